@@ -119,8 +119,11 @@ main(int argc, char *argv[])
         if (exiting) {
             poll_immediate_wake();
         }
-        ovsdb_idl_loop_commit_and_wait(&vtep_idl_loop);
-        ovsdb_idl_loop_commit_and_wait(&ovnsb_idl_loop);
+        int vtep_status = ovsdb_idl_loop_commit_and_wait(&vtep_idl_loop);
+        int sb_status = ovsdb_idl_loop_commit_and_wait(&ovnsb_idl_loop);
+        if (vtep_status != 1 || sb_status != 1) {
+            vtep_force_run();
+        }
         poll_block();
         if (should_service_stop()) {
             exiting = true;
@@ -226,26 +226,35 @@ vtep_lswitch_run(struct shash *vtep_pbs, struct sset *vtep_pswitches,
             }
 
             tnl_key = port_binding_rec->datapath->tunnel_key;
-            if (vtep_ls->n_tunnel_key
-                && vtep_ls->tunnel_key[0] != tnl_key) {
-                VLOG_DBG("set vtep logical switch (%s) tunnel key from "
-                         "(%"PRId64") to (%"PRId64")", vtep_ls->name,
-                         vtep_ls->tunnel_key[0], tnl_key);
+            if (!vtep_ls->n_tunnel_key
+                || vtep_ls->tunnel_key[0] != tnl_key) {
+                if (vtep_ls->n_tunnel_key) {
+                    VLOG_DBG("set vtep logical switch (%s) tunnel key from "
+                             "(%"PRId64") to (%"PRId64")", vtep_ls->name,
+                             vtep_ls->tunnel_key[0], tnl_key);
+                }
+                vteprec_logical_switch_set_tunnel_key(vtep_ls, &tnl_key, 1);
             }
-            vteprec_logical_switch_set_tunnel_key(vtep_ls, &tnl_key, 1);
 
             /* OVN is expected to always use source node replication mode,
              * hence the replication mode is hard-coded for each logical
              * switch in the context of ovn-controller-vtep. */
-            vteprec_logical_switch_set_replication_mode(vtep_ls, "source_node");
+            if (!vtep_ls->replication_mode
+                || strcmp(vtep_ls->replication_mode, "source_node")) {
+                vteprec_logical_switch_set_replication_mode(vtep_ls,
+                                                            "source_node");
+            }
             sset_add(&used_ls, lswitch_name);
         }
     }
     /* Resets the tunnel keys for unused vtep logical switches. */
     SHASH_FOR_EACH (node, vtep_lswitches) {
-        if (!sset_find(&used_ls, node->name)) {
+        const struct vteprec_logical_switch *vtep_ls = node->data;
+
+        if (!sset_find(&used_ls, node->name)
+            && (vtep_ls->n_tunnel_key != 1 || vtep_ls->tunnel_key[0])) {
             int64_t tnl_key = 0;
-            vteprec_logical_switch_set_tunnel_key(node->data, &tnl_key, 1);
+            vteprec_logical_switch_set_tunnel_key(vtep_ls, &tnl_key, 1);
         }
     }
     sset_destroy(&used_ls);
@@ -482,6 +491,23 @@ vtep_mcast_macs_cleanup(struct ovsdb_idl *vtep_idl)
     return true;
 }
 
+/* Sequence numbers of the SB and VTEP IDLs seen by the last vtep_run().
+ * vtep_run() derives all its changes from their contents, so it has nothing
+ * to do as long as they do not change, unless what it wrote was not
+ * committed. */
+static unsigned int vtep_sb_seqno;
+static unsigned int vtep_vtep_seqno;
+static bool vtep_run_needed = true;
+
+/* Makes the next vtep_run() compare the databases even if they did not
+ * change, e.g. because its last transaction failed or is still in
+ * flight. */
+void
+vtep_force_run(void)
+{
+    vtep_run_needed = true;
+}
+
 /* Updates vtep logical switch tunnel keys. */
 void
 vtep_run(struct controller_vtep_ctx *ctx)
@@ -490,6 +516,16 @@ vtep_run(struct controller_vtep_ctx *ctx)
         return;
     }
 
+    unsigned int sb_seqno = ovsdb_idl_get_seqno(ctx->ovnsb_idl);
+    unsigned int vtep_seqno = ovsdb_idl_get_seqno(ctx->vtep_idl);
+    if (!vtep_run_needed && sb_seqno == vtep_sb_seqno
+        && vtep_seqno == vtep_vtep_seqno) {
+        return;
+    }
+    vtep_sb_seqno = sb_seqno;
+    vtep_vtep_seqno = vtep_seqno;
+    vtep_run_needed = false;
+
     struct sset vtep_pswitches = SSET_INITIALIZER(&vtep_pswitches);
     struct shash vtep_lswitches = SHASH_INITIALIZER(&vtep_lswitches);
     struct shash ucast_macs_rmts = SHASH_INITIALIZER(&ucast_macs_rmts);
@@ -22,6 +22,7 @@
 struct controller_vtep_ctx;
 
 void vtep_run(struct controller_vtep_ctx *);
+void vtep_force_run(void);
 bool vtep_cleanup(struct controller_vtep_ctx *);
 
 #endif /* ovn/controller-vtep/vtep.h */
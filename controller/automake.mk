@@ -20,6 +20,8 @@ controller_ovn_controller_SOURCES = \
 	controller/lflow.h \
 	controller/lflow-cache.c \
 	controller/lflow-cache.h \
+	controller/lflow-conj-ids.c \
+	controller/lflow-conj-ids.h \
 	controller/lport.c \
 	controller/lport.h \
 	controller/ofctrl.c \
@@ -34,6 +36,8 @@ controller_ovn_controller_SOURCES = \
 	controller/ovn-controller.h \
 	controller/physical.c \
 	controller/physical.h \
+	controller/timer-wheel.c \
+	controller/timer-wheel.h \
 	controller/mac-learn.c \
 	controller/mac-learn.h
 
@@ -126,55 +126,56 @@ bfd_calculate_chassis(
     const struct sbrec_ha_chassis_group *ha_chassis_grp;
     SBREC_HA_CHASSIS_GROUP_TABLE_FOR_EACH (ha_chassis_grp,
                                            ha_chassis_grp_table) {
-        bool is_ha_chassis = false;
-        struct sset grp_chassis = SSET_INITIALIZER(&grp_chassis);
-        const struct sbrec_ha_chassis *ha_ch;
-        bool bfd_setup_required = false;
         if (ha_chassis_grp->n_ha_chassis < 2) {
             /* No need to consider the chassis group for BFD if
              * there is  1 or no chassis in it. */
             continue;
         }
+
+        /* Most of the groups do not involve 'our_chassis', so find out
+         * first whether the group is relevant before collecting any
+         * chassis name. */
+        bool is_ha_chassis = false;
         for (size_t i = 0; i < ha_chassis_grp->n_ha_chassis; i++) {
-            ha_ch = ha_chassis_grp->ha_chassis[i];
-            if (!ha_ch->chassis) {
-                continue;
-            }
-            sset_add(&grp_chassis, ha_ch->chassis->name);
-            if (our_chassis == ha_ch->chassis) {
+            if (our_chassis == ha_chassis_grp->ha_chassis[i]->chassis) {
                 is_ha_chassis = true;
-                bfd_setup_required = true;
+                break;
             }
         }
 
-        if (is_ha_chassis) {
-            /* It's an HA chassis. So add the ref_chassis to the bfd set. */
-            for (size_t i = 0; i < ha_chassis_grp->n_ref_chassis; i++) {
-                struct sbrec_chassis *ref_ch = ha_chassis_grp->ref_chassis[i];
-                if (smap_get_bool(&ref_ch->other_config, "is-remote", false)) {
-                    continue;
-                }
-                sset_add(&grp_chassis, ref_ch->name);
-            }
-        } else {
+        if (!is_ha_chassis) {
             /* This is not an HA chassis. Check if this chassis is present
-             * in the ref_chassis list. If so add the ha_chassis to the
-             * sset .*/
+             * in the ref_chassis list. If not, the group is not relevant. */
+            bool is_ref_chassis = false;
             for (size_t i = 0; i < ha_chassis_grp->n_ref_chassis; i++) {
                 if (our_chassis == ha_chassis_grp->ref_chassis[i]) {
-                    bfd_setup_required = true;
+                    is_ref_chassis = true;
                     break;
                 }
             }
+            if (!is_ref_chassis) {
+                continue;
+            }
         }
 
-        if (bfd_setup_required) {
-            const char *name;
-            SSET_FOR_EACH (name, &grp_chassis) {
-                sset_add(bfd_chassis, name);
+        for (size_t i = 0; i < ha_chassis_grp->n_ha_chassis; i++) {
+            const struct sbrec_ha_chassis *ha_ch =
+                ha_chassis_grp->ha_chassis[i];
+            if (ha_ch->chassis) {
+                sset_add(bfd_chassis, ha_ch->chassis->name);
+            }
+        }
+
+        if (is_ha_chassis) {
+            /* It's an HA chassis. So add the ref_chassis to the bfd set. */
+            for (size_t i = 0; i < ha_chassis_grp->n_ref_chassis; i++) {
+                struct sbrec_chassis *ref_ch = ha_chassis_grp->ref_chassis[i];
+                if (smap_get_bool(&ref_ch->other_config, "is-remote", false)) {
+                    continue;
+                }
+                sset_add(bfd_chassis, ref_ch->name);
             }
         }
-        sset_destroy(&grp_chassis);
     }
 }
 
@@ -23,6 +23,7 @@
 
 #include "lib/bitmap.h"
 #include "openvswitch/poll-loop.h"
+#include "lib/simap.h"
 #include "lib/sset.h"
 #include "lib/util.h"
 #include "lib/netdev.h"
@@ -30,7 +31,9 @@
 #include "openvswitch/hmap.h"
 #include "openvswitch/vlog.h"
 #include "lib/chassis-index.h"
+#include "lib/ovn-parallel-hmap.h"
 #include "lib/ovn-sb-idl.h"
+#include "lib/ovn-util.h"
 #include "ovn-controller.h"
 
 VLOG_DEFINE_THIS_MODULE(binding);
@@ -706,6 +709,32 @@ local_binding_data_destroy(struct local_binding_data *lbinding_data)
     shash_destroy(&lbinding_data->bindings);
 }
 
+void
+local_binding_data_get_memory_usage(
+    const struct local_binding_data *lbinding_data, struct simap *usage)
+{
+    size_t bytes = ovn_hmap_buckets_size(&lbinding_data->bindings.map)
+                   + ovn_hmap_buckets_size(&lbinding_data->lports.map);
+    const struct shash_node *node;
+
+    SHASH_FOR_EACH (node, &lbinding_data->bindings) {
+        const struct local_binding *lbinding = node->data;
+        bytes += sizeof *node + strlen(node->name) + 1
+                 + sizeof *lbinding + strlen(lbinding->name) + 1;
+    }
+    SHASH_FOR_EACH (node, &lbinding_data->lports) {
+        const struct binding_lport *b_lport = node->data;
+        bytes += sizeof *node + strlen(node->name) + 1
+                 + sizeof *b_lport + strlen(b_lport->name) + 1;
+    }
+
+    simap_increase(usage, "binding-local-bindings",
+                   shash_count(&lbinding_data->bindings));
+    simap_increase(usage, "binding-lports",
+                   shash_count(&lbinding_data->lports));
+    simap_increase(usage, "binding-KB", ROUND_UP(bytes, 1024) / 1024);
+}
+
 const struct sbrec_port_binding *
 local_binding_get_primary_pb(struct shash *local_bindings, const char *pb_name)
 {
@@ -1595,6 +1624,209 @@ build_local_bindings(struct binding_ctx_in *b_ctx_in,
     }
 }
 
+struct localnet_lport {
+    struct ovs_list list_node;
+    const struct sbrec_port_binding *pb;
+};
+
+static void
+consider_lport(const struct sbrec_port_binding *pb,
+               enum en_lport_type lport_type,
+               struct binding_ctx_in *b_ctx_in,
+               struct binding_ctx_out *b_ctx_out,
+               struct hmap *qos_map_ptr, struct hmap *qos_map,
+               struct ovs_list *localnet_lports)
+{
+    switch (lport_type) {
+    case LP_PATCH:
+    case LP_LOCALPORT:
+    case LP_VTEP:
+        update_local_lport_ids(pb, b_ctx_out);
+        break;
+
+    case LP_VIF:
+        consider_vif_lport(pb, b_ctx_in, b_ctx_out, NULL, qos_map_ptr);
+        break;
+
+    case LP_CONTAINER:
+        consider_container_lport(pb, b_ctx_in, b_ctx_out, qos_map_ptr);
+        break;
+
+    case LP_VIRTUAL:
+        consider_virtual_lport(pb, b_ctx_in, b_ctx_out, qos_map_ptr);
+        break;
+
+    case LP_L2GATEWAY:
+        consider_l2gw_lport(pb, b_ctx_in, b_ctx_out);
+        break;
+
+    case LP_L3GATEWAY:
+        consider_l3gw_lport(pb, b_ctx_in, b_ctx_out);
+        break;
+
+    case LP_CHASSISREDIRECT:
+        consider_cr_lport(pb, b_ctx_in, b_ctx_out);
+        break;
+
+    case LP_EXTERNAL:
+        consider_external_lport(pb, b_ctx_in, b_ctx_out);
+        break;
+
+    case LP_LOCALNET: {
+        consider_localnet_lport(pb, b_ctx_in, b_ctx_out, qos_map);
+        struct localnet_lport *lnet_lport = xmalloc(sizeof *lnet_lport);
+        lnet_lport->pb = pb;
+        ovs_list_push_back(localnet_lports, &lnet_lport->list_node);
+        break;
+    }
+
+    case LP_REMOTE:
+        /* Nothing to be done for REMOTE type. */
+        break;
+
+    case LP_UNKNOWN: {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+        VLOG_WARN_RL(&rl,
+                     "Unknown port binding type [%s] for port binding "
+                     "[%s]. Does the ovn-controller need an update ?",
+                     pb->type, pb->logical_port);
+        break;
+    }
+    }
+}
+
+/* Classifying the port bindings in parallel.
+ *
+ * Claiming and releasing the lports writes to the SB IDL transaction and
+ * updates the local datapaths and bindings, none of which is thread safe,
+ * so it stays in the serial loop of binding_run().  With thousands of
+ * port bindings, though, most of them are VIFs that are neither bound to
+ * this chassis nor have a local OVS interface, which the serial loop only
+ * has to skip.  So, before the serial loop, a pool of workers computes the
+ * type of each port binding and whether it may concern this chassis, only
+ * reading the IDL rows and the local bindings built by
+ * build_local_bindings(). */
+static bool use_parallel_binding = false;
+
+/* Below this many port bindings, waking up the workers costs more than it
+ * saves. */
+#define BINDING_CLASSIFY_PARALLEL_MIN 1024
+
+void
+binding_set_parallel(bool enabled)
+{
+    use_parallel_binding = enabled && can_parallelize_hashes(false);
+}
+
+struct binding_lport_class {
+    const struct sbrec_port_binding *pb;
+    enum en_lport_type type;
+    bool needs_binding;         /* False if the serial loop can skip it. */
+};
+
+struct binding_classify_job {
+    struct parallel_work work;
+    struct binding_lport_class *lports;
+    const struct sbrec_chassis *chassis_rec;
+    struct shash *local_bindings;
+};
+
+static void
+binding_classify_job_run(struct binding_classify_job *job, size_t index)
+{
+    struct binding_lport_class *lport = &job->lports[index];
+    const struct sbrec_port_binding *pb = lport->pb;
+
+    lport->type = get_lport_type(pb);
+    if (lport->type == LP_REMOTE) {
+        lport->needs_binding = false;
+    } else if (lport->type == LP_VIF) {
+        /* consider_vif_lport() does nothing for such a VIF. */
+        lport->needs_binding
+            = (pb->chassis == job->chassis_rec
+               || local_binding_find(job->local_bindings, pb->logical_port));
+    } else {
+        lport->needs_binding = true;
+    }
+}
+
+static bool binding_classify_pool_init_done = false;
+static struct worker_pool *binding_classify_pool = NULL;
+
+static void *
+binding_classify_thread(void *arg)
+{
+    struct worker_control *control = arg;
+    size_t start, end;
+
+    while (!stop_parallel_processing()) {
+        wait_for_work(control);
+        struct binding_classify_job *job = control->data;
+        if (stop_parallel_processing()) {
+            return NULL;
+        }
+        if (job) {
+            while (parallel_work_next(&job->work, &start, &end)) {
+                for (size_t i = start; i < end; i++) {
+                    binding_classify_job_run(job, i);
+                }
+            }
+        }
+        post_completed_work(control);
+    }
+    return NULL;
+}
+
+/* If parallel binding is enabled and there are enough port bindings,
+ * returns an array of all of them, in table order, classified by the worker
+ * pool, and stores its size in '*n_lports'.  The caller must free the
+ * array.  Otherwise, returns NULL. */
+static struct binding_lport_class *
+binding_classify_lports(struct binding_ctx_in *b_ctx_in,
+                        struct binding_ctx_out *b_ctx_out, size_t *n_lports)
+{
+    *n_lports = 0;
+    if (!use_parallel_binding) {
+        return NULL;
+    }
+    if (!binding_classify_pool_init_done) {
+        binding_classify_pool = add_worker_pool(binding_classify_thread);
+        binding_classify_pool_init_done = true;
+    }
+    if (!binding_classify_pool) {
+        return NULL;
+    }
+
+    struct binding_lport_class *lports = NULL;
+    size_t n = 0, allocated = 0;
+    const struct sbrec_port_binding *pb;
+    SBREC_PORT_BINDING_TABLE_FOR_EACH (pb, b_ctx_in->port_binding_table) {
+        if (n >= allocated) {
+            lports = x2nrealloc(lports, &allocated, sizeof *lports);
+        }
+        lports[n++].pb = pb;
+    }
+
+    if (n < BINDING_CLASSIFY_PARALLEL_MIN) {
+        free(lports);
+        return NULL;
+    }
+
+    struct binding_classify_job job = {
+        .lports = lports,
+        .chassis_rec = b_ctx_in->chassis_rec,
+        .local_bindings = &b_ctx_out->lbinding_data->bindings,
+    };
+    parallel_work_init_n(&job.work, n, binding_classify_pool->size);
+    for (int i = 0; i < binding_classify_pool->size; i++) {
+        binding_classify_pool->controls[i].data = &job;
+    }
+    run_pool_callback(binding_classify_pool, NULL, NULL, NULL);
+
+    *n_lports = n;
+    return lports;
+}
+
 void
 binding_run(struct binding_ctx_in *b_ctx_in, struct binding_ctx_out *b_ctx_out)
 {
@@ -1615,76 +1847,29 @@ binding_run(struct binding_ctx_in *b_ctx_in, struct binding_ctx_out *b_ctx_out)
 
     struct ovs_list localnet_lports = OVS_LIST_INITIALIZER(&localnet_lports);
 
-    struct localnet_lport {
-        struct ovs_list list_node;
-        const struct sbrec_port_binding *pb;
-    };
-
     /* Run through each binding record to see if it is resident on this
      * chassis and update the binding accordingly.  This includes both
      * directly connected logical ports and children of those ports
      * (which also includes virtual ports).
      */
-    const struct sbrec_port_binding *pb;
-    SBREC_PORT_BINDING_TABLE_FOR_EACH (pb,
-                                       b_ctx_in->port_binding_table) {
-        enum en_lport_type lport_type = get_lport_type(pb);
-
-        switch (lport_type) {
-        case LP_PATCH:
-        case LP_LOCALPORT:
-        case LP_VTEP:
-            update_local_lport_ids(pb, b_ctx_out);
-            break;
-
-        case LP_VIF:
-            consider_vif_lport(pb, b_ctx_in, b_ctx_out, NULL, qos_map_ptr);
-            break;
-
-        case LP_CONTAINER:
-            consider_container_lport(pb, b_ctx_in, b_ctx_out, qos_map_ptr);
-            break;
-
-        case LP_VIRTUAL:
-            consider_virtual_lport(pb, b_ctx_in, b_ctx_out, qos_map_ptr);
-            break;
-
-        case LP_L2GATEWAY:
-            consider_l2gw_lport(pb, b_ctx_in, b_ctx_out);
-            break;
-
-        case LP_L3GATEWAY:
-            consider_l3gw_lport(pb, b_ctx_in, b_ctx_out);
-            break;
-
-        case LP_CHASSISREDIRECT:
-            consider_cr_lport(pb, b_ctx_in, b_ctx_out);
-            break;
-
-        case LP_EXTERNAL:
-            consider_external_lport(pb, b_ctx_in, b_ctx_out);
-            break;
-
-        case LP_LOCALNET: {
-            consider_localnet_lport(pb, b_ctx_in, b_ctx_out, &qos_map);
-            struct localnet_lport *lnet_lport = xmalloc(sizeof *lnet_lport);
-            lnet_lport->pb = pb;
-            ovs_list_push_back(&localnet_lports, &lnet_lport->list_node);
-            break;
-        }
-
-        case LP_REMOTE:
-            /* Nothing to be done for REMOTE type. */
-            break;
-
-        case LP_UNKNOWN: {
-            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
-            VLOG_WARN_RL(&rl,
-                         "Unknown port binding type [%s] for port binding "
-                         "[%s]. Does the ovn-controller need an update ?",
-                         pb->type, pb->logical_port);
-            break;
+    size_t n_lports;
+    struct binding_lport_class *lports
+        = binding_classify_lports(b_ctx_in, b_ctx_out, &n_lports);
+    if (lports) {
+        for (size_t i = 0; i < n_lports; i++) {
+            if (lports[i].needs_binding) {
+                consider_lport(lports[i].pb, lports[i].type, b_ctx_in,
+                               b_ctx_out, qos_map_ptr, &qos_map,
+                               &localnet_lports);
+            }
         }
+        free(lports);
+    } else {
+        const struct sbrec_port_binding *pb;
+        SBREC_PORT_BINDING_TABLE_FOR_EACH (pb,
+                                           b_ctx_in->port_binding_table) {
+            consider_lport(pb, get_lport_type(pb), b_ctx_in, b_ctx_out,
+                           qos_map_ptr, &qos_map, &localnet_lports);
         }
     }
 
@@ -2067,6 +2252,17 @@ is_iface_vif(const struct ovsrec_interface *iface_rec)
     return true;
 }
 
+/* Returns true if 'iface_rec' is a tunnel without BFD, whose changes affect
+ * neither the bindings nor the active tunnels. */
+static bool
+is_iface_tunnel_without_bfd(const struct ovsrec_interface *iface_rec)
+{
+    return (smap_get(&iface_rec->options, "remote_ip")
+            && !smap_get_bool(&iface_rec->bfd, "enable", false)
+            && !ovsrec_interface_is_updated(iface_rec,
+                                            OVSREC_INTERFACE_COL_BFD));
+}
+
 static bool
 is_iface_in_int_bridge(const struct ovsrec_interface *iface,
                        const struct ovsrec_bridge *br_int)
@@ -2116,6 +2312,12 @@ binding_handle_ovs_interface_changes(struct binding_ctx_in *b_ctx_in,
     const struct ovsrec_interface *iface_rec;
     OVSREC_INTERFACE_TABLE_FOR_EACH_TRACKED (iface_rec,
                                              b_ctx_in->iface_table) {
+        if (is_iface_tunnel_without_bfd(iface_rec)) {
+            /* The tunnels to the other chassis are handled by the physical
+             * flows. */
+            continue;
+        }
+
         if (!is_iface_vif(iface_rec)) {
             /* Right now we are not handling ovs_interface changes of
              * other types. This can be enhanced to handle of
@@ -37,6 +37,7 @@ struct sbrec_port_binding_table;
 struct sset;
 struct sbrec_port_binding;
 struct ds;
+struct simap;
 struct if_status_mgr;
 
 struct binding_ctx_in {
@@ -97,6 +98,8 @@ struct local_binding_data {
 
 void local_binding_data_init(struct local_binding_data *);
 void local_binding_data_destroy(struct local_binding_data *);
+void local_binding_data_get_memory_usage(const struct local_binding_data *,
+                                         struct simap *usage);
 
 const struct sbrec_port_binding *local_binding_get_primary_pb(
     struct shash *local_bindings, const char *pb_name);
@@ -121,6 +124,7 @@ struct tracked_binding_datapath {
 };
 
 void binding_register_ovs_idl(struct ovsdb_idl *);
+void binding_set_parallel(bool enabled);
 void binding_run(struct binding_ctx_in *, struct binding_ctx_out *);
 bool binding_cleanup(struct ovsdb_idl_txn *ovnsb_idl_txn,
                      const struct sbrec_port_binding_table *,
@@ -1,10 +1,53 @@
 #include <config.h>
 
+#include "coverage.h"
+#include "lib/ovn-sb-idl.h"
+#include "openvswitch/hmap.h"
+#include "openvswitch/json.h"
 #include "openvswitch/vlog.h"
+#include "ovn-controller.h"
+#include "ovsdb-data.h"
+#include "ovsdb-idl.h"
+#include "uuid.h"
 #include "ddlog.h"
 
 VLOG_DEFINE_THIS_MODULE(controller_ddlog);
 
+COVERAGE_DEFINE(ddlog_local_datapath_mismatch);
+
+ddlog_prog ddlog_prog_global;
+
+/* Southbound tables mirrored into the DDlog program. */
+static const struct ovsdb_idl_table_class *ddlog_sb_tables[] = {
+    &sbrec_table_chassis,
+    &sbrec_table_ha_chassis,
+    &sbrec_table_ha_chassis_group,
+    &sbrec_table_logical_flow,
+    &sbrec_table_port_binding,
+};
+
+#define DDLOG_SB_PREFIX "OVN_Southbound::"
+
+static bool ddlog_enabled;
+
+/* True if the DDlog relations have to be repopulated from the full contents
+ * of the IDL, because tracked changes were lost or a transaction failed. */
+static bool ddlog_needs_full_sync = true;
+
+/* The name of the chassis pushed into LocalChassisName, if any. */
+static char *ddlog_chassis_name;
+
+static table_id LOCAL_CHASSIS_NAME_ID;
+static table_id LOCAL_DATAPATH_ID;
+
+/* The contents of the LocalDatapath output relation. */
+struct ddlog_dp_node {
+    struct hmap_node hmap_node;
+    struct uuid uuid;
+};
+static struct hmap ddlog_local_datapaths
+    = HMAP_INITIALIZER(&ddlog_local_datapaths);
+
 bool print_records_callback(uintptr_t arg, const ddlog_record *rec, ssize_t weight)
 {
     (void) arg;
@@ -26,21 +69,348 @@ void print_deltas_callback(uintptr_t arg, table_id table, const ddlog_record *re
     (void) weight;
     (void) table;
 
+    if (!VLOG_IS_DBG_ENABLED()) {
+        return;
+    }
+
     char *record_as_string = ddlog_dump_record(rec);
     if (record_as_string == NULL) {
-        VLOG_INFO("failed to dump delta");
+        VLOG_DBG("failed to dump delta");
     }
-    VLOG_INFO("DDlog delta: %s", record_as_string);
+    VLOG_DBG("DDlog delta: %s", record_as_string);
     ddlog_string_free(record_as_string);
 }
 
 void init_ddlog(void) {
+    if (ddlog_prog_global) {
+        return;
+    }
+
     ddlog_prog_global = ddlog_run(1, true, NULL, NULL);
     if (!ddlog_prog_global) {
         ovs_fatal(0, "Ddlog instance could not be created");
     }
+    LOCAL_CHASSIS_NAME_ID = ddlog_get_table_id(DDLOG_PROG,
+                                               "LocalChassisName");
+    LOCAL_DATAPATH_ID = ddlog_get_table_id(DDLOG_PROG, "LocalDatapath");
+}
+
+static void
+ddlog_local_datapaths_clear(void)
+{
+    struct ddlog_dp_node *node, *next;
+    HMAP_FOR_EACH_SAFE (node, next, hmap_node, &ddlog_local_datapaths) {
+        hmap_remove(&ddlog_local_datapaths, &node->hmap_node);
+        free(node);
+    }
 }
 
 void stop_ddlog(void) {
-    ddlog_stop(ddlog_prog_global);
+    if (ddlog_prog_global) {
+        ddlog_stop(ddlog_prog_global);
+        ddlog_prog_global = NULL;
+    }
+    ddlog_local_datapaths_clear();
+    free(ddlog_chassis_name);
+    ddlog_chassis_name = NULL;
+    ddlog_needs_full_sync = true;
+}
+
+/* Starts or stops the DDlog computation.  Stopping it frees the DDlog
+ * program, so that enabling it again starts from scratch. */
+void
+ctrl_ddlog_set_enabled(bool enabled)
+{
+    if (enabled == ddlog_enabled) {
+        return;
+    }
+
+    VLOG_INFO("%s the DDlog computation of local datapaths",
+              enabled ? "enabling" : "disabling");
+    ddlog_enabled = enabled;
+    if (enabled) {
+        init_ddlog();
+    } else {
+        stop_ddlog();
+    }
+}
+
+bool
+ctrl_ddlog_is_enabled(void)
+{
+    return ddlog_enabled;
+}
+
+/* Called when ctrl_ddlog_run() is skipped in an iteration of the main loop:
+ * the changes tracked by the IDL are about to be lost. */
+void
+ctrl_ddlog_invalidate(void)
+{
+    ddlog_needs_full_sync = true;
+}
+
+static struct json *
+ddlog_table_rows(struct json *updates, const struct ovsdb_idl_table_class *tc)
+{
+    struct json *rows = shash_find_data(json_object(updates), tc->name);
+    if (!rows) {
+        rows = json_object_create();
+        json_object_put(updates, tc->name, rows);
+    }
+    return rows;
+}
+
+/* Adds to <table-updates2> 'updates' an operation to insert 'row'. */
+static void
+ddlog_put_insert(struct json *updates, const struct ovsdb_idl_table_class *tc,
+                 const struct ovsdb_idl_row *row)
+{
+    struct json *new = json_object_create();
+    for (size_t i = 0; i < tc->n_columns; i++) {
+        const struct ovsdb_idl_column *column = &tc->columns[i];
+        json_object_put(new, column->name,
+                        ovsdb_datum_to_json(ovsdb_idl_read(row, column),
+                                            &column->type));
+    }
+
+    struct json *op = json_object_create();
+    json_object_put(op, "insert", new);
+    json_object_put_nocopy(ddlog_table_rows(updates, tc),
+                           xasprintf(UUID_FMT, UUID_ARGS(&row->uuid)), op);
+}
+
+/* Adds to <table-updates2> 'updates' an operation to delete 'row'. */
+static void
+ddlog_put_delete(struct json *updates, const struct ovsdb_idl_table_class *tc,
+                 const struct ovsdb_idl_row *row)
+{
+    struct json *op = json_object_create();
+    json_object_put(op, "delete", json_null_create());
+    json_object_put_nocopy(ddlog_table_rows(updates, tc),
+                           xasprintf(UUID_FMT, UUID_ARGS(&row->uuid)), op);
+}
+
+static int
+ddlog_apply_json(struct json *updates)
+{
+    int error = 0;
+
+    if (!shash_is_empty(json_object(updates))) {
+        char *s = json_to_string(updates, 0);
+        error = ddlog_apply_ovsdb_updates(DDLOG_PROG, DDLOG_SB_PREFIX, s);
+        if (error) {
+            VLOG_WARN("DDlog failed to apply updates %s", s);
+        }
+        free(s);
+    }
+    json_destroy(updates);
+    return error;
+}
+
+/* Pushes the contents of the mirrored tables, or the changes to them if
+ * 'full' is false, into the DDlog transaction. */
+static int
+ddlog_sync_tables(struct ovsdb_idl *idl, bool full)
+{
+    /* A modified row is deleted and inserted again, which can't be expressed
+     * within a single <table-updates2>, so the deletions go first. */
+    struct json *deletes = json_object_create();
+    struct json *inserts = json_object_create();
+
+    for (size_t i = 0; i < ARRAY_SIZE(ddlog_sb_tables); i++) {
+        const struct ovsdb_idl_table_class *tc = ddlog_sb_tables[i];
+        const struct ovsdb_idl_row *row;
+
+        if (full) {
+            char *relation = xasprintf(DDLOG_SB_PREFIX"%s", tc->name);
+            int error = ddlog_clear_relation(
+                DDLOG_PROG, ddlog_get_table_id(DDLOG_PROG, relation));
+            free(relation);
+            if (error) {
+                json_destroy(deletes);
+                json_destroy(inserts);
+                return error;
+            }
+
+            for (row = ovsdb_idl_first_row(idl, tc); row;
+                 row = ovsdb_idl_next_row(row)) {
+                ddlog_put_insert(inserts, tc, row);
+            }
+            continue;
+        }
+
+        for (row = ovsdb_idl_track_get_first(idl, tc); row;
+             row = ovsdb_idl_track_get_next(row)) {
+            bool is_new = !ovsdb_idl_row_get_seqno(row,
+                                                   OVSDB_IDL_CHANGE_MODIFY);
+            bool is_deleted = ovsdb_idl_row_get_seqno(row,
+                                                      OVSDB_IDL_CHANGE_DELETE);
+            if (!is_new) {
+                ddlog_put_delete(deletes, tc, row);
+            }
+            if (!is_deleted) {
+                ddlog_put_insert(inserts, tc, row);
+            }
+        }
+    }
+
+    int error = ddlog_apply_json(deletes);
+    if (error) {
+        json_destroy(inserts);
+        return error;
+    }
+    return ddlog_apply_json(inserts);
+}
+
+/* Updates LocalChassisName to 'name'. */
+static int
+ddlog_sync_chassis_name(const char *name)
+{
+    if (nullable_string_is_equal(name, ddlog_chassis_name)) {
+        return 0;
+    }
+
+    ddlog_cmd *cmds[2];
+    int n_cmds = 0;
+    if (ddlog_chassis_name) {
+        cmds[n_cmds++] = ddlog_delete_val_cmd(
+            LOCAL_CHASSIS_NAME_ID, ddlog_string(ddlog_chassis_name));
+    }
+    if (name) {
+        cmds[n_cmds++] = ddlog_insert_cmd(LOCAL_CHASSIS_NAME_ID,
+                                          ddlog_string(name));
+    }
+    if (ddlog_apply_updates(DDLOG_PROG, cmds, n_cmds) < 0) {
+        return -1;
+    }
+
+    free(ddlog_chassis_name);
+    ddlog_chassis_name = nullable_xstrdup(name);
+    return 0;
+}
+
+static bool
+ddlog_get_uuid(const ddlog_record *rec, struct uuid *uuid)
+{
+    if (!ddlog_is_int(rec)) {
+        return false;
+    }
+
+    __uint128_t u128 = ddlog_get_u128(rec);
+    uuid->parts[0] = u128 >> 96;
+    uuid->parts[1] = u128 >> 64;
+    uuid->parts[2] = u128 >> 32;
+    uuid->parts[3] = u128;
+    return true;
+}
+
+static struct ddlog_dp_node *
+ddlog_local_datapath_find(const struct uuid *uuid)
+{
+    struct ddlog_dp_node *node;
+    HMAP_FOR_EACH_WITH_HASH (node, hmap_node, uuid_hash(uuid),
+                             &ddlog_local_datapaths) {
+        if (uuid_equals(&node->uuid, uuid)) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+static void
+ddlog_delta_cb(uintptr_t arg, table_id table, const ddlog_record *rec,
+               ssize_t weight)
+{
+    if (table != LOCAL_DATAPATH_ID) {
+        print_deltas_callback(arg, table, rec, weight);
+        return;
+    }
+
+    struct uuid uuid;
+    if (!ddlog_get_uuid(rec, &uuid)) {
+        return;
+    }
+
+    struct ddlog_dp_node *node = ddlog_local_datapath_find(&uuid);
+    if (weight > 0 && !node) {
+        node = xmalloc(sizeof *node);
+        node->uuid = uuid;
+        hmap_insert(&ddlog_local_datapaths, &node->hmap_node,
+                    uuid_hash(&uuid));
+    } else if (weight < 0 && node) {
+        hmap_remove(&ddlog_local_datapaths, &node->hmap_node);
+        free(node);
+    }
+}
+
+/* Pushes the southbound changes of this iteration and the name of 'chassis'
+ * into DDlog, and updates the DDlog local datapaths from the outcome. */
+void
+ctrl_ddlog_run(struct ovsdb_idl *ovnsb_idl,
+               const struct sbrec_chassis *chassis)
+{
+    if (!ddlog_enabled) {
+        return;
+    }
+
+    if (ddlog_transaction_start(DDLOG_PROG)) {
+        VLOG_WARN("DDlog failed to start transaction");
+        ddlog_needs_full_sync = true;
+        return;
+    }
+
+    if (ddlog_sync_tables(ovnsb_idl, ddlog_needs_full_sync)
+        || ddlog_sync_chassis_name(chassis ? chassis->name : NULL)) {
+        goto error;
+    }
+
+    ddlog_delta *delta = ddlog_transaction_commit_dump_changes(DDLOG_PROG);
+    if (!delta) {
+        VLOG_WARN("DDlog failed to commit transaction");
+        goto error;
+    }
+    ddlog_delta_enumerate(delta, ddlog_delta_cb, 0);
+    ddlog_free_delta(delta);
+    ddlog_needs_full_sync = false;
+    return;
+
+error:
+    ddlog_transaction_rollback(DDLOG_PROG);
+    ddlog_needs_full_sync = true;
+}
+
+/* Compares the local datapaths computed by the incremental processing
+ * engine, 'local_datapaths', with the ones computed by DDlog, and logs the
+ * differences. */
+void
+ctrl_ddlog_check_local_datapaths(struct ovsdb_idl *ovnsb_idl,
+                                 const struct hmap *local_datapaths)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 5);
+
+    if (!ddlog_enabled || ddlog_needs_full_sync) {
+        return;
+    }
+
+    const struct local_datapath *ld;
+    HMAP_FOR_EACH (ld, hmap_node, local_datapaths) {
+        const struct uuid *uuid = &ld->datapath->header_.uuid;
+        if (!ddlog_local_datapath_find(uuid)) {
+            COVERAGE_INC(ddlog_local_datapath_mismatch);
+            VLOG_INFO_RL(&rl, "datapath "UUID_FMT" (%"PRId64") is local "
+                         "for the engine but not for DDlog",
+                         UUID_ARGS(uuid), ld->datapath->tunnel_key);
+        }
+    }
+
+    struct ddlog_dp_node *node;
+    HMAP_FOR_EACH (node, hmap_node, &ddlog_local_datapaths) {
+        const struct sbrec_datapath_binding *dp
+            = sbrec_datapath_binding_get_for_uuid(ovnsb_idl, &node->uuid);
+        if (!dp || !get_local_datapath(local_datapaths, dp->tunnel_key)) {
+            COVERAGE_INC(ddlog_local_datapath_mismatch);
+            VLOG_INFO_RL(&rl, "datapath "UUID_FMT" is local for DDlog but "
+                         "not for the engine", UUID_ARGS(&node->uuid));
+        }
+    }
 }
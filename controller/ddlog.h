@@ -1,15 +1,21 @@
 #ifndef OVN_DDLOG_H
 #define OVN_DDLOG_H 1
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "util.h"
 #include "controller/ovn_controller_ddlog/ddlog.h"
 
+struct hmap;
+struct ovsdb_idl;
+struct sbrec_chassis;
+
 #define DDLOG_PROG  (ddlog_prog_global)
 
-// the ddlog instance for ovn-controller, initialized in ovn-controller main()
-ddlog_prog ddlog_prog_global;
+/* The ddlog instance for ovn-controller, started when the DDlog computation
+ * is enabled through external_ids:ovn-ddlog, NULL otherwise. */
+extern ddlog_prog ddlog_prog_global;
 
 void init_ddlog(void);
 void stop_ddlog(void);
@@ -17,4 +23,17 @@ void stop_ddlog(void);
 bool print_records_callback(uintptr_t arg, const ddlog_record *rec, ssize_t weight);
 void print_deltas_callback(uintptr_t arg, table_id table, const ddlog_record *rec, ssize_t weight);
 
+/* The DDlog computation mirrors the southbound tables it needs into the
+ * program of controller/ovn_controller.dl, which computes the local
+ * datapaths in parallel with the incremental processing engine.  The result
+ * is compared with the one of the engine after each run, so that the changes
+ * that the engine's change handlers miss show up as mismatches. */
+void ctrl_ddlog_set_enabled(bool enabled);
+bool ctrl_ddlog_is_enabled(void);
+void ctrl_ddlog_run(struct ovsdb_idl *ovnsb_idl,
+                    const struct sbrec_chassis *chassis);
+void ctrl_ddlog_invalidate(void);
+void ctrl_ddlog_check_local_datapaths(struct ovsdb_idl *ovnsb_idl,
+                                      const struct hmap *local_datapaths);
+
 #endif
@@ -16,10 +16,13 @@
 #include <config.h>
 #include "encaps.h"
 
+#include "lib/chassis-index.h"
 #include "lib/hash.h"
 #include "lib/sset.h"
 #include "lib/util.h"
+#include "lib/uuid.h"
 #include "lib/vswitch-idl.h"
+#include "openvswitch/hmap.h"
 #include "openvswitch/vlog.h"
 #include "lib/ovn-sb-idl.h"
 #include "ovn-controller.h"
@@ -33,6 +36,29 @@ VLOG_DEFINE_THIS_MODULE(encaps);
  */
 #define	OVN_MVTEP_CHASSISID_DELIM '@'
 
+/* What the tunnels that exist after the last full run of encaps_run()
+ * depend on, other than the other chassis themselves.  As long as it does
+ * not change, the next runs only reconcile the tunnels of the chassis whose
+ * records, or tunnel ports, changed. */
+struct encaps_state {
+    bool valid;
+    struct uuid br_int;
+    struct uuid chassis;        /* This chassis. */
+    bool ipsec;
+    struct sset transport_zones;
+    bool on_demand;             /* Tunnels only to the chassis in 'peers'. */
+    struct sset peers;
+
+    /* Names of the chassis whose tunnels are to be reconciled. */
+    struct sset dirty_chassis;
+};
+
+static struct encaps_state encaps_state = {
+    .transport_zones = SSET_INITIALIZER(&encaps_state.transport_zones),
+    .peers = SSET_INITIALIZER(&encaps_state.peers),
+    .dirty_chassis = SSET_INITIALIZER(&encaps_state.dirty_chassis),
+};
+
 void
 encaps_register_ovs_idl(struct ovsdb_idl *ovs_idl)
 {
@@ -314,21 +340,228 @@ chassis_tzones_overlap(const struct sset *transport_zones,
     return false;
 }
 
+/* Creates the tunnels to 'chassis_rec', unless it is this chassis or is not
+ * to be reached through a tunnel.  If 'peers' is nonnull, tunnels are only
+ * created to the chassis it contains. */
+static void
+encaps_add_chassis_tunnels(struct tunnel_ctx *tc,
+                           const struct sbrec_chassis *chassis_rec,
+                           const struct sbrec_sb_global *sbg,
+                           const struct sset *transport_zones,
+                           const struct sset *peers)
+{
+    const struct sbrec_chassis *this_chassis = tc->this_chassis;
+
+    if (!strcmp(chassis_rec->name, this_chassis->name)) {
+        return;
+    }
+
+    if (peers && !sset_contains(peers, chassis_rec->name)) {
+        VLOG_DBG("Skipping encap creation for Chassis '%s' because "
+                 "it hosts no port of the local datapaths",
+                 chassis_rec->name);
+        return;
+    }
+
+    /* Create tunnels to the other Chassis belonging to the
+     * same transport zone */
+    if (!chassis_tzones_overlap(transport_zones, chassis_rec)) {
+        VLOG_DBG("Skipping encap creation for Chassis '%s' because "
+                 "it belongs to different transport zones",
+                 chassis_rec->name);
+        return;
+    }
+
+    if (smap_get_bool(&chassis_rec->other_config, "is-remote", false)
+        && !smap_get_bool(&this_chassis->other_config, "is-interconn",
+                          false)) {
+        VLOG_DBG("Skipping encap creation for Chassis '%s' because "
+                 "it is remote but this chassis is not interconn.",
+                 chassis_rec->name);
+        return;
+    }
+
+    if (chassis_tunnel_add(chassis_rec, sbg, tc) == 0) {
+        VLOG_INFO("Creating encap for '%s' failed", chassis_rec->name);
+    }
+}
+
+/* Collects all port names into tc->port_names and the OVN-created tunnels
+ * into tc->chassis.  If 'dirty' is nonnull, only the tunnels to the chassis
+ * it contains are collected. */
+static void
+encaps_collect_tunnels(struct tunnel_ctx *tc,
+                       const struct ovsrec_bridge_table *bridge_table,
+                       const struct sset *dirty)
+{
+    const struct ovsrec_bridge *br;
+
+    OVSREC_BRIDGE_TABLE_FOR_EACH (br, bridge_table) {
+        for (size_t i = 0; i < br->n_ports; i++) {
+            const struct ovsrec_port *port = br->ports[i];
+            sset_add(&tc->port_names, port->name);
+
+            /*
+             * note that the id here is not just the chassis name, but the
+             * combination of <chassis_name><delim><encap_ip>
+             */
+            const char *id = smap_get(&port->external_ids, "ovn-chassis-id");
+            if (!id) {
+                continue;
+            }
+            if (dirty) {
+                char *chassis_name;
+                if (!encaps_tunnel_id_parse(id, &chassis_name, NULL)) {
+                    continue;
+                }
+                bool is_dirty = sset_contains(dirty, chassis_name);
+                free(chassis_name);
+                if (!is_dirty) {
+                    continue;
+                }
+            }
+            if (!shash_find(&tc->chassis, id)) {
+                struct chassis_node *chassis = xzalloc(sizeof *chassis);
+                chassis->bridge = br;
+                chassis->port = port;
+                shash_add_assert(&tc->chassis, id, chassis);
+            } else {
+                /* Duplicate port for ovn-chassis-id.  Arbitrarily choose
+                 * to delete this one. */
+                ovsrec_bridge_update_ports_delvalue(br, port);
+            }
+        }
+    }
+}
+
+/* Adds to 'encaps_state.dirty_chassis' the chassis whose tunnels may have to
+ * change according to the tracked changes of the SB and OVS databases.
+ * Returns false if the tunnels to all the chassis have to be reconciled
+ * instead. */
+static bool
+encaps_track_changes(const struct sbrec_chassis_table *chassis_table,
+                     const struct sbrec_encap_table *encap_table,
+                     const struct ovsrec_port_table *port_table,
+                     const struct ovsrec_interface_table *iface_table,
+                     const struct sbrec_chassis *this_chassis)
+{
+    struct sset *dirty = &encaps_state.dirty_chassis;
+
+    const struct sbrec_chassis *chassis_rec;
+    SBREC_CHASSIS_TABLE_FOR_EACH_TRACKED (chassis_rec, chassis_table) {
+        if (chassis_rec == this_chassis
+            || (!sbrec_chassis_is_new(chassis_rec)
+                && !sbrec_chassis_is_deleted(chassis_rec)
+                && sbrec_chassis_is_updated(chassis_rec,
+                                            SBREC_CHASSIS_COL_NAME))) {
+            return false;
+        }
+        sset_add(dirty, chassis_rec->name);
+    }
+
+    const struct sbrec_encap *encap;
+    SBREC_ENCAP_TABLE_FOR_EACH_TRACKED (encap, encap_table) {
+        if (!strcmp(encap->chassis_name, this_chassis->name)) {
+            return false;
+        }
+        sset_add(dirty, encap->chassis_name);
+    }
+
+    const struct ovsrec_port *port;
+    OVSREC_PORT_TABLE_FOR_EACH_TRACKED (port, port_table) {
+        const char *id = smap_get(&port->external_ids, "ovn-chassis-id");
+        char *chassis_name;
+        if (id && encaps_tunnel_id_parse(id, &chassis_name, NULL)) {
+            sset_add_and_free(dirty, chassis_name);
+        }
+    }
+
+    /* The interfaces of the tunnels are created and deleted along with their
+     * ports, but there is no cheap way to find the port of an interface
+     * whose configuration was changed behind our back. */
+    const struct ovsrec_interface *iface;
+    OVSREC_INTERFACE_TABLE_FOR_EACH_TRACKED (iface, iface_table) {
+        if (ovsrec_interface_is_new(iface)
+            || ovsrec_interface_is_deleted(iface)) {
+            continue;
+        }
+        if (ovsrec_interface_is_updated(iface, OVSREC_INTERFACE_COL_NAME)
+            || ovsrec_interface_is_updated(iface, OVSREC_INTERFACE_COL_TYPE)
+            || ovsrec_interface_is_updated(iface,
+                                           OVSREC_INTERFACE_COL_OPTIONS)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Makes the next encaps_run() reconcile the tunnels to all the chassis, e.g.
+ * because it was not called and missed tracked changes. */
+void
+encaps_invalidate(void)
+{
+    encaps_state.valid = false;
+    sset_clear(&encaps_state.dirty_chassis);
+}
+
 void
 encaps_run(struct ovsdb_idl_txn *ovs_idl_txn,
            const struct ovsrec_bridge_table *bridge_table,
            const struct ovsrec_bridge *br_int,
+           const struct ovsrec_port_table *port_table,
+           const struct ovsrec_interface_table *iface_table,
+           struct ovsdb_idl_index *sbrec_chassis_by_name,
            const struct sbrec_chassis_table *chassis_table,
+           const struct sbrec_encap_table *encap_table,
            const struct sbrec_chassis *this_chassis,
            const struct sbrec_sb_global *sbg,
-           const struct sset *transport_zones)
+           const struct sset *transport_zones,
+           const struct sset *peers)
 {
+    struct encaps_state *state = &encaps_state;
+    bool ipsec = sbg && sbg->ipsec;
+
+    /* The tracked changes are only available during this run, so record
+     * them even if the tunnels can't be updated right now. */
+    if (state->valid
+        && (!br_int || !uuid_equals(&state->br_int, &br_int->header_.uuid)
+            || !uuid_equals(&state->chassis, &this_chassis->header_.uuid)
+            || state->ipsec != ipsec
+            || !sset_equals(&state->transport_zones, transport_zones)
+            || state->on_demand != (peers != NULL)
+            || !encaps_track_changes(chassis_table, encap_table, port_table,
+                                     iface_table, this_chassis))) {
+        encaps_invalidate();
+    }
+
+    if (state->valid && peers && !sset_equals(&state->peers, peers)) {
+        /* The tunnels to the chassis that became peers, or stopped being
+         * peers, have to be created or deleted. */
+        const char *name;
+        SSET_FOR_EACH (name, peers) {
+            if (!sset_contains(&state->peers, name)) {
+                sset_add(&state->dirty_chassis, name);
+            }
+        }
+        SSET_FOR_EACH (name, &state->peers) {
+            if (!sset_contains(peers, name)) {
+                sset_add(&state->dirty_chassis, name);
+            }
+        }
+        sset_destroy(&state->peers);
+        sset_clone(&state->peers, peers);
+    }
+
     if (!ovs_idl_txn || !br_int) {
         return;
     }
 
+    if (state->valid && sset_is_empty(&state->dirty_chassis)) {
+        return;
+    }
+
     const struct sbrec_chassis *chassis_rec;
-    const struct ovsrec_bridge *br;
 
     struct tunnel_ctx tc = {
         .chassis = SHASH_INITIALIZER(&tc.chassis),
@@ -342,58 +575,39 @@ encaps_run(struct ovsdb_idl_txn *ovs_idl_txn,
                               "ovn-controller: modifying OVS tunnels '%s'",
                               this_chassis->name);
 
-    /* Collect all port names into tc.port_names.
-     *
-     * Collect all the OVN-created tunnels into tc.tunnel_hmap. */
-    OVSREC_BRIDGE_TABLE_FOR_EACH (br, bridge_table) {
-        for (size_t i = 0; i < br->n_ports; i++) {
-            const struct ovsrec_port *port = br->ports[i];
-            sset_add(&tc.port_names, port->name);
+    if (state->valid) {
+        /* Only reconcile the tunnels to the chassis that changed. */
+        encaps_collect_tunnels(&tc, bridge_table, &state->dirty_chassis);
 
-            /*
-             * note that the id here is not just the chassis name, but the
-             * combination of <chassis_name><delim><encap_ip>
-             */
-            const char *id = smap_get(&port->external_ids, "ovn-chassis-id");
-            if (id) {
-                if (!shash_find(&tc.chassis, id)) {
-                    struct chassis_node *chassis = xzalloc(sizeof *chassis);
-                    chassis->bridge = br;
-                    chassis->port = port;
-                    shash_add_assert(&tc.chassis, id, chassis);
-                } else {
-                    /* Duplicate port for ovn-chassis-id.  Arbitrarily choose
-                     * to delete this one. */
-                    ovsrec_bridge_update_ports_delvalue(br, port);
-                }
+        const char *name;
+        SSET_FOR_EACH (name, &state->dirty_chassis) {
+            chassis_rec = chassis_lookup_by_name(sbrec_chassis_by_name, name);
+            if (chassis_rec) {
+                encaps_add_chassis_tunnels(&tc, chassis_rec, sbg,
+                                           transport_zones, peers);
             }
         }
-    }
+        sset_clear(&state->dirty_chassis);
+    } else {
+        encaps_collect_tunnels(&tc, bridge_table, NULL);
 
-    SBREC_CHASSIS_TABLE_FOR_EACH (chassis_rec, chassis_table) {
-        if (strcmp(chassis_rec->name, this_chassis->name)) {
-            /* Create tunnels to the other Chassis belonging to the
-             * same transport zone */
-            if (!chassis_tzones_overlap(transport_zones, chassis_rec)) {
-                VLOG_DBG("Skipping encap creation for Chassis '%s' because "
-                         "it belongs to different transport zones",
-                         chassis_rec->name);
-                continue;
-            }
-
-            if (smap_get_bool(&chassis_rec->other_config, "is-remote", false)
-                && !smap_get_bool(&this_chassis->other_config, "is-interconn",
-                                  false)) {
-                VLOG_DBG("Skipping encap creation for Chassis '%s' because "
-                         "it is remote but this chassis is not interconn.",
-                         chassis_rec->name);
-                continue;
-            }
+        SBREC_CHASSIS_TABLE_FOR_EACH (chassis_rec, chassis_table) {
+            encaps_add_chassis_tunnels(&tc, chassis_rec, sbg,
+                                       transport_zones, peers);
+        }
 
-            if (chassis_tunnel_add(chassis_rec, sbg, &tc) == 0) {
-                VLOG_INFO("Creating encap for '%s' failed", chassis_rec->name);
-                continue;
-            }
+        state->valid = true;
+        state->br_int = br_int->header_.uuid;
+        state->chassis = this_chassis->header_.uuid;
+        state->ipsec = ipsec;
+        sset_destroy(&state->transport_zones);
+        sset_clone(&state->transport_zones, transport_zones);
+        state->on_demand = peers != NULL;
+        sset_destroy(&state->peers);
+        if (peers) {
+            sset_clone(&state->peers, peers);
+        } else {
+            sset_init(&state->peers);
         }
     }
 
@@ -409,6 +623,49 @@ encaps_run(struct ovsdb_idl_txn *ovs_idl_txn,
     sset_destroy(&tc.port_names);
 }
 
+/* Adds to 'peers' the names of the chassis that host ports of the
+ * 'local_datapaths', or that may host them as gateways, i.e. the chassis
+ * that this chassis may have to reach through a tunnel. */
+void
+encaps_collect_peers(const struct hmap *local_datapaths,
+                     struct ovsdb_idl_index *sbrec_port_binding_by_datapath,
+                     struct sset *peers)
+{
+    const struct local_datapath *ld;
+    HMAP_FOR_EACH (ld, hmap_node, local_datapaths) {
+        struct sbrec_port_binding *target = sbrec_port_binding_index_init_row(
+            sbrec_port_binding_by_datapath);
+        sbrec_port_binding_index_set_datapath(target, ld->datapath);
+
+        const struct sbrec_port_binding *pb;
+        SBREC_PORT_BINDING_FOR_EACH_EQUAL (pb, target,
+                                           sbrec_port_binding_by_datapath) {
+            if (pb->chassis) {
+                sset_add(peers, pb->chassis->name);
+            }
+            for (size_t i = 0; i < pb->n_gateway_chassis; i++) {
+                const struct sbrec_chassis *gw
+                    = pb->gateway_chassis[i]->chassis;
+                if (gw) {
+                    sset_add(peers, gw->name);
+                }
+            }
+            if (pb->ha_chassis_group) {
+                const struct sbrec_ha_chassis_group *hcg
+                    = pb->ha_chassis_group;
+                for (size_t i = 0; i < hcg->n_ha_chassis; i++) {
+                    const struct sbrec_chassis *ha
+                        = hcg->ha_chassis[i]->chassis;
+                    if (ha) {
+                        sset_add(peers, ha->name);
+                    }
+                }
+            }
+        }
+        sbrec_port_binding_index_destroy_row(target);
+    }
+}
+
 /* Returns true if the database is all cleaned up, false if more work is
  * required. */
 bool
@@ -17,11 +17,62 @@
 
 #include "ha-chassis.h"
 #include "lib/sset.h"
+#include "lib/uuid.h"
 #include "openvswitch/vlog.h"
 #include "lib/ovn-sb-idl.h"
 
 VLOG_DEFINE_THIS_MODULE(ha_chassis);
 
+/* Result of ha_chassis_group_is_active() for an HA chassis group, so that
+ * the groups shared by many port bindings are only evaluated once.  The
+ * cache is flushed by ha_chassis_cache_flush() when the active tunnels or
+ * the HA chassis groups, HA chassis or chassis change. */
+struct ha_chassis_cache_node {
+    struct hmap_node hmap_node; /* In 'ha_chassis_cache', by group uuid. */
+    struct uuid group_uuid;
+    const struct sbrec_chassis *local_chassis;
+    const struct sset *active_tunnels;
+    bool active;
+};
+
+static struct hmap ha_chassis_cache = HMAP_INITIALIZER(&ha_chassis_cache);
+
+static struct ha_chassis_cache_node *
+ha_chassis_cache_find(const struct sbrec_ha_chassis_group *ha_ch_grp)
+{
+    const struct uuid *uuid = &ha_ch_grp->header_.uuid;
+    struct ha_chassis_cache_node *node;
+
+    HMAP_FOR_EACH_WITH_HASH (node, hmap_node, uuid_hash(uuid),
+                             &ha_chassis_cache) {
+        if (uuid_equals(&node->group_uuid, uuid)) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/* Forgets the cached results of ha_chassis_group_is_active().  Must be
+ * called whenever the active tunnels are recalculated and whenever an HA
+ * chassis group, an HA chassis or a chassis changes in the southbound
+ * database. */
+void
+ha_chassis_cache_flush(void)
+{
+    struct ha_chassis_cache_node *node;
+
+    HMAP_FOR_EACH_POP (node, hmap_node, &ha_chassis_cache) {
+        free(node);
+    }
+}
+
+void
+ha_chassis_cache_destroy(void)
+{
+    ha_chassis_cache_flush();
+    hmap_destroy(&ha_chassis_cache);
+}
+
 static int
 compare_chassis_prio_(const void *a_, const void *b_)
 {
@@ -164,22 +215,11 @@ is_local_chassis_only_candidate(const struct sbrec_ha_chassis_group *ha_ch_grp,
     return (local_chassis_present && n_active_ha_chassis == 1);
 }
 
-/* Returns true if the local_chassis is the master of
- * the HA chassis group, false otherwise. */
-bool
-ha_chassis_group_is_active(
-    const struct sbrec_ha_chassis_group *ha_ch_grp,
-    const struct sset *active_tunnels,
-    const struct sbrec_chassis *local_chassis)
+static bool
+ha_chassis_group_is_active__(const struct sbrec_ha_chassis_group *ha_ch_grp,
+                             const struct sset *active_tunnels,
+                             const struct sbrec_chassis *local_chassis)
 {
-    if (!ha_ch_grp || !ha_ch_grp->n_ha_chassis) {
-        return false;
-    }
-
-    if (ha_ch_grp->n_ha_chassis == 1) {
-        return (ha_ch_grp->ha_chassis[0]->chassis == local_chassis);
-    }
-
     if (is_local_chassis_only_candidate(ha_ch_grp, local_chassis)) {
         return true;
     }
@@ -202,6 +242,46 @@ ha_chassis_group_is_active(
     return (active_ch == local_chassis);
 }
 
+/* Returns true if the local_chassis is the master of
+ * the HA chassis group, false otherwise.
+ *
+ * The result is cached per HA chassis group until the next
+ * ha_chassis_cache_flush(). */
+bool
+ha_chassis_group_is_active(
+    const struct sbrec_ha_chassis_group *ha_ch_grp,
+    const struct sset *active_tunnels,
+    const struct sbrec_chassis *local_chassis)
+{
+    if (!ha_ch_grp || !ha_ch_grp->n_ha_chassis) {
+        return false;
+    }
+
+    if (ha_ch_grp->n_ha_chassis == 1) {
+        return (ha_ch_grp->ha_chassis[0]->chassis == local_chassis);
+    }
+
+    struct ha_chassis_cache_node *node = ha_chassis_cache_find(ha_ch_grp);
+    if (node && node->local_chassis == local_chassis
+        && node->active_tunnels == active_tunnels) {
+        return node->active;
+    }
+
+    bool active = ha_chassis_group_is_active__(ha_ch_grp, active_tunnels,
+                                               local_chassis);
+    if (!node) {
+        node = xmalloc(sizeof *node);
+        node->group_uuid = ha_ch_grp->header_.uuid;
+        hmap_insert(&ha_chassis_cache, &node->hmap_node,
+                    uuid_hash(&node->group_uuid));
+    }
+    node->local_chassis = local_chassis;
+    node->active_tunnels = active_tunnels;
+    node->active = active;
+
+    return active;
+}
+
 bool
 ha_chassis_group_contains(
     const struct sbrec_ha_chassis_group *ha_chassis_grp,
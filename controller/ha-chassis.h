@@ -47,4 +47,7 @@ struct ha_chassis_ordered *ha_chassis_get_ordered(
 void ha_chassis_destroy_ordered(
     struct ha_chassis_ordered *ordered_ha_ch);
 
+void ha_chassis_cache_flush(void);
+void ha_chassis_cache_destroy(void);
+
 #endif /* OVN_HA_CHASSIS_H */
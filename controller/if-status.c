@@ -20,7 +20,10 @@
 #include "ofctrl-seqno.h"
 
 #include "lib/hmapx.h"
+#include "lib/timeval.h"
 #include "lib/util.h"
+#include "openvswitch/dynamic-string.h"
+#include "openvswitch/poll-loop.h"
 #include "openvswitch/vlog.h"
 
 VLOG_DEFINE_THIS_MODULE(if_status);
@@ -48,6 +51,14 @@ VLOG_DEFINE_THIS_MODULE(if_status);
  * C. At every iteration, based on ofctrl_seqno updates, handled in
  *    if_status_mgr_run():
  * - the flows for a previously claimed interface have been installed in OVS.
+ *
+ * The interfaces that have to be marked "up" or "down" are grouped in
+ * batches: an interface that enters OIF_MARK_UP or OIF_MARK_DOWN joins the
+ * open batch, if any, or opens a new one that is flushed to the binding
+ * module 'flush_interval' ms later.  This way, a burst of new interfaces
+ * results in a few large SB and OVS transactions instead of one per
+ * iteration.  With the default interval of 0, interfaces are marked as soon
+ * as possible.
  */
 
 enum if_state {
@@ -76,6 +87,27 @@ static const char *if_state_names[] = {
     [OIF_INSTALLED]     = "INSTALLED",
 };
 
+/* Stages of the timeline of a claimed interface, from the claim to it being
+ * marked "up". */
+enum if_stage {
+    IF_STAGE_CLAIMED,       /* Claimed by the binding module. */
+    IF_STAGE_COMPUTED,      /* Flows computed, seqno requested. */
+    IF_STAGE_SENT,          /* Flows sent to OVS. */
+    IF_STAGE_ACKED,         /* Barrier for the flows acked by OVS. */
+    IF_STAGE_UP_WRITTEN,    /* "up" written to the SB and OVS databases. */
+    IF_STAGE_UP,            /* "up" confirmed by the databases. */
+    IF_STAGE_MAX,
+};
+
+static const char *if_stage_names[] = {
+    [IF_STAGE_CLAIMED]    = "claimed",
+    [IF_STAGE_COMPUTED]   = "computed",
+    [IF_STAGE_SENT]       = "sent",
+    [IF_STAGE_ACKED]      = "acked",
+    [IF_STAGE_UP_WRITTEN] = "up-written",
+    [IF_STAGE_UP]         = "up",
+};
+
 struct ovs_iface {
     char *id;               /* Extracted from OVS external_ids.iface_id. */
     enum if_state state;    /* State of the interface in the state machine. */
@@ -83,6 +115,47 @@ struct ovs_iface {
                              * be fully programmed in OVS.  Only used in state
                              * OIF_INSTALL_FLOWS.
                              */
+    long long int flush_time;   /* Time at which the interface is marked "up"
+                                 * or "down".  Only used in states OIF_MARK_UP
+                                 * and OIF_MARK_DOWN.
+                                 */
+    long long int stage_time[IF_STAGE_MAX]; /* Timeline of the last claim,
+                                             * in ms, 0 if not reached. */
+};
+
+/* Number of buckets of the latency histograms.  Bucket 0 counts the
+ * latencies below 1 ms, bucket 'i' those between 2**(i - 1) and 2**i ms, and
+ * the last bucket all the longer ones. */
+#define IF_STATUS_HIST_LEN 16
+
+struct if_status_latency {
+    uint64_t n;
+    uint64_t total_msec;
+    uint64_t max_msec;
+    uint64_t hist[IF_STATUS_HIST_LEN];
+};
+
+/* Latency 'i', for 'i' > 0, is the time from stage 'i' - 1 to stage 'i' of
+ * the timeline.  Latency 0 is the time from the claim to "up". */
+#define IF_LAT_CLAIM_TO_UP 0
+#define IF_LAT_MAX IF_STAGE_MAX
+
+static const char *if_status_latency_names[] = {
+    [IF_LAT_CLAIM_TO_UP]  = "claim to up",
+    [IF_STAGE_COMPUTED]   = "claim to flows computed",
+    [IF_STAGE_SENT]       = "flows computed to sent",
+    [IF_STAGE_ACKED]      = "flows sent to acked",
+    [IF_STAGE_UP_WRITTEN] = "flows acked to up written",
+    [IF_STAGE_UP]         = "up written to up",
+};
+
+/* Number of timelines of interfaces that were marked "up" kept for
+ * if-status-mgr/show-timeline. */
+#define IF_STATUS_HISTORY 64
+
+struct if_status_timeline {
+    char *id;
+    long long int stage_time[IF_STAGE_MAX];
 };
 
 /* State machine manager for all local OVS interfaces. */
@@ -100,6 +173,18 @@ struct if_status_mgr {
      * interfaces have been installed.
      */
     uint32_t iface_seqno;
+
+    /* Batching of the "up" and "down" notifications, see above. */
+    long long int flush_interval;   /* In ms. */
+    long long int batch_flush_time; /* Flush time of the open batch, or
+                                     * LLONG_MIN if there is none. */
+    uint64_t n_batches;             /* Batches opened. */
+
+    struct if_status_latency latency[IF_LAT_MAX];
+
+    /* Ring buffer of the timelines of the last interfaces marked "up". */
+    struct if_status_timeline history[IF_STATUS_HISTORY];
+    uint64_t n_history;
 };
 
 static struct ovs_iface *ovs_iface_create(struct if_status_mgr *,
@@ -123,9 +208,19 @@ if_status_mgr_create(void)
         hmapx_init(&mgr->ifaces_per_state[i]);
     }
     shash_init(&mgr->ifaces);
+    mgr->batch_flush_time = LLONG_MIN;
     return mgr;
 }
 
+/* Sets the time, in ms, for which the "up" and "down" notifications of the
+ * interfaces are batched.  0 disables batching. */
+void
+if_status_mgr_set_flush_interval(struct if_status_mgr *mgr,
+                                 unsigned int flush_interval)
+{
+    mgr->flush_interval = flush_interval;
+}
+
 void
 if_status_mgr_clear(struct if_status_mgr *mgr)
 {
@@ -146,6 +241,9 @@ void
 if_status_mgr_destroy(struct if_status_mgr *mgr)
 {
     if_status_mgr_clear(mgr);
+    for (size_t i = 0; i < IF_STATUS_HISTORY; i++) {
+        free(mgr->history[i].id);
+    }
     shash_destroy(&mgr->ifaces);
     for (size_t i = 0; i < ARRAY_SIZE(mgr->ifaces_per_state); i++) {
         hmapx_destroy(&mgr->ifaces_per_state[i]);
@@ -290,6 +388,7 @@ if_status_mgr_update(struct if_status_mgr *mgr,
 
         ovs_iface_set_state(mgr, iface, OIF_INSTALL_FLOWS);
         iface->install_seqno = mgr->iface_seqno + 1;
+        iface->stage_time[IF_STAGE_COMPUTED] = time_msec();
         new_ifaces = true;
     }
 
@@ -321,11 +420,14 @@ if_status_mgr_run(struct if_status_mgr *mgr,
     HMAPX_FOR_EACH_SAFE (node, node_next,
                          &mgr->ifaces_per_state[OIF_INSTALL_FLOWS]) {
         struct ovs_iface *iface = node->data;
+        const struct ofctrl_ack_seqno *ack
+            = ofctrl_acked_seqnos_find(acked_seqnos, iface->install_seqno);
 
-        if (!ofctrl_acked_seqnos_contains(acked_seqnos,
-                                          iface->install_seqno)) {
+        if (!ack) {
             continue;
         }
+        iface->stage_time[IF_STAGE_SENT] = ack->sent_time;
+        iface->stage_time[IF_STAGE_ACKED] = ack->ack_time;
         ovs_iface_set_state(mgr, iface, OIF_MARK_UP);
     }
     ofctrl_acked_seqnos_destroy(acked_seqnos);
@@ -359,6 +461,79 @@ ovs_iface_destroy(struct if_status_mgr *mgr, struct ovs_iface *iface)
     free(iface);
 }
 
+static void
+if_status_latency_format(const struct if_status_latency *lat, struct ds *s)
+{
+    ds_put_format(s, "count %"PRIu64", total %"PRIu64" ms, max %"PRIu64" ms",
+                  lat->n, lat->total_msec, lat->max_msec);
+    for (size_t i = 0; i < IF_STATUS_HIST_LEN; i++) {
+        if (!lat->hist[i]) {
+            continue;
+        }
+        if (i == IF_STATUS_HIST_LEN - 1) {
+            ds_put_format(s, ", >=%u ms: %"PRIu64, 1u << (i - 1),
+                          lat->hist[i]);
+        } else {
+            ds_put_format(s, ", <%u ms: %"PRIu64, 1u << i, lat->hist[i]);
+        }
+    }
+}
+
+static void
+if_status_latency_record(struct if_status_mgr *mgr,
+                         size_t type, long long int start,
+                         long long int now)
+{
+    struct if_status_latency *lat = &mgr->latency[type];
+    uint64_t msec = MAX(now - start, 0);
+    size_t bucket = msec ? MIN(log_2_floor(msec) + 1,
+                               IF_STATUS_HIST_LEN - 1) : 0;
+
+    lat->n++;
+    lat->total_msec += msec;
+    lat->max_msec = MAX(lat->max_msec, msec);
+    lat->hist[bucket]++;
+}
+
+/* Records the latencies of the timeline of 'iface', which was just marked
+ * "up", and keeps the timeline in the history. */
+static void
+if_status_mgr_record_timeline(struct if_status_mgr *mgr,
+                              const struct ovs_iface *iface)
+{
+    const long long int *t = iface->stage_time;
+
+    if (t[IF_STAGE_CLAIMED]) {
+        if_status_latency_record(mgr, IF_LAT_CLAIM_TO_UP,
+                                 t[IF_STAGE_CLAIMED], t[IF_STAGE_UP]);
+    }
+    for (size_t i = IF_STAGE_CLAIMED + 1; i < IF_STAGE_MAX; i++) {
+        if (t[i - 1] && t[i]) {
+            if_status_latency_record(mgr, i, t[i - 1], t[i]);
+        }
+    }
+
+    struct if_status_timeline *tl
+        = &mgr->history[mgr->n_history++ % IF_STATUS_HISTORY];
+    free(tl->id);
+    tl->id = xstrdup(iface->id);
+    memcpy(tl->stage_time, t, sizeof tl->stage_time);
+}
+
+/* Returns the time at which an interface that has to be marked "up" or
+ * "down" now should be flushed to the binding module. */
+static long long int
+if_status_mgr_batch_flush_time(struct if_status_mgr *mgr, long long int now)
+{
+    if (mgr->batch_flush_time <= now) {
+        mgr->batch_flush_time = now + mgr->flush_interval;
+        if (mgr->flush_interval) {
+            mgr->n_batches++;
+        }
+    }
+    return mgr->batch_flush_time;
+}
+
 static void
 ovs_iface_set_state(struct if_status_mgr *mgr, struct ovs_iface *iface,
                     enum if_state state)
@@ -367,6 +542,28 @@ ovs_iface_set_state(struct if_status_mgr *mgr, struct ovs_iface *iface,
              if_state_names[iface->state],
              if_state_names[state]);
 
+    long long int now = time_msec();
+    switch (state) {
+    case OIF_CLAIMED:
+        memset(iface->stage_time, 0, sizeof iface->stage_time);
+        iface->stage_time[IF_STAGE_CLAIMED] = now;
+        break;
+    case OIF_MARK_UP:
+    case OIF_MARK_DOWN:
+        iface->flush_time = if_status_mgr_batch_flush_time(mgr, now);
+        break;
+    case OIF_INSTALLED:
+        if (iface->state == OIF_MARK_UP) {
+            iface->stage_time[IF_STAGE_UP] = now;
+            if_status_mgr_record_timeline(mgr, iface);
+        }
+        break;
+    case OIF_INSTALL_FLOWS:
+        break;
+    case OIF_MAX:
+        OVS_NOT_REACHED();
+    }
+
     hmapx_find_and_delete(&mgr->ifaces_per_state[iface->state], iface);
     iface->state = state;
     hmapx_add(&mgr->ifaces_per_state[iface->state], iface);
@@ -396,20 +593,121 @@ if_status_mgr_update_bindings(struct if_status_mgr *mgr,
 
     /* Notifiy the binding module to set "up" all bindings that have had
      * their flows installed but are not yet marked "up" in the binding
-     * module.
+     * module, once their batch is due.
      */
+    long long int now = time_msec();
     HMAPX_FOR_EACH (node, &mgr->ifaces_per_state[OIF_MARK_UP]) {
         struct ovs_iface *iface = node->data;
 
-        local_binding_set_up(bindings, iface->id, sb_readonly, ovs_readonly);
+        if (iface->flush_time <= now) {
+            local_binding_set_up(bindings, iface->id, sb_readonly,
+                                 ovs_readonly);
+            if (!sb_readonly && !ovs_readonly
+                && !iface->stage_time[IF_STAGE_UP_WRITTEN]) {
+                iface->stage_time[IF_STAGE_UP_WRITTEN] = now;
+            }
+        }
     }
 
     /* Notify the binding module to set "down" all bindings that have been
-     * released but are not yet marked as "down" in the binding module.
+     * released but are not yet marked as "down" in the binding module, once
+     * their batch is due.
      */
     HMAPX_FOR_EACH (node, &mgr->ifaces_per_state[OIF_MARK_DOWN]) {
         struct ovs_iface *iface = node->data;
 
-        local_binding_set_down(bindings, iface->id, sb_readonly, ovs_readonly);
+        if (iface->flush_time <= now) {
+            local_binding_set_down(bindings, iface->id, sb_readonly,
+                                   ovs_readonly);
+        }
+    }
+
+    /* Wake up to flush the open batch. */
+    if (mgr->batch_flush_time > now) {
+        poll_timer_wait_until(mgr->batch_flush_time);
+    }
+}
+
+void
+if_status_mgr_get_stats(const struct if_status_mgr *mgr, struct ds *s)
+{
+    for (size_t i = 0; i < OIF_MAX; i++) {
+        ds_put_format(s, "%-13s: %"PRIuSIZE"\n", if_state_names[i],
+                      hmapx_count(&mgr->ifaces_per_state[i]));
+    }
+    ds_put_format(s, "Flush interval: %lld ms\n", mgr->flush_interval);
+    ds_put_format(s, "Batches: %"PRIu64"\n", mgr->n_batches);
+
+    for (size_t i = 0; i < IF_LAT_MAX; i++) {
+        ds_put_format(s, "Latency %s: ", if_status_latency_names[i]);
+        if_status_latency_format(&mgr->latency[i], s);
+        ds_put_char(s, '\n');
+    }
+}
+
+/* Formats the histogram of the latencies from the claim of the interfaces to
+ * them being marked "up" into 's'. */
+void
+if_status_mgr_format_up_latency(const struct if_status_mgr *mgr,
+                                struct ds *s)
+{
+    if_status_latency_format(&mgr->latency[IF_LAT_CLAIM_TO_UP], s);
+}
+
+static void
+if_status_timeline_format(const char *id, const long long int *stage_time,
+                          struct ds *s)
+{
+    long long int start = stage_time[IF_STAGE_CLAIMED];
+
+    ds_put_format(s, "%s:", id);
+    for (size_t i = 0; i < IF_STAGE_MAX; i++) {
+        if (stage_time[i]) {
+            ds_put_format(s, " %s +%lld ms", if_stage_names[i],
+                          stage_time[i] - start);
+        }
+    }
+}
+
+/* Formats into 's' the timelines of the interfaces that are not marked "up"
+ * yet, then those of the last interfaces that were, oldest first. */
+void
+if_status_mgr_get_timelines(const struct if_status_mgr *mgr, struct ds *s)
+{
+    ds_put_cstr(s, "In progress:\n");
+    for (size_t i = OIF_CLAIMED; i <= OIF_MARK_UP; i++) {
+        struct hmapx_node *node;
+
+        HMAPX_FOR_EACH (node, &mgr->ifaces_per_state[i]) {
+            const struct ovs_iface *iface = node->data;
+
+            ds_put_cstr(s, "  ");
+            if_status_timeline_format(iface->id, iface->stage_time, s);
+            ds_put_format(s, " (%s)\n", if_state_names[iface->state]);
+        }
+    }
+
+    ds_put_cstr(s, "Up:\n");
+    uint64_t first = (mgr->n_history > IF_STATUS_HISTORY
+                      ? mgr->n_history - IF_STATUS_HISTORY : 0);
+    for (uint64_t i = first; i < mgr->n_history; i++) {
+        const struct if_status_timeline *tl
+            = &mgr->history[i % IF_STATUS_HISTORY];
+
+        ds_put_cstr(s, "  ");
+        if_status_timeline_format(tl->id, tl->stage_time, s);
+        ds_put_char(s, '\n');
+    }
+}
+
+void
+if_status_mgr_clear_stats(struct if_status_mgr *mgr)
+{
+    memset(mgr->latency, 0, sizeof mgr->latency);
+    mgr->n_batches = 0;
+    for (size_t i = 0; i < IF_STATUS_HISTORY; i++) {
+        free(mgr->history[i].id);
+        mgr->history[i].id = NULL;
     }
+    mgr->n_history = 0;
 }
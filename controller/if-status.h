@@ -20,11 +20,14 @@
 
 #include "binding.h"
 
+struct ds;
 struct if_status_mgr;
 
 struct if_status_mgr *if_status_mgr_create(void);
 void if_status_mgr_clear(struct if_status_mgr *);
 void if_status_mgr_destroy(struct if_status_mgr *);
+void if_status_mgr_set_flush_interval(struct if_status_mgr *,
+                                      unsigned int flush_interval);
 
 void if_status_mgr_claim_iface(struct if_status_mgr *, const char *iface_id);
 void if_status_mgr_release_iface(struct if_status_mgr *, const char *iface_id);
@@ -34,4 +37,10 @@ void if_status_mgr_update(struct if_status_mgr *, struct local_binding_data *);
 void if_status_mgr_run(struct if_status_mgr *mgr, struct local_binding_data *,
                        bool sb_readonly, bool ovs_readonly);
 
+void if_status_mgr_get_stats(const struct if_status_mgr *, struct ds *);
+void if_status_mgr_clear_stats(struct if_status_mgr *);
+void if_status_mgr_get_timelines(const struct if_status_mgr *, struct ds *);
+void if_status_mgr_format_up_latency(const struct if_status_mgr *,
+                                     struct ds *);
+
 # endif /* controller/if-status.h */
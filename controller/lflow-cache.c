@@ -17,19 +17,30 @@
 
 #include <config.h>
 
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #if HAVE_DECL_MALLOC_TRIM
 #include <malloc.h>
 #endif
 
 #include "coverage.h"
 #include "lflow-cache.h"
+#include "lib/ovn-util.h"
 #include "lib/uuid.h"
+#include "openvswitch/list.h"
+#include "openvswitch/vlog.h"
 #include "ovn/expr.h"
+#include "util.h"
+
+VLOG_DEFINE_THIS_MODULE(lflow_cache);
 
 COVERAGE_DEFINE(lflow_cache_flush);
 COVERAGE_DEFINE(lflow_cache_add_conj_id);
 COVERAGE_DEFINE(lflow_cache_add_expr);
 COVERAGE_DEFINE(lflow_cache_add_matches);
+COVERAGE_DEFINE(lflow_cache_add_cond_matches);
+COVERAGE_DEFINE(lflow_cache_cond_matches_hit);
 COVERAGE_DEFINE(lflow_cache_free_conj_id);
 COVERAGE_DEFINE(lflow_cache_free_expr);
 COVERAGE_DEFINE(lflow_cache_free_matches);
@@ -47,8 +58,17 @@ static const char *lflow_cache_type_names[LCACHE_T_MAX] = {
     [LCACHE_T_MATCHES] = "cache-matches",
 };
 
+struct lflow_cache_type_stats {
+    uint64_t n_hits;
+    uint64_t n_evictions;
+    uint64_t mem_usage;
+};
+
 struct lflow_cache {
     struct hmap entries[LCACHE_T_MAX];
+    struct ovs_list lru[LCACHE_T_MAX];  /* Least recently used entry first. */
+    struct lflow_cache_type_stats stats[LCACHE_T_MAX];
+    uint64_t n_misses;
     uint32_t capacity;
     uint64_t mem_usage;
     uint64_t max_mem_usage;
@@ -57,6 +77,7 @@ struct lflow_cache {
 
 struct lflow_cache_entry {
     struct hmap_node node;
+    struct ovs_list lru_node; /* In 'lru' of the entry's type. */
     struct uuid lflow_uuid; /* key */
     size_t size;
 
@@ -64,6 +85,8 @@ struct lflow_cache_entry {
 };
 
 static size_t lflow_cache_n_entries__(const struct lflow_cache *lc);
+static struct lflow_cache_entry *lflow_cache_find__(
+    const struct lflow_cache *lc, const struct uuid *lflow_uuid);
 static bool lflow_cache_make_room__(struct lflow_cache *lc,
                                     enum lflow_cache_type type);
 static struct lflow_cache_value *lflow_cache_add__(
@@ -71,6 +94,12 @@ static struct lflow_cache_value *lflow_cache_add__(
     enum lflow_cache_type type, uint64_t value_size);
 static void lflow_cache_delete__(struct lflow_cache *lc,
                                  struct lflow_cache_entry *lce);
+static void lflow_cache_free_cond_matches__(
+    struct lflow_cache *lc, struct lflow_cache_entry *lce,
+    struct lflow_cache_cond_matches *cm);
+static bool lflow_cache_read_matches__(FILE *, off_t file_size,
+                                       uint32_t n_matches,
+                                       struct hmap *matches);
 
 struct lflow_cache *
 lflow_cache_create(void)
@@ -79,10 +108,13 @@ lflow_cache_create(void)
 
     for (size_t i = 0; i < LCACHE_T_MAX; i++) {
         hmap_init(&lc->entries[i]);
+        ovs_list_init(&lc->lru[i]);
     }
+    memset(lc->stats, 0, sizeof lc->stats);
 
     lc->enabled = true;
     lc->mem_usage = 0;
+    lc->n_misses = 0;
     return lc;
 }
 
@@ -171,6 +203,24 @@ lflow_cache_get_stats(const struct lflow_cache *lc, struct ds *output)
     }
     ds_put_format(output, "%-16s: %"PRIu64"\n", "Mem usage (KB)",
                   ROUND_UP(lc->mem_usage, 1024) / 1024);
+
+    uint64_t n_hits = 0;
+    for (size_t i = 0; i < LCACHE_T_MAX; i++) {
+        n_hits += lc->stats[i].n_hits;
+    }
+    ds_put_format(output, "%-16s: hits %"PRIu64", misses %"PRIu64"\n",
+                  "Lookups", n_hits, lc->n_misses);
+    for (size_t i = 0; i < LCACHE_T_MAX; i++) {
+        const struct lflow_cache_type_stats *stats = &lc->stats[i];
+
+        /* Skip the "cache-" prefix so that the lines with the number of
+         * entries are the only ones that match the full type names. */
+        ds_put_format(output, "%-16s: hits %"PRIu64", evictions %"PRIu64", "
+                      "mem (KB) %"PRIu64"\n",
+                      lflow_cache_type_names[i] + strlen("cache-"),
+                      stats->n_hits, stats->n_evictions,
+                      ROUND_UP(stats->mem_usage, 1024) / 1024);
+    }
 }
 
 void
@@ -219,6 +269,80 @@ lflow_cache_add_matches(struct lflow_cache *lc, const struct uuid *lflow_uuid,
     lcv->expr_matches = matches;
 }
 
+/* Adds to the LCACHE_T_EXPR entry of 'lflow_uuid' the 'matches' of its
+ * expression for the residency state 'cond_state', replacing the matches
+ * already cached for that state or, if there are already
+ * LCACHE_N_COND_MATCHES states, for the least recently added one.  Takes
+ * ownership of 'matches'. */
+void
+lflow_cache_add_cond_matches(struct lflow_cache *lc,
+                             const struct uuid *lflow_uuid,
+                             uint64_t cond_state, uint32_t conj_id_ofs,
+                             uint32_t n_conjs, struct hmap *matches,
+                             size_t matches_sz)
+{
+    struct lflow_cache_entry *lce
+        = lflow_uuid ? lflow_cache_find__(lc, lflow_uuid) : NULL;
+
+    if (!lce || lce->value.type != LCACHE_T_EXPR) {
+        goto error;
+    }
+
+    struct lflow_cache_cond_matches *slots = lce->value.cond_matches;
+    size_t i;
+    for (i = 0; i < LCACHE_N_COND_MATCHES - 1; i++) {
+        if (slots[i].matches && slots[i].cond_state == cond_state) {
+            break;
+        }
+    }
+    lflow_cache_free_cond_matches__(lc, lce, &slots[i]);
+    memmove(&slots[1], &slots[0], i * sizeof *slots);
+    memset(&slots[0], 0, sizeof *slots);
+
+    if (matches_sz + lc->mem_usage > lc->max_mem_usage) {
+        COVERAGE_INC(lflow_cache_mem_full);
+        goto error;
+    }
+
+    COVERAGE_INC(lflow_cache_add_cond_matches);
+    slots[0] = (struct lflow_cache_cond_matches) {
+        .cond_state = cond_state,
+        .conj_id_ofs = conj_id_ofs,
+        .n_conjs = n_conjs,
+        .matches = matches,
+        .size = matches_sz,
+    };
+    lce->size += matches_sz;
+    lc->mem_usage += matches_sz;
+    lc->stats[LCACHE_T_EXPR].mem_usage += matches_sz;
+    return;
+
+error:
+    expr_matches_destroy(matches);
+    free(matches);
+}
+
+/* Returns the matches cached in 'lcv' for the residency state 'cond_state',
+ * or NULL. */
+const struct lflow_cache_cond_matches *
+lflow_cache_find_cond_matches(const struct lflow_cache_value *lcv,
+                              uint64_t cond_state)
+{
+    if (lcv->type != LCACHE_T_EXPR) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < LCACHE_N_COND_MATCHES; i++) {
+        const struct lflow_cache_cond_matches *cm = &lcv->cond_matches[i];
+
+        if (cm->matches && cm->cond_state == cond_state) {
+            COVERAGE_INC(lflow_cache_cond_matches_hit);
+            return cm;
+        }
+    }
+    return NULL;
+}
+
 struct lflow_cache_value *
 lflow_cache_get(struct lflow_cache *lc, const struct uuid *lflow_uuid)
 {
@@ -226,20 +350,42 @@ lflow_cache_get(struct lflow_cache *lc, const struct uuid *lflow_uuid)
         return NULL;
     }
 
-    size_t hash = uuid_hash(lflow_uuid);
+    struct lflow_cache_entry *lce = lflow_cache_find__(lc, lflow_uuid);
+    if (!lce) {
+        COVERAGE_INC(lflow_cache_miss);
+        lc->n_misses++;
+        return NULL;
+    }
 
-    for (size_t i = 0; i < LCACHE_T_MAX; i++) {
-        struct lflow_cache_entry *lce;
+    COVERAGE_INC(lflow_cache_hit);
+    lc->stats[lce->value.type].n_hits++;
 
-        HMAP_FOR_EACH_WITH_HASH (lce, node, hash, &lc->entries[i]) {
-            if (uuid_equals(&lce->lflow_uuid, lflow_uuid)) {
-                COVERAGE_INC(lflow_cache_hit);
-                return &lce->value;
-            }
-        }
-    }
-    COVERAGE_INC(lflow_cache_miss);
-    return NULL;
+    /* Move the entry to the most recently used end of its list. */
+    ovs_list_remove(&lce->lru_node);
+    ovs_list_push_back(&lc->lru[lce->value.type], &lce->lru_node);
+    return &lce->value;
+}
+
+/* Returns the value cached for 'lflow_uuid', or NULL.  Unlike
+ * lflow_cache_get(), this is not accounted as a lookup and doesn't change the
+ * eviction order. */
+const struct lflow_cache_value *
+lflow_cache_peek(const struct lflow_cache *lc, const struct uuid *lflow_uuid)
+{
+    struct lflow_cache_entry *lce = lflow_cache_find__(lc, lflow_uuid);
+
+    return lce ? &lce->value : NULL;
+}
+
+/* Returns the type of the entry cached for 'lflow_uuid', or LCACHE_T_NONE,
+ * like lflow_cache_peek(). */
+enum lflow_cache_type
+lflow_cache_peek_type(const struct lflow_cache *lc,
+                      const struct uuid *lflow_uuid)
+{
+    const struct lflow_cache_value *lcv = lflow_cache_peek(lc, lflow_uuid);
+
+    return lcv ? lcv->type : LCACHE_T_NONE;
 }
 
 void
@@ -249,11 +395,10 @@ lflow_cache_delete(struct lflow_cache *lc, const struct uuid *lflow_uuid)
         return;
     }
 
-    struct lflow_cache_value *lcv = lflow_cache_get(lc, lflow_uuid);
-    if (lcv) {
+    struct lflow_cache_entry *lce = lflow_cache_find__(lc, lflow_uuid);
+    if (lce) {
         COVERAGE_INC(lflow_cache_delete);
-        lflow_cache_delete__(lc, CONTAINER_OF(lcv, struct lflow_cache_entry,
-                                              value));
+        lflow_cache_delete__(lc, lce);
     }
 }
 
@@ -268,6 +413,27 @@ lflow_cache_n_entries__(const struct lflow_cache *lc)
     return n_entries;
 }
 
+static struct lflow_cache_entry *
+lflow_cache_find__(const struct lflow_cache *lc, const struct uuid *lflow_uuid)
+{
+    if (!lflow_cache_is_enabled(lc)) {
+        return NULL;
+    }
+
+    size_t hash = uuid_hash(lflow_uuid);
+
+    for (size_t i = 0; i < LCACHE_T_MAX; i++) {
+        struct lflow_cache_entry *lce;
+
+        HMAP_FOR_EACH_WITH_HASH (lce, node, hash, &lc->entries[i]) {
+            if (uuid_equals(&lce->lflow_uuid, lflow_uuid)) {
+                return lce;
+            }
+        }
+    }
+    return NULL;
+}
+
 static bool
 lflow_cache_make_room__(struct lflow_cache *lc, enum lflow_cache_type type)
 {
@@ -277,13 +443,16 @@ lflow_cache_make_room__(struct lflow_cache *lc, enum lflow_cache_type type)
      * LCACHE_T_EXPR.  Similarly, evict entries of type LCACHE_T_CONJ_ID or
      * LCACHE_T_EXPR if there's no room to add an entry of type
      * LCACHE_T_MATCHES.
+     *
+     * Within a type, the least recently used entry is evicted.
      */
     for (size_t i = 0; i < type; i++) {
-        if (hmap_count(&lc->entries[i]) > 0) {
+        if (!ovs_list_is_empty(&lc->lru[i])) {
             struct lflow_cache_entry *lce =
-                CONTAINER_OF(hmap_first(&lc->entries[i]),
-                             struct lflow_cache_entry, node);
+                CONTAINER_OF(ovs_list_front(&lc->lru[i]),
+                             struct lflow_cache_entry, lru_node);
 
+            lc->stats[i].n_evictions++;
             lflow_cache_delete__(lc, lce);
             return true;
         }
@@ -291,6 +460,265 @@ lflow_cache_make_room__(struct lflow_cache *lc, enum lflow_cache_type type)
     return false;
 }
 
+/* Snapshots.
+ *
+ * lflow_cache_save() writes the LCACHE_T_MATCHES entries to a file that
+ * lflow_cache_load() reads back after a restart, so that the logical flows
+ * that didn't change meanwhile don't need to be translated again.  The
+ * matches are stored as they are in memory, so a snapshot is only accepted
+ * by a build with the same internal version and the same 'struct flow'
+ * layout.  Each entry is tagged with a fingerprint of the logical flow it was
+ * computed from, supplied by the caller, so that the entries of the logical
+ * flows that were modified are dropped.  It must also cover the tunnel keys
+ * that the port names of the match resolve to.  Like for any cached matches,
+ * the caller adds the references of the logical flow to the ports of the
+ * restored matches when it uses them.
+ *
+ * LCACHE_T_EXPR entries are not saved: expression trees refer to the symbol
+ * table and it's cheap enough to parse these matches again.  Neither are
+ * LCACHE_T_CONJ_ID entries, their conjunction ids are allocated again from
+ * the same hints after a restart.  The conjunction ids in the restored
+ * matches must be reserved by the caller. */
+
+#define LFLOW_CACHE_FILE_MAGIC 0x4f4c4331 /* "OLC1". */
+
+struct lflow_cache_file_header {
+    uint32_t magic;
+    uint32_t flow_wc_seq;       /* FLOW_WC_SEQ. */
+    uint32_t match_size;        /* sizeof(struct match). */
+    char version[64];           /* ovn_get_internal_version(). */
+};
+
+struct lflow_cache_file_entry {
+    struct uuid lflow_uuid;
+    uint32_t fingerprint;
+    uint32_t n_matches;
+    /* For each match: a 'struct match', a uint32_t number of conjunctions
+     * and that many 'struct cls_conjunction'. */
+};
+
+static void
+lflow_cache_file_header_init(struct lflow_cache_file_header *hdr)
+{
+    char *version = ovn_get_internal_version();
+
+    memset(hdr, 0, sizeof *hdr);
+    hdr->magic = LFLOW_CACHE_FILE_MAGIC;
+    hdr->flow_wc_seq = FLOW_WC_SEQ;
+    hdr->match_size = sizeof(struct match);
+    ovs_strlcpy(hdr->version, version, sizeof hdr->version);
+    free(version);
+}
+
+static bool
+lflow_cache_write__(FILE *file, const void *data, size_t size)
+{
+    return !size || fwrite(data, size, 1, file) == 1;
+}
+
+static bool
+lflow_cache_write_matches__(FILE *file, const struct hmap *matches)
+{
+    const struct expr_match *m;
+
+    HMAP_FOR_EACH (m, hmap_node, matches) {
+        uint32_t n_conjs = m->n;
+
+        if (!lflow_cache_write__(file, &m->match, sizeof m->match)
+            || !lflow_cache_write__(file, &n_conjs, sizeof n_conjs)
+            || !lflow_cache_write__(file, m->conjunctions,
+                                    m->n * sizeof *m->conjunctions)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Saves the cache entries of the logical flows for which 'fingerprint'
+ * returns true to 'file_name'.  The file is replaced atomically.  Returns 0
+ * if successful, otherwise a positive errno value. */
+int
+lflow_cache_save(const struct lflow_cache *lc, const char *file_name,
+                 lflow_cache_fingerprint_cb *fingerprint, const void *aux)
+{
+    if (!lflow_cache_is_enabled(lc)) {
+        return 0;
+    }
+
+    char *tmp_name = xasprintf("%s.tmp", file_name);
+    FILE *file = fopen(tmp_name, "wb");
+    if (!file) {
+        int error = errno;
+        VLOG_WARN("%s: could not create lflow cache snapshot (%s)",
+                  tmp_name, ovs_strerror(error));
+        free(tmp_name);
+        return error;
+    }
+
+    struct lflow_cache_file_header hdr;
+    lflow_cache_file_header_init(&hdr);
+    bool ok = lflow_cache_write__(file, &hdr, sizeof hdr);
+
+    const struct lflow_cache_entry *lce;
+    HMAP_FOR_EACH (lce, node, &lc->entries[LCACHE_T_MATCHES]) {
+        struct lflow_cache_file_entry entry = {
+            .lflow_uuid = lce->lflow_uuid,
+            .n_matches = hmap_count(lce->value.expr_matches),
+        };
+
+        if (!ok) {
+            break;
+        }
+        if (fingerprint(&lce->lflow_uuid, aux, &entry.fingerprint)) {
+            ok = (lflow_cache_write__(file, &entry, sizeof entry)
+                  && lflow_cache_write_matches__(file,
+                                                 lce->value.expr_matches));
+        }
+    }
+
+    int error = 0;
+    if (!ok) {
+        error = EIO;
+        fclose(file);
+    } else if (fclose(file)) {
+        error = errno;
+    } else if (rename(tmp_name, file_name)) {
+        error = errno;
+    }
+    if (error) {
+        VLOG_WARN("%s: could not save lflow cache snapshot (%s)",
+                  file_name, ovs_strerror(error));
+        unlink(tmp_name);
+    }
+    free(tmp_name);
+    return error;
+}
+
+/* Adds the entries saved by lflow_cache_save() in 'file_name' to 'lc', for
+ * the logical flows whose fingerprint hasn't changed.  A missing file is not
+ * an error.  Returns 0 if successful, otherwise a positive errno
+ * value. */
+int
+lflow_cache_load(struct lflow_cache *lc, const char *file_name,
+                 lflow_cache_fingerprint_cb *fingerprint, const void *aux)
+{
+    if (!lflow_cache_is_enabled(lc)) {
+        return 0;
+    }
+
+    FILE *file = fopen(file_name, "rb");
+    if (!file) {
+        int error = errno;
+        if (error == ENOENT) {
+            return 0;
+        }
+        VLOG_WARN("%s: could not open lflow cache snapshot (%s)",
+                  file_name, ovs_strerror(error));
+        return error;
+    }
+
+    struct stat s;
+    if (fstat(fileno(file), &s)) {
+        int error = errno;
+        VLOG_WARN("%s: could not stat lflow cache snapshot (%s)",
+                  file_name, ovs_strerror(error));
+        fclose(file);
+        return error;
+    }
+
+    struct lflow_cache_file_header expected, hdr;
+    lflow_cache_file_header_init(&expected);
+    if (fread(&hdr, sizeof hdr, 1, file) != 1
+        || hdr.magic != expected.magic
+        || hdr.flow_wc_seq != expected.flow_wc_seq
+        || hdr.match_size != expected.match_size
+        || strncmp(hdr.version, expected.version, sizeof hdr.version)) {
+        VLOG_INFO("%s: ignoring lflow cache snapshot from a different "
+                  "version", file_name);
+        fclose(file);
+        return 0;
+    }
+
+    size_t n_loaded = 0, n_stale = 0;
+    struct lflow_cache_file_entry entry;
+    int error = 0;
+    while (fread(&entry, sizeof entry, 1, file) == 1) {
+        struct hmap *matches = xmalloc(sizeof *matches);
+
+        if (!lflow_cache_read_matches__(file, s.st_size, entry.n_matches,
+                                        matches)) {
+            free(matches);
+            error = EINVAL;
+            break;
+        }
+
+        uint32_t current;
+        if (!fingerprint(&entry.lflow_uuid, aux, &current)
+            || current != entry.fingerprint
+            || lflow_cache_find__(lc, &entry.lflow_uuid)) {
+            n_stale++;
+            expr_matches_destroy(matches);
+            free(matches);
+            continue;
+        }
+
+        n_loaded++;
+        lflow_cache_add_matches(lc, &entry.lflow_uuid, matches,
+                                expr_matches_prepare(matches, 0));
+    }
+    if (!error && ferror(file)) {
+        error = EIO;
+    }
+    fclose(file);
+
+    if (error) {
+        VLOG_WARN("%s: lflow cache snapshot is corrupted (%s), loaded "
+                  "%"PRIuSIZE" entries", file_name, ovs_strerror(error),
+                  n_loaded);
+    } else {
+        VLOG_INFO("%s: loaded %"PRIuSIZE" lflow cache entries, skipped "
+                  "%"PRIuSIZE" stale ones", file_name, n_loaded, n_stale);
+    }
+    return error;
+}
+
+/* Reads 'n_matches' matches written by lflow_cache_save() from 'file' into
+ * 'matches', which is initialized.  Returns false, leaving 'matches'
+ * destroyed, if the file is truncated or malformed. */
+static bool
+lflow_cache_read_matches__(FILE *file, off_t file_size, uint32_t n_matches,
+                           struct hmap *matches)
+{
+    hmap_init(matches);
+    for (uint32_t i = 0; i < n_matches; i++) {
+        struct expr_match *m = xzalloc(sizeof *m);
+        uint32_t n_conjs;
+
+        if (fread(&m->match, sizeof m->match, 1, file) != 1
+            || fread(&n_conjs, sizeof n_conjs, 1, file) != 1
+            || n_conjs > file_size / sizeof *m->conjunctions) {
+            free(m);
+            goto error;
+        }
+        if (n_conjs) {
+            m->conjunctions = xmalloc(n_conjs * sizeof *m->conjunctions);
+            m->n = m->allocated = n_conjs;
+            if (fread(m->conjunctions, n_conjs * sizeof *m->conjunctions, 1,
+                      file) != 1) {
+                free(m->conjunctions);
+                free(m);
+                goto error;
+            }
+        }
+        hmap_insert(matches, &m->hmap_node, match_hash(&m->match, 0));
+    }
+    return true;
+
+error:
+    expr_matches_destroy(matches);
+    return false;
+}
+
 void
 lflow_cache_get_memory_usage(const struct lflow_cache *lc, struct simap *usage)
 {
@@ -329,6 +757,7 @@ lflow_cache_add__(struct lflow_cache *lc, const struct uuid *lflow_uuid,
     }
 
     lc->mem_usage += size;
+    lc->stats[type].mem_usage += size;
 
     COVERAGE_INC(lflow_cache_add);
     lce = xzalloc(sizeof *lce);
@@ -336,6 +765,7 @@ lflow_cache_add__(struct lflow_cache *lc, const struct uuid *lflow_uuid,
     lce->size = size;
     lce->value.type = type;
     hmap_insert(&lc->entries[type], &lce->node, uuid_hash(lflow_uuid));
+    ovs_list_push_back(&lc->lru[type], &lce->lru_node);
     return &lce->value;
 }
 
@@ -347,6 +777,7 @@ lflow_cache_delete__(struct lflow_cache *lc, struct lflow_cache_entry *lce)
     }
 
     hmap_remove(&lc->entries[lce->value.type], &lce->node);
+    ovs_list_remove(&lce->lru_node);
     switch (lce->value.type) {
     case LCACHE_T_NONE:
         OVS_NOT_REACHED();
@@ -357,6 +788,10 @@ lflow_cache_delete__(struct lflow_cache *lc, struct lflow_cache_entry *lce)
     case LCACHE_T_EXPR:
         COVERAGE_INC(lflow_cache_free_expr);
         expr_destroy(lce->value.expr);
+        for (size_t i = 0; i < LCACHE_N_COND_MATCHES; i++) {
+            lflow_cache_free_cond_matches__(lc, lce,
+                                            &lce->value.cond_matches[i]);
+        }
         break;
     case LCACHE_T_MATCHES:
         COVERAGE_INC(lflow_cache_free_matches);
@@ -367,5 +802,23 @@ lflow_cache_delete__(struct lflow_cache *lc, struct lflow_cache_entry *lce)
 
     ovs_assert(lc->mem_usage >= lce->size);
     lc->mem_usage -= lce->size;
+    lc->stats[lce->value.type].mem_usage -= lce->size;
     free(lce);
 }
+
+static void
+lflow_cache_free_cond_matches__(struct lflow_cache *lc,
+                                struct lflow_cache_entry *lce,
+                                struct lflow_cache_cond_matches *cm)
+{
+    if (!cm->matches) {
+        return;
+    }
+
+    expr_matches_destroy(cm->matches);
+    free(cm->matches);
+    lce->size -= cm->size;
+    lc->mem_usage -= cm->size;
+    lc->stats[LCACHE_T_EXPR].mem_usage -= cm->size;
+    memset(cm, 0, sizeof *cm);
+}
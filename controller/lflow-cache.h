@@ -32,7 +32,8 @@ struct lflow_cache;
  *  - Caches
  *     (1) Conjunction ID offset if the logical flow has port group/address
  *         set references.
- *     (2) expr tree if the logical flow has is_chassis_resident() match.
+ *     (2) expr tree if the logical flow has is_chassis_resident() match,
+ *         along with its matches for the last residency states.
  *     (3) expr matches if (1) and (2) are false.
  */
 enum lflow_cache_type {
@@ -43,6 +44,21 @@ enum lflow_cache_type {
     LCACHE_T_NONE = LCACHE_T_MAX, /* Not found in cache. */
 };
 
+/* The matches of an LCACHE_T_EXPR entry for a given residency state of the
+ * ports in its is_chassis_resident() conditions, see
+ * expr_get_condition_state(). */
+struct lflow_cache_cond_matches {
+    uint64_t cond_state;
+    uint32_t conj_id_ofs;
+    uint32_t n_conjs;
+    struct hmap *matches;       /* NULL if the slot is unused. */
+    size_t size;
+};
+
+/* Most logical flows with is_chassis_resident() conditions switch between
+ * two states, when a gateway port fails over and back. */
+#define LCACHE_N_COND_MATCHES 2
+
 struct lflow_cache_value {
     enum lflow_cache_type type;
     uint32_t conj_id_ofs;
@@ -51,6 +67,9 @@ struct lflow_cache_value {
         struct hmap *expr_matches;
         struct expr *expr;
     };
+
+    /* LCACHE_T_EXPR only, most recently added first. */
+    struct lflow_cache_cond_matches cond_matches[LCACHE_N_COND_MATCHES];
 };
 
 struct lflow_cache *lflow_cache_create(void);
@@ -70,12 +89,35 @@ void lflow_cache_add_expr(struct lflow_cache *, const struct uuid *lflow_uuid,
 void lflow_cache_add_matches(struct lflow_cache *,
                              const struct uuid *lflow_uuid,
                              struct hmap *matches, size_t matches_sz);
+void lflow_cache_add_cond_matches(struct lflow_cache *,
+                                  const struct uuid *lflow_uuid,
+                                  uint64_t cond_state, uint32_t conj_id_ofs,
+                                  uint32_t n_conjs, struct hmap *matches,
+                                  size_t matches_sz);
+const struct lflow_cache_cond_matches *lflow_cache_find_cond_matches(
+    const struct lflow_cache_value *, uint64_t cond_state);
 
 struct lflow_cache_value *lflow_cache_get(struct lflow_cache *,
                                           const struct uuid *lflow_uuid);
+const struct lflow_cache_value *lflow_cache_peek(
+    const struct lflow_cache *, const struct uuid *lflow_uuid);
+enum lflow_cache_type lflow_cache_peek_type(const struct lflow_cache *,
+                                            const struct uuid *lflow_uuid);
 void lflow_cache_delete(struct lflow_cache *, const struct uuid *lflow_uuid);
 
 void lflow_cache_get_memory_usage(const struct lflow_cache *,
                                   struct simap *usage);
 
+/* Stores in '*fingerprint' a hash of the contents of the logical flow
+ * 'lflow_uuid' that its cache entry depends on, and returns true, or returns
+ * false if there's no such logical flow. */
+typedef bool lflow_cache_fingerprint_cb(const struct uuid *lflow_uuid,
+                                        const void *aux,
+                                        uint32_t *fingerprint);
+
+int lflow_cache_save(const struct lflow_cache *, const char *file_name,
+                     lflow_cache_fingerprint_cb *, const void *aux);
+int lflow_cache_load(struct lflow_cache *, const char *file_name,
+                     lflow_cache_fingerprint_cb *, const void *aux);
+
 #endif /* controller/lflow-cache.h */
@@ -0,0 +1,298 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+
+#include "coverage.h"
+#include "hash.h"
+#include "lflow-conj-ids.h"
+#include "lib/uuid.h"
+#include "util.h"
+
+COVERAGE_DEFINE(lflow_conj_ids_alloc);
+COVERAGE_DEFINE(lflow_conj_ids_collision);
+COVERAGE_DEFINE(lflow_conj_ids_free);
+
+/* The conjunction ids allocated to a logical flow, in
+ * struct lflow_conj_ids's 'lflows'. */
+struct lflow_conj_id_range {
+    struct hmap_node node;      /* Hashed on 'lflow_uuid'. */
+    struct uuid lflow_uuid;
+    uint32_t conj_id_ofs;
+    uint32_t n_conjs;
+};
+
+/* A conjunction id in use, in struct lflow_conj_ids's 'ids'. */
+struct lflow_conj_id {
+    struct hmap_node node;      /* Hashed on 'id'. */
+    uint32_t id;
+};
+
+static void lflow_conj_ids_free__(struct lflow_conj_ids *,
+                                  struct lflow_conj_id_range *);
+
+void
+lflow_conj_ids_init(struct lflow_conj_ids *conj_ids)
+{
+    hmap_init(&conj_ids->lflows);
+    hmap_init(&conj_ids->ids);
+}
+
+void
+lflow_conj_ids_destroy(struct lflow_conj_ids *conj_ids)
+{
+    lflow_conj_ids_clear(conj_ids);
+    hmap_destroy(&conj_ids->lflows);
+    hmap_destroy(&conj_ids->ids);
+}
+
+void
+lflow_conj_ids_clear(struct lflow_conj_ids *conj_ids)
+{
+    struct lflow_conj_id_range *range, *next;
+
+    HMAP_FOR_EACH_SAFE (range, next, node, &conj_ids->lflows) {
+        lflow_conj_ids_free__(conj_ids, range);
+    }
+}
+
+static struct lflow_conj_id_range *
+lflow_conj_id_range_find(const struct lflow_conj_ids *conj_ids,
+                         const struct uuid *lflow_uuid)
+{
+    struct lflow_conj_id_range *range;
+
+    HMAP_FOR_EACH_WITH_HASH (range, node, uuid_hash(lflow_uuid),
+                             &conj_ids->lflows) {
+        if (uuid_equals(&range->lflow_uuid, lflow_uuid)) {
+            return range;
+        }
+    }
+    return NULL;
+}
+
+static bool
+lflow_conj_id_in_use(const struct lflow_conj_ids *conj_ids, uint32_t id)
+{
+    const struct lflow_conj_id *conj_id;
+
+    HMAP_FOR_EACH_WITH_HASH (conj_id, node, hash_int(id, 0), &conj_ids->ids) {
+        if (conj_id->id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Returns true if ids 'ofs' + 1 to 'ofs' + 'n' are all free.  Otherwise,
+ * stores the highest id of the range that is in use in '*conflict'. */
+static bool
+lflow_conj_ids_are_free(const struct lflow_conj_ids *conj_ids, uint32_t ofs,
+                        uint32_t n, uint32_t *conflict)
+{
+    for (uint32_t i = n; i > 0; i--) {
+        if (lflow_conj_id_in_use(conj_ids, ofs + i)) {
+            *conflict = ofs + i;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+lflow_conj_ids_mark(struct lflow_conj_ids *conj_ids, uint32_t ofs, uint32_t n)
+{
+    for (uint32_t i = 1; i <= n; i++) {
+        struct lflow_conj_id *conj_id = xmalloc(sizeof *conj_id);
+
+        conj_id->id = ofs + i;
+        hmap_insert(&conj_ids->ids, &conj_id->node, hash_int(conj_id->id, 0));
+    }
+}
+
+static void
+lflow_conj_ids_unmark(struct lflow_conj_ids *conj_ids, uint32_t ofs,
+                      uint32_t n)
+{
+    for (uint32_t i = 1; i <= n; i++) {
+        struct lflow_conj_id *conj_id;
+
+        HMAP_FOR_EACH_WITH_HASH (conj_id, node, hash_int(ofs + i, 0),
+                                 &conj_ids->ids) {
+            if (conj_id->id == ofs + i) {
+                hmap_remove(&conj_ids->ids, &conj_id->node);
+                free(conj_id);
+                break;
+            }
+        }
+    }
+}
+
+static void
+lflow_conj_id_range_add(struct lflow_conj_ids *conj_ids,
+                        const struct uuid *lflow_uuid, uint32_t conj_id_ofs,
+                        uint32_t n_conjs)
+{
+    struct lflow_conj_id_range *range = xmalloc(sizeof *range);
+
+    range->lflow_uuid = *lflow_uuid;
+    range->conj_id_ofs = conj_id_ofs;
+    range->n_conjs = n_conjs;
+    hmap_insert(&conj_ids->lflows, &range->node, uuid_hash(lflow_uuid));
+    lflow_conj_ids_mark(conj_ids, conj_id_ofs, n_conjs);
+}
+
+/* Stores in '*conj_id_ofs' the offset of 'n_conjs' conjunction ids for the
+ * logical flow 'lflow_uuid'.  If the logical flow already has at least
+ * 'n_conjs' ids, they are kept.  Returns false if the ids are exhausted. */
+bool
+lflow_conj_ids_alloc(struct lflow_conj_ids *conj_ids,
+                     const struct uuid *lflow_uuid, uint32_t n_conjs,
+                     uint32_t *conj_id_ofs)
+{
+    struct lflow_conj_id_range *range
+        = lflow_conj_id_range_find(conj_ids, lflow_uuid);
+    uint32_t conflict;
+
+    if (range) {
+        if (n_conjs <= range->n_conjs) {
+            *conj_id_ofs = range->conj_id_ofs;
+            return true;
+        }
+
+        /* Grow the range in place if possible, so that the flows that use the
+         * ids already allocated don't change. */
+        uint32_t n_more = n_conjs - range->n_conjs;
+        if (range->conj_id_ofs <= UINT32_MAX - n_conjs
+            && lflow_conj_ids_are_free(conj_ids,
+                                       range->conj_id_ofs + range->n_conjs,
+                                       n_more, &conflict)) {
+            lflow_conj_ids_mark(conj_ids, range->conj_id_ofs + range->n_conjs,
+                                n_more);
+            range->n_conjs = n_conjs;
+            *conj_id_ofs = range->conj_id_ofs;
+            return true;
+        }
+        lflow_conj_ids_free__(conj_ids, range);
+    }
+
+    if (!n_conjs) {
+        *conj_id_ofs = 0;
+        return true;
+    }
+
+    /* Start from a hash of the UUID and skip past the ids in use.  'max_ofs'
+     * keeps the ids below 2**32, and 0 is not a valid conjunction id. */
+    uint32_t max_ofs = UINT32_MAX - n_conjs;
+    uint32_t ofs = uuid_hash(lflow_uuid) % ((uint64_t) max_ofs + 1);
+    uint64_t skipped = 0;
+    while (!lflow_conj_ids_are_free(conj_ids, ofs, n_conjs, &conflict)) {
+        COVERAGE_INC(lflow_conj_ids_collision);
+        if (conflict > max_ofs) {
+            skipped += (uint64_t) max_ofs + 1 - ofs;
+            ofs = 0;
+        } else {
+            skipped += conflict - ofs;
+            ofs = conflict;
+        }
+        if (skipped > max_ofs) {
+            return false;
+        }
+    }
+
+    COVERAGE_INC(lflow_conj_ids_alloc);
+    lflow_conj_id_range_add(conj_ids, lflow_uuid, ofs, n_conjs);
+    *conj_id_ofs = ofs;
+    return true;
+}
+
+/* Records that the logical flow 'lflow_uuid' uses the 'n_conjs' conjunction
+ * ids starting after 'conj_id_ofs', e.g. because they are part of cached
+ * matches.  Returns false if any of them is used by another logical flow,
+ * or if the logical flow already has different ids. */
+bool
+lflow_conj_ids_reserve(struct lflow_conj_ids *conj_ids,
+                       const struct uuid *lflow_uuid, uint32_t conj_id_ofs,
+                       uint32_t n_conjs)
+{
+    const struct lflow_conj_id_range *range
+        = lflow_conj_id_range_find(conj_ids, lflow_uuid);
+    uint32_t conflict;
+
+    if (range) {
+        return (range->conj_id_ofs == conj_id_ofs
+                && range->n_conjs >= n_conjs);
+    }
+    if (conj_id_ofs > UINT32_MAX - n_conjs
+        || !lflow_conj_ids_are_free(conj_ids, conj_id_ofs, n_conjs,
+                                    &conflict)) {
+        return false;
+    }
+    lflow_conj_id_range_add(conj_ids, lflow_uuid, conj_id_ofs, n_conjs);
+    return true;
+}
+
+void
+lflow_conj_ids_free(struct lflow_conj_ids *conj_ids,
+                    const struct uuid *lflow_uuid)
+{
+    struct lflow_conj_id_range *range
+        = lflow_conj_id_range_find(conj_ids, lflow_uuid);
+
+    if (range) {
+        lflow_conj_ids_free__(conj_ids, range);
+    }
+}
+
+/* Returns true if the logical flow 'lflow_uuid' has conjunction ids. */
+bool
+lflow_conj_ids_contains(const struct lflow_conj_ids *conj_ids,
+                        const struct uuid *lflow_uuid)
+{
+    return lflow_conj_id_range_find(conj_ids, lflow_uuid) != NULL;
+}
+
+/* Frees the conjunction ids of the logical flows for which 'exists' returns
+ * false. */
+void
+lflow_conj_ids_sweep(struct lflow_conj_ids *conj_ids,
+                     bool (*exists)(const struct uuid *lflow_uuid,
+                                    const void *aux),
+                     const void *aux)
+{
+    struct lflow_conj_id_range *range, *next;
+
+    HMAP_FOR_EACH_SAFE (range, next, node, &conj_ids->lflows) {
+        if (!exists(&range->lflow_uuid, aux)) {
+            lflow_conj_ids_free__(conj_ids, range);
+        }
+    }
+}
+
+/* Returns the number of logical flows that have conjunction ids. */
+size_t
+lflow_conj_ids_count(const struct lflow_conj_ids *conj_ids)
+{
+    return hmap_count(&conj_ids->lflows);
+}
+
+static void
+lflow_conj_ids_free__(struct lflow_conj_ids *conj_ids,
+                      struct lflow_conj_id_range *range)
+{
+    COVERAGE_INC(lflow_conj_ids_free);
+    lflow_conj_ids_unmark(conj_ids, range->conj_id_ofs, range->n_conjs);
+    hmap_remove(&conj_ids->lflows, &range->node);
+    free(range);
+}
@@ -0,0 +1,58 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LFLOW_CONJ_IDS_H
+#define LFLOW_CONJ_IDS_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "openvswitch/hmap.h"
+#include "openvswitch/uuid.h"
+
+/* Conjunction id allocator.
+ *
+ * A logical flow whose match translates into conjunctive OpenFlow flows
+ * needs 'n_conjs' consecutive conjunction ids, conj_id_ofs + 1 to
+ * conj_id_ofs + n_conjs.  The range of a logical flow is kept until the
+ * logical flow is deleted, so that recomputing the logical flows generates
+ * the same OpenFlow flows again, and the first range tried for a logical flow
+ * is derived from its UUID, so that the ids are most likely the same after a
+ * restart as well.  The ids of deleted logical flows are reused. */
+struct lflow_conj_ids {
+    struct hmap lflows;         /* Contains "struct lflow_conj_id_range"s. */
+    struct hmap ids;            /* Contains "struct lflow_conj_id"s. */
+};
+
+void lflow_conj_ids_init(struct lflow_conj_ids *);
+void lflow_conj_ids_destroy(struct lflow_conj_ids *);
+void lflow_conj_ids_clear(struct lflow_conj_ids *);
+
+bool lflow_conj_ids_alloc(struct lflow_conj_ids *,
+                          const struct uuid *lflow_uuid, uint32_t n_conjs,
+                          uint32_t *conj_id_ofs);
+bool lflow_conj_ids_reserve(struct lflow_conj_ids *,
+                            const struct uuid *lflow_uuid,
+                            uint32_t conj_id_ofs, uint32_t n_conjs);
+void lflow_conj_ids_free(struct lflow_conj_ids *,
+                         const struct uuid *lflow_uuid);
+bool lflow_conj_ids_contains(const struct lflow_conj_ids *,
+                             const struct uuid *lflow_uuid);
+void lflow_conj_ids_sweep(struct lflow_conj_ids *,
+                          bool (*exists)(const struct uuid *lflow_uuid,
+                                         const void *aux),
+                          const void *aux);
+size_t lflow_conj_ids_count(const struct lflow_conj_ids *);
+
+#endif /* controller/lflow-conj-ids.h */
@@ -17,6 +17,7 @@
 #include "lflow.h"
 #include "coverage.h"
 #include "ha-chassis.h"
+#include "hash.h"
 #include "lflow-cache.h"
 #include "lport.h"
 #include "ofctrl.h"
@@ -27,17 +28,18 @@
 #include "ovn-controller.h"
 #include "ovn/actions.h"
 #include "ovn/expr.h"
+#include "ovn/lex.h"
 #include "lib/lb.h"
 #include "lib/ovn-l7.h"
 #include "lib/ovn-sb-idl.h"
+#include "lib/ovn-util.h"
 #include "lib/extend-table.h"
+#include "lib/ovn-parallel-hmap.h"
 #include "packets.h"
 #include "physical.h"
 #include "simap.h"
 #include "sset.h"
 
-#include "ddlog.h"
-
 VLOG_DEFINE_THIS_MODULE(lflow);
 
 COVERAGE_DEFINE(lflow_run);
@@ -45,12 +47,16 @@ COVERAGE_DEFINE(lflow_run);
 /* Symbol table. */
 
 /* Contains "struct expr_symbol"s for fields supported by OVN lflows. */
-static struct shash symtab;
+static const struct shash *symtab;
+
+/* Controller id of the packet-ins of the 'handle_bfd_msg' action, see
+ * lflow_set_bfd_controller_id(). */
+static uint16_t bfd_controller_id = 0;
 
 void
 lflow_init(void)
 {
-    ovn_init_symtab(&symtab);
+    symtab = ovn_symtab_ref();
 }
 
 struct lookup_port_aux {
@@ -74,8 +80,16 @@ consider_logical_flow(const struct sbrec_logical_flow *lflow,
                       struct hmap *dhcp_opts, struct hmap *dhcpv6_opts,
                       struct hmap *nd_ra_opts,
                       struct controller_event_options *controller_event_opts,
+                      struct hmap *match_exprs,
+                      struct hmap *lflow_actions,
                       struct lflow_ctx_in *l_ctx_in,
                       struct lflow_ctx_out *l_ctx_out);
+static void match_exprs_destroy(struct hmap *match_exprs);
+static void lflow_actions_destroy(struct hmap *lflow_actions);
+static void match_exprs_prefill(struct hmap *match_exprs,
+                                const struct ovnact_parse_params *pp,
+                                const struct lflow_ctx_in *l_ctx_in,
+                                const struct lflow_ctx_out *l_ctx_out);
 static void lflow_resource_add(struct lflow_resource_ref *, enum ref_type,
                                const char *ref_name, const struct uuid *);
 static struct ref_lflow_node *ref_lflow_lookup(struct hmap *ref_lflow_table,
@@ -205,6 +219,29 @@ lflow_resource_clear(struct lflow_resource_ref *lfrr)
     lflow_resource_init(lfrr);
 }
 
+void
+lflow_resource_get_memory_usage(const struct lflow_resource_ref *lfrr,
+                                struct simap *usage)
+{
+    size_t n_refs = 0;
+    size_t bytes = ovn_hmap_buckets_size(&lfrr->ref_lflow_table)
+                   + ovn_hmap_buckets_size(&lfrr->lflow_ref_table)
+                   + hmap_count(&lfrr->lflow_ref_table)
+                     * sizeof(struct lflow_ref_node);
+
+    const struct ref_lflow_node *rlfn;
+    HMAP_FOR_EACH (rlfn, node, &lfrr->ref_lflow_table) {
+        n_refs += hmap_count(&rlfn->lflow_uuids);
+        bytes += sizeof *rlfn + strlen(rlfn->ref_name) + 1
+                 + ovn_hmap_buckets_size(&rlfn->lflow_uuids);
+    }
+    bytes += n_refs * sizeof(struct lflow_ref_list_node);
+
+    simap_increase(usage, "lflow-resource-refs", n_refs);
+    simap_increase(usage, "lflow-resource-refs-KB",
+                   ROUND_UP(bytes, 1024) / 1024);
+}
+
 static struct ref_lflow_node*
 ref_lflow_lookup(struct hmap *ref_lflow_table,
                  enum ref_type type, const char *ref_name)
@@ -344,11 +381,27 @@ add_logical_flows(struct lflow_ctx_in *l_ctx_in,
     struct controller_event_options controller_event_opts;
     controller_event_opts_init(&controller_event_opts);
 
+    /* Logical flows that only differ by datapath share their parsed match,
+     * see struct match_expr. */
+    struct hmap match_exprs = HMAP_INITIALIZER(&match_exprs);
+    struct hmap lflow_actions = HMAP_INITIALIZER(&lflow_actions);
+    if (use_parallel_parsing) {
+        struct ovnact_parse_params pp = {
+            .symtab = symtab,
+            .dhcp_opts = &dhcp_opts,
+            .dhcpv6_opts = &dhcpv6_opts,
+            .nd_ra_opts = &nd_ra_opts,
+            .controller_event_opts = &controller_event_opts,
+            .n_tables = LOG_PIPELINE_LEN,
+        };
+        match_exprs_prefill(&match_exprs, &pp, l_ctx_in, l_ctx_out);
+    }
+
     SBREC_LOGICAL_FLOW_TABLE_FOR_EACH (lflow, l_ctx_in->logical_flow_table) {
 
         if (!consider_logical_flow(lflow, &dhcp_opts, &dhcpv6_opts,
-                    &nd_ra_opts, &controller_event_opts,
-                    l_ctx_in, l_ctx_out)) {
+                    &nd_ra_opts, &controller_event_opts, &match_exprs,
+                    &lflow_actions, l_ctx_in, l_ctx_out)) {
             static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 5);
             VLOG_ERR_RL(&rl, "Conjunction id overflow when processing lflow "
                         UUID_FMT, UUID_ARGS(&lflow->header_.uuid));
@@ -356,6 +409,8 @@ add_logical_flows(struct lflow_ctx_in *l_ctx_in,
         }
     }
 
+    match_exprs_destroy(&match_exprs);
+    lflow_actions_destroy(&lflow_actions);
     dhcp_opts_destroy(&dhcp_opts);
     dhcp_opts_destroy(&dhcpv6_opts);
     nd_ra_opts_destroy(&nd_ra_opts);
@@ -366,23 +421,6 @@ bool
 lflow_handle_changed_flows(struct lflow_ctx_in *l_ctx_in,
                            struct lflow_ctx_out *l_ctx_out)
 {
-    /** Some DDlog cruft **/
-    table_id input_table;
-    table_id output_table;
-    const char *input_relation = "OVN_Southbound::Logical_Flow";
-    const char *output_relation = "Logical_Flow_Dependencies";
-
-    input_table = ddlog_get_table_id(DDLOG_PROG, input_relation);
-    if (input_table == -1) {
-        VLOG_INFO("ddlog_get_table_id returned -1 for %s, %ld", input_relation, input_table);
-    }
-
-    output_table = ddlog_get_table_id(DDLOG_PROG, output_relation);
-    if (output_table == -1) {
-        VLOG_INFO("ddlog_get_table_id returned -1 for %s, %ld", output_relation, output_table);
-    }
-    /** End of DDlog cruft **/
-
     bool ret = true;
     const struct sbrec_logical_flow *lflow;
 
@@ -429,6 +467,7 @@ lflow_handle_changed_flows(struct lflow_ctx_in *l_ctx_in,
         }
     }
     ofctrl_flood_remove_flows(l_ctx_out->flow_table, &flood_remove_nodes);
+    struct hmap lflow_actions = HMAP_INITIALIZER(&lflow_actions);
     HMAP_FOR_EACH (ofrn, hmap_node, &flood_remove_nodes) {
         /* Delete entries from lflow resource reference. */
         lflow_resource_destroy_lflow(l_ctx_out->lfrr, &ofrn->sb_uuid);
@@ -439,61 +478,14 @@ lflow_handle_changed_flows(struct lflow_ctx_in *l_ctx_in,
             VLOG_DBG("re-add lflow "UUID_FMT,
                      UUID_ARGS(&lflow->header_.uuid));
 
-            /* Prepare the record to be inserted to OVN_Southbound::Logical_Flow */
-            ddlog_record **struct_args = (ddlog_record **)malloc(9 * sizeof(ddlog_record *));;
-
-            ddlog_record *flow_uuid = ddlog_u128(lflow->header_.uuid.parts[0]);
-            ddlog_record *flow_garbage_ldp = ddlog_u128(0xdeadbeef);
-            ddlog_record *flow_garbage_ldpg = ddlog_u128(0x123456);
-            ddlog_record *flow_pipeline = ddlog_string(lflow->pipeline);
-            ddlog_record *flow_table_id = ddlog_i64(lflow->table_id);
-            ddlog_record *flow_priority = ddlog_i64(lflow->priority);
-            ddlog_record *flow_match = ddlog_string(lflow->match);
-            ddlog_record *flow_actions = ddlog_string(lflow->actions);
-
-            struct_args[0] = flow_uuid;
-            struct_args[1] = flow_garbage_ldp;
-            struct_args[2] = flow_garbage_ldpg;
-            struct_args[3] = flow_pipeline;
-            struct_args[4] = flow_table_id;
-            struct_args[5] = flow_priority;
-            struct_args[6] = flow_match;
-            struct_args[7] = flow_actions;
-            struct_args[8] = ddlog_map(NULL, 0);
-
-            ddlog_record *new_record = ddlog_struct(input_relation, struct_args, 9);
-
-            /* Finished prepared record */
-
-            if (ddlog_transaction_start(DDLOG_PROG) < 0) {
-                VLOG_INFO("ddlog failed to start transaction");
-            }
-
-            ddlog_cmd *cmd = ddlog_insert_cmd(input_table, new_record);
-            if (cmd == NULL) {
-                VLOG_INFO("ddlog failed to create insert cmd");
-            }
-
-            if (ddlog_apply_updates(DDLOG_PROG, &cmd, 1) < 0) {
-                VLOG_INFO("ddlog failed to apply updates");
-            }
-
-            ddlog_delta *changes = ddlog_transaction_commit_dump_changes(DDLOG_PROG);
-            if (changes == NULL) {
-                VLOG_INFO("ddlog failed to commit transaction");
-            }
-
-            ddlog_delta_enumerate(changes, &print_deltas_callback, (uintptr_t)(void*)(NULL));
-
-            free(struct_args);
-            /*** End DDlog test code ***/
-
             if (!consider_logical_flow(lflow, &dhcp_opts, &dhcpv6_opts,
-                        &nd_ra_opts, &controller_event_opts,
-                                       l_ctx_in, l_ctx_out)) {
+                        &nd_ra_opts, &controller_event_opts, NULL,
+                                       &lflow_actions, l_ctx_in, l_ctx_out)) {
                 ret = false;
                 break;
             }
+        } else {
+            lflow_conj_ids_free(l_ctx_out->conj_ids, &ofrn->sb_uuid);
         }
     }
     HMAP_FOR_EACH_SAFE (ofrn, next, hmap_node, &flood_remove_nodes) {
@@ -501,6 +493,7 @@ lflow_handle_changed_flows(struct lflow_ctx_in *l_ctx_in,
         free(ofrn);
     }
     hmap_destroy(&flood_remove_nodes);
+    lflow_actions_destroy(&lflow_actions);
 
     dhcp_opts_destroy(&dhcp_opts);
     dhcp_opts_destroy(&dhcpv6_opts);
@@ -509,6 +502,56 @@ lflow_handle_changed_flows(struct lflow_ctx_in *l_ctx_in,
     return ret;
 }
 
+/* Flood-removes the flows of the logical flows in 'flood_remove_nodes', and
+ * of the logical flows that share flows with them, from the desired flow
+ * table, then translates all of these logical flows again.  Consumes
+ * 'flood_remove_nodes'. */
+static bool
+reprocess_lflows(struct hmap *flood_remove_nodes,
+                 struct hmap *dhcp_opts, struct hmap *dhcpv6_opts,
+                 struct hmap *nd_ra_opts,
+                 struct controller_event_options *controller_event_opts,
+                 struct lflow_ctx_in *l_ctx_in,
+                 struct lflow_ctx_out *l_ctx_out, bool *changed)
+{
+    struct ofctrl_flood_remove_node *ofrn, *ofrn_next;
+    bool ret = true;
+
+    /* Firstly, flood remove the flows from desired flow table. */
+    ofctrl_flood_remove_flows(l_ctx_out->flow_table, flood_remove_nodes);
+
+    /* Secondly, for each lflow that is actually removed, reprocessing it. */
+    struct hmap lflow_actions = HMAP_INITIALIZER(&lflow_actions);
+    HMAP_FOR_EACH (ofrn, hmap_node, flood_remove_nodes) {
+        lflow_resource_destroy_lflow(l_ctx_out->lfrr, &ofrn->sb_uuid);
+
+        const struct sbrec_logical_flow *lflow =
+            sbrec_logical_flow_table_get_for_uuid(l_ctx_in->logical_flow_table,
+                                                  &ofrn->sb_uuid);
+        if (!lflow) {
+            VLOG_DBG("lflow "UUID_FMT" not found while reprocessing.",
+                     UUID_ARGS(&ofrn->sb_uuid));
+            continue;
+        }
+
+        if (!consider_logical_flow(lflow, dhcp_opts, dhcpv6_opts,
+                                   nd_ra_opts, controller_event_opts, NULL,
+                                   &lflow_actions, l_ctx_in, l_ctx_out)) {
+            ret = false;
+            l_ctx_out->conj_id_overflow = true;
+            break;
+        }
+        *changed = true;
+    }
+    HMAP_FOR_EACH_SAFE (ofrn, ofrn_next, hmap_node, flood_remove_nodes) {
+        hmap_remove(flood_remove_nodes, &ofrn->hmap_node);
+        free(ofrn);
+    }
+    hmap_destroy(flood_remove_nodes);
+    lflow_actions_destroy(&lflow_actions);
+    return ret;
+}
+
 bool
 lflow_handle_changed_ref(enum ref_type ref_type, const char *ref_name,
                          struct lflow_ctx_in *l_ctx_in,
@@ -525,7 +568,6 @@ lflow_handle_changed_ref(enum ref_type ref_type, const char *ref_name,
     VLOG_DBG("Handle changed lflow reference for resource type: %d,"
              " name: %s.", ref_type, ref_name);
     *changed = false;
-    bool ret = true;
 
     hmap_remove(&l_ctx_out->lfrr->ref_lflow_table, &rlfn->node);
 
@@ -561,9 +603,7 @@ lflow_handle_changed_ref(enum ref_type ref_type, const char *ref_name,
     controller_event_opts_init(&controller_event_opts);
 
     /* Re-parse the related lflows. */
-    /* Firstly, flood remove the flows from desired flow table. */
     struct hmap flood_remove_nodes = HMAP_INITIALIZER(&flood_remove_nodes);
-    struct ofctrl_flood_remove_node *ofrn, *ofrn_next;
     HMAP_FOR_EACH (lrln, hmap_node, &rlfn->lflow_uuids) {
         VLOG_DBG("Reprocess lflow "UUID_FMT" for resource type: %d,"
                  " name: %s.",
@@ -571,37 +611,10 @@ lflow_handle_changed_ref(enum ref_type ref_type, const char *ref_name,
                  ref_type, ref_name);
         ofctrl_flood_remove_add_node(&flood_remove_nodes, &lrln->lflow_uuid);
     }
-    ofctrl_flood_remove_flows(l_ctx_out->flow_table, &flood_remove_nodes);
-
-    /* Secondly, for each lflow that is actually removed, reprocessing it. */
-    HMAP_FOR_EACH (ofrn, hmap_node, &flood_remove_nodes) {
-        lflow_resource_destroy_lflow(l_ctx_out->lfrr, &ofrn->sb_uuid);
-
-        const struct sbrec_logical_flow *lflow =
-            sbrec_logical_flow_table_get_for_uuid(l_ctx_in->logical_flow_table,
-                                                  &ofrn->sb_uuid);
-        if (!lflow) {
-            VLOG_DBG("lflow "UUID_FMT" not found while reprocessing for"
-                     " resource type: %d, name: %s.",
-                     UUID_ARGS(&ofrn->sb_uuid),
-                     ref_type, ref_name);
-            continue;
-        }
-
-        if (!consider_logical_flow(lflow, &dhcp_opts, &dhcpv6_opts,
-                                   &nd_ra_opts, &controller_event_opts,
-                                   l_ctx_in, l_ctx_out)) {
-            ret = false;
-            l_ctx_out->conj_id_overflow = true;
-            break;
-        }
-        *changed = true;
-    }
-    HMAP_FOR_EACH_SAFE (ofrn, ofrn_next, hmap_node, &flood_remove_nodes) {
-        hmap_remove(&flood_remove_nodes, &ofrn->hmap_node);
-        free(ofrn);
-    }
-    hmap_destroy(&flood_remove_nodes);
+    bool ret = reprocess_lflows(&flood_remove_nodes, &dhcp_opts,
+                                &dhcpv6_opts, &nd_ra_opts,
+                                &controller_event_opts, l_ctx_in, l_ctx_out,
+                                changed);
 
     HMAP_FOR_EACH_SAFE (lrln, next, hmap_node, &rlfn->lflow_uuids) {
         hmap_remove(&rlfn->lflow_uuids, &lrln->hmap_node);
@@ -616,17 +629,6 @@ lflow_handle_changed_ref(enum ref_type ref_type, const char *ref_name,
     return ret;
 }
 
-static bool
-update_conj_id_ofs(uint32_t *conj_id_ofs, uint32_t n_conjs)
-{
-    if (*conj_id_ofs + n_conjs < *conj_id_ofs) {
-        /* overflow */
-        return true;
-    }
-    *conj_id_ofs += n_conjs;
-    return false;
-}
-
 static void
 add_matches_to_flow_table(const struct sbrec_logical_flow *lflow,
                           const struct sbrec_datapath_binding *dp,
@@ -665,6 +667,7 @@ add_matches_to_flow_table(const struct sbrec_logical_flow *lflow,
         .ct_snat_vip_ptable = OFTABLE_CT_SNAT_FOR_VIP,
         .fdb_ptable = OFTABLE_GET_FDB,
         .fdb_lookup_ptable = OFTABLE_LOOKUP_FDB,
+        .bfd_controller_id = bfd_controller_id,
     };
     ovnacts_encode(ovnacts->data, ovnacts->size, &ep, &ofpacts);
 
@@ -737,7 +740,7 @@ convert_match_to_expr(const struct sbrec_logical_flow *lflow,
     struct sset port_groups_ref = SSET_INITIALIZER(&port_groups_ref);
     char *error = NULL;
 
-    struct expr *e = expr_parse_string(lflow->match, &symtab, addr_sets,
+    struct expr *e = expr_parse_string(lflow->match, symtab, addr_sets,
                                        port_groups, &addr_sets_ref,
                                        &port_groups_ref, dp->tunnel_key,
                                        &error);
@@ -764,7 +767,7 @@ convert_match_to_expr(const struct sbrec_logical_flow *lflow,
             e = expr_combine(EXPR_T_AND, e, *prereqs);
             *prereqs = NULL;
         }
-        e = expr_annotate(e, &symtab, &error);
+        e = expr_annotate(e, symtab, &error);
     }
     if (error) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
@@ -777,12 +780,374 @@ convert_match_to_expr(const struct sbrec_logical_flow *lflow,
     return expr_simplify(e);
 }
 
+/* A simplified match expression, as returned by convert_match_to_expr(),
+ * shared by the logical flows that have the same match and actions.
+ *
+ * Without datapath groups, a flow that applies to many datapaths has one
+ * Logical_Flow row per datapath and each would parse, annotate and simplify
+ * the same match.  These entries only last for one pass over the logical
+ * flows, so they don't need to be invalidated.  Matches that refer to address
+ * sets or port groups are not shared: the port group names are specific to a
+ * datapath and the flows must be recorded as references anyway. */
+struct match_expr {
+    struct hmap_node hmap_node;
+    const char *match;          /* Owned by the Logical_Flow row. */
+    const char *actions;        /* Owned by the Logical_Flow row. */
+    const char *pipeline;       /* Owned by the Logical_Flow row. */
+    int64_t table_id;
+    struct expr *expr;
+};
+
+static uint32_t
+match_expr_hash(const struct sbrec_logical_flow *lflow)
+{
+    uint32_t hash = hash_string(lflow->pipeline, lflow->table_id);
+
+    hash = hash_string(lflow->actions, hash);
+    return hash_string(lflow->match, hash);
+}
+
+static struct match_expr *
+match_expr_find(const struct hmap *match_exprs,
+                const struct sbrec_logical_flow *lflow, uint32_t hash)
+{
+    struct match_expr *me;
+
+    HMAP_FOR_EACH_WITH_HASH (me, hmap_node, hash, match_exprs) {
+        if (me->table_id == lflow->table_id
+            && !strcmp(me->match, lflow->match)
+            && !strcmp(me->actions, lflow->actions)
+            && !strcmp(me->pipeline, lflow->pipeline)) {
+            return me;
+        }
+    }
+    return NULL;
+}
+
+/* Adds a copy of 'expr' as the match expression of 'lflow'. */
+static void
+match_expr_add(struct hmap *match_exprs,
+               const struct sbrec_logical_flow *lflow, uint32_t hash,
+               const struct expr *expr)
+{
+    struct match_expr *me = xmalloc(sizeof *me);
+
+    me->match = lflow->match;
+    me->actions = lflow->actions;
+    me->pipeline = lflow->pipeline;
+    me->table_id = lflow->table_id;
+    me->expr = expr_clone(expr);
+    hmap_insert(match_exprs, &me->hmap_node, hash);
+}
+
+static void
+match_exprs_destroy(struct hmap *match_exprs)
+{
+    struct match_expr *me;
+
+    HMAP_FOR_EACH_POP (me, hmap_node, match_exprs) {
+        expr_destroy(me->expr);
+        free(me);
+    }
+    hmap_destroy(match_exprs);
+}
+
+/* Parsed actions, as returned by ovnacts_parse_string(), shared by the
+ * logical flows that have the same actions in the same table.
+ *
+ * A deployment has far fewer distinct actions than logical flows, e.g.
+ * "next;" or the actions of the ACLs, and a logical flow with a datapath
+ * group is translated once per datapath.  Like struct match_expr, these
+ * entries only last for one pass over the logical flows, during which the
+ * symbol table and the options that parsing depends on don't change.  The
+ * encoding of the actions depends on the logical flow and its datapath, so
+ * it isn't shared. */
+struct lflow_actions {
+    struct hmap_node hmap_node;
+    const char *actions;        /* Owned by the Logical_Flow row. */
+    const char *pipeline;       /* Owned by the Logical_Flow row. */
+    int64_t table_id;
+    struct ofpbuf ovnacts;
+    struct expr *prereqs;       /* May be NULL. */
+};
+
+static uint32_t
+lflow_actions_hash(const struct sbrec_logical_flow *lflow)
+{
+    uint32_t hash = hash_string(lflow->pipeline, lflow->table_id);
+
+    return hash_string(lflow->actions, hash);
+}
+
+static struct lflow_actions *
+lflow_actions_find(const struct hmap *lflow_actions,
+                   const struct sbrec_logical_flow *lflow, uint32_t hash)
+{
+    struct lflow_actions *la;
+
+    HMAP_FOR_EACH_WITH_HASH (la, hmap_node, hash, lflow_actions) {
+        if (la->table_id == lflow->table_id
+            && !strcmp(la->actions, lflow->actions)
+            && !strcmp(la->pipeline, lflow->pipeline)) {
+            return la;
+        }
+    }
+    return NULL;
+}
+
+/* Adds the parsed actions of 'lflow', taking ownership of the ovnacts in
+ * 'ovnacts', which is left empty, and adding a copy of 'prereqs'. */
+static struct lflow_actions *
+lflow_actions_add(struct hmap *lflow_actions,
+                  const struct sbrec_logical_flow *lflow, uint32_t hash,
+                  struct ofpbuf *ovnacts, const struct expr *prereqs)
+{
+    struct lflow_actions *la = xmalloc(sizeof *la);
+
+    la->actions = lflow->actions;
+    la->pipeline = lflow->pipeline;
+    la->table_id = lflow->table_id;
+    ofpbuf_init(&la->ovnacts, ovnacts->size);
+    ofpbuf_put(&la->ovnacts, ovnacts->data, ovnacts->size);
+    ofpbuf_clear(ovnacts);
+    la->prereqs = prereqs ? expr_clone(CONST_CAST(struct expr *, prereqs))
+                          : NULL;
+    hmap_insert(lflow_actions, &la->hmap_node, hash);
+    return la;
+}
+
+static void
+lflow_actions_destroy(struct hmap *lflow_actions)
+{
+    struct lflow_actions *la;
+
+    HMAP_FOR_EACH_POP (la, hmap_node, lflow_actions) {
+        ovnacts_free(la->ovnacts.data, la->ovnacts.size);
+        ofpbuf_uninit(&la->ovnacts);
+        expr_destroy(la->prereqs);
+        free(la);
+    }
+    hmap_destroy(lflow_actions);
+}
+
+/* Parsing the matches in parallel.
+ *
+ * Translating a logical flow into OpenFlow updates the desired flow table,
+ * the resource references, the conjunction ids and the lflow cache, which
+ * all have to stay in the order of the serial loop for the result to be
+ * deterministic.  Parsing, annotating and simplifying the matches is the
+ * most expensive part, though, and it only reads the symbol table and the
+ * options.  So, before a full translation, the matches that are not cached
+ * and don't refer to address sets or port groups are parsed by a pool of
+ * workers into 'match_exprs', where the serial loop finds them. */
+static bool use_parallel_parsing = false;
+
+/* Below this many matches, waking up the workers costs more than it saves. */
+#define LFLOW_PARSE_PARALLEL_MIN 1024
+
+void
+lflow_set_parallel_parsing(bool enabled)
+{
+    use_parallel_parsing = enabled && can_parallelize_hashes(false);
+}
+
+/* Sets the controller id to which the 'handle_bfd_msg' actions send their
+ * packets.  Takes effect on the next full recompute. */
+void
+lflow_set_bfd_controller_id(uint16_t controller_id)
+{
+    bfd_controller_id = controller_id;
+}
+
+struct match_parse_job {
+    struct parallel_work work;
+    struct match_expr **exprs;
+    const struct ovnact_parse_params *pp;
+};
+
+static void
+match_parse_job_run(struct match_parse_job *job, size_t index)
+{
+    struct match_expr *me = job->exprs[index];
+    struct ovnact_parse_params pp = *job->pp;
+    uint64_t ovnacts_stub[1024 / 8];
+    struct ofpbuf ovnacts = OFPBUF_STUB_INITIALIZER(ovnacts_stub);
+    struct expr *prereqs = NULL;
+    struct expr *e = NULL;
+    char *error;
+
+    pp.pipeline = (!strcmp(me->pipeline, "ingress")
+                   ? OVNACT_P_INGRESS : OVNACT_P_EGRESS);
+    pp.cur_ltable = me->table_id;
+    error = ovnacts_parse_string(me->actions, &pp, &ovnacts, &prereqs);
+    ovnacts_free(ovnacts.data, ovnacts.size);
+    ofpbuf_uninit(&ovnacts);
+
+    /* Errors are left for the serial loop to report. */
+    if (!error) {
+        e = expr_parse_string(me->match, symtab, NULL, NULL, NULL, NULL, 0,
+                              &error);
+    }
+    if (!error) {
+        if (prereqs) {
+            e = expr_combine(EXPR_T_AND, e, prereqs);
+            prereqs = NULL;
+        }
+        e = expr_annotate(e, symtab, &error);
+    }
+    if (!error) {
+        me->expr = expr_simplify(e);
+    }
+    free(error);
+    expr_destroy(prereqs);
+}
+
+static bool match_parse_pool_init_done = false;
+static struct worker_pool *match_parse_pool = NULL;
+
+static void *
+match_parse_thread(void *arg)
+{
+    struct worker_control *control = arg;
+    size_t start, end;
+
+    while (!stop_parallel_processing()) {
+        wait_for_work(control);
+        struct match_parse_job *job = control->data;
+        if (stop_parallel_processing()) {
+            return NULL;
+        }
+        if (job) {
+            while (parallel_work_next(&job->work, &start, &end)) {
+                for (size_t i = start; i < end; i++) {
+                    match_parse_job_run(job, i);
+                }
+            }
+        }
+        post_completed_work(control);
+    }
+    return NULL;
+}
+
+static bool
+lflow_has_local_datapath(const struct sbrec_logical_flow *lflow,
+                         const struct hmap *local_datapaths)
+{
+    const struct sbrec_logical_dp_group *dp_group = lflow->logical_dp_group;
+
+    if (lflow->logical_datapath) {
+        return get_local_datapath(local_datapaths,
+                                  lflow->logical_datapath->tunnel_key);
+    }
+    for (size_t i = 0; dp_group && i < dp_group->n_datapaths; i++) {
+        if (get_local_datapath(local_datapaths,
+                               dp_group->datapaths[i]->tunnel_key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+match_exprs_prefill(struct hmap *match_exprs,
+                    const struct ovnact_parse_params *pp,
+                    const struct lflow_ctx_in *l_ctx_in,
+                    const struct lflow_ctx_out *l_ctx_out)
+{
+    if (!match_parse_pool_init_done) {
+        match_parse_pool = add_worker_pool(match_parse_thread);
+        match_parse_pool_init_done = true;
+    }
+    if (!match_parse_pool) {
+        return;
+    }
+
+    struct match_expr **exprs = NULL;
+    size_t n_exprs = 0, allocated_exprs = 0;
+    const struct sbrec_logical_flow *lflow;
+    SBREC_LOGICAL_FLOW_TABLE_FOR_EACH (lflow, l_ctx_in->logical_flow_table) {
+        enum lflow_cache_type type
+            = lflow_cache_peek_type(l_ctx_out->lflow_cache,
+                                    &lflow->header_.uuid);
+
+        /* Address set and port group references start with '$' and '@'.
+         * This may also skip a few matches that only have these characters
+         * in string constants, which is harmless. */
+        if (type == LCACHE_T_EXPR || type == LCACHE_T_MATCHES
+            || strpbrk(lflow->match, "$@")
+            || !lflow_has_local_datapath(lflow, l_ctx_in->local_datapaths)) {
+            continue;
+        }
+
+        uint32_t hash = match_expr_hash(lflow);
+        if (match_expr_find(match_exprs, lflow, hash)) {
+            continue;
+        }
+
+        struct match_expr *me = xmalloc(sizeof *me);
+        me->match = lflow->match;
+        me->actions = lflow->actions;
+        me->pipeline = lflow->pipeline;
+        me->table_id = lflow->table_id;
+        me->expr = NULL;
+        hmap_insert(match_exprs, &me->hmap_node, hash);
+
+        if (n_exprs >= allocated_exprs) {
+            exprs = x2nrealloc(exprs, &allocated_exprs, sizeof *exprs);
+        }
+        exprs[n_exprs++] = me;
+    }
+
+    if (n_exprs >= LFLOW_PARSE_PARALLEL_MIN) {
+        struct match_parse_job job = { .exprs = exprs, .pp = pp };
+
+        parallel_work_init_n(&job.work, n_exprs, match_parse_pool->size);
+        for (int i = 0; i < match_parse_pool->size; i++) {
+            match_parse_pool->controls[i].data = &job;
+        }
+        run_pool_callback(match_parse_pool, NULL, NULL, NULL);
+    }
+
+    /* Leave the matches that failed to parse, and all of them if there were
+     * too few to bother, to the serial loop. */
+    for (size_t i = 0; i < n_exprs; i++) {
+        if (!exprs[i]->expr) {
+            hmap_remove(match_exprs, &exprs[i]->hmap_node);
+            free(exprs[i]);
+        }
+    }
+    free(exprs);
+}
+
+/* Returns true if the conjunction ids in the cached matches 'cm' of 'lflow'
+ * are still the ones allocated to 'lflow', allocating them if needed. */
+static bool
+lflow_reserve_cond_matches_conj_ids(const struct sbrec_logical_flow *lflow,
+                                    const struct lflow_cache_cond_matches *cm,
+                                    struct lflow_ctx_out *l_ctx_out)
+{
+    uint32_t conj_id_ofs;
+
+    if (!cm->n_conjs) {
+        lflow_conj_ids_free(l_ctx_out->conj_ids, &lflow->header_.uuid);
+        return true;
+    }
+    return (lflow_conj_ids_alloc(l_ctx_out->conj_ids, &lflow->header_.uuid,
+                                 cm->n_conjs, &conj_id_ofs)
+            && conj_id_ofs == cm->conj_id_ofs);
+}
+
+/* 'match_exprs' and 'lflow_actions', if nonnull, are used to share the
+ * parsed match and actions of 'lflow' with other logical flows, see struct
+ * match_expr and struct lflow_actions. */
 static bool
 consider_logical_flow__(const struct sbrec_logical_flow *lflow,
                         const struct sbrec_datapath_binding *dp,
                         struct hmap *dhcp_opts, struct hmap *dhcpv6_opts,
                         struct hmap *nd_ra_opts,
                         struct controller_event_options *controller_event_opts,
+                        struct hmap *match_exprs,
+                        struct hmap *lflow_actions,
                         struct lflow_ctx_in *l_ctx_in,
                         struct lflow_ctx_out *l_ctx_out)
 {
@@ -810,7 +1175,7 @@ consider_logical_flow__(const struct sbrec_logical_flow *lflow,
     uint64_t ovnacts_stub[1024 / 8];
     struct ofpbuf ovnacts = OFPBUF_STUB_INITIALIZER(ovnacts_stub);
     struct ovnact_parse_params pp = {
-        .symtab = &symtab,
+        .symtab = symtab,
         .dhcp_opts = dhcp_opts,
         .dhcpv6_opts = dhcpv6_opts,
         .nd_ra_opts = nd_ra_opts,
@@ -820,18 +1185,34 @@ consider_logical_flow__(const struct sbrec_logical_flow *lflow,
         .n_tables = LOG_PIPELINE_LEN,
         .cur_ltable = lflow->table_id,
     };
+    struct ofpbuf *actions = &ovnacts;
     struct expr *prereqs = NULL;
-    char *error;
 
-    error = ovnacts_parse_string(lflow->actions, &pp, &ovnacts, &prereqs);
-    if (error) {
-        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
-        VLOG_WARN_RL(&rl, "error parsing actions \"%s\": %s",
-                     lflow->actions, error);
-        free(error);
-        ovnacts_free(ovnacts.data, ovnacts.size);
-        ofpbuf_uninit(&ovnacts);
-        return true;
+    uint32_t actions_hash = lflow_actions ? lflow_actions_hash(lflow) : 0;
+    struct lflow_actions *la
+        = (lflow_actions
+           ? lflow_actions_find(lflow_actions, lflow, actions_hash)
+           : NULL);
+    if (la) {
+        actions = &la->ovnacts;
+        prereqs = la->prereqs ? expr_clone(la->prereqs) : NULL;
+    } else {
+        char *error = ovnacts_parse_string(lflow->actions, &pp, &ovnacts,
+                                           &prereqs);
+        if (error) {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+            VLOG_WARN_RL(&rl, "error parsing actions \"%s\": %s",
+                         lflow->actions, error);
+            free(error);
+            ovnacts_free(ovnacts.data, ovnacts.size);
+            ofpbuf_uninit(&ovnacts);
+            return true;
+        }
+        if (lflow_actions) {
+            la = lflow_actions_add(lflow_actions, lflow, actions_hash,
+                                   &ovnacts, prereqs);
+            actions = &la->ovnacts;
+        }
     }
 
     struct lookup_port_aux aux = {
@@ -850,8 +1231,7 @@ consider_logical_flow__(const struct sbrec_logical_flow *lflow,
 
     struct lflow_cache_value *lcv =
         lflow_cache_get(l_ctx_out->lflow_cache, &lflow->header_.uuid);
-    uint32_t conj_id_ofs =
-        lcv ? lcv->conj_id_ofs : *l_ctx_out->conj_id_ofs;
+    uint32_t conj_id_ofs = 0;
     enum lflow_cache_type lcv_type =
         lcv ? lcv->type : LCACHE_T_NONE;
 
@@ -865,17 +1245,53 @@ consider_logical_flow__(const struct sbrec_logical_flow *lflow,
 
     bool conj_id_overflow = false;
 
+    /* The matches of a cached expr may also be cached for the current
+     * residency of the ports in its is_chassis_resident() conditions, then
+     * they are used like cached matches. */
+    struct hmap *cached_matches = NULL;
+    bool has_cond_state = false;
+    uint64_t cond_state = 0;
+    if (lcv_type == LCACHE_T_EXPR) {
+        has_cond_state = expr_get_condition_state(lcv->expr,
+                                                  is_chassis_resident_cb,
+                                                  &cond_aux, &cond_state);
+        const struct lflow_cache_cond_matches *cm
+            = (has_cond_state
+               ? lflow_cache_find_cond_matches(lcv, cond_state)
+               : NULL);
+        if (cm && lflow_reserve_cond_matches_conj_ids(lflow, cm,
+                                                      l_ctx_out)) {
+            cached_matches = cm->matches;
+            lcv_type = LCACHE_T_MATCHES;
+        }
+    } else if (lcv_type == LCACHE_T_MATCHES) {
+        cached_matches = lcv->expr_matches;
+    }
+
     /* Get match expr, either from cache or from lflow match. */
     switch (lcv_type) {
     case LCACHE_T_NONE:
-    case LCACHE_T_CONJ_ID:
+    case LCACHE_T_CONJ_ID: {
+        uint32_t hash = match_exprs ? match_expr_hash(lflow) : 0;
+        const struct match_expr *me
+            = match_exprs ? match_expr_find(match_exprs, lflow, hash) : NULL;
+
+        if (me) {
+            expr = expr_clone(me->expr);
+            break;
+        }
+
         expr = convert_match_to_expr(lflow, dp, &prereqs, l_ctx_in->addr_sets,
                                      l_ctx_in->port_groups, l_ctx_out->lfrr,
                                      &pg_addr_set_ref);
         if (!expr) {
             goto done;
         }
+        if (match_exprs && !pg_addr_set_ref) {
+            match_expr_add(match_exprs, lflow, hash, expr);
+        }
         break;
+    }
     case LCACHE_T_EXPR:
         expr = expr_clone(lcv->expr);
         break;
@@ -912,6 +1328,14 @@ consider_logical_flow__(const struct sbrec_logical_flow *lflow,
     case LCACHE_T_EXPR:
         matches = xmalloc(sizeof *matches);
         n_conjs = expr_to_matches(expr, lookup_port_cb, &aux, matches);
+        if (!n_conjs) {
+            lflow_conj_ids_free(l_ctx_out->conj_ids, &lflow->header_.uuid);
+        } else if (!lflow_conj_ids_alloc(l_ctx_out->conj_ids,
+                                         &lflow->header_.uuid, n_conjs,
+                                         &conj_id_ofs)) {
+            conj_id_overflow = true;
+            goto done;
+        }
         matches_size = expr_matches_prepare(matches, conj_id_ofs);
         if (hmap_is_empty(matches)) {
             VLOG_DBG("lflow "UUID_FMT" matches are empty, skip",
@@ -920,21 +1344,16 @@ consider_logical_flow__(const struct sbrec_logical_flow *lflow,
         }
         break;
     case LCACHE_T_MATCHES:
-        matches = lcv->expr_matches;
+        matches = cached_matches;
         break;
     }
 
     add_matches_to_flow_table(lflow, dp, matches, ptable, output_ptable,
-                              &ovnacts, ingress, l_ctx_in, l_ctx_out);
+                              actions, ingress, l_ctx_in, l_ctx_out);
 
     /* Update cache if needed. */
     switch (lcv_type) {
     case LCACHE_T_NONE:
-        /* Entry not already in cache, update conjunction id offset and
-         * add the entry to the cache.
-         */
-        conj_id_overflow = update_conj_id_ofs(l_ctx_out->conj_id_ofs, n_conjs);
-
         /* Cache new entry if caching is enabled. */
         if (lflow_cache_is_enabled(l_ctx_out->lflow_cache)) {
             if (cached_expr && !is_cr_cond_present) {
@@ -943,10 +1362,21 @@ consider_logical_flow__(const struct sbrec_logical_flow *lflow,
                                         matches_size);
                 matches = NULL;
             } else if (cached_expr) {
+                has_cond_state = expr_get_condition_state(
+                    cached_expr, is_chassis_resident_cb, &cond_aux,
+                    &cond_state);
                 lflow_cache_add_expr(l_ctx_out->lflow_cache,
                                      &lflow->header_.uuid, conj_id_ofs,
                                      cached_expr, expr_size(cached_expr));
                 cached_expr = NULL;
+                if (has_cond_state) {
+                    lflow_cache_add_cond_matches(l_ctx_out->lflow_cache,
+                                                 &lflow->header_.uuid,
+                                                 cond_state, conj_id_ofs,
+                                                 n_conjs, matches,
+                                                 matches_size);
+                    matches = NULL;
+                }
             } else if (n_conjs) {
                 lflow_cache_add_conj_id(l_ctx_out->lflow_cache,
                                         &lflow->header_.uuid, conj_id_ofs);
@@ -954,7 +1384,15 @@ consider_logical_flow__(const struct sbrec_logical_flow *lflow,
         }
         break;
     case LCACHE_T_CONJ_ID:
+        break;
     case LCACHE_T_EXPR:
+        if (has_cond_state) {
+            lflow_cache_add_cond_matches(l_ctx_out->lflow_cache,
+                                         &lflow->header_.uuid, cond_state,
+                                         conj_id_ofs, n_conjs, matches,
+                                         matches_size);
+            matches = NULL;
+        }
         break;
     case LCACHE_T_MATCHES:
         /* Cached matches were used, don't destroy them. */
@@ -978,6 +1416,8 @@ consider_logical_flow(const struct sbrec_logical_flow *lflow,
                       struct hmap *dhcp_opts, struct hmap *dhcpv6_opts,
                       struct hmap *nd_ra_opts,
                       struct controller_event_options *controller_event_opts,
+                      struct hmap *match_exprs,
+                      struct hmap *lflow_actions,
                       struct lflow_ctx_in *l_ctx_in,
                       struct lflow_ctx_out *l_ctx_out)
 {
@@ -996,30 +1436,447 @@ consider_logical_flow(const struct sbrec_logical_flow *lflow,
 
     if (dp && !consider_logical_flow__(lflow, dp,
                                        dhcp_opts, dhcpv6_opts, nd_ra_opts,
-                                       controller_event_opts,
-                                       l_ctx_in, l_ctx_out)) {
+                                       controller_event_opts, match_exprs,
+                                       lflow_actions, l_ctx_in, l_ctx_out)) {
         ret = false;
     }
     for (size_t i = 0; dp_group && i < dp_group->n_datapaths; i++) {
         if (!consider_logical_flow__(lflow, dp_group->datapaths[i],
                                      dhcp_opts,  dhcpv6_opts, nd_ra_opts,
-                                     controller_event_opts,
-                                     l_ctx_in, l_ctx_out)) {
+                                     controller_event_opts, match_exprs,
+                                     lflow_actions, l_ctx_in, l_ctx_out)) {
             ret = false;
         }
     }
     return ret;
 }
 
-static void
-put_load(const uint8_t *data, size_t len,
-         enum mf_field_id dst, int ofs, int n_bits,
-         struct ofpbuf *ofpacts)
+/* Returns the number of references in 'match' to the address set or port
+ * group 'name', depending on 'ref_type', when 'match' is parsed for 'dp'. */
+static size_t
+count_const_set_refs(const char *match, enum ref_type ref_type,
+                     const char *name,
+                     const struct sbrec_datapath_binding *dp)
 {
-    struct ofpact_set_field *sf = ofpact_put_set_field(ofpacts,
-                                                       mf_from_id(dst), NULL,
-                                                       NULL);
-    bitwise_copy(data, len, 0, sf->value, sf->field->n_bytes, ofs, n_bits);
+    char sigil = ref_type == REF_TYPE_ADDRSET ? '$' : '@';
+    struct ds sb_name = DS_EMPTY_INITIALIZER;
+    size_t n = 0;
+
+    for (const char *p = strchr(match, sigil); p; p = strchr(p + 1, sigil)) {
+        const char *start = p + 1;
+        const char *end = start;
+        while ((*end >= 'a' && *end <= 'z') || (*end >= 'A' && *end <= 'Z')
+               || (*end >= '0' && *end <= '9') || *end == '_' || *end == '.') {
+            end++;
+        }
+
+        char *id = xmemdup0(start, end - start);
+        if (!strcmp(id, name)) {
+            n++;
+        } else if (ref_type == REF_TYPE_PORTGROUP) {
+            /* Port groups are looked up by their southbound name first, see
+             * parse_port_group(). */
+            ds_clear(&sb_name);
+            get_sb_port_group_name(id, dp->tunnel_key, &sb_name);
+            if (!strcmp(ds_cstr(&sb_name), name)) {
+                n++;
+            }
+        }
+        free(id);
+    }
+    ds_destroy(&sb_name);
+    return n;
+}
+
+/* Translates the match of 'lflow' on 'dp' into 'matches', with the constant
+ * set 'name' in 'const_sets', which is either 'addr_sets' or 'port_groups',
+ * replaced by 'cs'.  Returns false if the match can't be translated or if
+ * the translation needs conjunctive flows. */
+static bool
+translate_with_const_set(const struct sbrec_logical_flow *lflow,
+                         const struct sbrec_datapath_binding *dp,
+                         struct expr *prereqs, const struct shash *addr_sets,
+                         const struct shash *port_groups,
+                         struct shash *const_sets, const char *name,
+                         struct expr_constant_set *cs,
+                         struct lflow_ctx_in *l_ctx_in,
+                         struct lflow_ctx_out *l_ctx_out,
+                         struct hmap *matches)
+{
+    struct shash_node *cs_node = shash_find(const_sets, name);
+    void *orig_cs = cs_node->data;
+
+    prereqs = prereqs ? expr_clone(prereqs) : NULL;
+    cs_node->data = cs;
+    struct expr *expr = convert_match_to_expr(lflow, dp, &prereqs, addr_sets,
+                                              port_groups, l_ctx_out->lfrr,
+                                              NULL);
+    cs_node->data = orig_cs;
+    expr_destroy(prereqs);
+    if (!expr) {
+        return false;
+    }
+
+    struct lookup_port_aux aux = {
+        .sbrec_multicast_group_by_name_datapath
+            = l_ctx_in->sbrec_multicast_group_by_name_datapath,
+        .sbrec_port_binding_by_name = l_ctx_in->sbrec_port_binding_by_name,
+        .dp = dp,
+    };
+    struct condition_aux cond_aux = {
+        .sbrec_port_binding_by_name = l_ctx_in->sbrec_port_binding_by_name,
+        .chassis = l_ctx_in->chassis,
+        .active_tunnels = l_ctx_in->active_tunnels,
+        .lflow = lflow,
+        .lfrr = l_ctx_out->lfrr,
+    };
+    bool is_cr_cond_present = false;
+
+    expr = expr_evaluate_condition(expr, is_chassis_resident_cb, &cond_aux,
+                                   &is_cr_cond_present);
+    expr = expr_normalize(expr);
+    uint32_t n_conjs = expr_to_matches(expr, lookup_port_cb, &aux, matches);
+    expr_destroy(expr);
+    return !n_conjs;
+}
+
+static bool
+expr_matches_contains(const struct hmap *matches, const struct expr_match *m)
+{
+    const struct expr_match *other;
+
+    HMAP_FOR_EACH_WITH_HASH (other, hmap_node, m->hmap_node.hash, matches) {
+        if (match_equal(&other->match, &m->match)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* The flows to add and to remove for a logical flow on one datapath, when an
+ * address set or a port group that it uses is updated. */
+struct const_set_flows {
+    const struct sbrec_datapath_binding *dp;
+    struct hmap added;          /* Contains "struct expr_match"es. */
+    struct hmap deleted;        /* Contains "struct expr_match"es. */
+};
+
+/* The address sets and port groups used to translate logical flows for an
+ * update of the constant set 'name', with a copy of the sets of its type in
+ * which 'name' can be replaced by the added or deleted constants. */
+struct const_set_update {
+    enum ref_type ref_type;
+    const char *name;
+    const struct const_set_diff *diff;
+    struct shash copy;
+    const struct shash *addr_sets;
+    const struct shash *port_groups;
+    bool may_aggregate;         /* Set may be aggregated before or after. */
+};
+
+/* Adds and removes the flows of 'lflow' for the constants added to and
+ * deleted from the constant set of 'update', without touching the flows of
+ * the other constants.  Returns false if 'lflow' can't be updated this way
+ * and must be translated again instead.  Its flows are then left unchanged,
+ * unless one of the flows to remove is not installed, in which case the
+ * caller replaces all of them anyway.
+ *
+ * This is only possible if each constant translates into exactly one flow of
+ * its own, which isn't the case, e.g., if the match refers to the set more
+ * than once or if it needs conjunctive flows. */
+static bool
+lflow_apply_const_set_diff(const struct sbrec_logical_flow *lflow,
+                           struct const_set_update *update,
+                           struct hmap *dhcp_opts, struct hmap *dhcpv6_opts,
+                           struct hmap *nd_ra_opts,
+                           struct controller_event_options *ce_opts,
+                           struct lflow_ctx_in *l_ctx_in,
+                           struct lflow_ctx_out *l_ctx_out)
+{
+    const struct const_set_diff *diff = update->diff;
+
+    /* The flows of an address set whose prefixes are aggregated don't match
+     * one to one with its addresses. */
+    if (update->may_aggregate) {
+        return false;
+    }
+
+    if (lflow_conj_ids_contains(l_ctx_out->conj_ids, &lflow->header_.uuid)) {
+        return false;
+    }
+
+    const struct sbrec_logical_dp_group *dp_group = lflow->logical_dp_group;
+    size_t n_dps = (lflow->logical_datapath ? 1
+                    : dp_group ? dp_group->n_datapaths : 0);
+    if (!n_dps) {
+        return false;
+    }
+
+    bool ingress = !strcmp(lflow->pipeline, "ingress");
+    uint8_t ptable = lflow->table_id + (ingress
+                                        ? OFTABLE_LOG_INGRESS_PIPELINE
+                                        : OFTABLE_LOG_EGRESS_PIPELINE);
+    uint8_t output_ptable = (ingress
+                             ? OFTABLE_REMOTE_OUTPUT
+                             : OFTABLE_SAVE_INPORT);
+
+    uint64_t ovnacts_stub[1024 / 8];
+    struct ofpbuf ovnacts = OFPBUF_STUB_INITIALIZER(ovnacts_stub);
+    struct ovnact_parse_params pp = {
+        .symtab = symtab,
+        .dhcp_opts = dhcp_opts,
+        .dhcpv6_opts = dhcpv6_opts,
+        .nd_ra_opts = nd_ra_opts,
+        .controller_event_opts = ce_opts,
+
+        .pipeline = ingress ? OVNACT_P_INGRESS : OVNACT_P_EGRESS,
+        .n_tables = LOG_PIPELINE_LEN,
+        .cur_ltable = lflow->table_id,
+    };
+    struct expr *prereqs = NULL;
+    char *error = ovnacts_parse_string(lflow->actions, &pp, &ovnacts,
+                                       &prereqs);
+    if (error) {
+        free(error);
+        ovnacts_free(ovnacts.data, ovnacts.size);
+        ofpbuf_uninit(&ovnacts);
+        return false;
+    }
+
+    struct expr_constant_set empty_cs = {
+        .type = diff->added->type,
+        .in_curlies = true,
+    };
+    struct const_set_flows *dp_flows = xmalloc(n_dps * sizeof *dp_flows);
+    size_t n_dp_flows = 0;
+    bool ok = true;
+
+    for (size_t i = 0; ok && i < n_dps; i++) {
+        const struct sbrec_datapath_binding *dp
+            = lflow->logical_datapath ? lflow->logical_datapath
+                                      : dp_group->datapaths[i];
+        if (!get_local_datapath(l_ctx_in->local_datapaths, dp->tunnel_key)) {
+            continue;
+        }
+
+        /* A port group of a logical flow with a datapath group is a
+         * different port group on each datapath. */
+        size_t n_refs = count_const_set_refs(lflow->match, update->ref_type,
+                                             update->name, dp);
+        if (!n_refs) {
+            continue;
+        } else if (n_refs > 1) {
+            ok = false;
+            break;
+        }
+
+        struct const_set_flows *f = &dp_flows[n_dp_flows++];
+        f->dp = dp;
+        hmap_init(&f->added);
+        hmap_init(&f->deleted);
+
+        ok = (translate_with_const_set(lflow, dp, prereqs, update->addr_sets,
+                                       update->port_groups, &update->copy,
+                                       update->name, diff->added,
+                                       l_ctx_in, l_ctx_out, &f->added)
+              && hmap_count(&f->added) == diff->added->n_values
+              && translate_with_const_set(lflow, dp, prereqs,
+                                          update->addr_sets,
+                                          update->port_groups, &update->copy,
+                                          update->name, diff->deleted,
+                                          l_ctx_in, l_ctx_out, &f->deleted)
+              && hmap_count(&f->deleted) == diff->deleted->n_values);
+
+        if (ok && diff->deleted->n_values) {
+            /* A flow of a deleted constant may still be needed by the rest
+             * of the match. */
+            struct hmap others = HMAP_INITIALIZER(&others);
+            const struct expr_match *m;
+
+            ok = translate_with_const_set(lflow, dp, prereqs,
+                                          update->addr_sets,
+                                          update->port_groups, &update->copy,
+                                          update->name, &empty_cs,
+                                          l_ctx_in, l_ctx_out, &others);
+            HMAP_FOR_EACH (m, hmap_node, &f->deleted) {
+                if (!ok || expr_matches_contains(&others, m)) {
+                    ok = false;
+                    break;
+                }
+            }
+            expr_matches_destroy(&others);
+        }
+    }
+    if (!n_dp_flows) {
+        /* The reference wasn't found in the match. */
+        ok = false;
+    }
+
+    for (size_t i = 0; i < n_dp_flows; i++) {
+        struct const_set_flows *f = &dp_flows[i];
+
+        if (ok) {
+            struct expr_match *m;
+            HMAP_FOR_EACH (m, hmap_node, &f->deleted) {
+                match_set_metadata(&m->match, htonll(f->dp->tunnel_key));
+                if (!ofctrl_remove_flow(l_ctx_out->flow_table, ptable,
+                                        lflow->priority, &m->match,
+                                        &lflow->header_.uuid)) {
+                    /* The flows of 'lflow' are not the ones expected, so
+                     * they have to be replaced altogether. */
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        if (ok) {
+            add_matches_to_flow_table(lflow, f->dp, &f->added, ptable,
+                                      output_ptable, &ovnacts, ingress,
+                                      l_ctx_in, l_ctx_out);
+        }
+        expr_matches_destroy(&f->added);
+        expr_matches_destroy(&f->deleted);
+    }
+    free(dp_flows);
+
+    expr_destroy(prereqs);
+    ovnacts_free(ovnacts.data, ovnacts.size);
+    ofpbuf_uninit(&ovnacts);
+    return ok;
+}
+
+/* Handles an update of the address set or port group 'name', depending on
+ * 'ref_type', whose added and deleted constants are in 'diff'.  The logical
+ * flows that use the set are only updated for these constants when possible,
+ * and translated again otherwise. */
+bool
+lflow_handle_const_set_update(enum ref_type ref_type, const char *name,
+                              const struct const_set_diff *diff,
+                              struct lflow_ctx_in *l_ctx_in,
+                              struct lflow_ctx_out *l_ctx_out,
+                              bool *changed)
+{
+    ovs_assert(ref_type == REF_TYPE_ADDRSET
+               || ref_type == REF_TYPE_PORTGROUP);
+    *changed = false;
+
+    struct ref_lflow_node *rlfn =
+        ref_lflow_lookup(&l_ctx_out->lfrr->ref_lflow_table, ref_type, name);
+    if (!rlfn) {
+        return true;
+    }
+    VLOG_DBG("Handle update of resource type: %d, name: %s: %"PRIuSIZE
+             " added, %"PRIuSIZE" deleted.", ref_type, name,
+             diff->added->n_values, diff->deleted->n_values);
+    if (!diff->added->n_values && !diff->deleted->n_values) {
+        return true;
+    }
+
+    /* Translating the logical flows updates 'rlfn', so copy the UUIDs. */
+    size_t n_lflows = hmap_count(&rlfn->lflow_uuids);
+    struct uuid *lflow_uuids = xmalloc(n_lflows * sizeof *lflow_uuids);
+    struct lflow_ref_list_node *lrln;
+    size_t i = 0;
+    HMAP_FOR_EACH (lrln, hmap_node, &rlfn->lflow_uuids) {
+        lflow_uuids[i++] = lrln->lflow_uuid;
+    }
+
+    struct hmap dhcp_opts = HMAP_INITIALIZER(&dhcp_opts);
+    struct hmap dhcpv6_opts = HMAP_INITIALIZER(&dhcpv6_opts);
+    const struct sbrec_dhcp_options *dhcp_opt_row;
+    SBREC_DHCP_OPTIONS_TABLE_FOR_EACH (dhcp_opt_row,
+                                       l_ctx_in->dhcp_options_table) {
+        dhcp_opt_add(&dhcp_opts, dhcp_opt_row->name, dhcp_opt_row->code,
+                     dhcp_opt_row->type);
+    }
+
+    const struct sbrec_dhcpv6_options *dhcpv6_opt_row;
+    SBREC_DHCPV6_OPTIONS_TABLE_FOR_EACH(dhcpv6_opt_row,
+                                        l_ctx_in->dhcpv6_options_table) {
+       dhcp_opt_add(&dhcpv6_opts, dhcpv6_opt_row->name, dhcpv6_opt_row->code,
+                    dhcpv6_opt_row->type);
+    }
+
+    struct hmap nd_ra_opts = HMAP_INITIALIZER(&nd_ra_opts);
+    nd_ra_opts_init(&nd_ra_opts);
+
+    struct controller_event_options controller_event_opts;
+    controller_event_opts_init(&controller_event_opts);
+
+    struct const_set_update update = {
+        .ref_type = ref_type,
+        .name = name,
+        .diff = diff,
+        .copy = SHASH_INITIALIZER(&update.copy),
+        .addr_sets = l_ctx_in->addr_sets,
+        .port_groups = l_ctx_in->port_groups,
+    };
+    const struct shash *const_sets = (ref_type == REF_TYPE_ADDRSET
+                                      ? l_ctx_in->addr_sets
+                                      : l_ctx_in->port_groups);
+    struct shash_node *node;
+    SHASH_FOR_EACH (node, const_sets) {
+        shash_add(&update.copy, node->name, node->data);
+    }
+    if (ref_type == REF_TYPE_ADDRSET) {
+        update.addr_sets = &update.copy;
+    } else {
+        update.port_groups = &update.copy;
+    }
+    if (ref_type == REF_TYPE_ADDRSET) {
+        const struct expr_constant_set *cs = shash_find_data(const_sets,
+                                                             name);
+        size_t n_new = cs ? cs->n_values : 0;
+        size_t n_old = (n_new + diff->deleted->n_values
+                        - diff->added->n_values);
+        update.may_aggregate = expr_may_aggregate(MAX(n_old, n_new));
+    }
+
+    struct hmap flood_remove_nodes = HMAP_INITIALIZER(&flood_remove_nodes);
+    for (i = 0; i < n_lflows; i++) {
+        const struct sbrec_logical_flow *lflow =
+            sbrec_logical_flow_table_get_for_uuid(l_ctx_in->logical_flow_table,
+                                                  &lflow_uuids[i]);
+        if (!lflow) {
+            continue;
+        }
+
+        if (lflow_apply_const_set_diff(lflow, &update, &dhcp_opts,
+                                       &dhcpv6_opts, &nd_ra_opts,
+                                       &controller_event_opts,
+                                       l_ctx_in, l_ctx_out)) {
+            *changed = true;
+        } else {
+            VLOG_DBG("Reprocess lflow "UUID_FMT" for resource type: %d,"
+                     " name: %s.", UUID_ARGS(&lflow_uuids[i]), ref_type,
+                     name);
+            ofctrl_flood_remove_add_node(&flood_remove_nodes,
+                                         &lflow_uuids[i]);
+        }
+    }
+    bool ret = reprocess_lflows(&flood_remove_nodes, &dhcp_opts,
+                                &dhcpv6_opts, &nd_ra_opts,
+                                &controller_event_opts, l_ctx_in, l_ctx_out,
+                                changed);
+
+    shash_destroy(&update.copy);
+    free(lflow_uuids);
+    dhcp_opts_destroy(&dhcp_opts);
+    dhcp_opts_destroy(&dhcpv6_opts);
+    nd_ra_opts_destroy(&nd_ra_opts);
+    controller_event_opts_destroy(&controller_event_opts);
+    return ret;
+}
+
+static void
+put_load(const uint8_t *data, size_t len,
+         enum mf_field_id dst, int ofs, int n_bits,
+         struct ofpbuf *ofpacts)
+{
+    struct ofpact_set_field *sf = ofpact_put_set_field(ofpacts,
+                                                       mf_from_id(dst), NULL,
+                                                       NULL);
+    bitwise_copy(data, len, 0, sf->value, sf->field->n_bytes, ofs, n_bits);
     bitwise_one(ofpact_set_field_mask(sf), sf->field->n_bytes, ofs, n_bits);
 }
 
@@ -1113,19 +1970,44 @@ consider_neighbor_flow(struct ovsdb_idl_index *sbrec_port_binding_by_name,
     ofpbuf_uninit(&ofpacts);
 }
 
-/* Adds an OpenFlow flow to flow tables for each MAC binding in the OVN
- * southbound database. */
+/* Adds an OpenFlow flow to flow tables for each MAC binding of 'dp' in the
+ * OVN southbound database. */
 static void
-add_neighbor_flows(struct ovsdb_idl_index *sbrec_port_binding_by_name,
-                   const struct sbrec_mac_binding_table *mac_binding_table,
-                   const struct hmap *local_datapaths,
-                   struct ovn_desired_flow_table *flow_table)
+add_neighbor_flows_for_datapath(
+    struct ovsdb_idl_index *sbrec_port_binding_by_name,
+    struct ovsdb_idl_index *sbrec_mac_binding_by_datapath,
+    const struct sbrec_datapath_binding *dp,
+    const struct hmap *local_datapaths,
+    struct ovn_desired_flow_table *flow_table)
 {
+    struct sbrec_mac_binding *mb_row = sbrec_mac_binding_index_init_row(
+        sbrec_mac_binding_by_datapath);
+    sbrec_mac_binding_index_set_datapath(mb_row, dp);
+
     const struct sbrec_mac_binding *b;
-    SBREC_MAC_BINDING_TABLE_FOR_EACH (b, mac_binding_table) {
+    SBREC_MAC_BINDING_FOR_EACH_EQUAL (b, mb_row,
+                                      sbrec_mac_binding_by_datapath) {
         consider_neighbor_flow(sbrec_port_binding_by_name, local_datapaths,
                                b, flow_table);
     }
+    sbrec_mac_binding_index_destroy_row(mb_row);
+}
+
+/* Adds an OpenFlow flow to flow tables for each MAC binding of the local
+ * datapaths in the OVN southbound database. */
+static void
+add_neighbor_flows(struct ovsdb_idl_index *sbrec_port_binding_by_name,
+                   struct ovsdb_idl_index *sbrec_mac_binding_by_datapath,
+                   const struct hmap *local_datapaths,
+                   struct ovn_desired_flow_table *flow_table)
+{
+    const struct local_datapath *ld;
+    HMAP_FOR_EACH (ld, hmap_node, local_datapaths) {
+        add_neighbor_flows_for_datapath(sbrec_port_binding_by_name,
+                                        sbrec_mac_binding_by_datapath,
+                                        ld->datapath, local_datapaths,
+                                        flow_table);
+    }
 }
 
 /* Builds the "learn()" action to be triggered by packets initiating a
@@ -1300,7 +2182,7 @@ add_lb_vip_hairpin_reply_action(struct in6_addr *vip6, ovs_be32 vip,
     ofpact_finish_LEARN(ofpacts, &ol);
 }
 
-/* Adds flows to detect hairpin sessions.
+/* Adds flows to detect hairpin sessions, for each backend of 'lb_vip'.
  *
  * For backwards compatibilty with older ovn-northd versions, uses
  * ct_nw_dst(), ct_ipv6_dst(), ct_tp_dst(), otherwise uses the
@@ -1309,87 +2191,59 @@ add_lb_vip_hairpin_reply_action(struct in6_addr *vip6, ovs_be32 vip,
 static void
 add_lb_vip_hairpin_flows(struct ovn_controller_lb *lb,
                          struct ovn_lb_vip *lb_vip,
-                         struct ovn_lb_backend *lb_backend,
                          uint8_t lb_proto,
                          struct ovn_desired_flow_table *flow_table)
 {
-    uint64_t stub[1024 / 8];
-    struct ofpbuf ofpacts = OFPBUF_STUB_INITIALIZER(stub);
-    struct match hairpin_match = MATCH_CATCHALL_INITIALIZER;
-
-    uint8_t value = 1;
-    put_load(&value, sizeof value, MFF_LOG_FLAGS,
-             MLF_LOOKUP_LB_HAIRPIN_BIT, 1, &ofpacts);
+    /* The actions only depend on whether the backend has an L4 port, so
+     * they are built at most twice per VIP, not once per backend. */
+    uint64_t stub[2][1024 / 8];
+    struct ofpbuf ofpacts[2] = {
+        OFPBUF_STUB_INITIALIZER(stub[0]),
+        OFPBUF_STUB_INITIALIZER(stub[1]),
+    };
+    struct match vip_match = MATCH_CATCHALL_INITIALIZER;
+    bool is_ipv4 = IN6_IS_ADDR_V4MAPPED(&lb_vip->vip);
+    struct in6_addr *snat_vip6 = NULL;
+    ovs_be32 snat_vip4 = 0;
 
     /* Matching on ct_nw_dst()/ct_ipv6_dst()/ct_tp_dst() requires matching
      * on ct_state first.
      */
     if (!lb->hairpin_orig_tuple) {
         uint32_t ct_state = OVS_CS_F_TRACKED | OVS_CS_F_DST_NAT;
-        match_set_ct_state_masked(&hairpin_match, ct_state, ct_state);
+        match_set_ct_state_masked(&vip_match, ct_state, ct_state);
     }
 
-    if (IN6_IS_ADDR_V4MAPPED(&lb_vip->vip)) {
-        ovs_be32 bip4 = in6_addr_get_mapped_ipv4(&lb_backend->ip);
+    if (is_ipv4) {
         ovs_be32 vip4 = in6_addr_get_mapped_ipv4(&lb_vip->vip);
-        ovs_be32 snat_vip4 = lb->hairpin_snat_ips.n_ipv4_addrs
-                        ? lb->hairpin_snat_ips.ipv4_addrs[0].addr
-                        : vip4;
-
-        match_set_dl_type(&hairpin_match, htons(ETH_TYPE_IP));
-        match_set_nw_src(&hairpin_match, bip4);
-        match_set_nw_dst(&hairpin_match, bip4);
+        snat_vip4 = lb->hairpin_snat_ips.n_ipv4_addrs
+                    ? lb->hairpin_snat_ips.ipv4_addrs[0].addr
+                    : vip4;
 
+        match_set_dl_type(&vip_match, htons(ETH_TYPE_IP));
         if (!lb->hairpin_orig_tuple) {
-            match_set_ct_nw_dst(&hairpin_match, vip4);
+            match_set_ct_nw_dst(&vip_match, vip4);
         } else {
-            match_set_reg(&hairpin_match,
+            match_set_reg(&vip_match,
                           MFF_LOG_LB_ORIG_DIP_IPV4 - MFF_LOG_REG0,
                           ntohl(vip4));
         }
-
-        add_lb_vip_hairpin_reply_action(NULL, snat_vip4, lb_proto,
-                                        lb_backend->port,
-                                        lb->slb->header_.uuid.parts[0],
-                                        &ofpacts);
     } else {
-        struct in6_addr *bip6 = &lb_backend->ip;
-        struct in6_addr *snat_vip6 =
-            lb->hairpin_snat_ips.n_ipv6_addrs
-            ? &lb->hairpin_snat_ips.ipv6_addrs[0].addr
-            : &lb_vip->vip;
-        match_set_dl_type(&hairpin_match, htons(ETH_TYPE_IPV6));
-        match_set_ipv6_src(&hairpin_match, bip6);
-        match_set_ipv6_dst(&hairpin_match, bip6);
+        snat_vip6 = lb->hairpin_snat_ips.n_ipv6_addrs
+                    ? &lb->hairpin_snat_ips.ipv6_addrs[0].addr
+                    : &lb_vip->vip;
 
+        match_set_dl_type(&vip_match, htons(ETH_TYPE_IPV6));
         if (!lb->hairpin_orig_tuple) {
-            match_set_ct_ipv6_dst(&hairpin_match, &lb_vip->vip);
+            match_set_ct_ipv6_dst(&vip_match, &lb_vip->vip);
         } else {
             ovs_be128 vip6_value;
 
             memcpy(&vip6_value, &lb_vip->vip, sizeof vip6_value);
-            match_set_xxreg(&hairpin_match,
+            match_set_xxreg(&vip_match,
                             MFF_LOG_LB_ORIG_DIP_IPV6 - MFF_LOG_XXREG0,
                             ntoh128(vip6_value));
         }
-
-        add_lb_vip_hairpin_reply_action(snat_vip6, 0, lb_proto,
-                                        lb_backend->port,
-                                        lb->slb->header_.uuid.parts[0],
-                                        &ofpacts);
-    }
-
-    if (lb_backend->port) {
-        match_set_nw_proto(&hairpin_match, lb_proto);
-        match_set_tp_dst(&hairpin_match, htons(lb_backend->port));
-        if (!lb->hairpin_orig_tuple) {
-            match_set_ct_nw_proto(&hairpin_match, lb_proto);
-            match_set_ct_tp_dst(&hairpin_match, htons(lb_vip->vip_port));
-        } else {
-            match_set_reg_masked(&hairpin_match,
-                                 MFF_LOG_LB_ORIG_TP_DPORT - MFF_REG0,
-                                 lb_vip->vip_port, UINT16_MAX);
-        }
     }
 
     /* In the original direction, only match on traffic that was already
@@ -1405,12 +2259,54 @@ add_lb_vip_hairpin_flows(struct ovn_controller_lb *lb,
     ovs_u128 lb_ct_label = {
         .u64.lo = OVN_CT_NATTED,
     };
-    match_set_ct_label_masked(&hairpin_match, lb_ct_label, lb_ct_label);
+    match_set_ct_label_masked(&vip_match, lb_ct_label, lb_ct_label);
+
+    for (size_t i = 0; i < lb_vip->n_backends; i++) {
+        struct ovn_lb_backend *lb_backend = &lb_vip->backends[i];
+        bool has_l4_port = lb_backend->port != 0;
+        struct ofpbuf *actions = &ofpacts[has_l4_port];
+
+        if (!actions->size) {
+            uint8_t value = 1;
+            put_load(&value, sizeof value, MFF_LOG_FLAGS,
+                     MLF_LOOKUP_LB_HAIRPIN_BIT, 1, actions);
+            add_lb_vip_hairpin_reply_action(snat_vip6, snat_vip4, lb_proto,
+                                            has_l4_port,
+                                            lb->slb->header_.uuid.parts[0],
+                                            actions);
+        }
 
-    ofctrl_add_flow(flow_table, OFTABLE_CHK_LB_HAIRPIN, 100,
-                    lb->slb->header_.uuid.parts[0], &hairpin_match,
-                    &ofpacts, &lb->slb->header_.uuid);
-    ofpbuf_uninit(&ofpacts);
+        struct match hairpin_match = vip_match;
+        if (is_ipv4) {
+            ovs_be32 bip4 = in6_addr_get_mapped_ipv4(&lb_backend->ip);
+
+            match_set_nw_src(&hairpin_match, bip4);
+            match_set_nw_dst(&hairpin_match, bip4);
+        } else {
+            match_set_ipv6_src(&hairpin_match, &lb_backend->ip);
+            match_set_ipv6_dst(&hairpin_match, &lb_backend->ip);
+        }
+
+        if (has_l4_port) {
+            match_set_nw_proto(&hairpin_match, lb_proto);
+            match_set_tp_dst(&hairpin_match, htons(lb_backend->port));
+            if (!lb->hairpin_orig_tuple) {
+                match_set_ct_nw_proto(&hairpin_match, lb_proto);
+                match_set_ct_tp_dst(&hairpin_match, htons(lb_vip->vip_port));
+            } else {
+                match_set_reg_masked(&hairpin_match,
+                                     MFF_LOG_LB_ORIG_TP_DPORT - MFF_REG0,
+                                     lb_vip->vip_port, UINT16_MAX);
+            }
+        }
+
+        ofctrl_add_flow(flow_table, OFTABLE_CHK_LB_HAIRPIN, 100,
+                        lb->slb->header_.uuid.parts[0], &hairpin_match,
+                        actions, &lb->slb->header_.uuid);
+    }
+
+    ofpbuf_uninit(&ofpacts[0]);
+    ofpbuf_uninit(&ofpacts[1]);
 }
 
 /* Adds flows to perform SNAT for hairpin sessions.
@@ -1551,13 +2447,7 @@ consider_lb_hairpin_flows(const struct sbrec_load_balancer *sbrec_lb,
     for (i = 0; i < lb->n_vips; i++) {
         struct ovn_lb_vip *lb_vip = &lb->vips[i];
 
-        for (size_t j = 0; j < lb_vip->n_backends; j++) {
-            struct ovn_lb_backend *lb_backend = &lb_vip->backends[j];
-
-            add_lb_vip_hairpin_flows(lb, lb_vip, lb_backend, lb_proto,
-                                     flow_table);
-        }
-
+        add_lb_vip_hairpin_flows(lb, lb_vip, lb_proto, flow_table);
         add_lb_ct_snat_vip_flows(lb, lb_vip, lb_proto, flow_table);
     }
 
@@ -1653,37 +2543,121 @@ consider_fdb_flows(const struct sbrec_fdb *fdb,
     ofpbuf_uninit(&ofpacts);
 }
 
-/* Adds an OpenFlow flow to flow tables for each MAC binding in the OVN
+/* Adds OpenFlow flows to flow tables for each FDB entry of 'dp' in the OVN
  * southbound database. */
 static void
-add_fdb_flows(const struct sbrec_fdb_table *fdb_table,
-              const struct hmap *local_datapaths,
-              struct ovn_desired_flow_table *flow_table)
+add_fdb_flows_for_datapath(struct ovsdb_idl_index *sbrec_fdb_by_dp_key,
+                           const struct sbrec_datapath_binding *dp,
+                           const struct hmap *local_datapaths,
+                           struct ovn_desired_flow_table *flow_table)
 {
+    struct sbrec_fdb *fdb_row = sbrec_fdb_index_init_row(sbrec_fdb_by_dp_key);
+    sbrec_fdb_index_set_dp_key(fdb_row, dp->tunnel_key);
+
     const struct sbrec_fdb *fdb;
-    SBREC_FDB_TABLE_FOR_EACH (fdb, fdb_table) {
+    SBREC_FDB_FOR_EACH_EQUAL (fdb, fdb_row, sbrec_fdb_by_dp_key) {
         consider_fdb_flows(fdb, local_datapaths, flow_table);
     }
+    sbrec_fdb_index_destroy_row(fdb_row);
+}
+
+/* Adds OpenFlow flows to flow tables for each FDB entry of the local
+ * datapaths in the OVN southbound database. */
+static void
+add_fdb_flows(struct ovsdb_idl_index *sbrec_fdb_by_dp_key,
+              const struct hmap *local_datapaths,
+              struct ovn_desired_flow_table *flow_table)
+{
+    const struct local_datapath *ld;
+    HMAP_FOR_EACH (ld, hmap_node, local_datapaths) {
+        add_fdb_flows_for_datapath(sbrec_fdb_by_dp_key, ld->datapath,
+                                   local_datapaths, flow_table);
+    }
 }
 
 
 /* Translates logical flows in the Logical_Flow table in the OVN_SB database
  * into OpenFlow flows.  See ovn-architecture(7) for more information. */
+static bool
+lflow_exists(const struct uuid *lflow_uuid, const void *flow_table)
+{
+    return sbrec_logical_flow_table_get_for_uuid(flow_table, lflow_uuid);
+}
+
 void
 lflow_run(struct lflow_ctx_in *l_ctx_in, struct lflow_ctx_out *l_ctx_out)
 {
     COVERAGE_INC(lflow_run);
 
     add_logical_flows(l_ctx_in, l_ctx_out);
+
+    /* Deletions are not tracked across reconnections to the SB database, so
+     * drop the conjunction ids of the logical flows that are gone. */
+    lflow_conj_ids_sweep(l_ctx_out->conj_ids, lflow_exists,
+                         l_ctx_in->logical_flow_table);
     add_neighbor_flows(l_ctx_in->sbrec_port_binding_by_name,
-                       l_ctx_in->mac_binding_table, l_ctx_in->local_datapaths,
-                       l_ctx_out->flow_table);
+                       l_ctx_in->sbrec_mac_binding_by_datapath,
+                       l_ctx_in->local_datapaths, l_ctx_out->flow_table);
     add_lb_hairpin_flows(l_ctx_in->lb_table, l_ctx_in->local_datapaths,
                          l_ctx_out->flow_table);
-    add_fdb_flows(l_ctx_in->fdb_table, l_ctx_in->local_datapaths,
+    add_fdb_flows(l_ctx_in->sbrec_fdb_by_dp_key, l_ctx_in->local_datapaths,
                   l_ctx_out->flow_table);
 }
 
+/* Finds the conjunction ids used by 'matches', which were translated from a
+ * logical flow with conj_id_ofs + 1 to conj_id_ofs + n_conjs.  Returns false
+ * if they don't use any. */
+static bool
+expr_matches_get_conj_ids(const struct hmap *matches, uint32_t *conj_id_ofs,
+                          uint32_t *n_conjs)
+{
+    uint32_t min_id = UINT32_MAX;
+    uint32_t max_id = 0;
+    const struct expr_match *m;
+
+    HMAP_FOR_EACH (m, hmap_node, matches) {
+        if (m->match.wc.masks.conj_id) {
+            min_id = MIN(min_id, m->match.flow.conj_id);
+            max_id = MAX(max_id, m->match.flow.conj_id);
+        }
+        for (size_t i = 0; i < m->n; i++) {
+            min_id = MIN(min_id, m->conjunctions[i].id);
+            max_id = MAX(max_id, m->conjunctions[i].id);
+        }
+    }
+    if (!max_id) {
+        return false;
+    }
+    *conj_id_ofs = min_id - 1;
+    *n_conjs = max_id - min_id + 1;
+    return true;
+}
+
+/* Reserves the conjunction ids used by the matches that lflow_cache_load()
+ * restored, before any is allocated again.  The cache entries whose ids are
+ * already taken are dropped. */
+void
+lflow_reserve_cached_conj_ids(
+    struct lflow_cache *lc, struct lflow_conj_ids *conj_ids,
+    const struct sbrec_logical_flow_table *flow_table)
+{
+    const struct sbrec_logical_flow *lflow;
+
+    SBREC_LOGICAL_FLOW_TABLE_FOR_EACH (lflow, flow_table) {
+        const struct lflow_cache_value *lcv
+            = lflow_cache_peek(lc, &lflow->header_.uuid);
+        uint32_t conj_id_ofs, n_conjs;
+
+        if (lcv && lcv->type == LCACHE_T_MATCHES
+            && expr_matches_get_conj_ids(lcv->expr_matches, &conj_id_ofs,
+                                         &n_conjs)
+            && !lflow_conj_ids_reserve(conj_ids, &lflow->header_.uuid,
+                                       conj_id_ofs, n_conjs)) {
+            lflow_cache_delete(lc, &lflow->header_.uuid);
+        }
+    }
+}
+
 /* Should be called at every ovn-controller iteration before IDL tracked
  * changes are cleared to avoid maintaining cache entries for flows that
  * don't exist anymore.
@@ -1701,11 +2675,75 @@ lflow_handle_cached_flows(struct lflow_cache *lc,
     }
 }
 
+/* Adds to 'hash' the datapath 'dp' of 'lflow' and the tunnel keys that
+ * lookup_port_cb() resolves the port names of its match to on 'dp'.  These
+ * keys are part of the cached matches.  Strings in the matches that are
+ * cached are port names: is_chassis_resident() conditions prevent it. */
+static uint32_t
+lflow_cache_fingerprint_dp(const struct sbrec_logical_flow *lflow,
+                           const struct sbrec_datapath_binding *dp,
+                           const struct lflow_cache_fingerprint_aux *aux,
+                           uint32_t hash)
+{
+    struct lookup_port_aux lp_aux = {
+        .sbrec_multicast_group_by_name_datapath
+            = aux->sbrec_multicast_group_by_name_datapath,
+        .sbrec_port_binding_by_name = aux->sbrec_port_binding_by_name,
+        .dp = dp,
+    };
+    struct lexer lexer;
+
+    hash = hash_int(dp->tunnel_key, hash);
+    lexer_init(&lexer, lflow->match);
+    for (lexer_get(&lexer);
+         lexer.token.type != LEX_T_END && lexer.token.type != LEX_T_ERROR;
+         lexer_get(&lexer)) {
+        if (lexer.token.type == LEX_T_STRING) {
+            unsigned int port;
+            if (!lookup_port_cb(&lp_aux, lexer.token.s, &port)) {
+                port = UINT_MAX;
+            }
+            hash = hash_int(port, hash);
+        }
+    }
+    lexer_destroy(&lexer);
+    return hash;
+}
+
+/* Implements lflow_cache_fingerprint_cb for lflow cache snapshots.  'aux'
+ * is a 'struct lflow_cache_fingerprint_aux'. */
+bool
+lflow_cache_fingerprint(const struct uuid *lflow_uuid, const void *aux_,
+                        uint32_t *fingerprint)
+{
+    const struct lflow_cache_fingerprint_aux *aux = aux_;
+    const struct sbrec_logical_flow *lflow
+        = sbrec_logical_flow_table_get_for_uuid(aux->logical_flow_table,
+                                                lflow_uuid);
+    if (!lflow) {
+        return false;
+    }
+
+    uint32_t hash = match_expr_hash(lflow);
+    if (lflow->logical_datapath) {
+        hash = lflow_cache_fingerprint_dp(lflow, lflow->logical_datapath,
+                                          aux, hash);
+    }
+
+    const struct sbrec_logical_dp_group *dp_group = lflow->logical_dp_group;
+    for (size_t i = 0; dp_group && i < dp_group->n_datapaths; i++) {
+        hash = lflow_cache_fingerprint_dp(lflow, dp_group->datapaths[i],
+                                          aux, hash);
+    }
+    *fingerprint = hash;
+    return true;
+}
+
 void
 lflow_destroy(void)
 {
-    expr_symtab_destroy(&symtab);
-    shash_destroy(&symtab);
+    ovn_symtab_unref();
+    symtab = NULL;
 }
 
 bool
@@ -1741,12 +2779,14 @@ lflow_add_flows_for_datapath(const struct sbrec_datapath_binding *dp,
         l_ctx_in->sbrec_logical_flow_by_logical_datapath);
     sbrec_logical_flow_index_set_logical_datapath(lf_row, dp);
 
+    struct hmap lflow_actions = HMAP_INITIALIZER(&lflow_actions);
     const struct sbrec_logical_flow *lflow;
     SBREC_LOGICAL_FLOW_FOR_EACH_EQUAL (
         lflow, lf_row, l_ctx_in->sbrec_logical_flow_by_logical_datapath) {
         if (!consider_logical_flow__(lflow, dp, &dhcp_opts, &dhcpv6_opts,
                                      &nd_ra_opts, &controller_event_opts,
-                                     l_ctx_in, l_ctx_out)) {
+                                     NULL, &lflow_actions, l_ctx_in,
+                                     l_ctx_out)) {
             handled = false;
             l_ctx_out->conj_id_overflow = true;
             goto lflow_processing_end;
@@ -1776,7 +2816,8 @@ lflow_add_flows_for_datapath(const struct sbrec_datapath_binding *dp,
             lflow, lf_row, l_ctx_in->sbrec_logical_flow_by_logical_dp_group) {
             if (!consider_logical_flow__(lflow, dp, &dhcp_opts, &dhcpv6_opts,
                                          &nd_ra_opts, &controller_event_opts,
-                                         l_ctx_in, l_ctx_out)) {
+                                         NULL, &lflow_actions, l_ctx_in,
+                                         l_ctx_out)) {
                 handled = false;
                 l_ctx_out->conj_id_overflow = true;
                 goto lflow_processing_end;
@@ -1785,12 +2826,24 @@ lflow_add_flows_for_datapath(const struct sbrec_datapath_binding *dp,
     }
 lflow_processing_end:
     sbrec_logical_flow_index_destroy_row(lf_row);
+    lflow_actions_destroy(&lflow_actions);
 
     dhcp_opts_destroy(&dhcp_opts);
     dhcp_opts_destroy(&dhcpv6_opts);
     nd_ra_opts_destroy(&nd_ra_opts);
     controller_event_opts_destroy(&controller_event_opts);
 
+    /* Add the neighbor flows of the MAC bindings learnt on the datapath. */
+    add_neighbor_flows_for_datapath(l_ctx_in->sbrec_port_binding_by_name,
+                                    l_ctx_in->sbrec_mac_binding_by_datapath,
+                                    dp, l_ctx_in->local_datapaths,
+                                    l_ctx_out->flow_table);
+
+    /* Add the FDB flows of the MACs learnt on the datapath. */
+    add_fdb_flows_for_datapath(l_ctx_in->sbrec_fdb_by_dp_key, dp,
+                               l_ctx_in->local_datapaths,
+                               l_ctx_out->flow_table);
+
     /* Add load balancer hairpin flows if the datapath has any load balancers
      * associated. */
     for (size_t i = 0; i < dp->n_load_balancers; i++) {
@@ -35,10 +35,12 @@
 
 #include <stdint.h>
 #include "lflow-cache.h"
+#include "lflow-conj-ids.h"
 #include "openvswitch/hmap.h"
 #include "openvswitch/uuid.h"
 #include "openvswitch/list.h"
 
+struct expr_constant_set;
 struct ovn_extend_table;
 struct ovsdb_idl_index;
 struct ovn_desired_flow_table;
@@ -123,16 +125,19 @@ struct lflow_resource_ref {
 void lflow_resource_init(struct lflow_resource_ref *);
 void lflow_resource_destroy(struct lflow_resource_ref *);
 void lflow_resource_clear(struct lflow_resource_ref *);
+void lflow_resource_get_memory_usage(const struct lflow_resource_ref *,
+                                     struct simap *usage);
 
 struct lflow_ctx_in {
     struct ovsdb_idl_index *sbrec_multicast_group_by_name_datapath;
     struct ovsdb_idl_index *sbrec_logical_flow_by_logical_datapath;
     struct ovsdb_idl_index *sbrec_logical_flow_by_logical_dp_group;
     struct ovsdb_idl_index *sbrec_port_binding_by_name;
+    struct ovsdb_idl_index *sbrec_mac_binding_by_datapath;
+    struct ovsdb_idl_index *sbrec_fdb_by_dp_key;
     const struct sbrec_dhcp_options_table *dhcp_options_table;
     const struct sbrec_dhcpv6_options_table *dhcpv6_options_table;
     const struct sbrec_datapath_binding_table *dp_binding_table;
-    const struct sbrec_mac_binding_table *mac_binding_table;
     const struct sbrec_logical_flow_table *logical_flow_table;
     const struct sbrec_logical_dp_group_table *logical_dp_group_table;
     const struct sbrec_multicast_group_table *mc_group_table;
@@ -152,18 +157,45 @@ struct lflow_ctx_out {
     struct ovn_extend_table *meter_table;
     struct lflow_resource_ref *lfrr;
     struct lflow_cache *lflow_cache;
-    uint32_t *conj_id_ofs;
+    struct lflow_conj_ids *conj_ids;
     bool conj_id_overflow;
 };
 
 void lflow_init(void);
+void lflow_set_parallel_parsing(bool enabled);
+void lflow_set_bfd_controller_id(uint16_t controller_id);
 void lflow_run(struct lflow_ctx_in *, struct lflow_ctx_out *);
 void lflow_handle_cached_flows(struct lflow_cache *,
                                const struct sbrec_logical_flow_table *);
+
+/* Auxiliary data for lflow_cache_fingerprint(). */
+struct lflow_cache_fingerprint_aux {
+    const struct sbrec_logical_flow_table *logical_flow_table;
+    struct ovsdb_idl_index *sbrec_port_binding_by_name;
+    struct ovsdb_idl_index *sbrec_multicast_group_by_name_datapath;
+};
+
+bool lflow_cache_fingerprint(const struct uuid *lflow_uuid, const void *aux,
+                             uint32_t *fingerprint);
+void lflow_reserve_cached_conj_ids(struct lflow_cache *,
+                                   struct lflow_conj_ids *,
+                                   const struct sbrec_logical_flow_table *);
 bool lflow_handle_changed_flows(struct lflow_ctx_in *, struct lflow_ctx_out *);
 bool lflow_handle_changed_ref(enum ref_type, const char *ref_name,
                               struct lflow_ctx_in *, struct lflow_ctx_out *,
                               bool *changed);
+
+/* The constants added to and deleted from an address set or a port group by
+ * an update. */
+struct const_set_diff {
+    struct expr_constant_set *added;
+    struct expr_constant_set *deleted;
+};
+bool lflow_handle_const_set_update(enum ref_type, const char *name,
+                                   const struct const_set_diff *,
+                                   struct lflow_ctx_in *,
+                                   struct lflow_ctx_out *,
+                                   bool *changed);
 void lflow_handle_changed_neighbors(
     struct ovsdb_idl_index *sbrec_port_binding_by_name,
     const struct sbrec_mac_binding_table *,
@@ -18,51 +18,70 @@
 #include "mac-learn.h"
 
 /* OpenvSwitch lib includes. */
+#include "coverage.h"
 #include "openvswitch/vlog.h"
 #include "lib/packets.h"
 #include "lib/smap.h"
 
 VLOG_DEFINE_THIS_MODULE(mac_learn);
 
+COVERAGE_DEFINE(mac_learn_evict_mac_binding);
+COVERAGE_DEFINE(mac_learn_evict_fdb);
+
 #define MAX_MAC_BINDINGS 1000
 #define MAX_FDB_ENTRIES  1000
 
 static size_t mac_binding_hash(uint32_t dp_key, uint32_t port_key,
                                struct in6_addr *);
-static struct mac_binding *mac_binding_find(struct hmap *mac_bindings,
+static struct mac_binding *mac_binding_find(struct mac_binding_table *,
                                             uint32_t dp_key,
                                             uint32_t port_key,
                                             struct in6_addr *ip, size_t hash);
 static size_t fdb_entry_hash(uint32_t dp_key, struct eth_addr *);
 
-static struct fdb_entry *fdb_entry_find(struct hmap *fdbs, uint32_t dp_key,
+static struct fdb_entry *fdb_entry_find(struct fdb_table *, uint32_t dp_key,
                                         struct eth_addr *mac, size_t hash);
 
 /* mac_binding functions. */
 void
-ovn_mac_bindings_init(struct hmap *mac_bindings)
+ovn_mac_bindings_init(struct mac_binding_table *mac_bindings)
 {
-    hmap_init(mac_bindings);
+    hmap_init(&mac_bindings->bindings);
+    ovs_list_init(&mac_bindings->lru);
 }
 
 void
-ovn_mac_bindings_flush(struct hmap *mac_bindings)
+ovn_mac_bindings_flush(struct mac_binding_table *mac_bindings)
 {
     struct mac_binding *mb;
-    HMAP_FOR_EACH_POP (mb, hmap_node, mac_bindings) {
+    HMAP_FOR_EACH_POP (mb, hmap_node, &mac_bindings->bindings) {
         free(mb);
     }
+    ovs_list_init(&mac_bindings->lru);
 }
 
 void
-ovn_mac_bindings_destroy(struct hmap *mac_bindings)
+ovn_mac_bindings_destroy(struct mac_binding_table *mac_bindings)
 {
     ovn_mac_bindings_flush(mac_bindings);
-    hmap_destroy(mac_bindings);
+    hmap_destroy(&mac_bindings->bindings);
+}
+
+/* Exchanges the bindings of 'a' and 'b', without copying them. */
+void
+ovn_mac_bindings_swap(struct mac_binding_table *a,
+                      struct mac_binding_table *b)
+{
+    struct ovs_list tmp;
+
+    hmap_swap(&a->bindings, &b->bindings);
+    ovs_list_move(&tmp, &a->lru);
+    ovs_list_move(&a->lru, &b->lru);
+    ovs_list_move(&b->lru, &tmp);
 }
 
 struct mac_binding *
-ovn_mac_binding_add(struct hmap *mac_bindings, uint32_t dp_key,
+ovn_mac_binding_add(struct mac_binding_table *mac_bindings, uint32_t dp_key,
                     uint32_t port_key, struct in6_addr *ip,
                     struct eth_addr mac)
 {
@@ -70,83 +89,129 @@ ovn_mac_binding_add(struct hmap *mac_bindings, uint32_t dp_key,
 
     struct mac_binding *mb =
         mac_binding_find(mac_bindings, dp_key, port_key, ip, hash);
-    if (!mb) {
-        if (hmap_count(mac_bindings) >= MAX_MAC_BINDINGS) {
-            return NULL;
+    if (mb) {
+        ovs_list_remove(&mb->list_node);
+    } else {
+        if (hmap_count(&mac_bindings->bindings) >= MAX_MAC_BINDINGS) {
+            /* Reuse the least recently learned binding. */
+            mb = CONTAINER_OF(ovs_list_pop_front(&mac_bindings->lru),
+                              struct mac_binding, list_node);
+            hmap_remove(&mac_bindings->bindings, &mb->hmap_node);
+            COVERAGE_INC(mac_learn_evict_mac_binding);
+        } else {
+            mb = xmalloc(sizeof *mb);
         }
-
-        mb = xmalloc(sizeof *mb);
         mb->dp_key = dp_key;
         mb->port_key = port_key;
         mb->ip = *ip;
-        hmap_insert(mac_bindings, &mb->hmap_node, hash);
+        hmap_insert(&mac_bindings->bindings, &mb->hmap_node, hash);
     }
+    ovs_list_push_back(&mac_bindings->lru, &mb->list_node);
     mb->mac = mac;
 
     return mb;
 }
 
+struct mac_binding *
+ovn_mac_binding_find(struct mac_binding_table *mac_bindings, uint32_t dp_key,
+                     uint32_t port_key, struct in6_addr *ip)
+{
+    return mac_binding_find(mac_bindings, dp_key, port_key, ip,
+                            mac_binding_hash(dp_key, port_key, ip));
+}
+
 /* fdb functions. */
 void
-ovn_fdb_init(struct hmap *fdbs)
+ovn_fdb_init(struct fdb_table *fdbs)
 {
-    hmap_init(fdbs);
+    hmap_init(&fdbs->entries);
+    ovs_list_init(&fdbs->lru);
 }
 
 void
-ovn_fdbs_flush(struct hmap *fdbs)
+ovn_fdbs_flush(struct fdb_table *fdbs)
 {
     struct fdb_entry *fdb_e;
-    HMAP_FOR_EACH_POP (fdb_e, hmap_node, fdbs) {
+    HMAP_FOR_EACH_POP (fdb_e, hmap_node, &fdbs->entries) {
         free(fdb_e);
     }
+    ovs_list_init(&fdbs->lru);
 }
 
 void
-ovn_fdbs_destroy(struct hmap *fdbs)
+ovn_fdbs_destroy(struct fdb_table *fdbs)
 {
    ovn_fdbs_flush(fdbs);
-   hmap_destroy(fdbs);
+   hmap_destroy(&fdbs->entries);
+}
+
+/* Exchanges the entries of 'a' and 'b', without copying them. */
+void
+ovn_fdbs_swap(struct fdb_table *a, struct fdb_table *b)
+{
+    struct ovs_list tmp;
+
+    hmap_swap(&a->entries, &b->entries);
+    ovs_list_move(&tmp, &a->lru);
+    ovs_list_move(&a->lru, &b->lru);
+    ovs_list_move(&b->lru, &tmp);
 }
 
 struct fdb_entry *
-ovn_fdb_add(struct hmap *fdbs, uint32_t dp_key, struct eth_addr mac,
+ovn_fdb_add(struct fdb_table *fdbs, uint32_t dp_key, struct eth_addr mac,
             uint32_t port_key)
 {
     uint32_t hash = fdb_entry_hash(dp_key, &mac);
 
     struct fdb_entry *fdb_e =
         fdb_entry_find(fdbs, dp_key, &mac, hash);
-    if (!fdb_e) {
-        if (hmap_count(fdbs) >= MAX_FDB_ENTRIES) {
-            return NULL;
+    if (fdb_e) {
+        ovs_list_remove(&fdb_e->list_node);
+    } else {
+        if (hmap_count(&fdbs->entries) >= MAX_FDB_ENTRIES) {
+            /* Reuse the least recently learned entry. */
+            fdb_e = CONTAINER_OF(ovs_list_pop_front(&fdbs->lru),
+                                 struct fdb_entry, list_node);
+            hmap_remove(&fdbs->entries, &fdb_e->hmap_node);
+            COVERAGE_INC(mac_learn_evict_fdb);
+        } else {
+            fdb_e = xzalloc(sizeof *fdb_e);
         }
-
-        fdb_e = xzalloc(sizeof *fdb_e);
         fdb_e->dp_key = dp_key;
         fdb_e->mac = mac;
-        hmap_insert(fdbs, &fdb_e->hmap_node, hash);
+        hmap_insert(&fdbs->entries, &fdb_e->hmap_node, hash);
     }
+    ovs_list_push_back(&fdbs->lru, &fdb_e->list_node);
     fdb_e->port_key = port_key;
 
     return fdb_e;
 
 }
 
+struct fdb_entry *
+ovn_fdb_find(struct fdb_table *fdbs, uint32_t dp_key, struct eth_addr mac)
+{
+    return fdb_entry_find(fdbs, dp_key, &mac, fdb_entry_hash(dp_key, &mac));
+}
+
 /* mac_binding related static functions. */
 
+/* Hashes the address as 4 words rather than as bytes, which is cheaper for
+ * the many bindings a gateway learns. */
 static size_t
 mac_binding_hash(uint32_t dp_key, uint32_t port_key, struct in6_addr *ip)
 {
-    return hash_bytes(ip, sizeof *ip, hash_2words(dp_key, port_key));
+    return hash_words(ALIGNED_CAST(const uint32_t *, ip->s6_addr),
+                      sizeof *ip / sizeof(uint32_t),
+                      hash_2words(dp_key, port_key));
 }
 
 static struct mac_binding *
-mac_binding_find(struct hmap *mac_bindings, uint32_t dp_key,
+mac_binding_find(struct mac_binding_table *mac_bindings, uint32_t dp_key,
                    uint32_t port_key, struct in6_addr *ip, size_t hash)
 {
     struct mac_binding *mb;
-    HMAP_FOR_EACH_WITH_HASH (mb, hmap_node, hash, mac_bindings) {
+    HMAP_FOR_EACH_WITH_HASH (mb, hmap_node, hash, &mac_bindings->bindings) {
         if (mb->dp_key == dp_key && mb->port_key == port_key &&
             IN6_ARE_ADDR_EQUAL(&mb->ip, ip)) {
             return mb;
@@ -161,16 +226,15 @@ mac_binding_find(struct hmap *mac_bindings, uint32_t dp_key,
 static size_t
 fdb_entry_hash(uint32_t dp_key, struct eth_addr *mac)
 {
-    uint64_t mac64 = eth_addr_to_uint64(*mac);
-    return hash_2words(dp_key, hash_uint64(mac64));
+    return hash_uint64_basis(eth_addr_to_uint64(*mac), dp_key);
 }
 
 static struct fdb_entry *
-fdb_entry_find(struct hmap *fdbs, uint32_t dp_key,
+fdb_entry_find(struct fdb_table *fdbs, uint32_t dp_key,
                struct eth_addr *mac, size_t hash)
 {
     struct fdb_entry *fdb_e;
-    HMAP_FOR_EACH_WITH_HASH (fdb_e, hmap_node, hash, fdbs) {
+    HMAP_FOR_EACH_WITH_HASH (fdb_e, hmap_node, hash, &fdbs->entries) {
         if (fdb_e->dp_key == dp_key && eth_addr_equals(fdb_e->mac, *mac)) {
             return fdb_e;
         }
@@ -20,9 +20,11 @@
 #include <sys/types.h>
 #include <netinet/in.h>
 #include "openvswitch/hmap.h"
+#include "openvswitch/list.h"
 
 struct mac_binding {
-    struct hmap_node hmap_node; /* In a hmap. */
+    struct hmap_node hmap_node; /* In mac_binding_table's 'bindings'. */
+    struct ovs_list list_node;  /* In mac_binding_table's 'lru'. */
 
     /* Key. */
     uint32_t dp_key;
@@ -33,19 +35,32 @@ struct mac_binding {
     struct eth_addr mac;
 };
 
-void ovn_mac_bindings_init(struct hmap *mac_bindings);
-void ovn_mac_bindings_flush(struct hmap *mac_bindings);
-void ovn_mac_bindings_destroy(struct hmap *mac_bindings);
+/* Bounded table of learned MAC bindings.  Once it is full, learning a new
+ * binding evicts the one learned or updated least recently. */
+struct mac_binding_table {
+    struct hmap bindings;
+    struct ovs_list lru;        /* Least recently learned first. */
+};
+
+void ovn_mac_bindings_init(struct mac_binding_table *);
+void ovn_mac_bindings_flush(struct mac_binding_table *);
+void ovn_mac_bindings_destroy(struct mac_binding_table *);
+void ovn_mac_bindings_swap(struct mac_binding_table *,
+                           struct mac_binding_table *);
 
-struct mac_binding *ovn_mac_binding_add(struct hmap *mac_bindings,
+struct mac_binding *ovn_mac_binding_add(struct mac_binding_table *,
                                         uint32_t dp_key, uint32_t port_key,
                                         struct in6_addr *ip,
                                         struct eth_addr mac);
+struct mac_binding *ovn_mac_binding_find(struct mac_binding_table *,
+                                         uint32_t dp_key, uint32_t port_key,
+                                         struct in6_addr *ip);
 
 
 
 struct fdb_entry {
-    struct hmap_node hmap_node; /* In a hmap. */
+    struct hmap_node hmap_node; /* In fdb_table's 'entries'. */
+    struct ovs_list list_node;  /* In fdb_table's 'lru'. */
 
     /* Key. */
     uint32_t dp_key;
@@ -55,12 +70,22 @@ struct fdb_entry {
     uint32_t port_key;
 };
 
-void ovn_fdb_init(struct hmap *fdbs);
-void ovn_fdbs_flush(struct hmap *fdbs);
-void ovn_fdbs_destroy(struct hmap *fdbs);
+/* Bounded table of learned FDB entries, evicted like the MAC bindings of a
+ * mac_binding_table. */
+struct fdb_table {
+    struct hmap entries;
+    struct ovs_list lru;        /* Least recently learned first. */
+};
+
+void ovn_fdb_init(struct fdb_table *);
+void ovn_fdbs_flush(struct fdb_table *);
+void ovn_fdbs_destroy(struct fdb_table *);
+void ovn_fdbs_swap(struct fdb_table *, struct fdb_table *);
 
-struct fdb_entry *ovn_fdb_add(struct hmap *fdbs,
+struct fdb_entry *ovn_fdb_add(struct fdb_table *,
                                 uint32_t dp_key, struct eth_addr mac,
                                 uint32_t port_key);
+struct fdb_entry *ovn_fdb_find(struct fdb_table *,
+                               uint32_t dp_key, struct eth_addr mac);
 
 #endif /* OVN_MAC_LEARN_H */
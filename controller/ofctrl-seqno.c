@@ -18,6 +18,7 @@
 #include "hash.h"
 #include "ofctrl-seqno.h"
 #include "openvswitch/list.h"
+#include "timeval.h"
 #include "util.h"
 
 /* A sequence number update request, i.e., when the barrier corresponding to
@@ -34,6 +35,10 @@ struct ofctrl_seqno_update {
                                 * application.
                                 */
     uint64_t req_cfg;          /* Application specific seqno. */
+    long long int req_time;    /* When the update was requested. */
+    long long int sent_time;   /* When the flows for 'flow_cfg' were sent to
+                                * OVS, or 0 if not yet. */
+    long long int ack_time;    /* When 'flow_cfg' was acked by OVS. */
 };
 
 /* List of in flight sequence number updates. */
@@ -59,7 +64,7 @@ static struct ofctrl_seqno_state *ofctrl_seqno_states;
 static void ofctrl_acked_seqnos_init(struct ofctrl_acked_seqnos *seqnos,
                                      uint64_t last_acked);
 static void ofctrl_acked_seqnos_add(struct ofctrl_acked_seqnos *seqnos,
-                                    uint32_t val);
+                                    const struct ofctrl_seqno_update *);
 
 /* ofctrl_seqno_update related static function prototypes. */
 static void ofctrl_seqno_update_create__(size_t seqno_type, uint64_t req_cfg);
@@ -82,7 +87,7 @@ ofctrl_acked_seqnos_get(size_t seqno_type)
 
     ovs_assert(seqno_type < n_ofctrl_seqno_states);
     LIST_FOR_EACH_POP (update, list_node, &state->acked_cfgs) {
-        ofctrl_acked_seqnos_add(acked_seqnos, update->req_cfg);
+        ofctrl_acked_seqnos_add(acked_seqnos, update);
         free(update);
     }
     return acked_seqnos;
@@ -107,15 +112,24 @@ ofctrl_acked_seqnos_destroy(struct ofctrl_acked_seqnos *seqnos)
 bool
 ofctrl_acked_seqnos_contains(const struct ofctrl_acked_seqnos *seqnos,
                              uint32_t val)
+{
+    return ofctrl_acked_seqnos_find(seqnos, val) != NULL;
+}
+
+/* Returns the acked sequence number 'val' in 'seqnos', with the times of its
+ * request, or NULL if it was not acked. */
+const struct ofctrl_ack_seqno *
+ofctrl_acked_seqnos_find(const struct ofctrl_acked_seqnos *seqnos,
+                         uint32_t val)
 {
     struct ofctrl_ack_seqno *sn;
 
     HMAP_FOR_EACH_WITH_HASH (sn, node, hash_int(val, 0), &seqnos->acked) {
         if (sn->seqno == val) {
-            return true;
+            return sn;
         }
     }
-    return false;
+    return NULL;
 }
 
 void
@@ -166,6 +180,24 @@ ofctrl_seqno_update_create(size_t seqno_type, uint64_t new_cfg)
     ofctrl_seqno_update_create__(seqno_type, new_cfg);
 }
 
+/* Should be called when all OVS flow updates corresponding to 'flow_cfg' have
+ * been sent to OVS.  Records the time for the pending updates. */
+void
+ofctrl_seqno_sent(uint64_t flow_cfg)
+{
+    long long int now = time_msec();
+    struct ofctrl_seqno_update *update;
+    LIST_FOR_EACH_REVERSE (update, list_node, &ofctrl_seqno_updates) {
+        if (update->flow_cfg > flow_cfg) {
+            continue;
+        }
+        if (update->sent_time) {
+            break;
+        }
+        update->sent_time = now;
+    }
+}
+
 /* Should be called when the application is certain that all OVS flow updates
  * corresponding to 'flow_cfg' were processed.  Populates the application
  * specific lists of acked requests in 'ofctrl_seqno_states'.
@@ -213,13 +245,19 @@ ofctrl_acked_seqnos_init(struct ofctrl_acked_seqnos *seqnos,
 }
 
 static void
-ofctrl_acked_seqnos_add(struct ofctrl_acked_seqnos *seqnos, uint32_t val)
+ofctrl_acked_seqnos_add(struct ofctrl_acked_seqnos *seqnos,
+                        const struct ofctrl_seqno_update *update)
 {
+    uint32_t val = update->req_cfg;
+
     seqnos->last_acked = val;
 
     struct ofctrl_ack_seqno *sn = xmalloc(sizeof *sn);
     hmap_insert(&seqnos->acked, &sn->node, hash_int(val, 0));
     sn->seqno = val;
+    sn->req_time = update->req_time;
+    sn->sent_time = update->sent_time;
+    sn->ack_time = update->ack_time;
 }
 
 static void
@@ -232,6 +270,9 @@ ofctrl_seqno_update_create__(size_t seqno_type, uint64_t req_cfg)
     update->seqno_type = seqno_type;
     update->flow_cfg = ofctrl_req_seqno;
     update->req_cfg = req_cfg;
+    update->req_time = time_msec();
+    update->sent_time = 0;
+    update->ack_time = 0;
 }
 
 static void
@@ -248,6 +289,7 @@ static void
 ofctrl_seqno_cfg_run(size_t seqno_type, struct ofctrl_seqno_update *update)
 {
     ovs_assert(seqno_type < n_ofctrl_seqno_states);
+    update->ack_time = time_msec();
     ovs_list_push_back(&ofctrl_seqno_states[seqno_type].acked_cfgs,
                        &update->list_node);
     ofctrl_seqno_states[seqno_type].cur_cfg = update->req_cfg;
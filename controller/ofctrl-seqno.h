@@ -28,20 +28,30 @@ struct ofctrl_acked_seqnos {
     uint64_t last_acked;
 };
 
-/* Acked application specific seqno.  Stored in ofctrl_acked_seqnos.acked. */
+/* Acked application specific seqno.  Stored in ofctrl_acked_seqnos.acked.
+ *
+ * The times, in ms, are those at which the update was requested, the flows
+ * of the request were sent to OVS (0 if unknown) and the barrier was
+ * replied to. */
 struct ofctrl_ack_seqno {
     struct hmap_node node;
     uint64_t seqno;
+    long long int req_time;
+    long long int sent_time;
+    long long int ack_time;
 };
 
 struct ofctrl_acked_seqnos *ofctrl_acked_seqnos_get(size_t seqno_type);
 void ofctrl_acked_seqnos_destroy(struct ofctrl_acked_seqnos *seqnos);
 bool ofctrl_acked_seqnos_contains(const struct ofctrl_acked_seqnos *seqnos,
                                   uint32_t val);
+const struct ofctrl_ack_seqno *ofctrl_acked_seqnos_find(
+    const struct ofctrl_acked_seqnos *seqnos, uint32_t val);
 
 void ofctrl_seqno_init(void);
 size_t ofctrl_seqno_add_type(void);
 void ofctrl_seqno_update_create(size_t seqno_type, uint64_t new_cfg);
+void ofctrl_seqno_sent(uint64_t flow_cfg);
 void ofctrl_seqno_run(uint64_t flow_cfg);
 uint64_t ofctrl_seqno_get_req_cfg(void);
 void ofctrl_seqno_flush(void);
@@ -16,6 +16,7 @@
 #include <config.h>
 #include "bitmap.h"
 #include "byte-order.h"
+#include "coverage.h"
 #include "dirs.h"
 #include "dp-packet.h"
 #include "flow.h"
@@ -46,12 +47,18 @@
 #include "openvswitch/poll-loop.h"
 #include "physical.h"
 #include "openvswitch/rconn.h"
+#include "simap.h"
+#include "smap.h"
 #include "socket-util.h"
+#include "timeval.h"
 #include "util.h"
 #include "vswitch-idl.h"
 
 VLOG_DEFINE_THIS_MODULE(ofctrl);
 
+COVERAGE_DEFINE(flood_remove);
+COVERAGE_DEFINE(flood_remove_fanout);
+
 /* An OpenFlow flow. */
 struct ovn_flow {
     /* Key. */
@@ -62,12 +69,45 @@ struct ovn_flow {
     /* Hash. */
     uint32_t hash;
 
-    /* Data. */
-    struct ofpact *ofpacts;
+    /* Data.  'ofpacts' is shared by all the flows with the same actions, see
+     * struct ovn_flow_actions. */
+    const struct ofpact *ofpacts;
     size_t ofpacts_len;
     uint64_t cookie;
 };
 
+/* The actions of one or more flows.  Many flows only differ in their match,
+ * e.g. the flows of a logical flow for each of its addresses, so the actions
+ * are interned in 'flow_actions' and shared by the flows, desired or
+ * installed, that have the same actions.  Two flows thus have the same
+ * actions if and only if their 'ofpacts' pointers are equal. */
+struct ovn_flow_actions {
+    struct hmap_node hmap_node;  /* In 'flow_actions'. */
+    size_t refcount;
+    size_t len;
+    uint64_t ofpacts[];          /* 'len' bytes of struct ofpact. */
+};
+
+static struct hmap flow_actions = HMAP_INITIALIZER(&flow_actions);
+static size_t flow_actions_bytes;
+
+/* Allocator for fixed-size objects, which are carved out of big chunks to
+ * avoid the overhead of a heap allocation for each of the millions of flows of
+ * a big deployment.  Freed objects are reused by later allocations.  The
+ * chunks are only released by flow_pool_destroy(). */
+#define FLOW_POOL_CHUNK_SIZE (64 * 1024)
+
+struct flow_pool {
+    size_t obj_size;
+    void *free_objs;            /* Linked through their first pointer. */
+    void *chunks;               /* Linked through their first pointer. */
+    char *next_obj;             /* Unused space in the last chunk. */
+    size_t n_left;              /* Number of objects that fit at 'next_obj'. */
+    size_t n_objs;              /* Number of objects allocated. */
+};
+
+#define FLOW_POOL_INITIALIZER(TYPE) { .obj_size = ROUND_UP(sizeof(TYPE), 8) }
+
 /* A desired flow, in struct ovn_desired_flow_table, calculated by the
  * incremental processing engine.
  * - They are added/removed incrementally when I-P engine is able to process
@@ -169,11 +209,13 @@ struct sb_to_flow {
 struct sb_flow_ref {
     struct ovs_list sb_list; /* List node in desired_flow.references. */
     struct ovs_list flow_list; /* List node in sb_to_flow.desired_flows. */
+    struct hmap_node match_uuid_hmap_node; /* In ovn_desired_flow_table's
+                                            * match_uuid_table. */
     struct desired_flow *flow;
     struct uuid sb_uuid;
 };
 
-/* A installed flow, in static variable installed_flows.
+/* A installed flow, in static variable installed_lflows or installed_pflows.
  *
  * Installed flows are updated in ofctrl_put for maintaining the flow
  * installation to OVS. They are updated according to desired flows: either by
@@ -212,6 +254,42 @@ struct installed_flow {
     struct ovs_list desired_refs;
 };
 
+static struct flow_pool desired_flow_pool
+    = FLOW_POOL_INITIALIZER(struct desired_flow);
+static struct flow_pool installed_flow_pool
+    = FLOW_POOL_INITIALIZER(struct installed_flow);
+
+/* Memory accounting, for ofctrl_get_memory_usage(). */
+static size_t desired_flow_match_bytes;
+static size_t installed_flow_match_bytes;
+static size_t n_sb_flow_refs;
+static size_t n_sb_to_flows;
+
+/* Statistics of the updates of the switch, for ofctrl_get_stats(). */
+struct ofctrl_table_stats {
+    uint64_t n_flows;           /* Installed flows. */
+    uint64_t n_flow_mods;       /* Flow_mods sent. */
+};
+static struct ofctrl_table_stats table_stats[UINT8_MAX + 1];
+static uint64_t n_flow_mods;
+static uint64_t n_bytes_sent;
+
+/* Updates acknowledged by their barrier reply, and the time from the
+ * composition of an update to its barrier reply, in ms. */
+static uint64_t n_acked_updates;
+static long long int update_latency_last;
+static long long int update_latency_max;
+static long long int update_latency_total;
+
+/* The rates are averaged over at least OFCTRL_STATS_SAMPLE_MSEC, from the
+ * counters at 'stats_sample_time'. */
+#define OFCTRL_STATS_SAMPLE_MSEC 10000
+static long long int stats_sample_time;
+static uint64_t stats_sample_flow_mods;
+static uint64_t stats_sample_bytes;
+static double flow_mod_rate;
+static double byte_rate;
+
 typedef bool
 (*desired_flow_match_cb)(const struct desired_flow *candidate,
                          const void *arg);
@@ -234,12 +312,19 @@ static struct desired_flow *desired_flow_lookup_conjunctive(
 static void desired_flow_destroy(struct desired_flow *);
 
 static struct installed_flow *installed_flow_lookup(
-    const struct ovn_flow *target);
+    const struct ovn_flow *target, struct hmap *installed_flows);
 static void installed_flow_destroy(struct installed_flow *);
 static struct installed_flow *installed_flow_dup(struct desired_flow *);
 static struct desired_flow *installed_flow_get_active(struct installed_flow *);
 
 static uint32_t ovn_flow_match_hash(const struct ovn_flow *);
+static size_t ovn_flow_match_size(const struct ovn_flow *);
+static const struct ofpact *ovn_flow_actions_get(const void *ofpacts,
+                                                 size_t len);
+static const struct ofpact *ovn_flow_actions_ref(const struct ofpact *);
+static void ovn_flow_actions_put(const struct ofpact *);
+static void *flow_pool_alloc(struct flow_pool *);
+static void flow_pool_free(struct flow_pool *, void *);
 static char *ovn_flow_to_string(const struct ovn_flow *);
 static void ovn_flow_log(const struct ovn_flow *, const char *action);
 
@@ -247,7 +332,7 @@ static void ovn_flow_log(const struct ovn_flow *, const char *action);
 static struct rconn *swconn;
 
 /* Symbol table for OVN expressions. */
-static struct shash symtab;
+static const struct shash *symtab;
 
 /* Last seen sequence number for 'swconn'.  When this differs from
  * rconn_get_connection_seqno(rconn), 'swconn' has reconnected. */
@@ -259,6 +344,7 @@ static unsigned int seqno;
     STATE(S_TLV_TABLE_REQUESTED)                \
     STATE(S_TLV_TABLE_MOD_SENT)                 \
     STATE(S_CLEAR_FLOWS)                        \
+    STATE(S_DUMP_FLOWS)                         \
     STATE(S_UPDATE_FLOWS)
 enum ofctrl_state {
 #define STATE(NAME) NAME,
@@ -277,6 +363,7 @@ struct ofctrl_flow_update {
     struct ovs_list list_node;  /* In 'flow_updates'. */
     ovs_be32 xid;               /* OpenFlow transaction ID for barrier. */
     uint64_t req_cfg;           /* Requested sequence number. */
+    long long int sent;         /* When the barrier was queued, in ms. */
 };
 
 static struct ofctrl_flow_update *
@@ -291,24 +378,70 @@ static struct ovs_list flow_updates;
 /* req_cfg of latest committed flow update. */
 static uint64_t cur_cfg;
 
+/* req_cfg of latest flow update queued to the switch. */
+static uint64_t sent_cfg;
+
 /* Current state. */
 static enum ofctrl_state state;
 
 /* Transaction IDs for messages in flight to the switch. */
 static ovs_be32 xid, xid2;
 
-/* Counter for in-flight OpenFlow messages on 'swconn'.  We only send a new
- * round of flow table modifications to the switch when the counter falls to
- * zero, to avoid unbounded buffering. */
+/* Counter for in-flight OpenFlow messages on 'swconn'. */
 static struct rconn_packet_counter *tx_counter;
 
-/* Flow table of "struct ovn_flow"s, that holds the flow table currently
- * installed in the switch. */
-static struct hmap installed_flows;
+/* OpenFlow messages composed by ofctrl_put() that are not queued on 'swconn'
+ * yet.  They are handed to the rconn in chunks of OFCTRL_CHUNK_MSGS messages,
+ * as long as fewer than OFCTRL_MAX_CHUNKS_IN_FLIGHT chunks are in flight, so
+ * that a big update doesn't have to be buffered all at once in the rconn and
+ * a new update can be composed and queued behind one that is still being
+ * transmitted.  Each update is still a single ordered and atomic bundle. */
+#define OFCTRL_CHUNK_MSGS 4096
+#define OFCTRL_MAX_CHUNKS_IN_FLIGHT 4
+static struct ovs_list pending_msgs = OVS_LIST_INITIALIZER(&pending_msgs);
+static size_t n_pending_msgs;
+
+/* Flow tables of "struct ovn_flow"s, that hold the logical and the physical
+ * flows currently installed in the switch.  They are kept apart, like the
+ * desired flow tables they are updated from, so that one of them can be
+ * compared against its desired flows without walking the other. */
+static struct hmap installed_lflows;
+static struct hmap installed_pflows;
+
+/* If true, the flows are not deleted from the switch when the connection is
+ * (re)established.  They are dumped instead, in S_DUMP_FLOWS, into
+ * 'dumped_flows', and the next ofctrl_put() sorts them into the installed
+ * flow tables and only sends the differences from the desired flows, so that
+ * a reconnection doesn't disrupt the traffic that the existing flows carry. */
+static bool reconcile_flows;
+
+/* Flows dumped from the switch, and whether they are complete and still have
+ * to be merged into the installed flow tables by ofctrl_put(). */
+static struct hmap dumped_flows;
+static bool need_reconcile_flows;
+
+/* IDs of the groups and meters dumped from the switch along with the flows.
+ * ofctrl_put() modifies, rather than adds, the desired groups and meters that
+ * the switch already has, and deletes the others once the flows that may
+ * refer to them are updated.  'n_dumps_pending' is the number of dumps whose
+ * last reply was not received yet, 'dump_group_xid' and 'dump_meter_xid' are
+ * the xids of the group and meter dump requests. */
+struct dumped_id {
+    struct hmap_node hmap_node;
+    uint32_t id;
+};
+static struct hmap dumped_groups;
+static struct hmap dumped_meters;
+static int n_dumps_pending;
+static ovs_be32 dump_group_xid;
+static ovs_be32 dump_meter_xid;
 
 /* A reference to the group_table. */
 static struct ovn_extend_table *groups;
 
+/* A reference to the group table of the physical flows. */
+static struct ovn_extend_table *pflow_groups;
+
 /* A reference to the meter_table. */
 static struct ovn_extend_table *meters;
 
@@ -322,6 +455,8 @@ static enum mf_field_id mff_ovn_geneve;
 static bool need_reinstall_flows;
 
 static ovs_be32 queue_msg(struct ofpbuf *);
+static void send_pending_msgs(void);
+static void discard_pending_msgs(void);
 
 static struct ofpbuf *encode_flow_mod(struct ofputil_flow_mod *);
 
@@ -329,24 +464,32 @@ static struct ofpbuf *encode_group_mod(const struct ofputil_group_mod *);
 
 static struct ofpbuf *encode_meter_mod(const struct ofputil_meter_mod *);
 
-static void ovn_installed_flow_table_clear(void);
-static void ovn_installed_flow_table_destroy(void);
-
+static void ovn_installed_flow_table_clear(struct hmap *installed_flows);
+static void ovn_installed_flow_table_destroy(struct hmap *installed_flows);
 
+static void log_openflow_rl(struct vlog_rate_limit *, enum vlog_level,
+                            const struct ofp_header *, const char *title);
 static void ofctrl_recv(const struct ofp_header *, enum ofptype);
 
 void
 ofctrl_init(struct ovn_extend_table *group_table,
+            struct ovn_extend_table *pflow_group_table,
             struct ovn_extend_table *meter_table,
             int inactivity_probe_interval)
 {
     swconn = rconn_create(inactivity_probe_interval, 0,
                           DSCP_DEFAULT, 1 << OFP15_VERSION);
     tx_counter = rconn_packet_counter_create();
-    hmap_init(&installed_flows);
+    hmap_init(&installed_lflows);
+    hmap_init(&installed_pflows);
+    stats_sample_time = time_msec();
+    hmap_init(&dumped_flows);
+    hmap_init(&dumped_groups);
+    hmap_init(&dumped_meters);
     ovs_list_init(&flow_updates);
-    ovn_init_symtab(&symtab);
+    symtab = ovn_symtab_ref();
     groups = group_table;
+    pflow_groups = pflow_group_table;
     meters = meter_table;
 }
 
@@ -542,19 +685,10 @@ error:
     state = S_CLEAR_FLOWS;
 }
 
-/* S_CLEAR_FLOWS, after we've established a Geneve metadata field ID and it's
- * time to set up some flows.
- *
- * Sends an OFPT_TABLE_MOD to clear all flows, then transitions to
- * S_UPDATE_FLOWS. */
-
+/* Sends a flow_mod to delete all flows. */
 static void
-run_S_CLEAR_FLOWS(void)
+clear_flows(void)
 {
-    VLOG_DBG("clearing all flows");
-
-    need_reinstall_flows = true;
-    /* Send a flow_mod to delete all flows. */
     struct ofputil_flow_mod fm = {
         .table_id = OFPTT_ALL,
         .command = OFPFC_DELETE,
@@ -562,8 +696,12 @@ run_S_CLEAR_FLOWS(void)
     minimatch_init_catchall(&fm.match);
     queue_msg(encode_flow_mod(&fm));
     minimatch_destroy(&fm.match);
+}
 
-    /* Send a group_mod to delete all groups. */
+/* Sends a group_mod and a meter_mod to delete all groups and meters. */
+static void
+clear_groups_and_meters(void)
+{
     struct ofputil_group_mod gm;
     memset(&gm, 0, sizeof gm);
     gm.command = OFPGC11_DELETE;
@@ -573,22 +711,86 @@ run_S_CLEAR_FLOWS(void)
     queue_msg(encode_group_mod(&gm));
     ofputil_uninit_group_mod(&gm);
 
-    /* Clear installed_flows, to match the state of the switch. */
-    ovn_installed_flow_table_clear();
-
-    /* Clear existing groups, to match the state of the switch. */
-    if (groups) {
-        ovn_extend_table_clear(groups, true);
-    }
-
-    /* Send a meter_mod to delete all meters. */
     struct ofputil_meter_mod mm;
     memset(&mm, 0, sizeof mm);
     mm.command = OFPMC13_DELETE;
     mm.meter.meter_id = OFPM13_ALL;
     queue_msg(encode_meter_mod(&mm));
+}
+
+static void
+dumped_ids_add(struct hmap *ids, uint32_t id)
+{
+    struct dumped_id *dumped = xmalloc(sizeof *dumped);
+
+    dumped->id = id;
+    hmap_insert(ids, &dumped->hmap_node, hash_int(id, 0));
+}
+
+/* Removes 'id' from 'ids'.  Returns true if it was there. */
+static bool
+dumped_ids_remove(struct hmap *ids, uint32_t id)
+{
+    struct dumped_id *dumped;
+
+    HMAP_FOR_EACH_WITH_HASH (dumped, hmap_node, hash_int(id, 0), ids) {
+        if (dumped->id == id) {
+            hmap_remove(ids, &dumped->hmap_node);
+            free(dumped);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+dumped_ids_clear(struct hmap *ids)
+{
+    struct dumped_id *dumped;
+
+    HMAP_FOR_EACH_POP (dumped, hmap_node, ids) {
+        free(dumped);
+    }
+}
+
+/* S_CLEAR_FLOWS, after we've established a Geneve metadata field ID and it's
+ * time to set up some flows.
+ *
+ * Sends an OFPT_TABLE_MOD to clear all flows, along with the group_mod and
+ * meter_mod that clear all groups and meters, then transitions to
+ * S_UPDATE_FLOWS.  If 'reconcile_flows' is set, requests a dump of the flows,
+ * groups and meters instead and transitions to S_DUMP_FLOWS. */
 
-    /* Clear existing meters, to match the state of the switch. */
+static void
+run_S_CLEAR_FLOWS(void)
+{
+    need_reinstall_flows = true;
+    need_reconcile_flows = false;
+    ovn_installed_flow_table_clear(&dumped_flows);
+    dumped_ids_clear(&dumped_groups);
+    dumped_ids_clear(&dumped_meters);
+    if (!reconcile_flows) {
+        VLOG_DBG("clearing all flows, groups and meters");
+        clear_flows();
+        clear_groups_and_meters();
+    }
+
+    /* Clear the installed flows, to match the state of the switch.  When
+     * reconciling, the dump fills them again. */
+    ovn_installed_flow_table_clear(&installed_lflows);
+    ovn_installed_flow_table_clear(&installed_pflows);
+    for (size_t i = 0; i < ARRAY_SIZE(table_stats); i++) {
+        table_stats[i].n_flows = 0;
+    }
+
+    /* Clear existing groups and meters.  When reconciling, ofctrl_put()
+     * installs all the desired ones over the dumped ones. */
+    if (groups) {
+        ovn_extend_table_clear(groups, true);
+    }
+    if (pflow_groups) {
+        ovn_extend_table_clear(pflow_groups, true);
+    }
     if (meters) {
         ovn_extend_table_clear(meters, true);
     }
@@ -600,7 +802,29 @@ run_S_CLEAR_FLOWS(void)
         free(fup);
     }
 
-    state = S_UPDATE_FLOWS;
+    if (reconcile_flows) {
+        /* Dump all the flows, groups and meters. */
+        VLOG_DBG("dumping all flows, groups and meters");
+        struct ofputil_flow_stats_request fsr = {
+            .table_id = OFPTT_ALL,
+            .out_port = OFPP_ANY,
+            .out_group = OFPG_ANY,
+        };
+        match_init_catchall(&fsr.match);
+        enum ofp_version version = rconn_get_version(swconn);
+        enum ofputil_protocol protocol
+            = ofputil_protocol_from_ofp_version(version);
+        xid = queue_msg(ofputil_encode_flow_stats_request(&fsr, protocol));
+        dump_group_xid = queue_msg(
+            ofputil_encode_group_desc_request(version, OFPG_ALL));
+        dump_meter_xid = queue_msg(
+            ofputil_encode_meter_request(version, OFPUTIL_METER_CONFIG,
+                                         OFPM13_ALL));
+        n_dumps_pending = 3;
+        state = S_DUMP_FLOWS;
+    } else {
+        state = S_UPDATE_FLOWS;
+    }
 }
 
 static void
@@ -609,6 +833,155 @@ recv_S_CLEAR_FLOWS(const struct ofp_header *oh, enum ofptype type,
 {
     ofctrl_recv(oh, type);
 }
+
+/* S_DUMP_FLOWS, after we've requested the flows, groups and meters from the
+ * switch.
+ *
+ * Collects the flows of the OFPST_FLOW replies into 'dumped_flows', and the
+ * IDs of the groups and the meters of the OFPST_GROUP_DESC and
+ * OFPST_METER_CONFIG replies into 'dumped_groups' and 'dumped_meters'.  After
+ * the last reply of all three dumps, transitions to S_UPDATE_FLOWS.  If the
+ * switch returns an error, or a reply can't be decoded, falls back to
+ * clearing all flows, groups and meters. */
+
+static void
+run_S_DUMP_FLOWS(void)
+{
+    /* Nothing to do here.  The replies are handled by recv_S_DUMP_FLOWS(). */
+}
+
+static bool
+add_dumped_flows(const struct ofp_header *oh)
+{
+    struct ofpbuf msg = ofpbuf_const_initializer(oh, ntohs(oh->length));
+    uint64_t ofpacts_stub[1024 / 8];
+    struct ofpbuf ofpacts = OFPBUF_STUB_INITIALIZER(ofpacts_stub);
+    bool ok = true;
+
+    for (;;) {
+        struct ofputil_flow_stats fs;
+        int retval = ofputil_decode_flow_stats_reply(&fs, &msg, false,
+                                                     &ofpacts);
+        if (retval) {
+            if (retval != EOF) {
+                VLOG_WARN("could not decode flow dump reply (%s)",
+                          ofperr_to_string(retval));
+                ok = false;
+            }
+            break;
+        }
+
+        struct installed_flow *i = flow_pool_alloc(&installed_flow_pool);
+        ovs_list_init(&i->desired_refs);
+        i->flow.table_id = fs.table_id;
+        i->flow.priority = fs.priority;
+        minimatch_init(&i->flow.match, &fs.match);
+        i->flow.ofpacts = ovn_flow_actions_get(fs.ofpacts, fs.ofpacts_len);
+        i->flow.ofpacts_len = fs.ofpacts_len;
+        i->flow.cookie = ntohll(fs.cookie);
+        i->flow.hash = ovn_flow_match_hash(&i->flow);
+        installed_flow_match_bytes += ovn_flow_match_size(&i->flow);
+        hmap_insert(&dumped_flows, &i->match_hmap_node, i->flow.hash);
+    }
+
+    ofpbuf_uninit(&ofpacts);
+    return ok;
+}
+
+static bool
+add_dumped_groups(const struct ofp_header *oh)
+{
+    struct ofpbuf msg = ofpbuf_const_initializer(oh, ntohs(oh->length));
+
+    for (;;) {
+        struct ofputil_group_desc gd;
+        int retval = ofputil_decode_group_desc_reply(&gd, &msg, oh->version);
+        if (retval) {
+            if (retval != EOF) {
+                VLOG_WARN("could not decode group dump reply (%s)",
+                          ofperr_to_string(retval));
+                return false;
+            }
+            return true;
+        }
+        dumped_ids_add(&dumped_groups, gd.group_id);
+        ofputil_uninit_group_desc(&gd);
+    }
+}
+
+static bool
+add_dumped_meters(const struct ofp_header *oh)
+{
+    struct ofpbuf msg = ofpbuf_const_initializer(oh, ntohs(oh->length));
+    uint64_t bands_stub[256 / 8];
+    struct ofpbuf bands = OFPBUF_STUB_INITIALIZER(bands_stub);
+    bool ok = true;
+
+    for (;;) {
+        struct ofputil_meter_config mc;
+        int retval = ofputil_decode_meter_config(&msg, &mc, &bands);
+        if (retval) {
+            if (retval != EOF) {
+                VLOG_WARN("could not decode meter dump reply (%s)",
+                          ofperr_to_string(retval));
+                ok = false;
+            }
+            break;
+        }
+        dumped_ids_add(&dumped_meters, mc.meter_id);
+    }
+
+    ofpbuf_uninit(&bands);
+    return ok;
+}
+
+static void
+recv_S_DUMP_FLOWS(const struct ofp_header *oh, enum ofptype type,
+                  struct shash *pending_ct_zones OVS_UNUSED)
+{
+    bool ok;
+
+    if (oh->xid == xid && type == OFPTYPE_FLOW_STATS_REPLY) {
+        ok = add_dumped_flows(oh);
+    } else if (oh->xid == dump_group_xid
+               && type == OFPTYPE_GROUP_DESC_STATS_REPLY) {
+        ok = add_dumped_groups(oh);
+    } else if (oh->xid == dump_meter_xid
+               && type == OFPTYPE_METER_CONFIG_STATS_REPLY) {
+        ok = add_dumped_meters(oh);
+    } else if (type == OFPTYPE_ERROR
+               && (oh->xid == xid || oh->xid == dump_group_xid
+                   || oh->xid == dump_meter_xid)) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
+        log_openflow_rl(&rl, VLL_WARN, oh, "dump failed");
+        ok = false;
+    } else {
+        ofctrl_recv(oh, type);
+        return;
+    }
+
+    if (ok) {
+        if (ofpmp_more(oh) || --n_dumps_pending) {
+            return;
+        }
+        VLOG_INFO("reconciling %"PRIuSIZE" flows, %"PRIuSIZE" groups and "
+                  "%"PRIuSIZE" meters dumped from the switch",
+                  hmap_count(&dumped_flows), hmap_count(&dumped_groups),
+                  hmap_count(&dumped_meters));
+        need_reconcile_flows = true;
+    } else {
+        /* The replies to the other dumps, if any, are ignored in
+         * S_UPDATE_FLOWS. */
+        VLOG_INFO("clearing all flows, groups and meters instead of "
+                  "reconciling them");
+        ovn_installed_flow_table_clear(&dumped_flows);
+        dumped_ids_clear(&dumped_groups);
+        dumped_ids_clear(&dumped_meters);
+        clear_flows();
+        clear_groups_and_meters();
+    }
+    state = S_UPDATE_FLOWS;
+}
 
 /* S_UPDATE_FLOWS, for maintaining the flow table over time.
  *
@@ -637,6 +1010,12 @@ recv_S_UPDATE_FLOWS(const struct ofp_header *oh, enum ofptype type,
             if (fup->req_cfg >= cur_cfg) {
                 cur_cfg = fup->req_cfg;
             }
+
+            long long int latency = time_msec() - fup->sent;
+            n_acked_updates++;
+            update_latency_last = latency;
+            update_latency_max = MAX(update_latency_max, latency);
+            update_latency_total += latency;
             ovs_list_remove(&fup->list_node);
             free(fup);
         }
@@ -663,8 +1042,8 @@ ofctrl_get_mf_field_id(void)
     if (!rconn_is_connected(swconn)) {
         return 0;
     }
-    return (state == S_CLEAR_FLOWS || state == S_UPDATE_FLOWS
-            ? mff_ovn_geneve : 0);
+    return (state == S_CLEAR_FLOWS || state == S_DUMP_FLOWS
+            || state == S_UPDATE_FLOWS ? mff_ovn_geneve : 0);
 }
 
 /* Runs the OpenFlow state machine against 'br_int', which is local to the
@@ -689,6 +1068,9 @@ ofctrl_run(const struct ovsrec_bridge *br_int, struct shash *pending_ct_zones)
         seqno = rconn_get_connection_seqno(swconn);
         state = S_NEW;
 
+        /* The flows are reinstalled from scratch on the new connection. */
+        discard_pending_msgs();
+
         /* Reset the state of any outstanding ct flushes to resend them. */
         struct shash_node *iter;
         SHASH_FOR_EACH(iter, pending_ct_zones) {
@@ -740,6 +1122,11 @@ ofctrl_run(const struct ovsrec_bridge *br_int, struct shash *pending_ct_zones)
         /* If we did some work, plan to go around again. */
         progress = old_state != state || msg;
     }
+
+    /* There is room for more chunks of the pending updates whenever
+     * in-flight messages have been sent.  Otherwise, rconn_run_wait() wakes
+     * us up when the connection can take more. */
+    send_pending_msgs();
     if (progress) {
         /* We bailed out to limit the amount of work we do in one go, to allow
          * other code a chance to run.  We were still making progress at that
@@ -758,11 +1145,20 @@ ofctrl_wait(void)
 void
 ofctrl_destroy(void)
 {
+    discard_pending_msgs();
     rconn_destroy(swconn);
-    ovn_installed_flow_table_destroy();
+    ovn_installed_flow_table_destroy(&installed_lflows);
+    ovn_installed_flow_table_destroy(&installed_pflows);
+    ovn_installed_flow_table_destroy(&dumped_flows);
+    dumped_ids_clear(&dumped_groups);
+    hmap_destroy(&dumped_groups);
+    dumped_ids_clear(&dumped_meters);
+    hmap_destroy(&dumped_meters);
+    flow_pool_destroy(&installed_flow_pool);
+    flow_pool_destroy(&desired_flow_pool);
     rconn_packet_counter_destroy(tx_counter);
-    expr_symtab_destroy(&symtab);
-    shash_destroy(&symtab);
+    ovn_symtab_unref();
+    symtab = NULL;
 }
 
 uint64_t
@@ -770,16 +1166,61 @@ ofctrl_get_cur_cfg(void)
 {
     return cur_cfg;
 }
+
+/* Returns the req_cfg of the latest flow update that ofctrl_put() queued to
+ * the switch, whether or not the switch acked it yet. */
+uint64_t
+ofctrl_get_sent_cfg(void)
+{
+    return sent_cfg;
+}
 
 static ovs_be32
 queue_msg(struct ofpbuf *msg)
 {
     const struct ofp_header *oh = msg->data;
     ovs_be32 xid_ = oh->xid;
+    n_bytes_sent += msg->size;
     rconn_send(swconn, msg, tx_counter);
     return xid_;
 }
 
+static bool
+pending_msgs_can_send(void)
+{
+    return (rconn_packet_counter_n_packets(tx_counter)
+            < OFCTRL_CHUNK_MSGS * OFCTRL_MAX_CHUNKS_IN_FLIGHT);
+}
+
+/* Queues on 'swconn' as many chunks of 'pending_msgs' as the in-flight limit
+ * allows. */
+static void
+send_pending_msgs(void)
+{
+    if (state != S_UPDATE_FLOWS) {
+        return;
+    }
+
+    while (!ovs_list_is_empty(&pending_msgs) && pending_msgs_can_send()) {
+        for (size_t i = 0; i < OFCTRL_CHUNK_MSGS; i++) {
+            if (ovs_list_is_empty(&pending_msgs)) {
+                break;
+            }
+            struct ofpbuf *msg = ofpbuf_from_list(
+                ovs_list_pop_front(&pending_msgs));
+            n_pending_msgs--;
+            queue_msg(msg);
+        }
+    }
+}
+
+static void
+discard_pending_msgs(void)
+{
+    ofpbuf_list_delete(&pending_msgs);
+    n_pending_msgs = 0;
+}
+
 static void
 log_openflow_rl(struct vlog_rate_limit *rl, enum vlog_level level,
                 const struct ofp_header *oh, const char *title)
@@ -987,18 +1428,70 @@ sb_to_flow_find(struct hmap *uuid_flow_table, const struct uuid *sb_uuid)
     return NULL;
 }
 
+static uint32_t
+sb_flow_ref_hash(const struct ovn_flow *f, const struct uuid *sb_uuid)
+{
+    return hash_add(f->hash, uuid_hash(sb_uuid));
+}
+
+/* Finds and returns the reference of 'sb_uuid' to a desired flow in
+ * 'flow_table' whose key is identical to 'target''s key, or NULL if there is
+ * none. */
+static struct sb_flow_ref *
+sb_flow_ref_find(struct ovn_desired_flow_table *flow_table,
+                 const struct ovn_flow *target, const struct uuid *sb_uuid)
+{
+    struct sb_flow_ref *sfr;
+    HMAP_FOR_EACH_WITH_HASH (sfr, match_uuid_hmap_node,
+                             sb_flow_ref_hash(target, sb_uuid),
+                             &flow_table->match_uuid_table) {
+        const struct ovn_flow *f = &sfr->flow->flow;
+        if (uuid_equals(&sfr->sb_uuid, sb_uuid)
+            && f->table_id == target->table_id
+            && f->priority == target->priority
+            && minimatch_equal(&f->match, &target->match)) {
+            return sfr;
+        }
+    }
+    return NULL;
+}
+
+/* Frees 'sfr', which must have been removed from its lists already. */
+static void
+sb_flow_ref_destroy(struct ovn_desired_flow_table *flow_table,
+                    struct sb_flow_ref *sfr)
+{
+    hmap_remove(&flow_table->match_uuid_table, &sfr->match_uuid_hmap_node);
+    free(sfr);
+    n_sb_flow_refs--;
+}
+
+/* Removes 'stf' from 'flow_table' and frees it. */
+static void
+sb_to_flow_destroy(struct ovn_desired_flow_table *flow_table,
+                   struct sb_to_flow *stf)
+{
+    hmap_remove(&flow_table->uuid_flow_table, &stf->hmap_node);
+    free(stf);
+    n_sb_to_flows--;
+}
+
 static void
 link_flow_to_sb(struct ovn_desired_flow_table *flow_table,
                 struct desired_flow *f, const struct uuid *sb_uuid)
 {
     struct sb_flow_ref *sfr = xmalloc(sizeof *sfr);
+    n_sb_flow_refs++;
     sfr->flow = f;
     sfr->sb_uuid = *sb_uuid;
     ovs_list_insert(&f->references, &sfr->sb_list);
+    hmap_insert(&flow_table->match_uuid_table, &sfr->match_uuid_hmap_node,
+                sb_flow_ref_hash(&f->flow, sb_uuid));
     struct sb_to_flow *stf = sb_to_flow_find(&flow_table->uuid_flow_table,
                                              sb_uuid);
     if (!stf) {
         stf = xmalloc(sizeof *stf);
+        n_sb_to_flows++;
         stf->sb_uuid = *sb_uuid;
         ovs_list_init(&stf->flows);
         hmap_insert(&flow_table->uuid_flow_table, &stf->hmap_node,
@@ -1087,8 +1580,9 @@ ofctrl_add_or_append_flow(struct ovn_desired_flow_table *desired_flows,
                    existing->flow.ofpacts_len);
         ofpbuf_put(&compound, f->flow.ofpacts, f->flow.ofpacts_len);
 
-        free(existing->flow.ofpacts);
-        existing->flow.ofpacts = xmemdup(compound.data, compound.size);
+        ovn_flow_actions_put(existing->flow.ofpacts);
+        existing->flow.ofpacts = ovn_flow_actions_get(compound.data,
+                                                      compound.size);
         existing->flow.ofpacts_len = compound.size;
 
         ofpbuf_uninit(&compound);
@@ -1121,7 +1615,7 @@ remove_flows_from_sb_to_flow(struct ovn_desired_flow_table *flow_table,
         ovs_list_remove(&sfr->sb_list);
         ovs_list_remove(&sfr->flow_list);
         struct desired_flow *f = sfr->flow;
-        free(sfr);
+        sb_flow_ref_destroy(flow_table, sfr);
 
         if (ovs_list_is_empty(&f->references)) {
             if (log_msg) {
@@ -1132,8 +1626,7 @@ remove_flows_from_sb_to_flow(struct ovn_desired_flow_table *flow_table,
             track_or_destroy_for_flow_del(flow_table, f);
         }
     }
-    hmap_remove(&flow_table->uuid_flow_table, &stf->hmap_node);
-    free(stf);
+    sb_to_flow_destroy(flow_table, stf);
 }
 
 void
@@ -1151,6 +1644,46 @@ ofctrl_remove_flows(struct ovn_desired_flow_table *flow_table,
     ovn_extend_table_remove_desired(meters, sb_uuid);
 }
 
+/* Removes the reference of 'sb_uuid' to the flow with the given 'table_id',
+ * 'priority' and 'match', and the flow itself if no other sb_uuid references
+ * it.  Returns false if 'sb_uuid' doesn't reference such a flow. */
+bool
+ofctrl_remove_flow(struct ovn_desired_flow_table *flow_table,
+                   uint8_t table_id, uint16_t priority,
+                   const struct match *match, const struct uuid *sb_uuid)
+{
+    struct ovn_flow target = {
+        .table_id = table_id,
+        .priority = priority,
+    };
+    minimatch_init(&target.match, match);
+    target.hash = ovn_flow_match_hash(&target);
+
+    struct sb_flow_ref *sfr = sb_flow_ref_find(flow_table, &target, sb_uuid);
+    minimatch_destroy(&target.match);
+    if (!sfr) {
+        return false;
+    }
+
+    struct desired_flow *f = sfr->flow;
+    ovs_list_remove(&sfr->sb_list);
+    ovs_list_remove(&sfr->flow_list);
+    sb_flow_ref_destroy(flow_table, sfr);
+
+    struct sb_to_flow *stf = sb_to_flow_find(&flow_table->uuid_flow_table,
+                                             sb_uuid);
+    if (stf && ovs_list_is_empty(&stf->flows)) {
+        sb_to_flow_destroy(flow_table, stf);
+    }
+
+    if (ovs_list_is_empty(&f->references)) {
+        ovn_flow_log(&f->flow, "ofctrl_remove_flow");
+        hmap_remove(&flow_table->match_flow_table, &f->match_hmap_node);
+        track_or_destroy_for_flow_del(flow_table, f);
+    }
+    return true;
+}
+
 static struct ofctrl_flood_remove_node *
 flood_remove_find_node(struct hmap *flood_remove_nodes, struct uuid *sb_uuid)
 {
@@ -1173,10 +1706,17 @@ ofctrl_flood_remove_add_node(struct hmap *flood_remove_nodes,
     hmap_insert(flood_remove_nodes, &ofrn->hmap_node, uuid_hash(sb_uuid));
 }
 
+/* Removes the flows of 'sb_uuid' from 'flow_table'.  The flows that are also
+ * referenced by other sb_uuids are removed as well, and the sb_uuids that are
+ * not in 'flood_remove_nodes' yet are added to it and to 'queue', of which
+ * '*n_queue' entries out of '*allocated' are used, so that the caller
+ * removes their flows in turn. */
 static void
 flood_remove_flows_for_sb_uuid(struct ovn_desired_flow_table *flow_table,
                                const struct uuid *sb_uuid,
-                               struct hmap *flood_remove_nodes)
+                               struct hmap *flood_remove_nodes,
+                               struct uuid **queue, size_t *n_queue,
+                               size_t *allocated)
 {
     struct sb_to_flow *stf = sb_to_flow_find(&flow_table->uuid_flow_table,
                                              sb_uuid);
@@ -1195,7 +1735,7 @@ flood_remove_flows_for_sb_uuid(struct ovn_desired_flow_table *flow_table,
 
         ovs_list_remove(&sfr->sb_list);
         ovs_list_remove(&sfr->flow_list);
-        free(sfr);
+        sb_flow_ref_destroy(flow_table, sfr);
 
         ovs_assert(ovs_list_is_empty(&f->list_node));
         if (ovs_list_is_empty(&f->references)) {
@@ -1209,62 +1749,72 @@ flood_remove_flows_for_sb_uuid(struct ovn_desired_flow_table *flow_table,
             ovs_list_insert(&to_be_removed, &f->list_node);
         }
     }
-    hmap_remove(&flow_table->uuid_flow_table, &stf->hmap_node);
-    free(stf);
-
-    /* Traverse other referencing sb_uuids for the flows in the to_be_removed
-     * list. */
+    sb_to_flow_destroy(flow_table, stf);
 
-    /* Detach the items in f->references from the sfr.flow_list lists,
-     * so that recursive calls will not mess up the sfr.sb_list list. */
+    /* Remove the other references of the flows in the to_be_removed list,
+     * and queue their sb_uuids.  The flows list of a queued sb_uuid may thus
+     * become empty before it is processed, but no reference to a processed
+     * sb_uuid is left. */
     struct desired_flow *f, *f_next;
-    LIST_FOR_EACH (f, list_node, &to_be_removed) {
-        ovs_assert(!ovs_list_is_empty(&f->references));
-        LIST_FOR_EACH (sfr, sb_list, &f->references) {
-            ovs_list_remove(&sfr->flow_list);
-        }
-    }
     LIST_FOR_EACH_SAFE (f, f_next, list_node, &to_be_removed) {
         LIST_FOR_EACH_SAFE (sfr, next, sb_list, &f->references) {
             if (!flood_remove_find_node(flood_remove_nodes, &sfr->sb_uuid)) {
                 ofctrl_flood_remove_add_node(flood_remove_nodes,
                                              &sfr->sb_uuid);
-                flood_remove_flows_for_sb_uuid(flow_table, &sfr->sb_uuid,
-                                               flood_remove_nodes);
+                if (*n_queue >= *allocated) {
+                    *queue = x2nrealloc(*queue, allocated, sizeof **queue);
+                }
+                (*queue)[(*n_queue)++] = sfr->sb_uuid;
             }
             ovs_list_remove(&sfr->sb_list);
-            free(sfr);
+            ovs_list_remove(&sfr->flow_list);
+            sb_flow_ref_destroy(flow_table, sfr);
         }
         ovs_list_remove(&f->list_node);
         hmap_remove(&flow_table->match_flow_table,
                     &f->match_hmap_node);
         track_or_destroy_for_flow_del(flow_table, f);
     }
-
 }
 
+/* Removes the flows of the sb_uuids in 'flood_remove_nodes', and of the
+ * sb_uuids that share flows with them, transitively.  The latter are added to
+ * 'flood_remove_nodes', for the caller to reprocess them.
+ *
+ * The sb_uuids are processed in breadth-first order from a queue instead of
+ * recursively, so that a long chain of shared flows neither deepens the stack
+ * nor revisits an sb_uuid: 'flood_remove_nodes' is the visited set. */
 void
 ofctrl_flood_remove_flows(struct ovn_desired_flow_table *flow_table,
                           struct hmap *flood_remove_nodes)
 {
     struct ofctrl_flood_remove_node *ofrn;
-    int i, n = 0;
+    size_t n_initial = hmap_count(flood_remove_nodes);
+    size_t allocated = MAX(n_initial, 1);
+    size_t n_queue = 0;
 
     /* flood_remove_flows_for_sb_uuid() will modify the 'flood_remove_nodes'
      * hash map by inserting new items, so we can't use it for iteration.
-     * Copying the sb_uuids into an array. */
-    struct uuid *sb_uuids;
-    sb_uuids = xmalloc(hmap_count(flood_remove_nodes) * sizeof *sb_uuids);
-    struct hmap flood_remove_uuids = HMAP_INITIALIZER(&flood_remove_uuids);
+     * Copying the sb_uuids into the queue. */
+    struct uuid *queue = xmalloc(allocated * sizeof *queue);
     HMAP_FOR_EACH (ofrn, hmap_node, flood_remove_nodes) {
-        sb_uuids[n++] = ofrn->sb_uuid;
+        queue[n_queue++] = ofrn->sb_uuid;
     }
 
-    for (i = 0; i < n; i++) {
-        flood_remove_flows_for_sb_uuid(flow_table, &sb_uuids[i],
-                                       flood_remove_nodes);
+    for (size_t i = 0; i < n_queue; i++) {
+        struct uuid sb_uuid = queue[i];
+        flood_remove_flows_for_sb_uuid(flow_table, &sb_uuid,
+                                       flood_remove_nodes, &queue, &n_queue,
+                                       &allocated);
+    }
+    free(queue);
+
+    COVERAGE_INC(flood_remove);
+    COVERAGE_ADD(flood_remove_fanout, n_queue - n_initial);
+    if (n_queue > n_initial) {
+        VLOG_DBG("flood removal of %"PRIuSIZE" sb_uuids reached %"PRIuSIZE
+                 " more", n_initial, n_queue - n_initial);
     }
-    free(sb_uuids);
 
     /* remove any related group and meter info */
     HMAP_FOR_EACH (ofrn, hmap_node, flood_remove_nodes) {
@@ -1275,6 +1825,112 @@ ofctrl_flood_remove_flows(struct ovn_desired_flow_table *flow_table,
 
 /* flow operations. */
 
+/* Returns the shared copy of the 'len' bytes of actions in 'ofpacts', with a
+ * new reference that the caller must release with ovn_flow_actions_put(). */
+static const struct ofpact *
+ovn_flow_actions_get(const void *ofpacts, size_t len)
+{
+    uint32_t hash = hash_bytes(ofpacts, len, 0);
+    struct ovn_flow_actions *a;
+
+    HMAP_FOR_EACH_WITH_HASH (a, hmap_node, hash, &flow_actions) {
+        if (a->len == len && !memcmp(a->ofpacts, ofpacts, len)) {
+            a->refcount++;
+            return (const struct ofpact *) a->ofpacts;
+        }
+    }
+
+    a = xmalloc(sizeof *a + len);
+    a->refcount = 1;
+    a->len = len;
+    memcpy(a->ofpacts, ofpacts, len);
+    hmap_insert(&flow_actions, &a->hmap_node, hash);
+    flow_actions_bytes += len;
+    return (const struct ofpact *) a->ofpacts;
+}
+
+static struct ovn_flow_actions *
+ovn_flow_actions_from_ofpacts(const struct ofpact *ofpacts)
+{
+    return CONTAINER_OF(ofpacts, struct ovn_flow_actions, ofpacts);
+}
+
+/* Adds a reference to the shared actions 'ofpacts' and returns them. */
+static const struct ofpact *
+ovn_flow_actions_ref(const struct ofpact *ofpacts)
+{
+    ovn_flow_actions_from_ofpacts(ofpacts)->refcount++;
+    return ofpacts;
+}
+
+/* Releases a reference to the shared actions 'ofpacts'. */
+static void
+ovn_flow_actions_put(const struct ofpact *ofpacts)
+{
+    struct ovn_flow_actions *a = ovn_flow_actions_from_ofpacts(ofpacts);
+
+    ovs_assert(a->refcount);
+    if (!--a->refcount) {
+        hmap_remove(&flow_actions, &a->hmap_node);
+        flow_actions_bytes -= a->len;
+        free(a);
+    }
+}
+
+static void *
+flow_pool_alloc(struct flow_pool *pool)
+{
+    void *obj = pool->free_objs;
+
+    if (obj) {
+        pool->free_objs = *(void **) obj;
+    } else {
+        if (!pool->n_left) {
+            /* The chunk starts with the link to the previous one, padded to
+             * keep the objects aligned. */
+            char *chunk = xmalloc(FLOW_POOL_CHUNK_SIZE);
+            *(void **) chunk = pool->chunks;
+            pool->chunks = chunk;
+            pool->next_obj = chunk + ROUND_UP(sizeof(void *), 8);
+            pool->n_left = ((FLOW_POOL_CHUNK_SIZE
+                             - ROUND_UP(sizeof(void *), 8))
+                            / pool->obj_size);
+        }
+        obj = pool->next_obj;
+        pool->next_obj += pool->obj_size;
+        pool->n_left--;
+    }
+    pool->n_objs++;
+    return obj;
+}
+
+static void
+flow_pool_free(struct flow_pool *pool, void *obj)
+{
+    ovs_assert(pool->n_objs);
+    *(void **) obj = pool->free_objs;
+    pool->free_objs = obj;
+    pool->n_objs--;
+}
+
+/* Releases the memory of 'pool'.  Does nothing if some of its objects are
+ * still in use. */
+static void
+flow_pool_destroy(struct flow_pool *pool)
+{
+    if (pool->n_objs) {
+        return;
+    }
+    while (pool->chunks) {
+        void *chunk = pool->chunks;
+        pool->chunks = *(void **) chunk;
+        free(chunk);
+    }
+    pool->free_objs = NULL;
+    pool->next_obj = NULL;
+    pool->n_left = 0;
+}
+
 static void
 ovn_flow_init(struct ovn_flow *f, uint8_t table_id, uint16_t priority,
               uint64_t cookie, const struct match *match,
@@ -1283,7 +1939,7 @@ ovn_flow_init(struct ovn_flow *f, uint8_t table_id, uint16_t priority,
     f->table_id = table_id;
     f->priority = priority;
     minimatch_init(&f->match, match);
-    f->ofpacts = xmemdup(actions->data, actions->size);
+    f->ofpacts = ovn_flow_actions_get(actions->data, actions->size);
     f->ofpacts_len = actions->size;
     f->hash = ovn_flow_match_hash(f);
     f->cookie = cookie;
@@ -1293,7 +1949,7 @@ static struct desired_flow *
 desired_flow_alloc(uint8_t table_id, uint16_t priority, uint64_t cookie,
                    const struct match *match, const struct ofpbuf *actions)
 {
-    struct desired_flow *f = xmalloc(sizeof *f);
+    struct desired_flow *f = flow_pool_alloc(&desired_flow_pool);
     ovs_list_init(&f->references);
     ovs_list_init(&f->list_node);
     ovs_list_init(&f->installed_ref_list_node);
@@ -1301,10 +1957,21 @@ desired_flow_alloc(uint8_t table_id, uint16_t priority, uint64_t cookie,
     f->installed_flow = NULL;
     f->is_deleted = false;
     ovn_flow_init(&f->flow, table_id, priority, cookie, match, actions);
+    desired_flow_match_bytes += ovn_flow_match_size(&f->flow);
 
     return f;
 }
 
+/* Returns the number of bytes allocated for the match of 'f'. */
+static size_t
+ovn_flow_match_size(const struct ovn_flow *f)
+{
+    /* A minimatch allocates its miniflow and its minimask, which have the
+     * same number of values, in a single block. */
+    return 2 * (sizeof *f->match.flow
+                + MINIFLOW_VALUES_SIZE(miniflow_n_values(f->match.flow)));
+}
+
 /* Returns a hash of the match key in 'f'. */
 static uint32_t
 ovn_flow_match_hash(const struct ovn_flow *f)
@@ -1317,15 +1984,16 @@ ovn_flow_match_hash(const struct ovn_flow *f)
 static struct installed_flow *
 installed_flow_dup(struct desired_flow *src)
 {
-    struct installed_flow *dst = xmalloc(sizeof *dst);
+    struct installed_flow *dst = flow_pool_alloc(&installed_flow_pool);
     ovs_list_init(&dst->desired_refs);
     dst->flow.table_id = src->flow.table_id;
     dst->flow.priority = src->flow.priority;
     minimatch_clone(&dst->flow.match, &src->flow.match);
-    dst->flow.ofpacts = xmemdup(src->flow.ofpacts, src->flow.ofpacts_len);
+    dst->flow.ofpacts = ovn_flow_actions_ref(src->flow.ofpacts);
     dst->flow.ofpacts_len = src->flow.ofpacts_len;
     dst->flow.hash = src->flow.hash;
     dst->flow.cookie = src->flow.cookie;
+    installed_flow_match_bytes += ovn_flow_match_size(&dst->flow);
     return dst;
 }
 
@@ -1372,34 +2040,21 @@ desired_flow_lookup(struct ovn_desired_flow_table *flow_table,
     return desired_flow_lookup__(flow_table, target, NULL, NULL);
 }
 
-static bool
-flow_lookup_match_uuid_cb(const struct desired_flow *candidate,
-                          const void *arg)
-{
-    const struct uuid *sb_uuid = arg;
-    struct sb_flow_ref *sfr;
-
-    LIST_FOR_EACH (sfr, sb_list, &candidate->references) {
-        if (uuid_equals(sb_uuid, &sfr->sb_uuid)) {
-            return true;
-        }
-    }
-    return false;
-}
-
 /* Finds and returns a desired_flow in 'flow_table' whose key is identical to
  * 'target''s key, or NULL if there is none.
  *
  * The function will also check if the found flow is referenced by the
- * 'sb_uuid'.
+ * 'sb_uuid'.  It looks up the reference directly, so that it doesn't depend
+ * on the number of flows with the same key, e.g. when many logical flows
+ * generate the same match.
  */
 static struct desired_flow *
 desired_flow_lookup_check_uuid(struct ovn_desired_flow_table *flow_table,
                             const struct ovn_flow *target,
                             const struct uuid *sb_uuid)
 {
-    return desired_flow_lookup__(flow_table, target, flow_lookup_match_uuid_cb,
-                                 sb_uuid);
+    struct sb_flow_ref *sfr = sb_flow_ref_find(flow_table, target, sb_uuid);
+    return sfr ? sfr->flow : NULL;
 }
 
 static bool
@@ -1423,14 +2078,15 @@ desired_flow_lookup_conjunctive(struct ovn_desired_flow_table *flow_table,
                                  NULL);
 }
 
-/* Finds and returns an installed_flow in installed_flows whose key is
+/* Finds and returns an installed_flow in 'installed_flows' whose key is
  * identical to 'target''s key, or NULL if there is none. */
 static struct installed_flow *
-installed_flow_lookup(const struct ovn_flow *target)
+installed_flow_lookup(const struct ovn_flow *target,
+                      struct hmap *installed_flows)
 {
     struct installed_flow *i;
     HMAP_FOR_EACH_WITH_HASH (i, match_hmap_node, target->hash,
-                             &installed_flows) {
+                             installed_flows) {
         struct ovn_flow *f = &i->flow;
         if (f->table_id == target->table_id
             && f->priority == target->priority
@@ -1470,7 +2126,7 @@ static void
 ovn_flow_uninit(struct ovn_flow *f)
 {
     minimatch_destroy(&f->match);
-    free(f->ofpacts);
+    ovn_flow_actions_put(f->ofpacts);
 }
 
 static void
@@ -1479,8 +2135,9 @@ desired_flow_destroy(struct desired_flow *f)
     if (f) {
         ovs_assert(ovs_list_is_empty(&f->references));
         ovs_assert(!f->installed_flow);
+        desired_flow_match_bytes -= ovn_flow_match_size(&f->flow);
         ovn_flow_uninit(&f->flow);
-        free(f);
+        flow_pool_free(&desired_flow_pool, f);
     }
 }
 
@@ -1489,8 +2146,9 @@ installed_flow_destroy(struct installed_flow *f)
 {
     if (f) {
         ovs_assert(!installed_flow_get_active(f));
+        installed_flow_match_bytes -= ovn_flow_match_size(&f->flow);
         ovn_flow_uninit(&f->flow);
-        free(f);
+        flow_pool_free(&installed_flow_pool, f);
     }
 }
 
@@ -1500,15 +2158,16 @@ ovn_desired_flow_table_init(struct ovn_desired_flow_table *flow_table)
 {
     hmap_init(&flow_table->match_flow_table);
     hmap_init(&flow_table->uuid_flow_table);
+    hmap_init(&flow_table->match_uuid_table);
     ovs_list_init(&flow_table->tracked_flows);
     flow_table->change_tracked = false;
 }
 
-void
-ovn_desired_flow_table_clear(struct ovn_desired_flow_table *flow_table)
+/* Forgets the tracked changes of 'flow_table', destroying the tracked deleted
+ * flows, so that it can be compared against the installed flows. */
+static void
+ovn_desired_flow_table_flush_tracked(struct ovn_desired_flow_table *flow_table)
 {
-    flow_table->change_tracked = false;
-
     struct desired_flow *f, *f_next;
     LIST_FOR_EACH_SAFE (f, f_next, track_list_node,
                         &flow_table->tracked_flows) {
@@ -1518,8 +2177,17 @@ ovn_desired_flow_table_clear(struct ovn_desired_flow_table *flow_table)
                 unlink_installed_to_desired(f->installed_flow, f);
             }
             desired_flow_destroy(f);
+        } else {
+            ovs_list_init(&f->track_list_node);
         }
     }
+}
+
+void
+ovn_desired_flow_table_clear(struct ovn_desired_flow_table *flow_table)
+{
+    flow_table->change_tracked = false;
+    ovn_desired_flow_table_flush_tracked(flow_table);
 
     struct sb_to_flow *stf, *next;
     HMAP_FOR_EACH_SAFE (stf, next, hmap_node,
@@ -1534,26 +2202,27 @@ ovn_desired_flow_table_destroy(struct ovn_desired_flow_table *flow_table)
     ovn_desired_flow_table_clear(flow_table);
     hmap_destroy(&flow_table->match_flow_table);
     hmap_destroy(&flow_table->uuid_flow_table);
+    hmap_destroy(&flow_table->match_uuid_table);
 }
 
 
 /* Installed flow table operations. */
 static void
-ovn_installed_flow_table_clear(void)
+ovn_installed_flow_table_clear(struct hmap *installed_flows)
 {
     struct installed_flow *f, *next;
-    HMAP_FOR_EACH_SAFE (f, next, match_hmap_node, &installed_flows) {
-        hmap_remove(&installed_flows, &f->match_hmap_node);
+    HMAP_FOR_EACH_SAFE (f, next, match_hmap_node, installed_flows) {
+        hmap_remove(installed_flows, &f->match_hmap_node);
         unlink_all_refs_for_installed_flow(f);
         installed_flow_destroy(f);
     }
 }
 
 static void
-ovn_installed_flow_table_destroy(void)
+ovn_installed_flow_table_destroy(struct hmap *installed_flows)
 {
-    ovn_installed_flow_table_clear();
-    hmap_destroy(&installed_flows);
+    ovn_installed_flow_table_clear(installed_flows);
+    hmap_destroy(installed_flows);
 }
 
 /* Flow table update. */
@@ -1584,6 +2253,9 @@ add_flow_mod(struct ofputil_flow_mod *fm,
 
     ofpbuf_delete(msg);
     ovs_list_push_back(msgs, &bundle_msg->list_node);
+
+    n_flow_mods++;
+    table_stats[fm->table_id].n_flow_mods++;
 }
 
 /* group_table. */
@@ -1663,6 +2335,81 @@ add_group_mod(struct ofputil_group_mod *gm, struct ovs_list *msgs)
     ofputil_uninit_group_mod(&split);
 }
 
+/* Adds to 'msgs' the group_mods that add the desired groups of 'table' that
+ * are not installed yet.  The groups that the switch already has, according
+ * to 'dumped', if nonnull, are modified instead, and removed from 'dumped'. */
+static void
+add_groups(struct ovn_extend_table *table, struct hmap *dumped,
+           struct ovs_list *msgs)
+{
+    struct ovn_extend_table_info *desired;
+
+    if (!table) {
+        return;
+    }
+
+    EXTEND_TABLE_FOR_EACH_UNINSTALLED (desired, table) {
+        /* Create and install new group. */
+        struct ofputil_group_mod gm;
+        enum ofputil_protocol usable_protocols;
+        char *group_string = xasprintf("group_id=%"PRIu32",%s",
+                                       desired->table_id,
+                                       desired->name);
+        uint16_t command
+            = (dumped && dumped_ids_remove(dumped, desired->table_id)
+               ? OFPGC15_MODIFY : OFPGC15_ADD);
+        char *error = parse_ofp_group_mod_str(&gm, command, group_string,
+                                              NULL, NULL, &usable_protocols);
+        if (!error) {
+            add_group_mod(&gm, msgs);
+        } else {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
+            VLOG_ERR_RL(&rl, "new group %s %s", error, group_string);
+            free(error);
+        }
+        free(group_string);
+        ofputil_uninit_group_mod(&gm);
+    }
+}
+
+/* Adds to 'msgs' the group_mods that delete the installed groups of 'table'
+ * that are not desired anymore, and syncs its installed groups with the
+ * desired ones. */
+static void
+delete_groups(struct ovn_extend_table *table, struct ovs_list *msgs)
+{
+    struct ovn_extend_table_info *installed, *next_group;
+
+    if (!table) {
+        return;
+    }
+
+    EXTEND_TABLE_FOR_EACH_INSTALLED (installed, next_group, table) {
+        /* Delete the group. */
+        struct ofputil_group_mod gm;
+        enum ofputil_protocol usable_protocols;
+        char *group_string = xasprintf("group_id=%"PRIu32"",
+                                       installed->table_id);
+        char *error = parse_ofp_group_mod_str(&gm, OFPGC15_DELETE,
+                                              group_string, NULL, NULL,
+                                              &usable_protocols);
+        if (!error) {
+            add_group_mod(&gm, msgs);
+        } else {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
+            VLOG_ERR_RL(&rl, "Error deleting group %d: %s",
+                        installed->table_id, error);
+            free(error);
+        }
+        free(group_string);
+        ofputil_uninit_group_mod(&gm);
+        ovn_extend_table_remove_existing(table, installed);
+    }
+
+    /* Sync the contents of table->desired to table->existing. */
+    ovn_extend_table_sync(table);
+}
+
 
 static struct ofpbuf *
 encode_meter_mod(const struct ofputil_meter_mod *mm)
@@ -1689,7 +2436,7 @@ add_ct_flush_zone(uint16_t zone_id, struct ovs_list *msgs)
 }
 
 static void
-add_meter_string(struct ovn_extend_table_info *m_desired,
+add_meter_string(struct ovn_extend_table_info *m_desired, uint16_t command,
                  struct ovs_list *msgs)
 {
     /* Create and install new meter. */
@@ -1698,7 +2445,7 @@ add_meter_string(struct ovn_extend_table_info *m_desired,
     char *meter_string = xasprintf("meter=%"PRIu32",%s",
                                    m_desired->table_id,
                                    &m_desired->name[52]);
-    char *error = parse_ofp_meter_mod_str(&mm, meter_string, OFPMC13_ADD,
+    char *error = parse_ofp_meter_mod_str(&mm, meter_string, command,
                                           &usable_protocols);
     if (!error) {
         add_meter_mod(&mm, msgs);
@@ -1713,7 +2460,7 @@ add_meter_string(struct ovn_extend_table_info *m_desired,
 
 static void
 add_meter(struct ovn_extend_table_info *m_desired,
-          const struct sbrec_meter_table *meter_table,
+          const struct sbrec_meter_table *meter_table, uint16_t command,
           struct ovs_list *msgs)
 {
     const struct sbrec_meter *sb_meter;
@@ -1730,7 +2477,7 @@ add_meter(struct ovn_extend_table_info *m_desired,
     }
 
     struct ofputil_meter_mod mm;
-    mm.command = OFPMC13_ADD;
+    mm.command = command;
     mm.meter.meter_id = m_desired->table_id;
     mm.meter.flags = OFPMF13_STATS;
 
@@ -1806,8 +2553,8 @@ installed_flow_mod(struct ovn_flow *i, struct ovn_flow *d,
     add_flow_mod(&fm, bc, msgs);
 
     /* Replace 'i''s actions and cookie by 'd''s. */
-    free(i->ofpacts);
-    i->ofpacts = xmemdup(d->ofpacts, d->ofpacts_len);
+    ovn_flow_actions_put(i->ofpacts);
+    i->ofpacts = ovn_flow_actions_ref(d->ofpacts);
     i->ofpacts_len = d->ofpacts_len;
     i->cookie = d->cookie;
 }
@@ -1826,17 +2573,34 @@ installed_flow_del(struct ovn_flow *i,
     add_flow_mod(&fm, bc, msgs);
 }
 
+/* Inserts 'i' into 'installed_flows', one of the installed flow tables. */
+static void
+installed_flows_insert(struct hmap *installed_flows, struct installed_flow *i)
+{
+    hmap_insert(installed_flows, &i->match_hmap_node, i->flow.hash);
+    table_stats[i->flow.table_id].n_flows++;
+}
+
+/* Removes 'i' from 'installed_flows', one of the installed flow tables. */
+static void
+installed_flows_remove(struct hmap *installed_flows, struct installed_flow *i)
+{
+    hmap_remove(installed_flows, &i->match_hmap_node);
+    table_stats[i->flow.table_id].n_flows--;
+}
+
 static void
 update_installed_flows_by_compare(struct ovn_desired_flow_table *flow_table,
                                   struct ofputil_bundle_ctrl_msg *bc,
-                                  struct ovs_list *msgs)
+                                  struct ovs_list *msgs,
+                                  struct hmap *installed_flows)
 {
     ovs_assert(ovs_list_is_empty(&flow_table->tracked_flows));
     /* Iterate through all of the installed flows.  If any of them are no
      * longer desired, delete them; if any of them should have different
      * actions, update them. */
     struct installed_flow *i, *next;
-    HMAP_FOR_EACH_SAFE (i, next, match_hmap_node, &installed_flows) {
+    HMAP_FOR_EACH_SAFE (i, next, match_hmap_node, installed_flows) {
         unlink_all_refs_for_installed_flow(i);
         struct desired_flow *d = desired_flow_lookup(flow_table, &i->flow);
         if (!d) {
@@ -1845,11 +2609,10 @@ update_installed_flows_by_compare(struct ovn_desired_flow_table *flow_table,
             installed_flow_del(&i->flow, bc, msgs);
             ovn_flow_log(&i->flow, "removing installed");
 
-            hmap_remove(&installed_flows, &i->match_hmap_node);
+            installed_flows_remove(installed_flows, i);
             installed_flow_destroy(i);
         } else {
-            if (!ofpacts_equal(i->flow.ofpacts, i->flow.ofpacts_len,
-                               d->flow.ofpacts, d->flow.ofpacts_len) ||
+            if (i->flow.ofpacts != d->flow.ofpacts ||
                 i->flow.cookie != d->flow.cookie) {
                 installed_flow_mod(&i->flow, &d->flow, bc, msgs);
                 ovn_flow_log(&i->flow, "updating installed");
@@ -1863,14 +2626,14 @@ update_installed_flows_by_compare(struct ovn_desired_flow_table *flow_table,
      * in the installed flow table. */
     struct desired_flow *d;
     HMAP_FOR_EACH (d, match_hmap_node, &flow_table->match_flow_table) {
-        i = installed_flow_lookup(&d->flow);
+        i = installed_flow_lookup(&d->flow, installed_flows);
         if (!i) {
             ovn_flow_log(&d->flow, "adding installed");
             installed_flow_add(&d->flow, bc, msgs);
 
             /* Copy 'd' from 'flow_table' to installed_flows. */
             i = installed_flow_dup(d);
-            hmap_insert(&installed_flows, &i->match_hmap_node, i->flow.hash);
+            installed_flows_insert(installed_flows, i);
             link_installed_to_desired(i, d);
         } else if (!d->installed_flow) {
             /* This is a desired_flow that conflicts with one installed
@@ -1886,6 +2649,15 @@ update_installed_flows_by_compare(struct ovn_desired_flow_table *flow_table,
     }
 }
 
+/* Returns a hash of the key, the cookie and the actions of 'f', so that the
+ * deleted flows that only share their key with a flow don't have to be
+ * compared with it. */
+static uint32_t
+deleted_flow_hash(const struct ovn_flow *f)
+{
+    return hash_pointer(f->ofpacts, hash_uint64_basis(f->cookie, f->hash));
+}
+
 /* Finds and returns a desired_flow in 'deleted_flows' that is exactly the
  * same as 'target', including cookie and actions.
  */
@@ -1893,15 +2665,14 @@ static struct desired_flow *
 deleted_flow_lookup(struct hmap *deleted_flows, struct ovn_flow *target)
 {
     struct desired_flow *d;
-    HMAP_FOR_EACH_WITH_HASH (d, match_hmap_node, target->hash,
+    HMAP_FOR_EACH_WITH_HASH (d, match_hmap_node, deleted_flow_hash(target),
                              deleted_flows) {
         struct ovn_flow *f = &d->flow;
         if (f->table_id == target->table_id
             && f->priority == target->priority
             && minimatch_equal(&f->match, &target->match)
             && f->cookie == target->cookie
-            && ofpacts_equal(f->ofpacts, f->ofpacts_len, target->ofpacts,
-                             target->ofpacts_len)) {
+            && f->ofpacts == target->ofpacts) {
             return d;
         }
     }
@@ -1923,7 +2694,7 @@ merge_tracked_flows(struct ovn_desired_flow_table *flow_table)
             /* reuse f->match_hmap_node field since it is already removed from
              * the desired flow table's match index. */
             hmap_insert(&deleted_flows, &f->match_hmap_node,
-                        f->flow.hash);
+                        deleted_flow_hash(&f->flow));
         } else {
             struct desired_flow *del_f = deleted_flow_lookup(&deleted_flows,
                                                              &f->flow);
@@ -1961,7 +2732,8 @@ merge_tracked_flows(struct ovn_desired_flow_table *flow_table)
 static void
 update_installed_flows_by_track(struct ovn_desired_flow_table *flow_table,
                                 struct ofputil_bundle_ctrl_msg *bc,
-                                struct ovs_list *msgs)
+                                struct ovs_list *msgs,
+                                struct hmap *installed_flows)
 {
     merge_tracked_flows(flow_table);
     struct desired_flow *f, *f_next;
@@ -1979,7 +2751,7 @@ update_installed_flows_by_track(struct ovn_desired_flow_table *flow_table,
                     installed_flow_del(&i->flow, bc, msgs);
                     ovn_flow_log(&i->flow, "removing installed (tracked)");
 
-                    hmap_remove(&installed_flows, &i->match_hmap_node);
+                    installed_flows_remove(installed_flows, i);
                     installed_flow_destroy(i);
                 } else if (was_active) {
                     /* There are other desired flow(s) referencing this
@@ -1993,7 +2765,8 @@ update_installed_flows_by_track(struct ovn_desired_flow_table *flow_table,
             desired_flow_destroy(f);
         } else {
             /* The desired flow was added or modified. */
-            struct installed_flow *i = installed_flow_lookup(&f->flow);
+            struct installed_flow *i = installed_flow_lookup(&f->flow,
+                                                             installed_flows);
             if (!i) {
                 /* Adding a new flow. */
                 installed_flow_add(&f->flow, bc, msgs);
@@ -2001,8 +2774,7 @@ update_installed_flows_by_track(struct ovn_desired_flow_table *flow_table,
 
                 /* Copy 'f' from 'flow_table' to installed_flows. */
                 struct installed_flow *new_node = installed_flow_dup(f);
-                hmap_insert(&installed_flows, &new_node->match_hmap_node,
-                            new_node->flow.hash);
+                installed_flows_insert(installed_flows, new_node);
                 link_installed_to_desired(new_node, f);
             } else if (installed_flow_get_active(i) == f) {
                 /* The installed flow is installed for f, but f has change
@@ -2028,15 +2800,40 @@ update_installed_flows_by_track(struct ovn_desired_flow_table *flow_table,
     }
 }
 
+/* Moves the flows dumped from the switch into the installed flow table of
+ * the desired flow table that has a flow with the same match, so that the
+ * comparison only updates the flows that differ.  The flows that neither
+ * table wants go to 'installed_lflows', to be deleted by the comparison.
+ *
+ * The tracked changes are dropped: the comparison covers them. */
+static void
+reconcile_installed_flows(struct ovn_desired_flow_table *lflow_table,
+                          struct ovn_desired_flow_table *pflow_table)
+{
+    ovn_desired_flow_table_flush_tracked(lflow_table);
+    ovn_desired_flow_table_flush_tracked(pflow_table);
+
+    struct installed_flow *i, *next;
+    HMAP_FOR_EACH_SAFE (i, next, match_hmap_node, &dumped_flows) {
+        hmap_remove(&dumped_flows, &i->match_hmap_node);
+        struct hmap *installed_flows
+            = (!desired_flow_lookup(lflow_table, &i->flow)
+               && desired_flow_lookup(pflow_table, &i->flow)
+               ? &installed_pflows : &installed_lflows);
+        installed_flows_insert(installed_flows, i);
+    }
+}
+
 /* The flow table can be updated if the connection to the switch is up and
- * in the correct state and not backlogged with existing flow_mods.  (Our
- * criteria for being backlogged appear very conservative, but the socket
- * between ovn-controller and OVS provides some buffering.) */
+ * in the correct state and not backlogged with existing flow_mods.  An update
+ * may be queued behind the last chunks of the previous one, but not behind
+ * more than the in-flight limit, so that the backlog stays bounded. */
 bool
 ofctrl_can_put(void)
 {
     if (state != S_UPDATE_FLOWS
-        || rconn_packet_counter_n_packets(tx_counter)
+        || n_pending_msgs
+        || !pending_msgs_can_send()
         || rconn_get_version(swconn) < 0) {
         return false;
     }
@@ -2044,7 +2841,7 @@ ofctrl_can_put(void)
 }
 
 /* Replaces the flow table on the switch, if possible, by the flows added
- * with ofctrl_add_flow().
+ * with ofctrl_add_flow() to 'lflow_table' and 'pflow_table'.
  *
  * Replaces the group table and meter table on the switch, if possible,
  * by the contents of '->desired'.
@@ -2055,16 +2852,19 @@ ofctrl_can_put(void)
  *
  * This should be called after ofctrl_run() within the main loop. */
 void
-ofctrl_put(struct ovn_desired_flow_table *flow_table,
+ofctrl_put(struct ovn_desired_flow_table *lflow_table,
+           struct ovn_desired_flow_table *pflow_table,
            struct shash *pending_ct_zones,
            const struct sbrec_meter_table *meter_table,
            uint64_t req_cfg,
-           bool flow_changed)
+           bool lflows_changed,
+           bool pflows_changed)
 {
     static bool skipped_last_time = false;
     static uint64_t old_req_cfg = 0;
     bool need_put = false;
-    if (flow_changed || skipped_last_time || need_reinstall_flows) {
+    if (lflows_changed || pflows_changed || skipped_last_time
+        || need_reinstall_flows) {
         need_put = true;
         old_req_cfg = req_cfg;
     } else if (req_cfg != old_req_cfg) {
@@ -2075,6 +2875,7 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
              */
             if (ovs_list_is_empty(&flow_updates)) {
                 cur_cfg = req_cfg;
+                sent_cfg = req_cfg;
                 old_req_cfg = req_cfg;
             }
         } else {
@@ -2096,6 +2897,12 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
     skipped_last_time = false;
     need_reinstall_flows = false;
 
+    bool reconcile = need_reconcile_flows;
+    if (reconcile) {
+        reconcile_installed_flows(lflow_table, pflow_table);
+        need_reconcile_flows = false;
+    }
+
     /* OpenFlow messages to send to the switch to bring it up-to-date. */
     struct ovs_list msgs = OVS_LIST_INITIALIZER(&msgs);
 
@@ -2111,38 +2918,27 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
     }
 
     /* Iterate through all the desired groups. If there are new ones,
-     * add them to the switch. */
-    struct ovn_extend_table_info *desired;
-    EXTEND_TABLE_FOR_EACH_UNINSTALLED (desired, groups) {
-        /* Create and install new group. */
-        struct ofputil_group_mod gm;
-        enum ofputil_protocol usable_protocols;
-        char *group_string = xasprintf("group_id=%"PRIu32",%s",
-                                       desired->table_id,
-                                       desired->name);
-        char *error = parse_ofp_group_mod_str(&gm, OFPGC15_ADD, group_string,
-                                              NULL, NULL, &usable_protocols);
-        if (!error) {
-            add_group_mod(&gm, &msgs);
-        } else {
-            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
-            VLOG_ERR_RL(&rl, "new group %s %s", error, group_string);
-            free(error);
-        }
-        free(group_string);
-        ofputil_uninit_group_mod(&gm);
-    }
+     * add them to the switch.  After a reconnection, all the desired groups
+     * are new, and the ones dumped from the switch are replaced in place so
+     * that the flows that refer to them keep working. */
+    struct hmap *dumped = reconcile ? &dumped_groups : NULL;
+    add_groups(groups, dumped, &msgs);
+    add_groups(pflow_groups, dumped, &msgs);
 
     /* Iterate through all the desired meters. If there are new ones,
      * add them to the switch. */
     struct ovn_extend_table_info *m_desired;
     EXTEND_TABLE_FOR_EACH_UNINSTALLED (m_desired, meters) {
+        uint16_t command
+            = (reconcile && dumped_ids_remove(&dumped_meters,
+                                              m_desired->table_id)
+               ? OFPMC13_MODIFY : OFPMC13_ADD);
         if (!strncmp(m_desired->name, "__string: ", 10)) {
             /* The "set-meter" action creates a meter entry name that
              * describes the meter itself. */
-            add_meter_string(m_desired, &msgs);
+            add_meter_string(m_desired, command, &msgs);
         } else {
-            add_meter(m_desired, meter_table, &msgs);
+            add_meter(m_desired, meter_table, command, &msgs);
         }
     }
 
@@ -2159,10 +2955,20 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
     bundle_open = ofputil_encode_bundle_ctrl_request(OFP15_VERSION, &bc);
     ovs_list_push_back(&msgs, &bundle_open->list_node);
 
-    if (flow_table->change_tracked) {
-        update_installed_flows_by_track(flow_table, &bc, &msgs);
+    if (lflow_table->change_tracked && !reconcile) {
+        update_installed_flows_by_track(lflow_table, &bc, &msgs,
+                                        &installed_lflows);
     } else {
-        update_installed_flows_by_compare(flow_table, &bc, &msgs);
+        update_installed_flows_by_compare(lflow_table, &bc, &msgs,
+                                          &installed_lflows);
+    }
+
+    if (pflow_table->change_tracked && !reconcile) {
+        update_installed_flows_by_track(pflow_table, &bc, &msgs,
+                                        &installed_pflows);
+    } else {
+        update_installed_flows_by_compare(pflow_table, &bc, &msgs,
+                                          &installed_pflows);
     }
 
     if (ovs_list_back(&msgs) == &bundle_open->list_node) {
@@ -2178,31 +2984,8 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
 
     /* Iterate through the installed groups from previous runs. If they
      * are not needed delete them. */
-    struct ovn_extend_table_info *installed, *next_group;
-    EXTEND_TABLE_FOR_EACH_INSTALLED (installed, next_group, groups) {
-        /* Delete the group. */
-        struct ofputil_group_mod gm;
-        enum ofputil_protocol usable_protocols;
-        char *group_string = xasprintf("group_id=%"PRIu32"",
-                                       installed->table_id);
-        char *error = parse_ofp_group_mod_str(&gm, OFPGC15_DELETE,
-                                              group_string, NULL, NULL,
-                                              &usable_protocols);
-        if (!error) {
-            add_group_mod(&gm, &msgs);
-        } else {
-            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
-            VLOG_ERR_RL(&rl, "Error deleting group %d: %s",
-                        installed->table_id, error);
-            free(error);
-        }
-        free(group_string);
-        ofputil_uninit_group_mod(&gm);
-        ovn_extend_table_remove_existing(groups, installed);
-    }
-
-    /* Sync the contents of groups->desired to groups->existing. */
-    ovn_extend_table_sync(groups);
+    delete_groups(groups, &msgs);
+    delete_groups(pflow_groups, &msgs);
 
     /* Iterate through the installed meters from previous runs. If they
      * are not needed delete them. */
@@ -2221,6 +3004,31 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
     /* Sync the contents of meters->desired to meters->existing. */
     ovn_extend_table_sync(meters);
 
+    /* Delete the groups and meters dumped from the switch that are not
+     * desired anymore, now that the flows have been updated. */
+    if (reconcile) {
+        struct dumped_id *dumped_id;
+        HMAP_FOR_EACH_POP (dumped_id, hmap_node, &dumped_groups) {
+            struct ofputil_group_mod gm;
+            memset(&gm, 0, sizeof gm);
+            gm.command = OFPGC11_DELETE;
+            gm.group_id = dumped_id->id;
+            gm.command_bucket_id = OFPG15_BUCKET_ALL;
+            ovs_list_init(&gm.buckets);
+            add_group_mod(&gm, &msgs);
+            ofputil_uninit_group_mod(&gm);
+            free(dumped_id);
+        }
+        HMAP_FOR_EACH_POP (dumped_id, hmap_node, &dumped_meters) {
+            struct ofputil_meter_mod mm = {
+                .command = OFPMC13_DELETE,
+                .meter = { .meter_id = dumped_id->id },
+            };
+            add_meter_mod(&mm, &msgs);
+            free(dumped_id);
+        }
+    }
+
     if (!ovs_list_is_empty(&msgs)) {
         /* Add a barrier to the list of messages. */
         struct ofpbuf *barrier = ofputil_encode_barrier_request(OFP15_VERSION);
@@ -2228,11 +3036,10 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
         ovs_be32 xid_ = oh->xid;
         ovs_list_push_back(&msgs, &barrier->list_node);
 
-        /* Queue the messages. */
-        struct ofpbuf *msg;
-        LIST_FOR_EACH_POP (msg, list_node, &msgs) {
-            queue_msg(msg);
-        }
+        /* Queue the messages behind the pending ones. */
+        n_pending_msgs += ovs_list_size(&msgs);
+        ovs_list_push_back_all(&pending_msgs, &msgs);
+        send_pending_msgs();
 
         /* Store the barrier's xid with any newly sent ct flushes. */
         SHASH_FOR_EACH(iter, pending_ct_zones) {
@@ -2263,6 +3070,7 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
                  * until we're really caught up. */
                 VLOG_DBG("advanced xid target for req_cfg=%"PRId64, req_cfg);
                 fup->xid = xid_;
+                fup->sent = time_msec();
                 goto done;
             } else {
                 break;
@@ -2274,6 +3082,7 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
         ovs_list_push_back(&flow_updates, &fup->list_node);
         fup->xid = xid_;
         fup->req_cfg = req_cfg;
+        fup->sent = time_msec();
     done:;
     } else if (!ovs_list_is_empty(&flow_updates)) {
         /* Getting up-to-date with 'req_cfg' didn't require any extra flow
@@ -2286,9 +3095,12 @@ ofctrl_put(struct ovn_desired_flow_table *flow_table,
         /* We were completely up-to-date before and still are. */
         cur_cfg = req_cfg;
     }
+    sent_cfg = req_cfg;
 
-    flow_table->change_tracked = true;
-    ovs_assert(ovs_list_is_empty(&flow_table->tracked_flows));
+    lflow_table->change_tracked = true;
+    pflow_table->change_tracked = true;
+    ovs_assert(ovs_list_is_empty(&lflow_table->tracked_flows));
+    ovs_assert(ovs_list_is_empty(&pflow_table->tracked_flows));
 }
 
 /* Looks up the logical port with the name 'port_name' in 'br_int_'.  If
@@ -2343,7 +3155,7 @@ ofctrl_inject_pkt(const struct ovsrec_bridge *br_int, const char *flow_s,
     }
 
     struct flow uflow;
-    char *error = expr_parse_microflow(flow_s, &symtab, addr_sets,
+    char *error = expr_parse_microflow(flow_s, symtab, addr_sets,
                                        port_groups, ofctrl_lookup_port,
                                        br_int, &uflow);
     if (error) {
@@ -2399,3 +3211,132 @@ ofctrl_set_probe_interval(int probe_interval)
         rconn_set_probe_interval(swconn, probe_interval);
     }
 }
+
+void
+ofctrl_get_memory_usage(struct simap *usage)
+{
+    size_t desired_bytes
+        = desired_flow_pool.n_objs * desired_flow_pool.obj_size
+          + desired_flow_match_bytes;
+    size_t installed_bytes
+        = installed_flow_pool.n_objs * installed_flow_pool.obj_size
+          + installed_flow_match_bytes;
+    size_t sb_ref_bytes = n_sb_flow_refs * sizeof(struct sb_flow_ref)
+                          + n_sb_to_flows * sizeof(struct sb_to_flow);
+
+    simap_increase(usage, "ofctrl-desired-flows", desired_flow_pool.n_objs);
+    simap_increase(usage, "ofctrl-desired-flows-KB",
+                   ROUND_UP(desired_bytes, 1024) / 1024);
+    simap_increase(usage, "ofctrl-installed-flows",
+                   installed_flow_pool.n_objs);
+    simap_increase(usage, "ofctrl-installed-flows-KB",
+                   ROUND_UP(installed_bytes, 1024) / 1024);
+    simap_increase(usage, "ofctrl-sb-flow-refs", n_sb_flow_refs);
+    simap_increase(usage, "ofctrl-sb-flow-refs-KB",
+                   ROUND_UP(sb_ref_bytes, 1024) / 1024);
+    simap_increase(usage, "ofctrl-flow-actions", hmap_count(&flow_actions));
+    simap_increase(usage, "ofctrl-flow-actions-KB",
+                   ROUND_UP(flow_actions_bytes, 1024) / 1024);
+}
+
+/* Updates the rates, if the last sample is old enough. */
+static void
+ofctrl_stats_sample(void)
+{
+    long long int now = time_msec();
+    long long int elapsed = now - stats_sample_time;
+
+    if (elapsed >= OFCTRL_STATS_SAMPLE_MSEC) {
+        flow_mod_rate = (n_flow_mods - stats_sample_flow_mods) * 1000.0
+                        / elapsed;
+        byte_rate = (n_bytes_sent - stats_sample_bytes) * 1000.0 / elapsed;
+        stats_sample_time = now;
+        stats_sample_flow_mods = n_flow_mods;
+        stats_sample_bytes = n_bytes_sent;
+    }
+}
+
+static uint64_t
+ofctrl_n_installed_flows(void)
+{
+    return hmap_count(&installed_lflows) + hmap_count(&installed_pflows);
+}
+
+/* Messages composed by ofctrl_put() and not sent yet, either because they
+ * wait for earlier chunks or because the connection is busy. */
+static size_t
+ofctrl_backlog(void)
+{
+    return n_pending_msgs + rconn_packet_counter_n_packets(tx_counter);
+}
+
+/* Appends to 's' the statistics of the updates of the switch, for the
+ * "ofctrl/show-stats" command. */
+void
+ofctrl_get_stats(struct ds *s)
+{
+    ofctrl_stats_sample();
+
+    ds_put_format(s, "Installed flows: %"PRIu64"\n",
+                  ofctrl_n_installed_flows());
+    ds_put_format(s, "Flow mods: %"PRIu64" (%.1f per second)\n",
+                  n_flow_mods, flow_mod_rate);
+    ds_put_format(s, "Bytes sent: %"PRIu64" (%.1f per second)\n",
+                  n_bytes_sent, byte_rate);
+    ds_put_format(s, "Acked updates: %"PRIu64, n_acked_updates);
+    if (n_acked_updates) {
+        ds_put_format(s, ", latency last %lld ms, max %lld ms, "
+                      "average %lld ms", update_latency_last,
+                      update_latency_max,
+                      update_latency_total / (long long int) n_acked_updates);
+    }
+    ds_put_format(s, "\nBacklog: %"PRIuSIZE" messages, %"PRIuSIZE
+                  " updates in flight\n", ofctrl_backlog(),
+                  ovs_list_size(&flow_updates));
+
+    ds_put_cstr(s, "Tables:\n");
+    for (size_t i = 0; i < ARRAY_SIZE(table_stats); i++) {
+        const struct ofctrl_table_stats *ts = &table_stats[i];
+        if (ts->n_flows || ts->n_flow_mods) {
+            ds_put_format(s, "  table %"PRIuSIZE": flows %"PRIu64
+                          ", flow mods %"PRIu64"\n", i, ts->n_flows,
+                          ts->n_flow_mods);
+        }
+    }
+}
+
+/* Adds to 'stats' a summary of the statistics of ofctrl_get_stats(), to
+ * store into the external_ids of the Chassis_Private record. */
+void
+ofctrl_get_stats_summary(struct smap *stats)
+{
+    ofctrl_stats_sample();
+
+    smap_add_format(stats, "ofctrl-installed-flows", "%"PRIu64,
+                    ofctrl_n_installed_flows());
+    smap_add_format(stats, "ofctrl-flow-mods", "%"PRIu64, n_flow_mods);
+    smap_add_format(stats, "ofctrl-flow-mods-rate", "%.1f", flow_mod_rate);
+    smap_add_format(stats, "ofctrl-bytes-sent", "%"PRIu64, n_bytes_sent);
+    smap_add_format(stats, "ofctrl-update-latency", "%lld",
+                    update_latency_last);
+    smap_add_format(stats, "ofctrl-backlog", "%"PRIuSIZE, ofctrl_backlog());
+
+    struct ds tables = DS_EMPTY_INITIALIZER;
+    for (size_t i = 0; i < ARRAY_SIZE(table_stats); i++) {
+        if (table_stats[i].n_flows) {
+            ds_put_format(&tables, "%s%"PRIuSIZE":%"PRIu64,
+                          tables.length ? "," : "", i, table_stats[i].n_flows);
+        }
+    }
+    smap_add(stats, "ofctrl-table-flows", ds_cstr(&tables));
+    ds_destroy(&tables);
+}
+
+/* Sets whether the flows already in the switch are reconciled with the
+ * desired flows, instead of being cleared, when the connection to the switch
+ * is (re)established.  Takes effect on the next connection. */
+void
+ofctrl_set_reconcile_flows(bool reconcile)
+{
+    reconcile_flows = reconcile;
+}
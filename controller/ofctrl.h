@@ -23,6 +23,7 @@
 #include "ovsdb-idl.h"
 #include "hindex.h"
 
+struct ds;
 struct ovn_extend_table;
 struct hmap;
 struct match;
@@ -30,6 +31,8 @@ struct ofpbuf;
 struct ovsrec_bridge;
 struct sbrec_meter_table;
 struct shash;
+struct simap;
+struct smap;
 
 struct ovn_desired_flow_table {
     /* Hash map flow table using flow match conditions as hash key.*/
@@ -39,6 +42,11 @@ struct ovn_desired_flow_table {
      * match_flow_table.*/
     struct hmap uuid_flow_table;
 
+    /* Index of the cross reference nodes by the key of their flow and their
+     * SB uuid, to find the flow of a SB uuid with a given key without
+     * walking all the flows that have the same key. */
+    struct hmap match_uuid_table;
+
     /* Is flow changes tracked. */
     bool change_tracked;
     /* Tracked flow changes. */
@@ -47,20 +55,24 @@ struct ovn_desired_flow_table {
 
 /* Interface for OVN main loop. */
 void ofctrl_init(struct ovn_extend_table *group_table,
+                 struct ovn_extend_table *pflow_group_table,
                  struct ovn_extend_table *meter_table,
                  int inactivity_probe_interval);
 void ofctrl_run(const struct ovsrec_bridge *br_int,
                 struct shash *pending_ct_zones);
 enum mf_field_id ofctrl_get_mf_field_id(void);
-void ofctrl_put(struct ovn_desired_flow_table *,
+void ofctrl_put(struct ovn_desired_flow_table *lflow_table,
+                struct ovn_desired_flow_table *pflow_table,
                 struct shash *pending_ct_zones,
                 const struct sbrec_meter_table *,
                 uint64_t nb_cfg,
-                bool flow_changed);
+                bool lflows_changed,
+                bool pflows_changed);
 bool ofctrl_can_put(void);
 void ofctrl_wait(void);
 void ofctrl_destroy(void);
 uint64_t ofctrl_get_cur_cfg(void);
+uint64_t ofctrl_get_sent_cfg(void);
 
 void ofctrl_ct_flush_zone(uint16_t zone_id);
 
@@ -86,6 +98,9 @@ void ofctrl_add_or_append_flow(struct ovn_desired_flow_table *desired_flows,
  * ofctrl_flood_remove_flows(). */
 void ofctrl_remove_flows(struct ovn_desired_flow_table *,
                          const struct uuid *sb_uuid);
+bool ofctrl_remove_flow(struct ovn_desired_flow_table *, uint8_t table_id,
+                        uint16_t priority, const struct match *,
+                        const struct uuid *sb_uuid);
 
 /* The function ofctrl_flood_remove_flows flood-removes flows from the desired
  * flow table for the sb_uuids provided in the flood_remove_nodes argument.
@@ -117,5 +132,9 @@ void ofctrl_check_and_add_flow(struct ovn_desired_flow_table *,
 
 bool ofctrl_is_connected(void);
 void ofctrl_set_probe_interval(int probe_interval);
+void ofctrl_set_reconcile_flows(bool reconcile);
+void ofctrl_get_memory_usage(struct simap *usage);
+void ofctrl_get_stats(struct ds *);
+void ofctrl_get_stats_summary(struct smap *);
 
 #endif /* controller/ofctrl.h */
@@ -32,6 +32,7 @@
 #include "dirs.h"
 #include "openvswitch/dynamic-string.h"
 #include "encaps.h"
+#include "ha-chassis.h"
 #include "fatal-signal.h"
 #include "if-status.h"
 #include "ip-mcast.h"
@@ -46,6 +47,8 @@
 #include "openvswitch/vconn.h"
 #include "openvswitch/vlog.h"
 #include "ovn/actions.h"
+#include "ovn/expr.h"
+#include "lib/acl-log.h"
 #include "lib/chassis-index.h"
 #include "lib/extend-table.h"
 #include "lib/ip-mcast-index.h"
@@ -88,15 +91,25 @@ static unixctl_cb_func debug_status_execution;
 static unixctl_cb_func debug_dump_local_bindings;
 static unixctl_cb_func lflow_cache_flush_cmd;
 static unixctl_cb_func lflow_cache_show_stats_cmd;
+static unixctl_cb_func if_status_mgr_show_stats_cmd;
+static unixctl_cb_func if_status_mgr_clear_stats_cmd;
+static unixctl_cb_func if_status_mgr_show_timeline_cmd;
+static unixctl_cb_func sb_monitor_show_stats_cmd;
+static unixctl_cb_func pinctrl_show_buffered_packets_cmd;
+static unixctl_cb_func pinctrl_show_packet_in_stats_cmd;
+static unixctl_cb_func pinctrl_show_ip_mcast_stats_cmd;
+static unixctl_cb_func ofctrl_show_stats_cmd;
 static unixctl_cb_func debug_delay_nb_cfg_report;
 
 #define DEFAULT_BRIDGE_NAME "br-int"
 #define DEFAULT_PROBE_INTERVAL_MSEC 5000
 #define OFCTRL_DEFAULT_PROBE_INTERVAL_SEC 0
+#define OFCTRL_DEFAULT_STATS_INTERVAL_SEC 60
 
 #define CONTROLLER_LOOP_STOPWATCH_NAME "ovn-controller-flow-generation"
 
 #define OVS_NB_CFG_NAME "ovn-nb-cfg"
+#define OVS_PORT_UP_LATENCY_NAME "ovn-port-up-latency"
 
 static char *parse_options(int argc, char *argv[]);
 OVS_NO_RETURN static void usage(void);
@@ -110,9 +123,17 @@ static const char *ssl_ca_cert_file;
 #define DEFAULT_LFLOW_CACHE_MAX_ENTRIES UINT32_MAX
 #define DEFAULT_LFLOW_CACHE_MAX_MEM_KB (UINT64_MAX / 1024)
 
+/* Packets buffered by pinctrl while a next hop is resolved. */
+#define DEFAULT_BUFFERED_PACKETS_DEPTH 64
+#define DEFAULT_BUFFERED_PACKETS_MAX_MEM_KB (16 * 1024)
+
 struct controller_engine_ctx {
     struct lflow_cache *lflow_cache;
     struct if_status_mgr *if_mgr;
+
+    /* Snapshot of the lflow cache, see lflow_cache_save(). */
+    char *lflow_cache_file;     /* NULL if not configured. */
+    bool lflow_cache_loaded;    /* Snapshot was read at startup. */
 };
 
 /* Pending packet to be injected into connected OVS. */
@@ -134,6 +155,23 @@ get_local_datapath(const struct hmap *local_datapaths, uint32_t tunnel_key)
             : NULL);
 }
 
+static void
+local_datapaths_get_memory_usage(const struct hmap *local_datapaths,
+                                 struct simap *usage)
+{
+    size_t bytes = ovn_hmap_buckets_size(local_datapaths);
+
+    const struct local_datapath *ld;
+    HMAP_FOR_EACH (ld, hmap_node, local_datapaths) {
+        bytes += sizeof *ld
+                 + ld->n_allocated_peer_ports * sizeof *ld->peer_ports;
+    }
+
+    simap_increase(usage, "local-datapaths", hmap_count(local_datapaths));
+    simap_increase(usage, "local-datapaths-KB",
+                   ROUND_UP(bytes, 1024) / 1024);
+}
+
 uint32_t
 get_tunnel_type(const char *name)
 {
@@ -160,6 +198,129 @@ get_bridge(const struct ovsrec_bridge_table *bridge_table, const char *br_name)
     return NULL;
 }
 
+/* SB monitor conditions.
+ *
+ * Without ovn-monitor-all, the rows that are specific to logical datapaths
+ * are requested only for the "monitored" datapaths: the local datapaths and
+ * the datapaths that stopped being local less than
+ * SB_MONITOR_DP_RETAIN_MSEC ago.  Keeping the latter for a while avoids
+ * dropping and then downloading again all the rows of a datapath, e.g. when
+ * a VIF is moved from one OVS port to another or quickly rebound.
+ *
+ * update_sb_monitors() is called at most once per main loop iteration,
+ * after the engine has run, and the IDL merges the condition changes
+ * requested while a previous request is still in flight, so a burst of
+ * local datapath changes results in few condition update requests. */
+#define SB_MONITOR_DP_RETAIN_MSEC 5000
+
+struct sb_monitor_dp {
+    struct hmap_node hmap_node; /* In 'sb_monitor.dps', by uuid_hash(). */
+    struct uuid uuid;
+    bool local;                 /* Local in the last update. */
+    long long int last_local;   /* Last time the datapath was local. */
+};
+
+static struct sb_monitor {
+    struct hmap dps;            /* Contains "struct sb_monitor_dp"s. */
+    long long int next_expiry;  /* When a retained datapath expires. */
+    bool monitor_all;
+    unsigned int expected_cond_seqno;
+    uint64_t n_updates;         /* Updates that changed the conditions. */
+    uint64_t n_calls;
+} sb_monitor = {
+    .dps = HMAP_INITIALIZER(&sb_monitor.dps),
+    .next_expiry = LLONG_MAX,
+};
+
+static struct sb_monitor_dp *
+sb_monitor_dp_find(const struct uuid *uuid)
+{
+    struct sb_monitor_dp *mdp;
+
+    HMAP_FOR_EACH_WITH_HASH (mdp, hmap_node, uuid_hash(uuid),
+                             &sb_monitor.dps) {
+        if (uuid_equals(&mdp->uuid, uuid)) {
+            return mdp;
+        }
+    }
+    return NULL;
+}
+
+static void
+sb_monitor_clear_dps(void)
+{
+    struct sb_monitor_dp *mdp;
+
+    HMAP_FOR_EACH_POP (mdp, hmap_node, &sb_monitor.dps) {
+        free(mdp);
+    }
+    sb_monitor.next_expiry = LLONG_MAX;
+}
+
+/* Updates the monitored datapaths from 'local_datapaths' and expires the
+ * datapaths retained for too long. */
+static void
+sb_monitor_update_dps(const struct hmap *local_datapaths)
+{
+    long long int now = time_msec();
+    struct sb_monitor_dp *mdp, *next;
+
+    HMAP_FOR_EACH (mdp, hmap_node, &sb_monitor.dps) {
+        mdp->local = false;
+    }
+
+    if (local_datapaths) {
+        const struct local_datapath *ld;
+        HMAP_FOR_EACH (ld, hmap_node, local_datapaths) {
+            const struct uuid *uuid = &ld->datapath->header_.uuid;
+
+            mdp = sb_monitor_dp_find(uuid);
+            if (!mdp) {
+                mdp = xmalloc(sizeof *mdp);
+                mdp->uuid = *uuid;
+                hmap_insert(&sb_monitor.dps, &mdp->hmap_node,
+                            uuid_hash(uuid));
+            }
+            mdp->local = true;
+            mdp->last_local = now;
+        }
+    }
+
+    sb_monitor.next_expiry = LLONG_MAX;
+    HMAP_FOR_EACH_SAFE (mdp, next, hmap_node, &sb_monitor.dps) {
+        if (mdp->local) {
+            continue;
+        }
+        long long int expiry = mdp->last_local + SB_MONITOR_DP_RETAIN_MSEC;
+        if (expiry <= now) {
+            hmap_remove(&sb_monitor.dps, &mdp->hmap_node);
+            free(mdp);
+        } else {
+            sb_monitor.next_expiry = MIN(sb_monitor.next_expiry, expiry);
+        }
+    }
+}
+
+/* Returns true if a retained datapath expired, so that the monitor
+ * conditions need to be narrowed. */
+static bool
+sb_monitor_expired(void)
+{
+    return time_msec() >= sb_monitor.next_expiry;
+}
+
+/* Wakes up the main loop when a retained datapath expires.  An expiry that
+ * could not be processed yet, e.g. because the engine did not run, is
+ * processed at the next wake up instead of busy looping. */
+static void
+sb_monitor_wait(void)
+{
+    if (sb_monitor.next_expiry != LLONG_MAX
+        && sb_monitor.next_expiry > time_msec()) {
+        poll_timer_wait_until(sb_monitor.next_expiry);
+    }
+}
+
 static unsigned int
 update_sb_monitors(struct ovsdb_idl *ovnsb_idl,
                    const struct sbrec_chassis *chassis,
@@ -167,39 +328,48 @@ update_sb_monitors(struct ovsdb_idl *ovnsb_idl,
                    struct hmap *local_datapaths,
                    bool monitor_all)
 {
-    /* Monitor Port_Bindings rows for local interfaces and local datapaths.
+    /* Monitor Port_Bindings rows for local interfaces and monitored
+     * datapaths.
      *
-     * Monitor Logical_Flow, MAC_Binding, Multicast_Group, and DNS tables for
-     * local datapaths.
+     * Monitor Logical_Flow, Logical_DP_Group, MAC_Binding, Multicast_Group,
+     * DNS and Load_Balancer tables for monitored datapaths.
      *
      * Monitor Controller_Event rows for local chassis.
      *
-     * Monitor IP_Multicast for local datapaths.
+     * Monitor IP_Multicast for monitored datapaths.
      *
      * Monitor IGMP_Groups for local chassis.
      *
-     * We always monitor patch ports because they allow us to see the linkages
-     * between related logical datapaths.  That way, when we know that we have
-     * a VIF on a particular logical switch, we immediately know to monitor all
-     * the connected logical routers and logical switches. */
+     * We monitor the peers of the patch and l3gateway ports of the
+     * monitored datapaths because they allow us to see the linkages between
+     * related logical datapaths.  That way, when we know that we have a VIF
+     * on a particular logical switch, we get the connected logical routers
+     * and logical switches, and then their own peers, until the closure of
+     * the local datapaths is monitored. */
     struct ovsdb_idl_condition pb = OVSDB_IDL_CONDITION_INIT(&pb);
     struct ovsdb_idl_condition lf = OVSDB_IDL_CONDITION_INIT(&lf);
     struct ovsdb_idl_condition ldpg = OVSDB_IDL_CONDITION_INIT(&ldpg);
     struct ovsdb_idl_condition mb = OVSDB_IDL_CONDITION_INIT(&mb);
     struct ovsdb_idl_condition mg = OVSDB_IDL_CONDITION_INIT(&mg);
     struct ovsdb_idl_condition dns = OVSDB_IDL_CONDITION_INIT(&dns);
+    struct ovsdb_idl_condition lb = OVSDB_IDL_CONDITION_INIT(&lb);
     struct ovsdb_idl_condition ce =  OVSDB_IDL_CONDITION_INIT(&ce);
     struct ovsdb_idl_condition ip_mcast = OVSDB_IDL_CONDITION_INIT(&ip_mcast);
     struct ovsdb_idl_condition igmp = OVSDB_IDL_CONDITION_INIT(&igmp);
     struct ovsdb_idl_condition chprv = OVSDB_IDL_CONDITION_INIT(&chprv);
 
+    sb_monitor.n_calls++;
+    sb_monitor.monitor_all = monitor_all;
+
     if (monitor_all) {
+        sb_monitor_clear_dps();
         ovsdb_idl_condition_add_clause_true(&pb);
         ovsdb_idl_condition_add_clause_true(&lf);
         ovsdb_idl_condition_add_clause_true(&ldpg);
         ovsdb_idl_condition_add_clause_true(&mb);
         ovsdb_idl_condition_add_clause_true(&mg);
         ovsdb_idl_condition_add_clause_true(&dns);
+        ovsdb_idl_condition_add_clause_true(&lb);
         ovsdb_idl_condition_add_clause_true(&ce);
         ovsdb_idl_condition_add_clause_true(&ip_mcast);
         ovsdb_idl_condition_add_clause_true(&igmp);
@@ -207,7 +377,6 @@ update_sb_monitors(struct ovsdb_idl *ovnsb_idl,
         goto out;
     }
 
-    sbrec_port_binding_add_clause_type(&pb, OVSDB_F_EQ, "patch");
     /* XXX: We can optimize this, if we find a way to only monitor
      * ports that have a Gateway_Chassis that point's to our own
      * chassis */
@@ -253,10 +422,11 @@ update_sb_monitors(struct ovsdb_idl *ovnsb_idl,
         }
     }
     if (local_datapaths) {
-        const struct local_datapath *ld;
-        HMAP_FOR_EACH (ld, hmap_node, local_datapaths) {
-            struct uuid *uuid = CONST_CAST(struct uuid *,
-                                           &ld->datapath->header_.uuid);
+        sb_monitor_update_dps(local_datapaths);
+
+        const struct sb_monitor_dp *mdp;
+        HMAP_FOR_EACH (mdp, hmap_node, &sb_monitor.dps) {
+            struct uuid *uuid = CONST_CAST(struct uuid *, &mdp->uuid);
             sbrec_port_binding_add_clause_datapath(&pb, OVSDB_F_EQ, uuid);
             sbrec_logical_flow_add_clause_logical_datapath(&lf, OVSDB_F_EQ,
                                                            uuid);
@@ -265,19 +435,39 @@ update_sb_monitors(struct ovsdb_idl *ovnsb_idl,
             sbrec_mac_binding_add_clause_datapath(&mb, OVSDB_F_EQ, uuid);
             sbrec_multicast_group_add_clause_datapath(&mg, OVSDB_F_EQ, uuid);
             sbrec_dns_add_clause_datapaths(&dns, OVSDB_F_INCLUDES, &uuid, 1);
+            sbrec_load_balancer_add_clause_datapaths(&lb, OVSDB_F_INCLUDES,
+                                                     &uuid, 1);
             sbrec_ip_multicast_add_clause_datapath(&ip_mcast, OVSDB_F_EQ,
                                                    uuid);
         }
 
+        const struct sbrec_port_binding *binding;
+        SBREC_PORT_BINDING_FOR_EACH (binding, ovnsb_idl) {
+            if (strcmp(binding->type, "patch")
+                && strcmp(binding->type, "l3gateway")) {
+                continue;
+            }
+            const char *peer = smap_get(&binding->options, "peer");
+            if (peer && binding->datapath
+                && sb_monitor_dp_find(&binding->datapath->header_.uuid)) {
+                sbrec_port_binding_add_clause_logical_port(&pb, OVSDB_F_EQ,
+                                                           peer);
+            }
+        }
+
         /* Datapath groups are immutable, which means a new group record is
          * created when a datapath is added to a group.  The logical flows
          * referencing a datapath group are also updated in such cases but the
          * new group UUID is not known by ovn-controller until the SB update
-         * is received.  To avoid unnecessarily removing and adding lflows
-         * that reference datapath groups, set the monitor condition to always
-         * request all of them.
-         */
-        sbrec_logical_flow_add_clause_logical_dp_group(&lf, OVSDB_F_NE, NULL);
+         * is received.  Such logical flows are removed from the monitored
+         * rows until the next condition update adds the new group, which
+         * happens as soon as the group is received, because the
+         * Logical_DP_Group monitor condition already includes it. */
+        const struct sbrec_logical_dp_group *dp_group;
+        SBREC_LOGICAL_DP_GROUP_FOR_EACH (dp_group, ovnsb_idl) {
+            sbrec_logical_flow_add_clause_logical_dp_group(
+                &lf, OVSDB_F_EQ, &dp_group->header_.uuid);
+        }
     }
 
 out:;
@@ -288,6 +478,7 @@ out:;
         sbrec_mac_binding_set_condition(ovnsb_idl, &mb),
         sbrec_multicast_group_set_condition(ovnsb_idl, &mg),
         sbrec_dns_set_condition(ovnsb_idl, &dns),
+        sbrec_load_balancer_set_condition(ovnsb_idl, &lb),
         sbrec_controller_event_set_condition(ovnsb_idl, &ce),
         sbrec_ip_multicast_set_condition(ovnsb_idl, &ip_mcast),
         sbrec_igmp_group_set_condition(ovnsb_idl, &igmp),
@@ -298,6 +489,10 @@ out:;
     for (size_t i = 0; i < ARRAY_SIZE(cond_seqnos); i++) {
         expected_cond_seqno = MAX(expected_cond_seqno, cond_seqnos[i]);
     }
+    if (expected_cond_seqno != sb_monitor.expected_cond_seqno) {
+        sb_monitor.expected_cond_seqno = expected_cond_seqno;
+        sb_monitor.n_updates++;
+    }
 
     ovsdb_idl_condition_destroy(&pb);
     ovsdb_idl_condition_destroy(&lf);
@@ -305,6 +500,7 @@ out:;
     ovsdb_idl_condition_destroy(&mb);
     ovsdb_idl_condition_destroy(&mg);
     ovsdb_idl_condition_destroy(&dns);
+    ovsdb_idl_condition_destroy(&lb);
     ovsdb_idl_condition_destroy(&ce);
     ovsdb_idl_condition_destroy(&ip_mcast);
     ovsdb_idl_condition_destroy(&igmp);
@@ -476,8 +672,91 @@ get_ofctrl_probe_interval(struct ovsdb_idl *ovs_idl)
                                OFCTRL_DEFAULT_PROBE_INTERVAL_SEC);
 }
 
+static unsigned int
+get_ofctrl_stats_interval(struct ovsdb_idl *ovs_idl)
+{
+    const struct ovsrec_open_vswitch *cfg = ovsrec_open_vswitch_first(ovs_idl);
+    return !cfg ? OFCTRL_DEFAULT_STATS_INTERVAL_SEC :
+                  smap_get_uint(&cfg->external_ids,
+                                "ovn-ofctrl-stats-interval",
+                                OFCTRL_DEFAULT_STATS_INTERVAL_SEC);
+}
+
+static bool
+get_ofctrl_reconcile_flows(struct ovsdb_idl *ovs_idl)
+{
+    const struct ovsrec_open_vswitch *cfg = ovsrec_open_vswitch_first(ovs_idl);
+    return cfg && smap_get_bool(&cfg->external_ids,
+                                "ovn-ofctrl-reconcile-flows", false);
+}
+
 /* Retrieves the pointer to the OVN Southbound database from 'ovs_idl' and
  * updates 'sbdb_idl' with that pointer. */
+struct sb_remote {
+    uint32_t weight;
+    char *name;
+};
+
+static int
+compare_sb_remotes(const void *a_, const void *b_)
+{
+    const struct sb_remote *a = a_;
+    const struct sb_remote *b = b_;
+
+    if (a->weight != b->weight) {
+        return a->weight > b->weight ? -1 : 1;
+    }
+    return strcmp(a->name, b->name);
+}
+
+/* Returns a malloc()'d copy of the comma-separated list of SB 'remote's,
+ * ordered by decreasing hash of each of them with 'chassis_id', or NULL if
+ * there is nothing to order.
+ *
+ * Each chassis thus connects first to a server picked by its name, which
+ * spreads the chassis evenly over the servers of a cluster, and after a
+ * failure of that server its chassis are still spread evenly over the
+ * remaining ones. */
+static char *
+get_chassis_hashed_remote(const char *remote, const char *chassis_id)
+{
+    if (!chassis_id || !strchr(remote, ',')) {
+        return NULL;
+    }
+
+    struct sb_remote *remotes = NULL;
+    size_t n = 0, allocated = 0;
+    uint32_t basis = hash_string(chassis_id, 0);
+
+    char *tokstr = xstrdup(remote);
+    char *save_ptr = NULL;
+    for (char *token = strtok_r(tokstr, ", ", &save_ptr); token;
+         token = strtok_r(NULL, ", ", &save_ptr)) {
+        if (n >= allocated) {
+            remotes = x2nrealloc(remotes, &allocated, sizeof *remotes);
+        }
+        remotes[n++] = (struct sb_remote) {
+            .weight = hash_string(token, basis),
+            .name = token,
+        };
+    }
+
+    char *hashed_remote = NULL;
+    if (n > 1) {
+        qsort(remotes, n, sizeof *remotes, compare_sb_remotes);
+
+        struct ds ds = DS_EMPTY_INITIALIZER;
+        for (size_t i = 0; i < n; i++) {
+            ds_put_format(&ds, "%s%s", i ? "," : "", remotes[i].name);
+        }
+        hashed_remote = ds_steal_cstr(&ds);
+    }
+
+    free(remotes);
+    free(tokstr);
+    return hashed_remote;
+}
+
 static void
 update_sb_db(struct ovsdb_idl *ovs_idl, struct ovsdb_idl *ovnsb_idl,
              bool *monitor_all_p, bool *reset_ovnsb_idl_min_index,
@@ -491,7 +770,16 @@ update_sb_db(struct ovsdb_idl *ovs_idl, struct ovsdb_idl *ovnsb_idl,
 
     /* Set remote based on user configuration. */
     const char *remote = smap_get(&cfg->external_ids, "ovn-remote");
-    ovsdb_idl_set_remote(ovnsb_idl, remote, true);
+    char *hashed_remote = NULL;
+    if (remote && smap_get_bool(&cfg->external_ids, "ovn-remote-chassis-hash",
+                                false)) {
+        hashed_remote = get_chassis_hashed_remote(
+            remote, smap_get(&cfg->external_ids, "system-id"));
+    }
+    ovsdb_idl_set_shuffle_remotes(ovnsb_idl, !hashed_remote);
+    ovsdb_idl_set_remote(ovnsb_idl, hashed_remote ? hashed_remote : remote,
+                         true);
+    free(hashed_remote);
 
     /* Set probe interval, based on user configuration and the remote. */
     int default_interval = (remote && !stream_or_pstream_needs_probes(remote)
@@ -534,6 +822,62 @@ update_sb_db(struct ovsdb_idl *ovs_idl, struct ovsdb_idl *ovnsb_idl,
                            smap_get_ullong(&cfg->external_ids,
                                            "ovn-memlimit-lflow-cache-kb",
                                            DEFAULT_LFLOW_CACHE_MAX_MEM_KB));
+        lflow_set_parallel_parsing(
+            smap_get_bool(&cfg->external_ids,
+                          "ovn-enable-parallel-lflow-parsing", false));
+        if (expr_set_aggregate_prefixes(
+                smap_get_bool(&cfg->external_ids, "ovn-aggregate-prefixes",
+                              false))) {
+            /* The cached matches were computed with the previous setting. */
+            lflow_cache_flush(ctx->lflow_cache);
+            engine_set_force_recompute(true);
+        }
+        if (expr_set_cross_product_limit(
+                smap_get_uint(&cfg->external_ids,
+                              "ovn-cross-product-limit", 0))) {
+            lflow_cache_flush(ctx->lflow_cache);
+            engine_set_force_recompute(true);
+        }
+        binding_set_parallel(
+            smap_get_bool(&cfg->external_ids,
+                          "ovn-enable-parallel-binding", false));
+        ctrl_ddlog_set_enabled(
+            smap_get_bool(&cfg->external_ids, "ovn-ddlog", false));
+        if_status_mgr_set_flush_interval(
+            ctx->if_mgr, smap_get_uint(&cfg->external_ids,
+                                       "ovn-if-status-flush-interval", 0));
+        pinctrl_set_n_workers(
+            smap_get_uint(&cfg->external_ids, "ovn-pinctrl-workers", 0));
+        pinctrl_set_packet_in_rate(
+            smap_get_uint(&cfg->external_ids, "ovn-packet-in-rate", 0));
+        pinctrl_set_buffered_packets_limits(
+            smap_get_uint(&cfg->external_ids, "ovn-buffered-packets-depth",
+                          DEFAULT_BUFFERED_PACKETS_DEPTH),
+            smap_get_ullong(&cfg->external_ids,
+                            "ovn-memlimit-buffered-packets-kb",
+                            DEFAULT_BUFFERED_PACKETS_MAX_MEM_KB) * 1024);
+        acl_log_set_aggregate_interval(
+            smap_get_uint(&cfg->external_ids,
+                          "ovn-acl-log-aggregate-interval", 0));
+        pinctrl_set_mac_binding_limits(
+            smap_get_uint(&cfg->external_ids, "ovn-mac-binding-rate", 0),
+            smap_get_uint(&cfg->external_ids,
+                          "ovn-mac-binding-flush-interval", 0));
+        if (pinctrl_set_bfd_thread(
+                smap_get_bool(&cfg->external_ids, "ovn-bfd-thread", false))) {
+            /* The bfd_msg actions send their packets to the connection of
+             * the BFD thread, if any. */
+            lflow_set_bfd_controller_id(pinctrl_bfd_controller_id());
+            engine_set_force_recompute(true);
+        }
+
+        const char *lflow_cache_file = smap_get(&cfg->external_ids,
+                                                "ovn-lflow-cache-file");
+        if (!nullable_string_is_equal(lflow_cache_file,
+                                      ctx->lflow_cache_file)) {
+            free(ctx->lflow_cache_file);
+            ctx->lflow_cache_file = nullable_xstrdup(lflow_cache_file);
+        }
     }
 }
 
@@ -835,6 +1179,70 @@ done:
     ofctrl_acked_seqnos_destroy(acked_nb_cfg_seqnos);
 }
 
+/* Publishes the histogram of the latencies from the claim of the local ports
+ * to them being marked "up" in the local OVS DB, so that it can be collected
+ * without access to the unixctl socket. */
+static void
+store_port_up_latency(struct ovsdb_idl_txn *ovs_txn,
+                      const struct ovsrec_bridge *br_int,
+                      const struct if_status_mgr *if_mgr)
+{
+    if (!ovs_txn || !br_int) {
+        return;
+    }
+
+    struct ds latency = DS_EMPTY_INITIALIZER;
+    if_status_mgr_format_up_latency(if_mgr, &latency);
+    if (strcmp(ds_cstr(&latency),
+               smap_get_def(&br_int->external_ids,
+                            OVS_PORT_UP_LATENCY_NAME, ""))) {
+        ovsrec_bridge_update_external_ids_setkey(br_int,
+                                                 OVS_PORT_UP_LATENCY_NAME,
+                                                 ds_cstr(&latency));
+    }
+    ds_destroy(&latency);
+}
+
+/* Stores a summary of the statistics of ofctrl into the external_ids of
+ * 'chassis' every 'interval' seconds, so that the programming of the
+ * switches can be monitored across the chassis without access to their
+ * unixctl sockets. */
+static void
+store_ofctrl_stats(struct ovsdb_idl_txn *sb_txn,
+                   const struct sbrec_chassis_private *chassis,
+                   unsigned int interval)
+{
+    static long long int last_store = LLONG_MIN;
+
+    if (!interval) {
+        return;
+    }
+
+    long long int now = time_msec();
+    long long int next_store = (last_store == LLONG_MIN ? now
+                                : last_store + interval * 1000LL);
+    if (now >= next_store) {
+        if (!sb_txn || !chassis) {
+            return;
+        }
+
+        struct smap stats = SMAP_INITIALIZER(&stats);
+        ofctrl_get_stats_summary(&stats);
+        struct smap_node *node;
+        SMAP_FOR_EACH (node, &stats) {
+            if (strcmp(node->value, smap_get_def(&chassis->external_ids,
+                                                 node->key, ""))) {
+                sbrec_chassis_private_update_external_ids_setkey(
+                    chassis, node->key, node->value);
+            }
+        }
+        smap_destroy(&stats);
+        last_store = now;
+        next_store = now + interval * 1000LL;
+    }
+    poll_timer_wait_until(next_store);
+}
+
 static const char *
 get_transport_zones(const struct ovsrec_open_vswitch_table *ovs_table)
 {
@@ -843,6 +1251,14 @@ get_transport_zones(const struct ovsrec_open_vswitch_table *ovs_table)
     return smap_get_def(&cfg->external_ids, "ovn-transport-zones", "");
 }
 
+static bool
+get_on_demand_tunnels(const struct ovsrec_open_vswitch_table *ovs_table)
+{
+    const struct ovsrec_open_vswitch *cfg
+        = ovsrec_open_vswitch_table_first(ovs_table);
+    return smap_get_bool(&cfg->external_ids, "ovn-on-demand-tunnels", false);
+}
+
 static void
 ctrl_register_ovs_idl(struct ovsdb_idl *ovs_idl)
 {
@@ -993,8 +1409,8 @@ struct ed_type_runtime_data {
 
 /* struct ed_type_runtime_data has the below members for tracking the
  * changes done to the runtime_data engine by the runtime_data engine
- * handlers. Since this engine is an input to the flow_output engine,
- * the flow output runtime data handler will make use of this tracked data.
+ * handlers. Since this engine is an input to the lflow_output engine,
+ * the lflow output runtime data handler will make use of this tracked data.
  *
  *  ------------------------------------------------------------------------
  * |                      | This is a hmap of                               |
@@ -1246,6 +1662,8 @@ en_runtime_data_run(struct engine_node *node, void *data)
          * connected. */
         bfd_calculate_active_tunnels(b_ctx_in.br_int, active_tunnels);
     }
+    /* The BFD state of the tunnels may have changed. */
+    ha_chassis_cache_flush();
 
     binding_run(&b_ctx_in, &b_ctx_out);
 
@@ -1274,6 +1692,30 @@ runtime_data_ovs_interface_handler(struct engine_node *node, void *data)
     return true;
 }
 
+/* Only the local chassis record matters to the runtime data.  The remote
+ * chassis are used by the physical flows, through their tunnels. */
+static bool
+runtime_data_sb_chassis_handler(struct engine_node *node,
+                                void *data OVS_UNUSED)
+{
+    struct ovsrec_open_vswitch_table *ovs_table =
+        (struct ovsrec_open_vswitch_table *)EN_OVSDB_GET(
+            engine_get_input("OVS_open_vswitch", node));
+    struct sbrec_chassis_table *chassis_table =
+        (struct sbrec_chassis_table *)EN_OVSDB_GET(
+            engine_get_input("SB_chassis", node));
+    const char *chassis_id = get_ovs_chassis_id(ovs_table);
+
+    const struct sbrec_chassis *chassis;
+    SBREC_CHASSIS_TABLE_FOR_EACH_TRACKED (chassis, chassis_table) {
+        if (!chassis_id || !strcmp(chassis->name, chassis_id)
+            || sbrec_chassis_is_updated(chassis, SBREC_CHASSIS_COL_NAME)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static bool
 runtime_data_sb_port_binding_handler(struct engine_node *node, void *data)
 {
@@ -1329,6 +1771,7 @@ struct ed_type_addr_sets {
     struct sset new;
     struct sset deleted;
     struct sset updated;
+    struct shash diffs;  /* Contains "struct const_set_diff"s for 'updated'. */
 };
 
 static void *
@@ -1342,9 +1785,54 @@ en_addr_sets_init(struct engine_node *node OVS_UNUSED,
     sset_init(&as->new);
     sset_init(&as->deleted);
     sset_init(&as->updated);
+    shash_init(&as->diffs);
     return as;
 }
 
+static void
+const_set_diff_destroy(struct const_set_diff *diff)
+{
+    if (diff) {
+        expr_constant_set_destroy(diff->added);
+        free(diff->added);
+        expr_constant_set_destroy(diff->deleted);
+        free(diff->deleted);
+        free(diff);
+    }
+}
+
+/* Records in 'diffs' the constants added to and deleted from the constant set
+ * 'name' from 'old_cs' to 'new_cs'.  If the set was already updated since
+ * 'diffs' was cleared, the changes aren't tracked anymore: the NULL diff
+ * means that the logical flows have to be translated again. */
+static void
+const_set_diffs_add(struct shash *diffs, const char *name,
+                    const struct expr_constant_set *old_cs,
+                    const struct expr_constant_set *new_cs)
+{
+    struct shash_node *node = shash_find(diffs, name);
+    if (node) {
+        const_set_diff_destroy(node->data);
+        node->data = NULL;
+        return;
+    }
+
+    struct const_set_diff *diff = xmalloc(sizeof *diff);
+    expr_constant_set_diff(old_cs, new_cs, &diff->added, &diff->deleted);
+    shash_add(diffs, name, diff);
+}
+
+static void
+const_set_diffs_clear(struct shash *diffs)
+{
+    struct shash_node *node, *next;
+
+    SHASH_FOR_EACH_SAFE (node, next, diffs) {
+        const_set_diff_destroy(node->data);
+        shash_delete(diffs, node);
+    }
+}
+
 static void
 en_addr_sets_cleanup(void *data)
 {
@@ -1354,6 +1842,8 @@ en_addr_sets_cleanup(void *data)
     sset_destroy(&as->new);
     sset_destroy(&as->deleted);
     sset_destroy(&as->updated);
+    const_set_diffs_clear(&as->diffs);
+    shash_destroy(&as->diffs);
 }
 
 /* Iterate address sets in the southbound database.  Create and update the
@@ -1370,10 +1860,14 @@ addr_sets_init(const struct sbrec_address_set_table *address_set_table,
     }
 }
 
+/* Updates 'addr_sets' with the tracked changes of the address sets.  For
+ * the updated address sets, also stores in 'diffs' the addresses that were
+ * added and deleted. */
 static void
 addr_sets_update(const struct sbrec_address_set_table *address_set_table,
                  struct shash *addr_sets, struct sset *new,
-                 struct sset *deleted, struct sset *updated)
+                 struct sset *deleted, struct sset *updated,
+                 struct shash *diffs)
 {
     const struct sbrec_address_set *as;
     SBREC_ADDRESS_SET_TABLE_FOR_EACH_TRACKED (as, address_set_table) {
@@ -1381,6 +1875,8 @@ addr_sets_update(const struct sbrec_address_set_table *address_set_table,
             expr_const_sets_remove(addr_sets, as->name);
             sset_add(deleted, as->name);
         } else {
+            struct expr_constant_set *old_cs
+                = shash_find_and_delete(addr_sets, as->name);
             expr_const_sets_add_integers(addr_sets, as->name,
                                          (const char *const *) as->addresses,
                                          as->n_addresses);
@@ -1388,7 +1884,13 @@ addr_sets_update(const struct sbrec_address_set_table *address_set_table,
                 sset_add(new, as->name);
             } else {
                 sset_add(updated, as->name);
+                if (old_cs) {
+                    const_set_diffs_add(diffs, as->name, old_cs,
+                                        shash_find_data(addr_sets, as->name));
+                }
             }
+            expr_constant_set_destroy(old_cs);
+            free(old_cs);
         }
     }
 }
@@ -1401,6 +1903,7 @@ en_addr_sets_run(struct engine_node *node, void *data)
     sset_clear(&as->new);
     sset_clear(&as->deleted);
     sset_clear(&as->updated);
+    const_set_diffs_clear(&as->diffs);
     expr_const_sets_destroy(&as->addr_sets);
 
     struct sbrec_address_set_table *as_table =
@@ -1421,13 +1924,14 @@ addr_sets_sb_address_set_handler(struct engine_node *node, void *data)
     sset_clear(&as->new);
     sset_clear(&as->deleted);
     sset_clear(&as->updated);
+    const_set_diffs_clear(&as->diffs);
 
     struct sbrec_address_set_table *as_table =
         (struct sbrec_address_set_table *)EN_OVSDB_GET(
             engine_get_input("SB_address_set", node));
 
     addr_sets_update(as_table, &as->addr_sets, &as->new,
-                     &as->deleted, &as->updated);
+                     &as->deleted, &as->updated, &as->diffs);
 
     if (!sset_is_empty(&as->new) || !sset_is_empty(&as->deleted) ||
             !sset_is_empty(&as->updated)) {
@@ -1452,6 +1956,7 @@ struct ed_type_port_groups{
     struct sset new;
     struct sset deleted;
     struct sset updated;
+    struct shash diffs;  /* Contains "struct const_set_diff"s for 'updated'. */
 };
 
 static void
@@ -1511,6 +2016,7 @@ en_port_groups_init(struct engine_node *node OVS_UNUSED,
     sset_init(&pg->new);
     sset_init(&pg->deleted);
     sset_init(&pg->updated);
+    shash_init(&pg->diffs);
     return pg;
 }
 
@@ -1528,6 +2034,8 @@ en_port_groups_cleanup(void *data)
     sset_destroy(&pg->new);
     sset_destroy(&pg->deleted);
     sset_destroy(&pg->updated);
+    const_set_diffs_clear(&pg->diffs);
+    shash_destroy(&pg->diffs);
 }
 
 static void
@@ -1545,13 +2053,34 @@ port_groups_init(const struct sbrec_port_group_table *port_group_table,
     }
 }
 
+/* Replaces the local ports of port group 'pg' in 'port_groups_cs_local' and
+ * records in 'diffs' the ports that were added and deleted. */
+static void
+port_groups_cs_local_update(struct shash *port_groups_cs_local,
+                            const struct sbrec_port_group *pg,
+                            const struct sset *local_lports,
+                            struct shash *diffs)
+{
+    struct expr_constant_set *old_cs
+        = shash_find_and_delete(port_groups_cs_local, pg->name);
+    expr_const_sets_add_strings(port_groups_cs_local, pg->name,
+                                (const char *const *) pg->ports,
+                                pg->n_ports, local_lports);
+    if (old_cs) {
+        const_set_diffs_add(diffs, pg->name, old_cs,
+                            shash_find_data(port_groups_cs_local, pg->name));
+        expr_constant_set_destroy(old_cs);
+        free(old_cs);
+    }
+}
+
 static void
 port_groups_update(const struct sbrec_port_group_table *port_group_table,
                    const struct sset *local_lports,
                    struct shash *port_group_ssets,
                    struct shash *port_groups_cs_local,
                    struct sset *new, struct sset *deleted,
-                   struct sset *updated)
+                   struct sset *updated, struct shash *diffs)
 {
     const struct sbrec_port_group *pg;
     SBREC_PORT_GROUP_TABLE_FOR_EACH_TRACKED (pg, port_group_table) {
@@ -1561,12 +2090,14 @@ port_groups_update(const struct sbrec_port_group_table *port_group_table,
             sset_add(deleted, pg->name);
         } else {
             port_group_ssets_add_or_update(port_group_ssets, pg);
-            expr_const_sets_add_strings(port_groups_cs_local, pg->name,
-                                        (const char *const *) pg->ports,
-                                        pg->n_ports, local_lports);
             if (sbrec_port_group_is_new(pg)) {
+                expr_const_sets_add_strings(port_groups_cs_local, pg->name,
+                                            (const char *const *) pg->ports,
+                                            pg->n_ports, local_lports);
                 sset_add(new, pg->name);
             } else {
+                port_groups_cs_local_update(port_groups_cs_local, pg,
+                                            local_lports, diffs);
                 sset_add(updated, pg->name);
             }
         }
@@ -1580,6 +2111,7 @@ en_port_groups_clear_tracked_data(void *data_)
     sset_clear(&pg->new);
     sset_clear(&pg->deleted);
     sset_clear(&pg->updated);
+    const_set_diffs_clear(&pg->diffs);
     pg->change_tracked = false;
 }
 
@@ -1590,6 +2122,7 @@ en_port_groups_run(struct engine_node *node, void *data)
 
     expr_const_sets_destroy(&pg->port_groups_cs_local);
     port_group_ssets_clear(&pg->port_group_ssets);
+    const_set_diffs_clear(&pg->diffs);
 
     struct sbrec_port_group_table *pg_table =
         (struct sbrec_port_group_table *)EN_OVSDB_GET(
@@ -1623,7 +2156,7 @@ port_groups_sb_port_group_handler(struct engine_node *node, void *data)
         &rt_data->lbinding_data);
     port_groups_update(pg_table, local_b_lports, &pg->port_group_ssets,
                        &pg->port_groups_cs_local, &pg->new, &pg->deleted,
-                       &pg->updated);
+                       &pg->updated, &pg->diffs);
     binding_destroy_local_binding_lports(local_b_lports);
 
     if (!sset_is_empty(&pg->new) || !sset_is_empty(&pg->deleted) ||
@@ -1684,9 +2217,8 @@ port_groups_runtime_data_handler(struct engine_node *node, void *data)
             }
         }
         if (need_update) {
-            expr_const_sets_add_strings(&pg->port_groups_cs_local, pg_sb->name,
-                                        (const char *const *) pg_sb->ports,
-                                        pg_sb->n_ports, local_b_lports);
+            port_groups_cs_local_update(&pg->port_groups_cs_local, pg_sb,
+                                        local_b_lports, &pg->diffs);
             sset_add(&pg->updated, pg_sb->name);
         }
     }
@@ -1798,10 +2330,10 @@ en_mff_ovn_geneve_run(struct engine_node *node, void *data)
  *   - recompute only physical flows or
  *   - we can incrementally process the physical flows.
  *
- * en_physical_flow_changes is an input to flow_output engine node.
+ * en_physical_flow_changes is an input to pflow_output engine node.
  * If the engine node 'en_physical_flow_changes' gets updated during
  * engine run, it means the handler for this -
- * flow_output_physical_flow_changes_handler() will either
+ * pflow_output_physical_flow_changes_handler() will either
  *    - recompute the physical flows by calling 'physical_run() or
  *    - incrementlly process some of the changes for physical flow
  *      calculation. Right now we handle OVS interfaces changes
@@ -1814,17 +2346,12 @@ en_mff_ovn_geneve_run(struct engine_node *node, void *data)
  * by calling physical_run() or handling the changes incrementally.
  *
  * Hence this is an intermediate engine node to indicate the
- * flow_output engine to recomputes/compute the physical flows.
+ * pflow_output engine to recomputes/compute the physical flows.
  *
- * TODO 1. Ideally this engine node should recompute/compute the physical
- *         flows instead of relegating it to the flow_output node.
- *         But this requires splitting the flow_output node to
- *         logical_flow_output and physical_flow_output.
- *
- * TODO 2. We can further optimise the en_ct_zone changes to
+ * TODO 1. We can further optimise the en_ct_zone changes to
  *         compute the phsyical flows for changed zone ids.
  *
- * TODO 3: physical.c has a global simap -localvif_to_ofport which stores the
+ * TODO 2: physical.c has a global simap -localvif_to_ofport which stores the
  *         local OVS interfaces and the ofport numbers. Ideally this should be
  *         part of the engine data.
  */
@@ -1855,7 +2382,7 @@ en_physical_flow_changes_cleanup(void *data OVS_UNUSED)
 {
 }
 
-/* Indicate to the flow_output engine that we need to recompute physical
+/* Indicate to the pflow_output engine that we need to recompute physical
  * flows. */
 static void
 en_physical_flow_changes_run(struct engine_node *node, void *data)
@@ -1876,7 +2403,7 @@ physical_flow_changes_ct_zones_handler(struct engine_node *node OVS_UNUSED,
     return false;
 }
 
-/* There are OVS interface changes. Indicate to the flow_output engine
+/* There are OVS interface changes. Indicate to the pflow_output engine
  * to handle these OVS interface changes for physical flow computations. */
 static bool
 physical_flow_changes_ovs_iface_handler(struct engine_node *node, void *data)
@@ -1887,13 +2414,26 @@ physical_flow_changes_ovs_iface_handler(struct engine_node *node, void *data)
     return true;
 }
 
-struct flow_output_persistent_data {
-    uint32_t conj_id_ofs;
+struct lflow_output_persistent_data {
+    struct lflow_conj_ids conj_ids;
     struct lflow_cache *lflow_cache;
 };
 
-struct ed_type_flow_output {
-    /* desired flows */
+/* The desired flows are split between two engine nodes, so that a change
+ * that only affects the physical flows, e.g. an OVS interface or a ct zone
+ * change, never recomputes the logical flows, and vice versa:
+ *
+ *   - en_lflow_output translates the logical flows, including the
+ *     neighbor, FDB and load balancer hairpin flows, which are generated
+ *     by lflow.c as well.
+ *
+ *   - en_pflow_output computes the physical flows (physical.c).
+ *
+ * Each of them owns its own desired flow table and ofctrl_put() installs
+ * both.  en_flow_output has the two of them as inputs and only indicates
+ * to the main loop whether any desired flow changed. */
+struct ed_type_lflow_output {
+    /* desired logical flows */
     struct ovn_desired_flow_table flow_table;
     /* group ids for load balancing */
     struct ovn_extend_table group_table;
@@ -1904,11 +2444,20 @@ struct ed_type_flow_output {
 
     /* Data which is persistent and not cleared during
      * full recompute. */
-    struct flow_output_persistent_data pd;
+    struct lflow_output_persistent_data pd;
+};
+
+struct ed_type_pflow_output {
+    /* desired physical flows */
+    struct ovn_desired_flow_table flow_table;
+    /* groups of the physical flows, with ids above those of the logical
+     * flows */
+    struct ovn_extend_table group_table;
 };
 
 static void init_physical_ctx(struct engine_node *node,
                               struct ed_type_runtime_data *rt_data,
+                              struct ed_type_pflow_output *fo,
                               struct physical_ctx *p_ctx)
 {
     struct ovsdb_idl_index *sbrec_port_binding_by_name =
@@ -1916,6 +2465,16 @@ static void init_physical_ctx(struct engine_node *node,
                 engine_get_input("SB_port_binding", node),
                 "name");
 
+    struct ovsdb_idl_index *sbrec_port_binding_by_datapath =
+        engine_ovsdb_node_get_index(
+                engine_get_input("SB_port_binding", node),
+                "datapath");
+
+    struct ovsdb_idl_index *sbrec_port_binding_by_type =
+        engine_ovsdb_node_get_index(
+                engine_get_input("SB_port_binding", node),
+                "type");
+
     struct sbrec_multicast_group_table *multicast_group_table =
         (struct sbrec_multicast_group_table *)EN_OVSDB_GET(
             engine_get_input("SB_multicast_group", node));
@@ -1928,6 +2487,10 @@ static void init_physical_ctx(struct engine_node *node,
         (struct sbrec_chassis_table *)EN_OVSDB_GET(
             engine_get_input("SB_chassis", node));
 
+    struct sbrec_encap_table *encap_table =
+        (struct sbrec_encap_table *)EN_OVSDB_GET(
+            engine_get_input("SB_encap", node));
+
     struct ed_type_mff_ovn_geneve *ed_mff_ovn_geneve =
         engine_get_input_data("mff_ovn_geneve", node);
 
@@ -1950,6 +2513,12 @@ static void init_physical_ctx(struct engine_node *node,
 
     ovs_assert(br_int && chassis);
 
+    const struct ovsrec_open_vswitch *cfg =
+        ovsrec_open_vswitch_table_first(ovs_table);
+    bool mc_flood_groups = cfg && smap_get_bool(&cfg->external_ids,
+                                                "ovn-mc-flood-groups",
+                                                false);
+
     struct ovsrec_interface_table *iface_table =
         (struct ovsrec_interface_table *)EN_OVSDB_GET(
             engine_get_input("OVS_interface", node));
@@ -1959,10 +2528,13 @@ static void init_physical_ctx(struct engine_node *node,
     struct simap *ct_zones = &ct_zones_data->current;
 
     p_ctx->sbrec_port_binding_by_name = sbrec_port_binding_by_name;
+    p_ctx->sbrec_port_binding_by_datapath = sbrec_port_binding_by_datapath;
+    p_ctx->sbrec_port_binding_by_type = sbrec_port_binding_by_type;
     p_ctx->port_binding_table = port_binding_table;
     p_ctx->mc_group_table = multicast_group_table;
     p_ctx->br_int = br_int;
     p_ctx->chassis_table = chassis_table;
+    p_ctx->encap_table = encap_table;
     p_ctx->iface_table = iface_table;
     p_ctx->chassis = chassis;
     p_ctx->active_tunnels = &rt_data->active_tunnels;
@@ -1972,11 +2544,13 @@ static void init_physical_ctx(struct engine_node *node,
     p_ctx->mff_ovn_geneve = ed_mff_ovn_geneve->mff_ovn_geneve;
     p_ctx->local_bindings = &rt_data->lbinding_data.bindings;
     p_ctx->ct_updated_datapaths = &rt_data->ct_updated_datapaths;
+    p_ctx->group_table = &fo->group_table;
+    p_ctx->mc_flood_groups = mc_flood_groups;
 }
 
 static void init_lflow_ctx(struct engine_node *node,
                            struct ed_type_runtime_data *rt_data,
-                           struct ed_type_flow_output *fo,
+                           struct ed_type_lflow_output *fo,
                            struct lflow_ctx_in *l_ctx_in,
                            struct lflow_ctx_out *l_ctx_out)
 {
@@ -2008,9 +2582,10 @@ static void init_lflow_ctx(struct engine_node *node,
         (struct sbrec_dhcpv6_options_table *)EN_OVSDB_GET(
             engine_get_input("SB_dhcpv6_options", node));
 
-    struct sbrec_mac_binding_table *mac_binding_table =
-        (struct sbrec_mac_binding_table *)EN_OVSDB_GET(
-            engine_get_input("SB_mac_binding", node));
+    struct ovsdb_idl_index *sbrec_mac_binding_by_dp =
+        engine_ovsdb_node_get_index(
+                engine_get_input("SB_mac_binding", node),
+                "datapath");
 
     struct sbrec_logical_flow_table *logical_flow_table =
         (struct sbrec_logical_flow_table *)EN_OVSDB_GET(
@@ -2032,6 +2607,11 @@ static void init_lflow_ctx(struct engine_node *node,
         (struct sbrec_fdb_table *)EN_OVSDB_GET(
             engine_get_input("SB_fdb", node));
 
+    struct ovsdb_idl_index *sbrec_fdb_by_dp_key =
+        engine_ovsdb_node_get_index(
+                engine_get_input("SB_fdb", node),
+                "dp_key");
+
     struct ovsrec_open_vswitch_table *ovs_table =
         (struct ovsrec_open_vswitch_table *)EN_OVSDB_GET(
             engine_get_input("OVS_open_vswitch", node));
@@ -2063,9 +2643,10 @@ static void init_lflow_ctx(struct engine_node *node,
     l_ctx_in->sbrec_logical_flow_by_logical_dp_group =
         sbrec_logical_flow_by_dp_group;
     l_ctx_in->sbrec_port_binding_by_name = sbrec_port_binding_by_name;
+    l_ctx_in->sbrec_mac_binding_by_datapath = sbrec_mac_binding_by_dp;
+    l_ctx_in->sbrec_fdb_by_dp_key = sbrec_fdb_by_dp_key;
     l_ctx_in->dhcp_options_table  = dhcp_table;
     l_ctx_in->dhcpv6_options_table = dhcpv6_table;
-    l_ctx_in->mac_binding_table = mac_binding_table;
     l_ctx_in->logical_flow_table = logical_flow_table;
     l_ctx_in->logical_dp_group_table = logical_dp_group_table;
     l_ctx_in->mc_group_table = multicast_group_table;
@@ -2082,38 +2663,39 @@ static void init_lflow_ctx(struct engine_node *node,
     l_ctx_out->group_table = &fo->group_table;
     l_ctx_out->meter_table = &fo->meter_table;
     l_ctx_out->lfrr = &fo->lflow_resource_ref;
-    l_ctx_out->conj_id_ofs = &fo->pd.conj_id_ofs;
+    l_ctx_out->conj_ids = &fo->pd.conj_ids;
     l_ctx_out->lflow_cache = fo->pd.lflow_cache;
     l_ctx_out->conj_id_overflow = false;
 }
 
 static void *
-en_flow_output_init(struct engine_node *node OVS_UNUSED,
-                    struct engine_arg *arg OVS_UNUSED)
+en_lflow_output_init(struct engine_node *node OVS_UNUSED,
+                     struct engine_arg *arg OVS_UNUSED)
 {
-    struct ed_type_flow_output *data = xzalloc(sizeof *data);
+    struct ed_type_lflow_output *data = xzalloc(sizeof *data);
 
     ovn_desired_flow_table_init(&data->flow_table);
     ovn_extend_table_init(&data->group_table);
     ovn_extend_table_init(&data->meter_table);
-    data->pd.conj_id_ofs = 1;
+    lflow_conj_ids_init(&data->pd.conj_ids);
     lflow_resource_init(&data->lflow_resource_ref);
     return data;
 }
 
 static void
-en_flow_output_cleanup(void *data)
+en_lflow_output_cleanup(void *data)
 {
-    struct ed_type_flow_output *flow_output_data = data;
-    ovn_desired_flow_table_destroy(&flow_output_data->flow_table);
-    ovn_extend_table_destroy(&flow_output_data->group_table);
-    ovn_extend_table_destroy(&flow_output_data->meter_table);
-    lflow_resource_destroy(&flow_output_data->lflow_resource_ref);
-    lflow_cache_destroy(flow_output_data->pd.lflow_cache);
+    struct ed_type_lflow_output *lflow_output_data = data;
+    ovn_desired_flow_table_destroy(&lflow_output_data->flow_table);
+    ovn_extend_table_destroy(&lflow_output_data->group_table);
+    ovn_extend_table_destroy(&lflow_output_data->meter_table);
+    lflow_resource_destroy(&lflow_output_data->lflow_resource_ref);
+    lflow_conj_ids_destroy(&lflow_output_data->pd.conj_ids);
+    lflow_cache_destroy(lflow_output_data->pd.lflow_cache);
 }
 
 static void
-en_flow_output_run(struct engine_node *node, void *data)
+en_lflow_output_run(struct engine_node *node, void *data)
 {
     struct ed_type_runtime_data *rt_data =
         engine_get_input_data("runtime_data", node);
@@ -2139,7 +2721,7 @@ en_flow_output_run(struct engine_node *node, void *data)
 
     ovs_assert(br_int && chassis);
 
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_lflow_output *fo = data;
     struct ovn_desired_flow_table *flow_table = &fo->flow_table;
     struct ovn_extend_table *group_table = &fo->group_table;
     struct ovn_extend_table *meter_table = &fo->meter_table;
@@ -2159,13 +2741,27 @@ en_flow_output_run(struct engine_node *node, void *data)
 
     fo->pd.lflow_cache = ctrl_ctx->lflow_cache;
 
-    if (!lflow_cache_is_enabled(fo->pd.lflow_cache)) {
-        fo->pd.conj_id_ofs = 1;
-    }
-
     struct lflow_ctx_in l_ctx_in;
     struct lflow_ctx_out l_ctx_out;
     init_lflow_ctx(node, rt_data, fo, &l_ctx_in, &l_ctx_out);
+
+    /* Warm up the lflow cache from the snapshot saved by the previous run,
+     * once the logical flows are there to validate it against. */
+    if (!ctrl_ctx->lflow_cache_loaded && ctrl_ctx->lflow_cache_file
+        && sbrec_logical_flow_table_first(l_ctx_in.logical_flow_table)) {
+        struct lflow_cache_fingerprint_aux fp_aux = {
+            .logical_flow_table = l_ctx_in.logical_flow_table,
+            .sbrec_port_binding_by_name = l_ctx_in.sbrec_port_binding_by_name,
+            .sbrec_multicast_group_by_name_datapath
+                = l_ctx_in.sbrec_multicast_group_by_name_datapath,
+        };
+
+        ctrl_ctx->lflow_cache_loaded = true;
+        lflow_cache_load(fo->pd.lflow_cache, ctrl_ctx->lflow_cache_file,
+                         lflow_cache_fingerprint, &fp_aux);
+        lflow_reserve_cached_conj_ids(fo->pd.lflow_cache, &fo->pd.conj_ids,
+                                      l_ctx_in.logical_flow_table);
+    }
     lflow_run(&l_ctx_in, &l_ctx_out);
 
     if (l_ctx_out.conj_id_overflow) {
@@ -2175,7 +2771,7 @@ en_flow_output_run(struct engine_node *node, void *data)
         ovn_extend_table_clear(group_table, false /* desired */);
         ovn_extend_table_clear(meter_table, false /* desired */);
         lflow_resource_clear(lfrr);
-        fo->pd.conj_id_ofs = 1;
+        lflow_conj_ids_clear(&fo->pd.conj_ids);
         lflow_cache_flush(fo->pd.lflow_cache);
         l_ctx_out.conj_id_overflow = false;
         lflow_run(&l_ctx_in, &l_ctx_out);
@@ -2184,16 +2780,11 @@ en_flow_output_run(struct engine_node *node, void *data)
         }
     }
 
-    struct physical_ctx p_ctx;
-    init_physical_ctx(node, rt_data, &p_ctx);
-
-    physical_run(&p_ctx, &fo->flow_table);
-
     engine_set_node_state(node, EN_UPDATED);
 }
 
 static bool
-flow_output_sb_logical_flow_handler(struct engine_node *node, void *data)
+lflow_output_sb_logical_flow_handler(struct engine_node *node, void *data)
 {
     struct ed_type_runtime_data *rt_data =
         engine_get_input_data("runtime_data", node);
@@ -2206,7 +2797,7 @@ flow_output_sb_logical_flow_handler(struct engine_node *node, void *data)
     const struct ovsrec_bridge *br_int = get_br_int(bridge_table, ovs_table);
     ovs_assert(br_int);
 
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_lflow_output *fo = data;
     struct lflow_ctx_in l_ctx_in;
     struct lflow_ctx_out l_ctx_out;
     init_lflow_ctx(node, rt_data, fo, &l_ctx_in, &l_ctx_out);
@@ -2218,7 +2809,7 @@ flow_output_sb_logical_flow_handler(struct engine_node *node, void *data)
 }
 
 static bool
-flow_output_sb_mac_binding_handler(struct engine_node *node, void *data)
+lflow_output_sb_mac_binding_handler(struct engine_node *node, void *data)
 {
     struct ovsdb_idl_index *sbrec_port_binding_by_name =
         engine_ovsdb_node_get_index(
@@ -2233,7 +2824,7 @@ flow_output_sb_mac_binding_handler(struct engine_node *node, void *data)
         engine_get_input_data("runtime_data", node);
     const struct hmap *local_datapaths = &rt_data->local_datapaths;
 
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_lflow_output *fo = data;
     struct ovn_desired_flow_table *flow_table = &fo->flow_table;
 
     lflow_handle_changed_neighbors(sbrec_port_binding_by_name,
@@ -2244,20 +2835,20 @@ flow_output_sb_mac_binding_handler(struct engine_node *node, void *data)
 }
 
 static bool
-flow_output_sb_port_binding_handler(struct engine_node *node,
-                                    void *data)
+pflow_output_sb_port_binding_handler(struct engine_node *node,
+                                     void *data)
 {
     struct ed_type_runtime_data *rt_data =
         engine_get_input_data("runtime_data", node);
 
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_pflow_output *fo = data;
     struct ovn_desired_flow_table *flow_table = &fo->flow_table;
 
     struct physical_ctx p_ctx;
-    init_physical_ctx(node, rt_data, &p_ctx);
+    init_physical_ctx(node, rt_data, fo, &p_ctx);
 
     /* We handle port-binding changes for physical flow processing
-     * only. flow_output runtime data handler takes care of processing
+     * only. lflow_output runtime data handler takes care of processing
      * logical flows for any port binding changes.
      */
     physical_handle_port_binding_changes(&p_ctx, flow_table);
@@ -2267,16 +2858,16 @@ flow_output_sb_port_binding_handler(struct engine_node *node,
 }
 
 static bool
-flow_output_sb_multicast_group_handler(struct engine_node *node, void *data)
+pflow_output_sb_multicast_group_handler(struct engine_node *node, void *data)
 {
     struct ed_type_runtime_data *rt_data =
         engine_get_input_data("runtime_data", node);
 
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_pflow_output *fo = data;
     struct ovn_desired_flow_table *flow_table = &fo->flow_table;
 
     struct physical_ctx p_ctx;
-    init_physical_ctx(node, rt_data, &p_ctx);
+    init_physical_ctx(node, rt_data, fo, &p_ctx);
 
     physical_handle_mc_group_changes(&p_ctx, flow_table);
 
@@ -2286,8 +2877,48 @@ flow_output_sb_multicast_group_handler(struct engine_node *node, void *data)
 }
 
 static bool
-_flow_output_resource_ref_handler(struct engine_node *node, void *data,
-                                  enum ref_type ref_type)
+pflow_output_sb_chassis_handler(struct engine_node *node, void *data)
+{
+    struct ed_type_runtime_data *rt_data =
+        engine_get_input_data("runtime_data", node);
+
+    struct ed_type_pflow_output *fo = data;
+    struct ovn_desired_flow_table *flow_table = &fo->flow_table;
+
+    struct physical_ctx p_ctx;
+    init_physical_ctx(node, rt_data, fo, &p_ctx);
+
+    if (!physical_handle_sb_chassis_changes(&p_ctx, flow_table)) {
+        return false;
+    }
+
+    engine_set_node_state(node, EN_UPDATED);
+    return true;
+}
+
+static bool
+pflow_output_sb_encap_handler(struct engine_node *node, void *data)
+{
+    struct ed_type_runtime_data *rt_data =
+        engine_get_input_data("runtime_data", node);
+
+    struct ed_type_pflow_output *fo = data;
+    struct ovn_desired_flow_table *flow_table = &fo->flow_table;
+
+    struct physical_ctx p_ctx;
+    init_physical_ctx(node, rt_data, fo, &p_ctx);
+
+    if (!physical_handle_sb_encap_changes(&p_ctx, flow_table)) {
+        return false;
+    }
+
+    engine_set_node_state(node, EN_UPDATED);
+    return true;
+}
+
+static bool
+_lflow_output_resource_ref_handler(struct engine_node *node, void *data,
+                                   enum ref_type ref_type)
 {
     struct ed_type_runtime_data *rt_data =
         engine_get_input_data("runtime_data", node);
@@ -2318,7 +2949,7 @@ _flow_output_resource_ref_handler(struct engine_node *node, void *data,
 
     ovs_assert(br_int && chassis);
 
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_lflow_output *fo = data;
 
     struct lflow_ctx_in l_ctx_in;
     struct lflow_ctx_out l_ctx_out;
@@ -2327,6 +2958,7 @@ _flow_output_resource_ref_handler(struct engine_node *node, void *data,
     bool changed;
     const char *ref_name;
     struct sset *new, *updated, *deleted;
+    struct shash *diffs;
 
     switch (ref_type) {
         case REF_TYPE_ADDRSET:
@@ -2338,6 +2970,7 @@ _flow_output_resource_ref_handler(struct engine_node *node, void *data,
             new = &as_data->new;
             updated = &as_data->updated;
             deleted = &as_data->deleted;
+            diffs = &as_data->diffs;
             break;
         case REF_TYPE_PORTGROUP:
             if (!pg_data->change_tracked) {
@@ -2346,9 +2979,11 @@ _flow_output_resource_ref_handler(struct engine_node *node, void *data,
             new = &pg_data->new;
             updated = &pg_data->updated;
             deleted = &pg_data->deleted;
+            diffs = &pg_data->diffs;
             break;
 
-        /* This ref type is handled in the flow_output_runtime_data_handler. */
+        /* This ref type is handled in the
+         * lflow_output_runtime_data_handler. */
         case REF_TYPE_PORTBINDING:
         default:
             OVS_NOT_REACHED();
@@ -2365,8 +3000,12 @@ _flow_output_resource_ref_handler(struct engine_node *node, void *data,
         }
     }
     SSET_FOR_EACH (ref_name, updated) {
-        if (!lflow_handle_changed_ref(ref_type, ref_name, &l_ctx_in,
-                                      &l_ctx_out, &changed)) {
+        const struct const_set_diff *diff = shash_find_data(diffs, ref_name);
+        if (diff
+            ? !lflow_handle_const_set_update(ref_type, ref_name, diff,
+                                             &l_ctx_in, &l_ctx_out, &changed)
+            : !lflow_handle_changed_ref(ref_type, ref_name, &l_ctx_in,
+                                        &l_ctx_out, &changed)) {
             return false;
         }
         if (changed) {
@@ -2387,26 +3026,27 @@ _flow_output_resource_ref_handler(struct engine_node *node, void *data,
 }
 
 static bool
-flow_output_addr_sets_handler(struct engine_node *node, void *data)
+lflow_output_addr_sets_handler(struct engine_node *node, void *data)
 {
-    return _flow_output_resource_ref_handler(node, data, REF_TYPE_ADDRSET);
+    return _lflow_output_resource_ref_handler(node, data, REF_TYPE_ADDRSET);
 }
 
 static bool
-flow_output_port_groups_handler(struct engine_node *node, void *data)
+lflow_output_port_groups_handler(struct engine_node *node, void *data)
 {
-    return _flow_output_resource_ref_handler(node, data, REF_TYPE_PORTGROUP);
+    return _lflow_output_resource_ref_handler(node, data, REF_TYPE_PORTGROUP);
 }
 
 static bool
-flow_output_physical_flow_changes_handler(struct engine_node *node, void *data)
+pflow_output_physical_flow_changes_handler(struct engine_node *node,
+                                           void *data)
 {
     struct ed_type_runtime_data *rt_data =
         engine_get_input_data("runtime_data", node);
 
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_pflow_output *fo = data;
     struct physical_ctx p_ctx;
-    init_physical_ctx(node, rt_data, &p_ctx);
+    init_physical_ctx(node, rt_data, fo, &p_ctx);
 
     engine_set_node_state(node, EN_UPDATED);
     struct ed_type_pfc_data *pfc_data =
@@ -2432,14 +3072,14 @@ flow_output_physical_flow_changes_handler(struct engine_node *node, void *data)
 }
 
 static bool
-flow_output_runtime_data_handler(struct engine_node *node,
-                                 void *data OVS_UNUSED)
+lflow_output_runtime_data_handler(struct engine_node *node,
+                                  void *data OVS_UNUSED)
 {
     struct ed_type_runtime_data *rt_data =
         engine_get_input_data("runtime_data", node);
 
     /* There is no tracked data. Fall back to full recompute of
-     * flow_output. */
+     * lflow_output. */
     if (!rt_data->tracked) {
         return false;
     }
@@ -2454,12 +3094,9 @@ flow_output_runtime_data_handler(struct engine_node *node,
 
     struct lflow_ctx_in l_ctx_in;
     struct lflow_ctx_out l_ctx_out;
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_lflow_output *fo = data;
     init_lflow_ctx(node, rt_data, fo, &l_ctx_in, &l_ctx_out);
 
-    struct physical_ctx p_ctx;
-    init_physical_ctx(node, rt_data, &p_ctx);
-
     struct tracked_binding_datapath *tdp;
     HMAP_FOR_EACH (tdp, node, tracked_dp_bindings) {
         if (tdp->is_new) {
@@ -2484,12 +3121,12 @@ flow_output_runtime_data_handler(struct engine_node *node,
 }
 
 static bool
-flow_output_sb_load_balancer_handler(struct engine_node *node, void *data)
+lflow_output_sb_load_balancer_handler(struct engine_node *node, void *data)
 {
     struct ed_type_runtime_data *rt_data =
         engine_get_input_data("runtime_data", node);
 
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_lflow_output *fo = data;
     struct lflow_ctx_in l_ctx_in;
     struct lflow_ctx_out l_ctx_out;
     init_lflow_ctx(node, rt_data, fo, &l_ctx_in, &l_ctx_out);
@@ -2501,12 +3138,12 @@ flow_output_sb_load_balancer_handler(struct engine_node *node, void *data)
 }
 
 static bool
-flow_output_sb_fdb_handler(struct engine_node *node, void *data)
+lflow_output_sb_fdb_handler(struct engine_node *node, void *data)
 {
     struct ed_type_runtime_data *rt_data =
         engine_get_input_data("runtime_data", node);
 
-    struct ed_type_flow_output *fo = data;
+    struct ed_type_lflow_output *fo = data;
     struct lflow_ctx_in l_ctx_in;
     struct lflow_ctx_out l_ctx_out;
     init_lflow_ctx(node, rt_data, fo, &l_ctx_in, &l_ctx_out);
@@ -2517,6 +3154,107 @@ flow_output_sb_fdb_handler(struct engine_node *node, void *data)
     return handled;
 }
 
+static void *
+en_pflow_output_init(struct engine_node *node OVS_UNUSED,
+                     struct engine_arg *arg OVS_UNUSED)
+{
+    struct ed_type_pflow_output *data = xzalloc(sizeof *data);
+
+    ovn_desired_flow_table_init(&data->flow_table);
+    ovn_extend_table_init_base(&data->group_table, MAX_EXT_TABLE_ID);
+    return data;
+}
+
+static void
+en_pflow_output_cleanup(void *data)
+{
+    struct ed_type_pflow_output *pflow_output_data = data;
+    ovn_desired_flow_table_destroy(&pflow_output_data->flow_table);
+    ovn_extend_table_destroy(&pflow_output_data->group_table);
+}
+
+static void
+en_pflow_output_run(struct engine_node *node, void *data)
+{
+    struct ed_type_runtime_data *rt_data =
+        engine_get_input_data("runtime_data", node);
+
+    struct ed_type_pflow_output *fo = data;
+    struct ovn_desired_flow_table *flow_table = &fo->flow_table;
+
+    static bool first_run = true;
+    if (first_run) {
+        first_run = false;
+    } else {
+        ovn_desired_flow_table_clear(flow_table);
+        ovn_extend_table_clear(&fo->group_table, false /* desired */);
+    }
+
+    struct physical_ctx p_ctx;
+    init_physical_ctx(node, rt_data, fo, &p_ctx);
+
+    physical_run(&p_ctx, flow_table);
+
+    engine_set_node_state(node, EN_UPDATED);
+}
+
+static bool
+pflow_output_runtime_data_handler(struct engine_node *node,
+                                  void *data OVS_UNUSED)
+{
+    struct ed_type_runtime_data *rt_data =
+        engine_get_input_data("runtime_data", node);
+
+    /* There is no tracked data. Fall back to full recompute of
+     * pflow_output. */
+    if (!rt_data->tracked) {
+        return false;
+    }
+
+    /* The tracked binding changes are handled in the
+     * lflow_output_runtime_data_handler.  Any runtime data change also
+     * recomputes the ct zones, which recomputes the physical flows through
+     * en_physical_flow_changes. */
+    return true;
+}
+
+static void *
+en_flow_output_init(struct engine_node *node OVS_UNUSED,
+                    struct engine_arg *arg OVS_UNUSED)
+{
+    return NULL;
+}
+
+static void
+en_flow_output_cleanup(void *data OVS_UNUSED)
+{
+}
+
+static void
+en_flow_output_run(struct engine_node *node, void *data OVS_UNUSED)
+{
+    engine_set_node_state(node, EN_UPDATED);
+}
+
+/* The desired flows are owned by en_lflow_output and en_pflow_output and
+ * installed by ofctrl_put(), so a change to either of them only needs to be
+ * passed on. */
+static bool
+flow_output_lflow_output_handler(struct engine_node *node,
+                                 void *data OVS_UNUSED)
+{
+    engine_set_node_state(node, EN_UPDATED);
+    return true;
+}
+
+static bool
+flow_output_pflow_output_handler(struct engine_node *node,
+                                 void *data OVS_UNUSED)
+{
+    engine_set_node_state(node, EN_UPDATED);
+    return true;
+}
+
 struct ovn_controller_exit_args {
     bool *exiting;
     bool *restart;
@@ -2646,6 +3384,9 @@ main(int argc, char *argv[])
         = ovsdb_idl_index_create2(ovnsb_idl_loop.idl,
                                   &sbrec_mac_binding_col_logical_port,
                                   &sbrec_mac_binding_col_ip);
+    struct ovsdb_idl_index *sbrec_mac_binding_by_datapath
+        = ovsdb_idl_index_create1(ovnsb_idl_loop.idl,
+                                  &sbrec_mac_binding_col_datapath);
     struct ovsdb_idl_index *sbrec_ip_multicast
         = ip_mcast_index_create(ovnsb_idl_loop.idl);
     struct ovsdb_idl_index *sbrec_igmp_group
@@ -2654,6 +3395,9 @@ main(int argc, char *argv[])
         = ovsdb_idl_index_create2(ovnsb_idl_loop.idl,
                                   &sbrec_fdb_col_mac,
                                   &sbrec_fdb_col_dp_key);
+    struct ovsdb_idl_index *sbrec_fdb_by_dp_key
+        = ovsdb_idl_index_create1(ovnsb_idl_loop.idl,
+                                  &sbrec_fdb_col_dp_key);
 
     ovsdb_idl_track_add_all(ovnsb_idl_loop.idl);
     ovsdb_idl_omit_alert(ovnsb_idl_loop.idl,
@@ -2696,9 +3440,11 @@ main(int argc, char *argv[])
      * other_config column so we no longer need to monitor it */
     ovsdb_idl_omit_alert(ovnsb_idl_loop.idl, &sbrec_chassis_col_external_ids);
 
-    /* Do not monitor Chassis_Private external_ids */
-    ovsdb_idl_omit(ovnsb_idl_loop.idl,
-                   &sbrec_chassis_private_col_external_ids);
+    /* Omit alerts to the Chassis_Private external_ids column.  It is only
+     * monitored so that store_ofctrl_stats() can update some of its keys
+     * and compare them with their stored values. */
+    ovsdb_idl_omit_alert(ovnsb_idl_loop.idl,
+                         &sbrec_chassis_private_col_external_ids);
 
     update_sb_monitors(ovnsb_idl_loop.idl, NULL, NULL, NULL, false);
 
@@ -2711,6 +3457,8 @@ main(int argc, char *argv[])
     ENGINE_NODE(ofctrl_is_connected, "ofctrl_is_connected");
     ENGINE_NODE_WITH_CLEAR_TRACK_DATA(physical_flow_changes,
                                       "physical_flow_changes");
+    ENGINE_NODE(lflow_output, "lflow_output");
+    ENGINE_NODE(pflow_output, "pflow_output");
     ENGINE_NODE(flow_output, "flow_output");
     ENGINE_NODE(addr_sets, "addr_sets");
     ENGINE_NODE_WITH_CLEAR_TRACK_DATA(port_groups, "port_groups");
@@ -2723,9 +3471,6 @@ main(int argc, char *argv[])
     OVS_NODES
 #undef OVS_NODE
 
-    // Init the ovn-controller DDlog instance
-    init_ddlog();
-
     /* Add dependencies between inc-proc-engine nodes. */
 
     engine_add_input(&en_addr_sets, &en_sb_address_set,
@@ -2749,46 +3494,70 @@ main(int argc, char *argv[])
     engine_add_input(&en_physical_flow_changes, &en_ct_zones,
                      physical_flow_changes_ct_zones_handler);
 
-    engine_add_input(&en_flow_output, &en_addr_sets,
-                     flow_output_addr_sets_handler);
-    engine_add_input(&en_flow_output, &en_port_groups,
-                     flow_output_port_groups_handler);
-    engine_add_input(&en_flow_output, &en_runtime_data,
-                     flow_output_runtime_data_handler);
-    engine_add_input(&en_flow_output, &en_mff_ovn_geneve, NULL);
-    engine_add_input(&en_flow_output, &en_physical_flow_changes,
-                     flow_output_physical_flow_changes_handler);
-
-    /* We need this input nodes for only data. Hence the noop handler. */
-    engine_add_input(&en_flow_output, &en_ct_zones, engine_noop_handler);
-    engine_add_input(&en_flow_output, &en_ovs_interface, engine_noop_handler);
-
-    engine_add_input(&en_flow_output, &en_ovs_open_vswitch, NULL);
-    engine_add_input(&en_flow_output, &en_ovs_bridge, NULL);
-
-    engine_add_input(&en_flow_output, &en_sb_chassis, NULL);
-    engine_add_input(&en_flow_output, &en_sb_encap, NULL);
-    engine_add_input(&en_flow_output, &en_sb_multicast_group,
-                     flow_output_sb_multicast_group_handler);
-    engine_add_input(&en_flow_output, &en_sb_port_binding,
-                     flow_output_sb_port_binding_handler);
-    engine_add_input(&en_flow_output, &en_sb_mac_binding,
-                     flow_output_sb_mac_binding_handler);
-    engine_add_input(&en_flow_output, &en_sb_logical_flow,
-                     flow_output_sb_logical_flow_handler);
+    engine_add_input(&en_lflow_output, &en_addr_sets,
+                     lflow_output_addr_sets_handler);
+    engine_add_input(&en_lflow_output, &en_port_groups,
+                     lflow_output_port_groups_handler);
+    engine_add_input(&en_lflow_output, &en_runtime_data,
+                     lflow_output_runtime_data_handler);
+
+    engine_add_input(&en_lflow_output, &en_ovs_open_vswitch, NULL);
+    engine_add_input(&en_lflow_output, &en_ovs_bridge, NULL);
+
+    engine_add_input(&en_lflow_output, &en_sb_chassis, NULL);
+    /* Multicast group and port binding changes are handled by
+     * pflow_output, the logical flows only need the indexes.  The logical
+     * flows of the port bindings that get bound or unbound are handled by
+     * the lflow_output_runtime_data_handler. */
+    engine_add_input(&en_lflow_output, &en_sb_multicast_group,
+                     engine_noop_handler);
+    engine_add_input(&en_lflow_output, &en_sb_port_binding,
+                     engine_noop_handler);
+    engine_add_input(&en_lflow_output, &en_sb_mac_binding,
+                     lflow_output_sb_mac_binding_handler);
+    engine_add_input(&en_lflow_output, &en_sb_logical_flow,
+                     lflow_output_sb_logical_flow_handler);
     /* Using a noop handler since we don't really need any data from datapath
      * groups or a full recompute.  Update of a datapath group will put
      * logical flow into the tracked list, so the logical flow handler will
      * process all changes. */
-    engine_add_input(&en_flow_output, &en_sb_logical_dp_group,
+    engine_add_input(&en_lflow_output, &en_sb_logical_dp_group,
                      engine_noop_handler);
-    engine_add_input(&en_flow_output, &en_sb_dhcp_options, NULL);
-    engine_add_input(&en_flow_output, &en_sb_dhcpv6_options, NULL);
-    engine_add_input(&en_flow_output, &en_sb_dns, NULL);
-    engine_add_input(&en_flow_output, &en_sb_load_balancer,
-                     flow_output_sb_load_balancer_handler);
-    engine_add_input(&en_flow_output, &en_sb_fdb,
-                     flow_output_sb_fdb_handler);
+    engine_add_input(&en_lflow_output, &en_sb_dhcp_options, NULL);
+    engine_add_input(&en_lflow_output, &en_sb_dhcpv6_options, NULL);
+    engine_add_input(&en_lflow_output, &en_sb_dns, NULL);
+    engine_add_input(&en_lflow_output, &en_sb_load_balancer,
+                     lflow_output_sb_load_balancer_handler);
+    engine_add_input(&en_lflow_output, &en_sb_fdb,
+                     lflow_output_sb_fdb_handler);
+
+    engine_add_input(&en_pflow_output, &en_runtime_data,
+                     pflow_output_runtime_data_handler);
+    engine_add_input(&en_pflow_output, &en_mff_ovn_geneve, NULL);
+    engine_add_input(&en_pflow_output, &en_physical_flow_changes,
+                     pflow_output_physical_flow_changes_handler);
+
+    /* We need this input nodes for only data. Hence the noop handler. */
+    engine_add_input(&en_pflow_output, &en_ct_zones, engine_noop_handler);
+    engine_add_input(&en_pflow_output, &en_ovs_interface,
+                     engine_noop_handler);
+
+    engine_add_input(&en_pflow_output, &en_ovs_open_vswitch, NULL);
+    engine_add_input(&en_pflow_output, &en_ovs_bridge, NULL);
+
+    engine_add_input(&en_pflow_output, &en_sb_chassis,
+                     pflow_output_sb_chassis_handler);
+    engine_add_input(&en_pflow_output, &en_sb_encap,
+                     pflow_output_sb_encap_handler);
+    engine_add_input(&en_pflow_output, &en_sb_multicast_group,
+                     pflow_output_sb_multicast_group_handler);
+    engine_add_input(&en_pflow_output, &en_sb_port_binding,
+                     pflow_output_sb_port_binding_handler);
+
+    engine_add_input(&en_flow_output, &en_lflow_output,
+                     flow_output_lflow_output_handler);
+    engine_add_input(&en_flow_output, &en_pflow_output,
+                     flow_output_pflow_output_handler);
 
     engine_add_input(&en_ct_zones, &en_ovs_open_vswitch, NULL);
     engine_add_input(&en_ct_zones, &en_ovs_bridge, NULL);
@@ -2801,7 +3570,8 @@ main(int argc, char *argv[])
     engine_add_input(&en_runtime_data, &en_ovs_bridge, NULL);
     engine_add_input(&en_runtime_data, &en_ovs_qos, NULL);
 
-    engine_add_input(&en_runtime_data, &en_sb_chassis, NULL);
+    engine_add_input(&en_runtime_data, &en_sb_chassis,
+                     runtime_data_sb_chassis_handler);
     engine_add_input(&en_runtime_data, &en_sb_datapath_binding,
                      runtime_data_sb_datapath_binding_handler);
     engine_add_input(&en_runtime_data, &en_sb_port_binding,
@@ -2835,28 +3605,40 @@ main(int argc, char *argv[])
                                 sbrec_port_binding_by_key);
     engine_ovsdb_node_add_index(&en_sb_port_binding, "datapath",
                                 sbrec_port_binding_by_datapath);
+    engine_ovsdb_node_add_index(&en_sb_port_binding, "type",
+                                sbrec_port_binding_by_type);
+    engine_ovsdb_node_add_index(&en_sb_mac_binding, "datapath",
+                                sbrec_mac_binding_by_datapath);
+    engine_ovsdb_node_add_index(&en_sb_fdb, "dp_key", sbrec_fdb_by_dp_key);
     engine_ovsdb_node_add_index(&en_sb_datapath_binding, "key",
                                 sbrec_datapath_binding_by_key);
 
-    struct ed_type_flow_output *flow_output_data =
-        engine_get_internal_data(&en_flow_output);
+    struct ed_type_lflow_output *lflow_output_data =
+        engine_get_internal_data(&en_lflow_output);
+    struct ed_type_pflow_output *pflow_output_data =
+        engine_get_internal_data(&en_pflow_output);
     struct ed_type_ct_zones *ct_zones_data =
         engine_get_internal_data(&en_ct_zones);
     struct ed_type_runtime_data *runtime_data =
         engine_get_internal_data(&en_runtime_data);
 
-    ofctrl_init(&flow_output_data->group_table,
-                &flow_output_data->meter_table,
+    ofctrl_init(&lflow_output_data->group_table,
+                &pflow_output_data->group_table,
+                &lflow_output_data->meter_table,
                 get_ofctrl_probe_interval(ovs_idl_loop.idl));
     ofctrl_seqno_init();
 
     unixctl_command_register("group-table-list", "", 0, 0,
                              extend_table_list,
-                             &flow_output_data->group_table);
+                             &lflow_output_data->group_table);
+
+    unixctl_command_register("pflow-group-table-list", "", 0, 0,
+                             extend_table_list,
+                             &pflow_output_data->group_table);
 
     unixctl_command_register("meter-table-list", "", 0, 0,
                              extend_table_list,
-                             &flow_output_data->meter_table);
+                             &lflow_output_data->meter_table);
 
     unixctl_command_register("ct-zone-list", "", 0, 0,
                              ct_zone_list,
@@ -2870,14 +3652,24 @@ main(int argc, char *argv[])
                              NULL);
     unixctl_command_register("lflow-cache/flush", "", 0, 0,
                              lflow_cache_flush_cmd,
-                             &flow_output_data->pd);
+                             &lflow_output_data->pd);
     /* Keep deprecated 'flush-lflow-cache' command for now. */
     unixctl_command_register("flush-lflow-cache", "[deprecated]", 0, 0,
                              lflow_cache_flush_cmd,
-                             &flow_output_data->pd);
+                             &lflow_output_data->pd);
     unixctl_command_register("lflow-cache/show-stats", "", 0, 0,
                              lflow_cache_show_stats_cmd,
-                             &flow_output_data->pd);
+                             &lflow_output_data->pd);
+    unixctl_command_register("sb-monitor/show-stats", "", 0, 0,
+                             sb_monitor_show_stats_cmd, ovnsb_idl_loop.idl);
+    unixctl_command_register("pinctrl/show-buffered-packets", "", 0, 0,
+                             pinctrl_show_buffered_packets_cmd, NULL);
+    unixctl_command_register("pinctrl/show-packet-in-stats", "", 0, 0,
+                             pinctrl_show_packet_in_stats_cmd, NULL);
+    unixctl_command_register("pinctrl/show-ip-mcast-stats", "", 0, 0,
+                             pinctrl_show_ip_mcast_stats_cmd, NULL);
+    unixctl_command_register("ofctrl/show-stats", "", 0, 0,
+                             ofctrl_show_stats_cmd, NULL);
 
     bool reset_ovnsb_idl_min_index = false;
     unixctl_command_register("sb-cluster-state-reset", "", 0, 0,
@@ -2900,6 +3692,11 @@ main(int argc, char *argv[])
                              debug_dump_local_bindings,
                              &runtime_data->lbinding_data);
 
+    /* Chassis that host ports of the local datapaths, as of the last run of
+     * the engine, to which tunnels are created with
+     * external_ids:ovn-on-demand-tunnels. */
+    struct sset tunnel_peers = SSET_INITIALIZER(&tunnel_peers);
+
     unsigned int ovs_cond_seqno = UINT_MAX;
     unsigned int ovnsb_cond_seqno = UINT_MAX;
     unsigned int ovnsb_expected_cond_seqno = UINT_MAX;
@@ -2909,6 +3706,12 @@ main(int argc, char *argv[])
         .if_mgr = if_status_mgr_create(),
     };
     struct if_status_mgr *if_mgr = ctrl_engine_ctx.if_mgr;
+    unixctl_command_register("if-status-mgr/show-stats", "", 0, 0,
+                             if_status_mgr_show_stats_cmd, if_mgr);
+    unixctl_command_register("if-status-mgr/clear-stats", "", 0, 0,
+                             if_status_mgr_clear_stats_cmd, if_mgr);
+    unixctl_command_register("if-status-mgr/show-timeline", "", 0, 0,
+                             if_status_mgr_show_timeline_cmd, if_mgr);
 
     char *ovn_version = ovn_get_internal_version();
     VLOG_INFO("OVN internal version is : [%s]", ovn_version);
@@ -2923,6 +3726,15 @@ main(int argc, char *argv[])
             struct simap usage = SIMAP_INITIALIZER(&usage);
 
             lflow_cache_get_memory_usage(ctrl_engine_ctx.lflow_cache, &usage);
+            ofctrl_get_memory_usage(&usage);
+            lflow_resource_get_memory_usage(
+                &lflow_output_data->lflow_resource_ref, &usage);
+            local_datapaths_get_memory_usage(&runtime_data->local_datapaths,
+                                             &usage);
+            local_binding_data_get_memory_usage(&runtime_data->lbinding_data,
+                                                &usage);
+            physical_get_memory_usage(&usage);
+            pinctrl_get_memory_usage(&usage);
             memory_report(&usage);
             simap_destroy(&usage);
         }
@@ -2954,6 +3766,8 @@ main(int argc, char *argv[])
                      &ctrl_engine_ctx, &ovnsb_expected_cond_seqno);
         update_ssl_config(ovsrec_ssl_table_get(ovs_idl_loop.idl));
         ofctrl_set_probe_interval(get_ofctrl_probe_interval(ovs_idl_loop.idl));
+        ofctrl_set_reconcile_flows(
+            get_ofctrl_reconcile_flows(ovs_idl_loop.idl));
 
         struct ovsdb_idl_txn *ovnsb_idl_txn
             = ovsdb_idl_loop_run(&ovnsb_idl_loop);
@@ -2967,6 +3781,17 @@ main(int argc, char *argv[])
             ovnsb_cond_seqno = new_ovnsb_cond_seqno;
         }
 
+        /* The cached HA chassis group results depend on the membership and
+         * the priorities of the groups and on the chassis names. */
+        if (sbrec_ha_chassis_group_table_track_get_first(
+                sbrec_ha_chassis_group_table_get(ovnsb_idl_loop.idl))
+            || sbrec_ha_chassis_table_track_get_first(
+                sbrec_ha_chassis_table_get(ovnsb_idl_loop.idl))
+            || sbrec_chassis_table_track_get_first(
+                sbrec_chassis_table_get(ovnsb_idl_loop.idl))) {
+            ha_chassis_cache_flush();
+        }
+
         struct engine_context eng_ctx = {
             .ovs_idl_txn = ovs_idl_txn,
             .ovnsb_idl_txn = ovnsb_idl_txn,
@@ -2985,6 +3810,9 @@ main(int argc, char *argv[])
             ovsrec_open_vswitch_table_get(ovs_idl_loop.idl);
         const struct ovsrec_bridge *br_int =
             process_br_int(ovs_idl_txn, bridge_table, ovs_table);
+        bool encaps_ran = false;
+        bool ddlog_ran = false;
+        bool patch_ran = false;
 
         if (ovsdb_idl_has_ever_connected(ovnsb_idl_loop.idl) &&
             northd_version_match) {
@@ -3003,6 +3831,7 @@ main(int argc, char *argv[])
             sset_from_delimited_string(&transport_zones,
                 get_transport_zones(ovsrec_open_vswitch_table_get(
                                     ovs_idl_loop.idl)), ",");
+            bool on_demand_tunnels = get_on_demand_tunnels(ovs_table);
 
             const char *chassis_id = get_ovs_chassis_id(ovs_table);
             const struct sbrec_chassis *chassis = NULL;
@@ -3024,10 +3853,16 @@ main(int argc, char *argv[])
                 if (chassis) {
                     encaps_run(ovs_idl_txn,
                                bridge_table, br_int,
+                               ovsrec_port_table_get(ovs_idl_loop.idl),
+                               ovsrec_interface_table_get(ovs_idl_loop.idl),
+                               sbrec_chassis_by_name,
                                sbrec_chassis_table_get(ovnsb_idl_loop.idl),
+                               sbrec_encap_table_get(ovnsb_idl_loop.idl),
                                chassis,
                                sbrec_sb_global_first(ovnsb_idl_loop.idl),
-                               &transport_zones);
+                               &transport_zones,
+                               on_demand_tunnels ? &tunnel_peers : NULL);
+                    encaps_ran = true;
 
                     stopwatch_start(CONTROLLER_LOOP_STOPWATCH_NAME,
                                     time_msec());
@@ -3074,13 +3909,38 @@ main(int argc, char *argv[])
                     }
 
                     runtime_data = engine_get_data(&en_runtime_data);
+                    if (ctrl_ddlog_is_enabled()) {
+                        ctrl_ddlog_run(ovnsb_idl_loop.idl, chassis);
+                        if (runtime_data) {
+                            ctrl_ddlog_check_local_datapaths(
+                                ovnsb_idl_loop.idl,
+                                &runtime_data->local_datapaths);
+                        }
+                        ddlog_ran = true;
+                    }
+                    if (runtime_data && on_demand_tunnels) {
+                        struct sset peers = SSET_INITIALIZER(&peers);
+                        encaps_collect_peers(&runtime_data->local_datapaths,
+                                             sbrec_port_binding_by_datapath,
+                                             &peers);
+                        if (!sset_equals(&peers, &tunnel_peers)) {
+                            /* Update the tunnels in the next iteration. */
+                            sset_swap(&peers, &tunnel_peers);
+                            poll_immediate_wake();
+                        }
+                        sset_destroy(&peers);
+                    }
                     if (runtime_data) {
                         patch_run(ovs_idl_txn,
                             sbrec_port_binding_by_type,
                             ovsrec_bridge_table_get(ovs_idl_loop.idl),
                             ovsrec_open_vswitch_table_get(ovs_idl_loop.idl),
                             ovsrec_port_table_get(ovs_idl_loop.idl),
-                            br_int, chassis, &runtime_data->local_datapaths);
+                            ovsrec_interface_table_get(ovs_idl_loop.idl),
+                            sbrec_port_binding_table_get(ovnsb_idl_loop.idl),
+                            br_int, chassis, &runtime_data->local_datapaths,
+                            engine_node_changed(&en_runtime_data));
+                        patch_ran = true;
                         pinctrl_run(ovnsb_idl_txn,
                                     sbrec_datapath_binding_by_key,
                                     sbrec_port_binding_by_datapath,
@@ -3099,10 +3959,14 @@ main(int argc, char *argv[])
                                     br_int, chassis,
                                     &runtime_data->local_datapaths,
                                     &runtime_data->active_tunnels);
-                        /* Updating monitor conditions if runtime data or
-                         * logical datapath goups changed. */
+                        /* Updating monitor conditions if runtime data,
+                         * port bindings (for the patch port peers) or
+                         * logical datapath goups changed, or if datapaths
+                         * that are no longer local expired. */
                         if (engine_node_changed(&en_runtime_data)
-                            || engine_node_changed(&en_sb_logical_dp_group)) {
+                            || engine_node_changed(&en_sb_port_binding)
+                            || engine_node_changed(&en_sb_logical_dp_group)
+                            || sb_monitor_expired()) {
                             ovnsb_expected_cond_seqno =
                                 update_sb_monitors(
                                     ovnsb_idl_loop.idl, chassis,
@@ -3123,14 +3987,19 @@ main(int argc, char *argv[])
                         runtime_data ? &runtime_data->lbinding_data : NULL;
                     if_status_mgr_update(if_mgr, binding_data);
 
-                    flow_output_data = engine_get_data(&en_flow_output);
-                    if (flow_output_data && ct_zones_data) {
-                        ofctrl_put(&flow_output_data->flow_table,
+                    lflow_output_data = engine_get_data(&en_lflow_output);
+                    pflow_output_data = engine_get_data(&en_pflow_output);
+                    if (lflow_output_data && pflow_output_data
+                        && ct_zones_data) {
+                        ofctrl_put(&lflow_output_data->flow_table,
+                                   &pflow_output_data->flow_table,
                                    &ct_zones_data->pending,
                                    sbrec_meter_table_get(ovnsb_idl_loop.idl),
                                    ofctrl_seqno_get_req_cfg(),
-                                   engine_node_changed(&en_flow_output));
+                                   engine_node_changed(&en_lflow_output),
+                                   engine_node_changed(&en_pflow_output));
                     }
+                    ofctrl_seqno_sent(ofctrl_get_sent_cfg());
                     ofctrl_seqno_run(ofctrl_get_cur_cfg());
                     if_status_mgr_run(if_mgr, binding_data, !ovnsb_idl_txn,
                                       !ovs_idl_txn);
@@ -3160,6 +4029,9 @@ main(int argc, char *argv[])
 
             store_nb_cfg(ovnsb_idl_txn, ovs_idl_txn, chassis_private,
                          br_int, delay_nb_cfg_report);
+            store_port_up_latency(ovs_idl_txn, br_int, if_mgr);
+            store_ofctrl_stats(ovnsb_idl_txn, chassis_private,
+                               get_ofctrl_stats_interval(ovs_idl_loop.idl));
 
             if (pending_pkt.conn) {
                 struct ed_type_addr_sets *as_data =
@@ -3190,6 +4062,7 @@ main(int argc, char *argv[])
             if (br_int) {
                 ofctrl_wait();
                 pinctrl_wait(ovnsb_idl_txn);
+                sb_monitor_wait();
             }
         }
 
@@ -3210,9 +4083,15 @@ main(int argc, char *argv[])
         if (!ovsdb_idl_loop_commit_and_wait(&ovnsb_idl_loop)) {
             VLOG_INFO("OVNSB commit failed, force recompute next time.");
             engine_set_force_recompute(true);
+            pinctrl_ip_mcast_resync();
         }
 
-        if (ovsdb_idl_loop_commit_and_wait(&ovs_idl_loop) == 1) {
+        int ovs_txn_status = ovsdb_idl_loop_commit_and_wait(&ovs_idl_loop);
+        if (!ovs_txn_status) {
+            /* The tunnels and patch ports may not have been updated. */
+            encaps_invalidate();
+            patch_invalidate();
+        } else if (ovs_txn_status == 1) {
             ct_zones_data = engine_get_data(&en_ct_zones);
             if (ct_zones_data) {
                 struct shash_node *iter, *iter_next;
@@ -3227,6 +4106,16 @@ main(int argc, char *argv[])
             }
         }
 
+        if (!encaps_ran) {
+            /* The tracked changes are about to be lost. */
+            encaps_invalidate();
+        }
+        if (!ddlog_ran) {
+            ctrl_ddlog_invalidate();
+        }
+        if (!patch_ran) {
+            patch_invalidate();
+        }
         ovsdb_idl_track_clear(ovnsb_idl_loop.idl);
         ovsdb_idl_track_clear(ovs_idl_loop.idl);
 
@@ -3238,6 +4127,21 @@ loop_done:
         }
     }
 
+    if (ctrl_engine_ctx.lflow_cache_file) {
+        struct lflow_cache_fingerprint_aux fp_aux = {
+            .logical_flow_table
+                = sbrec_logical_flow_table_get(ovnsb_idl_loop.idl),
+            .sbrec_port_binding_by_name = sbrec_port_binding_by_name,
+            .sbrec_multicast_group_by_name_datapath
+                = sbrec_multicast_group_by_name_datapath,
+        };
+
+        lflow_cache_save(ctrl_engine_ctx.lflow_cache,
+                         ctrl_engine_ctx.lflow_cache_file,
+                         lflow_cache_fingerprint, &fp_aux);
+        free(ctrl_engine_ctx.lflow_cache_file);
+    }
+
     engine_set_context(NULL);
     engine_cleanup();
 
@@ -3298,8 +4202,11 @@ loop_done:
     lflow_destroy();
     ofctrl_destroy();
     pinctrl_destroy();
+    sb_monitor_clear_dps();
     patch_destroy();
     if_status_mgr_destroy(if_mgr);
+    sset_destroy(&tunnel_peers);
+    ha_chassis_cache_destroy();
 
     ovsdb_idl_loop_destroy(&ovs_idl_loop);
     ovsdb_idl_loop_destroy(&ovnsb_idl_loop);
@@ -3499,9 +4406,8 @@ lflow_cache_flush_cmd(struct unixctl_conn *conn OVS_UNUSED,
                       void *arg_)
 {
     VLOG_INFO("User triggered lflow cache flush.");
-    struct flow_output_persistent_data *fo_pd = arg_;
+    struct lflow_output_persistent_data *fo_pd = arg_;
     lflow_cache_flush(fo_pd->lflow_cache);
-    fo_pd->conj_id_ofs = 1;
     engine_set_force_recompute(true);
     poll_immediate_wake();
     unixctl_command_reply(conn, NULL);
@@ -3511,7 +4417,7 @@ static void
 lflow_cache_show_stats_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
                            const char *argv[] OVS_UNUSED, void *arg_)
 {
-    struct flow_output_persistent_data *fo_pd = arg_;
+    struct lflow_output_persistent_data *fo_pd = arg_;
     struct lflow_cache *lc = fo_pd->lflow_cache;
     struct ds ds = DS_EMPTY_INITIALIZER;
 
@@ -3520,6 +4426,143 @@ lflow_cache_show_stats_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
     ds_destroy(&ds);
 }
 
+static void
+if_status_mgr_show_stats_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                             const char *argv[] OVS_UNUSED, void *if_mgr_)
+{
+    struct if_status_mgr *if_mgr = if_mgr_;
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    if_status_mgr_get_stats(if_mgr, &ds);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+static void
+if_status_mgr_clear_stats_cmd(struct unixctl_conn *conn,
+                              int argc OVS_UNUSED,
+                              const char *argv[] OVS_UNUSED, void *if_mgr_)
+{
+    if_status_mgr_clear_stats(if_mgr_);
+    unixctl_command_reply(conn, NULL);
+}
+
+static void
+if_status_mgr_show_timeline_cmd(struct unixctl_conn *conn,
+                                int argc OVS_UNUSED,
+                                const char *argv[] OVS_UNUSED, void *if_mgr_)
+{
+    struct if_status_mgr *if_mgr = if_mgr_;
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    if_status_mgr_get_timelines(if_mgr, &ds);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+static void
+pinctrl_show_buffered_packets_cmd(struct unixctl_conn *conn,
+                                  int argc OVS_UNUSED,
+                                  const char *argv[] OVS_UNUSED,
+                                  void *arg OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    pinctrl_get_buffered_packets_stats(&ds);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+static void
+pinctrl_show_packet_in_stats_cmd(struct unixctl_conn *conn,
+                                 int argc OVS_UNUSED,
+                                 const char *argv[] OVS_UNUSED,
+                                 void *arg OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    pinctrl_get_packet_in_stats(&ds);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+static void
+ofctrl_show_stats_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                      const char *argv[] OVS_UNUSED, void *arg OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    ofctrl_get_stats(&ds);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+static void
+pinctrl_show_ip_mcast_stats_cmd(struct unixctl_conn *conn,
+                                int argc OVS_UNUSED,
+                                const char *argv[] OVS_UNUSED,
+                                void *arg OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    pinctrl_get_ip_mcast_stats(&ds);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+static void
+sb_monitor_show_stats_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                          const char *argv[] OVS_UNUSED, void *idl_)
+{
+    struct ovsdb_idl *ovnsb_idl = idl_;
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    const struct sb_monitor_dp *mdp;
+    size_t n_local = 0;
+
+    HMAP_FOR_EACH (mdp, hmap_node, &sb_monitor.dps) {
+        n_local += mdp->local;
+    }
+
+    ds_put_format(&ds, "Monitor all: %s\n",
+                  sb_monitor.monitor_all ? "true" : "false");
+    ds_put_format(&ds, "Monitored datapaths: %"PRIuSIZE"\n",
+                  hmap_count(&sb_monitor.dps));
+    ds_put_format(&ds, "  local: %"PRIuSIZE"\n", n_local);
+    ds_put_format(&ds, "  retained: %"PRIuSIZE"\n",
+                  hmap_count(&sb_monitor.dps) - n_local);
+    ds_put_format(&ds, "Condition updates: %"PRIu64" (of %"PRIu64" calls)\n",
+                  sb_monitor.n_updates, sb_monitor.n_calls);
+    ds_put_format(&ds, "Condition seqno: %u (expected %u)\n",
+                  ovsdb_idl_get_condition_seqno(ovnsb_idl),
+                  sb_monitor.expected_cond_seqno);
+
+    ds_put_cstr(&ds, "Rows:\n");
+#define SB_MONITOR_COUNT_ROWS(TABLE, NAME_STR)                          \
+    {                                                                   \
+        const struct sbrec_##TABLE *row;                                \
+        size_t n = 0;                                                   \
+                                                                        \
+        for (row = sbrec_##TABLE##_first(ovnsb_idl); row;               \
+             row = sbrec_##TABLE##_next(row)) {                         \
+            n++;                                                        \
+        }                                                               \
+        ds_put_format(&ds, "  %-16s %"PRIuSIZE"\n", NAME_STR":", n);    \
+    }
+    SB_MONITOR_COUNT_ROWS(port_binding, "Port_Binding");
+    SB_MONITOR_COUNT_ROWS(logical_flow, "Logical_Flow");
+    SB_MONITOR_COUNT_ROWS(logical_dp_group, "Logical_DP_Group");
+    SB_MONITOR_COUNT_ROWS(mac_binding, "MAC_Binding");
+    SB_MONITOR_COUNT_ROWS(multicast_group, "Multicast_Group");
+    SB_MONITOR_COUNT_ROWS(dns, "DNS");
+    SB_MONITOR_COUNT_ROWS(load_balancer, "Load_Balancer");
+    SB_MONITOR_COUNT_ROWS(ip_multicast, "IP_Multicast");
+    SB_MONITOR_COUNT_ROWS(igmp_group, "IGMP_Group");
+#undef SB_MONITOR_COUNT_ROWS
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
 static void
 cluster_state_reset_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
                const char *argv[] OVS_UNUSED, void *idl_reset_)
@@ -24,6 +24,8 @@
 #include "openvswitch/hmap.h"
 #include "openvswitch/vlog.h"
 #include "ovn-controller.h"
+#include "lib/ovn-sb-idl.h"
+#include "lib/uuid.h"
 #include "sset.h"
 
 VLOG_DEFINE_THIS_MODULE(patch);
@@ -31,6 +33,16 @@ VLOG_DEFINE_THIS_MODULE(patch);
 /* Contains list of physical bridges that were missing. */
 static struct sset missed_bridges;
 
+/* The inputs of the last patch_run() that reconciled the patch ports.  While
+ * 'valid', the next runs only reconcile them again if one of these inputs,
+ * or a tracked row that the patch ports depend on, changed. */
+static struct {
+    bool valid;
+    struct uuid br_int;
+    struct uuid chassis;
+    char *bridge_mappings;
+} patch_state;
+
 void
 patch_init(void)
 {
@@ -41,6 +53,15 @@ void
 patch_destroy(void)
 {
     sset_destroy(&missed_bridges);
+    free(patch_state.bridge_mappings);
+}
+
+/* Makes the next patch_run() reconcile the patch ports, e.g. because it was
+ * not called and missed tracked changes. */
+void
+patch_invalidate(void)
+{
+    patch_state.valid = false;
 }
 
 static char *
@@ -293,17 +314,114 @@ add_bridge_mappings(struct ovsdb_idl_txn *ovs_idl_txn,
     shash_destroy(&bridge_mappings);
 }
 
+/* Returns true if 'port' was created by ovn-controller for a bridge mapping,
+ * or by an older version for a gateway or logical patch port. */
+static bool
+is_ovn_patch_port(const struct ovsrec_port *port)
+{
+    return (smap_get(&port->external_ids, "ovn-localnet-port")
+            || smap_get(&port->external_ids, "ovn-l2gateway-port")
+            || smap_get(&port->external_ids, "ovn-l3gateway-port")
+            || smap_get(&port->external_ids, "ovn-logical-patch-port"));
+}
+
+/* Returns true if 'mappings', in the format of ovn-bridge-mappings, maps a
+ * network to 'bridge'. */
+static bool
+is_mapped_bridge(const char *mappings, const char *bridge)
+{
+    char *start = xstrdup(mappings);
+    char *next = start;
+    char *cur;
+    bool found = false;
+
+    while (!found && (cur = strsep(&next, ","))) {
+        char *br = strchr(cur, ':');
+        found = br && !strcmp(br + 1, bridge);
+    }
+    free(start);
+    return found;
+}
+
+/* Returns false if the tracked changes may require to add or remove patch
+ * ports: changes of localnet and l2gateway port bindings, of the ports that
+ * ovn-controller created, of patch interfaces, and the creation or deletion
+ * of a mapped bridge, which creates or deletes its local port. */
+static bool
+patch_track_changes(const struct sbrec_port_binding_table *pb_table,
+                    const struct ovsrec_port_table *port_table,
+                    const struct ovsrec_interface_table *iface_table,
+                    const char *bridge_mappings)
+{
+    const struct sbrec_port_binding *pb;
+    SBREC_PORT_BINDING_TABLE_FOR_EACH_TRACKED (pb, pb_table) {
+        if (!strcmp(pb->type, "localnet") || !strcmp(pb->type, "l2gateway")
+            || (!sbrec_port_binding_is_new(pb)
+                && !sbrec_port_binding_is_deleted(pb)
+                && sbrec_port_binding_is_updated(
+                       pb, SBREC_PORT_BINDING_COL_TYPE))) {
+            return false;
+        }
+    }
+
+    const struct ovsrec_port *port;
+    OVSREC_PORT_TABLE_FOR_EACH_TRACKED (port, port_table) {
+        if (is_ovn_patch_port(port)
+            || ((ovsrec_port_is_new(port) || ovsrec_port_is_deleted(port))
+                && is_mapped_bridge(bridge_mappings, port->name))) {
+            return false;
+        }
+    }
+
+    const struct ovsrec_interface *iface;
+    OVSREC_INTERFACE_TABLE_FOR_EACH_TRACKED (iface, iface_table) {
+        if (!strcmp(iface->type, "patch")
+            || (!ovsrec_interface_is_new(iface)
+                && !ovsrec_interface_is_deleted(iface)
+                && ovsrec_interface_is_updated(iface,
+                                               OVSREC_INTERFACE_COL_TYPE))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Adds and removes the patch ports for the bridge mappings.  Only does so
+ * when its inputs changed since the last time it did, as told by the tracked
+ * changes and by 'local_datapaths_changed'. */
 void
 patch_run(struct ovsdb_idl_txn *ovs_idl_txn,
           struct ovsdb_idl_index *sbrec_port_binding_by_type,
           const struct ovsrec_bridge_table *bridge_table,
           const struct ovsrec_open_vswitch_table *ovs_table,
           const struct ovsrec_port_table *port_table,
+          const struct ovsrec_interface_table *iface_table,
+          const struct sbrec_port_binding_table *port_binding_table,
           const struct ovsrec_bridge *br_int,
           const struct sbrec_chassis *chassis,
-          const struct hmap *local_datapaths)
+          const struct hmap *local_datapaths,
+          bool local_datapaths_changed)
 {
-    if (!ovs_idl_txn) {
+    const struct ovsrec_open_vswitch *cfg =
+        ovsrec_open_vswitch_table_first(ovs_table);
+    const char *bridge_mappings = cfg
+        ? smap_get_def(&cfg->external_ids, "ovn-bridge-mappings", "")
+        : "";
+
+    /* The tracked changes are only available during this run, so record
+     * them even if the patch ports can't be updated right now. */
+    if (patch_state.valid
+        && (local_datapaths_changed
+            || !uuid_equals(&patch_state.br_int, &br_int->header_.uuid)
+            || !uuid_equals(&patch_state.chassis, &chassis->header_.uuid)
+            || strcmp(patch_state.bridge_mappings, bridge_mappings)
+            || !patch_track_changes(port_binding_table, port_table,
+                                    iface_table, bridge_mappings))) {
+        patch_invalidate();
+    }
+
+    if (!ovs_idl_txn || patch_state.valid) {
         return;
     }
 
@@ -316,10 +434,7 @@ patch_run(struct ovsdb_idl_txn *ovs_idl_txn,
     struct shash existing_ports = SHASH_INITIALIZER(&existing_ports);
     const struct ovsrec_port *port;
     OVSREC_PORT_TABLE_FOR_EACH (port, port_table) {
-        if (smap_get(&port->external_ids, "ovn-localnet-port")
-            || smap_get(&port->external_ids, "ovn-l2gateway-port")
-            || smap_get(&port->external_ids, "ovn-l3gateway-port")
-            || smap_get(&port->external_ids, "ovn-logical-patch-port")) {
+        if (is_ovn_patch_port(port)) {
             shash_add(&existing_ports, port->name, port);
         }
     }
@@ -340,4 +455,10 @@ patch_run(struct ovsdb_idl_txn *ovs_idl_txn,
         remove_port(bridge_table, port);
     }
     shash_destroy(&existing_ports);
+
+    patch_state.valid = true;
+    patch_state.br_int = br_int->header_.uuid;
+    patch_state.chassis = chassis->header_.uuid;
+    free(patch_state.bridge_mappings);
+    patch_state.bridge_mappings = xstrdup(bridge_mappings);
 }
@@ -27,6 +27,7 @@ struct ovsdb_idl_txn;
 struct ovsdb_idl_index;
 struct ovsrec_bridge;
 struct ovsrec_bridge_table;
+struct ovsrec_interface_table;
 struct ovsrec_open_vswitch_table;
 struct ovsrec_port_table;
 struct sbrec_port_binding_table;
@@ -41,9 +42,13 @@ void patch_run(struct ovsdb_idl_txn *ovs_idl_txn,
                const struct ovsrec_bridge_table *,
                const struct ovsrec_open_vswitch_table *,
                const struct ovsrec_port_table *,
+               const struct ovsrec_interface_table *,
+               const struct sbrec_port_binding_table *,
                const struct ovsrec_bridge *br_int,
                const struct sbrec_chassis *,
-               const struct hmap *local_datapaths);
+               const struct hmap *local_datapaths,
+               bool local_datapaths_changed);
+void patch_invalidate(void);
 void patch_init(void);
 void patch_destroy(void);
 
@@ -23,9 +23,11 @@
 #include "lport.h"
 #include "chassis.h"
 #include "lib/bundle.h"
+#include "lib/extend-table.h"
 #include "openvswitch/poll-loop.h"
 #include "lib/uuid.h"
 #include "ofctrl.h"
+#include "openvswitch/dynamic-string.h"
 #include "openvswitch/list.h"
 #include "openvswitch/hmap.h"
 #include "openvswitch/match.h"
@@ -63,6 +65,10 @@ load_logical_ingress_metadata(const struct sbrec_port_binding *binding,
 /* UUID to identify OF flows not associated with ovsdb rows. */
 static struct uuid *hc_uuid = NULL;
 
+/* UUID to identify the OF flows for the MACs of the remote chassis, so that
+ * they can be replaced when the chassis change. */
+static struct uuid chassis_mac_uuid;
+
 #define CHASSIS_MAC_TO_ROUTER_MAC_CONJID        100
 
 void
@@ -84,44 +90,129 @@ physical_register_ovs_idl(struct ovsdb_idl *ovs_idl)
 
 static struct simap localvif_to_ofport =
     SIMAP_INITIALIZER(&localvif_to_ofport);
+/* Tunnels, indexed by chassis name and by chassis name and encap IP. */
 static struct hmap tunnels = HMAP_INITIALIZER(&tunnels);
+static struct hmap tunnels_by_ip = HMAP_INITIALIZER(&tunnels_by_ip);
 
 /* Maps from a chassis to the OpenFlow port number of the tunnel that can be
  * used to reach that chassis. */
 struct chassis_tunnel {
-    struct hmap_node hmap_node;
-    char *chassis_id;
+    struct hmap_node hmap_node;     /* In 'tunnels'. */
+    struct hmap_node ip_node;       /* In 'tunnels_by_ip'. */
+    char *chassis_id;               /* <chassis_name><delimiter><IP>. */
+    char *chassis_name;             /* Parsed from 'chassis_id'. */
+    char *encap_ip;                 /* Parsed from 'chassis_id'. */
     ofp_port_t ofport;
     enum chassis_tunnel_type type;
+    struct uuid flow_uuid;      /* Identifies the flows for packets received
+                                 * from the tunnel. */
 };
 
+void
+physical_get_memory_usage(struct simap *usage)
+{
+    size_t bytes = ovn_hmap_buckets_size(&tunnels)
+                   + ovn_hmap_buckets_size(&tunnels_by_ip)
+                   + ovn_hmap_buckets_size(&localvif_to_ofport.map)
+                   + ovn_hmap_buckets_size(&remote_chassis_macs);
+
+    const struct chassis_tunnel *tun;
+    HMAP_FOR_EACH (tun, hmap_node, &tunnels) {
+        bytes += sizeof *tun + strlen(tun->chassis_id) + 1
+                 + strlen(tun->chassis_name) + 1 + strlen(tun->encap_ip) + 1;
+    }
+
+    const struct simap_node *node;
+    SIMAP_FOR_EACH (node, &localvif_to_ofport) {
+        bytes += sizeof *node + strlen(node->name) + 1;
+    }
+
+    const struct remote_chassis_mac *mac;
+    HMAP_FOR_EACH (mac, hmap_node, &remote_chassis_macs) {
+        bytes += sizeof *mac + strlen(mac->chassis_mac) + 1
+                 + strlen(mac->chassis_id) + 1;
+    }
+
+    simap_increase(usage, "physical-tunnels", hmap_count(&tunnels));
+    simap_increase(usage, "physical-ofports",
+                   simap_count(&localvif_to_ofport));
+    simap_increase(usage, "physical-KB", ROUND_UP(bytes, 1024) / 1024);
+}
+
+static uint32_t
+chassis_tunnel_ip_hash(const char *chassis_name, const char *encap_ip)
+{
+    return hash_string(encap_ip, hash_string(chassis_name, 0));
+}
+
 /*
  * This function looks up the list of tunnel ports (provided by
  * ovn-chassis-id ports) and returns the tunnel for the given chassid-id and
  * encap-ip. The ovn-chassis-id is formed using the chassis-id and encap-ip.
- * The list is hashed using the chassis-id. If the encap-ip is not specified,
- * it means we'll just return a tunnel for that chassis-id, i.e. we just check
- * for chassis-id and if there is a match, we'll return the tunnel.
+ * The tunnels are indexed by the chassis-id and, separately, by both the
+ * chassis-id and the encap-ip. If the encap-ip is not specified, it means
+ * we'll just return a tunnel for that chassis-id, i.e. we just check for
+ * chassis-id and if there is a match, we'll return the tunnel.
  * If encap-ip is also provided we use both chassis-id and encap-ip to do
  * a more specific lookup.
  */
 static struct chassis_tunnel *
-chassis_tunnel_find(const char *chassis_id, char *encap_ip)
+chassis_tunnel_find(const char *chassis_id, const char *encap_ip)
 {
-    /*
-     * If the specific encap_ip is given, look for the chassisid_ip entry,
-     * else return the 1st found entry for the chassis.
-     */
     struct chassis_tunnel *tun = NULL;
+    if (encap_ip) {
+        HMAP_FOR_EACH_WITH_HASH (tun, ip_node,
+                                 chassis_tunnel_ip_hash(chassis_id, encap_ip),
+                                 &tunnels_by_ip) {
+            if (!strcmp(tun->chassis_name, chassis_id)
+                && !strcmp(tun->encap_ip, encap_ip)) {
+                return tun;
+            }
+        }
+        return NULL;
+    }
+
+    /* Return the 1st found entry for the chassis. */
     HMAP_FOR_EACH_WITH_HASH (tun, hmap_node, hash_string(chassis_id, 0),
                              &tunnels) {
-        if (encaps_tunnel_id_match(tun->chassis_id, chassis_id, encap_ip)) {
+        if (!strcmp(tun->chassis_name, chassis_id)) {
             return tun;
         }
     }
     return NULL;
 }
 
+/* Adds a tunnel for 'tunnel_id', which is 'chassis_name' and 'encap_ip'
+ * joined by the delimiter.  Takes ownership of 'chassis_name' and
+ * 'encap_ip'. */
+static struct chassis_tunnel *
+chassis_tunnel_add(const char *tunnel_id, char *chassis_name, char *encap_ip,
+                   ofp_port_t ofport, enum chassis_tunnel_type type)
+{
+    struct chassis_tunnel *tun = xmalloc(sizeof *tun);
+    tun->chassis_id = xstrdup(tunnel_id);
+    tun->chassis_name = chassis_name;
+    tun->encap_ip = encap_ip;
+    tun->ofport = ofport;
+    tun->type = type;
+    uuid_generate(&tun->flow_uuid);
+    hmap_insert(&tunnels, &tun->hmap_node, hash_string(chassis_name, 0));
+    hmap_insert(&tunnels_by_ip, &tun->ip_node,
+                chassis_tunnel_ip_hash(chassis_name, encap_ip));
+    return tun;
+}
+
+static void
+chassis_tunnel_destroy(struct chassis_tunnel *tun)
+{
+    hmap_remove(&tunnels, &tun->hmap_node);
+    hmap_remove(&tunnels_by_ip, &tun->ip_node);
+    free(tun->chassis_id);
+    free(tun->chassis_name);
+    free(tun->encap_ip);
+    free(tun);
+}
+
 static void
 put_load(uint64_t value, enum mf_field_id dst, int ofs, int n_bits,
          struct ofpbuf *ofpacts)
@@ -512,7 +603,7 @@ put_chassis_mac_conj_id_flow(const struct sbrec_chassis_table *chassis_table,
         conj->clause = 0;
         ofctrl_add_flow(flow_table, OFTABLE_PHY_TO_LOG, 180,
                         mac->chassis_sb_cookie,
-                        &match, ofpacts_p, hc_uuid);
+                        &match, ofpacts_p, &chassis_mac_uuid);
     }
 
     free_remote_chassis_macs();
@@ -1342,6 +1433,7 @@ consider_mc_group(enum mf_field_id mff_ovn_geneve,
                   const struct hmap *local_datapaths,
                   const struct sbrec_chassis *chassis,
                   const struct sbrec_multicast_group *mc,
+                  struct ovn_extend_table *group_table,
                   struct ovn_desired_flow_table *flow_table)
 {
     uint32_t dp_key = mc->datapath->tunnel_key;
@@ -1367,11 +1459,20 @@ consider_mc_group(enum mf_field_id mff_ovn_geneve,
      *      instead.  (If we put them in 'ofpacts', then the output
      *      would happen on every hypervisor in the multicast group,
      *      effectively duplicating the packet.)
+     *
+     * With a 'group_table', the actions of each local port go to their own
+     * bucket of a group of type "all" instead, so that the output to the
+     * local ports takes a single action whatever their number.  They are
+     * still added to 'ofpacts' too, in case the group can't get an ID.
      */
     struct ofpbuf ofpacts;
     ofpbuf_init(&ofpacts, 0);
     struct ofpbuf remote_ofpacts;
     ofpbuf_init(&remote_ofpacts, 0);
+    struct ofpbuf bucket;
+    ofpbuf_init(&bucket, 0);
+    struct ds group = DS_EMPTY_INITIALIZER;
+    size_t n_buckets = 0;
     for (size_t i = 0; i < mc->n_ports; i++) {
         struct sbrec_port_binding *port = mc->ports[i];
 
@@ -1384,7 +1485,7 @@ consider_mc_group(enum mf_field_id mff_ovn_geneve,
         }
 
         int zone_id = simap_get(ct_zones, port->logical_port);
-        if (zone_id) {
+        if (zone_id && !group_table) {
             put_load(zone_id, MFF_LOG_CT_ZONE, 0, 32, &ofpacts);
         }
 
@@ -1397,8 +1498,23 @@ consider_mc_group(enum mf_field_id mff_ovn_geneve,
                            ? port->parent_port : port->logical_port)
                    || (!strcmp(port->type, "l3gateway")
                        && port->chassis == chassis)) {
-            put_load(port->tunnel_key, MFF_LOG_OUTPORT, 0, 32, &ofpacts);
-            put_resubmit(OFTABLE_CHECK_LOOPBACK, &ofpacts);
+            if (group_table) {
+                ofpbuf_clear(&bucket);
+                if (zone_id) {
+                    put_load(zone_id, MFF_LOG_CT_ZONE, 0, 32, &bucket);
+                }
+                put_load(port->tunnel_key, MFF_LOG_OUTPORT, 0, 32, &bucket);
+                put_resubmit(OFTABLE_CHECK_LOOPBACK, &bucket);
+
+                struct ofpact_format_params fp = { .s = &group };
+                ds_put_format(&group, ",bucket=bucket_id=%"PRIuSIZE
+                              ",actions=", n_buckets++);
+                ofpacts_format(bucket.data, bucket.size, &fp);
+                ofpbuf_put(&ofpacts, bucket.data, bucket.size);
+            } else {
+                put_load(port->tunnel_key, MFF_LOG_OUTPORT, 0, 32, &ofpacts);
+                put_resubmit(OFTABLE_CHECK_LOOPBACK, &ofpacts);
+            }
         } else if (port->chassis && !get_localnet_port(local_datapaths,
                                          mc->datapath->tunnel_key)) {
             /* Add remote chassis only when localnet port not exist,
@@ -1413,8 +1529,29 @@ consider_mc_group(enum mf_field_id mff_ovn_geneve,
      *
      * Handle output to the local logical ports in the multicast group, if
      * any. */
+    if (n_buckets) {
+        /* The buckets act on clones of the packet, so the logical output
+         * port stays the multicast group. */
+        char *name = xasprintf("type=all%s", ds_cstr(&group));
+        uint32_t group_id = ovn_extend_table_assign_id(group_table, name,
+                                                       mc->header_.uuid);
+        free(name);
+        if (group_id != EXT_TABLE_ID_INVALID) {
+            ofpbuf_clear(&ofpacts);
+            ofpact_put_GROUP(&ofpacts)->group_id = group_id;
+            ofctrl_add_flow(flow_table, OFTABLE_LOCAL_OUTPUT, 100,
+                            mc->header_.uuid.parts[0],
+                            &match, &ofpacts, &mc->header_.uuid);
+        } else {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
+            VLOG_WARN_RL(&rl, "no group ID left for multicast group %s of "
+                         "datapath %"PRIu32", outputting to its local "
+                         "ports without a group", mc->name, dp_key);
+            n_buckets = 0;
+        }
+    }
     bool local_ports = ofpacts.size > 0;
-    if (local_ports) {
+    if (local_ports && !n_buckets) {
         /* Following delivery to local logical ports, restore the multicast
          * group as the logical output port. */
         put_load(mc->tunnel_key, MFF_LOG_OUTPORT, 0, 32, &ofpacts);
@@ -1465,9 +1602,32 @@ consider_mc_group(enum mf_field_id mff_ovn_geneve,
     }
     ofpbuf_uninit(&ofpacts);
     ofpbuf_uninit(&remote_ofpacts);
+    ofpbuf_uninit(&bucket);
+    ds_destroy(&group);
     sset_destroy(&remote_chassis);
 }
 
+/* Returns the group table that consider_mc_group() uses for 'p_ctx', if
+ * any. */
+static struct ovn_extend_table *
+mc_group_table(const struct physical_ctx *p_ctx)
+{
+    return p_ctx->mc_flood_groups ? p_ctx->group_table : NULL;
+}
+
+/* Removes the physical flows of 'mc' and its group, if it has one. */
+static void
+remove_mc_group_flows(const struct physical_ctx *p_ctx,
+                      const struct sbrec_multicast_group *mc,
+                      struct ovn_desired_flow_table *flow_table)
+{
+    ofctrl_remove_flows(flow_table, &mc->header_.uuid);
+    if (p_ctx->group_table) {
+        ovn_extend_table_remove_desired(p_ctx->group_table,
+                                        &mc->header_.uuid);
+    }
+}
+
 /* Replaces 'old' by 'new' (destroying 'new').  Returns true if 'old' and 'new'
  * contained different data, false if they were the same. */
 static bool
@@ -1479,6 +1639,295 @@ update_ofports(struct simap *old, struct simap *new)
     return changed;
 }
 
+/* Adds the flows in table 0, priority 100 and 110, for the packets received
+ * from 'tun', identified by the tunnel's 'flow_uuid'.
+ *
+ * Geneve and STT encapsulations have metadata about the ingress and egress
+ * logical ports.  VXLAN encapsulations have metadata about the egress logical
+ * port only.  We set MFF_LOG_DATAPATH, MFF_LOG_INPORT, and MFF_LOG_OUTPORT
+ * from the tunnel key data where possible, then resubmit to table 33 to
+ * handle packets to the local hypervisor. */
+static void
+put_tunnel_flows(const struct physical_ctx *p_ctx,
+                 const struct chassis_tunnel *tun, struct ofpbuf *ofpacts,
+                 struct ovn_desired_flow_table *flow_table)
+{
+    struct match match = MATCH_CATCHALL_INITIALIZER;
+    match_set_in_port(&match, tun->ofport);
+
+    ofpbuf_clear(ofpacts);
+    if (tun->type == GENEVE) {
+        put_move(MFF_TUN_ID, 0,  MFF_LOG_DATAPATH, 0, 24, ofpacts);
+        put_move(p_ctx->mff_ovn_geneve, 16, MFF_LOG_INPORT, 0, 15, ofpacts);
+        put_move(p_ctx->mff_ovn_geneve, 0, MFF_LOG_OUTPORT, 0, 16, ofpacts);
+    } else if (tun->type == STT) {
+        put_move(MFF_TUN_ID, 40, MFF_LOG_INPORT,   0, 15, ofpacts);
+        put_move(MFF_TUN_ID, 24, MFF_LOG_OUTPORT,  0, 16, ofpacts);
+        put_move(MFF_TUN_ID,  0, MFF_LOG_DATAPATH, 0, 24, ofpacts);
+    } else if (tun->type == VXLAN) {
+        /* Add flows for non-VTEP tunnels. Split VNI into two 12-bit
+         * sections and use them for datapath and outport IDs. */
+        put_move(MFF_TUN_ID, 12, MFF_LOG_OUTPORT,  0, 12, ofpacts);
+        put_move(MFF_TUN_ID, 0, MFF_LOG_DATAPATH, 0, 12, ofpacts);
+    } else {
+        OVS_NOT_REACHED();
+    }
+
+    put_resubmit(OFTABLE_LOCAL_OUTPUT, ofpacts);
+
+    ofctrl_add_flow(flow_table, OFTABLE_PHY_TO_LOG, 100, 0, &match,
+                    ofpacts, &tun->flow_uuid);
+
+    if (tun->type != VXLAN) {
+        return;
+    }
+
+    /* Handle ramp switch encapsulations. */
+    struct sbrec_port_binding *target = sbrec_port_binding_index_init_row(
+        p_ctx->sbrec_port_binding_by_type);
+    sbrec_port_binding_index_set_type(target, "vtep");
+
+    const struct sbrec_port_binding *binding;
+    SBREC_PORT_BINDING_FOR_EACH_EQUAL (binding, target,
+                                       p_ctx->sbrec_port_binding_by_type) {
+        if (!binding->chassis ||
+            strcmp(tun->chassis_name, binding->chassis->name)) {
+            continue;
+        }
+
+        match_init_catchall(&match);
+        match_set_in_port(&match, tun->ofport);
+        ofpbuf_clear(ofpacts);
+
+        /* Add flows for ramp switches.  The VNI is used to populate
+         * MFF_LOG_DATAPATH.  The gateway's logical port is set to
+         * MFF_LOG_INPORT.  Then the packet is resubmitted to table 8
+         * to determine the logical egress port. */
+        match_set_tun_id(&match, htonll(binding->datapath->tunnel_key));
+
+        put_move(MFF_TUN_ID, 0,  MFF_LOG_DATAPATH, 0, 24, ofpacts);
+        put_load(binding->tunnel_key, MFF_LOG_INPORT, 0, 15, ofpacts);
+        /* For packets received from a ramp tunnel, set a flag to that
+         * effect. */
+        put_load(1, MFF_LOG_FLAGS, MLF_RCV_FROM_RAMP_BIT, 1, ofpacts);
+        put_resubmit(OFTABLE_LOG_INGRESS_PIPELINE, ofpacts);
+
+        ofctrl_add_flow(flow_table, OFTABLE_PHY_TO_LOG, 110,
+                        binding->header_.uuid.parts[0],
+                        &match, ofpacts, &tun->flow_uuid);
+    }
+    sbrec_port_binding_index_destroy_row(target);
+}
+
+/* Synchronizes 'tunnels' with the ovn-chassis-id ports of br-int.  The flows
+ * of the tunnels that changed or were removed are removed from 'flow_table';
+ * the caller must add the flows of the new and changed tunnels, which are
+ * stored in 'changed_tunnels' if it is nonnull.  The chassis names of the
+ * tunnels that were added, changed or removed are stored in
+ * 'changed_chassis' if it is nonnull.
+ *
+ * Returns true if any tunnel was added, changed or removed. */
+static bool
+update_tunnels(const struct physical_ctx *p_ctx,
+               struct ovn_desired_flow_table *flow_table,
+               struct sset *changed_chassis, struct hmapx *changed_tunnels)
+{
+    struct sset new_tunnels = SSET_INITIALIZER(&new_tunnels);
+    bool changed = false;
+
+    for (int i = 0; i < p_ctx->br_int->n_ports; i++) {
+        const struct ovsrec_port *port_rec = p_ctx->br_int->ports[i];
+        if (!strcmp(port_rec->name, p_ctx->br_int->name)) {
+            continue;
+        }
+
+        const char *tunnel_id = smap_get(&port_rec->external_ids,
+                                         "ovn-chassis-id");
+        if (!tunnel_id || encaps_tunnel_id_match(tunnel_id,
+                                                 p_ctx->chassis->name,
+                                                 NULL)) {
+            continue;
+        }
+
+        for (int j = 0; j < port_rec->n_interfaces; j++) {
+            const struct ovsrec_interface *iface_rec = port_rec->interfaces[j];
+
+            /* Get OpenFlow port number. */
+            if (!iface_rec->n_ofport) {
+                continue;
+            }
+            int64_t ofport = iface_rec->ofport[0];
+            if (ofport < 1 || ofport > ofp_to_u16(OFPP_MAX)) {
+                continue;
+            }
+
+            enum chassis_tunnel_type tunnel_type;
+            if (!strcmp(iface_rec->type, "geneve")) {
+                tunnel_type = GENEVE;
+                if (!p_ctx->mff_ovn_geneve) {
+                    continue;
+                }
+            } else if (!strcmp(iface_rec->type, "stt")) {
+                tunnel_type = STT;
+            } else if (!strcmp(iface_rec->type, "vxlan")) {
+                tunnel_type = VXLAN;
+            } else {
+                continue;
+            }
+
+            /*
+             * We split the tunnel_id to get the chassis-id
+             * and hash the tunnel list on the chassis-id. The
+             * reason to use the chassis-id alone is because
+             * there might be cases (multicast, gateway chassis)
+             * where we need to tunnel to the chassis, but won't
+             * have the encap-ip specifically.
+             */
+            char *hash_id = NULL;
+            char *ip = NULL;
+
+            if (!encaps_tunnel_id_parse(tunnel_id, &hash_id, &ip)) {
+                continue;
+            }
+            sset_add(&new_tunnels, tunnel_id);
+
+            struct chassis_tunnel *tun = chassis_tunnel_find(hash_id, ip);
+            bool tun_changed = false;
+            if (tun) {
+                /* If the tunnel's ofport has changed, update. */
+                if (tun->ofport != u16_to_ofp(ofport) ||
+                    tun->type != tunnel_type) {
+                    ofctrl_remove_flows(flow_table, &tun->flow_uuid);
+                    tun->ofport = u16_to_ofp(ofport);
+                    tun->type = tunnel_type;
+                    tun_changed = true;
+                }
+                free(hash_id);
+                free(ip);
+            } else {
+                tun = chassis_tunnel_add(tunnel_id, hash_id, ip,
+                                         u16_to_ofp(ofport), tunnel_type);
+                tun_changed = true;
+            }
+
+            if (tun_changed) {
+                changed = true;
+                if (changed_chassis) {
+                    sset_add(changed_chassis, tun->chassis_name);
+                }
+                if (changed_tunnels) {
+                    hmapx_add(changed_tunnels, tun);
+                }
+            }
+            break;
+        }
+    }
+
+    /* Remove tunnels that are no longer here. */
+    struct chassis_tunnel *tun, *tun_next;
+    HMAP_FOR_EACH_SAFE (tun, tun_next, hmap_node, &tunnels) {
+        if (!sset_contains(&new_tunnels, tun->chassis_id)) {
+            if (changed_chassis) {
+                sset_add(changed_chassis, tun->chassis_name);
+            }
+            ofctrl_remove_flows(flow_table, &tun->flow_uuid);
+            chassis_tunnel_destroy(tun);
+            changed = true;
+        }
+    }
+    sset_destroy(&new_tunnels);
+
+    return changed;
+}
+
+static bool
+chassis_name_is_in(const struct sbrec_chassis *chassis,
+                   const struct sset *chassis_names)
+{
+    return chassis && sset_contains(chassis_names, chassis->name);
+}
+
+/* Returns true if 'binding' is bound to, or may be bound to as part of its
+ * HA chassis group, a chassis in 'chassis_names'. */
+static bool
+binding_uses_chassis(const struct sbrec_port_binding *binding,
+                     const struct sset *chassis_names)
+{
+    if (chassis_name_is_in(binding->chassis, chassis_names)) {
+        return true;
+    }
+
+    const struct sbrec_ha_chassis_group *ha_ch_grp
+        = binding->ha_chassis_group;
+    for (size_t i = 0; ha_ch_grp && i < ha_ch_grp->n_ha_chassis; i++) {
+        if (chassis_name_is_in(ha_ch_grp->ha_chassis[i]->chassis,
+                               chassis_names)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Recomputes the physical flows of the port bindings and multicast groups
+ * that may send packets to a chassis in 'chassis_names', since the tunnels
+ * to those chassis changed. */
+static void
+physical_reconsider_chassis(const struct physical_ctx *p_ctx,
+                            const struct sset *chassis_names,
+                            struct ovn_desired_flow_table *flow_table)
+{
+    if (sset_is_empty(chassis_names)) {
+        return;
+    }
+
+    struct ofpbuf ofpacts;
+    ofpbuf_init(&ofpacts, 0);
+
+    struct ovsdb_idl_index *pb_by_dp = p_ctx->sbrec_port_binding_by_datapath;
+    struct sbrec_port_binding *target
+        = sbrec_port_binding_index_init_row(pb_by_dp);
+
+    const struct local_datapath *ld;
+    HMAP_FOR_EACH (ld, hmap_node, p_ctx->local_datapaths) {
+        sbrec_port_binding_index_set_datapath(target, ld->datapath);
+
+        const struct sbrec_port_binding *binding;
+        SBREC_PORT_BINDING_FOR_EACH_EQUAL (binding, target, pb_by_dp) {
+            if (binding_uses_chassis(binding, chassis_names)) {
+                ofctrl_remove_flows(flow_table, &binding->header_.uuid);
+                consider_port_binding(p_ctx->sbrec_port_binding_by_name,
+                                      p_ctx->mff_ovn_geneve, p_ctx->ct_zones,
+                                      p_ctx->active_tunnels,
+                                      p_ctx->local_datapaths,
+                                      binding, p_ctx->chassis,
+                                      flow_table, &ofpacts);
+            }
+        }
+    }
+    sbrec_port_binding_index_destroy_row(target);
+
+    const struct sbrec_multicast_group *mc;
+    SBREC_MULTICAST_GROUP_TABLE_FOR_EACH (mc, p_ctx->mc_group_table) {
+        if (!get_local_datapath(p_ctx->local_datapaths,
+                                mc->datapath->tunnel_key)) {
+            continue;
+        }
+
+        for (size_t i = 0; i < mc->n_ports; i++) {
+            if (chassis_name_is_in(mc->ports[i]->chassis, chassis_names)) {
+                remove_mc_group_flows(p_ctx, mc, flow_table);
+                consider_mc_group(p_ctx->mff_ovn_geneve, p_ctx->ct_zones,
+                                  p_ctx->local_datapaths,
+                                  p_ctx->chassis, mc, mc_group_table(p_ctx),
+                                  flow_table);
+                break;
+            }
+        }
+    }
+
+    ofpbuf_uninit(&ofpacts);
+}
+
 void
 physical_handle_port_binding_changes(struct physical_ctx *p_ctx,
                                      struct ovn_desired_flow_table *flow_table)
@@ -1512,14 +1961,15 @@ physical_handle_mc_group_changes(struct physical_ctx *p_ctx,
     const struct sbrec_multicast_group *mc;
     SBREC_MULTICAST_GROUP_TABLE_FOR_EACH_TRACKED (mc, p_ctx->mc_group_table) {
         if (sbrec_multicast_group_is_deleted(mc)) {
-            ofctrl_remove_flows(flow_table, &mc->header_.uuid);
+            remove_mc_group_flows(p_ctx, mc, flow_table);
         } else {
             if (!sbrec_multicast_group_is_new(mc)) {
-                ofctrl_remove_flows(flow_table, &mc->header_.uuid);
+                remove_mc_group_flows(p_ctx, mc, flow_table);
             }
             consider_mc_group(p_ctx->mff_ovn_geneve, p_ctx->ct_zones,
                               p_ctx->local_datapaths,
-                              p_ctx->chassis, mc, flow_table);
+                              p_ctx->chassis, mc, mc_group_table(p_ctx),
+                              flow_table);
         }
     }
 }
@@ -1531,6 +1981,7 @@ physical_run(struct physical_ctx *p_ctx,
     if (!hc_uuid) {
         hc_uuid = xmalloc(sizeof(struct uuid));
         uuid_generate(hc_uuid);
+        uuid_generate(&chassis_mac_uuid);
     }
 
     /* This bool tracks physical mapping changes. */
@@ -1538,8 +1989,6 @@ physical_run(struct physical_ctx *p_ctx,
 
     struct simap new_localvif_to_ofport =
         SIMAP_INITIALIZER(&new_localvif_to_ofport);
-    struct simap new_tunnel_to_ofport =
-        SIMAP_INITIALIZER(&new_tunnel_to_ofport);
     for (int i = 0; i < p_ctx->br_int->n_ports; i++) {
         const struct ovsrec_port *port_rec = p_ctx->br_int->ports[i];
         if (!strcmp(port_rec->name, p_ctx->br_int->name)) {
@@ -1583,55 +2032,7 @@ physical_run(struct physical_ctx *p_ctx,
                 simap_put(&new_localvif_to_ofport, l2gateway, ofport);
                 break;
             } else if (tunnel_id) {
-                enum chassis_tunnel_type tunnel_type;
-                if (!strcmp(iface_rec->type, "geneve")) {
-                    tunnel_type = GENEVE;
-                    if (!p_ctx->mff_ovn_geneve) {
-                        continue;
-                    }
-                } else if (!strcmp(iface_rec->type, "stt")) {
-                    tunnel_type = STT;
-                } else if (!strcmp(iface_rec->type, "vxlan")) {
-                    tunnel_type = VXLAN;
-                } else {
-                    continue;
-                }
-
-                simap_put(&new_tunnel_to_ofport, tunnel_id, ofport);
-                /*
-                 * We split the tunnel_id to get the chassis-id
-                 * and hash the tunnel list on the chassis-id. The
-                 * reason to use the chassis-id alone is because
-                 * there might be cases (multicast, gateway chassis)
-                 * where we need to tunnel to the chassis, but won't
-                 * have the encap-ip specifically.
-                 */
-                char *hash_id = NULL;
-                char *ip = NULL;
-
-                if (!encaps_tunnel_id_parse(tunnel_id, &hash_id, &ip)) {
-                    continue;
-                }
-                struct chassis_tunnel *tun = chassis_tunnel_find(hash_id, ip);
-                if (tun) {
-                    /* If the tunnel's ofport has changed, update. */
-                    if (tun->ofport != u16_to_ofp(ofport) ||
-                        tun->type != tunnel_type) {
-                        tun->ofport = u16_to_ofp(ofport);
-                        tun->type = tunnel_type;
-                        physical_map_changed = true;
-                    }
-                } else {
-                    tun = xmalloc(sizeof *tun);
-                    hmap_insert(&tunnels, &tun->hmap_node,
-                                hash_string(hash_id, 0));
-                    tun->chassis_id = xstrdup(tunnel_id);
-                    tun->ofport = u16_to_ofp(ofport);
-                    tun->type = tunnel_type;
-                    physical_map_changed = true;
-                }
-                free(hash_id);
-                free(ip);
+                /* Tunnels are handled by update_tunnels(). */
                 break;
             } else {
                 const char *iface_id = smap_get(&iface_rec->external_ids,
@@ -1643,16 +2044,7 @@ physical_run(struct physical_ctx *p_ctx,
         }
     }
 
-    /* Remove tunnels that are no longer here. */
-    struct chassis_tunnel *tun, *tun_next;
-    HMAP_FOR_EACH_SAFE (tun, tun_next, hmap_node, &tunnels) {
-        if (!simap_find(&new_tunnel_to_ofport, tun->chassis_id)) {
-            hmap_remove(&tunnels, &tun->hmap_node);
-            physical_map_changed = true;
-            free(tun->chassis_id);
-            free(tun);
-        }
-    }
+    physical_map_changed |= update_tunnels(p_ctx, flow_table, NULL, NULL);
 
     /* Capture changed or removed openflow ports. */
     physical_map_changed |= update_ofports(&localvif_to_ofport,
@@ -1669,105 +2061,40 @@ physical_run(struct physical_ctx *p_ctx,
                                  &ofpacts, flow_table);
 
     /* Set up flows in table 0 for physical-to-logical translation and in table
-     * 64 for logical-to-physical translation. */
-    const struct sbrec_port_binding *binding;
-    SBREC_PORT_BINDING_TABLE_FOR_EACH (binding, p_ctx->port_binding_table) {
-        consider_port_binding(p_ctx->sbrec_port_binding_by_name,
-                              p_ctx->mff_ovn_geneve, p_ctx->ct_zones,
-                              p_ctx->active_tunnels, p_ctx->local_datapaths,
-                              binding, p_ctx->chassis,
-                              flow_table, &ofpacts);
+     * 64 for logical-to-physical translation.  Only the port bindings of the
+     * local datapaths have flows. */
+    struct ovsdb_idl_index *pb_by_dp = p_ctx->sbrec_port_binding_by_datapath;
+    struct sbrec_port_binding *target
+        = sbrec_port_binding_index_init_row(pb_by_dp);
+
+    const struct local_datapath *ld;
+    HMAP_FOR_EACH (ld, hmap_node, p_ctx->local_datapaths) {
+        sbrec_port_binding_index_set_datapath(target, ld->datapath);
+
+        const struct sbrec_port_binding *binding;
+        SBREC_PORT_BINDING_FOR_EACH_EQUAL (binding, target, pb_by_dp) {
+            consider_port_binding(p_ctx->sbrec_port_binding_by_name,
+                                  p_ctx->mff_ovn_geneve, p_ctx->ct_zones,
+                                  p_ctx->active_tunnels,
+                                  p_ctx->local_datapaths,
+                                  binding, p_ctx->chassis,
+                                  flow_table, &ofpacts);
+        }
     }
+    sbrec_port_binding_index_destroy_row(target);
 
     /* Handle output to multicast groups, in tables 32 and 33. */
     const struct sbrec_multicast_group *mc;
     SBREC_MULTICAST_GROUP_TABLE_FOR_EACH (mc, p_ctx->mc_group_table) {
         consider_mc_group(p_ctx->mff_ovn_geneve, p_ctx->ct_zones,
                           p_ctx->local_datapaths, p_ctx->chassis,
-                          mc, flow_table);
+                          mc, mc_group_table(p_ctx), flow_table);
     }
 
-    /* Table 0, priority 100.
-     * ======================
-     *
-     * Process packets that arrive from a remote hypervisor (by matching
-     * on tunnel in_port). */
-
-    /* Add flows for Geneve, STT and VXLAN encapsulations.  Geneve and STT
-     * encapsulations have metadata about the ingress and egress logical ports.
-     * VXLAN encapsulations have metadata about the egress logical port only.
-     * We set MFF_LOG_DATAPATH, MFF_LOG_INPORT, and MFF_LOG_OUTPORT from the
-     * tunnel key data where possible, then resubmit to table 33 to handle
-     * packets to the local hypervisor. */
+    /* Table 0, priority 100 and 110: packets received from tunnels. */
+    struct chassis_tunnel *tun;
     HMAP_FOR_EACH (tun, hmap_node, &tunnels) {
-        struct match match = MATCH_CATCHALL_INITIALIZER;
-        match_set_in_port(&match, tun->ofport);
-
-        ofpbuf_clear(&ofpacts);
-        if (tun->type == GENEVE) {
-            put_move(MFF_TUN_ID, 0,  MFF_LOG_DATAPATH, 0, 24, &ofpacts);
-            put_move(p_ctx->mff_ovn_geneve, 16, MFF_LOG_INPORT, 0, 15,
-                     &ofpacts);
-            put_move(p_ctx->mff_ovn_geneve, 0, MFF_LOG_OUTPORT, 0, 16,
-                     &ofpacts);
-        } else if (tun->type == STT) {
-            put_move(MFF_TUN_ID, 40, MFF_LOG_INPORT,   0, 15, &ofpacts);
-            put_move(MFF_TUN_ID, 24, MFF_LOG_OUTPORT,  0, 16, &ofpacts);
-            put_move(MFF_TUN_ID,  0, MFF_LOG_DATAPATH, 0, 24, &ofpacts);
-        } else if (tun->type == VXLAN) {
-            /* Add flows for non-VTEP tunnels. Split VNI into two 12-bit
-             * sections and use them for datapath and outport IDs. */
-            put_move(MFF_TUN_ID, 12, MFF_LOG_OUTPORT,  0, 12, &ofpacts);
-            put_move(MFF_TUN_ID, 0, MFF_LOG_DATAPATH, 0, 12, &ofpacts);
-        } else {
-            OVS_NOT_REACHED();
-        }
-
-        put_resubmit(OFTABLE_LOCAL_OUTPUT, &ofpacts);
-
-        ofctrl_add_flow(flow_table, OFTABLE_PHY_TO_LOG, 100, 0, &match,
-                        &ofpacts, hc_uuid);
-    }
-
-    /* Handle ramp switch encapsulations. */
-    HMAP_FOR_EACH (tun, hmap_node, &tunnels) {
-        if (tun->type != VXLAN) {
-            continue;
-        }
-
-        SBREC_PORT_BINDING_TABLE_FOR_EACH (binding,
-                                           p_ctx->port_binding_table) {
-            if (strcmp(binding->type, "vtep")) {
-                continue;
-            }
-
-            if (!binding->chassis ||
-                !encaps_tunnel_id_match(tun->chassis_id,
-                                        binding->chassis->name, NULL)) {
-                continue;
-            }
-
-            struct match match = MATCH_CATCHALL_INITIALIZER;
-            match_set_in_port(&match, tun->ofport);
-            ofpbuf_clear(&ofpacts);
-
-            /* Add flows for ramp switches.  The VNI is used to populate
-             * MFF_LOG_DATAPATH.  The gateway's logical port is set to
-             * MFF_LOG_INPORT.  Then the packet is resubmitted to table 8
-             * to determine the logical egress port. */
-            match_set_tun_id(&match, htonll(binding->datapath->tunnel_key));
-
-            put_move(MFF_TUN_ID, 0,  MFF_LOG_DATAPATH, 0, 24, &ofpacts);
-            put_load(binding->tunnel_key, MFF_LOG_INPORT, 0, 15, &ofpacts);
-            /* For packets received from a ramp tunnel, set a flag to that
-             * effect. */
-            put_load(1, MFF_LOG_FLAGS, MLF_RCV_FROM_RAMP_BIT, 1, &ofpacts);
-            put_resubmit(OFTABLE_LOG_INGRESS_PIPELINE, &ofpacts);
-
-            ofctrl_add_flow(flow_table, OFTABLE_PHY_TO_LOG, 110,
-                            binding->header_.uuid.parts[0],
-                            &match, &ofpacts, hc_uuid);
-        }
+        put_tunnel_flows(p_ctx, tun, &ofpacts, flow_table);
     }
 
     /* Table 32, priority 150.
@@ -1867,8 +2194,6 @@ physical_run(struct physical_ctx *p_ctx,
                     &ofpacts, hc_uuid);
 
     ofpbuf_uninit(&ofpacts);
-
-    simap_destroy(&new_tunnel_to_ofport);
 }
 
 bool
@@ -1876,18 +2201,40 @@ physical_handle_ovs_iface_changes(struct physical_ctx *p_ctx,
                                   struct ovn_desired_flow_table *flow_table)
 {
     const struct ovsrec_interface *iface_rec;
+    bool tunnels_changed = false;
     OVSREC_INTERFACE_TABLE_FOR_EACH_TRACKED (iface_rec, p_ctx->iface_table) {
+        if (!strcmp(iface_rec->type, "patch")) {
+            return false;
+        }
         if (!strcmp(iface_rec->type, "geneve") ||
-            !strcmp(iface_rec->type, "patch") ||
             !strcmp(iface_rec->type, "vxlan") ||
             !strcmp(iface_rec->type, "stt")) {
-            return false;
+            tunnels_changed = true;
         }
     }
 
     struct ofpbuf ofpacts;
     ofpbuf_init(&ofpacts, 0);
 
+    if (tunnels_changed) {
+        struct sset changed_chassis = SSET_INITIALIZER(&changed_chassis);
+        struct hmapx changed_tunnels = HMAPX_INITIALIZER(&changed_tunnels);
+
+        if (update_tunnels(p_ctx, flow_table, &changed_chassis,
+                           &changed_tunnels)) {
+            struct hmapx_node *node;
+            HMAPX_FOR_EACH (node, &changed_tunnels) {
+                put_tunnel_flows(p_ctx, node->data, &ofpacts, flow_table);
+            }
+            physical_reconsider_chassis(p_ctx, &changed_chassis, flow_table);
+
+            /* Reprocess logical flow table immediately. */
+            poll_immediate_wake();
+        }
+        hmapx_destroy(&changed_tunnels);
+        sset_destroy(&changed_chassis);
+    }
+
     OVSREC_INTERFACE_TABLE_FOR_EACH_TRACKED (iface_rec, p_ctx->iface_table) {
         const char *iface_id = smap_get(&iface_rec->external_ids, "iface-id");
         if (!iface_id) {
@@ -1946,11 +2293,68 @@ get_tunnel_ofport(const char *chassis_name, char *encap_ip, ofp_port_t *ofport)
     return true;
 }
 
+/* Handles the changes to the SB Chassis table.  Returns false if the physical
+ * flows must be recomputed. */
+bool
+physical_handle_sb_chassis_changes(struct physical_ctx *p_ctx,
+                                   struct ovn_desired_flow_table *flow_table)
+{
+    struct sset changed_chassis = SSET_INITIALIZER(&changed_chassis);
+    const struct sbrec_chassis *chassis;
+    SBREC_CHASSIS_TABLE_FOR_EACH_TRACKED (chassis, p_ctx->chassis_table) {
+        if (chassis == p_ctx->chassis
+            || !strcmp(chassis->name, p_ctx->chassis->name)) {
+            sset_destroy(&changed_chassis);
+            return false;
+        }
+        sset_add(&changed_chassis, chassis->name);
+    }
+
+    /* The MACs of the remote chassis are derived from all of them. */
+    struct ofpbuf ofpacts;
+    ofpbuf_init(&ofpacts, 0);
+    ofctrl_remove_flows(flow_table, &chassis_mac_uuid);
+    put_chassis_mac_conj_id_flow(p_ctx->chassis_table, p_ctx->chassis,
+                                 &ofpacts, flow_table);
+    ofpbuf_uninit(&ofpacts);
+
+    physical_reconsider_chassis(p_ctx, &changed_chassis, flow_table);
+    sset_destroy(&changed_chassis);
+    return true;
+}
+
+/* Handles the changes to the SB Encap table.  Returns false if the physical
+ * flows must be recomputed. */
+bool
+physical_handle_sb_encap_changes(struct physical_ctx *p_ctx,
+                                 struct ovn_desired_flow_table *flow_table)
+{
+    struct sset changed_chassis = SSET_INITIALIZER(&changed_chassis);
+    const struct sbrec_encap *encap;
+    SBREC_ENCAP_TABLE_FOR_EACH_TRACKED (encap, p_ctx->encap_table) {
+        if (!strcmp(encap->chassis_name, p_ctx->chassis->name)) {
+            sset_destroy(&changed_chassis);
+            return false;
+        }
+        sset_add(&changed_chassis, encap->chassis_name);
+    }
+
+    physical_reconsider_chassis(p_ctx, &changed_chassis, flow_table);
+    sset_destroy(&changed_chassis);
+    return true;
+}
+
 void
 physical_clear_unassoc_flows_with_db(struct ovn_desired_flow_table *flow_table)
 {
     if (hc_uuid) {
         ofctrl_remove_flows(flow_table, hc_uuid);
+        ofctrl_remove_flows(flow_table, &chassis_mac_uuid);
+    }
+
+    struct chassis_tunnel *tun;
+    HMAP_FOR_EACH (tun, hmap_node, &tunnels) {
+        ofctrl_remove_flows(flow_table, &tun->flow_uuid);
     }
 }
 
@@ -1959,16 +2363,23 @@ physical_clear_dp_flows(struct physical_ctx *p_ctx,
                         struct hmapx *ct_updated_datapaths,
                         struct ovn_desired_flow_table *flow_table)
 {
-    const struct sbrec_port_binding *binding;
-    SBREC_PORT_BINDING_TABLE_FOR_EACH (binding, p_ctx->port_binding_table) {
-        if (!hmapx_find(ct_updated_datapaths, binding->datapath)) {
-            continue;
-        }
-        const struct sbrec_port_binding *peer =
-            get_binding_peer(p_ctx->sbrec_port_binding_by_name, binding);
-        ofctrl_remove_flows(flow_table, &binding->header_.uuid);
-        if (peer) {
-            ofctrl_remove_flows(flow_table, &peer->header_.uuid);
+    struct ovsdb_idl_index *pb_by_dp = p_ctx->sbrec_port_binding_by_datapath;
+    struct sbrec_port_binding *target
+        = sbrec_port_binding_index_init_row(pb_by_dp);
+
+    struct hmapx_node *node;
+    HMAPX_FOR_EACH (node, ct_updated_datapaths) {
+        sbrec_port_binding_index_set_datapath(target, node->data);
+
+        const struct sbrec_port_binding *binding;
+        SBREC_PORT_BINDING_FOR_EACH_EQUAL (binding, target, pb_by_dp) {
+            const struct sbrec_port_binding *peer =
+                get_binding_peer(p_ctx->sbrec_port_binding_by_name, binding);
+            ofctrl_remove_flows(flow_table, &binding->header_.uuid);
+            if (peer) {
+                ofctrl_remove_flows(flow_table, &peer->header_.uuid);
+            }
         }
     }
+    sbrec_port_binding_index_destroy_row(target);
 }
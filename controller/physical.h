@@ -28,9 +28,11 @@
 #include "openvswitch/meta-flow.h"
 
 struct hmap;
+struct ovn_extend_table;
 struct ovsdb_idl_index;
 struct ovsrec_bridge;
 struct simap;
+struct sbrec_encap_table;
 struct sbrec_multicast_group_table;
 struct sbrec_port_binding_table;
 struct sset;
@@ -44,10 +46,13 @@ struct sset;
 
 struct physical_ctx {
     struct ovsdb_idl_index *sbrec_port_binding_by_name;
+    struct ovsdb_idl_index *sbrec_port_binding_by_datapath;
+    struct ovsdb_idl_index *sbrec_port_binding_by_type;
     const struct sbrec_port_binding_table *port_binding_table;
     const struct sbrec_multicast_group_table *mc_group_table;
     const struct ovsrec_bridge *br_int;
     const struct sbrec_chassis_table *chassis_table;
+    const struct sbrec_encap_table *encap_table;
     const struct sbrec_chassis *chassis;
     const struct ovsrec_interface_table *iface_table;
     const struct sset *active_tunnels;
@@ -57,9 +62,16 @@ struct physical_ctx {
     enum mf_field_id mff_ovn_geneve;
     struct shash *local_bindings;
     struct hmapx *ct_updated_datapaths;
+
+    /* Groups of the physical flows. */
+    struct ovn_extend_table *group_table;
+    /* Use an OpenFlow group of type "all" for the output to the local ports
+     * of the multicast groups. */
+    bool mc_flood_groups;
 };
 
 void physical_register_ovs_idl(struct ovsdb_idl *);
+void physical_get_memory_usage(struct simap *usage);
 void physical_run(struct physical_ctx *,
                   struct ovn_desired_flow_table *);
 void physical_clear_unassoc_flows_with_db(struct ovn_desired_flow_table *);
@@ -72,6 +84,10 @@ void physical_handle_mc_group_changes(struct physical_ctx *,
                                       struct ovn_desired_flow_table *);
 bool physical_handle_ovs_iface_changes(struct physical_ctx *,
                                        struct ovn_desired_flow_table *);
+bool physical_handle_sb_chassis_changes(struct physical_ctx *,
+                                        struct ovn_desired_flow_table *);
+bool physical_handle_sb_encap_changes(struct physical_ctx *,
+                                      struct ovn_desired_flow_table *);
 bool get_tunnel_ofport(const char *chassis_name, char *encap_ip,
                        ofp_port_t *ofport);
 #endif /* controller/physical.h */
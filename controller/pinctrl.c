@@ -25,6 +25,7 @@
 #include "encaps.h"
 #include "flow.h"
 #include "ha-chassis.h"
+#include "hash.h"
 #include "lport.h"
 #include "mac-learn.h"
 #include "nx-match.h"
@@ -42,6 +43,7 @@
 #include "lib/crc32c.h"
 
 #include "lib/dhcp.h"
+#include "lib/hmapx.h"
 #include "ovn-controller.h"
 #include "ovn/actions.h"
 #include "ovn/lex.h"
@@ -53,8 +55,13 @@
 #include "ovn/logical-fields.h"
 #include "openvswitch/poll-loop.h"
 #include "openvswitch/rconn.h"
+#include "openvswitch/token-bucket.h"
+#include "ovs-rcu.h"
+#include "ovs-thread.h"
 #include "socket-util.h"
 #include "seq.h"
+#include "simap.h"
+#include "timer-wheel.h"
 #include "timeval.h"
 #include "vswitch-idl.h"
 #include "lflow.h"
@@ -78,11 +85,13 @@ VLOG_DEFINE_THIS_MODULE(pinctrl);
  *
  *   - dns_lookup -     In order to do a DNS lookup, this action needs
  *                      to access the 'DNS' table. pinctrl_run() builds a
- *                      local DNS cache - 'dns_cache'. See sync_dns_cache()
- *                      for more details.
+ *                      local DNS cache - 'dns_cache' - and publishes an
+ *                      immutable copy of it, 'dns_cache_snapshot', through
+ *                      RCU. See sync_dns_cache() for more details.
  *                      The function 'pinctrl_handle_dns_lookup()' (which is
  *                      called with in the pinctrl_handler thread) looks into
- *                      the local DNS cache to resolve the DNS requests.
+ *                      the snapshot to resolve the DNS requests, without
+ *                      taking 'pinctrl_mutex'.
  *
  *   - put_arp/put_nd - These actions stores the IPv4/IPv6 and MAC addresses
  *                      in the 'MAC_Binding' table.
@@ -94,6 +103,12 @@ VLOG_DEFINE_THIS_MODULE(pinctrl);
  *                      pinctrl_run(), reads these mac bindings from the hmap
  *                      'put_mac_bindings' and writes to the 'MAC_Binding'
  *                      table in the Southbound DB.
+ *                      'put_mac_bindings', like 'put_vport_bindings' and
+ *                      'put_fdbs', is protected by 'pinctrl_put_mutex'
+ *                      rather than 'pinctrl_mutex' and is swapped out by
+ *                      pinctrl_run() before the database is updated, so
+ *                      that the pinctrl_handler thread never waits for
+ *                      the database updates.
  *
  *   - arp/nd_ns      - These actions generate an ARP/IPv6 Neighbor solicit
  *                      requests. The original packets are buffered and
@@ -114,6 +129,13 @@ VLOG_DEFINE_THIS_MODULE(pinctrl);
  *                      which maintains multicast group information. The
  *                      multicast groups (mcast_snoop_map) are synced to
  *                      the 'IGMP_Group' table by ip_mcast_sync().
+ *                      pinctrl_handler() records the groups that the
+ *                      IGMP/MLD packets change in the 'dirty_groups' of
+ *                      their datapath, and marks a datapath 'sync_all'
+ *                      when its groups expire or its configuration
+ *                      changes, so that ip_mcast_sync() only writes the
+ *                      groups that changed, at most IP_MCAST_SYNC_BATCH
+ *                      per transaction.
  *                      ip_mcast_sync() also reads the 'IP_Multicast'
  *                      (snooping and querier) configuration and builds a
  *                      local configuration mcast_cfg_map.
@@ -140,10 +162,20 @@ VLOG_DEFINE_THIS_MODULE(pinctrl);
  *
  * IGMP Queries     - pinctrl_run() prepares the IGMP queries (at most one
  *                    per local datapath) based on the mcast_snoop_map
- *                    contents and stores them in mcast_query_list.
+ *                    contents and schedules a query timer for each of them.
  *
  *                    pinctrl_handler thread sends the periodic IGMP queries
- *                    by walking the mcast_query_list.
+ *                    when their timers expire.
+ *
+ * Timers           - The periodic work of the pinctrl_handler thread, i.e.,
+ *                    gARPs/rARPs, IGMP queries and service monitor
+ *                    health checks, is driven by 'pinctrl_timers', a timer
+ *                    wheel shared by all of them, so that each iteration
+ *                    only handles the timers that expired and computes the
+ *                    next wakeup in constant time.  The packet-outs they
+ *                    send are encoded once in a 'struct
+ *                    pinctrl_po_template' and are sent after pinctrl_mutex
+ *                    is released.
  *
  * Notification between pinctrl_handler() and pinctrl_run()
  * -------------------------------------------------------
@@ -157,9 +189,35 @@ VLOG_DEFINE_THIS_MODULE(pinctrl);
  *  'pinctrl_main_seq' is used by pinctrl_handler() thread to wake up
  *  the main thread from poll_block() when mac bindings/igmp groups need to
  *  be updated in the Southboubd DB.
+ *
+ * Packet-in processing
+ * --------------------
+ * pinctrl_handler() queues the packet-ins it receives per class (see
+ * enum pinctrl_pin_class) and serves the classes in order, so that a burst
+ * of, e.g., DHCP requests doesn't delay the BFD and service monitor
+ * packets.  The packets that are answered from their own contents only are
+ * processed by a pool of 'n_workers' pinctrl_worker() threads, if
+ * configured, or by pinctrl_handler() itself, a batch per iteration.
+ *
+ * BFD
+ * ---
+ * The BFD sessions have their own mutex, 'bfd_mutex', and timer wheel,
+ * 'bfd_timers', so that their control packets are not delayed by the main
+ * thread holding pinctrl_mutex.  They are served by pinctrl_handler() or,
+ * if "ovn-bfd-thread" is enabled, by a pinctrl_bfd_handler() thread with its
+ * own OpenFlow connection, to which the switch sends the packet-ins of the
+ * bfd_msg action thanks to PINCTRL_BFD_CONTROLLER_ID.  The detection
+ * timeouts then hold even when pinctrl_handler() is busy.
  * */
 
 static struct ovs_mutex pinctrl_mutex = OVS_MUTEX_INITIALIZER;
+/* Protects the updates queued by the pinctrl_handler thread for the main
+ * thread to write to the Southbound DB: 'put_mac_bindings',
+ * 'put_vport_bindings' and 'put_fdbs'. */
+static struct ovs_mutex pinctrl_put_mutex = OVS_MUTEX_INITIALIZER;
+/* Protects the BFD sessions, see "BFD" above.  When both are taken,
+ * pinctrl_mutex is taken first. */
+static struct ovs_mutex bfd_mutex = OVS_MUTEX_INITIALIZER;
 static struct seq *pinctrl_handler_seq;
 static struct seq *pinctrl_main_seq;
 
@@ -167,6 +225,8 @@ static void *pinctrl_handler(void *arg);
 
 struct pinctrl {
     char *br_int_name;
+    size_t n_workers;
+    bool bfd_thread;
     pthread_t pinctrl_thread;
     /* Latch to destroy the 'pinctrl_thread' */
     struct latch pinctrl_thread_exit;
@@ -176,6 +236,7 @@ static struct pinctrl pinctrl;
 
 static void init_buffered_packets_map(void);
 static void destroy_buffered_packets_map(void);
+static void dns_cache_publish(void);
 static void
 run_buffered_binding(struct ovsdb_idl_index *sbrec_mac_binding_by_lport_ip,
                      const struct hmap *local_datapaths)
@@ -184,7 +245,7 @@ run_buffered_binding(struct ovsdb_idl_index *sbrec_mac_binding_by_lport_ip,
 static void pinctrl_handle_put_mac_binding(const struct flow *md,
                                            const struct flow *headers,
                                            bool is_arp)
-    OVS_REQUIRES(pinctrl_mutex);
+    OVS_REQUIRES(pinctrl_put_mutex);
 static void init_put_mac_bindings(void);
 static void destroy_put_mac_bindings(void);
 static void run_put_mac_bindings(
@@ -192,14 +253,13 @@ static void run_put_mac_bindings(
     struct ovsdb_idl_index *sbrec_datapath_binding_by_key,
     struct ovsdb_idl_index *sbrec_port_binding_by_key,
     struct ovsdb_idl_index *sbrec_mac_binding_by_lport_ip)
-    OVS_REQUIRES(pinctrl_mutex);
+    OVS_EXCLUDED(pinctrl_put_mutex);
 static void wait_put_mac_bindings(struct ovsdb_idl_txn *ovnsb_idl_txn);
 static void send_mac_binding_buffered_pkts(struct rconn *swconn)
     OVS_REQUIRES(pinctrl_mutex);
 
 static void init_send_garps_rarps(void);
 static void destroy_send_garps_rarps(void);
-static void send_garp_rarp_wait(long long int send_garp_rarp_time);
 static void send_garp_rarp_prepare(
     struct ovsdb_idl_txn *ovnsb_idl_txn,
     struct ovsdb_idl_index *sbrec_port_binding_by_datapath,
@@ -210,9 +270,6 @@ static void send_garp_rarp_prepare(
     const struct hmap *local_datapaths,
     const struct sset *active_tunnels)
     OVS_REQUIRES(pinctrl_mutex);
-static void send_garp_rarp_run(struct rconn *swconn,
-                               long long int *send_garp_rarp_time)
-    OVS_REQUIRES(pinctrl_mutex);
 static void pinctrl_handle_nd_na(struct rconn *swconn,
                                  const struct flow *ip_flow,
                                  const struct match *md,
@@ -253,9 +310,7 @@ static void ip_mcast_snoop_init(void);
 static void ip_mcast_snoop_destroy(void);
 static void ip_mcast_snoop_run(void)
     OVS_REQUIRES(pinctrl_mutex);
-static void ip_mcast_querier_run(struct rconn *swconn,
-                                 long long int *query_time);
-static void ip_mcast_querier_wait(long long int query_time);
+static void wait_ip_mcast_sync(struct ovsdb_idl_txn *ovnsb_idl_txn);
 static void ip_mcast_sync(
     struct ovsdb_idl_txn *ovnsb_idl_txn,
     const struct sbrec_chassis *chassis,
@@ -283,14 +338,16 @@ static void run_put_vport_bindings(
     struct ovsdb_idl_index *sbrec_datapath_binding_by_key,
     struct ovsdb_idl_index *sbrec_port_binding_by_key,
     const struct sbrec_chassis *chassis)
-    OVS_REQUIRES(pinctrl_mutex);
+    OVS_EXCLUDED(pinctrl_put_mutex);
 static void wait_put_vport_bindings(struct ovsdb_idl_txn *ovnsb_idl_txn);
 static void pinctrl_handle_bind_vport(const struct flow *md,
-                                      struct ofpbuf *userdata);
+                                      struct ofpbuf *userdata)
+    OVS_REQUIRES(pinctrl_put_mutex);
 static void pinctrl_handle_svc_check(struct rconn *swconn,
                                      const struct flow *ip_flow,
                                      struct dp_packet *pkt_in,
-                                     const struct match *md);
+                                     const struct match *md)
+    OVS_REQUIRES(pinctrl_mutex);
 static void init_svc_monitors(void);
 static void destroy_svc_monitors(void);
 static void sync_svc_monitors(
@@ -299,10 +356,6 @@ static void sync_svc_monitors(
     struct ovsdb_idl_index *sbrec_port_binding_by_name,
     const struct sbrec_chassis *our_chassis)
     OVS_REQUIRES(pinctrl_mutex);
-static void svc_monitors_run(struct rconn *swconn,
-                             long long int *svc_monitors_next_run_time)
-    OVS_REQUIRES(pinctrl_mutex);
-static void svc_monitors_wait(long long int svc_monitors_next_run_time);
 
 static void pinctrl_compose_ipv4(struct dp_packet *packet,
                                  struct eth_addr eth_src,
@@ -324,16 +377,14 @@ put_load(uint64_t value, enum mf_field_id dst, int ofs, int n_bits,
 static void notify_pinctrl_main(void);
 static void notify_pinctrl_handler(void);
 
-static bool bfd_monitor_should_inject(void);
-static void bfd_monitor_wait(long long int timeout);
 static void bfd_monitor_init(void);
 static void bfd_monitor_destroy(void);
-static void bfd_monitor_send_msg(struct rconn *swconn, long long int *bfd_time)
-                                 OVS_REQUIRES(pinctrl_mutex);
 static void
 pinctrl_handle_bfd_msg(struct rconn *swconn, const struct flow *ip_flow,
                        struct dp_packet *pkt_in)
-                       OVS_REQUIRES(pinctrl_mutex);
+                       OVS_REQUIRES(bfd_mutex);
+static void bfd_timers_run(struct rconn *, struct ovs_list *txq)
+    OVS_REQUIRES(bfd_mutex);
 static void bfd_monitor_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
                             const struct sbrec_bfd_table *bfd_table,
                             struct ovsdb_idl_index *sbrec_port_binding_by_name,
@@ -347,20 +398,85 @@ static const struct sbrec_fdb *fdb_lookup(
     uint32_t dp_key, const char *mac);
 static void run_put_fdb(struct ovsdb_idl_txn *ovnsb_idl_txn,
                         struct ovsdb_idl_index *sbrec_fdb_by_dp_key_mac,
-                        const struct fdb_entry *fdb_e)
-                        OVS_REQUIRES(pinctrl_mutex);
+                        const struct fdb_entry *fdb_e);
 static void run_put_fdbs(struct ovsdb_idl_txn *ovnsb_idl_txn,
                         struct ovsdb_idl_index *sbrec_fdb_by_dp_key_mac)
-                        OVS_REQUIRES(pinctrl_mutex);
+                        OVS_EXCLUDED(pinctrl_put_mutex);
 static void wait_put_fdbs(struct ovsdb_idl_txn *ovnsb_idl_txn);
 static void pinctrl_handle_put_fdb(const struct flow *md,
                                    const struct flow *headers)
-                                   OVS_REQUIRES(pinctrl_mutex);
+                                   OVS_REQUIRES(pinctrl_put_mutex);
+
+/* The kinds of timers in 'pinctrl_timers'. */
+enum pinctrl_timer_type {
+    PINCTRL_TIMER_GARP_RARP,    /* In struct garp_rarp_data. */
+    PINCTRL_TIMER_MCAST_QUERY,  /* In struct ip_mcast_snoop. */
+    PINCTRL_TIMER_SVC_MONITOR,  /* In struct svc_monitor. */
+};
+
+struct pinctrl_timer {
+    struct timer_wheel_node node;
+    enum pinctrl_timer_type type;
+};
+
+/* Timers of the periodic work of the pinctrl_handler thread.  Protected by
+ * pinctrl_mutex, since the main thread adds and removes the entries that
+ * own them. */
+static struct timer_wheel pinctrl_timers OVS_GUARDED_BY(pinctrl_mutex);
+
+/* Timers of the BFD sessions, in "struct bfd_entry"s. */
+static struct timer_wheel bfd_timers OVS_GUARDED_BY(bfd_mutex);
+
+static void send_garp_rarp_expired(struct rconn *, struct ovs_list *txq,
+                                   struct pinctrl_timer *, long long int now)
+    OVS_REQUIRES(pinctrl_mutex);
+static void ip_mcast_querier_expired(struct rconn *, struct ovs_list *txq,
+                                     struct pinctrl_timer *, long long int now)
+    OVS_REQUIRES(pinctrl_mutex);
+static void svc_monitor_expired(struct rconn *, struct ovs_list *txq,
+                                struct pinctrl_timer *, long long int now)
+    OVS_REQUIRES(pinctrl_mutex);
+
+static void
+pinctrl_timer_init(struct pinctrl_timer *timer, enum pinctrl_timer_type type)
+{
+    timer_wheel_node_init(&timer->node);
+    timer->type = type;
+}
+
+static void
+pinctrl_timer_cancel(struct pinctrl_timer *timer)
+    OVS_REQUIRES(pinctrl_mutex)
+{
+    timer_wheel_cancel(&pinctrl_timers, &timer->node);
+}
+
+/* Schedules 'timer' to expire at 'expires', or cancels it if 'expires' is
+ * LLONG_MAX. */
+static void
+pinctrl_timer_schedule(struct pinctrl_timer *timer, long long int expires)
+    OVS_REQUIRES(pinctrl_mutex)
+{
+    if (expires == LLONG_MAX) {
+        pinctrl_timer_cancel(timer);
+    } else {
+        timer_wheel_schedule(&pinctrl_timers, &timer->node, expires);
+    }
+}
 
-COVERAGE_DEFINE(pinctrl_drop_put_mac_binding);
+COVERAGE_DEFINE(pinctrl_drop_put_mac_binding_rate);
 COVERAGE_DEFINE(pinctrl_drop_buffered_packets_map);
+COVERAGE_DEFINE(pinctrl_drop_buffered_packets_depth);
+COVERAGE_DEFINE(pinctrl_drop_buffered_packets_mem);
+COVERAGE_DEFINE(pinctrl_drop_buffered_packets_timeout);
 COVERAGE_DEFINE(pinctrl_drop_controller_event);
 COVERAGE_DEFINE(pinctrl_drop_put_vport_binding);
+COVERAGE_DEFINE(pinctrl_drop_packet_in);
+COVERAGE_DEFINE(pinctrl_drop_packet_in_rate);
+COVERAGE_DEFINE(pinctrl_ip_mcast_group_create);
+COVERAGE_DEFINE(pinctrl_ip_mcast_group_delete);
+COVERAGE_DEFINE(pinctrl_ip_mcast_group_sync);
+COVERAGE_DEFINE(pinctrl_ip_mcast_full_sync);
 
 struct empty_lb_backends_event {
     struct hmap_node hmap_node;
@@ -512,6 +628,9 @@ out:
 void
 pinctrl_init(void)
 {
+    ovs_mutex_lock(&pinctrl_mutex);
+    timer_wheel_init(&pinctrl_timers, time_msec());
+    ovs_mutex_unlock(&pinctrl_mutex);
     init_put_mac_bindings();
     init_send_garps_rarps();
     init_ipv6_ras();
@@ -523,7 +642,10 @@ pinctrl_init(void)
     init_svc_monitors();
     bfd_monitor_init();
     init_fdb_entries();
+    dns_cache_publish();
     pinctrl.br_int_name = NULL;
+    pinctrl.n_workers = 0;
+    pinctrl.bfd_thread = false;
     pinctrl_handler_seq = seq_create();
     pinctrl_main_seq = seq_create();
 
@@ -605,6 +727,115 @@ set_actions_and_enqueue_msg(struct rconn *swconn,
     ofpbuf_uninit(&ofpacts);
 }
 
+/* Packet-outs that pinctrl sends periodically, e.g. GARPs, BFD control
+ * packets and service monitor probes, have the same actions and mostly the
+ * same packet every time.  A "struct pinctrl_po_template" keeps such a
+ * packet-out encoded, so that sending it only takes a copy of the message
+ * and an update of the fields of its packet that differ.
+ *
+ * The packet is at the end of an encoded packet-out whatever the OpenFlow
+ * version.  The copies keep the xid of the template, which doesn't matter
+ * since packet-outs have no reply. */
+struct pinctrl_po_template {
+    struct ofpbuf *msg;         /* Encoded packet-out, NULL if not built. */
+    int version;                /* OpenFlow version of 'msg'. */
+    size_t packet_len;          /* Length of the packet at the end of 'msg'. */
+    size_t l3_ofs;              /* Offset of the L3 header in the packet. */
+    size_t l4_ofs;              /* Offset of the L4 header in the packet. */
+};
+
+static void
+pinctrl_po_template_init(struct pinctrl_po_template *t)
+{
+    t->msg = NULL;
+    t->version = -1;
+    t->packet_len = 0;
+    t->l3_ofs = 0;
+    t->l4_ofs = 0;
+}
+
+/* Invalidates 't', so that it is built again on next use. */
+static void
+pinctrl_po_template_clear(struct pinctrl_po_template *t)
+{
+    ofpbuf_delete(t->msg);
+    t->msg = NULL;
+}
+
+static bool
+pinctrl_po_template_is_valid(const struct pinctrl_po_template *t,
+                             struct rconn *swconn)
+{
+    return t->msg && t->version == rconn_get_version(swconn);
+}
+
+/* Builds 't' from 'packet' and 'ofpacts', for the OpenFlow version of
+ * 'swconn'. */
+static void
+pinctrl_po_template_set(struct pinctrl_po_template *t, struct rconn *swconn,
+                        const struct dp_packet *packet,
+                        const struct ofpbuf *ofpacts)
+{
+    enum ofp_version version = rconn_get_version(swconn);
+    struct ofputil_packet_out po = {
+        .packet = dp_packet_data(packet),
+        .packet_len = dp_packet_size(packet),
+        .buffer_id = UINT32_MAX,
+        .ofpacts = ofpacts->data,
+        .ofpacts_len = ofpacts->size,
+    };
+    match_set_in_port(&po.flow_metadata, OFPP_CONTROLLER);
+    enum ofputil_protocol proto = ofputil_protocol_from_ofp_version(version);
+
+    pinctrl_po_template_clear(t);
+    t->msg = ofputil_encode_packet_out(&po, proto);
+    t->version = version;
+    t->packet_len = dp_packet_size(packet);
+    t->l3_ofs = dp_packet_l3(packet)
+                ? (char *) dp_packet_l3(packet) - (char *) po.packet : 0;
+    t->l4_ofs = dp_packet_l4(packet)
+                ? (char *) dp_packet_l4(packet) - (char *) po.packet : 0;
+}
+
+/* Returns a copy of the packet-out of 't', which must be valid.  If 'packet'
+ * is nonnull, stores in '*packet' the start of the packet of the copy, that
+ * the caller may update before sending it. */
+static struct ofpbuf *
+pinctrl_po_template_clone(const struct pinctrl_po_template *t,
+                          uint8_t **packet)
+{
+    struct ofpbuf *msg = ofpbuf_clone(t->msg);
+
+    if (packet) {
+        *packet = (uint8_t *) msg->data + msg->size - t->packet_len;
+    }
+    return msg;
+}
+
+/* Sends 'msg' to the switch, or, if 'txq' is nonnull, appends it to 'txq'
+ * to be sent later by pinctrl_txq_flush().  This allows to compose the
+ * packet-outs with pinctrl_mutex held and to send them once it is
+ * released. */
+static void
+pinctrl_send_msg(struct rconn *swconn, struct ovs_list *txq,
+                 struct ofpbuf *msg)
+{
+    if (txq) {
+        ovs_list_push_back(txq, &msg->list_node);
+    } else {
+        queue_msg(swconn, msg);
+    }
+}
+
+static void
+pinctrl_txq_flush(struct rconn *swconn, struct ovs_list *txq)
+{
+    struct ofpbuf *msg;
+    LIST_FOR_EACH_POP (msg, list_node, txq) {
+        queue_msg(swconn, msg);
+    }
+}
+
 static struct shash ipv6_prefixd;
 
 enum {
@@ -1344,15 +1575,27 @@ prepare_ipv6_prefixd(struct ovsdb_idl_txn *ovnsb_idl_txn,
 }
 
 struct buffer_info {
+    struct ovs_list list_node;  /* In struct buffered_packets's 'queue'. */
     struct ofpbuf ofpacts;
     ofp_port_t ofp_port;
     struct dp_packet *p;
+    size_t n_bytes;             /* Memory used by this packet. */
 };
 
-#define BUFFER_QUEUE_DEPTH     4
+/* Default limits of the packets buffered while the next hop is resolved, per
+ * destination and for all destinations, see
+ * pinctrl_set_buffered_packets_limits(). */
+#define BUFFER_QUEUE_DEPTH_DEFAULT      64
+#define BUFFER_MAX_BYTES_DEFAULT        (16 * 1024 * 1024)
+
+/* Maximum number of destinations for which packets are buffered. */
+#define BUFFER_MAP_MAX_DESTINATIONS     1000
+
 struct buffered_packets {
     struct hmap_node hmap_node;
     struct ovs_list list;
+    /* In 'buffered_packets_lru' while in 'buffered_packets_map'. */
+    struct ovs_list lru_node;
 
     /* key */
     struct in6_addr ip;
@@ -1360,41 +1603,73 @@ struct buffered_packets {
 
     long long int timestamp;
 
-    struct buffer_info data[BUFFER_QUEUE_DEPTH];
-    uint32_t head, tail;
+    struct ovs_list queue;      /* Contains "struct buffer_info"s, oldest
+                                 * first. */
+    size_t n_packets;
+    size_t n_bytes;
 };
 
 static struct hmap buffered_packets_map;
 static struct ovs_list buffered_mac_bindings;
 
+/* The destinations in 'buffered_packets_map', least recently buffered to
+ * first. */
+static struct ovs_list buffered_packets_lru;
+
+/* Limits and totals over all the buffered packets, including those in
+ * 'buffered_mac_bindings'.  Protected by pinctrl_mutex. */
+static size_t buffered_packets_depth = BUFFER_QUEUE_DEPTH_DEFAULT;
+static size_t buffered_packets_max_bytes = BUFFER_MAX_BYTES_DEFAULT;
+static size_t buffered_packets_n_packets;
+static size_t buffered_packets_n_bytes;
+
 static void
 init_buffered_packets_map(void)
 {
     hmap_init(&buffered_packets_map);
     ovs_list_init(&buffered_mac_bindings);
+    ovs_list_init(&buffered_packets_lru);
 }
 
 static void
-destroy_buffered_packets(struct buffered_packets *bp)
+buffer_info_destroy(struct buffered_packets *bp, struct buffer_info *bi)
 {
-    struct buffer_info *bi;
+    ovs_list_remove(&bi->list_node);
+    bp->n_packets--;
+    bp->n_bytes -= bi->n_bytes;
+    buffered_packets_n_packets--;
+    buffered_packets_n_bytes -= bi->n_bytes;
 
-    while (bp->head != bp->tail) {
-        bi = &bp->data[bp->head];
-        dp_packet_delete(bi->p);
-        ofpbuf_uninit(&bi->ofpacts);
+    dp_packet_delete(bi->p);
+    ofpbuf_uninit(&bi->ofpacts);
+    free(bi);
+}
+
+static void
+destroy_buffered_packets(struct buffered_packets *bp)
+{
+    struct buffer_info *bi, *next;
 
-        bp->head = (bp->head + 1) % BUFFER_QUEUE_DEPTH;
+    LIST_FOR_EACH_SAFE (bi, next, list_node, &bp->queue) {
+        buffer_info_destroy(bp, bi);
     }
 }
 
+/* Removes 'bp' from 'buffered_packets_map'. */
+static void
+buffered_packets_remove(struct buffered_packets *bp)
+{
+    hmap_remove(&buffered_packets_map, &bp->hmap_node);
+    ovs_list_remove(&bp->lru_node);
+}
+
 static void
 destroy_buffered_packets_map(void)
 {
     struct buffered_packets *bp, *next;
     HMAP_FOR_EACH_SAFE (bp, next, hmap_node, &buffered_packets_map) {
         destroy_buffered_packets(bp);
-        hmap_remove(&buffered_packets_map, &bp->hmap_node);
+        buffered_packets_remove(bp);
         free(bp);
     }
     hmap_destroy(&buffered_packets_map);
@@ -1405,15 +1680,16 @@ destroy_buffered_packets_map(void)
     }
 }
 
+/* Queues 'packet' in 'bp', dropping the oldest packet of 'bp' if it is full.
+ * Drops 'packet' if it doesn't fit in the memory budget. */
 static void
 buffered_push_packet(struct buffered_packets *bp,
                      struct dp_packet *packet,
                      const struct match *md)
 {
-    uint32_t next = (bp->tail + 1) % BUFFER_QUEUE_DEPTH;
-    struct buffer_info *bi = &bp->data[bp->tail];
+    struct buffer_info *bi = xmalloc(sizeof *bi);
 
-    ofpbuf_init(&bi->ofpacts, 4096);
+    ofpbuf_init(&bi->ofpacts, 0);
 
     reload_metadata(&bi->ofpacts, md);
     /* reload pkt_mark field */
@@ -1428,14 +1704,29 @@ buffered_push_packet(struct buffered_packets *bp,
     resubmit->table_id = OFTABLE_REMOTE_OUTPUT;
 
     bi->p = packet;
-
-    if (next == bp->head) {
-        bi = &bp->data[bp->head];
+    bi->n_bytes = (sizeof *bi + bi->ofpacts.allocated
+                   + dp_packet_get_allocated(packet));
+
+    if (bp->n_packets >= buffered_packets_depth && bp->n_packets) {
+        COVERAGE_INC(pinctrl_drop_buffered_packets_depth);
+        buffer_info_destroy(bp, CONTAINER_OF(ovs_list_front(&bp->queue),
+                                             struct buffer_info, list_node));
+    }
+    if (!buffered_packets_depth
+        || buffered_packets_n_bytes + bi->n_bytes
+           > buffered_packets_max_bytes) {
+        COVERAGE_INC(pinctrl_drop_buffered_packets_mem);
         dp_packet_delete(bi->p);
         ofpbuf_uninit(&bi->ofpacts);
-        bp->head = (bp->head + 1) % BUFFER_QUEUE_DEPTH;
+        free(bi);
+        return;
     }
-    bp->tail = next;
+
+    ovs_list_push_back(&bp->queue, &bi->list_node);
+    bp->n_packets++;
+    bp->n_bytes += bi->n_bytes;
+    buffered_packets_n_packets++;
+    buffered_packets_n_bytes += bi->n_bytes;
 }
 
 static void
@@ -1444,9 +1735,9 @@ buffered_send_packets(struct rconn *swconn, struct buffered_packets *bp,
 {
     enum ofp_version version = rconn_get_version(swconn);
     enum ofputil_protocol proto = ofputil_protocol_from_ofp_version(version);
+    struct buffer_info *bi, *next;
 
-    while (bp->head != bp->tail) {
-        struct buffer_info *bi = &bp->data[bp->head];
+    LIST_FOR_EACH_SAFE (bi, next, list_node, &bp->queue) {
         struct eth_header *eth = dp_packet_data(bi->p);
 
         eth->eth_dst = *addr;
@@ -1460,13 +1751,13 @@ buffered_send_packets(struct rconn *swconn, struct buffered_packets *bp,
         match_set_in_port(&po.flow_metadata, bi->ofp_port);
         queue_msg(swconn, ofputil_encode_packet_out(&po, proto));
 
-        ofpbuf_uninit(&bi->ofpacts);
-        dp_packet_delete(bi->p);
-
-        bp->head = (bp->head + 1) % BUFFER_QUEUE_DEPTH;
+        buffer_info_destroy(bp, bi);
     }
 }
 
+/* Drops the packets buffered for the destinations for which no packet was
+ * buffered for BUFFER_MAP_TIMEOUT ms.  These are at the front of
+ * 'buffered_packets_lru', so this doesn't visit the other destinations. */
 #define BUFFER_MAP_TIMEOUT   10000
 static void
 buffered_packets_map_gc(void)
@@ -1474,12 +1765,15 @@ buffered_packets_map_gc(void)
     struct buffered_packets *cur_qp, *next_qp;
     long long int now = time_msec();
 
-    HMAP_FOR_EACH_SAFE (cur_qp, next_qp, hmap_node, &buffered_packets_map) {
-        if (now > cur_qp->timestamp + BUFFER_MAP_TIMEOUT) {
-            destroy_buffered_packets(cur_qp);
-            hmap_remove(&buffered_packets_map, &cur_qp->hmap_node);
-            free(cur_qp);
+    LIST_FOR_EACH_SAFE (cur_qp, next_qp, lru_node, &buffered_packets_lru) {
+        if (now <= cur_qp->timestamp + BUFFER_MAP_TIMEOUT) {
+            break;
         }
+        COVERAGE_ADD(pinctrl_drop_buffered_packets_timeout,
+                     cur_qp->n_packets);
+        destroy_buffered_packets(cur_qp);
+        buffered_packets_remove(cur_qp);
+        free(cur_qp);
     }
 }
 
@@ -1517,17 +1811,22 @@ pinctrl_handle_buffered_packets(struct dp_packet *pkt_in,
     uint32_t hash = hash_bytes(&addr, sizeof addr, 0);
     bp = pinctrl_find_buffered_packets(&addr, hash);
     if (!bp) {
-        if (hmap_count(&buffered_packets_map) >= 1000) {
+        if (hmap_count(&buffered_packets_map) >= BUFFER_MAP_MAX_DESTINATIONS) {
             COVERAGE_INC(pinctrl_drop_buffered_packets_map);
             return -ENOMEM;
         }
 
         bp = xmalloc(sizeof *bp);
         hmap_insert(&buffered_packets_map, &bp->hmap_node, hash);
-        bp->head = bp->tail = 0;
+        ovs_list_init(&bp->queue);
+        bp->n_packets = 0;
+        bp->n_bytes = 0;
         bp->ip = addr;
+    } else {
+        ovs_list_remove(&bp->lru_node);
     }
     bp->timestamp = time_msec();
+    ovs_list_push_back(&buffered_packets_lru, &bp->lru_node);
     /* clone the packet to send it later with correct L2 address */
     clone = dp_packet_clone_data(dp_packet_data(pkt_in),
                                  dp_packet_size(pkt_in));
@@ -2627,14 +2926,161 @@ struct dns_data {
     bool delete;
 };
 
+/* Only accessed by the main ovn-controller thread. */
 static struct shash dns_cache = SHASH_INITIALIZER(&dns_cache);
 
+/* Answers for a name on a datapath, pre-serialized from 'dns_cache'.  Each
+ * resource record of a reply is the query name, as found in the request,
+ * followed by a record tail (TYPE, CLASS, TTL, RDLENGTH and RDATA) taken
+ * from here. */
+struct dns_answer {
+    struct hmap_node hmap_node; /* In struct dns_cache_snapshot's 'answers'. */
+    uint64_t dp_key;
+    char *name;                 /* Lowercase, without the trailing '.'. */
+
+    struct ofpbuf a_rrs;        /* 'n_a_rrs' TYPE A record tails. */
+    size_t n_a_rrs;
+    struct ofpbuf aaaa_rrs;     /* 'n_aaaa_rrs' TYPE AAAA record tails. */
+    size_t n_aaaa_rrs;
+    struct ofpbuf ptr_rr;       /* TYPE PTR record tail. */
+};
+
+/* Sizes of the record tails for TYPE A and AAAA. */
+#define DNS_A_RR_TAIL_LEN (10 + sizeof(ovs_be32))
+#define DNS_AAAA_RR_TAIL_LEN (10 + sizeof(struct in6_addr))
+
+/* Immutable index of the answers in 'dns_cache' for the pinctrl_handler
+ * thread, rebuilt whenever 'dns_cache' changes. */
+struct dns_cache_snapshot {
+    struct hmap answers;        /* Contains "struct dns_answer"s. */
+};
+
+static OVSRCU_TYPE(struct dns_cache_snapshot *) dns_cache_snapshot;
+
+static void dns_put_a_rr_tail(struct ofpbuf *, ovs_be32 addr);
+static void dns_put_aaaa_rr_tail(struct ofpbuf *, const struct in6_addr *);
+static void dns_put_ptr_rr_tail(struct ofpbuf *, const char *answer_data);
+
+static void
+dns_data_destroy(struct dns_data *d)
+{
+    smap_destroy(&d->records);
+    free(d->dps);
+    free(d);
+}
+
+static uint32_t
+dns_answer_hash(uint64_t dp_key, const char *name)
+{
+    return hash_string(name, hash_uint64(dp_key));
+}
+
+static const struct dns_answer *
+dns_answer_find(const struct dns_cache_snapshot *snap, uint64_t dp_key,
+                const char *name)
+{
+    const struct dns_answer *answer;
+
+    HMAP_FOR_EACH_WITH_HASH (answer, hmap_node, dns_answer_hash(dp_key, name),
+                             &snap->answers) {
+        if (answer->dp_key == dp_key && !strcmp(answer->name, name)) {
+            return answer;
+        }
+    }
+    return NULL;
+}
+
+static void
+dns_answer_add(struct dns_cache_snapshot *snap, uint64_t dp_key,
+               const char *name, const char *answer_data)
+{
+    struct dns_answer *answer = xzalloc(sizeof *answer);
+
+    answer->dp_key = dp_key;
+    answer->name = xstrdup(name);
+    ofpbuf_init(&answer->a_rrs, 0);
+    ofpbuf_init(&answer->aaaa_rrs, 0);
+    ofpbuf_init(&answer->ptr_rr, 0);
+
+    /* The same record may be queried as a name, for TYPE A, AAAA or ANY, or
+     * as a reverse name, for TYPE PTR. */
+    dns_put_ptr_rr_tail(&answer->ptr_rr, answer_data);
+
+    struct lport_addresses ip_addrs;
+    if (extract_ip_addresses(answer_data, &ip_addrs)) {
+        for (size_t i = 0; i < ip_addrs.n_ipv4_addrs; i++) {
+            dns_put_a_rr_tail(&answer->a_rrs, ip_addrs.ipv4_addrs[i].addr);
+        }
+        answer->n_a_rrs = ip_addrs.n_ipv4_addrs;
+        for (size_t i = 0; i < ip_addrs.n_ipv6_addrs; i++) {
+            dns_put_aaaa_rr_tail(&answer->aaaa_rrs,
+                                 &ip_addrs.ipv6_addrs[i].addr);
+        }
+        answer->n_aaaa_rrs = ip_addrs.n_ipv6_addrs;
+        destroy_lport_addresses(&ip_addrs);
+    }
+
+    hmap_insert(&snap->answers, &answer->hmap_node,
+                dns_answer_hash(dp_key, name));
+}
+
+static void
+dns_cache_snapshot_destroy(struct dns_cache_snapshot *snap)
+{
+    if (snap) {
+        struct dns_answer *answer;
+        HMAP_FOR_EACH_POP (answer, hmap_node, &snap->answers) {
+            ofpbuf_uninit(&answer->a_rrs);
+            ofpbuf_uninit(&answer->aaaa_rrs);
+            ofpbuf_uninit(&answer->ptr_rr);
+            free(answer->name);
+            free(answer);
+        }
+        hmap_destroy(&snap->answers);
+        free(snap);
+    }
+}
+
+/* Publishes the answers in 'dns_cache' to the pinctrl_handler thread. */
+static void
+dns_cache_publish(void)
+{
+    struct dns_cache_snapshot *snap = xmalloc(sizeof *snap);
+    hmap_init(&snap->answers);
+
+    /* If several DNS records have the same name on a datapath, the first one
+     * found wins. */
+    struct shash_node *iter;
+    SHASH_FOR_EACH (iter, &dns_cache) {
+        const struct dns_data *d = iter->data;
+
+        for (size_t i = 0; i < d->n_dps; i++) {
+            struct smap_node *record;
+
+            SMAP_FOR_EACH (record, &d->records) {
+                if (!dns_answer_find(snap, d->dps[i], record->key)) {
+                    dns_answer_add(snap, d->dps[i], record->key,
+                                   record->value);
+                }
+            }
+        }
+    }
+
+    struct dns_cache_snapshot *old
+        = ovsrcu_get_protected(struct dns_cache_snapshot *,
+                               &dns_cache_snapshot);
+    ovsrcu_set(&dns_cache_snapshot, snap);
+    if (old) {
+        ovsrcu_postpone(dns_cache_snapshot_destroy, old);
+    }
+}
+
 /* Called by pinctrl_run(). Runs within the main ovn-controller
- * thread context. */
+ * thread context.  Publishes a new snapshot of the cache if it changed. */
 static void
 sync_dns_cache(const struct sbrec_dns_table *dns_table)
-    OVS_REQUIRES(pinctrl_mutex)
 {
+    bool changed = false;
     struct shash_node *iter;
     SHASH_FOR_EACH (iter, &dns_cache) {
         struct dns_data *d = iter->data;
@@ -2655,8 +3101,7 @@ sync_dns_cache(const struct sbrec_dns_table *dns_table)
             shash_add(&dns_cache, dns_id, dns_data);
             dns_data->n_dps = 0;
             dns_data->dps = NULL;
-        } else {
-            free(dns_data->dps);
+            changed = true;
         }
 
         dns_data->delete = false;
@@ -2664,12 +3109,22 @@ sync_dns_cache(const struct sbrec_dns_table *dns_table)
         if (!smap_equal(&dns_data->records, &sbrec_dns->records)) {
             smap_destroy(&dns_data->records);
             smap_clone(&dns_data->records, &sbrec_dns->records);
+            changed = true;
         }
 
-        dns_data->n_dps = sbrec_dns->n_datapaths;
-        dns_data->dps = xcalloc(dns_data->n_dps, sizeof(uint64_t));
-        for (size_t i = 0; i < sbrec_dns->n_datapaths; i++) {
-            dns_data->dps[i] = sbrec_dns->datapaths[i]->tunnel_key;
+        bool dps_changed = dns_data->n_dps != sbrec_dns->n_datapaths;
+        for (size_t i = 0; !dps_changed && i < dns_data->n_dps; i++) {
+            dps_changed = (dns_data->dps[i]
+                           != sbrec_dns->datapaths[i]->tunnel_key);
+        }
+        if (dps_changed) {
+            free(dns_data->dps);
+            dns_data->n_dps = sbrec_dns->n_datapaths;
+            dns_data->dps = xcalloc(dns_data->n_dps, sizeof(uint64_t));
+            for (size_t i = 0; i < sbrec_dns->n_datapaths; i++) {
+                dns_data->dps[i] = sbrec_dns->datapaths[i]->tunnel_key;
+            }
+            changed = true;
         }
     }
 
@@ -2678,13 +3133,17 @@ sync_dns_cache(const struct sbrec_dns_table *dns_table)
         struct dns_data *d = iter->data;
         if (d->delete) {
             shash_delete(&dns_cache, iter);
-            smap_destroy(&d->records);
-            free(d->dps);
-            free(d);
+            dns_data_destroy(d);
+            changed = true;
         }
     }
+
+    if (changed) {
+        dns_cache_publish();
+    }
 }
 
+/* Called after the pinctrl_handler thread exited. */
 static void
 destroy_dns_cache(void)
 {
@@ -2692,14 +3151,16 @@ destroy_dns_cache(void)
     SHASH_FOR_EACH_SAFE (iter, next, &dns_cache) {
         struct dns_data *d = iter->data;
         shash_delete(&dns_cache, iter);
-        smap_destroy(&d->records);
-        free(d->dps);
-        free(d);
+        dns_data_destroy(d);
     }
+    dns_cache_snapshot_destroy(
+        ovsrcu_get_protected(struct dns_cache_snapshot *,
+                             &dns_cache_snapshot));
+    ovsrcu_set_hidden(&dns_cache_snapshot, NULL);
 }
 
-/* Populates dns_answer struct with base data.
- * Copy the answer section
+/* Appends to 'rr' the part of a resource record of an answer section that
+ * follows the NAME, which is the query name of the request.
  * Format of the answer section is
  *  - NAME     -> The domain name
  *  - TYPE     -> 2 octets containing one of the RR type codes
@@ -2714,51 +3175,39 @@ destroy_dns_cache(void)
  *                describes the resource.
  */
 static void
-dns_build_base_answer(
-    struct ofpbuf *dns_answer, const uint8_t *in_queryname,
-    uint16_t query_length, int query_type)
+dns_put_base_rr_tail(struct ofpbuf *rr, int query_type)
 {
-    ofpbuf_put(dns_answer, in_queryname, query_length);
-    put_be16(dns_answer, htons(query_type));
-    put_be16(dns_answer, htons(DNS_CLASS_IN));
-    put_be32(dns_answer, htonl(DNS_DEFAULT_RR_TTL));
+    put_be16(rr, htons(query_type));
+    put_be16(rr, htons(DNS_CLASS_IN));
+    put_be32(rr, htonl(DNS_DEFAULT_RR_TTL));
 }
 
-/* Populates dns_answer struct with a TYPE A answer. */
+/* Appends a TYPE A record tail to 'rr'. */
 static void
-dns_build_a_answer(
-    struct ofpbuf *dns_answer, const uint8_t *in_queryname,
-    uint16_t query_length, const ovs_be32 addr)
+dns_put_a_rr_tail(struct ofpbuf *rr, ovs_be32 addr)
 {
-    dns_build_base_answer(dns_answer, in_queryname, query_length,
-                          DNS_QUERY_TYPE_A);
-    put_be16(dns_answer, htons(sizeof(ovs_be32)));
-    put_be32(dns_answer, addr);
+    dns_put_base_rr_tail(rr, DNS_QUERY_TYPE_A);
+    put_be16(rr, htons(sizeof(ovs_be32)));
+    put_be32(rr, addr);
 }
 
-/* Populates dns_answer struct with a TYPE AAAA answer. */
+/* Appends a TYPE AAAA record tail to 'rr'. */
 static void
-dns_build_aaaa_answer(
-    struct ofpbuf *dns_answer, const uint8_t *in_queryname,
-    uint16_t query_length, const struct in6_addr *addr)
+dns_put_aaaa_rr_tail(struct ofpbuf *rr, const struct in6_addr *addr)
 {
-    dns_build_base_answer(dns_answer, in_queryname, query_length,
-                          DNS_QUERY_TYPE_AAAA);
-    put_be16(dns_answer, htons(sizeof(*addr)));
-    ofpbuf_put(dns_answer, addr, sizeof(*addr));
+    dns_put_base_rr_tail(rr, DNS_QUERY_TYPE_AAAA);
+    put_be16(rr, htons(sizeof(*addr)));
+    ofpbuf_put(rr, addr, sizeof(*addr));
 }
 
-/* Populates dns_answer struct with a TYPE PTR answer. */
+/* Appends a TYPE PTR record tail to 'rr'. */
 static void
-dns_build_ptr_answer(
-    struct ofpbuf *dns_answer, const uint8_t *in_queryname,
-    uint16_t query_length, const char *answer_data)
+dns_put_ptr_rr_tail(struct ofpbuf *rr, const char *answer_data)
 {
     char *encoded_answer;
     uint16_t encoded_answer_length;
 
-    dns_build_base_answer(dns_answer, in_queryname, query_length,
-                          DNS_QUERY_TYPE_PTR);
+    dns_put_base_rr_tail(rr, DNS_QUERY_TYPE_PTR);
 
     /* Initialize string 2 chars longer than real answer:
      * first label length and terminating zero-length label.
@@ -2771,7 +3220,7 @@ dns_build_ptr_answer(
     encoded_answer_length = strlen(answer_data) + 2;
     encoded_answer = (char *)xzalloc(encoded_answer_length);
 
-    put_be16(dns_answer, htons(encoded_answer_length));
+    put_be16(rr, htons(encoded_answer_length));
     uint8_t label_len_index = 0;
     uint16_t label_len = 0;
     char *encoded_answer_ptr = (char *)encoded_answer + 1;
@@ -2794,17 +3243,32 @@ dns_build_ptr_answer(
         encoded_answer[label_len_index] = label_len;
     }
 
-    ofpbuf_put(dns_answer, encoded_answer, encoded_answer_length);
+    ofpbuf_put(rr, encoded_answer, encoded_answer_length);
     free(encoded_answer);
 }
 
+/* Appends to 'dns_answer' the 'n' resource records whose tails, of
+ * 'tail_len' bytes each, are in 'tails', with 'in_queryname' as NAME. */
+static void
+dns_put_rrs(struct ofpbuf *dns_answer, const uint8_t *in_queryname,
+            uint16_t query_length, const struct ofpbuf *tails, size_t n,
+            size_t tail_len)
+{
+    const uint8_t *tail = tails->data;
+
+    for (size_t i = 0; i < n; i++) {
+        ofpbuf_put(dns_answer, in_queryname, query_length);
+        ofpbuf_put(dns_answer, tail, tail_len);
+        tail += tail_len;
+    }
+}
+
 /* Called with in the pinctrl_handler thread context. */
 static void
 pinctrl_handle_dns_lookup(
     struct rconn *swconn,
     struct dp_packet *pkt_in, struct ofputil_packet_in *pin,
     struct ofpbuf *userdata, struct ofpbuf *continuation)
-    OVS_REQUIRES(pinctrl_mutex)
 {
     static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
     enum ofp_version version = rconn_get_version(swconn);
@@ -2902,66 +3366,43 @@ pinctrl_handle_dns_lookup(
     }
 
     uint64_t dp_key = ntohll(pin->flow_metadata.flow.metadata);
-    const char *answer_data = NULL;
-    struct shash_node *iter;
-    SHASH_FOR_EACH (iter, &dns_cache) {
-        struct dns_data *d = iter->data;
-        for (size_t i = 0; i < d->n_dps; i++) {
-            if (d->dps[i] == dp_key) {
-                /* DNS records in SBDB are stored in lowercase. Convert to
-                 * lowercase to perform case insensitive lookup
-                 */
-                char *query_name_lower = str_tolower(ds_cstr(&query_name));
-                answer_data = smap_get(&d->records, query_name_lower);
-                free(query_name_lower);
-                if (answer_data) {
-                    break;
-                }
-            }
-        }
-
-        if (answer_data) {
-            break;
-        }
-    }
+    const struct dns_cache_snapshot *snap
+        = ovsrcu_get(struct dns_cache_snapshot *, &dns_cache_snapshot);
 
+    /* DNS records in SBDB are stored in lowercase. Convert to
+     * lowercase to perform case insensitive lookup
+     */
+    char *query_name_lower = str_tolower(ds_cstr(&query_name));
+    const struct dns_answer *answer = dns_answer_find(snap, dp_key,
+                                                      query_name_lower);
+    free(query_name_lower);
     ds_destroy(&query_name);
-    if (!answer_data) {
+    if (!answer) {
         goto exit;
     }
 
-
     uint16_t ancount = 0;
     uint64_t dns_ans_stub[128 / 8];
     struct ofpbuf dns_answer = OFPBUF_STUB_INITIALIZER(dns_ans_stub);
 
     if (query_type == DNS_QUERY_TYPE_PTR) {
-        dns_build_ptr_answer(&dns_answer, in_queryname, idx, answer_data);
+        dns_put_rrs(&dns_answer, in_queryname, idx, &answer->ptr_rr, 1,
+                    answer->ptr_rr.size);
         ancount++;
     } else {
-        struct lport_addresses ip_addrs;
-        if (!extract_ip_addresses(answer_data, &ip_addrs)) {
-            goto exit;
-        }
-
         if (query_type == DNS_QUERY_TYPE_A ||
             query_type == DNS_QUERY_TYPE_ANY) {
-            for (size_t i = 0; i < ip_addrs.n_ipv4_addrs; i++) {
-                dns_build_a_answer(&dns_answer, in_queryname, idx,
-                                   ip_addrs.ipv4_addrs[i].addr);
-                ancount++;
-            }
+            dns_put_rrs(&dns_answer, in_queryname, idx, &answer->a_rrs,
+                        answer->n_a_rrs, DNS_A_RR_TAIL_LEN);
+            ancount += answer->n_a_rrs;
         }
 
         if (query_type == DNS_QUERY_TYPE_AAAA ||
             query_type == DNS_QUERY_TYPE_ANY) {
-            for (size_t i = 0; i < ip_addrs.n_ipv6_addrs; i++) {
-                dns_build_aaaa_answer(&dns_answer, in_queryname, idx,
-                                      &ip_addrs.ipv6_addrs[i].addr);
-                ancount++;
-            }
+            dns_put_rrs(&dns_answer, in_queryname, idx, &answer->aaaa_rrs,
+                        answer->n_aaaa_rrs, DNS_AAAA_RR_TAIL_LEN);
+            ancount += answer->n_aaaa_rrs;
         }
-        destroy_lport_addresses(&ip_addrs);
     }
 
     if (!ancount) {
@@ -3048,54 +3489,456 @@ exit:
     dp_packet_uninit(pkt_out_ptr);
 }
 
-/* Called with in the pinctrl_handler thread context. */
-static void
-process_packet_in(struct rconn *swconn, const struct ofp_header *msg)
-{
-    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+/* Classes of packet-ins, in the order in which they are served. */
+enum pinctrl_pin_class {
+    PIN_CLASS_MONITOR,  /* BFD and service monitor health checks. */
+    PIN_CLASS_STATE,    /* Packets that update the state shared with the
+                         * main thread, processed by pinctrl_handler(). */
+    PIN_CLASS_REPLY,    /* Packets answered from their own contents only,
+                         * processed by the workers, if any. */
+    PIN_CLASS_MAX,
+};
+
+/* Maximum number of packet-ins queued per class.  Packet-ins beyond this are
+ * dropped, so that a burst in one class doesn't grow the queues without
+ * bound. */
+#define PINCTRL_PIN_QUEUE_MAX 1024
+
+/* Maximum number of OpenFlow messages received and of PIN_CLASS_REPLY
+ * packet-ins processed by pinctrl_handler() per iteration. */
+#define PINCTRL_RECV_BATCH 256
+#define PINCTRL_REPLY_BATCH 50
+
+/* Maximum number of pinctrl_worker() threads. */
+#define PINCTRL_MAX_WORKERS 16
 
+/* A decoded packet-in.  The pointers in 'pin', 'userdata' and 'continuation'
+ * point into 'msg'. */
+struct pinctrl_pin {
+    struct ovs_list list_node;
+    struct ofpbuf *msg;
     struct ofputil_packet_in pin;
+    struct ofpbuf userdata;     /* Past the action header. */
     struct ofpbuf continuation;
-    enum ofperr error = ofputil_decode_packet_in(msg, true, NULL, NULL, &pin,
-                                                 NULL, NULL, &continuation);
+    uint32_t opcode;
+};
+
+struct pinctrl_pin_queue {
+    struct ovs_list pins;       /* Contains "struct pinctrl_pin"s. */
+    size_t n_pins;
+};
+
+/* Pool of threads that process the PIN_CLASS_REPLY packet-ins.  Owned by the
+ * pinctrl_handler thread. */
+struct pinctrl_workers {
+    struct ovs_mutex mutex;
+    pthread_cond_t cond;        /* Signaled when 'queue' or 'exit' change. */
+    struct pinctrl_pin_queue queue OVS_GUARDED;
+    bool exit OVS_GUARDED;
+
+    struct rconn *swconn;
+    pthread_t *threads;
+    size_t n_threads;
+};
+
+static enum pinctrl_pin_class
+pinctrl_pin_classify(uint32_t opcode)
+{
+    switch (opcode) {
+    case ACTION_OPCODE_BFD_MSG:
+    case ACTION_OPCODE_HANDLE_SVC_CHECK:
+        return PIN_CLASS_MONITOR;
 
+    case ACTION_OPCODE_IGMP:
+    case ACTION_OPCODE_PUT_ARP:
+    case ACTION_OPCODE_PUT_ND:
+    case ACTION_OPCODE_PUT_FDB:
+    case ACTION_OPCODE_EVENT:
+    case ACTION_OPCODE_BIND_VPORT:
+    case ACTION_OPCODE_DHCP6_SERVER:
+        return PIN_CLASS_STATE;
+
+    default:
+        return PIN_CLASS_REPLY;
+    }
+}
+
+/* Decodes the packet-in 'msg' and takes ownership of it.  Returns NULL, and
+ * frees 'msg', if the packet-in is not for an OVN action. */
+static struct pinctrl_pin *
+pinctrl_pin_create(struct ofpbuf *msg)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    struct pinctrl_pin *p = xmalloc(sizeof *p);
+
+    enum ofperr error = ofputil_decode_packet_in(msg->data, true, NULL, NULL,
+                                                 &p->pin, NULL, NULL,
+                                                 &p->continuation);
     if (error) {
         VLOG_WARN_RL(&rl, "error decoding packet-in: %s",
                      ofperr_to_string(error));
-        return;
+        goto error;
     }
-    if (pin.reason != OFPR_ACTION) {
-        return;
+    if (p->pin.reason != OFPR_ACTION) {
+        goto error;
     }
 
-    struct ofpbuf userdata = ofpbuf_const_initializer(pin.userdata,
-                                                      pin.userdata_len);
-    const struct action_header *ah = ofpbuf_pull(&userdata, sizeof *ah);
+    p->userdata = ofpbuf_const_initializer(p->pin.userdata,
+                                           p->pin.userdata_len);
+    const struct action_header *ah = ofpbuf_pull(&p->userdata, sizeof *ah);
     if (!ah) {
         VLOG_WARN_RL(&rl, "packet-in userdata lacks action header");
-        return;
+        goto error;
     }
+    p->opcode = ntohl(ah->opcode);
+    p->msg = msg;
+    return p;
 
-    struct dp_packet packet;
-    dp_packet_use_const(&packet, pin.packet, pin.packet_len);
-    struct flow headers;
-    flow_extract(&packet, &headers);
+error:
+    ofpbuf_delete(msg);
+    free(p);
+    return NULL;
+}
 
-    switch (ntohl(ah->opcode)) {
-    case ACTION_OPCODE_ARP:
-        pinctrl_handle_arp(swconn, &headers, &packet, &pin.flow_metadata,
-                           &userdata);
-        break;
-    case ACTION_OPCODE_IGMP:
-        pinctrl_ip_mcast_handle(swconn, &headers, &packet, &pin.flow_metadata,
-                                &userdata);
-        break;
+static void
+pinctrl_pin_destroy(struct pinctrl_pin *p)
+{
+    ofpbuf_delete(p->msg);
+    free(p);
+}
+
+static void
+pinctrl_pin_queue_init(struct pinctrl_pin_queue *q)
+{
+    ovs_list_init(&q->pins);
+    q->n_pins = 0;
+}
+
+static void
+pinctrl_pin_queue_clear(struct pinctrl_pin_queue *q)
+{
+    struct pinctrl_pin *p;
+
+    LIST_FOR_EACH_POP (p, list_node, &q->pins) {
+        pinctrl_pin_destroy(p);
+    }
+    q->n_pins = 0;
+}
+
+/* Appends 'p' to 'q', or drops it if 'q' is full.  Returns true if 'p' was
+ * queued. */
+static bool
+pinctrl_pin_queue_push(struct pinctrl_pin_queue *q, struct pinctrl_pin *p)
+{
+    if (q->n_pins >= PINCTRL_PIN_QUEUE_MAX) {
+        COVERAGE_INC(pinctrl_drop_packet_in);
+        pinctrl_pin_destroy(p);
+        return false;
+    }
+    ovs_list_push_back(&q->pins, &p->list_node);
+    q->n_pins++;
+    return true;
+}
+
+static struct pinctrl_pin *
+pinctrl_pin_queue_pop(struct pinctrl_pin_queue *q)
+{
+    if (ovs_list_is_empty(&q->pins)) {
+        return NULL;
+    }
+    q->n_pins--;
+    return CONTAINER_OF(ovs_list_pop_front(&q->pins), struct pinctrl_pin,
+                        list_node);
+}
+
+/* Packet-in admission control.
+ *
+ * Before they are queued, the packet-ins of each action are rate limited
+ * per datapath to 'pinctrl_pin_rate' per second, with a token bucket, so
+ * that a datapath that punts many packets doesn't fill the queues and
+ * starve the others.  The PIN_CLASS_MONITOR ones are never limited.
+ * pinctrl_handler() also counts the packet-ins received and dropped per
+ * action, and records the depth of the queues of each class, for
+ * pinctrl_get_packet_in_stats().  All of this is protected by
+ * 'pinctrl_pin_mutex', which is taken before the mutex of the workers. */
+static struct ovs_mutex pinctrl_pin_mutex = OVS_MUTEX_INITIALIZER;
+
+/* Tokens withdrawn per packet-in, so that the rate of a bucket, in tokens
+ * per ms, is the rate in packet-ins per second. */
+#define PINCTRL_PIN_RATE_TOKENS 1000
+
+/* The rate limit of an action on a datapath, in 'pinctrl_pin_rates'. */
+struct pinctrl_pin_rate {
+    struct hmap_node hmap_node; /* Hashed on 'opcode' and 'dp_key'. */
+    uint32_t opcode;
+    uint64_t dp_key;
+    struct token_bucket tb;
+};
+
+/* The statistics of an action, in 'pinctrl_pin_opcode_stats'. */
+struct pinctrl_pin_opcode_stats {
+    struct hmap_node hmap_node; /* Hashed on 'opcode'. */
+    uint32_t opcode;
+    uint64_t n_received;
+    uint64_t n_dropped_rate;    /* Dropped by the rate limit. */
+    uint64_t n_dropped_queue;   /* Dropped because the queue was full. */
+};
+
+/* The depth of the queue of a class, when it was last filled. */
+struct pinctrl_pin_class_stats {
+    size_t depth;
+    size_t max_depth;
+};
+
+/* Maximum number of packet-ins of an action per datapath per second, 0 for
+ * no limit. */
+static unsigned int pinctrl_pin_rate OVS_GUARDED_BY(pinctrl_pin_mutex);
+
+/* Contains "struct pinctrl_pin_rate"s. */
+static struct hmap pinctrl_pin_rates OVS_GUARDED_BY(pinctrl_pin_mutex)
+    = HMAP_INITIALIZER(&pinctrl_pin_rates);
+
+/* Contains "struct pinctrl_pin_opcode_stats"s. */
+static struct hmap pinctrl_pin_opcode_stats OVS_GUARDED_BY(pinctrl_pin_mutex)
+    = HMAP_INITIALIZER(&pinctrl_pin_opcode_stats);
+
+static struct pinctrl_pin_class_stats pinctrl_pin_class_stats[PIN_CLASS_MAX]
+    OVS_GUARDED_BY(pinctrl_pin_mutex);
+
+static const char *
+pinctrl_pin_class_name(enum pinctrl_pin_class class)
+{
+    switch (class) {
+    case PIN_CLASS_MONITOR:
+        return "monitor";
+    case PIN_CLASS_STATE:
+        return "state";
+    case PIN_CLASS_REPLY:
+        return "reply";
+    case PIN_CLASS_MAX:
+    default:
+        OVS_NOT_REACHED();
+    }
+}
+
+/* Returns the name of the OVN action of 'opcode', or NULL if it is
+ * unknown. */
+static const char *
+pinctrl_opcode_name(uint32_t opcode)
+{
+    switch (opcode) {
+    case ACTION_OPCODE_ARP: return "arp";
+    case ACTION_OPCODE_PUT_ARP: return "put_arp";
+    case ACTION_OPCODE_PUT_DHCP_OPTS: return "put_dhcp_opts";
+    case ACTION_OPCODE_ND_NA: return "nd_na";
+    case ACTION_OPCODE_PUT_ND: return "put_nd";
+    case ACTION_OPCODE_PUT_DHCPV6_OPTS: return "put_dhcpv6_opts";
+    case ACTION_OPCODE_DNS_LOOKUP: return "dns_lookup";
+    case ACTION_OPCODE_LOG: return "log";
+    case ACTION_OPCODE_PUT_ND_RA_OPTS: return "put_nd_ra_opts";
+    case ACTION_OPCODE_ND_NS: return "nd_ns";
+    case ACTION_OPCODE_ICMP: return "icmp";
+    case ACTION_OPCODE_TCP_RESET: return "tcp_reset";
+    case ACTION_OPCODE_ND_NA_ROUTER: return "nd_na_router";
+    case ACTION_OPCODE_PUT_ICMP4_FRAG_MTU: return "put_icmp4_frag_mtu";
+    case ACTION_OPCODE_ICMP4_ERROR: return "icmp4_error";
+    case ACTION_OPCODE_EVENT: return "trigger_event";
+    case ACTION_OPCODE_IGMP: return "igmp";
+    case ACTION_OPCODE_BIND_VPORT: return "bind_vport";
+    case ACTION_OPCODE_HANDLE_SVC_CHECK: return "handle_svc_check";
+    case ACTION_OPCODE_DHCP6_SERVER: return "dhcp6_server";
+    case ACTION_OPCODE_ICMP6_ERROR: return "icmp6_error";
+    case ACTION_OPCODE_PUT_ICMP6_FRAG_MTU: return "put_icmp6_frag_mtu";
+    case ACTION_OPCODE_REJECT: return "reject";
+    case ACTION_OPCODE_BFD_MSG: return "bfd_msg";
+    case ACTION_OPCODE_SCTP_ABORT: return "sctp_abort";
+    case ACTION_OPCODE_PUT_FDB: return "put_fdb";
+    default: return NULL;
+    }
+}
+
+static struct pinctrl_pin_opcode_stats *
+pinctrl_pin_opcode_stats_get(uint32_t opcode)
+    OVS_REQUIRES(pinctrl_pin_mutex)
+{
+    struct pinctrl_pin_opcode_stats *stats;
+    uint32_t hash = hash_int(opcode, 0);
+
+    HMAP_FOR_EACH_WITH_HASH (stats, hmap_node, hash,
+                             &pinctrl_pin_opcode_stats) {
+        if (stats->opcode == opcode) {
+            return stats;
+        }
+    }
+    stats = xzalloc(sizeof *stats);
+    stats->opcode = opcode;
+    hmap_insert(&pinctrl_pin_opcode_stats, &stats->hmap_node, hash);
+    return stats;
+}
+
+/* Returns true if the rate limit of the action and datapath of 'p' allows
+ * to queue it. */
+static bool
+pinctrl_pin_rate_allow(const struct pinctrl_pin *p)
+    OVS_REQUIRES(pinctrl_pin_mutex)
+{
+    if (!pinctrl_pin_rate) {
+        return true;
+    }
+
+    uint64_t dp_key = ntohll(p->pin.flow_metadata.flow.metadata);
+    uint32_t hash = hash_int(p->opcode, hash_uint64(dp_key));
+    struct pinctrl_pin_rate *rate;
+
+    HMAP_FOR_EACH_WITH_HASH (rate, hmap_node, hash, &pinctrl_pin_rates) {
+        if (rate->opcode == p->opcode && rate->dp_key == dp_key) {
+            goto found;
+        }
+    }
+    rate = xmalloc(sizeof *rate);
+    rate->opcode = p->opcode;
+    rate->dp_key = dp_key;
+    token_bucket_init(&rate->tb, pinctrl_pin_rate,
+                      OVS_SAT_MUL(pinctrl_pin_rate, PINCTRL_PIN_RATE_TOKENS));
+    hmap_insert(&pinctrl_pin_rates, &rate->hmap_node, hash);
+
+found:
+    return token_bucket_withdraw(&rate->tb, PINCTRL_PIN_RATE_TOKENS);
+}
+
+static void
+pinctrl_pin_rates_clear(void)
+    OVS_REQUIRES(pinctrl_pin_mutex)
+{
+    struct pinctrl_pin_rate *rate;
+    HMAP_FOR_EACH_POP (rate, hmap_node, &pinctrl_pin_rates) {
+        free(rate);
+    }
+}
+
+/* Records the depth of the queues of each class. */
+static void
+pinctrl_pin_record_depths(struct pinctrl_pin_queue queues[PIN_CLASS_MAX],
+                          struct pinctrl_workers *workers)
+{
+    size_t depths[PIN_CLASS_MAX];
+
+    for (size_t i = 0; i < PIN_CLASS_MAX; i++) {
+        depths[i] = queues[i].n_pins;
+    }
+    ovs_mutex_lock(&workers->mutex);
+    depths[PIN_CLASS_REPLY] = workers->queue.n_pins;
+    ovs_mutex_unlock(&workers->mutex);
+
+    ovs_mutex_lock(&pinctrl_pin_mutex);
+    for (size_t i = 0; i < PIN_CLASS_MAX; i++) {
+        struct pinctrl_pin_class_stats *stats = &pinctrl_pin_class_stats[i];
+        stats->depth = depths[i];
+        stats->max_depth = MAX(stats->max_depth, depths[i]);
+    }
+    ovs_mutex_unlock(&pinctrl_pin_mutex);
+}
+
+static void
+pinctrl_pin_stats_destroy(void)
+{
+    struct pinctrl_pin_opcode_stats *stats;
+
+    ovs_mutex_lock(&pinctrl_pin_mutex);
+    pinctrl_pin_rates_clear();
+    HMAP_FOR_EACH_POP (stats, hmap_node, &pinctrl_pin_opcode_stats) {
+        free(stats);
+    }
+    ovs_mutex_unlock(&pinctrl_pin_mutex);
+}
+
+/* Sets the maximum number of packet-ins of each action that each datapath
+ * may send per second, 'rate', 0 for no limit. */
+void
+pinctrl_set_packet_in_rate(unsigned int rate)
+{
+    ovs_mutex_lock(&pinctrl_pin_mutex);
+    if (rate != pinctrl_pin_rate) {
+        pinctrl_pin_rate = rate;
+        pinctrl_pin_rates_clear();
+    }
+    ovs_mutex_unlock(&pinctrl_pin_mutex);
+}
+
+/* Formats the depth of the packet-in queues and the number of packet-ins
+ * received and dropped per action into 's'. */
+void
+pinctrl_get_packet_in_stats(struct ds *s)
+{
+    ovs_mutex_lock(&pinctrl_mutex);
+    size_t n_workers = pinctrl.n_workers;
+    ovs_mutex_unlock(&pinctrl_mutex);
+
+    ovs_mutex_lock(&pinctrl_pin_mutex);
+    if (pinctrl_pin_rate) {
+        ds_put_format(s, "Rate limit: %u per second per datapath\n",
+                      pinctrl_pin_rate);
+    } else {
+        ds_put_cstr(s, "Rate limit: none\n");
+    }
+    ds_put_format(s, "Workers: %"PRIuSIZE"\n", n_workers);
+
+    ds_put_cstr(s, "Queues:\n");
+    for (size_t i = 0; i < PIN_CLASS_MAX; i++) {
+        const struct pinctrl_pin_class_stats *stats =
+            &pinctrl_pin_class_stats[i];
+        ds_put_format(s, "  %s: depth %"PRIuSIZE", max %"PRIuSIZE
+                      " (limit %d)\n", pinctrl_pin_class_name(i),
+                      stats->depth, stats->max_depth, PINCTRL_PIN_QUEUE_MAX);
+    }
+
+    ds_put_cstr(s, "Actions:\n");
+    const struct pinctrl_pin_opcode_stats *stats;
+    HMAP_FOR_EACH (stats, hmap_node, &pinctrl_pin_opcode_stats) {
+        const char *name = pinctrl_opcode_name(stats->opcode);
+        if (name) {
+            ds_put_format(s, "  %s:", name);
+        } else {
+            ds_put_format(s, "  opcode %"PRIu32":", stats->opcode);
+        }
+        ds_put_format(s, " received %"PRIu64", rate dropped %"PRIu64
+                      ", queue dropped %"PRIu64"\n", stats->n_received,
+                      stats->n_dropped_rate, stats->n_dropped_queue);
+    }
+    ovs_mutex_unlock(&pinctrl_pin_mutex);
+}
+
+/* Called with in the pinctrl_handler thread or a pinctrl_worker thread
+ * context. */
+static void
+process_packet_in(struct rconn *swconn, const struct pinctrl_pin *p)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+    struct ofputil_packet_in pin = p->pin;
+    struct ofpbuf userdata = p->userdata;
+    struct ofpbuf continuation = p->continuation;
+
+    struct dp_packet packet;
+    dp_packet_use_const(&packet, pin.packet, pin.packet_len);
+    struct flow headers;
+    flow_extract(&packet, &headers);
+
+    switch (p->opcode) {
+    case ACTION_OPCODE_ARP:
+        pinctrl_handle_arp(swconn, &headers, &packet, &pin.flow_metadata,
+                           &userdata);
+        break;
+    case ACTION_OPCODE_IGMP:
+        pinctrl_ip_mcast_handle(swconn, &headers, &packet, &pin.flow_metadata,
+                                &userdata);
+        break;
 
     case ACTION_OPCODE_PUT_ARP:
-        ovs_mutex_lock(&pinctrl_mutex);
+        ovs_mutex_lock(&pinctrl_put_mutex);
         pinctrl_handle_put_mac_binding(&pin.flow_metadata.flow, &headers,
                                        true);
-        ovs_mutex_unlock(&pinctrl_mutex);
+        ovs_mutex_unlock(&pinctrl_put_mutex);
         break;
 
     case ACTION_OPCODE_PUT_DHCP_OPTS:
@@ -3114,16 +3957,16 @@ process_packet_in(struct rconn *swconn, const struct ofp_header *msg)
         break;
 
     case ACTION_OPCODE_PUT_ND:
-        ovs_mutex_lock(&pinctrl_mutex);
+        ovs_mutex_lock(&pinctrl_put_mutex);
         pinctrl_handle_put_mac_binding(&pin.flow_metadata.flow, &headers,
                                        false);
-        ovs_mutex_unlock(&pinctrl_mutex);
+        ovs_mutex_unlock(&pinctrl_put_mutex);
         break;
 
     case ACTION_OPCODE_PUT_FDB:
-        ovs_mutex_lock(&pinctrl_mutex);
+        ovs_mutex_lock(&pinctrl_put_mutex);
         pinctrl_handle_put_fdb(&pin.flow_metadata.flow, &headers);
-        ovs_mutex_unlock(&pinctrl_mutex);
+        ovs_mutex_unlock(&pinctrl_put_mutex);
         break;
 
     case ACTION_OPCODE_PUT_DHCPV6_OPTS:
@@ -3132,10 +3975,8 @@ process_packet_in(struct rconn *swconn, const struct ofp_header *msg)
         break;
 
     case ACTION_OPCODE_DNS_LOOKUP:
-        ovs_mutex_lock(&pinctrl_mutex);
         pinctrl_handle_dns_lookup(swconn, &packet, &pin, &userdata,
                                   &continuation);
-        ovs_mutex_unlock(&pinctrl_mutex);
         break;
 
     case ACTION_OPCODE_LOG:
@@ -3191,9 +4032,9 @@ process_packet_in(struct rconn *swconn, const struct ofp_header *msg)
         break;
 
     case ACTION_OPCODE_BIND_VPORT:
-        ovs_mutex_lock(&pinctrl_mutex);
+        ovs_mutex_lock(&pinctrl_put_mutex);
         pinctrl_handle_bind_vport(&pin.flow_metadata.flow, &userdata);
-        ovs_mutex_unlock(&pinctrl_mutex);
+        ovs_mutex_unlock(&pinctrl_put_mutex);
         break;
     case ACTION_OPCODE_DHCP6_SERVER:
         ovs_mutex_lock(&pinctrl_mutex);
@@ -3210,22 +4051,80 @@ process_packet_in(struct rconn *swconn, const struct ofp_header *msg)
         break;
 
     case ACTION_OPCODE_BFD_MSG:
-        ovs_mutex_lock(&pinctrl_mutex);
+        ovs_mutex_lock(&bfd_mutex);
         pinctrl_handle_bfd_msg(swconn, &headers, &packet);
-        ovs_mutex_unlock(&pinctrl_mutex);
+        ovs_mutex_unlock(&bfd_mutex);
         break;
 
     default:
         VLOG_WARN_RL(&rl, "unrecognized packet-in opcode %"PRIu32,
-                     ntohl(ah->opcode));
+                     p->opcode);
         break;
     }
 }
 
-/* Called with in the pinctrl_handler thread context. */
+static void pinctrl_recv_switch_msg(struct rconn *, const struct ofp_header *,
+                                    enum ofptype);
+
+/* Called with in the pinctrl_handler thread context.  Takes ownership of
+ * 'msg'.  Packet-ins are queued in 'queues', the PIN_CLASS_REPLY ones in
+ * 'workers''s queue. */
 static void
-pinctrl_recv(struct rconn *swconn, const struct ofp_header *oh,
-             enum ofptype type)
+pinctrl_recv(struct rconn *swconn, struct ofpbuf *msg,
+             struct pinctrl_pin_queue queues[PIN_CLASS_MAX],
+             struct pinctrl_workers *workers)
+{
+    const struct ofp_header *oh = msg->data;
+    enum ofptype type;
+
+    ofptype_decode(&type, oh);
+    if (type == OFPTYPE_PACKET_IN) {
+        struct pinctrl_pin *p = pinctrl_pin_create(msg);
+        if (!p) {
+            return;
+        }
+
+        enum pinctrl_pin_class class = pinctrl_pin_classify(p->opcode);
+        bool queued;
+
+        ovs_mutex_lock(&pinctrl_pin_mutex);
+        struct pinctrl_pin_opcode_stats *stats =
+            pinctrl_pin_opcode_stats_get(p->opcode);
+        stats->n_received++;
+        if (class != PIN_CLASS_MONITOR && !pinctrl_pin_rate_allow(p)) {
+            COVERAGE_INC(pinctrl_drop_packet_in_rate);
+            stats->n_dropped_rate++;
+            ovs_mutex_unlock(&pinctrl_pin_mutex);
+            pinctrl_pin_destroy(p);
+            return;
+        }
+
+        if (class == PIN_CLASS_REPLY) {
+            ovs_mutex_lock(&workers->mutex);
+            queued = pinctrl_pin_queue_push(&workers->queue, p);
+            if (queued && workers->n_threads) {
+                xpthread_cond_signal(&workers->cond);
+            }
+            ovs_mutex_unlock(&workers->mutex);
+        } else {
+            queued = pinctrl_pin_queue_push(&queues[class], p);
+        }
+        if (!queued) {
+            stats->n_dropped_queue++;
+        }
+        ovs_mutex_unlock(&pinctrl_pin_mutex);
+        return;
+    }
+
+    pinctrl_recv_switch_msg(swconn, oh, type);
+    ofpbuf_delete(msg);
+}
+
+/* Handles 'oh', of type 'type', an OpenFlow message received on 'swconn'
+ * other than a packet-in. */
+static void
+pinctrl_recv_switch_msg(struct rconn *swconn, const struct ofp_header *oh,
+                        enum ofptype type)
 {
     if (type == OFPTYPE_ECHO_REQUEST) {
         queue_msg(swconn, ofputil_encode_echo_reply(oh));
@@ -3236,8 +4135,6 @@ pinctrl_recv(struct rconn *swconn, const struct ofp_header *oh,
         ofputil_decode_get_config_reply(oh, &config);
         config.miss_send_len = UINT16_MAX;
         set_switch_config(swconn, &config);
-    } else if (type == OFPTYPE_PACKET_IN) {
-        process_packet_in(swconn, oh);
     } else {
         if (VLOG_IS_DBG_ENABLED()) {
             static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(30, 300);
@@ -3250,6 +4147,134 @@ pinctrl_recv(struct rconn *swconn, const struct ofp_header *oh,
     }
 }
 
+/* pinctrl_worker pthread function. */
+static void *
+pinctrl_worker(void *workers_)
+{
+    struct pinctrl_workers *workers = workers_;
+
+    ovs_mutex_lock(&workers->mutex);
+    for (;;) {
+        while (!workers->exit && ovs_list_is_empty(&workers->queue.pins)) {
+            ovs_mutex_cond_wait(&workers->cond, &workers->mutex);
+        }
+        if (workers->exit) {
+            break;
+        }
+
+        struct pinctrl_pin *p = pinctrl_pin_queue_pop(&workers->queue);
+        ovs_mutex_unlock(&workers->mutex);
+        process_packet_in(workers->swconn, p);
+        pinctrl_pin_destroy(p);
+        ovs_mutex_lock(&workers->mutex);
+    }
+    ovs_mutex_unlock(&workers->mutex);
+    return NULL;
+}
+
+static void
+pinctrl_workers_init(struct pinctrl_workers *workers, struct rconn *swconn)
+{
+    ovs_mutex_init(&workers->mutex);
+    xpthread_cond_init(&workers->cond, NULL);
+    pinctrl_pin_queue_init(&workers->queue);
+    workers->exit = false;
+    workers->swconn = swconn;
+    workers->threads = NULL;
+    workers->n_threads = 0;
+}
+
+static void
+pinctrl_workers_stop(struct pinctrl_workers *workers)
+{
+    if (!workers->n_threads) {
+        return;
+    }
+
+    ovs_mutex_lock(&workers->mutex);
+    workers->exit = true;
+    xpthread_cond_broadcast(&workers->cond);
+    ovs_mutex_unlock(&workers->mutex);
+
+    for (size_t i = 0; i < workers->n_threads; i++) {
+        xpthread_join(workers->threads[i], NULL);
+    }
+    free(workers->threads);
+    workers->threads = NULL;
+    workers->n_threads = 0;
+
+    ovs_mutex_lock(&workers->mutex);
+    workers->exit = false;
+    ovs_mutex_unlock(&workers->mutex);
+}
+
+/* Called with in the pinctrl_handler thread context.  Restarts the pool with
+ * 'n_threads' threads if its size changed. */
+static void
+pinctrl_workers_resize(struct pinctrl_workers *workers, size_t n_threads)
+{
+    if (n_threads == workers->n_threads) {
+        return;
+    }
+
+    pinctrl_workers_stop(workers);
+    if (!n_threads) {
+        return;
+    }
+
+    workers->threads = xmalloc(n_threads * sizeof *workers->threads);
+    for (size_t i = 0; i < n_threads; i++) {
+        workers->threads[i] = ovs_thread_create("ovn_pinctrl_worker",
+                                                pinctrl_worker, workers);
+    }
+    workers->n_threads = n_threads;
+}
+
+static void
+pinctrl_workers_destroy(struct pinctrl_workers *workers)
+{
+    pinctrl_workers_stop(workers);
+    ovs_mutex_lock(&workers->mutex);
+    pinctrl_pin_queue_clear(&workers->queue);
+    ovs_mutex_unlock(&workers->mutex);
+    xpthread_cond_destroy(&workers->cond);
+    ovs_mutex_destroy(&workers->mutex);
+}
+
+/* Called with in the pinctrl_handler thread context.  Processes the queued
+ * packet-ins of each class in turn and, if there are no workers, a batch of
+ * the PIN_CLASS_REPLY ones.  Wakes up the next iteration immediately if some
+ * packet-ins remain for pinctrl_handler(). */
+static void
+pinctrl_process_packet_ins(struct rconn *swconn,
+                           struct pinctrl_pin_queue queues[PIN_CLASS_MAX],
+                           struct pinctrl_workers *workers)
+{
+    struct pinctrl_pin *p;
+
+    for (size_t i = 0; i < PIN_CLASS_REPLY; i++) {
+        while ((p = pinctrl_pin_queue_pop(&queues[i]))) {
+            process_packet_in(swconn, p);
+            pinctrl_pin_destroy(p);
+        }
+    }
+
+    if (workers->n_threads) {
+        return;
+    }
+    for (size_t i = 0; i < PINCTRL_REPLY_BATCH; i++) {
+        ovs_mutex_lock(&workers->mutex);
+        p = pinctrl_pin_queue_pop(&workers->queue);
+        ovs_mutex_unlock(&workers->mutex);
+        if (!p) {
+            return;
+        }
+        process_packet_in(swconn, p);
+        pinctrl_pin_destroy(p);
+    }
+    poll_immediate_wake();
+}
+
 /* Called with in the main ovn-controller thread context. */
 static void
 notify_pinctrl_handler(void)
@@ -3266,7 +4291,6 @@ notify_pinctrl_main(void)
 
 static void
 pinctrl_rconn_setup(struct rconn *swconn, const char *br_int_name)
-    OVS_REQUIRES(pinctrl_mutex)
 {
     if (br_int_name) {
         char *target = xasprintf("unix:%s/%s.mgmt", ovs_rundir(), br_int_name);
@@ -3281,6 +4305,163 @@ pinctrl_rconn_setup(struct rconn *swconn, const char *br_int_name)
     }
 }
 
+/* Called with in the pinctrl_handler thread context.  Handles the timers in
+ * 'pinctrl_timers' that expired.  The packet-outs to send are appended to
+ * 'txq'. */
+static void
+pinctrl_timers_run(struct rconn *swconn, struct ovs_list *txq)
+    OVS_REQUIRES(pinctrl_mutex)
+{
+    long long int now = time_msec();
+    struct timer_wheel_node *node;
+
+    while ((node = timer_wheel_pop(&pinctrl_timers, now))) {
+        struct pinctrl_timer *timer
+            = CONTAINER_OF(node, struct pinctrl_timer, node);
+
+        switch (timer->type) {
+        case PINCTRL_TIMER_GARP_RARP:
+            send_garp_rarp_expired(swconn, txq, timer, now);
+            break;
+        case PINCTRL_TIMER_MCAST_QUERY:
+            ip_mcast_querier_expired(swconn, txq, timer, now);
+            break;
+        case PINCTRL_TIMER_SVC_MONITOR:
+            svc_monitor_expired(swconn, txq, timer, now);
+            break;
+        default:
+            OVS_NOT_REACHED();
+        }
+    }
+}
+
+/* Bridge that pinctrl_bfd_handler() connects to, a copy of
+ * 'pinctrl.br_int_name'. */
+static char *bfd_br_int_name OVS_GUARDED_BY(bfd_mutex);
+
+/* The thread that serves the BFD sessions when "ovn-bfd-thread" is
+ * enabled.  Owned by the pinctrl_handler thread. */
+struct pinctrl_bfd_thread {
+    pthread_t thread;
+    struct latch exit;
+    bool running;
+};
+
+/* Sets up 'swconn', the newly (re)connected connection of
+ * pinctrl_bfd_handler(), to receive the packet-ins of the bfd_msg action
+ * only. */
+static void
+pinctrl_bfd_setup(struct rconn *swconn)
+{
+    pinctrl_setup(swconn);
+
+    struct ofpbuf *msg = ofpraw_alloc(OFPRAW_NXT_SET_CONTROLLER_ID,
+                                      rconn_get_version(swconn), 0);
+    struct nx_controller_id *nci = ofpbuf_put_zeros(msg, sizeof *nci);
+    nci->controller_id = htons(PINCTRL_BFD_CONTROLLER_ID);
+    queue_msg(swconn, msg);
+}
+
+/* Called with in the pinctrl_bfd_handler thread context.  Takes ownership
+ * of 'msg'. */
+static void
+pinctrl_bfd_recv(struct rconn *swconn, struct ofpbuf *msg)
+{
+    const struct ofp_header *oh = msg->data;
+    enum ofptype type;
+
+    ofptype_decode(&type, oh);
+    if (type == OFPTYPE_PACKET_IN) {
+        struct pinctrl_pin *p = pinctrl_pin_create(msg);
+        if (p) {
+            if (p->opcode == ACTION_OPCODE_BFD_MSG) {
+                process_packet_in(swconn, p);
+            }
+            pinctrl_pin_destroy(p);
+        }
+        return;
+    }
+
+    pinctrl_recv_switch_msg(swconn, oh, type);
+    ofpbuf_delete(msg);
+}
+
+/* pinctrl_bfd_handler pthread function. */
+static void *
+pinctrl_bfd_handler(void *bt_)
+{
+    struct pinctrl_bfd_thread *bt = bt_;
+    struct rconn *swconn = rconn_create(5, 0, DSCP_DEFAULT,
+                                        1 << OFP15_VERSION);
+    unsigned int conn_seq_no = 0;
+
+    while (!latch_is_set(&bt->exit)) {
+        long long int timers_time = LLONG_MAX;
+
+        ovs_mutex_lock(&bfd_mutex);
+        pinctrl_rconn_setup(swconn, bfd_br_int_name);
+        ovs_mutex_unlock(&bfd_mutex);
+
+        rconn_run(swconn);
+        if (rconn_is_connected(swconn)) {
+            if (conn_seq_no != rconn_get_connection_seqno(swconn)) {
+                pinctrl_bfd_setup(swconn);
+                conn_seq_no = rconn_get_connection_seqno(swconn);
+            }
+
+            /* Handle the received control packets before sending ours, so
+             * that the replies to polls go out first. */
+            for (int i = 0; i < PINCTRL_RECV_BATCH; i++) {
+                struct ofpbuf *msg = rconn_recv(swconn);
+                if (!msg) {
+                    break;
+                }
+                pinctrl_bfd_recv(swconn, msg);
+            }
+
+            struct ovs_list txq = OVS_LIST_INITIALIZER(&txq);
+            ovs_mutex_lock(&bfd_mutex);
+            bfd_timers_run(swconn, &txq);
+            timers_time = timer_wheel_next(&bfd_timers);
+            ovs_mutex_unlock(&bfd_mutex);
+            pinctrl_txq_flush(swconn, &txq);
+        }
+
+        rconn_run_wait(swconn);
+        rconn_recv_wait(swconn);
+        if (timers_time != LLONG_MAX) {
+            poll_timer_wait_until(timers_time);
+        }
+        seq_wait(pinctrl_handler_seq, seq_read(pinctrl_handler_seq));
+        latch_wait(&bt->exit);
+        poll_block();
+    }
+
+    rconn_destroy(swconn);
+    return NULL;
+}
+
+/* Called with in the pinctrl_handler thread context.  Starts or stops the
+ * BFD thread according to 'enabled'. */
+static void
+pinctrl_bfd_thread_set(struct pinctrl_bfd_thread *bt, bool enabled)
+{
+    if (enabled == bt->running) {
+        return;
+    }
+
+    if (enabled) {
+        latch_init(&bt->exit);
+        bt->thread = ovs_thread_create("ovn_pinctrl_bfd",
+                                       pinctrl_bfd_handler, bt);
+    } else {
+        latch_set(&bt->exit);
+        xpthread_join(bt->thread, NULL);
+        latch_destroy(&bt->exit);
+    }
+    bt->running = enabled;
+}
+
 /* pinctrl_handler pthread function. */
 static void *
 pinctrl_handler(void *arg_)
@@ -3296,23 +4477,35 @@ pinctrl_handler(void *arg_)
 
     /* Next IPV6 RA in seconds. */
     static long long int send_ipv6_ra_time = LLONG_MAX;
-    /* Next GARP/RARP announcement in ms. */
-    static long long int send_garp_rarp_time = LLONG_MAX;
-    /* Next multicast query (IGMP) in ms. */
-    static long long int send_mcast_query_time = LLONG_MAX;
-    static long long int svc_monitors_next_run_time = LLONG_MAX;
     static long long int send_prefixd_time = LLONG_MAX;
 
+    /* Queued packet-ins, except the PIN_CLASS_REPLY ones that are queued for
+     * 'workers'. */
+    struct pinctrl_pin_queue queues[PIN_CLASS_MAX];
+    struct pinctrl_workers workers;
+    struct pinctrl_bfd_thread bfd_thread = { .running = false };
+
     swconn = rconn_create(5, 0, DSCP_DEFAULT, 1 << OFP15_VERSION);
+    for (size_t i = 0; i < PIN_CLASS_MAX; i++) {
+        pinctrl_pin_queue_init(&queues[i]);
+    }
+    pinctrl_workers_init(&workers, swconn);
 
     while (!latch_is_set(&pctrl->pinctrl_thread_exit)) {
-        long long int bfd_time = LLONG_MAX;
+        long long int timers_time = LLONG_MAX;
+        bool bfd_thread_enabled;
+        size_t n_workers;
 
         ovs_mutex_lock(&pinctrl_mutex);
         pinctrl_rconn_setup(swconn, pctrl->br_int_name);
         ip_mcast_snoop_run();
+        n_workers = pctrl->n_workers;
+        bfd_thread_enabled = pctrl->bfd_thread;
         ovs_mutex_unlock(&pinctrl_mutex);
 
+        pinctrl_workers_resize(&workers, n_workers);
+        pinctrl_bfd_thread_set(&bfd_thread, bfd_thread_enabled);
+
         rconn_run(swconn);
         if (rconn_is_connected(swconn)) {
             if (conn_seq_no != rconn_get_connection_seqno(swconn)) {
@@ -3320,45 +4513,47 @@ pinctrl_handler(void *arg_)
                 conn_seq_no = rconn_get_connection_seqno(swconn);
             }
 
-            for (int i = 0; i < 50; i++) {
+            for (int i = 0; i < PINCTRL_RECV_BATCH; i++) {
                 struct ofpbuf *msg = rconn_recv(swconn);
                 if (!msg) {
                     break;
                 }
-
-                const struct ofp_header *oh = msg->data;
-                enum ofptype type;
-
-                ofptype_decode(&type, oh);
-                pinctrl_recv(swconn, oh, type);
-                ofpbuf_delete(msg);
+                pinctrl_recv(swconn, msg, queues, &workers);
             }
+            pinctrl_pin_record_depths(queues, &workers);
+            pinctrl_process_packet_ins(swconn, queues, &workers);
 
             if (may_inject_pkts()) {
                 ovs_mutex_lock(&pinctrl_mutex);
-                send_garp_rarp_run(swconn, &send_garp_rarp_time);
                 send_ipv6_ras(swconn, &send_ipv6_ra_time);
                 send_ipv6_prefixd(swconn, &send_prefixd_time);
                 send_mac_binding_buffered_pkts(swconn);
-                bfd_monitor_send_msg(swconn, &bfd_time);
                 ovs_mutex_unlock(&pinctrl_mutex);
+            }
 
-                ip_mcast_querier_run(swconn, &send_mcast_query_time);
+            struct ovs_list txq = OVS_LIST_INITIALIZER(&txq);
+            ovs_mutex_lock(&pinctrl_mutex);
+            pinctrl_timers_run(swconn, &txq);
+            timers_time = timer_wheel_next(&pinctrl_timers);
+            ovs_mutex_unlock(&pinctrl_mutex);
+            if (!bfd_thread.running) {
+                ovs_mutex_lock(&bfd_mutex);
+                bfd_timers_run(swconn, &txq);
+                timers_time = MIN(timers_time, timer_wheel_next(&bfd_timers));
+                ovs_mutex_unlock(&bfd_mutex);
             }
+            pinctrl_txq_flush(swconn, &txq);
         }
-
-        ovs_mutex_lock(&pinctrl_mutex);
-        svc_monitors_run(swconn, &svc_monitors_next_run_time);
-        ovs_mutex_unlock(&pinctrl_mutex);
+        acl_log_run();
 
         rconn_run_wait(swconn);
         rconn_recv_wait(swconn);
-        send_garp_rarp_wait(send_garp_rarp_time);
         ipv6_ra_wait(send_ipv6_ra_time);
-        ip_mcast_querier_wait(send_mcast_query_time);
-        svc_monitors_wait(svc_monitors_next_run_time);
         ipv6_prefixd_wait(send_prefixd_time);
-        bfd_monitor_wait(bfd_time);
+        acl_log_wait();
+        if (timers_time != LLONG_MAX) {
+            poll_timer_wait_until(timers_time);
+        }
 
         new_seq = seq_read(pinctrl_handler_seq);
         seq_wait(pinctrl_handler_seq, new_seq);
@@ -3367,6 +4562,11 @@ pinctrl_handler(void *arg_)
         poll_block();
     }
 
+    pinctrl_bfd_thread_set(&bfd_thread, false);
+    pinctrl_workers_destroy(&workers);
+    for (size_t i = 0; i < PIN_CLASS_MAX; i++) {
+        pinctrl_pin_queue_clear(&queues[i]);
+    }
     rconn_destroy(swconn);
     return NULL;
 }
@@ -3379,6 +4579,12 @@ pinctrl_set_br_int_name_(char *br_int_name)
                                                        br_int_name))) {
         free(pinctrl.br_int_name);
         pinctrl.br_int_name = xstrdup(br_int_name);
+
+        ovs_mutex_lock(&bfd_mutex);
+        free(bfd_br_int_name);
+        bfd_br_int_name = xstrdup(br_int_name);
+        ovs_mutex_unlock(&bfd_mutex);
+
         /* Notify pinctrl_handler that integration bridge is
          * set/changed. */
         notify_pinctrl_handler();
@@ -3393,6 +4599,99 @@ pinctrl_set_br_int_name(char *br_int_name)
     ovs_mutex_unlock(&pinctrl_mutex);
 }
 
+/* Sets the number of threads that process the packet-ins that are answered
+ * from their own contents, e.g., DHCP requests.  With 0, they are processed
+ * by the pinctrl_handler thread. */
+void
+pinctrl_set_n_workers(size_t n_workers)
+{
+    n_workers = MIN(n_workers, PINCTRL_MAX_WORKERS);
+
+    ovs_mutex_lock(&pinctrl_mutex);
+    if (n_workers != pinctrl.n_workers) {
+        pinctrl.n_workers = n_workers;
+        notify_pinctrl_handler();
+    }
+    ovs_mutex_unlock(&pinctrl_mutex);
+}
+
+/* Enables or disables the dedicated BFD thread.  Returns true if the setting
+ * changed, in which case the bfd_msg actions have to be encoded again with
+ * the controller id returned by pinctrl_bfd_controller_id(). */
+bool
+pinctrl_set_bfd_thread(bool enabled)
+{
+    bool changed;
+
+    ovs_mutex_lock(&pinctrl_mutex);
+    changed = enabled != pinctrl.bfd_thread;
+    if (changed) {
+        pinctrl.bfd_thread = enabled;
+        notify_pinctrl_handler();
+    }
+    ovs_mutex_unlock(&pinctrl_mutex);
+    return changed;
+}
+
+/* Returns the controller id that the bfd_msg actions must send their
+ * packet-ins to. */
+uint16_t
+pinctrl_bfd_controller_id(void)
+{
+    bool enabled;
+
+    ovs_mutex_lock(&pinctrl_mutex);
+    enabled = pinctrl.bfd_thread;
+    ovs_mutex_unlock(&pinctrl_mutex);
+    return enabled ? PINCTRL_BFD_CONTROLLER_ID : 0;
+}
+
+/* Sets the maximum number of packets buffered per destination while its MAC
+ * address is resolved, 'depth', and the memory that the packets buffered for
+ * all destinations may use, 'max_bytes'.  Packets already buffered are kept
+ * even if they exceed the new limits. */
+void
+pinctrl_set_buffered_packets_limits(size_t depth, size_t max_bytes)
+{
+    ovs_mutex_lock(&pinctrl_mutex);
+    buffered_packets_depth = depth;
+    buffered_packets_max_bytes = max_bytes;
+    ovs_mutex_unlock(&pinctrl_mutex);
+}
+
+/* Formats the occupancy and the limits of the buffered packets into 's'. */
+void
+pinctrl_get_buffered_packets_stats(struct ds *s)
+{
+    ovs_mutex_lock(&pinctrl_mutex);
+    ds_put_format(s, "Destinations: %"PRIuSIZE" pending, %"PRIuSIZE
+                  " resolved\n", hmap_count(&buffered_packets_map),
+                  ovs_list_size(&buffered_mac_bindings));
+    ds_put_format(s, "Packets: %"PRIuSIZE" (max %"PRIuSIZE
+                  " per destination)\n",
+                  buffered_packets_n_packets, buffered_packets_depth);
+    ds_put_format(s, "Memory: %"PRIuSIZE" bytes (max %"PRIuSIZE")\n",
+                  buffered_packets_n_bytes, buffered_packets_max_bytes);
+    ovs_mutex_unlock(&pinctrl_mutex);
+}
+
+void
+pinctrl_get_memory_usage(struct simap *usage)
+{
+    ovs_mutex_lock(&pinctrl_mutex);
+    size_t n_destinations = hmap_count(&buffered_packets_map)
+                            + ovs_list_size(&buffered_mac_bindings);
+    size_t bytes = buffered_packets_n_bytes
+                   + ovn_hmap_buckets_size(&buffered_packets_map)
+                   + n_destinations * sizeof(struct buffered_packets);
+
+    simap_increase(usage, "pinctrl-buffered-packets",
+                   buffered_packets_n_packets);
+    simap_increase(usage, "pinctrl-buffered-packets-KB",
+                   ROUND_UP(bytes, 1024) / 1024);
+    ovs_mutex_unlock(&pinctrl_mutex);
+}
+
 /* Called by ovn-controller. */
 void
 pinctrl_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
@@ -3413,13 +4712,18 @@ pinctrl_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
             const struct hmap *local_datapaths,
             const struct sset *active_tunnels)
 {
-    ovs_mutex_lock(&pinctrl_mutex);
-    pinctrl_set_br_int_name_(br_int->name);
+    /* These only need 'pinctrl_put_mutex', briefly, and don't hold up the
+     * pinctrl_handler thread while they update the database. */
     run_put_mac_bindings(ovnsb_idl_txn, sbrec_datapath_binding_by_key,
                          sbrec_port_binding_by_key,
                          sbrec_mac_binding_by_lport_ip);
     run_put_vport_bindings(ovnsb_idl_txn, sbrec_datapath_binding_by_key,
                            sbrec_port_binding_by_key, chassis);
+    run_put_fdbs(ovnsb_idl_txn, sbrec_fdb_by_dp_key_mac);
+    sync_dns_cache(dns_table);
+
+    ovs_mutex_lock(&pinctrl_mutex);
+    pinctrl_set_br_int_name_(br_int->name);
     send_garp_rarp_prepare(ovnsb_idl_txn, sbrec_port_binding_by_datapath,
                            sbrec_port_binding_by_name,
                            sbrec_mac_binding_by_lport_ip, br_int, chassis,
@@ -3427,7 +4731,6 @@ pinctrl_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
     prepare_ipv6_ras(local_datapaths);
     prepare_ipv6_prefixd(ovnsb_idl_txn, sbrec_port_binding_by_name,
                          local_datapaths, chassis, active_tunnels);
-    sync_dns_cache(dns_table);
     controller_event_run(ovnsb_idl_txn, ce_table, chassis);
     ip_mcast_sync(ovnsb_idl_txn, chassis, local_datapaths,
                   sbrec_datapath_binding_by_key,
@@ -3440,7 +4743,6 @@ pinctrl_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
                       chassis);
     bfd_monitor_run(ovnsb_idl_txn, bfd_table, sbrec_port_binding_by_name,
                     chassis, active_tunnels);
-    run_put_fdbs(ovnsb_idl_txn, sbrec_fdb_by_dp_key_mac);
     ovs_mutex_unlock(&pinctrl_mutex);
 }
 
@@ -3965,6 +5267,7 @@ pinctrl_wait(struct ovsdb_idl_txn *ovnsb_idl_txn)
     int64_t new_seq = seq_read(pinctrl_main_seq);
     seq_wait(pinctrl_main_seq, new_seq);
     wait_put_fdbs(ovnsb_idl_txn);
+    wait_ip_mcast_sync(ovnsb_idl_txn);
 }
 
 /* Called by ovn-controller. */
@@ -3975,12 +5278,16 @@ pinctrl_destroy(void)
     pthread_join(pinctrl.pinctrl_thread, NULL);
     latch_destroy(&pinctrl.pinctrl_thread_exit);
     free(pinctrl.br_int_name);
+    ovs_mutex_lock(&pinctrl_mutex);
+    timer_wheel_destroy(&pinctrl_timers);
+    ovs_mutex_unlock(&pinctrl_mutex);
     destroy_send_garps_rarps();
     destroy_ipv6_ras();
     destroy_ipv6_prefixd();
     destroy_buffered_packets_map();
     event_table_destroy();
     destroy_put_mac_bindings();
+    pinctrl_pin_stats_destroy();
     destroy_put_vport_bindings();
     destroy_dns_cache();
     ip_mcast_snoop_destroy();
@@ -3998,25 +5305,118 @@ pinctrl_destroy(void)
  *
  * This code could be a lot simpler if the database could always be updated,
  * but in fact we can only update it when 'ovnsb_idl_txn' is nonnull.  Thus,
- * we buffer up a few put_mac_bindings (but we don't keep them longer
- * than 1 second) and apply them whenever a database transaction is
- * available. */
+ * we buffer up a few put_mac_bindings and apply them whenever a database
+ * transaction is available.
+ *
+ * A host that scans a subnet makes every router on its way learn a binding
+ * per address, so the bindings are also coalesced and batched: a binding
+ * learned again before it is written only updates the pending one, the
+ * pending bindings are written at most once every
+ * 'mac_binding_flush_interval' ms, and each datapath may learn at most
+ * 'mac_binding_rate' new bindings per second. */
 
 /* Buffered "put_mac_binding" operation. */
 
 /* Contains "struct mac_binding"s. */
-static struct hmap put_mac_bindings;
+static struct mac_binding_table put_mac_bindings;
+
+/* Tokens withdrawn from a datapath's bucket per learned binding, so that
+ * the rate of the bucket, in tokens per ms, is the rate in bindings per
+ * second. */
+#define MAC_BINDING_RATE_TOKENS 1000
+
+/* The learning rate limit of a datapath, in 'mac_binding_rates'. */
+struct mac_binding_rate {
+    struct hmap_node hmap_node; /* Hashed on 'dp_key'. */
+    uint32_t dp_key;
+    struct token_bucket tb;
+};
+
+/* Contains "struct mac_binding_rate"s, protected by pinctrl_put_mutex. */
+static struct hmap mac_binding_rates;
+
+/* Maximum number of new bindings learned per datapath per second, 0 for no
+ * limit.  Protected by pinctrl_put_mutex. */
+static unsigned int mac_binding_rate;
+
+/* Minimum time between two writes of the pending bindings, in ms, and the
+ * time of the next write of the pending bindings and FDB entries.
+ * Protected by pinctrl_put_mutex. */
+static unsigned int mac_binding_flush_interval;
+static long long int mac_binding_next_flush;
+static long long int fdb_next_flush;
+
+static void
+mac_binding_rates_clear(void)
+    OVS_REQUIRES(pinctrl_put_mutex)
+{
+    struct mac_binding_rate *rate;
+    HMAP_FOR_EACH_POP (rate, hmap_node, &mac_binding_rates) {
+        free(rate);
+    }
+}
 
 static void
 init_put_mac_bindings(void)
 {
     ovn_mac_bindings_init(&put_mac_bindings);
+    hmap_init(&mac_binding_rates);
 }
 
 static void
 destroy_put_mac_bindings(void)
 {
+    ovs_mutex_lock(&pinctrl_put_mutex);
     ovn_mac_bindings_destroy(&put_mac_bindings);
+    mac_binding_rates_clear();
+    hmap_destroy(&mac_binding_rates);
+    ovs_mutex_unlock(&pinctrl_put_mutex);
+}
+
+/* Returns true if datapath 'dp_key' may learn one more binding. */
+static bool
+mac_binding_rate_allow(uint32_t dp_key)
+    OVS_REQUIRES(pinctrl_put_mutex)
+{
+    if (!mac_binding_rate) {
+        return true;
+    }
+
+    struct mac_binding_rate *rate;
+    uint32_t hash = hash_int(dp_key, 0);
+    HMAP_FOR_EACH_WITH_HASH (rate, hmap_node, hash, &mac_binding_rates) {
+        if (rate->dp_key == dp_key) {
+            goto found;
+        }
+    }
+    rate = xmalloc(sizeof *rate);
+    rate->dp_key = dp_key;
+    token_bucket_init(&rate->tb, mac_binding_rate,
+                      OVS_SAT_MUL(mac_binding_rate, MAC_BINDING_RATE_TOKENS));
+    hmap_insert(&mac_binding_rates, &rate->hmap_node, hash);
+
+found:
+    return token_bucket_withdraw(&rate->tb, MAC_BINDING_RATE_TOKENS);
+}
+
+/* Sets the maximum number of new MAC bindings that each datapath learns per
+ * second, 'rate', 0 for no limit, and the minimum time between two writes of
+ * the learned bindings and FDB entries to the MAC_Binding and FDB tables,
+ * 'flush_interval', in ms. */
+void
+pinctrl_set_mac_binding_limits(unsigned int rate, unsigned int flush_interval)
+{
+    ovs_mutex_lock(&pinctrl_put_mutex);
+    if (rate != mac_binding_rate) {
+        mac_binding_rate = rate;
+        mac_binding_rates_clear();
+    }
+    if (flush_interval != mac_binding_flush_interval) {
+        mac_binding_flush_interval = flush_interval;
+        mac_binding_next_flush = 0;
+        fdb_next_flush = 0;
+    }
+    ovs_mutex_unlock(&pinctrl_put_mutex);
 }
 
 /* Called with in the pinctrl_handler thread context. */
@@ -4024,7 +5424,7 @@ static void
 pinctrl_handle_put_mac_binding(const struct flow *md,
                                const struct flow *headers,
                                bool is_arp)
-    OVS_REQUIRES(pinctrl_mutex)
+    OVS_REQUIRES(pinctrl_put_mutex)
 {
     uint32_t dp_key = ntohll(md->metadata);
     uint32_t port_key = md->regs[MFF_LOG_INPORT - MFF_REG0];
@@ -4037,14 +5437,17 @@ pinctrl_handle_put_mac_binding(const struct flow *md,
         memcpy(&ip_key, &ip6, sizeof ip_key);
     }
 
-    struct mac_binding *mb = ovn_mac_binding_add(&put_mac_bindings, dp_key,
-                                                 port_key, &ip_key,
-                                                 headers->dl_src);
-    if (!mb) {
-        COVERAGE_INC(pinctrl_drop_put_mac_binding);
+    /* A binding that is already pending is only updated, so it does not
+     * count against the learning rate of its datapath. */
+    if (!ovn_mac_binding_find(&put_mac_bindings, dp_key, port_key, &ip_key)
+        && !mac_binding_rate_allow(dp_key)) {
+        COVERAGE_INC(pinctrl_drop_put_mac_binding_rate);
         return;
     }
 
+    ovn_mac_binding_add(&put_mac_bindings, dp_key, port_key, &ip_key,
+                        headers->dl_src);
+
     /* We can send the buffered packet once the main ovn-controller
      * thread calls pinctrl_run() and it writes the mac_bindings stored
      * in 'put_mac_bindings' hmap into the Southbound MAC_Binding table. */
@@ -4193,20 +5596,34 @@ run_put_mac_bindings(struct ovsdb_idl_txn *ovnsb_idl_txn,
                      struct ovsdb_idl_index *sbrec_datapath_binding_by_key,
                      struct ovsdb_idl_index *sbrec_port_binding_by_key,
                      struct ovsdb_idl_index *sbrec_mac_binding_by_lport_ip)
-    OVS_REQUIRES(pinctrl_mutex)
+    OVS_EXCLUDED(pinctrl_put_mutex)
 {
     if (!ovnsb_idl_txn) {
         return;
     }
 
+    /* Take the pending bindings, so that the pinctrl_handler thread can
+     * queue new ones while the database is updated. */
+    struct mac_binding_table mac_bindings;
+    ovn_mac_bindings_init(&mac_bindings);
+    ovs_mutex_lock(&pinctrl_put_mutex);
+    if (hmap_is_empty(&put_mac_bindings.bindings)
+        || time_msec() < mac_binding_next_flush) {
+        ovs_mutex_unlock(&pinctrl_put_mutex);
+        return;
+    }
+    ovn_mac_bindings_swap(&mac_bindings, &put_mac_bindings);
+    mac_binding_next_flush = time_msec() + mac_binding_flush_interval;
+    ovs_mutex_unlock(&pinctrl_put_mutex);
+
     const struct mac_binding *mb;
-    HMAP_FOR_EACH (mb, hmap_node, &put_mac_bindings) {
+    LIST_FOR_EACH (mb, list_node, &mac_bindings.lru) {
         run_put_mac_binding(ovnsb_idl_txn, sbrec_datapath_binding_by_key,
                             sbrec_port_binding_by_key,
                             sbrec_mac_binding_by_lport_ip,
                             mb);
     }
-    ovn_mac_bindings_flush(&put_mac_bindings);
+    ovn_mac_bindings_destroy(&mac_bindings);
 }
 
 static void
@@ -4239,7 +5656,7 @@ run_buffered_binding(struct ovsdb_idl_index *sbrec_mac_binding_by_lport_ip,
                         ds_cstr(&ip_s));
                 if (b && ovs_scan(b->mac, ETH_ADDR_SCAN_FMT,
                                   ETH_ADDR_SCAN_ARGS(cur_qp->ea))) {
-                    hmap_remove(&buffered_packets_map, &cur_qp->hmap_node);
+                    buffered_packets_remove(cur_qp);
                     ovs_list_push_back(&buffered_mac_bindings, &cur_qp->list);
                     notify = true;
                 }
@@ -4257,9 +5674,11 @@ run_buffered_binding(struct ovsdb_idl_index *sbrec_mac_binding_by_lport_ip,
 static void
 wait_put_mac_bindings(struct ovsdb_idl_txn *ovnsb_idl_txn)
 {
-    if (ovnsb_idl_txn && !hmap_is_empty(&put_mac_bindings)) {
-        poll_immediate_wake();
+    ovs_mutex_lock(&pinctrl_put_mutex);
+    if (ovnsb_idl_txn && !hmap_is_empty(&put_mac_bindings.bindings)) {
+        poll_timer_wait_until(mac_binding_next_flush);
     }
+    ovs_mutex_unlock(&pinctrl_put_mutex);
 }
 
 
@@ -4278,6 +5697,8 @@ struct garp_rarp_data {
     int backoff;                 /* Backoff for the next announcement. */
     uint32_t dp_key;             /* Datapath used to output this GARP. */
     uint32_t port_key;           /* Port to inject the GARP into. */
+    struct pinctrl_timer timer;  /* Expires at 'announce_time'. */
+    struct pinctrl_po_template po_template;
 };
 
 /* Contains GARPs/RARPs to be sent. Protected by pinctrl_mutex*/
@@ -4292,6 +5713,11 @@ init_send_garps_rarps(void)
 static void
 destroy_send_garps_rarps(void)
 {
+    struct shash_node *node;
+    SHASH_FOR_EACH (node, &send_garp_rarp_data) {
+        struct garp_rarp_data *garp_rarp = node->data;
+        pinctrl_po_template_clear(&garp_rarp->po_template);
+    }
     shash_destroy_free_data(&send_garp_rarp_data);
 }
 
@@ -4299,6 +5725,7 @@ destroy_send_garps_rarps(void)
 static void
 add_garp_rarp(const char *name, const struct eth_addr ea, ovs_be32 ip,
               uint32_t dp_key, uint32_t port_key)
+    OVS_REQUIRES(pinctrl_mutex)
 {
     struct garp_rarp_data *garp_rarp = xmalloc(sizeof *garp_rarp);
     garp_rarp->ea = ea;
@@ -4307,6 +5734,9 @@ add_garp_rarp(const char *name, const struct eth_addr ea, ovs_be32 ip,
     garp_rarp->backoff = 1;
     garp_rarp->dp_key = dp_key;
     garp_rarp->port_key = port_key;
+    pinctrl_timer_init(&garp_rarp->timer, PINCTRL_TIMER_GARP_RARP);
+    pinctrl_timer_schedule(&garp_rarp->timer, garp_rarp->announce_time);
+    pinctrl_po_template_init(&garp_rarp->po_template);
     shash_add(&send_garp_rarp_data, name, garp_rarp);
 
     /* Notify pinctrl_handler so that it can wakeup and process
@@ -4314,6 +5744,19 @@ add_garp_rarp(const char *name, const struct eth_addr ea, ovs_be32 ip,
     notify_pinctrl_handler();
 }
 
+/* Updates the datapath and port that 'garp_rarp' is injected into. */
+static void
+garp_rarp_set_keys(struct garp_rarp_data *garp_rarp, uint32_t dp_key,
+                   uint32_t port_key)
+    OVS_REQUIRES(pinctrl_mutex)
+{
+    if (garp_rarp->dp_key != dp_key || garp_rarp->port_key != port_key) {
+        garp_rarp->dp_key = dp_key;
+        garp_rarp->port_key = port_key;
+        pinctrl_po_template_clear(&garp_rarp->po_template);
+    }
+}
+
 /* Add or update a vif for which GARPs need to be announced. */
 static void
 send_garp_rarp_update(struct ovsdb_idl_txn *ovnsb_idl_txn,
@@ -4321,8 +5764,9 @@ send_garp_rarp_update(struct ovsdb_idl_txn *ovnsb_idl_txn,
                       const struct hmap *local_datapaths,
                       const struct sbrec_port_binding *binding_rec,
                       struct shash *nat_addresses)
+    OVS_REQUIRES(pinctrl_mutex)
 {
-    volatile struct garp_rarp_data *garp_rarp = NULL;
+    struct garp_rarp_data *garp_rarp = NULL;
 
     /* Skip localports as they don't need to be announced */
     if (!strcmp(binding_rec->type, "localport")) {
@@ -4344,8 +5788,9 @@ send_garp_rarp_update(struct ovsdb_idl_txn *ovnsb_idl_txn,
                                                 laddrs->ipv4_addrs[i].addr_s);
                 garp_rarp = shash_find_data(&send_garp_rarp_data, name);
                 if (garp_rarp) {
-                    garp_rarp->dp_key = binding_rec->datapath->tunnel_key;
-                    garp_rarp->port_key = binding_rec->tunnel_key;
+                    garp_rarp_set_keys(garp_rarp,
+                                       binding_rec->datapath->tunnel_key,
+                                       binding_rec->tunnel_key);
                 } else {
                     add_garp_rarp(name, laddrs->ea,
                                   laddrs->ipv4_addrs[i].addr,
@@ -4369,8 +5814,8 @@ send_garp_rarp_update(struct ovsdb_idl_txn *ovnsb_idl_txn,
     garp_rarp = shash_find_data(&send_garp_rarp_data,
                                 binding_rec->logical_port);
     if (garp_rarp) {
-        garp_rarp->dp_key = binding_rec->datapath->tunnel_key;
-        garp_rarp->port_key = binding_rec->tunnel_key;
+        garp_rarp_set_keys(garp_rarp, binding_rec->datapath->tunnel_key,
+                           binding_rec->tunnel_key);
         return;
     }
 
@@ -4404,56 +5849,58 @@ send_garp_rarp_update(struct ovsdb_idl_txn *ovnsb_idl_txn,
 /* Remove a vif from GARP announcements. */
 static void
 send_garp_rarp_delete(const char *lport)
+    OVS_REQUIRES(pinctrl_mutex)
 {
     struct garp_rarp_data *garp_rarp = shash_find_and_delete
                                        (&send_garp_rarp_data, lport);
+    if (garp_rarp) {
+        pinctrl_timer_cancel(&garp_rarp->timer);
+        pinctrl_po_template_clear(&garp_rarp->po_template);
+    }
     free(garp_rarp);
     notify_pinctrl_handler();
 }
 
 /* Called with in the pinctrl_handler thread context. */
 static long long int
-send_garp_rarp(struct rconn *swconn, struct garp_rarp_data *garp_rarp,
-               long long int current_time)
+send_garp_rarp(struct rconn *swconn, struct ovs_list *txq,
+               struct garp_rarp_data *garp_rarp, long long int current_time)
     OVS_REQUIRES(pinctrl_mutex)
 {
     if (current_time < garp_rarp->announce_time) {
         return garp_rarp->announce_time;
     }
 
-    /* Compose a GARP request packet. */
-    uint64_t packet_stub[128 / 8];
-    struct dp_packet packet;
-    dp_packet_use_stub(&packet, packet_stub, sizeof packet_stub);
-    if (garp_rarp->ipv4) {
-        compose_arp(&packet, ARP_OP_REQUEST, garp_rarp->ea, eth_addr_zero,
-                    true, garp_rarp->ipv4, garp_rarp->ipv4);
-    } else {
-        compose_rarp(&packet, garp_rarp->ea);
+    if (!pinctrl_po_template_is_valid(&garp_rarp->po_template, swconn)) {
+        /* Compose a GARP request packet. */
+        uint64_t packet_stub[128 / 8];
+        struct dp_packet packet;
+        dp_packet_use_stub(&packet, packet_stub, sizeof packet_stub);
+        if (garp_rarp->ipv4) {
+            compose_arp(&packet, ARP_OP_REQUEST, garp_rarp->ea, eth_addr_zero,
+                        true, garp_rarp->ipv4, garp_rarp->ipv4);
+        } else {
+            compose_rarp(&packet, garp_rarp->ea);
+        }
+
+        uint64_t ofpacts_stub[4096 / 8];
+        struct ofpbuf ofpacts = OFPBUF_STUB_INITIALIZER(ofpacts_stub);
+        put_load(garp_rarp->dp_key, MFF_LOG_DATAPATH, 0, 64, &ofpacts);
+        put_load(garp_rarp->port_key, MFF_LOG_INPORT, 0, 32, &ofpacts);
+        struct ofpact_resubmit *resubmit = ofpact_put_RESUBMIT(&ofpacts);
+        resubmit->in_port = OFPP_CONTROLLER;
+        resubmit->table_id = OFTABLE_LOG_INGRESS_PIPELINE;
+
+        pinctrl_po_template_set(&garp_rarp->po_template, swconn, &packet,
+                                &ofpacts);
+        dp_packet_uninit(&packet);
+        ofpbuf_uninit(&ofpacts);
     }
 
     /* Inject GARP request. */
-    uint64_t ofpacts_stub[4096 / 8];
-    struct ofpbuf ofpacts = OFPBUF_STUB_INITIALIZER(ofpacts_stub);
-    enum ofp_version version = rconn_get_version(swconn);
-    put_load(garp_rarp->dp_key, MFF_LOG_DATAPATH, 0, 64, &ofpacts);
-    put_load(garp_rarp->port_key, MFF_LOG_INPORT, 0, 32, &ofpacts);
-    struct ofpact_resubmit *resubmit = ofpact_put_RESUBMIT(&ofpacts);
-    resubmit->in_port = OFPP_CONTROLLER;
-    resubmit->table_id = OFTABLE_LOG_INGRESS_PIPELINE;
-
-    struct ofputil_packet_out po = {
-        .packet = dp_packet_data(&packet),
-        .packet_len = dp_packet_size(&packet),
-        .buffer_id = UINT32_MAX,
-        .ofpacts = ofpacts.data,
-        .ofpacts_len = ofpacts.size,
-    };
-    match_set_in_port(&po.flow_metadata, OFPP_CONTROLLER);
-    enum ofputil_protocol proto = ofputil_protocol_from_ofp_version(version);
-    queue_msg(swconn, ofputil_encode_packet_out(&po, proto));
-    dp_packet_uninit(&packet);
-    ofpbuf_uninit(&ofpacts);
+    pinctrl_send_msg(swconn, txq,
+                     pinctrl_po_template_clone(&garp_rarp->po_template,
+                                               NULL));
 
     /* Set the next announcement.  At most 5 announcements are sent for a
      * vif. */
@@ -4462,6 +5909,7 @@ send_garp_rarp(struct rconn *swconn, struct garp_rarp_data *garp_rarp,
         garp_rarp->announce_time = current_time + garp_rarp->backoff * 1000;
     } else {
         garp_rarp->announce_time = LLONG_MAX;
+        pinctrl_po_template_clear(&garp_rarp->po_template);
     }
     return garp_rarp->announce_time;
 }
@@ -4554,14 +6002,43 @@ struct ip_mcast_snoop_cfg {
  */
 struct ip_mcast_snoop {
     struct hmap_node hmap_node;    /* Linkage in the hash map. */
-    struct ovs_list query_node;    /* Linkage in the query list. */
     struct ip_mcast_snoop_cfg cfg; /* Multicast configuration. */
     struct mcast_snooping *ms;     /* Multicast group state. */
     int64_t dp_key;                /* Datapath running the snooping. */
 
     long long int query_time_ms;   /* Next query time in ms. */
+    struct pinctrl_timer query_timer; /* Expires at 'query_time_ms' if the
+                                       * querier is enabled. */
+
+    /* Southbound sync state.  'sync_all' is protected by pinctrl_mutex and
+     * 'dirty_groups' by 'ms->rwlock', as pinctrl_handler() adds the groups
+     * changed by the IGMP/MLD packets without holding pinctrl_mutex. */
+    bool sync_all;                 /* All the groups need to be synced. */
+    struct hmap dirty_groups;      /* Contains "struct ip_mcast_dirty_group"s
+                                    * that need to be synced. */
+
+    /* Statistics, maintained by ip_mcast_sync(). */
+    uint64_t n_created;            /* IGMP_Group records created. */
+    uint64_t n_deleted;            /* IGMP_Group records deleted. */
+    uint64_t n_synced;             /* Groups synced, created or not. */
+    uint64_t n_full_syncs;         /* Syncs of all the groups. */
+};
+
+/* A multicast group that changed since the last sync, in the 'dirty_groups'
+ * of its datapath. */
+struct ip_mcast_dirty_group {
+    struct hmap_node hmap_node;
+    struct in6_addr addr;
 };
 
+/* Maximum number of groups that ip_mcast_sync() writes in a transaction.
+ * The remaining ones are synced by the next transactions. */
+#define IP_MCAST_SYNC_BATCH 1024
+
+/* True if some groups are left to be synced by the next transaction.
+ * Protected by pinctrl_mutex. */
+static bool ip_mcast_sync_pending;
+
 /*
  * Holds the per-datapath multicast configuration state. Maintained by
  * pinctrl_run().
@@ -4584,11 +6061,6 @@ static const uint8_t mld_router_alert[4] = {0x05, 0x02, 0x00, 0x00};
  */
 static struct hmap mcast_snoop_map OVS_GUARDED_BY(pinctrl_mutex);
 
-/* Contains multicast queries to be sent. Only used by pinctrl_handler so no
- * locking needed.
- */
-static struct ovs_list mcast_query_list;
-
 /* Multicast config information stored independently by datapath key.
  * Protected by pinctrl_mutex. pinctrl_handler has RO access and pinctrl_main
  * has RW access. Read accesses from pinctrl_ip_mcast_handle() can be
@@ -4799,32 +6271,48 @@ ip_mcast_snoop_disable(struct ip_mcast_snoop *ip_ms)
         return;
     }
 
+    struct ip_mcast_dirty_group *dirty;
+    HMAP_FOR_EACH_POP (dirty, hmap_node, &ip_ms->dirty_groups) {
+        free(dirty);
+    }
     mcast_snooping_unref(ip_ms->ms);
     ip_ms->ms = NULL;
 }
 
+/* Records that group 'addr' of 'ip_ms' needs to be synced. */
+static void
+ip_mcast_snoop_mark_dirty(struct ip_mcast_snoop *ip_ms,
+                          const struct in6_addr *addr)
+    OVS_REQ_WRLOCK(ip_ms->ms->rwlock)
+{
+    struct ip_mcast_dirty_group *dirty;
+    uint32_t hash = hash_bytes(addr, sizeof *addr, 0);
+
+    HMAP_FOR_EACH_WITH_HASH (dirty, hmap_node, hash, &ip_ms->dirty_groups) {
+        if (ipv6_addr_equals(&dirty->addr, addr)) {
+            return;
+        }
+    }
+    dirty = xmalloc(sizeof *dirty);
+    dirty->addr = *addr;
+    hmap_insert(&ip_ms->dirty_groups, &dirty->hmap_node, hash);
+}
+
 static bool
 ip_mcast_snoop_configure(struct ip_mcast_snoop *ip_ms,
                          const struct ip_mcast_snoop_cfg *cfg)
+    OVS_REQUIRES(pinctrl_mutex)
 {
+    if (cfg->enabled != ip_ms->cfg.enabled) {
+        ip_ms->sync_all = true;
+    }
     if (cfg->enabled) {
         if (!ip_mcast_snoop_enable(ip_ms)) {
             return false;
         }
         if (ip_ms->cfg.seq_no != cfg->seq_no) {
             ip_mcast_snoop_flush(ip_ms);
-        }
-
-        bool old_querier_enabled =
-            (ip_ms->cfg.querier_v4_enabled || ip_ms->cfg.querier_v6_enabled);
-
-        bool querier_enabled =
-            (cfg->querier_v4_enabled || cfg->querier_v6_enabled);
-
-        if (old_querier_enabled && !querier_enabled) {
-            ovs_list_remove(&ip_ms->query_node);
-        } else if (!old_querier_enabled && querier_enabled) {
-            ovs_list_push_back(&mcast_query_list, &ip_ms->query_node);
+            ip_ms->sync_all = true;
         }
     } else {
         ip_mcast_snoop_disable(ip_ms);
@@ -4851,6 +6339,12 @@ ip_mcast_snoop_configure(struct ip_mcast_snoop *ip_ms,
 
 set_fields:
     memcpy(&ip_ms->cfg, cfg, sizeof ip_ms->cfg);
+    if (cfg->enabled && (cfg->querier_v4_enabled
+                         || cfg->querier_v6_enabled)) {
+        pinctrl_timer_schedule(&ip_ms->query_timer, ip_ms->query_time_ms);
+    } else {
+        pinctrl_timer_cancel(&ip_ms->query_timer);
+    }
     return true;
 }
 
@@ -4861,7 +6355,11 @@ ip_mcast_snoop_add(int64_t dp_key, const struct ip_mcast_snoop_cfg *cfg)
     struct ip_mcast_snoop *ip_ms = xzalloc(sizeof *ip_ms);
 
     ip_ms->dp_key = dp_key;
+    pinctrl_timer_init(&ip_ms->query_timer, PINCTRL_TIMER_MCAST_QUERY);
+    hmap_init(&ip_ms->dirty_groups);
+    ip_ms->sync_all = true;
     if (!ip_mcast_snoop_configure(ip_ms, cfg)) {
+        hmap_destroy(&ip_ms->dirty_groups);
         free(ip_ms);
         return NULL;
     }
@@ -4891,12 +6389,9 @@ ip_mcast_snoop_remove(struct ip_mcast_snoop *ip_ms)
     OVS_REQUIRES(pinctrl_mutex)
 {
     hmap_remove(&mcast_snoop_map, &ip_ms->hmap_node);
-
-    if (ip_ms->cfg.querier_v4_enabled || ip_ms->cfg.querier_v6_enabled) {
-        ovs_list_remove(&ip_ms->query_node);
-    }
-
+    pinctrl_timer_cancel(&ip_ms->query_timer);
     ip_mcast_snoop_disable(ip_ms);
+    hmap_destroy(&ip_ms->dirty_groups);
     free(ip_ms);
 }
 
@@ -4905,7 +6400,6 @@ ip_mcast_snoop_init(void)
     OVS_NO_THREAD_SAFETY_ANALYSIS
 {
     hmap_init(&mcast_snoop_map);
-    ovs_list_init(&mcast_query_list);
     hmap_init(&mcast_cfg_map);
 }
 
@@ -4960,9 +6454,11 @@ ip_mcast_snoop_run(void)
             continue;
         }
 
-        /* If enabled run the snooping instance to timeout old groups. */
+        /* If enabled run the snooping instance to timeout old groups.  The
+         * groups that expired are not known, so they are all synced. */
         if (ip_ms->cfg.enabled) {
             if (mcast_snooping_run(ip_ms->ms)) {
+                ip_ms->sync_all = true;
                 notify = true;
             }
 
@@ -4994,6 +6490,107 @@ ip_mcast_flush_groups(int64_t dp_key, const struct sbrec_chassis *chassis,
     }
 }
 
+/* Flushes the IGMP_Groups installed by the local chassis, on the datapaths
+ * of 'ip_mss', that are not needed anymore:
+ * - either multicast snooping was disabled on the datapath
+ * - or the group has expired.
+ */
+static void
+ip_mcast_flush_stale_groups(const struct sbrec_chassis *chassis,
+                            struct ovsdb_idl_index *sbrec_igmp_groups,
+                            const struct hmapx *ip_mss)
+    OVS_REQUIRES(pinctrl_mutex)
+{
+    const struct sbrec_igmp_group *sbrec_igmp;
+
+    SBREC_IGMP_GROUP_FOR_EACH_BYINDEX (sbrec_igmp, sbrec_igmp_groups) {
+        ovs_be32 group_v4_addr;
+        struct in6_addr group_addr;
+
+        if (!sbrec_igmp->datapath) {
+            continue;
+        }
+
+        /* Skip non-local records. */
+        if (sbrec_igmp->chassis != chassis) {
+            continue;
+        }
+
+        struct ip_mcast_snoop *ip_ms =
+            ip_mcast_snoop_find(sbrec_igmp->datapath->tunnel_key);
+        if (!ip_ms || !hmapx_contains(ip_mss, ip_ms)) {
+            continue;
+        }
+
+        /* If IGMP snooping was disabled on the datapath then delete the
+         * IGMP_Group entry.
+         */
+        if (!ip_ms->cfg.enabled) {
+            igmp_group_delete(sbrec_igmp);
+            ip_ms->n_deleted++;
+            COVERAGE_INC(pinctrl_ip_mcast_group_delete);
+            continue;
+        }
+
+        if (ip_parse(sbrec_igmp->address, &group_v4_addr)) {
+            group_addr = in6_addr_mapped_ipv4(group_v4_addr);
+        } else if (!ipv6_parse(sbrec_igmp->address, &group_addr)) {
+            continue;
+        }
+
+        ovs_rwlock_rdlock(&ip_ms->ms->rwlock);
+        struct mcast_group *mc_group =
+            mcast_snooping_lookup(ip_ms->ms, &group_addr, IP_MCAST_VLAN);
+
+        if (!mc_group || ovs_list_is_empty(&mc_group->bundle_lru)) {
+            igmp_group_delete(sbrec_igmp);
+            ip_ms->n_deleted++;
+            COVERAGE_INC(pinctrl_ip_mcast_group_delete);
+        }
+        ovs_rwlock_unlock(&ip_ms->ms->rwlock);
+    }
+}
+
+/* Writes to the southbound database the IGMP_Group of group 'addr' of
+ * 'ip_ms', or deletes it if the group has expired. */
+static void
+ip_mcast_sync_group(struct ovsdb_idl_txn *ovnsb_idl_txn,
+                    const struct sbrec_chassis *chassis,
+                    const struct sbrec_datapath_binding *datapath,
+                    struct ovsdb_idl_index *sbrec_datapath_binding_by_key,
+                    struct ovsdb_idl_index *sbrec_port_binding_by_key,
+                    struct ovsdb_idl_index *sbrec_igmp_groups,
+                    struct ip_mcast_snoop *ip_ms,
+                    const struct in6_addr *addr)
+    OVS_REQUIRES(pinctrl_mutex)
+    OVS_REQ_RDLOCK(ip_ms->ms->rwlock)
+{
+    struct mcast_group *mc_group =
+        mcast_snooping_lookup(ip_ms->ms, addr, IP_MCAST_VLAN);
+    const struct sbrec_igmp_group *sbrec_igmp =
+        igmp_group_lookup(sbrec_igmp_groups, addr, datapath, chassis);
+
+    if (!mc_group || ovs_list_is_empty(&mc_group->bundle_lru)) {
+        if (sbrec_igmp) {
+            igmp_group_delete(sbrec_igmp);
+            ip_ms->n_deleted++;
+            COVERAGE_INC(pinctrl_ip_mcast_group_delete);
+        }
+        return;
+    }
+
+    if (!sbrec_igmp) {
+        sbrec_igmp = igmp_group_create(ovnsb_idl_txn, addr, datapath,
+                                       chassis);
+        ip_ms->n_created++;
+        COVERAGE_INC(pinctrl_ip_mcast_group_create);
+    }
+    igmp_group_update_ports(sbrec_igmp, sbrec_datapath_binding_by_key,
+                            sbrec_port_binding_by_key, ip_ms->ms, mc_group);
+    ip_ms->n_synced++;
+    COVERAGE_INC(pinctrl_ip_mcast_group_sync);
+}
+
 /*
  * This runs in the pinctrl main thread, so it has access to the southbound
  * database. It reads the IP_Multicast table and updates the local multicast
@@ -5046,100 +6643,239 @@ ip_mcast_sync(struct ovsdb_idl_txn *ovnsb_idl_txn,
         }
     }
 
-    const struct sbrec_igmp_group *sbrec_igmp;
-
-    /* Then flush any IGMP_Group entries that are not needed anymore:
-     * - either multicast snooping was disabled on the datapath
-     * - or the group has expired.
+    /* Then pick the datapaths whose groups are all synced by this
+     * transaction, as long as the batch is not full.
      */
-    SBREC_IGMP_GROUP_FOR_EACH_BYINDEX (sbrec_igmp, sbrec_igmp_groups) {
-        ovs_be32 group_v4_addr;
-        struct in6_addr group_addr;
+    struct hmapx full_syncs = HMAPX_INITIALIZER(&full_syncs);
+    size_t budget = IP_MCAST_SYNC_BATCH;
+    struct ip_mcast_snoop *ip_ms;
 
-        if (!sbrec_igmp->datapath) {
+    ip_mcast_sync_pending = false;
+    HMAP_FOR_EACH (ip_ms, hmap_node, &mcast_snoop_map) {
+        if (!ip_ms->sync_all
+            || !get_local_datapath(local_datapaths, ip_ms->dp_key)) {
             continue;
         }
-
-        /* Skip non-local records. */
-        if (sbrec_igmp->chassis != chassis) {
+        if (!budget) {
+            ip_mcast_sync_pending = true;
             continue;
         }
 
-        /* Skip non-local datapaths. */
-        int64_t dp_key = sbrec_igmp->datapath->tunnel_key;
-        if (!get_local_datapath(local_datapaths, dp_key)) {
-            continue;
+        size_t n_groups = 1;
+        if (ip_ms->cfg.enabled) {
+            ovs_rwlock_rdlock(&ip_ms->ms->rwlock);
+            n_groups = MAX(hmap_count(&ip_ms->ms->table), 1);
+            ovs_rwlock_unlock(&ip_ms->ms->rwlock);
         }
+        budget -= MIN(budget, n_groups);
+        hmapx_add(&full_syncs, ip_ms);
+    }
+
+    /* Then flush, on these datapaths, any IGMP_Group entries that are not
+     * needed anymore.
+     */
+    if (!hmapx_is_empty(&full_syncs)) {
+        ip_mcast_flush_stale_groups(chassis, sbrec_igmp_groups, &full_syncs);
+    }
 
-        struct ip_mcast_snoop *ip_ms = ip_mcast_snoop_find(dp_key);
+    /* Last: write new IGMP_Groups to the southbound DB and update existing
+     * ones (if needed), all of them on the datapaths picked above and only
+     * the ones that changed on the others.
+     */
+    HMAP_FOR_EACH (ip_ms, hmap_node, &mcast_snoop_map) {
+        struct local_datapath *local_dp =
+            get_local_datapath(local_datapaths, ip_ms->dp_key);
+        bool full_sync = hmapx_contains(&full_syncs, ip_ms);
 
-        /* If the datapath doesn't exist anymore or IGMP snooping was disabled
-         * on it then delete the IGMP_Group entry.
-         */
-        if (!ip_ms || !ip_ms->cfg.enabled) {
-            igmp_group_delete(sbrec_igmp);
+        if (full_sync) {
+            ip_ms->sync_all = false;
+            ip_ms->n_full_syncs++;
+            COVERAGE_INC(pinctrl_ip_mcast_full_sync);
+        } else if (ip_ms->sync_all) {
             continue;
         }
 
-        if (ip_parse(sbrec_igmp->address, &group_v4_addr)) {
-            group_addr = in6_addr_mapped_ipv4(group_v4_addr);
-        } else if (!ipv6_parse(sbrec_igmp->address, &group_addr)) {
+        /* Skip non-local datapaths (e.g., stale) and the ones on which
+         * snooping is disabled. */
+        if (!local_dp || !ip_ms->cfg.enabled) {
             continue;
         }
 
-        ovs_rwlock_rdlock(&ip_ms->ms->rwlock);
-        struct mcast_group *mc_group =
-            mcast_snooping_lookup(ip_ms->ms, &group_addr, IP_MCAST_VLAN);
+        struct ip_mcast_dirty_group *dirty;
+        struct mcast_group *mc_group;
 
-        if (!mc_group || ovs_list_is_empty(&mc_group->bundle_lru)) {
-            igmp_group_delete(sbrec_igmp);
+        ovs_rwlock_wrlock(&ip_ms->ms->rwlock);
+        if (full_sync) {
+            HMAP_FOR_EACH_POP (dirty, hmap_node, &ip_ms->dirty_groups) {
+                free(dirty);
+            }
+            LIST_FOR_EACH (mc_group, group_node, &ip_ms->ms->group_lru) {
+                if (ovs_list_is_empty(&mc_group->bundle_lru)) {
+                    continue;
+                }
+                ip_mcast_sync_group(ovnsb_idl_txn, chassis,
+                                    local_dp->datapath,
+                                    sbrec_datapath_binding_by_key,
+                                    sbrec_port_binding_by_key,
+                                    sbrec_igmp_groups, ip_ms,
+                                    &mc_group->addr);
+            }
+        } else {
+            while (budget && !hmap_is_empty(&ip_ms->dirty_groups)) {
+                dirty = CONTAINER_OF(hmap_first(&ip_ms->dirty_groups),
+                                     struct ip_mcast_dirty_group, hmap_node);
+                hmap_remove(&ip_ms->dirty_groups, &dirty->hmap_node);
+                ip_mcast_sync_group(ovnsb_idl_txn, chassis,
+                                    local_dp->datapath,
+                                    sbrec_datapath_binding_by_key,
+                                    sbrec_port_binding_by_key,
+                                    sbrec_igmp_groups, ip_ms, &dirty->addr);
+                free(dirty);
+                budget--;
+            }
+            if (!hmap_is_empty(&ip_ms->dirty_groups)) {
+                ip_mcast_sync_pending = true;
+            }
         }
         ovs_rwlock_unlock(&ip_ms->ms->rwlock);
     }
+    hmapx_destroy(&full_syncs);
 
-    struct ip_mcast_snoop *ip_ms, *ip_ms_next;
+    if (notify) {
+        notify_pinctrl_handler();
+    }
+}
 
-    /* Last: write new IGMP_Groups to the southbound DB and update existing
-     * ones (if needed). We also flush any old per-datapath multicast snoop
-     * structures.
-     */
-    HMAP_FOR_EACH_SAFE (ip_ms, ip_ms_next, hmap_node, &mcast_snoop_map) {
-        /* Flush any non-local snooping datapaths (e.g., stale). */
-        struct local_datapath *local_dp =
-            get_local_datapath(local_datapaths, ip_ms->dp_key);
+static void
+wait_ip_mcast_sync(struct ovsdb_idl_txn *ovnsb_idl_txn)
+{
+    ovs_mutex_lock(&pinctrl_mutex);
+    if (ovnsb_idl_txn && ip_mcast_sync_pending) {
+        poll_immediate_wake();
+    }
+    ovs_mutex_unlock(&pinctrl_mutex);
+}
 
-        if (!local_dp) {
-            continue;
-        }
+/* Makes the next ip_mcast_sync() sync all the groups again, e.g. because the
+ * transaction that wrote the previous changes failed. */
+void
+pinctrl_ip_mcast_resync(void)
+{
+    struct ip_mcast_snoop *ip_ms;
 
-        /* Skip datapaths on which snooping is disabled. */
-        if (!ip_ms->cfg.enabled) {
-            continue;
+    ovs_mutex_lock(&pinctrl_mutex);
+    HMAP_FOR_EACH (ip_ms, hmap_node, &mcast_snoop_map) {
+        ip_ms->sync_all = true;
+    }
+    ovs_mutex_unlock(&pinctrl_mutex);
+}
+
+/* Formats the number of multicast groups of each datapath and the changes
+ * written to the IGMP_Group table into 's'. */
+void
+pinctrl_get_ip_mcast_stats(struct ds *s)
+{
+    struct ip_mcast_snoop *ip_ms;
+
+    ovs_mutex_lock(&pinctrl_mutex);
+    HMAP_FOR_EACH (ip_ms, hmap_node, &mcast_snoop_map) {
+        size_t n_groups = 0;
+        size_t n_dirty = 0;
+
+        if (ip_ms->cfg.enabled) {
+            ovs_rwlock_rdlock(&ip_ms->ms->rwlock);
+            n_groups = hmap_count(&ip_ms->ms->table);
+            n_dirty = hmap_count(&ip_ms->dirty_groups);
+            ovs_rwlock_unlock(&ip_ms->ms->rwlock);
+        }
+        ds_put_format(s, "Datapath %"PRId64": %s, %"PRIuSIZE" groups, %"
+                      PRIuSIZE" pending%s\n", ip_ms->dp_key,
+                      ip_ms->cfg.enabled ? "enabled" : "disabled",
+                      n_groups, n_dirty,
+                      ip_ms->sync_all ? " (full sync)" : "");
+        ds_put_format(s, "  created: %"PRIu64", deleted: %"PRIu64
+                      ", synced: %"PRIu64", full syncs: %"PRIu64"\n",
+                      ip_ms->n_created, ip_ms->n_deleted, ip_ms->n_synced,
+                      ip_ms->n_full_syncs);
+    }
+    ovs_mutex_unlock(&pinctrl_mutex);
+}
+
+/* Records the groups of the IGMPv3 report 'pkt_in' as needing to be synced.
+ * The records are walked the same way as mcast_snooping_add_report() does,
+ * so that all the groups that it may have changed are recorded. */
+static void
+ip_mcast_snoop_mark_igmpv3(struct ip_mcast_snoop *ip_ms,
+                           const struct dp_packet *pkt_in)
+    OVS_REQ_WRLOCK(ip_ms->ms->rwlock)
+{
+    size_t offset = (char *) dp_packet_l4(pkt_in)
+                    - (char *) dp_packet_data(pkt_in);
+    const struct igmpv3_header *igmpv3 =
+        dp_packet_at(pkt_in, offset, IGMPV3_HEADER_LEN);
+    if (!igmpv3) {
+        return;
+    }
+
+    int ngrp = ntohs(igmpv3->ngrp);
+    offset += IGMPV3_HEADER_LEN;
+    while (ngrp--) {
+        const struct igmpv3_record *record =
+            dp_packet_at(pkt_in, offset, sizeof *record);
+        if (!record) {
+            break;
         }
 
-        struct mcast_group *mc_group;
+        struct in6_addr addr =
+            in6_addr_mapped_ipv4(get_16aligned_be32(&record->maddr));
+        ip_mcast_snoop_mark_dirty(ip_ms, &addr);
+        offset += sizeof *record
+                  + ntohs(record->nsrcs) * sizeof(ovs_be32)
+                  + record->aux_len;
+    }
+}
 
-        ovs_rwlock_rdlock(&ip_ms->ms->rwlock);
-        LIST_FOR_EACH (mc_group, group_node, &ip_ms->ms->group_lru) {
-            if (ovs_list_is_empty(&mc_group->bundle_lru)) {
-                continue;
-            }
-            sbrec_igmp = igmp_group_lookup(sbrec_igmp_groups, &mc_group->addr,
-                                           local_dp->datapath, chassis);
-            if (!sbrec_igmp) {
-                sbrec_igmp = igmp_group_create(ovnsb_idl_txn, &mc_group->addr,
-                                               local_dp->datapath, chassis);
-            }
+/* Records the groups of the MLD report or done 'pkt_in' as needing to be
+ * synced, like ip_mcast_snoop_mark_igmpv3() does for IGMPv3. */
+static void
+ip_mcast_snoop_mark_mld(struct ip_mcast_snoop *ip_ms,
+                        const struct dp_packet *pkt_in)
+    OVS_REQ_WRLOCK(ip_ms->ms->rwlock)
+{
+    size_t offset = (char *) dp_packet_l4(pkt_in)
+                    - (char *) dp_packet_data(pkt_in);
+    const struct mld_header *mld = dp_packet_at(pkt_in, offset,
+                                                MLD_HEADER_LEN);
+    if (!mld) {
+        return;
+    }
 
-            igmp_group_update_ports(sbrec_igmp, sbrec_datapath_binding_by_key,
-                                    sbrec_port_binding_by_key, ip_ms->ms,
-                                    mc_group);
+    int ngrp = ntohs(mld->ngrp);
+    offset += MLD_HEADER_LEN;
+    if (mld->type == MLD_REPORT || mld->type == MLD_DONE) {
+        const struct in6_addr *addr =
+            dp_packet_at(pkt_in, offset, sizeof *addr);
+        if (addr) {
+            struct in6_addr group;
+            memcpy(&group, addr, sizeof group);
+            ip_mcast_snoop_mark_dirty(ip_ms, &group);
         }
-        ovs_rwlock_unlock(&ip_ms->ms->rwlock);
+        return;
     }
 
-    if (notify) {
-        notify_pinctrl_handler();
+    while (ngrp--) {
+        const struct mld2_record *record =
+            dp_packet_at(pkt_in, offset, sizeof *record);
+        if (!record) {
+            break;
+        }
+
+        struct in6_addr addr;
+        memcpy(&addr, &record->maddr, sizeof addr);
+        ip_mcast_snoop_mark_dirty(ip_ms, &addr);
+        offset += sizeof *record
+                  + ntohs(record->nsrcs) * sizeof(struct in6_addr)
+                  + record->aux_len;
     }
 }
 
@@ -5171,11 +6907,19 @@ pinctrl_ip_mcast_handle_igmp(struct ip_mcast_snoop *ip_ms,
         group_change =
             mcast_snooping_add_group4(ip_ms->ms, ip4, IP_MCAST_VLAN,
                                       port_key_data);
+        if (group_change) {
+            struct in6_addr addr = in6_addr_mapped_ipv4(ip4);
+            ip_mcast_snoop_mark_dirty(ip_ms, &addr);
+        }
         break;
     case IGMP_HOST_LEAVE_MESSAGE:
         group_change =
             mcast_snooping_leave_group4(ip_ms->ms, ip4, IP_MCAST_VLAN,
                                         port_key_data);
+        if (group_change) {
+            struct in6_addr addr = in6_addr_mapped_ipv4(ip4);
+            ip_mcast_snoop_mark_dirty(ip_ms, &addr);
+        }
         break;
     case IGMP_HOST_MEMBERSHIP_QUERY:
         /* Shouldn't be receiving any of these since we are the multicast
@@ -5189,6 +6933,9 @@ pinctrl_ip_mcast_handle_igmp(struct ip_mcast_snoop *ip_ms,
         group_change =
             mcast_snooping_add_report(ip_ms->ms, pkt_in, IP_MCAST_VLAN,
                                       port_key_data);
+        if (group_change) {
+            ip_mcast_snoop_mark_igmpv3(ip_ms, pkt_in);
+        }
         break;
     }
     ovs_rwlock_unlock(&ip_ms->ms->rwlock);
@@ -5237,6 +6984,9 @@ pinctrl_ip_mcast_handle_mld(struct ip_mcast_snoop *ip_ms,
         group_change =
             mcast_snooping_add_mld(ip_ms->ms, pkt_in, IP_MCAST_VLAN,
                                    port_key_data);
+        if (group_change) {
+            ip_mcast_snoop_mark_mld(ip_ms, pkt_in);
+        }
         break;
     }
     ovs_rwlock_unlock(&ip_ms->ms->rwlock);
@@ -5295,7 +7045,8 @@ pinctrl_ip_mcast_handle(struct rconn *swconn OVS_UNUSED,
 }
 
 static void
-ip_mcast_querier_send_igmp(struct rconn *swconn, struct ip_mcast_snoop *ip_ms)
+ip_mcast_querier_send_igmp(struct rconn *swconn, struct ovs_list *txq,
+                           struct ip_mcast_snoop *ip_ms)
 {
     /* Compose a multicast query. */
     uint64_t packet_stub[128 / 8];
@@ -5337,13 +7088,14 @@ ip_mcast_querier_send_igmp(struct rconn *swconn, struct ip_mcast_snoop *ip_ms)
     };
     match_set_in_port(&po.flow_metadata, OFPP_CONTROLLER);
     enum ofputil_protocol proto = ofputil_protocol_from_ofp_version(version);
-    queue_msg(swconn, ofputil_encode_packet_out(&po, proto));
+    pinctrl_send_msg(swconn, txq, ofputil_encode_packet_out(&po, proto));
     dp_packet_uninit(&packet);
     ofpbuf_uninit(&ofpacts);
 }
 
 static void
-ip_mcast_querier_send_mld(struct rconn *swconn, struct ip_mcast_snoop *ip_ms)
+ip_mcast_querier_send_mld(struct rconn *swconn, struct ovs_list *txq,
+                          struct ip_mcast_snoop *ip_ms)
 {
     /* Compose a multicast query. */
     uint64_t packet_stub[128 / 8];
@@ -5392,25 +7144,25 @@ ip_mcast_querier_send_mld(struct rconn *swconn, struct ip_mcast_snoop *ip_ms)
     };
     match_set_in_port(&po.flow_metadata, OFPP_CONTROLLER);
     enum ofputil_protocol proto = ofputil_protocol_from_ofp_version(version);
-    queue_msg(swconn, ofputil_encode_packet_out(&po, proto));
+    pinctrl_send_msg(swconn, txq, ofputil_encode_packet_out(&po, proto));
     dp_packet_uninit(&packet);
     ofpbuf_uninit(&ofpacts);
 }
 
 static long long int
-ip_mcast_querier_send(struct rconn *swconn, struct ip_mcast_snoop *ip_ms,
-                      long long int current_time)
+ip_mcast_querier_send(struct rconn *swconn, struct ovs_list *txq,
+                      struct ip_mcast_snoop *ip_ms, long long int current_time)
 {
     if (current_time < ip_ms->query_time_ms) {
         return ip_ms->query_time_ms;
     }
 
     if (ip_ms->cfg.querier_v4_enabled) {
-        ip_mcast_querier_send_igmp(swconn, ip_ms);
+        ip_mcast_querier_send_igmp(swconn, txq, ip_ms);
     }
 
     if (ip_ms->cfg.querier_v6_enabled) {
-        ip_mcast_querier_send_mld(swconn, ip_ms);
+        ip_mcast_querier_send_mld(swconn, txq, ip_ms);
     }
 
     /* Set the next query time. */
@@ -5418,34 +7170,18 @@ ip_mcast_querier_send(struct rconn *swconn, struct ip_mcast_snoop *ip_ms,
     return ip_ms->query_time_ms;
 }
 
+/* Called with in the pinctrl_handler thread context. */
 static void
-ip_mcast_querier_run(struct rconn *swconn, long long int *query_time)
+ip_mcast_querier_expired(struct rconn *swconn, struct ovs_list *txq,
+                         struct pinctrl_timer *timer, long long int now)
+    OVS_REQUIRES(pinctrl_mutex)
 {
-    if (ovs_list_is_empty(&mcast_query_list)) {
-        return;
-    }
-
-    /* Send multicast queries and update the next query time. */
-    long long int current_time = time_msec();
-    *query_time = LLONG_MAX;
-
-    struct ip_mcast_snoop *ip_ms;
-
-    LIST_FOR_EACH (ip_ms, query_node, &mcast_query_list) {
-        long long int next_query_time =
-            ip_mcast_querier_send(swconn, ip_ms, current_time);
-        if (*query_time > next_query_time) {
-            *query_time = next_query_time;
-        }
-    }
-}
+    struct ip_mcast_snoop *ip_ms
+        = CONTAINER_OF(timer, struct ip_mcast_snoop, query_timer);
 
-static void
-ip_mcast_querier_wait(long long int query_time)
-{
-    if (!ovs_list_is_empty(&mcast_query_list)) {
-        poll_timer_wait_until(query_time);
-    }
+    /* Send multicast queries and schedule the next ones. */
+    pinctrl_timer_schedule(timer,
+                           ip_mcast_querier_send(swconn, txq, ip_ms, now));
 }
 
 /* Get localnet vifs, local l3gw ports and ofport for localnet patch ports. */
@@ -5669,36 +7405,18 @@ get_nat_addresses_and_keys(struct ovsdb_idl_index *sbrec_port_binding_by_name,
     }
 }
 
-static void
-send_garp_rarp_wait(long long int send_garp_rarp_time)
-{
-    /* Set the poll timer for next garp/rarp only if there is data to
-     * be sent. */
-    if (!shash_is_empty(&send_garp_rarp_data)) {
-        poll_timer_wait_until(send_garp_rarp_time);
-    }
-}
-
 /* Called with in the pinctrl_handler thread context. */
 static void
-send_garp_rarp_run(struct rconn *swconn, long long int *send_garp_rarp_time)
+send_garp_rarp_expired(struct rconn *swconn, struct ovs_list *txq,
+                       struct pinctrl_timer *timer, long long int now)
     OVS_REQUIRES(pinctrl_mutex)
 {
-    if (shash_is_empty(&send_garp_rarp_data)) {
-        return;
-    }
+    struct garp_rarp_data *garp_rarp
+        = CONTAINER_OF(timer, struct garp_rarp_data, timer);
 
-    /* Send GARPs, and update the next announcement. */
-    struct shash_node *iter;
-    long long int current_time = time_msec();
-    *send_garp_rarp_time = LLONG_MAX;
-    SHASH_FOR_EACH (iter, &send_garp_rarp_data) {
-        long long int next_announce = send_garp_rarp(swconn, iter->data,
-                                                     current_time);
-        if (*send_garp_rarp_time > next_announce) {
-            *send_garp_rarp_time = next_announce;
-        }
-    }
+    /* Send the GARP, and schedule the next announcement. */
+    pinctrl_timer_schedule(timer,
+                           send_garp_rarp(swconn, txq, garp_rarp, now));
 }
 
 /* Called by pinctrl_run(). Runs with in the main ovn-controller
@@ -5782,11 +7500,8 @@ static bool
 may_inject_pkts(void)
 {
     return (!shash_is_empty(&ipv6_ras) ||
-            !shash_is_empty(&send_garp_rarp_data) ||
             ipv6_prefixd_should_inject() ||
-            !ovs_list_is_empty(&mcast_query_list) ||
-            !ovs_list_is_empty(&buffered_mac_bindings) ||
-            bfd_monitor_should_inject());
+            !ovs_list_is_empty(&buffered_mac_bindings));
 }
 
 static void
@@ -6171,10 +7886,10 @@ init_put_vport_bindings(void)
 }
 
 static void
-flush_put_vport_bindings(void)
+flush_put_vport_bindings(struct hmap *vport_bindings)
 {
     struct put_vport_binding *vport_b;
-    HMAP_FOR_EACH_POP (vport_b, hmap_node, &put_vport_bindings) {
+    HMAP_FOR_EACH_POP (vport_b, hmap_node, vport_bindings) {
         free(vport_b);
     }
 }
@@ -6182,21 +7897,26 @@ flush_put_vport_bindings(void)
 static void
 destroy_put_vport_bindings(void)
 {
-    flush_put_vport_bindings();
+    ovs_mutex_lock(&pinctrl_put_mutex);
+    flush_put_vport_bindings(&put_vport_bindings);
     hmap_destroy(&put_vport_bindings);
+    ovs_mutex_unlock(&pinctrl_put_mutex);
 }
 
 static void
 wait_put_vport_bindings(struct ovsdb_idl_txn *ovnsb_idl_txn)
 {
+    ovs_mutex_lock(&pinctrl_put_mutex);
     if (ovnsb_idl_txn && !hmap_is_empty(&put_vport_bindings)) {
         poll_immediate_wake();
     }
+    ovs_mutex_unlock(&pinctrl_put_mutex);
 }
 
 static struct put_vport_binding *
 pinctrl_find_put_vport_binding(uint32_t dp_key, uint32_t vport_key,
                                uint32_t hash)
+    OVS_REQUIRES(pinctrl_put_mutex)
 {
     struct put_vport_binding *vpb;
     HMAP_FOR_EACH_WITH_HASH (vpb, hmap_node, hash, &put_vport_bindings) {
@@ -6248,26 +7968,32 @@ run_put_vport_bindings(struct ovsdb_idl_txn *ovnsb_idl_txn,
                       struct ovsdb_idl_index *sbrec_datapath_binding_by_key,
                       struct ovsdb_idl_index *sbrec_port_binding_by_key,
                       const struct sbrec_chassis *chassis)
-    OVS_REQUIRES(pinctrl_mutex)
+    OVS_EXCLUDED(pinctrl_put_mutex)
 {
     if (!ovnsb_idl_txn) {
         return;
     }
 
+    struct hmap vport_bindings = HMAP_INITIALIZER(&vport_bindings);
+    ovs_mutex_lock(&pinctrl_put_mutex);
+    hmap_swap(&vport_bindings, &put_vport_bindings);
+    ovs_mutex_unlock(&pinctrl_put_mutex);
+
     const struct put_vport_binding *vpb;
-    HMAP_FOR_EACH (vpb, hmap_node, &put_vport_bindings) {
+    HMAP_FOR_EACH (vpb, hmap_node, &vport_bindings) {
         run_put_vport_binding(ovnsb_idl_txn, sbrec_datapath_binding_by_key,
                               sbrec_port_binding_by_key, chassis, vpb);
     }
 
-    flush_put_vport_bindings();
+    flush_put_vport_bindings(&vport_bindings);
+    hmap_destroy(&vport_bindings);
 }
 
 /* Called with in the pinctrl_handler thread context. */
 static void
 pinctrl_handle_bind_vport(
     const struct flow *md, struct ofpbuf *userdata)
-    OVS_REQUIRES(pinctrl_mutex)
+    OVS_REQUIRES(pinctrl_put_mutex)
 {
     /* Get the datapath key from the packet metadata. */
     uint32_t dp_key = ntohll(md->metadata);
@@ -6339,6 +8065,10 @@ struct svc_monitor {
     long long int timestamp;
     bool is_ip6;
 
+    /* Source of the health checks, from 'sb_svc_mon'. */
+    struct eth_addr src_ea;
+    ovs_be32 src_ip4;
+
     long long int wait_time;
     long long int next_send_time;
 
@@ -6368,6 +8098,13 @@ struct svc_monitor {
     uint32_t seq_no;
     ovs_be16 tp_src;
 
+    struct pinctrl_timer timer; /* Expires when the state machine has to
+                                 * run next. */
+
+    /* Health check packet-out, with the fields that differ between the
+     * checks set to 0. */
+    struct pinctrl_po_template po_template;
+
     bool delete;
 };
 
@@ -6393,6 +8130,7 @@ destroy_svc_monitors(void)
 
     LIST_FOR_EACH_POP (svc, list_node, &svc_monitors) {
         smap_destroy(&svc->options);
+        pinctrl_po_template_clear(&svc->po_template);
         free(svc);
     }
 }
@@ -6520,14 +8258,32 @@ sync_svc_monitors(struct ovsdb_idl_txn *ovnsb_idl_txn,
                 smap_get_int(&svc_mon->options, "failure_count", 1);
             svc_mon->n_success = 0;
             svc_mon->n_failures = 0;
+            pinctrl_timer_init(&svc_mon->timer, PINCTRL_TIMER_SVC_MONITOR);
+            pinctrl_timer_schedule(&svc_mon->timer, time_msec());
+            svc_mon->ea = eth_addr_zero;
+            svc_mon->src_ea = eth_addr_zero;
+            svc_mon->src_ip4 = 0;
+            pinctrl_po_template_init(&svc_mon->po_template);
 
             hmap_insert(&svc_monitors_map, &svc_mon->hmap_node, hash);
             ovs_list_push_back(&svc_monitors, &svc_mon->list_node);
             changed = true;
         }
 
+        struct eth_addr src_ea = eth_addr_zero;
+        ovs_be32 src_ip4 = 0;
+        eth_addr_from_string(sb_svc_mon->src_mac, &src_ea);
+        ip_parse(sb_svc_mon->src_ip, &src_ip4);
+        if (!eth_addr_equals(svc_mon->ea, ea)
+            || !eth_addr_equals(svc_mon->src_ea, src_ea)
+            || svc_mon->src_ip4 != src_ip4) {
+            pinctrl_po_template_clear(&svc_mon->po_template);
+        }
+
         svc_mon->sb_svc_mon = sb_svc_mon;
         svc_mon->ea = ea;
+        svc_mon->src_ea = src_ea;
+        svc_mon->src_ip4 = src_ip4;
         if (!smap_equal(&svc_mon->options, &sb_svc_mon->options)) {
             smap_destroy(&svc_mon->options);
             smap_clone(&svc_mon->options, &sb_svc_mon->options);
@@ -6548,9 +8304,11 @@ sync_svc_monitors(struct ovsdb_idl_txn *ovnsb_idl_txn,
     struct svc_monitor *next;
     LIST_FOR_EACH_SAFE (svc_mon, next, list_node, &svc_monitors) {
         if (svc_mon->delete) {
+            pinctrl_timer_cancel(&svc_mon->timer);
             hmap_remove(&svc_monitors_map, &svc_mon->hmap_node);
             ovs_list_remove(&svc_mon->list_node);
             smap_destroy(&svc_mon->options);
+            pinctrl_po_template_clear(&svc_mon->po_template);
             free(svc_mon);
             changed = true;
         } else if (ovnsb_idl_txn) {
@@ -6608,12 +8366,12 @@ bfd_get_status(enum bfd_state state)
     }
 }
 
-static struct hmap bfd_monitor_map;
+static struct hmap bfd_monitor_map OVS_GUARDED_BY(bfd_mutex);
 
 #define BFD_UPDATE_BATCH_TH     10
-static uint16_t bfd_pending_update;
+static uint16_t bfd_pending_update OVS_GUARDED_BY(bfd_mutex);
 #define BFD_UPDATE_TIMEOUT      5000LL
-static long long bfd_last_update;
+static long long bfd_last_update OVS_GUARDED_BY(bfd_mutex);
 
 struct bfd_entry {
     struct hmap_node node;
@@ -6653,27 +8411,42 @@ struct bfd_entry {
     uint32_t detection_timeout;
     long long int last_rx;
     long long int next_tx;
+
+    /* In 'bfd_timers', expires at bfd_monitor_next_time(). */
+    struct timer_wheel_node timer;
+    struct pinctrl_po_template po_template;
 };
 
 static void
 bfd_monitor_init(void)
 {
+    ovs_mutex_lock(&bfd_mutex);
     hmap_init(&bfd_monitor_map);
+    timer_wheel_init(&bfd_timers, time_msec());
     bfd_last_update = time_msec();
+    ovs_mutex_unlock(&bfd_mutex);
 }
 
 static void
 bfd_monitor_destroy(void)
 {
     struct bfd_entry *entry;
+
+    ovs_mutex_lock(&bfd_mutex);
+    timer_wheel_destroy(&bfd_timers);
     HMAP_FOR_EACH_POP (entry, node, &bfd_monitor_map) {
+        pinctrl_po_template_clear(&entry->po_template);
         free(entry);
     }
     hmap_destroy(&bfd_monitor_map);
+    free(bfd_br_int_name);
+    bfd_br_int_name = NULL;
+    ovs_mutex_unlock(&bfd_mutex);
 }
 
 static struct bfd_entry *
 pinctrl_find_bfd_monitor_entry_by_port(char *ip, uint16_t port)
+    OVS_REQUIRES(bfd_mutex)
 {
     struct bfd_entry *entry;
     HMAP_FOR_EACH_WITH_HASH (entry, node, hash_string(ip, 0),
@@ -6687,6 +8460,7 @@ pinctrl_find_bfd_monitor_entry_by_port(char *ip, uint16_t port)
 
 static struct bfd_entry *
 pinctrl_find_bfd_monitor_entry_by_disc(char *ip, ovs_be32 disc)
+    OVS_REQUIRES(bfd_mutex)
 {
     struct bfd_entry *ret = NULL, *entry;
 
@@ -6700,25 +8474,35 @@ pinctrl_find_bfd_monitor_entry_by_disc(char *ip, ovs_be32 disc)
     return ret;
 }
 
-static bool
-bfd_monitor_should_inject(void)
+/* Returns the time at which 'entry' has to send its next message or to
+ * detect that the session is down, LLONG_MAX if neither is needed. */
+static long long int
+bfd_monitor_next_time(const struct bfd_entry *entry)
 {
-    long long int cur_time = time_msec();
-    struct bfd_entry *entry;
+    if (entry->state == BFD_STATE_ADMIN_DOWN) {
+        return LLONG_MAX;
+    }
 
-    HMAP_FOR_EACH (entry, node, &bfd_monitor_map) {
-        if (entry->next_tx < cur_time) {
-            return true;
-        }
+    long long int next = LLONG_MAX;
+    if (entry->remote_min_rx && !entry->remote_demand_mode) {
+        next = entry->next_tx;
     }
-    return false;
+    if (entry->state != BFD_STATE_DOWN && entry->detection_timeout) {
+        next = MIN(next, entry->last_rx + entry->detection_timeout);
+    }
+    return next;
 }
 
 static void
-bfd_monitor_wait(long long int timeout)
+bfd_monitor_schedule(struct bfd_entry *entry)
+    OVS_REQUIRES(bfd_mutex)
 {
-    if (!hmap_is_empty(&bfd_monitor_map)) {
-        poll_timer_wait_until(timeout);
+    long long int next = bfd_monitor_next_time(entry);
+
+    if (next == LLONG_MAX) {
+        timer_wheel_cancel(&bfd_timers, &entry->timer);
+    } else {
+        timer_wheel_schedule(&bfd_timers, &entry->timer, next);
     }
 }
 
@@ -6772,47 +8556,49 @@ bfd_monitor_put_bfd_msg(struct bfd_entry *entry, struct dp_packet *packet,
 }
 
 static void
-pinctrl_send_bfd_tx_msg(struct rconn *swconn, struct bfd_entry *entry,
-                        bool final)
+pinctrl_send_bfd_tx_msg(struct rconn *swconn, struct ovs_list *txq,
+                        struct bfd_entry *entry, bool final)
 {
     uint64_t packet_stub[256 / 8];
     struct dp_packet packet;
     dp_packet_use_stub(&packet, packet_stub, sizeof packet_stub);
     bfd_monitor_put_bfd_msg(entry, &packet, final);
 
-    uint64_t ofpacts_stub[4096 / 8];
-    struct ofpbuf ofpacts = OFPBUF_STUB_INITIALIZER(ofpacts_stub);
-
-    /* Set MFF_LOG_DATAPATH and MFF_LOG_INPORT. */
-    uint32_t dp_key = entry->metadata;
-    uint32_t port_key = entry->port_key;
-    put_load(dp_key, MFF_LOG_DATAPATH, 0, 64, &ofpacts);
-    put_load(port_key, MFF_LOG_INPORT, 0, 32, &ofpacts);
-    put_load(1, MFF_LOG_FLAGS, MLF_LOCAL_ONLY_BIT, 1, &ofpacts);
-    struct ofpact_resubmit *resubmit = ofpact_put_RESUBMIT(&ofpacts);
-    resubmit->in_port = OFPP_CONTROLLER;
-    resubmit->table_id = OFTABLE_LOG_INGRESS_PIPELINE;
-
-    struct ofputil_packet_out po = {
-        .packet = dp_packet_data(&packet),
-        .packet_len = dp_packet_size(&packet),
-        .buffer_id = UINT32_MAX,
-        .ofpacts = ofpacts.data,
-        .ofpacts_len = ofpacts.size,
-    };
+    /* The actions are the same for every BFD control packet of 'entry', and
+     * so is the length of the packet, so only the packet is copied into the
+     * template. */
+    if (!pinctrl_po_template_is_valid(&entry->po_template, swconn)
+        || entry->po_template.packet_len != dp_packet_size(&packet)) {
+        uint64_t ofpacts_stub[4096 / 8];
+        struct ofpbuf ofpacts = OFPBUF_STUB_INITIALIZER(ofpacts_stub);
+
+        /* Set MFF_LOG_DATAPATH and MFF_LOG_INPORT. */
+        uint32_t dp_key = entry->metadata;
+        uint32_t port_key = entry->port_key;
+        put_load(dp_key, MFF_LOG_DATAPATH, 0, 64, &ofpacts);
+        put_load(port_key, MFF_LOG_INPORT, 0, 32, &ofpacts);
+        put_load(1, MFF_LOG_FLAGS, MLF_LOCAL_ONLY_BIT, 1, &ofpacts);
+        struct ofpact_resubmit *resubmit = ofpact_put_RESUBMIT(&ofpacts);
+        resubmit->in_port = OFPP_CONTROLLER;
+        resubmit->table_id = OFTABLE_LOG_INGRESS_PIPELINE;
+
+        pinctrl_po_template_set(&entry->po_template, swconn, &packet,
+                                &ofpacts);
+        ofpbuf_uninit(&ofpacts);
+    }
 
-    match_set_in_port(&po.flow_metadata, OFPP_CONTROLLER);
-    enum ofp_version version = rconn_get_version(swconn);
-    enum ofputil_protocol proto =
-        ofputil_protocol_from_ofp_version(version);
-    queue_msg(swconn, ofputil_encode_packet_out(&po, proto));
+    uint8_t *data;
+    struct ofpbuf *msg = pinctrl_po_template_clone(&entry->po_template,
+                                                   &data);
+    memcpy(data, dp_packet_data(&packet), dp_packet_size(&packet));
+    pinctrl_send_msg(swconn, txq, msg);
     dp_packet_uninit(&packet);
-    ofpbuf_uninit(&ofpacts);
 }
 
 
 static bool
 bfd_monitor_need_update(void)
+    OVS_REQUIRES(bfd_mutex)
 {
     long long int cur_time = time_msec();
 
@@ -6834,8 +8620,10 @@ update:
 
 static void
 bfd_check_detection_timeout(struct bfd_entry *entry)
+    OVS_REQUIRES(bfd_mutex)
 {
-    if (entry->state == BFD_STATE_ADMIN_DOWN) {
+    if (entry->state == BFD_STATE_ADMIN_DOWN
+        || entry->state == BFD_STATE_DOWN) {
         return;
     }
 
@@ -6855,47 +8643,45 @@ bfd_check_detection_timeout(struct bfd_entry *entry)
     notify_pinctrl_main();
 }
 
+/* Called with in the pinctrl_handler or pinctrl_bfd_handler thread
+ * context. */
 static void
-bfd_monitor_send_msg(struct rconn *swconn, long long int *bfd_time)
-    OVS_REQUIRES(pinctrl_mutex)
+bfd_monitor_expired(struct rconn *swconn, struct ovs_list *txq,
+                    struct bfd_entry *entry, long long int now)
+    OVS_REQUIRES(bfd_mutex)
 {
-    long long int cur_time = time_msec();
-    struct bfd_entry *entry;
-
     if (bfd_monitor_need_update()) {
         notify_pinctrl_main();
     }
 
-    HMAP_FOR_EACH (entry, node, &bfd_monitor_map) {
-        unsigned long tx_timeout;
-
-        bfd_check_detection_timeout(entry);
-
-        if (cur_time < entry->next_tx) {
-            goto next;
-        }
-
-        if (!entry->remote_min_rx) {
-            continue;
-        }
+    bfd_check_detection_timeout(entry);
 
-        if (entry->state == BFD_STATE_ADMIN_DOWN) {
-            continue;
-        }
+    if (now >= entry->next_tx
+        && entry->remote_min_rx
+        && entry->state != BFD_STATE_ADMIN_DOWN
+        && !entry->remote_demand_mode) {
+        pinctrl_send_bfd_tx_msg(swconn, txq, entry, false);
 
-        if (entry->remote_demand_mode) {
-            continue;
-        }
+        unsigned long tx_timeout = MAX(entry->local_min_tx,
+                                       entry->remote_min_rx);
+        tx_timeout -= random_range((tx_timeout * 25) / 100);
+        entry->next_tx = now + tx_timeout;
+    }
+    bfd_monitor_schedule(entry);
+}
 
-        pinctrl_send_bfd_tx_msg(swconn, entry, false);
+/* Handles the BFD sessions whose timer expired.  The packet-outs to send
+ * are appended to 'txq'. */
+static void
+bfd_timers_run(struct rconn *swconn, struct ovs_list *txq)
+    OVS_REQUIRES(bfd_mutex)
+{
+    long long int now = time_msec();
+    struct timer_wheel_node *node;
 
-        tx_timeout = MAX(entry->local_min_tx, entry->remote_min_rx);
-        tx_timeout -= random_range((tx_timeout * 25) / 100);
-        entry->next_tx = cur_time + tx_timeout;
-next:
-        if (*bfd_time > entry->next_tx) {
-            *bfd_time = entry->next_tx;
-        }
+    while ((node = timer_wheel_pop(&bfd_timers, now))) {
+        bfd_monitor_expired(swconn, txq,
+                            CONTAINER_OF(node, struct bfd_entry, timer), now);
     }
 }
 
@@ -6976,7 +8762,7 @@ pinctrl_check_bfd_msg(const struct flow *ip_flow, struct dp_packet *pkt_in)
 static void
 pinctrl_handle_bfd_msg(struct rconn *swconn, const struct flow *ip_flow,
                        struct dp_packet *pkt_in)
-    OVS_REQUIRES(pinctrl_mutex)
+    OVS_REQUIRES(bfd_mutex)
 {
     if (!pinctrl_check_bfd_msg(ip_flow, pkt_in)) {
         return;
@@ -7065,7 +8851,7 @@ pinctrl_handle_bfd_msg(struct rconn *swconn, const struct flow *ip_flow,
     }
 
     if (msg->flags & BFD_FLAG_POLL) {
-        pinctrl_send_bfd_tx_msg(swconn, entry, true);
+        pinctrl_send_bfd_tx_msg(swconn, NULL, entry, true);
     }
 
 out:
@@ -7077,11 +8863,13 @@ out:
     if (bfd_monitor_need_update()) {
         notify_pinctrl_main();
     }
+    bfd_monitor_schedule(entry);
 }
 
 static void
 bfd_monitor_check_sb_conf(const struct sbrec_bfd *sb_bt,
                           struct bfd_entry *entry)
+    OVS_REQUIRES(bfd_mutex)
 {
     struct lport_addresses dst_addr;
 
@@ -7125,6 +8913,7 @@ bfd_monitor_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
     long long int cur_time = time_msec();
     bool changed = false;
 
+    ovs_mutex_lock(&bfd_mutex);
     HMAP_FOR_EACH (entry, node, &bfd_monitor_map) {
         entry->erase = true;
     }
@@ -7217,9 +9006,12 @@ bfd_monitor_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
             entry->local_min_rx = bt->min_rx;
             entry->remote_min_rx = 1; /* RFC5880 page 29 */
             entry->local_mult = bt->detect_mult;
+            timer_wheel_node_init(&entry->timer);
+            pinctrl_po_template_init(&entry->po_template);
 
             uint32_t hash = hash_string(bt->dst_ip, 0);
             hmap_insert(&bfd_monitor_map, &entry->node, hash);
+            changed = true;
         } else if (!strcmp(bt->status, "admin_down") &&
                    entry->state != BFD_STATE_ADMIN_DOWN) {
             entry->state = BFD_STATE_ADMIN_DOWN;
@@ -7239,15 +9031,19 @@ bfd_monitor_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
             entry->change_state = false;
         }
         bfd_monitor_check_sb_conf(bt, entry);
+        bfd_monitor_schedule(entry);
         entry->erase = false;
     }
 
     HMAP_FOR_EACH_SAFE (entry, next_entry, node, &bfd_monitor_map) {
         if (entry->erase) {
+            timer_wheel_cancel(&bfd_timers, &entry->timer);
+            pinctrl_po_template_clear(&entry->po_template);
             hmap_remove(&bfd_monitor_map, &entry->node);
             free(entry);
         }
     }
+    ovs_mutex_unlock(&bfd_mutex);
 
     if (changed) {
         notify_pinctrl_handler();
@@ -7265,53 +9061,47 @@ get_random_src_port(void)
     return random_src_port;
 }
 
+/* Builds the packet-out template of 'svc_mon' if needed.  The template
+ * contains the TCP or UDP header with the ports and, for TCP, the window
+ * set, the other fields being filled in for each health check. */
 static void
-svc_monitor_send_tcp_health_check__(struct rconn *swconn,
-                                    struct svc_monitor *svc_mon,
-                                    uint16_t ctl_flags,
-                                    ovs_be32 tcp_seq,
-                                    ovs_be32 tcp_ack,
-                                    ovs_be16 tcp_src)
+svc_monitor_build_po_template(struct rconn *swconn,
+                              struct svc_monitor *svc_mon)
 {
-    if (svc_mon->is_ip6) {
+    if (pinctrl_po_template_is_valid(&svc_mon->po_template, swconn)) {
         return;
     }
 
-    /* Compose a TCP-SYN packet. */
     uint64_t packet_stub[128 / 8];
     struct dp_packet packet;
-
-    struct eth_addr eth_src;
-    eth_addr_from_string(svc_mon->sb_svc_mon->src_mac, &eth_src);
-    ovs_be32 ip4_src;
-    ip_parse(svc_mon->sb_svc_mon->src_ip, &ip4_src);
-
     dp_packet_use_stub(&packet, packet_stub, sizeof packet_stub);
-    pinctrl_compose_ipv4(&packet, eth_src, svc_mon->ea,
-                         ip4_src, in6_addr_get_mapped_ipv4(&svc_mon->ip),
-                         IPPROTO_TCP, 63, TCP_HEADER_LEN);
-
-    struct tcp_header *th = dp_packet_put_zeros(&packet, sizeof *th);
-    dp_packet_set_l4(&packet, th);
-    th->tcp_dst = htons(svc_mon->proto_port);
-    th->tcp_src = tcp_src;
 
-    th->tcp_ctl = htons((5 << 12) | ctl_flags);
-    put_16aligned_be32(&th->tcp_seq, tcp_seq);
-    put_16aligned_be32(&th->tcp_ack, tcp_ack);
+    if (svc_mon->protocol == SVC_MON_PROTO_TCP) {
+        pinctrl_compose_ipv4(&packet, svc_mon->src_ea, svc_mon->ea,
+                             svc_mon->src_ip4,
+                             in6_addr_get_mapped_ipv4(&svc_mon->ip),
+                             IPPROTO_TCP, 63, TCP_HEADER_LEN);
 
-    th->tcp_winsz = htons(65160);
+        struct tcp_header *th = dp_packet_put_zeros(&packet, sizeof *th);
+        dp_packet_set_l4(&packet, th);
+        th->tcp_dst = htons(svc_mon->proto_port);
+        th->tcp_winsz = htons(65160);
+    } else {
+        pinctrl_compose_ipv4(&packet, svc_mon->src_ea, svc_mon->ea,
+                             svc_mon->src_ip4,
+                             in6_addr_get_mapped_ipv4(&svc_mon->ip),
+                             IPPROTO_UDP, 63, UDP_HEADER_LEN + 8);
 
-    uint32_t csum;
-    csum = packet_csum_pseudoheader(dp_packet_l3(&packet));
-    csum = csum_continue(csum, th, dp_packet_size(&packet) -
-                         ((const unsigned char *)th -
-                         (const unsigned char *)dp_packet_eth(&packet)));
-    th->tcp_csum = csum_finish(csum);
+        struct udp_header *uh = dp_packet_put_zeros(&packet, sizeof *uh);
+        dp_packet_set_l4(&packet, uh);
+        uh->udp_dst = htons(svc_mon->proto_port);
+        uh->udp_len = htons(UDP_HEADER_LEN + 8);
+        uh->udp_csum = 0;
+        dp_packet_put_zeros(&packet, 8);
+    }
 
     uint64_t ofpacts_stub[4096 / 8];
     struct ofpbuf ofpacts = OFPBUF_STUB_INITIALIZER(ofpacts_stub);
-    enum ofp_version version = rconn_get_version(swconn);
     put_load(svc_mon->dp_key, MFF_LOG_DATAPATH, 0, 64, &ofpacts);
     put_load(svc_mon->port_key, MFF_LOG_OUTPORT, 0, 32, &ofpacts);
     put_load(1, MFF_LOG_FLAGS, MLF_LOCAL_ONLY, 1, &ofpacts);
@@ -7319,22 +9109,52 @@ svc_monitor_send_tcp_health_check__(struct rconn *swconn,
     resubmit->in_port = OFPP_CONTROLLER;
     resubmit->table_id = OFTABLE_LOCAL_OUTPUT;
 
-    struct ofputil_packet_out po = {
-        .packet = dp_packet_data(&packet),
-        .packet_len = dp_packet_size(&packet),
-        .buffer_id = UINT32_MAX,
-        .ofpacts = ofpacts.data,
-        .ofpacts_len = ofpacts.size,
-    };
-    match_set_in_port(&po.flow_metadata, OFPP_CONTROLLER);
-    enum ofputil_protocol proto = ofputil_protocol_from_ofp_version(version);
-    queue_msg(swconn, ofputil_encode_packet_out(&po, proto));
+    pinctrl_po_template_set(&svc_mon->po_template, swconn, &packet,
+                            &ofpacts);
     dp_packet_uninit(&packet);
     ofpbuf_uninit(&ofpacts);
 }
 
+static void
+svc_monitor_send_tcp_health_check__(struct rconn *swconn,
+                                    struct ovs_list *txq,
+                                    struct svc_monitor *svc_mon,
+                                    uint16_t ctl_flags,
+                                    ovs_be32 tcp_seq,
+                                    ovs_be32 tcp_ack,
+                                    ovs_be16 tcp_src)
+{
+    if (svc_mon->is_ip6) {
+        return;
+    }
+
+    svc_monitor_build_po_template(swconn, svc_mon);
+
+    /* Fill in the TCP header of a copy of the template. */
+    const struct pinctrl_po_template *t = &svc_mon->po_template;
+    uint8_t *packet;
+    struct ofpbuf *msg = pinctrl_po_template_clone(t, &packet);
+    struct ip_header *nh = ALIGNED_CAST(struct ip_header *,
+                                        packet + t->l3_ofs);
+    struct tcp_header *th = ALIGNED_CAST(struct tcp_header *,
+                                         packet + t->l4_ofs);
+
+    th->tcp_src = tcp_src;
+    th->tcp_ctl = htons((5 << 12) | ctl_flags);
+    put_16aligned_be32(&th->tcp_seq, tcp_seq);
+    put_16aligned_be32(&th->tcp_ack, tcp_ack);
+
+    uint32_t csum;
+    csum = packet_csum_pseudoheader(nh);
+    csum = csum_continue(csum, th, t->packet_len - t->l4_ofs);
+    th->tcp_csum = csum_finish(csum);
+
+    pinctrl_send_msg(swconn, txq, msg);
+}
+
 static void
 svc_monitor_send_udp_health_check(struct rconn *swconn,
+                                  struct ovs_list *txq,
                                   struct svc_monitor *svc_mon,
                                   ovs_be16 udp_src)
 {
@@ -7342,58 +9162,26 @@ svc_monitor_send_udp_health_check(struct rconn *swconn,
         return;
     }
 
-    struct eth_addr eth_src;
-    eth_addr_from_string(svc_mon->sb_svc_mon->src_mac, &eth_src);
-    ovs_be32 ip4_src;
-    ip_parse(svc_mon->sb_svc_mon->src_ip, &ip4_src);
-
-    uint64_t packet_stub[128 / 8];
-    struct dp_packet packet;
-    dp_packet_use_stub(&packet, packet_stub, sizeof packet_stub);
-    pinctrl_compose_ipv4(&packet, eth_src, svc_mon->ea,
-                         ip4_src, in6_addr_get_mapped_ipv4(&svc_mon->ip),
-                         IPPROTO_UDP, 63, UDP_HEADER_LEN + 8);
+    svc_monitor_build_po_template(swconn, svc_mon);
 
-    struct udp_header *uh = dp_packet_put_zeros(&packet, sizeof *uh);
-    dp_packet_set_l4(&packet, uh);
-    uh->udp_dst = htons(svc_mon->proto_port);
+    const struct pinctrl_po_template *t = &svc_mon->po_template;
+    uint8_t *packet;
+    struct ofpbuf *msg = pinctrl_po_template_clone(t, &packet);
+    struct udp_header *uh = ALIGNED_CAST(struct udp_header *,
+                                         packet + t->l4_ofs);
     uh->udp_src = udp_src;
-    uh->udp_len = htons(UDP_HEADER_LEN + 8);
-    uh->udp_csum = 0;
-    dp_packet_put_zeros(&packet, 8);
-
-    uint64_t ofpacts_stub[4096 / 8];
-    struct ofpbuf ofpacts = OFPBUF_STUB_INITIALIZER(ofpacts_stub);
-    enum ofp_version version = rconn_get_version(swconn);
-    put_load(svc_mon->dp_key, MFF_LOG_DATAPATH, 0, 64, &ofpacts);
-    put_load(svc_mon->port_key, MFF_LOG_OUTPORT, 0, 32, &ofpacts);
-    put_load(1, MFF_LOG_FLAGS, MLF_LOCAL_ONLY, 1, &ofpacts);
-    struct ofpact_resubmit *resubmit = ofpact_put_RESUBMIT(&ofpacts);
-    resubmit->in_port = OFPP_CONTROLLER;
-    resubmit->table_id = OFTABLE_LOCAL_OUTPUT;
 
-    struct ofputil_packet_out po = {
-        .packet = dp_packet_data(&packet),
-        .packet_len = dp_packet_size(&packet),
-        .buffer_id = UINT32_MAX,
-        .ofpacts = ofpacts.data,
-        .ofpacts_len = ofpacts.size,
-    };
-    match_set_in_port(&po.flow_metadata, OFPP_CONTROLLER);
-    enum ofputil_protocol proto = ofputil_protocol_from_ofp_version(version);
-    queue_msg(swconn, ofputil_encode_packet_out(&po, proto));
-    dp_packet_uninit(&packet);
-    ofpbuf_uninit(&ofpacts);
+    pinctrl_send_msg(swconn, txq, msg);
 }
 
 static void
-svc_monitor_send_health_check(struct rconn *swconn,
+svc_monitor_send_health_check(struct rconn *swconn, struct ovs_list *txq,
                               struct svc_monitor *svc_mon)
 {
     if (svc_mon->protocol == SVC_MON_PROTO_TCP) {
         svc_mon->seq_no = random_uint32();
         svc_mon->tp_src = htons(get_random_src_port());
-        svc_monitor_send_tcp_health_check__(swconn, svc_mon,
+        svc_monitor_send_tcp_health_check__(swconn, txq, svc_mon,
                                             TCP_SYN,
                                             htonl(svc_mon->seq_no), htonl(0),
                                             svc_mon->tp_src);
@@ -7401,98 +9189,84 @@ svc_monitor_send_health_check(struct rconn *swconn,
         if (!svc_mon->tp_src) {
             svc_mon->tp_src = htons(get_random_src_port());
         }
-        svc_monitor_send_udp_health_check(swconn, svc_mon, svc_mon->tp_src);
+        svc_monitor_send_udp_health_check(swconn, txq, svc_mon,
+                                          svc_mon->tp_src);
     }
 
     svc_mon->wait_time = time_msec() + svc_mon->svc_timeout;
     svc_mon->state = SVC_MON_S_WAITING;
 }
 
+/* Called with in the pinctrl_handler thread context.  Runs the state machine
+ * of the service monitor and schedules its next run. */
 static void
-svc_monitors_run(struct rconn *swconn,
-                 long long int *svc_monitors_next_run_time)
+svc_monitor_expired(struct rconn *swconn, struct ovs_list *txq,
+                    struct pinctrl_timer *timer, long long int current_time)
     OVS_REQUIRES(pinctrl_mutex)
 {
-    *svc_monitors_next_run_time = LLONG_MAX;
-    struct svc_monitor *svc_mon;
-    LIST_FOR_EACH (svc_mon, list_node, &svc_monitors) {
-        char ip_[INET6_ADDRSTRLEN + 1];
-        memset(ip_, 0, INET6_ADDRSTRLEN + 1);
-        ipv6_string_mapped(ip_, &svc_mon->ip);
-
-        long long int current_time = time_msec();
-        long long int next_run_time = LLONG_MAX;
-        enum svc_monitor_status old_status = svc_mon->status;
-        switch (svc_mon->state) {
-        case SVC_MON_S_INIT:
-            svc_monitor_send_health_check(swconn, svc_mon);
-            next_run_time = svc_mon->wait_time;
-            break;
-
-        case SVC_MON_S_WAITING:
-            if (current_time > svc_mon->wait_time) {
-                if (svc_mon->protocol ==  SVC_MON_PROTO_TCP) {
-                    svc_mon->n_failures++;
-                    svc_mon->state = SVC_MON_S_OFFLINE;
-                } else {
-                    svc_mon->n_success++;
-                    svc_mon->state = SVC_MON_S_ONLINE;
-                }
-                svc_mon->next_send_time = current_time + svc_mon->interval;
-                next_run_time = svc_mon->next_send_time;
-            } else {
-                next_run_time = svc_mon->wait_time - current_time;
-                next_run_time = svc_mon->wait_time;
-            }
-            break;
-
-        case SVC_MON_S_ONLINE:
-            if (svc_mon->n_success >= svc_mon->success_count) {
-                svc_mon->status = SVC_MON_ST_ONLINE;
-                svc_mon->n_success = 0;
-            }
-            if (current_time >= svc_mon->next_send_time) {
-                svc_monitor_send_health_check(swconn, svc_mon);
-                next_run_time = svc_mon->wait_time;
-            } else {
-                next_run_time = svc_mon->next_send_time;
-            }
-            break;
+    struct svc_monitor *svc_mon
+        = CONTAINER_OF(timer, struct svc_monitor, timer);
+    long long int next_run_time = LLONG_MAX;
+    enum svc_monitor_status old_status = svc_mon->status;
 
-        case SVC_MON_S_OFFLINE:
-            if (svc_mon->n_failures >= svc_mon->failure_count) {
-                svc_mon->status = SVC_MON_ST_OFFLINE;
-                svc_mon->n_failures = 0;
-            }
+    switch (svc_mon->state) {
+    case SVC_MON_S_INIT:
+        svc_monitor_send_health_check(swconn, txq, svc_mon);
+        next_run_time = svc_mon->wait_time;
+        break;
 
-            if (current_time >= svc_mon->next_send_time) {
-                svc_monitor_send_health_check(swconn, svc_mon);
-                next_run_time = svc_mon->wait_time;
+    case SVC_MON_S_WAITING:
+        if (current_time > svc_mon->wait_time) {
+            if (svc_mon->protocol ==  SVC_MON_PROTO_TCP) {
+                svc_mon->n_failures++;
+                svc_mon->state = SVC_MON_S_OFFLINE;
             } else {
-                next_run_time = svc_mon->next_send_time;
+                svc_mon->n_success++;
+                svc_mon->state = SVC_MON_S_ONLINE;
             }
-            break;
+            svc_mon->next_send_time = current_time + svc_mon->interval;
+            next_run_time = svc_mon->next_send_time;
+        } else {
+            next_run_time = svc_mon->wait_time + 1;
+        }
+        break;
 
-        default:
-            OVS_NOT_REACHED();
+    case SVC_MON_S_ONLINE:
+        if (svc_mon->n_success >= svc_mon->success_count) {
+            svc_mon->status = SVC_MON_ST_ONLINE;
+            svc_mon->n_success = 0;
+        }
+        if (current_time >= svc_mon->next_send_time) {
+            svc_monitor_send_health_check(swconn, txq, svc_mon);
+            next_run_time = svc_mon->wait_time;
+        } else {
+            next_run_time = svc_mon->next_send_time;
         }
+        break;
 
-        if (*svc_monitors_next_run_time > next_run_time) {
-            *svc_monitors_next_run_time = next_run_time;
+    case SVC_MON_S_OFFLINE:
+        if (svc_mon->n_failures >= svc_mon->failure_count) {
+            svc_mon->status = SVC_MON_ST_OFFLINE;
+            svc_mon->n_failures = 0;
         }
 
-        if (old_status != svc_mon->status) {
-            /* Notify the main thread to update the status in the SB DB. */
-            notify_pinctrl_main();
+        if (current_time >= svc_mon->next_send_time) {
+            svc_monitor_send_health_check(swconn, txq, svc_mon);
+            next_run_time = svc_mon->wait_time;
+        } else {
+            next_run_time = svc_mon->next_send_time;
         }
+        break;
+
+    default:
+        OVS_NOT_REACHED();
     }
-}
 
-static void
-svc_monitors_wait(long long int svc_monitors_next_run_time)
-{
-    if (!ovs_list_is_empty(&svc_monitors)) {
-        poll_timer_wait_until(svc_monitors_next_run_time);
+    pinctrl_timer_schedule(timer, next_run_time);
+
+    if (old_status != svc_mon->status) {
+        /* Notify the main thread to update the status in the SB DB. */
+        notify_pinctrl_main();
     }
 }
 
@@ -7500,6 +9274,7 @@ static bool
 pinctrl_handle_tcp_svc_check(struct rconn *swconn,
                              struct dp_packet *pkt_in,
                              struct svc_monitor *svc_mon)
+    OVS_REQUIRES(pinctrl_mutex)
 {
     struct tcp_header *th = dp_packet_l4(pkt_in);
 
@@ -7525,11 +9300,13 @@ pinctrl_handle_tcp_svc_check(struct rconn *swconn,
         svc_mon->state = SVC_MON_S_ONLINE;
 
         /* Send RST-ACK packet. */
-        svc_monitor_send_tcp_health_check__(swconn, svc_mon, TCP_RST | TCP_ACK,
+        svc_monitor_send_tcp_health_check__(swconn, NULL, svc_mon,
+                                            TCP_RST | TCP_ACK,
                                             htonl(tcp_ack + 1),
                                             htonl(tcp_seq + 1), th->tcp_dst);
-        /* Calculate next_send_time. */
+        /* Calculate next_send_time, and update the status right away. */
         svc_mon->next_send_time = time_msec() + svc_mon->interval;
+        pinctrl_timer_schedule(&svc_mon->timer, time_msec());
         return true;
     }
 
@@ -7538,8 +9315,9 @@ pinctrl_handle_tcp_svc_check(struct rconn *swconn,
         svc_mon->n_failures++;
         svc_mon->state = SVC_MON_S_OFFLINE;
 
-        /* Calculate next_send_time. */
+        /* Calculate next_send_time, and update the status right away. */
         svc_mon->next_send_time = time_msec() + svc_mon->interval;
+        pinctrl_timer_schedule(&svc_mon->timer, time_msec());
         return false;
     }
 
@@ -7549,6 +9327,7 @@ pinctrl_handle_tcp_svc_check(struct rconn *swconn,
 static void
 pinctrl_handle_svc_check(struct rconn *swconn, const struct flow *ip_flow,
                          struct dp_packet *pkt_in, const struct match *md)
+    OVS_REQUIRES(pinctrl_mutex)
 {
     uint32_t dp_key = ntohll(md->flow.metadata);
     uint32_t port_key = md->flow.regs[MFF_LOG_INPORT - MFF_REG0];
@@ -7662,12 +9441,14 @@ pinctrl_handle_svc_check(struct rconn *swconn, const struct flow *ip_flow,
         svc_mon->n_failures++;
         svc_mon->state = SVC_MON_S_OFFLINE;
 
-        /* Calculate next_send_time. */
+        /* Calculate next_send_time, and update the status right away. */
         svc_mon->next_send_time = time_msec() + svc_mon->interval;
+        pinctrl_timer_schedule(&svc_mon->timer, time_msec());
     }
 }
 
-static struct hmap put_fdbs;
+/* Contains "struct fdb_entry"s. */
+static struct fdb_table put_fdbs;
 
 /* MAC learning (fdb) related functions.  Runs within the main
  * ovn-controller thread context. */
@@ -7681,7 +9462,9 @@ init_fdb_entries(void)
 static void
 destroy_fdb_entries(void)
 {
+    ovs_mutex_lock(&pinctrl_put_mutex);
     ovn_fdbs_destroy(&put_fdbs);
+    ovs_mutex_unlock(&pinctrl_put_mutex);
 }
 
 static const struct sbrec_fdb *
@@ -7724,32 +9507,45 @@ run_put_fdb(struct ovsdb_idl_txn *ovnsb_idl_txn,
 static void
 run_put_fdbs(struct ovsdb_idl_txn *ovnsb_idl_txn,
              struct ovsdb_idl_index *sbrec_fdb_by_dp_key_mac)
-             OVS_REQUIRES(pinctrl_mutex)
+             OVS_EXCLUDED(pinctrl_put_mutex)
 {
     if (!ovnsb_idl_txn) {
         return;
     }
 
+    struct fdb_table fdbs;
+    ovn_fdb_init(&fdbs);
+    ovs_mutex_lock(&pinctrl_put_mutex);
+    if (hmap_is_empty(&put_fdbs.entries) || time_msec() < fdb_next_flush) {
+        ovs_mutex_unlock(&pinctrl_put_mutex);
+        return;
+    }
+    ovn_fdbs_swap(&fdbs, &put_fdbs);
+    fdb_next_flush = time_msec() + mac_binding_flush_interval;
+    ovs_mutex_unlock(&pinctrl_put_mutex);
+
     const struct fdb_entry *fdb_e;
-    HMAP_FOR_EACH (fdb_e, hmap_node, &put_fdbs) {
+    LIST_FOR_EACH (fdb_e, list_node, &fdbs.lru) {
         run_put_fdb(ovnsb_idl_txn, sbrec_fdb_by_dp_key_mac, fdb_e);
     }
-    ovn_fdbs_flush(&put_fdbs);
+    ovn_fdbs_destroy(&fdbs);
 }
 
 
 static void
 wait_put_fdbs(struct ovsdb_idl_txn *ovnsb_idl_txn)
 {
-    if (ovnsb_idl_txn && !hmap_is_empty(&put_fdbs)) {
-        poll_immediate_wake();
+    ovs_mutex_lock(&pinctrl_put_mutex);
+    if (ovnsb_idl_txn && !hmap_is_empty(&put_fdbs.entries)) {
+        poll_timer_wait_until(fdb_next_flush);
     }
+    ovs_mutex_unlock(&pinctrl_put_mutex);
 }
 
 /* Called with in the pinctrl_handler thread context. */
 static void
 pinctrl_handle_put_fdb(const struct flow *md, const struct flow *headers)
-                       OVS_REQUIRES(pinctrl_mutex)
+                       OVS_REQUIRES(pinctrl_put_mutex)
 {
     uint32_t dp_key = ntohll(md->metadata);
     uint32_t port_key = md->regs[MFF_LOG_INPORT - MFF_REG0];
@@ -17,11 +17,13 @@
 #ifndef PINCTRL_H
 #define PINCTRL_H 1
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "lib/sset.h"
 #include "openvswitch/meta-flow.h"
 
+struct ds;
 struct hmap;
 struct lport_index;
 struct ovsdb_idl_index;
@@ -32,6 +34,7 @@ struct sbrec_dns_table;
 struct sbrec_controller_event_table;
 struct sbrec_service_monitor_table;
 struct sbrec_bfd_table;
+struct simap;
 
 void pinctrl_init(void);
 void pinctrl_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
@@ -53,4 +56,20 @@ void pinctrl_run(struct ovsdb_idl_txn *ovnsb_idl_txn,
 void pinctrl_wait(struct ovsdb_idl_txn *ovnsb_idl_txn);
 void pinctrl_destroy(void);
 void pinctrl_set_br_int_name(char *br_int_name);
+void pinctrl_set_n_workers(size_t n_workers);
+void pinctrl_set_packet_in_rate(unsigned int rate);
+void pinctrl_get_packet_in_stats(struct ds *);
+void pinctrl_set_buffered_packets_limits(size_t depth, size_t max_bytes);
+void pinctrl_get_buffered_packets_stats(struct ds *);
+void pinctrl_get_memory_usage(struct simap *usage);
+void pinctrl_set_mac_binding_limits(unsigned int rate,
+                                    unsigned int flush_interval);
+void pinctrl_ip_mcast_resync(void);
+void pinctrl_get_ip_mcast_stats(struct ds *);
+
+/* OpenFlow controller id of the connection of the dedicated BFD thread. */
+#define PINCTRL_BFD_CONTROLLER_ID 1
+
+bool pinctrl_set_bfd_thread(bool enabled);
+uint16_t pinctrl_bfd_controller_id(void);
 #endif /* controller/pinctrl.h */
@@ -17,8 +17,10 @@
 
 #include "lib/uuid.h"
 #include "ovn/expr.h"
+#include "random.h"
 #include "tests/ovstest.h"
 #include "tests/test-utils.h"
+#include "timeval.h"
 #include "util.h"
 
 #include "lflow-cache.h"
@@ -70,6 +72,19 @@ test_lflow_cache_lookup__(struct lflow_cache *lc,
         break;
     case LCACHE_T_EXPR:
         printf("  type: expr\n");
+        if (lcv->cond_matches[0].matches) {
+            printf("  cond-states:");
+            for (size_t i = 0; i < LCACHE_N_COND_MATCHES; i++) {
+                const struct lflow_cache_cond_matches *cm
+                    = &lcv->cond_matches[i];
+                if (cm->matches) {
+                    ovs_assert(lflow_cache_find_cond_matches(
+                                   lcv, cm->cond_state) == cm);
+                    printf(" %"PRIu64, cm->cond_state);
+                }
+            }
+            printf("\n");
+        }
         break;
     case LCACHE_T_MATCHES:
         printf("  type: matches\n");
@@ -88,6 +103,29 @@ test_lflow_cache_delete__(struct lflow_cache *lc,
     lflow_cache_delete(lc, lflow_uuid);
 }
 
+/* All the logical flows exist and never change. */
+static bool
+test_lflow_cache_fingerprint(const struct uuid *lflow_uuid OVS_UNUSED,
+                             const void *aux OVS_UNUSED,
+                             uint32_t *fingerprint)
+{
+    *fingerprint = 0;
+    return true;
+}
+
+static void
+test_lflow_cache_save_load__(struct lflow_cache *lc)
+{
+    static const char file_name[] = "lflow-cache.snapshot";
+
+    printf("SAVE-LOAD\n");
+    ovs_assert(!lflow_cache_save(lc, file_name,
+                                 test_lflow_cache_fingerprint, NULL));
+    lflow_cache_flush(lc);
+    ovs_assert(!lflow_cache_load(lc, file_name,
+                                 test_lflow_cache_fingerprint, NULL));
+}
+
 static void
 test_lflow_cache_stats__(struct lflow_cache *lc)
 {
@@ -107,6 +145,10 @@ test_lflow_cache_operations(struct ovs_cmdl_context *ctx)
     unsigned int shift = 2;
     unsigned int n_ops;
 
+    /* The lflow UUID used by each operation, so that "lookup" can refer to
+     * the entry added by an earlier one. */
+    struct uuid *op_uuids = NULL;
+
     lflow_cache_enable(lc, enabled, UINT32_MAX, UINT32_MAX);
     test_lflow_cache_stats__(lc);
 
@@ -114,6 +156,8 @@ test_lflow_cache_operations(struct ovs_cmdl_context *ctx)
         goto done;
     }
 
+    op_uuids = xcalloc(n_ops, sizeof *op_uuids);
+
     for (unsigned int i = 0; i < n_ops; i++) {
         const char *op = test_read_value(ctx, shift++, "op");
 
@@ -123,6 +167,7 @@ test_lflow_cache_operations(struct ovs_cmdl_context *ctx)
 
         struct uuid lflow_uuid;
         uuid_generate(&lflow_uuid);
+        op_uuids[i] = lflow_uuid;
 
         if (!strcmp(op, "add")) {
             const char *op_type = test_read_value(ctx, shift++, "op_type");
@@ -154,6 +199,31 @@ test_lflow_cache_operations(struct ovs_cmdl_context *ctx)
             test_lflow_cache_lookup__(lc, &lflow_uuid);
             test_lflow_cache_delete__(lc, &lflow_uuid);
             test_lflow_cache_lookup__(lc, &lflow_uuid);
+        } else if (!strcmp(op, "add-cond-matches")) {
+            unsigned int op_index;
+            unsigned int cond_state;
+            if (!test_read_uint_value(ctx, shift++, "op-index", &op_index)
+                || !test_read_uint_value(ctx, shift++, "cond-state",
+                                         &cond_state)) {
+                goto done;
+            }
+            ovs_assert(op_index < i);
+
+            printf("ADD cond-matches:\n");
+            printf("  cond-state: %u\n", cond_state);
+            struct hmap *matches = xmalloc(sizeof *matches);
+            ovs_assert(expr_to_matches(e, NULL, NULL, matches) == 0);
+            lflow_cache_add_cond_matches(lc, &op_uuids[op_index], cond_state,
+                                         0, 0, matches,
+                                         TEST_LFLOW_CACHE_VALUE_SIZE);
+            test_lflow_cache_lookup__(lc, &op_uuids[op_index]);
+        } else if (!strcmp(op, "lookup")) {
+            unsigned int op_index;
+            if (!test_read_uint_value(ctx, shift++, "op-index", &op_index)) {
+                goto done;
+            }
+            ovs_assert(op_index < i);
+            test_lflow_cache_lookup__(lc, &op_uuids[op_index]);
         } else if (!strcmp(op, "enable")) {
             unsigned int limit;
             unsigned int mem_limit_kb;
@@ -169,6 +239,8 @@ test_lflow_cache_operations(struct ovs_cmdl_context *ctx)
         } else if (!strcmp(op, "disable")) {
             printf("DISABLE\n");
             lflow_cache_enable(lc, false, UINT32_MAX, UINT32_MAX);
+        } else if (!strcmp(op, "save-load")) {
+            test_lflow_cache_save_load__(lc);
         } else if (!strcmp(op, "flush")) {
             printf("FLUSH\n");
             lflow_cache_flush(lc);
@@ -178,8 +250,109 @@ test_lflow_cache_operations(struct ovs_cmdl_context *ctx)
         test_lflow_cache_stats__(lc);
     }
 done:
+    free(op_uuids);
+    lflow_cache_destroy(lc);
+    expr_destroy(e);
+}
+
+enum test_lflow_cache_bench_op {
+    BENCH_ADD,
+    BENCH_LOOKUP,
+    BENCH_DELETE,
+    N_BENCH_OPS
+};
+
+/* Runs 'n_ops' operations on a cache with the given capacity and memory
+ * limit, each on one of 'n_lflows' logical flows, drawn at random.  Each
+ * operation is an add with probability 'add_pct' percent, a delete with
+ * probability 'del_pct' percent, and a lookup otherwise.  Adding a flow that
+ * is cached replaces it, like ovn-controller does.  Prints the throughput and
+ * the latency percentiles of each kind of operation. */
+static void
+test_lflow_cache_benchmark(struct ovs_cmdl_context *ctx)
+{
+    unsigned int n_lflows, n_ops, capacity, mem_limit_kb;
+    unsigned int add_pct = 30;
+    unsigned int del_pct = 10;
+    unsigned int seed = 0;
+
+    if (!test_read_uint_value(ctx, 1, "n_lflows", &n_lflows)
+        || !test_read_uint_value(ctx, 2, "n_ops", &n_ops)
+        || !test_read_uint_value(ctx, 3, "capacity", &capacity)
+        || !test_read_uint_value(ctx, 4, "mem_limit_kb", &mem_limit_kb)
+        || (ctx->argc > 5
+            && !test_read_uint_value(ctx, 5, "add_pct", &add_pct))
+        || (ctx->argc > 6
+            && !test_read_uint_value(ctx, 6, "del_pct", &del_pct))
+        || (ctx->argc > 7 && !test_read_uint_value(ctx, 7, "seed", &seed))) {
+        return;
+    }
+    if (!n_lflows || add_pct + del_pct > 100) {
+        fprintf(stderr, "Invalid benchmark parameters\n");
+        return;
+    }
+
+    struct uuid *uuids = xmalloc(n_lflows * sizeof *uuids);
+    for (unsigned int i = 0; i < n_lflows; i++) {
+        uuid_generate(&uuids[i]);
+    }
+    random_set_seed(seed ? seed : time_msec());
+
+    struct test_latencies lat[N_BENCH_OPS];
+    test_latencies_init(&lat[BENCH_ADD], "add");
+    test_latencies_init(&lat[BENCH_LOOKUP], "lookup");
+    test_latencies_init(&lat[BENCH_DELETE], "delete");
+
+    struct lflow_cache *lc = lflow_cache_create();
+    struct expr *e = expr_create_boolean(true);
+    unsigned int n_hits = 0;
+    uint64_t start;
+
+    lflow_cache_enable(lc, true, capacity, mem_limit_kb);
+    for (unsigned int i = 0; i < n_ops; i++) {
+        const struct uuid *lflow_uuid = &uuids[random_range(n_lflows)];
+        unsigned int r = random_range(100);
+
+        if (r < add_pct) {
+            struct expr *clone = expr_clone(e);
+
+            if (lflow_cache_peek_type(lc, lflow_uuid) != LCACHE_T_NONE) {
+                start = test_time_ns();
+                lflow_cache_delete(lc, lflow_uuid);
+                test_latencies_add(&lat[BENCH_DELETE],
+                                   test_time_ns() - start);
+            }
+            start = test_time_ns();
+            lflow_cache_add_expr(lc, lflow_uuid, 0, clone,
+                                 TEST_LFLOW_CACHE_VALUE_SIZE);
+            test_latencies_add(&lat[BENCH_ADD], test_time_ns() - start);
+        } else if (r < add_pct + del_pct) {
+            start = test_time_ns();
+            lflow_cache_delete(lc, lflow_uuid);
+            test_latencies_add(&lat[BENCH_DELETE], test_time_ns() - start);
+        } else {
+            start = test_time_ns();
+            bool hit = lflow_cache_get(lc, lflow_uuid) != NULL;
+            test_latencies_add(&lat[BENCH_LOOKUP], test_time_ns() - start);
+            n_hits += hit;
+        }
+    }
+
+    printf("%u lflows, %u ops, capacity %u, mem-limit %u kB, "
+           "%u%% adds, %u%% deletes\n", n_lflows, n_ops, capacity,
+           mem_limit_kb, add_pct, del_pct);
+    printf("lookup hit ratio: %.2f%%\n",
+           100.0 * n_hits / MAX(lat[BENCH_LOOKUP].n, 1));
+    test_latencies_print_header();
+    for (size_t i = 0; i < N_BENCH_OPS; i++) {
+        test_latencies_print(&lat[i]);
+        test_latencies_destroy(&lat[i]);
+    }
+    test_lflow_cache_stats__(lc);
+
     lflow_cache_destroy(lc);
     expr_destroy(e);
+    free(uuids);
 }
 
 static void
@@ -204,9 +377,11 @@ test_lflow_cache_negative(struct ovs_cmdl_context *ctx OVS_UNUSED)
     for (size_t i = 0; i < ARRAY_SIZE(lcs); i++) {
         struct expr *e = expr_create_boolean(true);
         struct hmap *matches = xmalloc(sizeof *matches);
+        struct hmap *cond_matches = xmalloc(sizeof *cond_matches);
 
         ovs_assert(expr_to_matches(e, NULL, NULL, matches) == 0);
         ovs_assert(hmap_count(matches) == 1);
+        ovs_assert(expr_to_matches(e, NULL, NULL, cond_matches) == 0);
 
         lflow_cache_add_conj_id(lcs[i], NULL, 0);
         lflow_cache_add_expr(lcs[i], NULL, 0, NULL, 0);
@@ -214,6 +389,8 @@ test_lflow_cache_negative(struct ovs_cmdl_context *ctx OVS_UNUSED)
         lflow_cache_add_matches(lcs[i], NULL, NULL, 0);
         lflow_cache_add_matches(lcs[i], NULL, matches,
                                 TEST_LFLOW_CACHE_VALUE_SIZE);
+        lflow_cache_add_cond_matches(lcs[i], NULL, 0, 0, 0, cond_matches,
+                                     TEST_LFLOW_CACHE_VALUE_SIZE);
         lflow_cache_destroy(lcs[i]);
     }
 }
@@ -227,6 +404,8 @@ test_lflow_cache_main(int argc, char *argv[])
          test_lflow_cache_operations, OVS_RO},
         {"lflow_cache_negative", NULL, 0, 0,
          test_lflow_cache_negative, OVS_RO},
+        {"lflow_cache_benchmark", NULL, 4, 7,
+         test_lflow_cache_benchmark, OVS_RO},
         {NULL, NULL, 0, 0, NULL, OVS_RO},
     };
     struct ovs_cmdl_context ctx;
@@ -0,0 +1,121 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+
+#include "tests/ovstest.h"
+#include "tests/test-utils.h"
+#include "util.h"
+
+#include "lflow-conj-ids.h"
+
+/* Reads the lflow number and the hash of its UUID, which is the hint of the
+ * first range tried, from the command line. */
+static bool
+test_read_lflow_uuid(struct ovs_cmdl_context *ctx, unsigned int *shift,
+                     struct uuid *lflow_uuid)
+{
+    unsigned int lflow, hash;
+
+    if (!test_read_uint_value(ctx, (*shift)++, "lflow", &lflow)
+        || !test_read_uint_value(ctx, (*shift)++, "hash", &hash)) {
+        return false;
+    }
+    *lflow_uuid = (struct uuid) { .parts = { hash, lflow, 0, 0 } };
+    return true;
+}
+
+static void
+test_lflow_conj_ids_operations(struct ovs_cmdl_context *ctx)
+{
+    struct lflow_conj_ids conj_ids;
+    unsigned int shift = 1;
+    unsigned int n_ops;
+
+    lflow_conj_ids_init(&conj_ids);
+
+    if (!test_read_uint_value(ctx, shift++, "n_ops", &n_ops)) {
+        goto done;
+    }
+
+    for (unsigned int i = 0; i < n_ops; i++) {
+        const char *op = test_read_value(ctx, shift++, "op");
+        struct uuid lflow_uuid;
+        unsigned int n_conjs;
+
+        if (!op) {
+            goto done;
+        }
+
+        if (!strcmp(op, "alloc")) {
+            if (!test_read_lflow_uuid(ctx, &shift, &lflow_uuid)
+                || !test_read_uint_value(ctx, shift++, "n_conjs",
+                                         &n_conjs)) {
+                goto done;
+            }
+
+            uint32_t conj_id_ofs;
+            ovs_assert(lflow_conj_ids_alloc(&conj_ids, &lflow_uuid, n_conjs,
+                                            &conj_id_ofs));
+            printf("ALLOC lflow %"PRIu32" n_conjs %u: conj_id_ofs %"PRIu32
+                   "\n", lflow_uuid.parts[1], n_conjs, conj_id_ofs);
+        } else if (!strcmp(op, "reserve")) {
+            unsigned int conj_id_ofs;
+            if (!test_read_lflow_uuid(ctx, &shift, &lflow_uuid)
+                || !test_read_uint_value(ctx, shift++, "conj_id_ofs",
+                                         &conj_id_ofs)
+                || !test_read_uint_value(ctx, shift++, "n_conjs",
+                                         &n_conjs)) {
+                goto done;
+            }
+
+            bool ok = lflow_conj_ids_reserve(&conj_ids, &lflow_uuid,
+                                             conj_id_ofs, n_conjs);
+            printf("RESERVE lflow %"PRIu32" conj_id_ofs %u n_conjs %u: %s\n",
+                   lflow_uuid.parts[1], conj_id_ofs, n_conjs,
+                   ok ? "ok" : "in use");
+        } else if (!strcmp(op, "free")) {
+            if (!test_read_lflow_uuid(ctx, &shift, &lflow_uuid)) {
+                goto done;
+            }
+            printf("FREE lflow %"PRIu32"\n", lflow_uuid.parts[1]);
+            lflow_conj_ids_free(&conj_ids, &lflow_uuid);
+        } else if (!strcmp(op, "clear")) {
+            printf("CLEAR\n");
+            lflow_conj_ids_clear(&conj_ids);
+        } else {
+            OVS_NOT_REACHED();
+        }
+        printf("  n_lflows: %"PRIuSIZE"\n", lflow_conj_ids_count(&conj_ids));
+    }
+done:
+    lflow_conj_ids_destroy(&conj_ids);
+}
+
+static void
+test_lflow_conj_ids_main(int argc, char *argv[])
+{
+    set_program_name(argv[0]);
+    static const struct ovs_cmdl_command commands[] = {
+        {"lflow_conj_ids_operations", NULL, 1, INT_MAX,
+         test_lflow_conj_ids_operations, OVS_RO},
+        {NULL, NULL, 0, 0, NULL, OVS_RO},
+    };
+    struct ovs_cmdl_context ctx;
+    ctx.argc = argc - 1;
+    ctx.argv = argv + 1;
+    ovs_cmdl_run_command(&ctx, commands);
+}
+
+OVSTEST_REGISTER("test-lflow-conj-ids", test_lflow_conj_ids_main);
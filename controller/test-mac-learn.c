@@ -0,0 +1,173 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+
+#include "coverage.h"
+#include "lib/packets.h"
+#include "tests/ovstest.h"
+#include "tests/test-utils.h"
+#include "util.h"
+
+#include "mac-learn.h"
+
+/* Defined by COVERAGE_DEFINE() in mac-learn.c. */
+extern struct coverage_counter counter_mac_learn_evict_mac_binding;
+extern struct coverage_counter counter_mac_learn_evict_fdb;
+
+#define TEST_DP_KEY   1
+#define TEST_PORT_KEY 2
+
+static struct in6_addr
+test_mac_learn_ip(unsigned int id)
+{
+    struct in6_addr ip;
+
+    in6_addr_set_mapped_ipv4(&ip, htonl(0x0a000000 | id));
+    return ip;
+}
+
+static struct eth_addr
+test_mac_learn_mac(unsigned int id)
+{
+    struct eth_addr mac;
+
+    eth_addr_from_uint64(0x505400000000ULL | id, &mac);
+    return mac;
+}
+
+/* Prints the ranges of the ids in [1, n_ids] for which 'found' is 'true'. */
+static void
+test_mac_learn_print_ranges(const char *title, const bool *found,
+                            unsigned int n_ids)
+{
+    printf("%s:", title);
+    for (unsigned int i = 1; i <= n_ids; i++) {
+        if (!found[i]) {
+            continue;
+        }
+
+        unsigned int last = i;
+        while (last < n_ids && found[last + 1]) {
+            last++;
+        }
+        if (last == i) {
+            printf(" %u", i);
+        } else {
+            printf(" %u-%u", i, last);
+        }
+        i = last;
+    }
+    printf("\n");
+}
+
+/* Learns the bindings 1 to 'n_ids', learning the first one again after half
+ * of them, and prints the ones that the table kept. */
+static void
+test_mac_learn_mac_bindings(struct ovs_cmdl_context *ctx)
+{
+    struct mac_binding_table mac_bindings;
+    unsigned int n_ids;
+
+    if (!test_read_uint_value(ctx, 1, "n_ids", &n_ids)) {
+        return;
+    }
+
+    ovn_mac_bindings_init(&mac_bindings);
+    counter_mac_learn_evict_mac_binding.count();
+    for (unsigned int i = 1; i <= n_ids; i++) {
+        struct in6_addr ip = test_mac_learn_ip(i);
+        ovn_mac_binding_add(&mac_bindings, TEST_DP_KEY, TEST_PORT_KEY, &ip,
+                            test_mac_learn_mac(i));
+        if (i == n_ids / 2) {
+            ip = test_mac_learn_ip(1);
+            ovn_mac_binding_add(&mac_bindings, TEST_DP_KEY, TEST_PORT_KEY,
+                                &ip, test_mac_learn_mac(1));
+        }
+    }
+
+    bool *found = xcalloc(n_ids + 1, sizeof *found);
+    for (unsigned int i = 1; i <= n_ids; i++) {
+        struct in6_addr ip = test_mac_learn_ip(i);
+        struct mac_binding *mb = ovn_mac_binding_find(&mac_bindings,
+                                                      TEST_DP_KEY,
+                                                      TEST_PORT_KEY, &ip);
+        if (mb) {
+            ovs_assert(eth_addr_equals(mb->mac, test_mac_learn_mac(i)));
+            found[i] = true;
+        }
+    }
+
+    printf("bindings: %"PRIuSIZE"\n", hmap_count(&mac_bindings.bindings));
+    printf("evicted: %u\n", counter_mac_learn_evict_mac_binding.count());
+    test_mac_learn_print_ranges("kept", found, n_ids);
+
+    free(found);
+    ovn_mac_bindings_destroy(&mac_bindings);
+}
+
+/* Same as test_mac_learn_mac_bindings() for FDB entries. */
+static void
+test_mac_learn_fdbs(struct ovs_cmdl_context *ctx)
+{
+    struct fdb_table fdbs;
+    unsigned int n_ids;
+
+    if (!test_read_uint_value(ctx, 1, "n_ids", &n_ids)) {
+        return;
+    }
+
+    ovn_fdb_init(&fdbs);
+    counter_mac_learn_evict_fdb.count();
+    for (unsigned int i = 1; i <= n_ids; i++) {
+        ovn_fdb_add(&fdbs, TEST_DP_KEY, test_mac_learn_mac(i), i);
+        if (i == n_ids / 2) {
+            ovn_fdb_add(&fdbs, TEST_DP_KEY, test_mac_learn_mac(1), 1);
+        }
+    }
+
+    bool *found = xcalloc(n_ids + 1, sizeof *found);
+    for (unsigned int i = 1; i <= n_ids; i++) {
+        struct fdb_entry *fdb_e = ovn_fdb_find(&fdbs, TEST_DP_KEY,
+                                               test_mac_learn_mac(i));
+        if (fdb_e) {
+            ovs_assert(fdb_e->port_key == i);
+            found[i] = true;
+        }
+    }
+
+    printf("entries: %"PRIuSIZE"\n", hmap_count(&fdbs.entries));
+    printf("evicted: %u\n", counter_mac_learn_evict_fdb.count());
+    test_mac_learn_print_ranges("kept", found, n_ids);
+
+    free(found);
+    ovn_fdbs_destroy(&fdbs);
+}
+
+static void
+test_mac_learn_main(int argc, char *argv[])
+{
+    set_program_name(argv[0]);
+    static const struct ovs_cmdl_command commands[] = {
+        {"mac_bindings", NULL, 1, 1, test_mac_learn_mac_bindings, OVS_RO},
+        {"fdbs", NULL, 1, 1, test_mac_learn_fdbs, OVS_RO},
+        {NULL, NULL, 0, 0, NULL, OVS_RO},
+    };
+    struct ovs_cmdl_context ctx;
+    ctx.argc = argc - 1;
+    ctx.argv = argv + 1;
+    ovs_cmdl_run_command(&ctx, commands);
+}
+
+OVSTEST_REGISTER("test-mac-learn", test_mac_learn_main);
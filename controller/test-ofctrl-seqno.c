@@ -15,9 +15,11 @@
 
 #include <config.h>
 
+#include "random.h"
 #include "tests/ovstest.h"
 #include "tests/test-utils.h"
 #include "sort.h"
+#include "timeval.h"
 #include "util.h"
 
 #include "ofctrl-seqno.h"
@@ -158,6 +160,86 @@ test_ofctrl_seqno_ack_seqnos(struct ovs_cmdl_context *ctx)
     }
 }
 
+/* Requests 'n_updates' seqno updates, each for one of 'n_types' types drawn
+ * at random, and acks all the pending requests every 'ack_interval' updates,
+ * like ovn-controller does when OVS replies to a flow barrier.  Prints the
+ * throughput and the latency percentiles of the updates, of the acks and of
+ * the retrieval of the acked seqnos. */
+static void
+test_ofctrl_seqno_benchmark(struct ovs_cmdl_context *ctx)
+{
+    unsigned int ack_interval = 1;
+    unsigned int n_updates;
+    unsigned int n_types;
+    unsigned int seed = 0;
+
+    test_init();
+
+    if (!test_read_uint_value(ctx, 1, "n_types", &n_types)
+        || !test_read_uint_value(ctx, 2, "n_updates", &n_updates)
+        || (ctx->argc > 3
+            && !test_read_uint_value(ctx, 3, "ack_interval", &ack_interval))
+        || (ctx->argc > 4 && !test_read_uint_value(ctx, 4, "seed", &seed))) {
+        return;
+    }
+    if (!n_types || !ack_interval) {
+        fprintf(stderr, "Invalid benchmark parameters\n");
+        return;
+    }
+
+    for (unsigned int i = 0; i < n_types; i++) {
+        ofctrl_seqno_add_type();
+    }
+    random_set_seed(seed ? seed : time_msec());
+
+    struct test_latencies update, ack, get_acked;
+    test_latencies_init(&update, "update");
+    test_latencies_init(&ack, "ack");
+    test_latencies_init(&get_acked, "get-acked");
+
+    uint64_t *app_seqnos = xcalloc(n_types, sizeof *app_seqnos);
+    uint64_t n_acked = 0;
+    uint64_t start;
+
+    for (unsigned int i = 1; i <= n_updates; i++) {
+        size_t seqno_type = random_range(n_types);
+
+        start = test_time_ns();
+        ofctrl_seqno_update_create(seqno_type, ++app_seqnos[seqno_type]);
+        test_latencies_add(&update, test_time_ns() - start);
+
+        if (i % ack_interval && i != n_updates) {
+            continue;
+        }
+
+        start = test_time_ns();
+        ofctrl_seqno_run(ofctrl_seqno_get_req_cfg());
+        test_latencies_add(&ack, test_time_ns() - start);
+
+        for (size_t st = 0; st < n_types; st++) {
+            start = test_time_ns();
+            struct ofctrl_acked_seqnos *acked_seqnos =
+                ofctrl_acked_seqnos_get(st);
+            n_acked += hmap_count(&acked_seqnos->acked);
+            ofctrl_acked_seqnos_destroy(acked_seqnos);
+            test_latencies_add(&get_acked, test_time_ns() - start);
+        }
+    }
+
+    printf("%u types, %u updates, ack every %u updates\n",
+           n_types, n_updates, ack_interval);
+    printf("acked seqnos: %"PRIu64"\n", n_acked);
+    test_latencies_print_header();
+    test_latencies_print(&update);
+    test_latencies_print(&ack);
+    test_latencies_print(&get_acked);
+
+    test_latencies_destroy(&update);
+    test_latencies_destroy(&ack);
+    test_latencies_destroy(&get_acked);
+    free(app_seqnos);
+}
+
 static void
 test_ofctrl_seqno_main(int argc, char *argv[])
 {
@@ -167,6 +249,8 @@ test_ofctrl_seqno_main(int argc, char *argv[])
          test_ofctrl_seqno_add_type, OVS_RO},
         {"ofctrl_seqno_ack_seqnos", NULL, 2, INT_MAX,
          test_ofctrl_seqno_ack_seqnos, OVS_RO},
+        {"ofctrl_seqno_benchmark", NULL, 2, 4,
+         test_ofctrl_seqno_benchmark, OVS_RO},
         {NULL, NULL, 0, 0, NULL, OVS_RO},
     };
     struct ovs_cmdl_context ctx;
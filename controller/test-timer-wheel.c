@@ -0,0 +1,124 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+
+#include "tests/ovstest.h"
+#include "tests/test-utils.h"
+#include "util.h"
+
+#include "timer-wheel.h"
+
+#define TEST_N_TIMERS 16
+
+struct test_timer {
+    struct timer_wheel_node node;
+    unsigned int id;
+};
+
+static void
+test_timer_wheel_print_next(const struct timer_wheel *tw)
+{
+    long long int next = timer_wheel_next(tw);
+
+    printf("  n_timers: %"PRIuSIZE", next: ", timer_wheel_count(tw));
+    if (next == LLONG_MAX) {
+        printf("none\n");
+    } else if (next == LLONG_MIN) {
+        printf("now\n");
+    } else {
+        printf("%lld\n", next);
+    }
+}
+
+static void
+test_timer_wheel_operations(struct ovs_cmdl_context *ctx)
+{
+    struct test_timer timers[TEST_N_TIMERS];
+    struct timer_wheel tw;
+    unsigned int shift = 1;
+    unsigned int n_ops;
+
+    timer_wheel_init(&tw, 0);
+    for (unsigned int i = 0; i < TEST_N_TIMERS; i++) {
+        timer_wheel_node_init(&timers[i].node);
+        timers[i].id = i;
+    }
+
+    if (!test_read_uint_value(ctx, shift++, "n_ops", &n_ops)) {
+        goto done;
+    }
+
+    for (unsigned int i = 0; i < n_ops; i++) {
+        const char *op = test_read_value(ctx, shift++, "op");
+        unsigned int id, time;
+
+        if (!op) {
+            goto done;
+        }
+
+        if (!strcmp(op, "schedule")) {
+            if (!test_read_uint_value(ctx, shift++, "id", &id)
+                || !test_read_uint_value(ctx, shift++, "expires", &time)) {
+                goto done;
+            }
+            ovs_assert(id < TEST_N_TIMERS);
+            printf("SCHEDULE %u at %u\n", id, time);
+            timer_wheel_schedule(&tw, &timers[id].node, time);
+        } else if (!strcmp(op, "cancel")) {
+            if (!test_read_uint_value(ctx, shift++, "id", &id)) {
+                goto done;
+            }
+            ovs_assert(id < TEST_N_TIMERS);
+            printf("CANCEL %u\n", id);
+            timer_wheel_cancel(&tw, &timers[id].node);
+        } else if (!strcmp(op, "pop")) {
+            if (!test_read_uint_value(ctx, shift++, "now", &time)) {
+                goto done;
+            }
+
+            struct timer_wheel_node *node;
+            printf("POP at %u:", time);
+            while ((node = timer_wheel_pop(&tw, time))) {
+                struct test_timer *timer
+                    = CONTAINER_OF(node, struct test_timer, node);
+                ovs_assert(node->expires <= time);
+                printf(" %u", timer->id);
+            }
+            printf("\n");
+        } else {
+            OVS_NOT_REACHED();
+        }
+        test_timer_wheel_print_next(&tw);
+    }
+done:
+    timer_wheel_destroy(&tw);
+}
+
+static void
+test_timer_wheel_main(int argc, char *argv[])
+{
+    set_program_name(argv[0]);
+    static const struct ovs_cmdl_command commands[] = {
+        {"timer_wheel_operations", NULL, 1, INT_MAX,
+         test_timer_wheel_operations, OVS_RO},
+        {NULL, NULL, 0, 0, NULL, OVS_RO},
+    };
+    struct ovs_cmdl_context ctx;
+    ctx.argc = argc - 1;
+    ctx.argv = argv + 1;
+    ovs_cmdl_run_command(&ctx, commands);
+}
+
+OVSTEST_REGISTER("test-timer-wheel", test_timer_wheel_main);
@@ -0,0 +1,261 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+
+#include <limits.h>
+
+#include "timer-wheel.h"
+#include "util.h"
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/* Returns the span, in ms, of a slot of 'level'. */
+static long long int
+timer_wheel_span(int level)
+{
+    return 1LL << (TIMER_WHEEL_BITS * level);
+}
+
+static void
+timer_wheel_insert__(struct timer_wheel *tw, struct timer_wheel_node *node)
+{
+    long long int t = MAX(node->expires, tw->now);
+    long long int delta = t - tw->now;
+    int level = 0;
+
+    while (level < TIMER_WHEEL_LEVELS - 1
+           && delta >= timer_wheel_span(level + 1)) {
+        level++;
+    }
+    if (delta >= timer_wheel_span(TIMER_WHEEL_LEVELS)) {
+        /* Beyond the range of the wheel: rescheduled once the last slot is
+         * reached. */
+        t = tw->now + timer_wheel_span(TIMER_WHEEL_LEVELS) - 1;
+    }
+
+    node->level = level;
+    node->slot = (t >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    ovs_list_push_back(&tw->slots[level][node->slot], &node->list_node);
+    tw->occupied[level] |= UINT64_C(1) << node->slot;
+}
+
+/* Returns the time at which the first non-empty slot of 'level' is
+ * reached, or LLONG_MAX if the level is empty. */
+static long long int
+timer_wheel_level_next(const struct timer_wheel *tw, int level)
+{
+    uint64_t bits = tw->occupied[level];
+    if (!bits) {
+        return LLONG_MAX;
+    }
+
+    /* The slots of a level cover the TIMER_WHEEL_SLOTS spans that start
+     * with the first one not before 'now', so rotate the bitmap to start
+     * with that slot. */
+    int shift = TIMER_WHEEL_BITS * level;
+    long long int first = (tw->now + timer_wheel_span(level) - 1) >> shift;
+    unsigned int idx = first & TIMER_WHEEL_MASK;
+    if (idx) {
+        bits = (bits >> idx) | (bits << (TIMER_WHEEL_SLOTS - idx));
+    }
+    return (first + raw_ctz(bits)) << shift;
+}
+
+static long long int
+timer_wheel_next__(const struct timer_wheel *tw)
+{
+    long long int next = LLONG_MAX;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        next = MIN(next, timer_wheel_level_next(tw, level));
+    }
+    return next;
+}
+
+/* Moves the timers of the slot of 'level' that starts at 'now' to the lower
+ * levels. */
+static void
+timer_wheel_cascade(struct timer_wheel *tw, int level)
+{
+    if (tw->now & (timer_wheel_span(level) - 1)) {
+        return;
+    }
+
+    unsigned int slot
+        = (tw->now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    if (!(tw->occupied[level] & (UINT64_C(1) << slot))) {
+        return;
+    }
+
+    struct ovs_list timers;
+    ovs_list_move(&timers, &tw->slots[level][slot]);
+    ovs_list_init(&tw->slots[level][slot]);
+    tw->occupied[level] &= ~(UINT64_C(1) << slot);
+
+    struct timer_wheel_node *node;
+    LIST_FOR_EACH_POP (node, list_node, &timers) {
+        timer_wheel_insert__(tw, node);
+    }
+}
+
+/* Moves the timers that expire at or before 'now' to 'tw->expired'. */
+static void
+timer_wheel_advance(struct timer_wheel *tw, long long int now)
+{
+    for (;;) {
+        long long int next = timer_wheel_next__(tw);
+        if (next > now) {
+            break;
+        }
+
+        tw->now = next;
+        for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            timer_wheel_cascade(tw, level);
+        }
+
+        unsigned int slot = tw->now & TIMER_WHEEL_MASK;
+        if (tw->occupied[0] & (UINT64_C(1) << slot)) {
+            struct timer_wheel_node *node;
+            LIST_FOR_EACH_POP (node, list_node, &tw->slots[0][slot]) {
+                node->level = -1;
+                ovs_list_push_back(&tw->expired, &node->list_node);
+            }
+            tw->occupied[0] &= ~(UINT64_C(1) << slot);
+        }
+        tw->now++;
+    }
+
+    /* Nothing is scheduled up to 'now'. */
+    tw->now = MAX(tw->now, now);
+}
+
+void
+timer_wheel_init(struct timer_wheel *tw, long long int now)
+{
+    tw->now = now;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            ovs_list_init(&tw->slots[level][slot]);
+        }
+        tw->occupied[level] = 0;
+    }
+    ovs_list_init(&tw->expired);
+    tw->n_timers = 0;
+}
+
+/* Unschedules all the timers of 'tw'.  The timers themselves are owned by
+ * the caller. */
+void
+timer_wheel_destroy(struct timer_wheel *tw)
+{
+    struct timer_wheel_node *node;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            LIST_FOR_EACH_POP (node, list_node, &tw->slots[level][slot]) {
+                ovs_list_init(&node->list_node);
+            }
+        }
+        tw->occupied[level] = 0;
+    }
+    LIST_FOR_EACH_POP (node, list_node, &tw->expired) {
+        ovs_list_init(&node->list_node);
+    }
+    tw->n_timers = 0;
+}
+
+void
+timer_wheel_node_init(struct timer_wheel_node *node)
+{
+    ovs_list_init(&node->list_node);
+    node->expires = LLONG_MAX;
+    node->level = -1;
+    node->slot = 0;
+}
+
+bool
+timer_wheel_node_is_scheduled(const struct timer_wheel_node *node)
+{
+    return !ovs_list_is_empty(&node->list_node);
+}
+
+/* Schedules 'node' to expire at 'expires', in ms, replacing its previous
+ * expiration time if it was already scheduled.  A timer that is scheduled to
+ * expire before the time of the last timer_wheel_pop() expires 1 ms after
+ * it. */
+void
+timer_wheel_schedule(struct timer_wheel *tw, struct timer_wheel_node *node,
+                     long long int expires)
+{
+    timer_wheel_cancel(tw, node);
+    node->expires = expires;
+    timer_wheel_insert__(tw, node);
+    tw->n_timers++;
+}
+
+void
+timer_wheel_cancel(struct timer_wheel *tw, struct timer_wheel_node *node)
+{
+    if (!timer_wheel_node_is_scheduled(node)) {
+        return;
+    }
+
+    ovs_list_remove(&node->list_node);
+    if (node->level >= 0
+        && ovs_list_is_empty(&tw->slots[node->level][node->slot])) {
+        tw->occupied[node->level] &= ~(UINT64_C(1) << node->slot);
+    }
+    ovs_list_init(&node->list_node);
+    tw->n_timers--;
+}
+
+/* Returns a timer that expired at or before 'now' and unschedules it, or
+ * NULL if there is none.  The timers are not necessarily returned in the
+ * order of their expiration. */
+struct timer_wheel_node *
+timer_wheel_pop(struct timer_wheel *tw, long long int now)
+{
+    if (ovs_list_is_empty(&tw->expired)) {
+        timer_wheel_advance(tw, now);
+        if (ovs_list_is_empty(&tw->expired)) {
+            return NULL;
+        }
+    }
+
+    struct timer_wheel_node *node = CONTAINER_OF(
+        ovs_list_pop_front(&tw->expired), struct timer_wheel_node, list_node);
+    ovs_list_init(&node->list_node);
+    tw->n_timers--;
+    return node;
+}
+
+/* Returns the earliest time at which timer_wheel_pop() may return a timer,
+ * LLONG_MIN if it is already the case, or LLONG_MAX if no timer is
+ * scheduled.  The time may be earlier than the expiration of any timer, when
+ * timers have to be moved down the levels. */
+long long int
+timer_wheel_next(const struct timer_wheel *tw)
+{
+    if (!ovs_list_is_empty(&tw->expired)) {
+        return LLONG_MIN;
+    }
+    return timer_wheel_next__(tw);
+}
+
+size_t
+timer_wheel_count(const struct timer_wheel *tw)
+{
+    return tw->n_timers;
+}
@@ -0,0 +1,69 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "openvswitch/list.h"
+
+/* Hierarchical timer wheel.
+ *
+ * Timers have a resolution of 1 ms.  Level 0 has a slot per ms for the
+ * timers that expire in the next TIMER_WHEEL_SLOTS ms, and each slot of
+ * level 'n' covers TIMER_WHEEL_SLOTS times the span of a slot of level
+ * 'n - 1'.  When the time reaches the start of a slot of a higher level, its
+ * timers are moved down to the lower levels, so scheduling, cancelling and
+ * expiring a timer take constant time, whatever the number of timers.  The
+ * timers that expire later than the range of the top level are kept in its
+ * last slot and rescheduled when it is reached. */
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+struct timer_wheel_node {
+    struct ovs_list list_node;  /* In a slot or in 'expired'. */
+    long long int expires;      /* Expiration time, in ms. */
+    int level;                  /* Level of the slot, -1 if expired. */
+    unsigned int slot;
+};
+
+struct timer_wheel {
+    long long int now;          /* Next ms to process. */
+    struct ovs_list slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t occupied[TIMER_WHEEL_LEVELS]; /* Bitmaps of non-empty slots. */
+    struct ovs_list expired;    /* Expired timers, not popped yet. */
+    size_t n_timers;
+};
+
+void timer_wheel_init(struct timer_wheel *, long long int now);
+void timer_wheel_destroy(struct timer_wheel *);
+
+void timer_wheel_node_init(struct timer_wheel_node *);
+bool timer_wheel_node_is_scheduled(const struct timer_wheel_node *);
+
+void timer_wheel_schedule(struct timer_wheel *, struct timer_wheel_node *,
+                          long long int expires);
+void timer_wheel_cancel(struct timer_wheel *, struct timer_wheel_node *);
+
+struct timer_wheel_node *timer_wheel_pop(struct timer_wheel *,
+                                         long long int now);
+long long int timer_wheel_next(const struct timer_wheel *);
+size_t timer_wheel_count(const struct timer_wheel *);
+
+#endif /* controller/timer-wheel.h */
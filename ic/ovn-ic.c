@@ -67,6 +67,7 @@ struct ic_context {
     struct ovsdb_idl_index *sbrec_chassis_by_name;
     struct ovsdb_idl_index *sbrec_port_binding_by_name;
     struct ovsdb_idl_index *icsbrec_port_binding_by_ts;
+    struct ovsdb_idl_index *icsbrec_route_by_ts;
 };
 
 struct ic_state {
@@ -164,7 +165,7 @@ az_run(struct ic_context *ctx)
 }
 
 static uint32_t
-allocate_ts_dp_key(struct hmap *dp_tnlids)
+allocate_ts_dp_key(struct ovn_tnlids *dp_tnlids)
 {
     static uint32_t hint = OVN_MIN_DP_KEY_GLOBAL;
     return ovn_allocate_tnlid(dp_tnlids, "transit switch datapath",
@@ -177,7 +178,7 @@ ts_run(struct ic_context *ctx)
 {
     const struct icnbrec_transit_switch *ts;
 
-    struct hmap dp_tnlids = HMAP_INITIALIZER(&dp_tnlids);
+    struct ovn_tnlids dp_tnlids = OVN_TNLIDS_INITIALIZER;
     struct shash isb_dps = SHASH_INITIALIZER(&isb_dps);
     const struct icsbrec_datapath_binding *isb_dp;
     ICSBREC_DATAPATH_BINDING_FOR_EACH (isb_dp, ctx->ovnisb_idl) {
@@ -438,6 +439,61 @@ find_ts_in_nb(struct ic_context *ctx, char *ts_name)
     return NULL;
 }
 
+/* Skips a full sync of the databases while nothing it reads changed.
+ *
+ * ovn-ic has no change tracking: each sync compares all the rows it handles
+ * in the databases.  The result can only differ from the previous run if
+ * the contents of one of the IDLs changed, which is reflected by the IDL
+ * sequence numbers, or if what the previous run wrote was not committed. */
+struct ic_sync_gate {
+    unsigned int nb_seqno;
+    unsigned int sb_seqno;
+    unsigned int inb_seqno;
+    unsigned int isb_seqno;
+    bool needed;                /* Run even if the seqnos did not change. */
+};
+
+#define IC_SYNC_GATE_INITIALIZER { .needed = true }
+
+static struct ic_sync_gate port_binding_gate = IC_SYNC_GATE_INITIALIZER;
+static struct ic_sync_gate route_gate = IC_SYNC_GATE_INITIALIZER;
+
+/* Returns true if the sync guarded by 'gate' has to run, that is if one of
+ * the NB, IC-NB, IC-SB and, if 'use_sb' is true, SB IDLs changed since the
+ * previous time it ran, and records their current state. */
+static bool
+ic_sync_gate_check(struct ic_sync_gate *gate, const struct ic_context *ctx,
+                   bool use_sb)
+{
+    unsigned int nb_seqno = ovsdb_idl_get_seqno(ctx->ovnnb_idl);
+    unsigned int sb_seqno = use_sb ? ovsdb_idl_get_seqno(ctx->ovnsb_idl) : 0;
+    unsigned int inb_seqno = ovsdb_idl_get_seqno(ctx->ovninb_idl);
+    unsigned int isb_seqno = ovsdb_idl_get_seqno(ctx->ovnisb_idl);
+
+    if (!gate->needed && nb_seqno == gate->nb_seqno
+        && sb_seqno == gate->sb_seqno && inb_seqno == gate->inb_seqno
+        && isb_seqno == gate->isb_seqno) {
+        return false;
+    }
+
+    gate->nb_seqno = nb_seqno;
+    gate->sb_seqno = sb_seqno;
+    gate->inb_seqno = inb_seqno;
+    gate->isb_seqno = isb_seqno;
+    gate->needed = false;
+    return true;
+}
+
+/* Forces the next run of all the syncs, because the changes of the current
+ * one are still in flight or were lost.  The IDLs do not necessarily change
+ * when they are resolved. */
+static void
+ic_sync_gates_reset(void)
+{
+    port_binding_gate.needed = true;
+    route_gate.needed = true;
+}
+
 static const struct sbrec_port_binding *
 find_sb_pb_by_name(struct ovsdb_idl_index *sbrec_port_binding_by_name,
                    const char *name)
@@ -725,7 +781,7 @@ find_lsp_in_sb(struct ic_context *ctx,
 }
 
 static uint32_t
-allocate_port_key(struct hmap *pb_tnlids)
+allocate_port_key(struct ovn_tnlids *pb_tnlids)
 {
     static uint32_t hint;
     return ovn_allocate_tnlid(pb_tnlids, "transit port",
@@ -740,6 +796,10 @@ port_binding_run(struct ic_context *ctx,
         return;
     }
 
+    if (!ic_sync_gate_check(&port_binding_gate, ctx, true)) {
+        return;
+    }
+
     const struct icnbrec_transit_switch *ts;
     ICNBREC_TRANSIT_SWITCH_FOR_EACH (ts, ctx->ovninb_idl) {
         const struct nbrec_logical_switch *ls = find_ts_in_nb(ctx, ts->name);
@@ -749,7 +809,7 @@ port_binding_run(struct ic_context *ctx,
         }
         struct shash local_pbs = SHASH_INITIALIZER(&local_pbs);
         struct shash remote_pbs = SHASH_INITIALIZER(&remote_pbs);
-        struct hmap pb_tnlids = HMAP_INITIALIZER(&pb_tnlids);
+        struct ovn_tnlids pb_tnlids = OVN_TNLIDS_INITIALIZER;
         const struct icsbrec_port_binding *isb_pb;
         const struct icsbrec_port_binding *isb_pb_key =
             icsbrec_port_binding_index_init_row(
@@ -945,9 +1005,8 @@ prefix_is_link_local(struct in6_addr *prefix, unsigned int plen)
         if (plen < 16) {
             return false;
         }
-        ovs_be32 lla;
-        inet_pton(AF_INET, "169.254.0.0", &lla);
-        return ((in6_addr_get_mapped_ipv4(prefix) & htonl(0xffff0000)) == lla);
+        return ((in6_addr_get_mapped_ipv4(prefix) & htonl(0xffff0000))
+                == htonl(0xa9fe0000));
     }
 
     /* ipv6, link local range is "fe80::/10". */
@@ -958,20 +1017,110 @@ prefix_is_link_local(struct in6_addr *prefix, unsigned int plen)
             ((prefix->s6_addr[1] & 0xc0) == 0x80));
 }
 
+/* Binary trie of IP prefixes, with one bit of the address per level, to
+ * find whether a route falls in one of many prefixes in O(prefix length).
+ * IPv4 and IPv6 prefixes are kept in separate tries, so that an IPv6
+ * prefix never matches an IPv4 route. */
+struct prefix_trie_node {
+    struct prefix_trie_node *children[2];
+    bool terminal;              /* A prefix ends at this node. */
+};
+
+struct prefix_trie {
+    struct prefix_trie_node *roots[2]; /* For IPv6 ([0]) and IPv4 ([1]). */
+};
+
+/* Returns the bit of 'addr' at 'depth' in the trie, counting from the most
+ * significant bit of the IPv4 address for IPv4-mapped addresses. */
+static unsigned int
+prefix_trie_bit(const struct in6_addr *addr, bool is_ipv4, unsigned int depth)
+{
+    unsigned int bit = is_ipv4 ? 96 + depth : depth;
+    return (addr->s6_addr[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+static void
+prefix_trie_insert(struct prefix_trie *trie, const struct in6_addr *prefix,
+                   unsigned int plen)
+{
+    bool is_ipv4 = IN6_IS_ADDR_V4MAPPED(prefix);
+    struct prefix_trie_node **nodep = &trie->roots[is_ipv4];
+
+    for (unsigned int depth = 0; ; depth++) {
+        if (!*nodep) {
+            *nodep = xzalloc(sizeof **nodep);
+        }
+        if (depth >= plen) {
+            break;
+        }
+        nodep = &(*nodep)->children[prefix_trie_bit(prefix, is_ipv4, depth)];
+    }
+    (*nodep)->terminal = true;
+}
+
+/* Returns true if 'prefix'/'plen' is included in one of the prefixes of
+ * 'trie', i.e. if one of them is not longer than 'plen' and matches its
+ * leading bits. */
 static bool
-prefix_is_black_listed(const struct smap *nb_options,
-                       struct in6_addr *prefix,
-                       unsigned int plen)
+prefix_trie_contains(const struct prefix_trie *trie,
+                     const struct in6_addr *prefix, unsigned int plen)
 {
-    const char *blacklist = smap_get(nb_options, "ic-route-blacklist");
-    if (!blacklist || !blacklist[0]) {
-        return false;
+    bool is_ipv4 = IN6_IS_ADDR_V4MAPPED(prefix);
+    const struct prefix_trie_node *node = trie->roots[is_ipv4];
+
+    for (unsigned int depth = 0; node; depth++) {
+        if (node->terminal) {
+            return true;
+        }
+        if (depth >= plen) {
+            break;
+        }
+        node = node->children[prefix_trie_bit(prefix, is_ipv4, depth)];
+    }
+    return false;
+}
+
+static void
+prefix_trie_node_destroy(struct prefix_trie_node *node)
+{
+    if (node) {
+        prefix_trie_node_destroy(node->children[0]);
+        prefix_trie_node_destroy(node->children[1]);
+        free(node);
+    }
+}
+
+static void
+prefix_trie_destroy(struct prefix_trie *trie)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(trie->roots); i++) {
+        prefix_trie_node_destroy(trie->roots[i]);
+        trie->roots[i] = NULL;
+    }
+}
+
+/* Returns the trie of the prefixes of the nb_global options:
+ * ic-route-blacklist, which is only parsed again when the option changes. */
+static const struct prefix_trie *
+get_route_blacklist(const struct smap *nb_options)
+{
+    static struct prefix_trie blacklist_trie;
+    static char *blacklist_s;
+
+    const char *blacklist = smap_get_def(nb_options, "ic-route-blacklist",
+                                         "");
+    if (blacklist_s && !strcmp(blacklist, blacklist_s)) {
+        return &blacklist_trie;
     }
+
+    prefix_trie_destroy(&blacklist_trie);
+    free(blacklist_s);
+    blacklist_s = xstrdup(blacklist);
+
     struct in6_addr bl_prefix;
     unsigned int bl_plen;
     char *cur, *next, *start;
     next = start = xstrdup(blacklist);
-    bool matched = false;
     while ((cur = strsep(&next, ",")) && *cur) {
         if (!ip46_parse_cidr(cur, &bl_prefix, &bl_plen)) {
             static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
@@ -979,38 +1128,19 @@ prefix_is_black_listed(const struct smap *nb_options,
                          "ic-route-blacklist: %s. CIDR expected.", cur);
             continue;
         }
-
-        if (IN6_IS_ADDR_V4MAPPED(&bl_prefix) != IN6_IS_ADDR_V4MAPPED(prefix)) {
-            continue;
-        }
-
-        /* 192.168.0.0/16 does not belong to 192.168.0.0/17 */
-        if (plen < bl_plen) {
-            continue;
-        }
-
-        if (IN6_IS_ADDR_V4MAPPED(prefix)) {
-            ovs_be32 bl_prefix_v4 = in6_addr_get_mapped_ipv4(&bl_prefix);
-            ovs_be32 prefix_v4 = in6_addr_get_mapped_ipv4(prefix);
-            ovs_be32 mask = be32_prefix_mask(bl_plen);
-
-            if ((prefix_v4 & mask) != (bl_prefix_v4 & mask)) {
-                continue;
-            }
-        } else {
-            struct in6_addr mask = ipv6_create_mask(bl_plen);
-            for (int i = 0; i < 16 && mask.s6_addr[i] != 0; i++) {
-                if ((prefix->s6_addr[i] & mask.s6_addr[i])
-                    != (bl_prefix.s6_addr[i] & mask.s6_addr[i])) {
-                    continue;
-                }
-            }
-        }
-        matched = true;
-        break;
+        prefix_trie_insert(&blacklist_trie, &bl_prefix, bl_plen);
     }
     free(start);
-    return matched;
+    return &blacklist_trie;
+}
+
+static bool
+prefix_is_black_listed(const struct smap *nb_options,
+                       struct in6_addr *prefix,
+                       unsigned int plen)
+{
+    return prefix_trie_contains(get_route_blacklist(nb_options),
+                                prefix, plen);
 }
 
 static bool
@@ -1149,12 +1279,26 @@ route_need_learn(struct in6_addr *prefix,
     return true;
 }
 
-static void
-sync_learned_route(struct ic_context *ctx,
-                   const struct icsbrec_availability_zone *az,
-                   struct ic_router_info *ic_lr)
+/* A route of another availability zone in IC-SB that is to be learned. */
+struct ic_isb_route {
+    const struct icsbrec_route *isb_route;
+    struct in6_addr prefix;
+    unsigned int plen;
+    struct in6_addr nexthop;
+};
+
+/* Parses the IC-SB routes of the other availability zones and returns the
+ * ones that are to be learned, in a malloc()'d array of '*n_routes'
+ * elements, so that they are parsed and filtered only once for all the
+ * routers. */
+static struct ic_isb_route *
+get_routes_to_learn(struct ic_context *ctx,
+                    const struct icsbrec_availability_zone *az,
+                    const struct smap *nb_options, size_t *n_routes)
 {
-    ovs_assert(ctx->ovnnb_txn);
+    struct ic_isb_route *routes = NULL;
+    size_t n = 0, allocated = 0;
+
     const struct icsbrec_route *isb_route;
     ICSBREC_ROUTE_FOR_EACH (isb_route, ctx->ovnisb_idl) {
         if (isb_route->availability_zone == az) {
@@ -1169,14 +1313,38 @@ sync_learned_route(struct ic_context *ctx,
                          isb_route->ip_prefix, isb_route->nexthop);
             continue;
         }
-        const struct nbrec_nb_global *nb_global =
-            nbrec_nb_global_first(ctx->ovnnb_idl);
-        ovs_assert(nb_global);
-        if (!route_need_learn(&prefix, plen, &nb_global->options)) {
+        if (!route_need_learn(&prefix, plen, nb_options)) {
             continue;
         }
+        if (n >= allocated) {
+            routes = x2nrealloc(routes, &allocated, sizeof *routes);
+        }
+        routes[n++] = (struct ic_isb_route) {
+            .isb_route = isb_route,
+            .prefix = prefix,
+            .plen = plen,
+            .nexthop = nexthop,
+        };
+    }
+
+    *n_routes = n;
+    return routes;
+}
+
+static void
+sync_learned_route(struct ic_context *ctx,
+                   const struct ic_isb_route *routes, size_t n_routes,
+                   struct ic_router_info *ic_lr)
+{
+    ovs_assert(ctx->ovnnb_txn);
+    for (size_t i = 0; i < n_routes; i++) {
+        const struct icsbrec_route *isb_route = routes[i].isb_route;
+        const struct in6_addr *prefix = &routes[i].prefix;
+        const struct in6_addr *nexthop = &routes[i].nexthop;
+        unsigned int plen = routes[i].plen;
+
         struct ic_route_info *route_learned
-            = ic_route_find(&ic_lr->routes_learned, &prefix, plen, &nexthop);
+            = ic_route_find(&ic_lr->routes_learned, prefix, plen, nexthop);
         if (route_learned) {
             /* Sync external-ids */
             struct uuid ext_id;
@@ -1245,15 +1413,32 @@ advertise_route(struct ic_context *ctx,
                 struct hmap *routes_ad)
 {
     ovs_assert(ctx->ovnisb_txn);
+
+    /* Collect the routes of the TS advertised by this AZ first, since they
+     * may be deleted below. */
+    const struct icsbrec_route **isb_routes = NULL;
+    size_t n_isb_routes = 0, allocated_isb_routes = 0;
+
     const struct icsbrec_route *isb_route;
-    ICSBREC_ROUTE_FOR_EACH (isb_route, ctx->ovnisb_idl) {
-        if (strcmp(isb_route->transit_switch, ts_name)) {
-            continue;
-        }
+    const struct icsbrec_route *isb_route_key =
+        icsbrec_route_index_init_row(ctx->icsbrec_route_by_ts);
+    icsbrec_route_index_set_transit_switch(isb_route_key, ts_name);
 
+    ICSBREC_ROUTE_FOR_EACH_EQUAL (isb_route, isb_route_key,
+                                  ctx->icsbrec_route_by_ts) {
         if (isb_route->availability_zone != az) {
             continue;
         }
+        if (n_isb_routes >= allocated_isb_routes) {
+            isb_routes = x2nrealloc(isb_routes, &allocated_isb_routes,
+                                    sizeof *isb_routes);
+        }
+        isb_routes[n_isb_routes++] = isb_route;
+    }
+    icsbrec_route_index_destroy_row(isb_route_key);
+
+    for (size_t i = 0; i < n_isb_routes; i++) {
+        isb_route = isb_routes[i];
 
         struct in6_addr prefix, nexthop;
         unsigned int plen;
@@ -1282,6 +1467,7 @@ advertise_route(struct ic_context *ctx,
             free(route_adv);
         }
     }
+    free(isb_routes);
 
     /* Create the missing routes in IC-SB */
     struct ic_route_info *route_adv, *next;
@@ -1344,10 +1530,19 @@ route_run(struct ic_context *ctx,
         return;
     }
 
+    /* The routes only depend on the NB, IC-NB and IC-SB contents. */
+    if (!ic_sync_gate_check(&route_gate, ctx, false)) {
+        return;
+    }
+
     const struct nbrec_nb_global *nb_global =
         nbrec_nb_global_first(ctx->ovnnb_idl);
     ovs_assert(nb_global);
 
+    size_t n_routes_to_learn;
+    struct ic_isb_route *routes_to_learn =
+        get_routes_to_learn(ctx, az, &nb_global->options, &n_routes_to_learn);
+
     const struct icnbrec_transit_switch *ts;
     ICNBREC_TRANSIT_SWITCH_FOR_EACH (ts, ctx->ovninb_idl) {
         struct hmap ic_lrs = HMAP_INITIALIZER(&ic_lrs);
@@ -1464,13 +1659,15 @@ route_run(struct ic_context *ctx,
 
         struct ic_router_info *ic_lr, *next;
         HMAP_FOR_EACH_SAFE (ic_lr, next, node, &ic_lrs) {
-            sync_learned_route(ctx, az, ic_lr);
+            sync_learned_route(ctx, routes_to_learn, n_routes_to_learn,
+                               ic_lr);
             hmap_destroy(&ic_lr->routes_learned);
             hmap_remove(&ic_lrs, &ic_lr->node);
             free(ic_lr);
         }
         hmap_destroy(&ic_lrs);
     }
+    free(routes_to_learn);
 }
 
 static void
@@ -1677,6 +1874,9 @@ main(int argc, char *argv[])
     struct ovsdb_idl_index *icsbrec_port_binding_by_ts
         = ovsdb_idl_index_create1(ovnisb_idl_loop.idl,
                                   &icsbrec_port_binding_col_transit_switch);
+    struct ovsdb_idl_index *icsbrec_route_by_ts
+        = ovsdb_idl_index_create1(ovnisb_idl_loop.idl,
+                                  &icsbrec_route_col_transit_switch);
 
     /* Main loop. */
     exiting = false;
@@ -1718,12 +1918,14 @@ main(int argc, char *argv[])
                 .sbrec_port_binding_by_name = sbrec_port_binding_by_name,
                 .sbrec_chassis_by_name = sbrec_chassis_by_name,
                 .icsbrec_port_binding_by_ts = icsbrec_port_binding_by_ts,
+                .icsbrec_route_by_ts = icsbrec_route_by_ts,
             };
 
             if (!state.had_lock && ovsdb_idl_has_lock(ovnsb_idl_loop.idl)) {
                 VLOG_INFO("ovn-ic lock acquired. "
                         "This ovn-ic instance is now active.");
                 state.had_lock = true;
+                ic_sync_gates_reset();
             } else if (state.had_lock &&
                        !ovsdb_idl_has_lock(ovnsb_idl_loop.idl)) {
                 VLOG_INFO("ovn-ic lock lost. "
@@ -1735,10 +1937,14 @@ main(int argc, char *argv[])
                 ovn_db_run(&ctx);
             }
 
-            ovsdb_idl_loop_commit_and_wait(&ovnnb_idl_loop);
-            ovsdb_idl_loop_commit_and_wait(&ovnsb_idl_loop);
-            ovsdb_idl_loop_commit_and_wait(&ovninb_idl_loop);
-            ovsdb_idl_loop_commit_and_wait(&ovnisb_idl_loop);
+            int nb_status = ovsdb_idl_loop_commit_and_wait(&ovnnb_idl_loop);
+            int sb_status = ovsdb_idl_loop_commit_and_wait(&ovnsb_idl_loop);
+            int inb_status = ovsdb_idl_loop_commit_and_wait(&ovninb_idl_loop);
+            int isb_status = ovsdb_idl_loop_commit_and_wait(&ovnisb_idl_loop);
+            if (nb_status != 1 || sb_status != 1 || inb_status != 1
+                || isb_status != 1) {
+                ic_sync_gates_reset();
+            }
         } else {
             /* ovn-ic is paused
              *    - we still want to handle any db updates and update the
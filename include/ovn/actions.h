@@ -795,6 +795,10 @@ struct ovnact_encode_params {
                          * 'get_fdb' to resubmit. */
     uint8_t fdb_lookup_ptable; /* OpenFlow table for
                                 * 'lookup_fdb' to resubmit. */
+
+    /* OpenFlow controller id to which 'handle_bfd_msg' sends its packets,
+     * 0 for the default connections. */
+    uint16_t bfd_controller_id;
 };
 
 void ovnacts_encode(const struct ovnact[], size_t ovnacts_len,
@@ -262,6 +262,11 @@ struct expr_symbol {
     bool must_crossproduct;
     enum expr_write_scope rw; /* Bit map indicating in which nested contexts
                                * the symbol is writeable */
+
+    /* Annotated 'prereqs' and 'predicate', if expr_symtab_compile() could
+     * annotate them, otherwise NULL. */
+    struct expr *prereqs_expr;
+    struct expr *predicate_expr;
 };
 
 void expr_symbol_format(const struct expr_symbol *, struct ds *);
@@ -316,6 +321,7 @@ struct expr_symbol *expr_symtab_add_predicate(struct shash *symtab,
 struct expr_symbol *expr_symtab_add_ovn_field(struct shash *symtab,
                                               const char *name,
                                               enum ovn_field_id id);
+void expr_symtab_compile(struct shash *symtab);
 void expr_symtab_destroy(struct shash *symtab);
 
 /* Expression type. */
@@ -437,6 +443,13 @@ struct expr *expr_parse_string(const char *, const struct shash *symtab,
 struct expr *expr_clone(struct expr *);
 void expr_destroy(struct expr *);
 
+/* Numbers of expression nodes allocated by a thread. */
+struct expr_node_stats {
+    unsigned long long int n_allocated; /* With malloc(). */
+    unsigned long long int n_reused;    /* Freed nodes reused instead. */
+};
+void expr_get_node_stats(struct expr_node_stats *);
+
 struct expr *expr_annotate(struct expr *, const struct shash *symtab,
                            char **errorp);
 struct expr *expr_simplify(struct expr *);
@@ -445,7 +458,14 @@ struct expr *expr_evaluate_condition(
     bool (*is_chassis_resident)(const void *c_aux,
                                 const char *port_name),
     const void *c_aux, bool *condition_present);
+bool expr_get_condition_state(
+    const struct expr *,
+    bool (*is_chassis_resident)(const void *c_aux,
+                                const char *port_name),
+    const void *c_aux, uint64_t *statep);
 struct expr *expr_normalize(struct expr *);
+bool expr_set_aggregate_prefixes(bool all);
+bool expr_may_aggregate(size_t n_cmps);
 
 bool expr_honors_invariants(const struct expr *);
 bool expr_is_simplified(const struct expr *);
@@ -465,6 +485,12 @@ bool expr_evaluate(const struct expr *, const struct flow *uflow,
                    bool (*lookup_port)(const void *aux, const char *port_name,
                                        unsigned int *portp),
                    const void *aux);
+void expr_evaluate_batch(const struct expr *, const struct flow flows[],
+                         size_t n_flows,
+                         bool (*lookup_port)(const void *aux,
+                                             const char *port_name,
+                                             unsigned int *portp),
+                         const void *aux, unsigned long *results);
 
 /* Converting expressions to OpenFlow flows. */
 
@@ -483,6 +509,7 @@ uint32_t expr_to_matches(const struct expr *,
                                              unsigned int *portp),
                          const void *aux,
                          struct hmap *matches);
+bool expr_set_cross_product_limit(unsigned int limit);
 void expr_matches_destroy(struct hmap *matches);
 size_t expr_matches_prepare(struct hmap *matches, uint32_t conj_id_ofs);
 void expr_matches_print(const struct hmap *matches, FILE *);
@@ -537,6 +564,10 @@ struct expr_constant_set {
 bool expr_constant_set_parse(struct lexer *, struct expr_constant_set *);
 void expr_constant_set_format(const struct expr_constant_set *, struct ds *);
 void expr_constant_set_destroy(struct expr_constant_set *cs);
+void expr_constant_set_diff(const struct expr_constant_set *old_cs,
+                            const struct expr_constant_set *new_cs,
+                            struct expr_constant_set **added,
+                            struct expr_constant_set **deleted);
 
 
 /* Constant sets.
@@ -54,6 +54,8 @@ enum ovn_controller_event {
 #define MFF_N_LOG_REGS 10
 
 void ovn_init_symtab(struct shash *symtab);
+const struct shash *ovn_symtab_ref(void);
+void ovn_symtab_unref(void);
 
 /* MFF_LOG_FLAGS_REG bit assignments */
 enum mff_log_flags_bits {
@@ -18,13 +18,59 @@
 #include "acl-log.h"
 #include <string.h>
 #include "flow.h"
+#include "hash.h"
+#include "openvswitch/hmap.h"
 #include "openvswitch/json.h"
 #include "openvswitch/ofpbuf.h"
+#include "openvswitch/poll-loop.h"
 #include "openvswitch/vlog.h"
+#include "ovs-thread.h"
+#include "packets.h"
+#include "timeval.h"
+#include "util.h"
 
 
 VLOG_DEFINE_THIS_MODULE(acl_log);
 
+/* Aggregation of the log messages of identical packets.
+ *
+ * The packets that hit the same logged ACL with the same addresses,
+ * protocol and ports, within 'aggregate_interval' ms of the first one, are
+ * not logged individually.  The first one is logged when it is received,
+ * and the number of the others, if any, is logged at the end of the
+ * interval. */
+struct acl_log_key {
+    struct in6_addr src;        /* IPv4 addresses are IPv4-mapped. */
+    struct in6_addr dst;
+    ovs_be16 dl_type;
+    ovs_be16 tp_src;
+    ovs_be16 tp_dst;
+    uint8_t nw_proto;
+    uint8_t verdict;
+    uint8_t severity;
+    uint8_t pad[3];
+};
+
+struct acl_log_entry {
+    struct hmap_node hmap_node; /* In 'acl_log_entries'. */
+    struct acl_log_key key;
+    char *name;                 /* Name of the ACL, may be NULL. */
+    struct flow headers;        /* Headers of the first packet. */
+    long long int expires;      /* End of the aggregation interval. */
+    unsigned int n_suppressed;  /* Packets not logged since the first. */
+};
+
+/* Maximum number of aggregated entries.  Beyond that, the packets are
+ * logged individually. */
+#define ACL_LOG_MAX_ENTRIES 1000
+
+static struct ovs_mutex acl_log_mutex = OVS_MUTEX_INITIALIZER;
+static struct hmap acl_log_entries OVS_GUARDED_BY(acl_log_mutex)
+    = HMAP_INITIALIZER(&acl_log_entries);
+static unsigned int aggregate_interval OVS_GUARDED_BY(acl_log_mutex);
+static long long int acl_log_next_flush OVS_GUARDED_BY(acl_log_mutex)
+    = LLONG_MAX;
+
 const char *
 log_verdict_to_string(uint8_t verdict)
 {
@@ -75,6 +121,134 @@ log_severity_from_string(const char *name)
     }
 }
 
+static void
+format_acl_log(struct ds *ds, const char *name, uint8_t verdict,
+               uint8_t severity, const struct flow *headers)
+{
+    ds_put_cstr(ds, "name=");
+    json_string_escape(name ? name : "<unnamed>", ds);
+    ds_put_format(ds, ", verdict=%s, severity=%s: ",
+                  log_verdict_to_string(verdict),
+                  log_severity_to_string(severity));
+    flow_format(ds, headers, NULL);
+}
+
+static void
+acl_log_key_init(struct acl_log_key *key, const struct flow *headers,
+                 uint8_t verdict, uint8_t severity)
+{
+    memset(key, 0, sizeof *key);
+    if (headers->dl_type == htons(ETH_TYPE_IP)) {
+        in6_addr_set_mapped_ipv4(&key->src, headers->nw_src);
+        in6_addr_set_mapped_ipv4(&key->dst, headers->nw_dst);
+    } else if (headers->dl_type == htons(ETH_TYPE_IPV6)) {
+        key->src = headers->ipv6_src;
+        key->dst = headers->ipv6_dst;
+    }
+    key->dl_type = headers->dl_type;
+    key->nw_proto = headers->nw_proto;
+    key->tp_src = headers->tp_src;
+    key->tp_dst = headers->tp_dst;
+    key->verdict = verdict;
+    key->severity = severity;
+}
+
+static uint32_t
+acl_log_hash(const struct acl_log_key *key, const char *name)
+{
+    return hash_string(name ? name : "", hash_bytes(key, sizeof *key, 0));
+}
+
+static struct acl_log_entry *
+acl_log_find(const struct acl_log_key *key, const char *name, uint32_t hash)
+    OVS_REQUIRES(acl_log_mutex)
+{
+    struct acl_log_entry *e;
+    HMAP_FOR_EACH_WITH_HASH (e, hmap_node, hash, &acl_log_entries) {
+        if (!memcmp(&e->key, key, sizeof *key)
+            && nullable_string_is_equal(e->name, name)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/* Logs the number of packets of 'e' that were not logged, if any, and
+ * destroys 'e'. */
+static void
+acl_log_flush_entry(struct acl_log_entry *e)
+    OVS_REQUIRES(acl_log_mutex)
+{
+    if (e->n_suppressed) {
+        struct ds ds = DS_EMPTY_INITIALIZER;
+        format_acl_log(&ds, e->name, e->key.verdict, e->key.severity,
+                       &e->headers);
+        ds_put_format(&ds, ", suppressed=%u", e->n_suppressed);
+        VLOG_INFO("%s", ds_cstr(&ds));
+        ds_destroy(&ds);
+    }
+    hmap_remove(&acl_log_entries, &e->hmap_node);
+    free(e->name);
+    free(e);
+}
+
+/* Flushes the entries whose aggregation interval ended at 'now'. */
+static void
+acl_log_flush(long long int now)
+    OVS_REQUIRES(acl_log_mutex)
+{
+    if (now < acl_log_next_flush) {
+        return;
+    }
+
+    struct acl_log_entry *e, *next;
+    acl_log_next_flush = LLONG_MAX;
+    HMAP_FOR_EACH_SAFE (e, next, hmap_node, &acl_log_entries) {
+        if (e->expires <= now) {
+            acl_log_flush_entry(e);
+        } else {
+            acl_log_next_flush = MIN(acl_log_next_flush, e->expires);
+        }
+    }
+}
+
+/* Returns true if the packet with 'headers' has to be logged, false if it
+ * is aggregated with a previous one. */
+static bool
+acl_log_aggregate(const struct flow *headers, const char *name,
+                  uint8_t verdict, uint8_t severity)
+    OVS_REQUIRES(acl_log_mutex)
+{
+    if (!aggregate_interval) {
+        return true;
+    }
+
+    long long int now = time_msec();
+    acl_log_flush(now);
+
+    struct acl_log_key key;
+    acl_log_key_init(&key, headers, verdict, severity);
+    uint32_t hash = acl_log_hash(&key, name);
+
+    struct acl_log_entry *e = acl_log_find(&key, name, hash);
+    if (e) {
+        e->n_suppressed++;
+        return false;
+    }
+
+    if (hmap_count(&acl_log_entries) < ACL_LOG_MAX_ENTRIES) {
+        e = xmalloc(sizeof *e);
+        e->key = key;
+        e->name = nullable_xstrdup(name);
+        e->headers = *headers;
+        e->expires = now + aggregate_interval;
+        e->n_suppressed = 0;
+        hmap_insert(&acl_log_entries, &e->hmap_node, hash);
+        acl_log_next_flush = MIN(acl_log_next_flush, e->expires);
+    }
+    return true;
+}
+
 void
 handle_acl_log(const struct flow *headers, struct ofpbuf *userdata)
 {
@@ -91,15 +265,53 @@ handle_acl_log(const struct flow *headers, struct ofpbuf *userdata)
     size_t name_len = userdata->size;
     char *name = name_len ? xmemdup0(userdata->data, name_len) : NULL;
 
-    struct ds ds = DS_EMPTY_INITIALIZER;
-    ds_put_cstr(&ds, "name=");
-    json_string_escape(name_len ? name : "<unnamed>", &ds);
-    ds_put_format(&ds, ", verdict=%s, severity=%s: ",
-                  log_verdict_to_string(lph->verdict),
-                  log_severity_to_string(lph->severity));
-    flow_format(&ds, headers, NULL);
+    ovs_mutex_lock(&acl_log_mutex);
+    bool emit = acl_log_aggregate(headers, name, lph->verdict,
+                                  lph->severity);
+    ovs_mutex_unlock(&acl_log_mutex);
 
-    VLOG_INFO("%s", ds_cstr(&ds));
-    ds_destroy(&ds);
+    if (emit) {
+        struct ds ds = DS_EMPTY_INITIALIZER;
+        format_acl_log(&ds, name, lph->verdict, lph->severity, headers);
+        VLOG_INFO("%s", ds_cstr(&ds));
+        ds_destroy(&ds);
+    }
     free(name);
 }
+
+/* Sets the interval, in ms, over which the log messages of identical
+ * packets are aggregated, 0 to log every packet.  The pending aggregated
+ * messages are flushed when the interval changes. */
+void
+acl_log_set_aggregate_interval(unsigned int interval)
+{
+    ovs_mutex_lock(&acl_log_mutex);
+    if (interval != aggregate_interval) {
+        struct acl_log_entry *e, *next;
+        HMAP_FOR_EACH_SAFE (e, next, hmap_node, &acl_log_entries) {
+            acl_log_flush_entry(e);
+        }
+        acl_log_next_flush = LLONG_MAX;
+        aggregate_interval = interval;
+    }
+    ovs_mutex_unlock(&acl_log_mutex);
+}
+
+/* Logs the aggregated messages whose interval ended. */
+void
+acl_log_run(void)
+{
+    ovs_mutex_lock(&acl_log_mutex);
+    acl_log_flush(time_msec());
+    ovs_mutex_unlock(&acl_log_mutex);
+}
+
+void
+acl_log_wait(void)
+{
+    ovs_mutex_lock(&acl_log_mutex);
+    if (acl_log_next_flush != LLONG_MAX) {
+        poll_timer_wait_until(acl_log_next_flush);
+    }
+    ovs_mutex_unlock(&acl_log_mutex);
+}
@@ -50,5 +50,8 @@ const char *log_severity_to_string(uint8_t severity);
 uint8_t log_severity_from_string(const char *name);
 
 void handle_acl_log(const struct flow *headers, struct ofpbuf *userdata);
+void acl_log_set_aggregate_interval(unsigned int interval);
+void acl_log_run(void);
+void acl_log_wait(void);
 
 #endif /* lib/acl-log.h */
@@ -2770,10 +2770,14 @@ format_BFD_MSG(const struct ovnact_null *a OVS_UNUSED, struct ds *s)
 
 static void
 encode_BFD_MSG(const struct ovnact_null *a OVS_UNUSED,
-               const struct ovnact_encode_params *ep OVS_UNUSED,
+               const struct ovnact_encode_params *ep,
                struct ofpbuf *ofpacts)
 {
-    encode_controller_op(ACTION_OPCODE_BFD_MSG, ofpacts);
+    size_t ofs = encode_start_controller_op(ACTION_OPCODE_BFD_MSG, false,
+                                            NX_CTLR_NO_METER, ofpacts);
+    struct ofpact_controller *oc = ofpbuf_at_assert(ofpacts, ofs, sizeof *oc);
+    oc->controller_id = ep->bfd_controller_id;
+    encode_finish_controller_op(ofs, ofpacts);
 }
 
 static void
@@ -0,0 +1,155 @@
+/* Copyright (c) 2021, Red Hat, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "util.h"
+
+/* Default size of the blocks, including the header. */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* Alignment of all allocations, enough for any basic type. */
+#define ARENA_ALIGN 16
+
+/* The usable memory of a block follows its header, at offset
+ * ARENA_BLOCK_HEADER. */
+struct arena_block {
+    struct arena_block *next;
+    size_t size;                /* Usable bytes. */
+    size_t used;                /* Bytes already allocated. */
+};
+
+#define ARENA_BLOCK_HEADER ROUND_UP(sizeof(struct arena_block), ARENA_ALIGN)
+
+void
+arena_init(struct arena *arena)
+{
+    arena->blocks = NULL;
+    arena->free = NULL;
+}
+
+static void
+arena_free_blocks(struct arena_block *block)
+{
+    while (block) {
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+/* Frees all the memory of 'arena'. */
+void
+arena_destroy(struct arena *arena)
+{
+    if (arena) {
+        arena_free_blocks(arena->blocks);
+        arena_free_blocks(arena->free);
+        arena_init(arena);
+    }
+}
+
+/* Releases all the allocations made from 'arena' at once.  The memory is
+ * kept for later allocations. */
+void
+arena_clear(struct arena *arena)
+{
+    struct arena_block *block = arena->blocks;
+
+    while (block) {
+        struct arena_block *next = block->next;
+
+        block->used = 0;
+        block->next = arena->free;
+        arena->free = block;
+        block = next;
+    }
+    arena->blocks = NULL;
+}
+
+/* Makes a block with at least 'size' usable bytes the current block of
+ * 'arena', reusing a released block if possible. */
+static struct arena_block *
+arena_new_block(struct arena *arena, size_t size)
+{
+    struct arena_block **prev, *block;
+
+    for (prev = &arena->free; *prev; prev = &(*prev)->next) {
+        if ((*prev)->size >= size) {
+            block = *prev;
+            *prev = block->next;
+            goto out;
+        }
+    }
+
+    size_t usable = MAX(ARENA_BLOCK_SIZE - ARENA_BLOCK_HEADER, size);
+    block = xmalloc(ARENA_BLOCK_HEADER + usable);
+    block->size = usable;
+    block->used = 0;
+
+out:
+    block->next = arena->blocks;
+    arena->blocks = block;
+    return block;
+}
+
+/* Returns 'size' bytes of memory from 'arena', aligned for any basic type.
+ * The memory stays valid until 'arena' is cleared or destroyed. */
+void *
+arena_alloc(struct arena *arena, size_t size)
+{
+    struct arena_block *block = arena->blocks;
+
+    size = ROUND_UP(MAX(size, 1), ARENA_ALIGN);
+    if (!block || block->size - block->used < size) {
+        block = arena_new_block(arena, size);
+    }
+
+    void *p = (char *) block + ARENA_BLOCK_HEADER + block->used;
+    block->used += size;
+    return p;
+}
+
+char *
+arena_strdup(struct arena *arena, const char *s)
+{
+    size_t size = strlen(s) + 1;
+
+    return memcpy(arena_alloc(arena, size), s, size);
+}
+
+char *
+arena_asprintf(struct arena *arena, const char *format, ...)
+{
+    va_list args;
+    int needed;
+
+    va_start(args, format);
+    needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    ovs_assert(needed >= 0);
+
+    char *s = arena_alloc(arena, needed + 1);
+    va_start(args, format);
+    vsnprintf(s, needed + 1, format, args);
+    va_end(args);
+
+    return s;
+}
@@ -0,0 +1,54 @@
+/* Copyright (c) 2021, Red Hat, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OVN_ARENA_H
+#define OVN_ARENA_H 1
+
+#include <stddef.h>
+#include "openvswitch/compiler.h"
+
+/* Arena allocator.
+ *
+ * An arena hands out memory from large blocks and can only release all of
+ * it at once, with arena_clear().  This is much cheaper than malloc() and
+ * free() for many small objects that all have the same lifetime, e.g. the
+ * temporary data built during one iteration of a main loop.
+ *
+ * The blocks are kept by arena_clear() and reused by later allocations, so
+ * an arena that is cleared after each iteration stops calling malloc() once
+ * it has grown to the size needed by an iteration.
+ *
+ * An arena is not thread-safe.  Threads that allocate in parallel need one
+ * arena each. */
+
+struct arena_block;
+
+struct arena {
+    struct arena_block *blocks; /* Blocks in use, current one first. */
+    struct arena_block *free;   /* Blocks released by arena_clear(). */
+};
+
+#define ARENA_INITIALIZER { NULL, NULL }
+
+void arena_init(struct arena *);
+void arena_destroy(struct arena *);
+void arena_clear(struct arena *);
+
+void *arena_alloc(struct arena *, size_t size);
+char *arena_strdup(struct arena *, const char *);
+char *arena_asprintf(struct arena *, const char *format, ...)
+    OVS_PRINTF_FORMAT(2, 3);
+
+#endif /* lib/arena.h */
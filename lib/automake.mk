@@ -7,6 +7,8 @@ lib_libovn_la_SOURCES = \
 	lib/acl-log.c \
 	lib/acl-log.h \
 	lib/actions.c \
+	lib/arena.c \
+	lib/arena.h \
 	lib/chassis-index.c \
 	lib/chassis-index.h \
 	lib/ovn-dirs.h \
@@ -15,7 +15,9 @@
  */
 
 #include <config.h>
+#include "bitmap.h"
 #include "byte-order.h"
+#include "hash.h"
 #include "openvswitch/json.h"
 #include "nx-match.h"
 #include "openvswitch/dynamic-string.h"
@@ -23,6 +25,7 @@
 #include "openvswitch/ofp-actions.h"
 #include "openvswitch/vlog.h"
 #include "openvswitch/shash.h"
+#include "ovs-thread.h"
 #include "ovn/expr.h"
 #include "ovn/lex.h"
 #include "ovn/logical-fields.h"
@@ -46,6 +49,9 @@ VLOG_DEFINE_THIS_MODULE(expr);
  */
 static bool force_crossproduct = false;
 
+static struct expr *expand_symbol(const char *s, const struct expr *cached,
+                                  const struct shash *symtab,
+                                  struct ovs_list *nesting, char **errorp);
 static struct expr *parse_and_annotate(const char *s,
                                        const struct shash *symtab,
                                        struct ovs_list *nesting,
@@ -150,6 +156,109 @@ expr_relop_test(enum expr_relop relop, int cmp)
     }
 }
 
+/* Allocating expression nodes.
+ *
+ * Converting a logical flow creates and destroys many expression nodes, all
+ * of the same size, e.g. when expr_normalize() distributes an AND over an OR
+ * or when crush_cmps() intersects comparisons.  Each thread keeps up to
+ * EXPR_NODE_CACHE_MAX freed nodes for reuse, so that the nodes of one
+ * conversion mostly reuse those of the previous one instead of going through
+ * malloc() and free().  The nodes are ordinary heap blocks, so they may
+ * still be freed with free(), and expr_node_free() accepts nodes allocated
+ * with malloc(). */
+#define EXPR_NODE_CACHE_MAX 1024
+
+struct expr_node_cache {
+    struct expr *nodes[EXPR_NODE_CACHE_MAX];
+    size_t n;
+    struct expr_node_stats stats;
+};
+
+static ovsthread_key_t expr_node_cache_key;
+
+static void
+expr_node_cache_destroy(void *cache_)
+{
+    struct expr_node_cache *cache = cache_;
+
+    for (size_t i = 0; i < cache->n; i++) {
+        free(cache->nodes[i]);
+    }
+    free(cache);
+}
+
+static struct expr_node_cache *
+expr_node_cache_get(void)
+{
+    static struct ovsthread_once once = OVSTHREAD_ONCE_INITIALIZER;
+    if (ovsthread_once_start(&once)) {
+        ovsthread_key_create(&expr_node_cache_key, expr_node_cache_destroy);
+        ovsthread_once_done(&once);
+    }
+
+    struct expr_node_cache *cache = ovsthread_getspecific(expr_node_cache_key);
+    if (!cache) {
+        cache = xzalloc(sizeof *cache);
+        ovsthread_setspecific(expr_node_cache_key, cache);
+    }
+    return cache;
+}
+
+/* Returns a new, uninitialized, expression node. */
+static struct expr *
+expr_node_alloc(void)
+{
+    struct expr_node_cache *cache = expr_node_cache_get();
+
+    if (cache->n) {
+        cache->stats.n_reused++;
+        return cache->nodes[--cache->n];
+    }
+    cache->stats.n_allocated++;
+    return xmalloc(sizeof(struct expr));
+}
+
+static struct expr *
+expr_node_zalloc(void)
+{
+    struct expr *e = expr_node_alloc();
+    memset(e, 0, sizeof *e);
+    return e;
+}
+
+/* Returns a new expression node that is a shallow copy of 'expr'. */
+static struct expr *
+expr_node_clone(const struct expr *expr)
+{
+    struct expr *e = expr_node_alloc();
+    memcpy(e, expr, sizeof *e);
+    return e;
+}
+
+/* Frees 'e' itself, but not its substructure. */
+static void
+expr_node_free(struct expr *e)
+{
+    if (!e) {
+        return;
+    }
+
+    struct expr_node_cache *cache = expr_node_cache_get();
+    if (cache->n < EXPR_NODE_CACHE_MAX) {
+        cache->nodes[cache->n++] = e;
+    } else {
+        free(e);
+    }
+}
+
+/* Stores in 'stats' the number of expression nodes that the calling thread
+ * allocated so far. */
+void
+expr_get_node_stats(struct expr_node_stats *stats)
+{
+    *stats = expr_node_cache_get()->stats;
+}
+
 /* Constructing and manipulating expressions. */
 
 /* Creates and returns a logical AND or OR expression (according to 'type',
@@ -160,7 +269,7 @@ expr_relop_test(enum expr_relop relop, int cmp)
 struct expr *
 expr_create_andor(enum expr_type type)
 {
-    struct expr *e = xmalloc(sizeof *e);
+    struct expr *e = expr_node_alloc();
     e->type = type;
     ovs_list_init(&e->andor);
     return e;
@@ -186,7 +295,7 @@ expr_combine(enum expr_type type, struct expr *a, struct expr *b)
     } else if (a->type == type) {
         if (b->type == type) {
             ovs_list_splice(&a->andor, b->andor.next, &b->andor);
-            free(b);
+            expr_node_free(b);
         } else {
             ovs_list_push_back(&a->andor, &b->node);
         }
@@ -210,7 +319,7 @@ expr_insert_andor(struct expr *andor, struct expr *before, struct expr *new)
             /* Conjunction junction, what's your function? */
         }
         ovs_list_splice(&before->node, new->andor.next, &new->andor);
-        free(new);
+        expr_node_free(new);
     } else {
         ovs_list_insert(&before->node, &new->node);
     }
@@ -220,7 +329,7 @@ expr_insert_andor(struct expr *andor, struct expr *before, struct expr *new)
 struct expr *
 expr_create_boolean(bool b)
 {
-    struct expr *e = xmalloc(sizeof *e);
+    struct expr *e = expr_node_alloc();
     e->type = EXPR_T_BOOLEAN;
     e->boolean = b;
     return e;
@@ -276,11 +385,11 @@ expr_fix_andor(struct expr *expr, bool short_circuit)
 
     if (ovs_list_is_short(&expr->andor)) {
         if (ovs_list_is_empty(&expr->andor)) {
-            free(expr);
+            expr_node_free(expr);
             return expr_create_boolean(!short_circuit);
         } else {
             sub = expr_from_node(ovs_list_front(&expr->andor));
-            free(expr);
+            expr_node_free(expr);
             return sub;
         }
     } else {
@@ -529,7 +638,7 @@ static struct expr *
 make_cmp__(const struct expr_field *f, enum expr_relop r,
              const union expr_constant *c)
 {
-    struct expr *e = xzalloc(sizeof *e);
+    struct expr *e = expr_node_zalloc();
     e->type = EXPR_T_CMP;
     e->cmp.symbol = f->symbol;
     e->cmp.relop = r;
@@ -1104,6 +1213,117 @@ expr_constant_set_destroy(struct expr_constant_set *cs)
     }
 }
 
+/* A constant of a constant set, in a hash table of constants. */
+struct expr_constant_node {
+    struct hmap_node hmap_node;
+    const union expr_constant *c;
+};
+
+static uint32_t
+expr_constant_hash(const union expr_constant *c, enum expr_constant_type type)
+{
+    if (type == EXPR_C_STRING) {
+        return hash_string(c->string, 0);
+    }
+
+    uint32_t hash = hash_bytes(&c->value, sizeof c->value, c->masked);
+    return c->masked ? hash_bytes(&c->mask, sizeof c->mask, hash) : hash;
+}
+
+static bool
+expr_constant_equals(const union expr_constant *a,
+                     const union expr_constant *b,
+                     enum expr_constant_type type)
+{
+    if (type == EXPR_C_STRING) {
+        return !strcmp(a->string, b->string);
+    }
+    return (a->masked == b->masked
+            && !memcmp(&a->value, &b->value, sizeof a->value)
+            && (!a->masked || !memcmp(&a->mask, &b->mask, sizeof a->mask)));
+}
+
+static void
+expr_constant_set_to_hmap(const struct expr_constant_set *cs,
+                          struct hmap *constants)
+{
+    hmap_init(constants);
+    for (size_t i = 0; i < cs->n_values; i++) {
+        struct expr_constant_node *node = xmalloc(sizeof *node);
+        node->c = &cs->values[i];
+        hmap_insert(constants, &node->hmap_node,
+                    expr_constant_hash(node->c, cs->type));
+    }
+}
+
+static bool
+expr_constant_hmap_contains(const struct hmap *constants,
+                            const union expr_constant *c,
+                            enum expr_constant_type type)
+{
+    const struct expr_constant_node *node;
+    HMAP_FOR_EACH_WITH_HASH (node, hmap_node, expr_constant_hash(c, type),
+                             constants) {
+        if (expr_constant_equals(node->c, c, type)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Stores in '*added' a new constant set with the constants of 'new_cs' that
+ * are not in 'old_cs' and in '*deleted' one with the constants of 'old_cs'
+ * that are not in 'new_cs'.  Both sets must have the same type.  The caller
+ * must destroy and free '*added' and '*deleted'. */
+void
+expr_constant_set_diff(const struct expr_constant_set *old_cs,
+                       const struct expr_constant_set *new_cs,
+                       struct expr_constant_set **added,
+                       struct expr_constant_set **deleted)
+{
+    ovs_assert(old_cs->type == new_cs->type);
+
+    struct hmap old_constants, new_constants;
+    expr_constant_set_to_hmap(old_cs, &old_constants);
+    expr_constant_set_to_hmap(new_cs, &new_constants);
+
+    struct expr_constant_set *sets[2];
+    for (int i = 0; i < 2; i++) {
+        const struct expr_constant_set *from = i ? old_cs : new_cs;
+        const struct hmap *others = i ? &new_constants : &old_constants;
+        struct expr_constant_set *cs = xzalloc(sizeof *cs);
+
+        cs->in_curlies = true;
+        cs->type = from->type;
+        cs->values = xmalloc(from->n_values * sizeof *cs->values);
+        for (size_t j = 0; j < from->n_values; j++) {
+            const union expr_constant *c = &from->values[j];
+
+            if (!expr_constant_hmap_contains(others, c, from->type)) {
+                union expr_constant *dst = &cs->values[cs->n_values++];
+                if (from->type == EXPR_C_STRING) {
+                    dst->string = xstrdup(c->string);
+                } else {
+                    *dst = *c;
+                }
+            }
+        }
+        sets[i] = cs;
+    }
+    *added = sets[0];
+    *deleted = sets[1];
+
+    struct expr_constant_node *node;
+    HMAP_FOR_EACH_POP (node, hmap_node, &old_constants) {
+        free(node);
+    }
+    HMAP_FOR_EACH_POP (node, hmap_node, &new_constants) {
+        free(node);
+    }
+    hmap_destroy(&old_constants);
+    hmap_destroy(&new_constants);
+}
+
 /* Adds an constant set named 'name' to 'const_sets', replacing any existing
  * constant set entry with the given name. The 'values' must be strings that
  * can be converted to integers or masked integers, such as IP addresses.
@@ -1210,7 +1430,7 @@ parse_chassis_resident(struct expr_context *ctx)
         return NULL;
     }
 
-    struct expr *e = xzalloc(sizeof *e);
+    struct expr *e = expr_node_zalloc();
     e->type = EXPR_T_CONDITION;
     e->cond.type = EXPR_COND_CHASSIS_RESIDENT;
     e->cond.not = false;
@@ -1487,8 +1707,9 @@ expr_field_parse(struct lexer *lexer, const struct shash *symtab,
             if (symbol->prereqs) {
                 char *error;
                 struct ovs_list nesting = OVS_LIST_INITIALIZER(&nesting);
-                struct expr *e = parse_and_annotate(symbol->prereqs, symtab,
-                                                    &nesting, &error);
+                struct expr *e = expand_symbol(symbol->prereqs,
+                                               symbol->prereqs_expr, symtab,
+                                               &nesting, &error);
                 if (error) {
                     lexer_error(lexer, "%s", error);
                     free(error);
@@ -1744,16 +1965,56 @@ expr_symtab_destroy(struct shash *symtab)
         free(symbol->name);
         free(symbol->prereqs);
         free(symbol->predicate);
+        expr_destroy(symbol->prereqs_expr);
+        expr_destroy(symbol->predicate_expr);
         free(symbol);
     }
 }
+
+static struct expr *
+compile_symbol_expansion(const char *s, const struct shash *symtab)
+{
+    struct ovs_list nesting = OVS_LIST_INITIALIZER(&nesting);
+    char *error;
+
+    struct expr *expr = parse_and_annotate(s, symtab, &nesting, &error);
+    free(error);
+    return expr;
+}
+
+/* Parses and annotates the prerequisites and the predicate expansion of each
+ * symbol in 'symtab' once, so that annotating a reference to the symbol
+ * clones them instead of parsing them again.
+ *
+ * Symbols added afterward, and symbols whose expansions fail to annotate,
+ * are still expanded by parsing, which reports the errors.  Since the
+ * symbols are modified, this must not be called while other threads use
+ * 'symtab'. */
+void
+expr_symtab_compile(struct shash *symtab)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH (node, symtab) {
+        struct expr_symbol *symbol = node->data;
+
+        if (symbol->prereqs && !symbol->prereqs_expr) {
+            symbol->prereqs_expr = compile_symbol_expansion(symbol->prereqs,
+                                                            symtab);
+        }
+        if (symbol->predicate && !symbol->predicate_expr) {
+            symbol->predicate_expr
+                = compile_symbol_expansion(symbol->predicate, symtab);
+        }
+    }
+}
 
 /* Cloning. */
 
 static struct expr *
 expr_clone_cmp(struct expr *expr)
 {
-    struct expr *new = xmemdup(expr, sizeof *expr);
+    struct expr *new = expr_node_clone(expr);
     if (!new->cmp.symbol->width) {
         new->cmp.string = xstrdup(new->cmp.string);
     }
@@ -1776,7 +2037,7 @@ expr_clone_andor(struct expr *expr)
 static struct expr *
 expr_clone_condition(struct expr *expr)
 {
-    struct expr *new = xmemdup(expr, sizeof *expr);
+    struct expr *new = expr_node_clone(expr);
     new->cond.string = xstrdup(new->cond.string);
     return new;
 }
@@ -1835,7 +2096,7 @@ expr_destroy(struct expr *expr)
         free(expr->cond.string);
         break;
     }
-    free(expr);
+    expr_node_free(expr);
 }
 
 /* Annotation. */
@@ -1874,6 +2135,21 @@ parse_and_annotate(const char *s, const struct shash *symtab,
     return expr;
 }
 
+/* Returns the annotated expansion 's' of the prerequisites or the predicate
+ * of a symbol, cloned from 'cached' if expr_symtab_compile() already
+ * annotated it. */
+static struct expr *
+expand_symbol(const char *s, const struct expr *cached,
+              const struct shash *symtab, struct ovs_list *nesting,
+              char **errorp)
+{
+    if (cached) {
+        *errorp = NULL;
+        return expr_clone(CONST_CAST(struct expr *, cached));
+    }
+    return parse_and_annotate(s, symtab, nesting, errorp);
+}
+
 static struct expr *
 expr_annotate_cmp(struct expr *expr, const struct shash *symtab,
                   bool append_prereqs, struct ovs_list *nesting, char **errorp)
@@ -1895,7 +2171,8 @@ expr_annotate_cmp(struct expr *expr, const struct shash *symtab,
 
     struct expr *prereqs = NULL;
     if (append_prereqs && symbol->prereqs) {
-        prereqs = parse_and_annotate(symbol->prereqs, symtab, nesting, errorp);
+        prereqs = expand_symbol(symbol->prereqs, symbol->prereqs_expr,
+                                symtab, nesting, errorp);
         if (!prereqs) {
             goto error;
         }
@@ -1908,8 +2185,8 @@ expr_annotate_cmp(struct expr *expr, const struct shash *symtab,
     } else if (symbol->predicate) {
         struct expr *predicate;
 
-        predicate = parse_and_annotate(symbol->predicate, symtab,
-                                       nesting, errorp);
+        predicate = expand_symbol(symbol->predicate, symbol->predicate_expr,
+                                  symtab, nesting, errorp);
         if (!predicate) {
             goto error;
         }
@@ -1944,7 +2221,8 @@ expr_append_prereqs(struct expr *expr, const struct expr_symbol *symbol,
     struct expr *prereqs = NULL;
 
     if (symbol->prereqs) {
-        prereqs = parse_and_annotate(symbol->prereqs, symtab, nesting, errorp);
+        prereqs = expand_symbol(symbol->prereqs, symbol->prereqs_expr,
+                                symtab, nesting, errorp);
         if (!prereqs) {
             expr_destroy(expr);
             return NULL;
@@ -2075,7 +2353,7 @@ expr_simplify_ne(struct expr *expr)
     for (i = 0; (i = bitwise_scan(mask, sizeof *mask, true, i, w)) < w; i++) {
         struct expr *e;
 
-        e = xzalloc(sizeof *e);
+        e = expr_node_zalloc();
         e->type = EXPR_T_CMP;
         e->cmp.symbol = expr->cmp.symbol;
         e->cmp.relop = EXPR_R_EQ;
@@ -2140,7 +2418,7 @@ expr_simplify_relational(struct expr *expr)
      * and similarly for "tcp.dst <= 1234". */
     struct expr *new = NULL;
     if (eq) {
-        new = xmemdup(expr, sizeof *expr);
+        new = expr_node_clone(expr);
         new->cmp.relop = EXPR_R_EQ;
     }
 
@@ -2149,7 +2427,7 @@ expr_simplify_relational(struct expr *expr)
          z = bitwise_scan(value, sizeof *value, lt, z + 1, end)) {
         struct expr *e;
 
-        e = xmemdup(expr, sizeof *expr);
+        e = expr_node_clone(expr);
         e->cmp.relop = EXPR_R_EQ;
         bitwise_toggle_bit(&e->cmp.value, sizeof e->cmp.value, z);
         bitwise_zero(&e->cmp.value, sizeof e->cmp.value, start, z - start);
@@ -2218,6 +2496,64 @@ expr_evaluate_condition(struct expr *expr,
     OVS_NOT_REACHED();
 }
 
+static bool
+expr_get_condition_state__(const struct expr *expr,
+                           bool (*is_chassis_resident)(const void *c_aux,
+                                                       const char *port_name),
+                           const void *c_aux, uint64_t *statep,
+                           unsigned int *n_condsp)
+{
+    const struct expr *sub;
+
+    switch (expr->type) {
+    case EXPR_T_AND:
+    case EXPR_T_OR:
+        LIST_FOR_EACH (sub, node, &expr->andor) {
+            if (!expr_get_condition_state__(sub, is_chassis_resident, c_aux,
+                                            statep, n_condsp)) {
+                return false;
+            }
+        }
+        return true;
+
+    case EXPR_T_CONDITION:
+        ovs_assert(expr->cond.type == EXPR_COND_CHASSIS_RESIDENT);
+        if (*n_condsp >= 64) {
+            return false;
+        }
+        if (is_chassis_resident(c_aux, expr->cond.string)) {
+            *statep |= UINT64_C(1) << *n_condsp;
+        }
+        (*n_condsp)++;
+        return true;
+
+    case EXPR_T_CMP:
+    case EXPR_T_BOOLEAN:
+        return true;
+    }
+
+    OVS_NOT_REACHED();
+}
+
+/* Calls 'is_chassis_resident' for each condition in 'expr', in the same order
+ * as expr_evaluate_condition(), and stores the results as a bitmap in
+ * '*statep', the first condition in the least significant bit.
+ * expr_evaluate_condition() turns clones of 'expr' with the same state into
+ * the same expression.  Returns false if 'expr' has more than 64
+ * conditions. */
+bool
+expr_get_condition_state(const struct expr *expr,
+                         bool (*is_chassis_resident)(const void *c_aux,
+                                                     const char *port_name),
+                         const void *c_aux, uint64_t *statep)
+{
+    unsigned int n_conds = 0;
+
+    *statep = 0;
+    return expr_get_condition_state__(expr, is_chassis_resident, c_aux,
+                                      statep, &n_conds);
+}
+
 /* Takes ownership of 'expr' and returns an equivalent expression whose
  * EXPR_T_CMP nodes use only tests for equality (EXPR_R_EQ). */
 struct expr *
@@ -2372,7 +2708,7 @@ crush_and_string(struct expr *expr, const struct expr_symbol *symbol)
                 expr_destroy(expr);
                 return new;
             }
-            free(new);
+            expr_node_free(new);
             break;
         case EXPR_T_CONDITION:
             OVS_NOT_REACHED();
@@ -2421,7 +2757,7 @@ crush_and_string(struct expr *expr, const struct expr_symbol *symbol)
 
     const char *string;
     SSET_FOR_EACH (string, &result) {
-        sub = xmalloc(sizeof *sub);
+        sub = expr_node_alloc();
         sub->type = EXPR_T_CMP;
         sub->cmp.relop = EXPR_R_EQ;
         sub->cmp.symbol = symbol;
@@ -2480,7 +2816,7 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
             return expr_create_boolean(true);
         } else {
             struct expr *cmp;
-            cmp = xmalloc(sizeof *cmp);
+            cmp = expr_node_alloc();
             cmp->type = EXPR_T_CMP;
             cmp->cmp.symbol = symbol;
             cmp->cmp.relop = EXPR_R_EQ;
@@ -2495,7 +2831,7 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
         struct expr *disjuncts = expr_from_node(ovs_list_pop_front(&expr->andor));
         struct expr *or;
 
-        or = xmalloc(sizeof *or);
+        or = expr_node_alloc();
         or->type = EXPR_T_OR;
         ovs_list_init(&or->andor);
 
@@ -2511,14 +2847,14 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
                 expr_destroy(sub);
             }
         }
-        free(disjuncts);
-        free(expr);
+        expr_node_free(disjuncts);
+        expr_node_free(expr);
         if (ovs_list_is_empty(&or->andor)) {
-            free(or);
+            expr_node_free(or);
             return expr_create_boolean(false);
         } else if (ovs_list_is_short(&or->andor)) {
             struct expr *cmp = expr_from_node(ovs_list_pop_front(&or->andor));
-            free(or);
+            expr_node_free(or);
             return cmp;
         } else {
             return crush_cmps(or, symbol);
@@ -2531,7 +2867,7 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
         struct expr *new = NULL;
         struct expr *or;
 
-        or = xmalloc(sizeof *or);
+        or = expr_node_alloc();
         or->type = EXPR_T_OR;
         ovs_list_init(&or->andor);
 
@@ -2550,7 +2886,7 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
             LIST_FOR_EACH (b, node, &bs->andor) {
                 ovs_assert(b->type == EXPR_T_CMP);
                 if (!new) {
-                    new = xmalloc(sizeof *new);
+                    new = expr_node_alloc();
                     new->type = EXPR_T_CMP;
                     new->cmp.symbol = symbol;
                     new->cmp.relop = EXPR_R_EQ;
@@ -2565,15 +2901,15 @@ crush_and_numeric(struct expr *expr, const struct expr_symbol *symbol)
         }
         expr_destroy(as);
         expr_destroy(bs);
-        free(new);
+        expr_node_free(new);
 
         if (ovs_list_is_empty(&or->andor)) {
             expr_destroy(expr);
-            free(or);
+            expr_node_free(or);
             return expr_create_boolean(false);
         } else if (ovs_list_is_short(&or->andor)) {
             struct expr *cmp = expr_from_node(ovs_list_pop_front(&or->andor));
-            free(or);
+            expr_node_free(or);
             if (ovs_list_is_empty(&expr->andor)) {
                 expr_destroy(expr);
                 return crush_cmps(cmp, symbol);
@@ -2616,6 +2952,136 @@ compare_cmps_cb(const void *a_, const void *b_)
     return compare_cmps_3way(a, b);
 }
 
+/* Minimum number of comparisons in a disjunction for crush_or() to
+ * aggregate their prefixes.  Smaller disjunctions, e.g. of a few addresses
+ * or ports, are kept as written, so that their flows remain the same, unless
+ * expr_set_aggregate_prefixes() enabled the aggregation of all of them. */
+#define EXPR_AGGREGATE_MIN_CMPS 64
+static bool aggregate_all_prefixes;
+
+/* Enables or disables the aggregation of the prefixes of all the
+ * disjunctions, whatever their size, e.g. so that 'tcp.dst == {80, 81, 82,
+ * 83}' becomes a single masked match on 'tcp.dst'.  Returns true if the
+ * setting changed, in which case the expressions already converted to flows
+ * must be converted again to take it into account.
+ *
+ * This must not be called while other threads normalize expressions. */
+bool
+expr_set_aggregate_prefixes(bool all)
+{
+    bool changed = aggregate_all_prefixes != all;
+    aggregate_all_prefixes = all;
+    return changed;
+}
+
+/* Returns true if a disjunction of 'n_cmps' comparisons on a field may be
+ * aggregated by expr_normalize(), in which case its flows don't match one to
+ * one with its comparisons. */
+bool
+expr_may_aggregate(size_t n_cmps)
+{
+    return n_cmps >= (aggregate_all_prefixes ? 2 : EXPR_AGGREGATE_MIN_CMPS);
+}
+
+/* Returns the number of leading bits of a 'width'-bit field that the mask of
+ * 'cmp', an equality comparison, covers, or 0 if its mask is not such a
+ * prefix. */
+static int
+cmp_prefix_len(const struct expr *cmp, int width)
+{
+    int start, n_bits;
+
+    if (cmp->cmp.relop != EXPR_R_EQ) {
+        return 0;
+    }
+    find_bitwise_range(&cmp->cmp.mask, width, &start, &n_bits);
+    return start + n_bits == width ? n_bits : 0;
+}
+
+/* Returns true if 'a' and 'b' have the same bits under 'mask', on a
+ * 'width'-bit field. */
+static bool
+masked_equals(const union mf_subvalue *a, const union mf_subvalue *b,
+              const union mf_subvalue *mask, int width)
+{
+    for (size_t i = sizeof *a - DIV_ROUND_UP(width, 8); i < sizeof *a; i++) {
+        if ((a->u8[i] ^ b->u8[i]) & mask->u8[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Returns true if prefixes 'a' and 'b', of length 'plen' on a 'width'-bit
+ * field, are the two halves of the same prefix of length 'plen - 1', 'a'
+ * being the lower one. */
+static bool
+cmp_prefix_is_sibling(const struct expr *a, const struct expr *b, int plen,
+                      int width)
+{
+    int bit = width - plen;
+
+    if (cmp_prefix_len(a, width) != plen
+        || bitwise_get_bit(&a->cmp.value, sizeof a->cmp.value, bit)
+        || !bitwise_get_bit(&b->cmp.value, sizeof b->cmp.value, bit)) {
+        return false;
+    }
+
+    union mf_subvalue value = b->cmp.value;
+    bitwise_put0(&value, sizeof value, bit);
+    return masked_equals(&a->cmp.value, &value, &a->cmp.mask, width);
+}
+
+/* Aggregates the prefixes of 'expr', a disjunction of comparisons on a
+ * 'width'-bit field sorted by compare_cmps_3way(), into the minimal set of
+ * prefixes that covers the same values: the prefixes contained in others are
+ * removed and the pairs of prefixes that form a shorter one are replaced by
+ * it, e.g. a large address set of consecutive addresses and subnets becomes
+ * a few subnets.  The comparisons that are not on prefixes are kept as they
+ * are.
+ *
+ * Once the contained prefixes are removed, the remaining ones are disjoint
+ * and sorted, so the pairs to replace are always adjacent and a single pass
+ * with a stack of the kept prefixes finds them all. */
+static void
+crush_or_prefixes(struct expr *expr, int width)
+{
+    size_t n = ovs_list_size(&expr->andor);
+    struct expr **stack = xmalloc(n * sizeof *stack);
+    struct expr *sub, *next;
+
+    n = 0;
+    LIST_FOR_EACH_SAFE (sub, next, node, &expr->andor) {
+        int plen = cmp_prefix_len(sub, width);
+        if (!plen) {
+            continue;
+        }
+
+        /* Values are sorted, and shorter prefixes of the same value come
+         * first, so a contained prefix follows the one that contains it. */
+        if (n && masked_equals(&stack[n - 1]->cmp.value, &sub->cmp.value,
+                               &stack[n - 1]->cmp.mask, width)) {
+            ovs_list_remove(&sub->node);
+            expr_destroy(sub);
+            continue;
+        }
+
+        while (n && plen > 1
+               && cmp_prefix_is_sibling(stack[n - 1], sub, plen, width)) {
+            struct expr *lower = stack[--n];
+            int bit = width - plen;
+
+            bitwise_put0(&sub->cmp.value, sizeof sub->cmp.value, bit);
+            bitwise_put0(&sub->cmp.mask, sizeof sub->cmp.mask, bit);
+            ovs_list_remove(&lower->node);
+            expr_destroy(lower);
+            plen--;
+        }
+        stack[n++] = sub;
+    }
+    free(stack);
+}
+
 /* Implementation of crush_cmps() for expr->type == EXPR_T_OR. */
 static struct expr *
 crush_or(struct expr *expr, const struct expr_symbol *symbol)
@@ -2659,6 +3125,10 @@ crush_or(struct expr *expr, const struct expr_symbol *symbol)
         }
     }
     free(subs);
+
+    if (symbol->width && expr_may_aggregate(ovs_list_size(&expr->andor))) {
+        crush_or_prefixes(expr, symbol->width);
+    }
     return expr_fix(expr);
 }
 
@@ -2723,7 +3193,7 @@ expr_sort(struct expr *expr)
     qsort(subs, n, sizeof *subs, compare_expr_sort);
 
     ovs_list_init(&expr->andor);
-    free(expr);
+    expr_node_free(expr);
     expr = NULL;
 
     for (i = 0; i < n; ) {
@@ -2756,7 +3226,7 @@ expr_sort(struct expr *expr)
                     expr = crushed;
                     break;
                 } else {
-                    free(crushed);
+                    expr_node_free(crushed);
                 }
             } else {
                 expr = expr_combine(EXPR_T_AND, expr, crushed);
@@ -2803,7 +3273,7 @@ expr_normalize_and(struct expr *expr)
     }
     if (ovs_list_is_short(&expr->andor)) {
         struct expr *sub = expr_from_node(ovs_list_front(&expr->andor));
-        free(expr);
+        expr_node_free(expr);
         return sub;
     }
 
@@ -2861,7 +3331,7 @@ expr_normalize_or(struct expr *expr)
                     expr_destroy(expr);
                     return new;
                 }
-                free(new);
+                expr_node_free(new);
             } else {
                 expr_insert_andor(expr, next, new);
             }
@@ -2871,12 +3341,12 @@ expr_normalize_or(struct expr *expr)
         }
     }
     if (ovs_list_is_empty(&expr->andor)) {
-        free(expr);
+        expr_node_free(expr);
         return expr_create_boolean(false);
     }
     if (ovs_list_is_short(&expr->andor)) {
         struct expr *e = expr_from_node(ovs_list_pop_front(&expr->andor));
-        free(expr);
+        expr_node_free(expr);
         return e;
     }
 
@@ -3027,43 +3497,128 @@ constrain_match(const struct expr *expr,
     return true;
 }
 
+/* Adds to 'matches' the flows that match 'm' and one comparison of each of the
+ * 'n_ors' disjunctions in 'ors', that is, the cross product of 'ors'.  Each
+ * flow gets one conjunction based on 'conj_id', 'clause' and 'n_clauses', if
+ * 'conj_id' is nonzero.  Returns false if no flow can match. */
 static bool
-add_disjunction(const struct expr *or,
-                bool (*lookup_port)(const void *aux, const char *port_name,
-                                    unsigned int *portp),
-                const void *aux,
-                struct match *m, uint8_t clause, uint8_t n_clauses,
-                uint32_t conj_id, struct hmap *matches)
+add_cross_product(const struct expr **ors, size_t n_ors,
+                  bool (*lookup_port)(const void *aux, const char *port_name,
+                                      unsigned int *portp),
+                  const void *aux,
+                  const struct match *m, uint8_t clause, uint8_t n_clauses,
+                  uint32_t conj_id, struct hmap *matches)
 {
-    struct expr *sub;
-    int n = 0;
+    if (!n_ors) {
+        expr_match_add(matches, expr_match_new(m, clause, n_clauses,
+                                               conj_id));
+        return true;
+    }
 
-    ovs_assert(or->type == EXPR_T_OR);
-    LIST_FOR_EACH (sub, node, &or->andor) {
-        struct expr_match *match = expr_match_new(m, clause, n_clauses,
-                                                  conj_id);
-        if (constrain_match(sub, lookup_port, aux, &match->match)) {
-            expr_match_add(matches, match);
-            n++;
-        } else {
-            free(match->conjunctions);
-            free(match);
+    const struct expr *sub;
+    bool any = false;
+
+    ovs_assert(ors[0]->type == EXPR_T_OR);
+    LIST_FOR_EACH (sub, node, &ors[0]->andor) {
+        struct match match = *m;
+        if (constrain_match(sub, lookup_port, aux, &match)
+            && add_cross_product(ors + 1, n_ors - 1, lookup_port, aux, &match,
+                                 clause, n_clauses, conj_id, matches)) {
+            any = true;
         }
     }
+    return any;
+}
 
-    /* If n == 1, then this didn't really need to be a disjunction.  Oh well,
-     * that shouldn't happen much. */
-    return n > 0;
+/* Maximum number of flows that the cross products of the clauses of
+ * conjunctive matches may add to the flows of an expression, or 0 to always
+ * use conjunctive matches.  See expr_set_cross_product_limit(). */
+static unsigned int cross_product_limit;
+
+/* Sets to 'limit' the number of flows that expr_to_matches() may add for an
+ * expression, compared with conjunctive matches, to replace conjunctions, or
+ * some of their clauses, by the cross products of their clauses.  The
+ * conjunctions, or clauses, that don't need more flows as cross products are
+ * always replaced, unless 'limit' is 0, in which case conjunctions are used
+ * whatever their cost.  Returns true if the limit changed.
+ *
+ * This must not be called while other threads convert expressions to
+ * matches. */
+bool
+expr_set_cross_product_limit(unsigned int limit)
+{
+    bool changed = cross_product_limit != limit;
+    cross_product_limit = limit;
+    return changed;
 }
 
+/* A clause of a conjunctive match: the cross product of disjunctions. */
+struct conj_clause {
+    const struct expr **ors;
+    size_t n_ors;
+    size_t n_flows;             /* Product of the sizes of 'ors'. */
+};
+
+static int
+compare_conj_clauses(const void *a_, const void *b_)
+{
+    const struct conj_clause *a = a_;
+    const struct conj_clause *b = b_;
+    return a->n_flows < b->n_flows ? -1 : a->n_flows > b->n_flows;
+}
+
+static size_t
+n_flows_product(size_t a, size_t b)
+{
+    return a && b > SIZE_MAX / a ? SIZE_MAX : a * b;
+}
+
+/* Folds the smallest of the 'n_clauses' clauses in 'clauses' into their
+ * cross products, as long as this doesn't need more flows than keeping them
+ * apart, or the additional flows fit in '*budget', which is updated.  A flow
+ * per clause and the conj_id flow, with one clause left, are saved.  Returns
+ * the remaining number of clauses. */
+static size_t
+fold_conj_clauses(struct conj_clause *clauses, size_t n_clauses,
+                  size_t *budget)
+{
+    while (n_clauses > 1) {
+        qsort(clauses, n_clauses, sizeof *clauses, compare_conj_clauses);
+
+        struct conj_clause *a = &clauses[0];
+        struct conj_clause *b = &clauses[1];
+        size_t n_flows = n_flows_product(a->n_flows, b->n_flows);
+        size_t n_saved = a->n_flows + b->n_flows + (n_clauses == 2);
+        if (n_flows > n_saved) {
+            if (n_flows - n_saved > *budget) {
+                break;
+            }
+            *budget -= n_flows - n_saved;
+        }
+
+        memcpy(&a->ors[a->n_ors], b->ors, b->n_ors * sizeof *b->ors);
+        a->n_ors += b->n_ors;
+        a->n_flows = n_flows;
+        free(b->ors);
+        *b = clauses[--n_clauses];
+    }
+    return n_clauses;
+}
+
+/* Adds the flows of 'and', a conjunction of comparisons and disjunctions, to
+ * 'matches'.  With at least two disjunctions, these are the clauses of a
+ * conjunctive match or, depending on the number of flows, their cross
+ * products within the limit of '*budget' additional flows.  See
+ * expr_set_cross_product_limit(). */
 static void
 add_conjunction(const struct expr *and,
                 bool (*lookup_port)(const void *aux, const char *port_name,
                                     unsigned int *portp),
-                const void *aux, uint32_t *n_conjsp, struct hmap *matches)
+                const void *aux, uint32_t *n_conjsp, size_t *budget,
+                struct hmap *matches)
 {
     struct match match;
-    int n_clauses = 0;
+    size_t n_ors = 0;
     struct expr *sub;
 
     match_init_catchall(&match);
@@ -3077,7 +3632,7 @@ add_conjunction(const struct expr *and,
             }
             break;
         case EXPR_T_OR:
-            n_clauses++;
+            n_ors++;
             break;
         case EXPR_T_AND:
         case EXPR_T_BOOLEAN:
@@ -3087,37 +3642,57 @@ add_conjunction(const struct expr *and,
         }
     }
 
-    if (!n_clauses) {
+    if (!n_ors) {
         expr_match_add(matches, expr_match_new(&match, 0, 0, 0));
-    } else if (n_clauses == 1) {
-        LIST_FOR_EACH (sub, node, &and->andor) {
-            if (sub->type == EXPR_T_OR) {
-                add_disjunction(sub, lookup_port, aux, &match, 0, 0, 0,
-                                matches);
-            }
+        return;
+    }
+
+    struct conj_clause *clauses = xmalloc(n_ors * sizeof *clauses);
+    size_t n_clauses = 0;
+    LIST_FOR_EACH (sub, node, &and->andor) {
+        if (sub->type == EXPR_T_OR) {
+            struct conj_clause *c = &clauses[n_clauses++];
+            c->ors = xmalloc(n_ors * sizeof *c->ors);
+            c->ors[0] = sub;
+            c->n_ors = 1;
+            c->n_flows = ovs_list_size(&sub->andor);
         }
+    }
+    if (cross_product_limit) {
+        n_clauses = fold_conj_clauses(clauses, n_clauses, budget);
+    }
+
+    if (n_clauses == 1) {
+        add_cross_product(clauses[0].ors, clauses[0].n_ors, lookup_port, aux,
+                          &match, 0, 0, 0, matches);
     } else {
-        int clause = 0;
         (*n_conjsp)++;
-        LIST_FOR_EACH (sub, node, &and->andor) {
-            if (sub->type == EXPR_T_OR) {
-                if (!add_disjunction(sub, lookup_port, aux, &match, clause++,
-                                     n_clauses, *n_conjsp, matches)) {
-                    /* This clause can't ever match, so we might as well skip
-                     * adding the other clauses--the overall disjunctive flow
-                     * can't ever match.  Ideally we would also back out all of
-                     * the clauses we already added, but that seems like a lot
-                     * of trouble for a case that might never occur in
-                     * practice. */
-                    return;
-                }
+        size_t i;
+        for (i = 0; i < n_clauses; i++) {
+            if (!add_cross_product(clauses[i].ors, clauses[i].n_ors,
+                                   lookup_port, aux, &match, i, n_clauses,
+                                   *n_conjsp, matches)) {
+                /* This clause can't ever match, so we might as well skip
+                 * adding the other clauses--the overall disjunctive flow
+                 * can't ever match.  Ideally we would also back out all of
+                 * the clauses we already added, but that seems like a lot
+                 * of trouble for a case that might never occur in
+                 * practice. */
+                break;
             }
         }
 
-        /* Add the flow that matches on conj_id. */
-        match_set_conj_id(&match, *n_conjsp);
-        expr_match_add(matches, expr_match_new(&match, 0, 0, 0));
+        if (i == n_clauses) {
+            /* Add the flow that matches on conj_id. */
+            match_set_conj_id(&match, *n_conjsp);
+            expr_match_add(matches, expr_match_new(&match, 0, 0, 0));
+        }
+    }
+
+    for (size_t i = 0; i < n_clauses; i++) {
+        free(clauses[i].ors);
     }
+    free(clauses);
 }
 
 static void
@@ -3174,6 +3749,7 @@ expr_to_matches(const struct expr *expr,
                                     unsigned int *portp),
                 const void *aux, struct hmap *matches)
 {
+    size_t budget = cross_product_limit;
     uint32_t n_conjs = 0;
 
     hmap_init(matches);
@@ -3183,7 +3759,8 @@ expr_to_matches(const struct expr *expr,
         break;
 
     case EXPR_T_AND:
-        add_conjunction(expr, lookup_port, aux, &n_conjs, matches);
+        add_conjunction(expr, lookup_port, aux, &n_conjs, &budget,
+                        matches);
         break;
 
     case EXPR_T_OR:
@@ -3198,7 +3775,8 @@ expr_to_matches(const struct expr *expr,
 
             LIST_FOR_EACH (sub, node, &expr->andor) {
                 if (sub->type == EXPR_T_AND) {
-                    add_conjunction(sub, lookup_port, aux, &n_conjs, matches);
+                    add_conjunction(sub, lookup_port, aux, &n_conjs, &budget,
+                                    matches);
                 } else {
                     add_cmp_flow(sub, lookup_port, aux, matches);
                 }
@@ -3480,6 +4058,184 @@ expr_evaluate(const struct expr *e, const struct flow *uflow,
         OVS_NOT_REACHED();
     }
 }
+
+/* Batch evaluation.
+ *
+ * The results of a node for a batch of microflows are kept in a bitmap with a
+ * bit per microflow.  Each node is only evaluated against the microflows that
+ * can still change the result of its parent, in 'active'. */
+
+static void expr_evaluate_batch__(
+    const struct expr *, const struct flow flows[], size_t n_flows,
+    bool (*lookup_port)(const void *aux, const char *port_name,
+                        unsigned int *portp),
+    const void *aux, const unsigned long *active, unsigned long *results);
+
+static void
+expr_evaluate_andor_batch(const struct expr *e, const struct flow flows[],
+                          size_t n_flows, bool short_circuit,
+                          bool (*lookup_port)(const void *aux,
+                                              const char *port_name,
+                                              unsigned int *portp),
+                          const void *aux, const unsigned long *active,
+                          unsigned long *results)
+{
+    size_t n_longs = bitmap_n_longs(n_flows);
+    unsigned long *pending = xmemdup(active, bitmap_n_bytes(n_flows));
+    unsigned long *sub_results = bitmap_allocate(n_flows);
+    const struct expr *sub;
+
+    /* 'pending' has the microflows whose result is not known yet, the ones
+     * for which all the subexpressions so far evaluated to !short_circuit. */
+    memset(results, 0, bitmap_n_bytes(n_flows));
+    LIST_FOR_EACH (sub, node, &e->andor) {
+        if (bitmap_is_all_zeros(pending, n_flows)) {
+            break;
+        }
+
+        expr_evaluate_batch__(sub, flows, n_flows, lookup_port, aux,
+                              pending, sub_results);
+        for (size_t i = 0; i < n_longs; i++) {
+            unsigned long decided = (short_circuit
+                                     ? sub_results[i]
+                                     : pending[i] & ~sub_results[i]);
+            pending[i] &= ~decided;
+            if (short_circuit) {
+                results[i] |= decided;
+            }
+        }
+    }
+    if (!short_circuit) {
+        memcpy(results, pending, bitmap_n_bytes(n_flows));
+    }
+
+    bitmap_free(sub_results);
+    bitmap_free(pending);
+}
+
+static void
+expr_evaluate_cmp_batch(const struct expr *e, const struct flow flows[],
+                        size_t n_flows,
+                        bool (*lookup_port)(const void *aux,
+                                            const char *port_name,
+                                            unsigned int *portp),
+                        const void *aux, const unsigned long *active,
+                        unsigned long *results)
+{
+    const struct expr_symbol *s = e->cmp.symbol;
+    const struct mf_field *field = s->field;
+    enum expr_relop relop = e->cmp.relop;
+    size_t i;
+
+    memset(results, 0, bitmap_n_bytes(n_flows));
+    if (s->width) {
+        int n_bytes = field->n_bytes;
+        const uint8_t *cst = &e->cmp.value.u8[sizeof e->cmp.value - n_bytes];
+        const uint8_t *mask = &e->cmp.mask.u8[sizeof e->cmp.mask - n_bytes];
+
+        BITMAP_FOR_EACH_1 (i, n_flows, active) {
+            union mf_value value;
+            mf_get_value(field, &flows[i], &value);
+            for (int j = 0; j < n_bytes; j++) {
+                value.b[j] &= mask[j];
+            }
+            if (expr_relop_test(relop, memcmp(&value, cst, n_bytes))) {
+                bitmap_set1(results, i);
+            }
+        }
+    } else {
+        /* The port is only looked up once for the whole batch. */
+        unsigned int cst;
+        if (!lookup_port(aux, e->cmp.string, &cst)) {
+            return;
+        }
+
+        struct mf_subfield sf = { .field = field, .ofs = 0,
+                                  .n_bits = field->n_bits };
+        BITMAP_FOR_EACH_1 (i, n_flows, active) {
+            uint64_t value = mf_get_subfield(&sf, &flows[i]);
+            if (expr_relop_test(relop, value < cst ? -1 : value > cst)) {
+                bitmap_set1(results, i);
+            }
+        }
+    }
+}
+
+/* Sets the bits of 'results' for the microflows in 'active' that 'e'
+ * evaluates to true against, and clears all the others. */
+static void
+expr_evaluate_batch__(const struct expr *e, const struct flow flows[],
+                      size_t n_flows,
+                      bool (*lookup_port)(const void *aux,
+                                          const char *port_name,
+                                          unsigned int *portp),
+                      const void *aux, const unsigned long *active,
+                      unsigned long *results)
+{
+    bool result;
+
+    switch (e->type) {
+    case EXPR_T_CMP:
+        expr_evaluate_cmp_batch(e, flows, n_flows, lookup_port, aux,
+                                active, results);
+        return;
+
+    case EXPR_T_AND:
+        expr_evaluate_andor_batch(e, flows, n_flows, false, lookup_port, aux,
+                                  active, results);
+        return;
+
+    case EXPR_T_OR:
+        expr_evaluate_andor_batch(e, flows, n_flows, true, lookup_port, aux,
+                                  active, results);
+        return;
+
+    case EXPR_T_BOOLEAN:
+        result = e->boolean;
+        break;
+
+    case EXPR_T_CONDITION:
+        /* Same assumption as expr_evaluate(). */
+        result = !e->cond.not;
+        break;
+
+    default:
+        OVS_NOT_REACHED();
+    }
+
+    if (result) {
+        memcpy(results, active, bitmap_n_bytes(n_flows));
+    } else {
+        memset(results, 0, bitmap_n_bytes(n_flows));
+    }
+}
+
+/* Evaluates 'e' against each of the 'n_flows' microflows in 'flows' and sets
+ * bit 'i' of 'results', a bitmap of 'n_flows' bits allocated by the caller,
+ * to the result for 'flows[i]'.
+ *
+ * The results are the same as calling expr_evaluate() for each microflow, but
+ * each node of 'e' is only visited once for the whole batch, its constants
+ * and port numbers are looked up once, and the microflows for which the
+ * result of a conjunction or a disjunction is already known are not
+ * evaluated against its remaining terms. */
+void
+expr_evaluate_batch(const struct expr *e, const struct flow flows[],
+                    size_t n_flows,
+                    bool (*lookup_port)(const void *aux,
+                                        const char *port_name,
+                                        unsigned int *portp),
+                    const void *aux, unsigned long *results)
+{
+    if (!n_flows) {
+        return;
+    }
+
+    unsigned long *active = bitmap_allocate1(n_flows);
+    expr_evaluate_batch__(e, flows, n_flows, lookup_port, aux,
+                          active, results);
+    bitmap_free(active);
+}
 
 /* Action parsing helper. */
 
@@ -31,14 +31,35 @@ ovn_extend_table_delete_desired(struct ovn_extend_table *table,
 
 void
 ovn_extend_table_init(struct ovn_extend_table *table)
+{
+    ovn_extend_table_init_base(table, 0);
+}
+
+/* Initializes 'table' to assign ids starting from 'id_base' + 1, so that
+ * several tables can share the same id space, e.g. the OpenFlow groups,
+ * when their bases are at least MAX_EXT_TABLE_ID apart. */
+void
+ovn_extend_table_init_base(struct ovn_extend_table *table, uint32_t id_base)
 {
     table->table_ids = bitmap_allocate(MAX_EXT_TABLE_ID);
     bitmap_set1(table->table_ids, 0); /* table id 0 is invalid. */
+    table->next_free_id = 1;
+    table->id_base = id_base;
     hmap_init(&table->desired);
     hmap_init(&table->lflow_to_desired);
     hmap_init(&table->existing);
 }
 
+/* Releases 'table_id' in the 'table_ids' bitmap of 'table'. */
+static void
+ovn_extend_table_free_id(struct ovn_extend_table *table, uint32_t table_id)
+{
+    uint32_t idx = table_id - table->id_base;
+
+    bitmap_set0(table->table_ids, idx);
+    table->next_free_id = MIN(table->next_free_id, idx);
+}
+
 static struct ovn_extend_table_info *
 ovn_extend_table_info_alloc(const char *name, uint32_t id, bool is_new_id,
                             uint32_t hash)
@@ -187,7 +208,7 @@ ovn_extend_table_clear(struct ovn_extend_table *table, bool existing)
         /* Don't unset bitmap for desired group_info if the group_id
          * was not freshly reserved. */
         if (existing || g->new_table_id) {
-            bitmap_set0(table->table_ids, g->table_id);
+            ovn_extend_table_free_id(table, g->table_id);
         }
         ovn_extend_table_info_destroy(g);
     }
@@ -213,7 +234,7 @@ ovn_extend_table_remove_existing(struct ovn_extend_table *table,
     hmap_remove(&table->existing, &existing->hmap_node);
 
     /* Dealloc group_id. */
-    bitmap_set0(table->table_ids, existing->table_id);
+    ovn_extend_table_free_id(table, existing->table_id);
     ovn_extend_table_info_destroy(existing);
 }
 
@@ -231,7 +252,7 @@ ovn_extend_table_delete_desired(struct ovn_extend_table *table,
                      e->name, UUID_ARGS(&l->lflow_uuid));
             hmap_remove(&table->desired, &e->hmap_node);
             if (e->new_table_id) {
-                bitmap_set0(table->table_ids, e->table_id);
+                ovn_extend_table_free_id(table, e->table_id);
             }
             ovn_extend_table_info_destroy(e);
         }
@@ -310,22 +331,25 @@ ovn_extend_table_assign_id(struct ovn_extend_table *table, const char *name,
     HMAP_FOR_EACH_WITH_HASH (table_info, hmap_node, hash, &table->existing) {
         if (!strcmp(table_info->name, name)) {
             table_id = table_info->table_id;
+            break;
         }
     }
 
     bool new_table_id = false;
     if (!table_id) {
-        /* Reserve a new group_id. */
-        table_id = bitmap_scan(table->table_ids, 0, 1, MAX_EXT_TABLE_ID + 1);
+        /* Reserve a new group_id, the lowest free one. */
+        uint32_t idx = bitmap_scan(table->table_ids, 0, table->next_free_id,
+                                   MAX_EXT_TABLE_ID + 1);
+        if (idx == MAX_EXT_TABLE_ID + 1) {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+            VLOG_ERR_RL(&rl, "%"PRIu32" out of table ids.", idx);
+            return EXT_TABLE_ID_INVALID;
+        }
+        table->next_free_id = idx;
+        table_id = table->id_base + idx;
         new_table_id = true;
     }
-
-    if (table_id == MAX_EXT_TABLE_ID + 1) {
-        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
-        VLOG_ERR_RL(&rl, "%"PRIu32" out of table ids.", table_id);
-        return EXT_TABLE_ID_INVALID;
-    }
-    bitmap_set1(table->table_ids, table_id);
+    bitmap_set1(table->table_ids, table_id - table->id_base);
 
     table_info = ovn_extend_table_info_alloc(name, table_id, new_table_id,
                                              hash);
@@ -30,6 +30,11 @@ struct ovn_extend_table {
     unsigned long *table_ids;  /* Used as a bitmap with value set
                                 * for allocated group ids in either
                                 * desired or existing. */
+    uint32_t next_free_id;     /* No id below it is free in 'table_ids',
+                                * so that allocating the lowest free id
+                                * does not scan the whole bitmap. */
+    uint32_t id_base;          /* Added to the indexes in 'table_ids' to
+                                * get the ids. */
     struct hmap desired;
     struct hmap lflow_to_desired; /* Index for looking up desired table
                                    * items from given lflow uuid, with
@@ -73,6 +78,7 @@ struct ovn_extend_table_lflow_ref {
 };
 
 void ovn_extend_table_init(struct ovn_extend_table *);
+void ovn_extend_table_init_base(struct ovn_extend_table *, uint32_t id_base);
 
 void ovn_extend_table_destroy(struct ovn_extend_table *);
 
@@ -27,6 +27,7 @@
 #include "openvswitch/hmap.h"
 #include "openvswitch/vlog.h"
 #include "inc-proc-eng.h"
+#include "timeval.h"
 #include "unixctl.h"
 
 VLOG_DEFINE_THIS_MODULE(inc_proc_eng);
@@ -45,6 +46,22 @@ static const char *engine_node_state_name[EN_STATE_MAX] = {
     [EN_ABORTED]   = "Aborted",
 };
 
+/* Why a node was recomputed. */
+struct engine_recompute_cause {
+    long long int when;                 /* Wall clock time, in ms. */
+    const struct engine_node *node;
+    const struct engine_node *input;    /* NULL if forced. */
+    bool no_handler;                    /* 'input' has no change handler. */
+    bool aborted;                       /* Recompute wasn't allowed. */
+};
+
+/* Ring buffer of the last recompute causes.  'n_recompute_causes' is the
+ * total number of causes recorded, the last one is at index
+ * (n_recompute_causes - 1) % ENGINE_RECOMPUTE_HISTORY. */
+static struct engine_recompute_cause
+    recompute_causes[ENGINE_RECOMPUTE_HISTORY];
+static uint64_t n_recompute_causes;
+
 void
 engine_set_force_recompute(bool val)
 {
@@ -103,6 +120,55 @@ engine_get_nodes(struct engine_node *node, size_t *n_count)
     return engine_topo_sort(node, NULL, n_count, &n_size);
 }
 
+static void
+engine_time_stats_record(struct engine_time_stats *stats, long long int start)
+{
+    uint64_t usec = MAX(time_usec() - start, 0);
+    uint64_t msec = usec / 1000;
+    size_t bucket = msec ? MIN(log_2_floor(msec) + 1,
+                               ENGINE_TIME_HIST_LEN - 1) : 0;
+
+    stats->total_usec += usec;
+    stats->max_usec = MAX(stats->max_usec, usec);
+    stats->hist[bucket]++;
+}
+
+static void
+engine_time_stats_format(const struct engine_time_stats *stats,
+                         struct ds *s)
+{
+    ds_put_format(s, "total %"PRIu64".%03"PRIu64" ms, "
+                  "max %"PRIu64".%03"PRIu64" ms",
+                  stats->total_usec / 1000, stats->total_usec % 1000,
+                  stats->max_usec / 1000, stats->max_usec % 1000);
+    for (size_t i = 0; i < ENGINE_TIME_HIST_LEN; i++) {
+        if (!stats->hist[i]) {
+            continue;
+        }
+        if (i == ENGINE_TIME_HIST_LEN - 1) {
+            ds_put_format(s, ", >=%u ms: %"PRIu64, 1u << (i - 1),
+                          stats->hist[i]);
+        } else {
+            ds_put_format(s, ", <%u ms: %"PRIu64, 1u << i, stats->hist[i]);
+        }
+    }
+}
+
+static void
+engine_record_recompute_cause(const struct engine_node *node,
+                              const struct engine_node_input *input,
+                              bool aborted)
+{
+    struct engine_recompute_cause *cause
+        = &recompute_causes[n_recompute_causes++ % ENGINE_RECOMPUTE_HISTORY];
+
+    cause->when = time_wall_msec();
+    cause->node = node;
+    cause->input = input ? input->node : NULL;
+    cause->no_handler = input && !input->change_handler;
+    cause->aborted = aborted;
+}
+
 static void
 engine_clear_stats(struct unixctl_conn *conn, int argc OVS_UNUSED,
                    const char *argv[] OVS_UNUSED, void *arg OVS_UNUSED)
@@ -111,7 +177,11 @@ engine_clear_stats(struct unixctl_conn *conn, int argc OVS_UNUSED,
         struct engine_node *node = engine_nodes[i];
 
         memset(&node->stats, 0, sizeof node->stats);
+        for (size_t j = 0; j < node->n_inputs; j++) {
+            memset(&node->inputs[j].stats, 0, sizeof node->inputs[j].stats);
+        }
     }
+    n_recompute_causes = 0;
     unixctl_command_reply(conn, NULL);
 }
 
@@ -131,6 +201,58 @@ engine_dump_stats(struct unixctl_conn *conn, int argc OVS_UNUSED,
                       "- abort:     %12"PRIu64"\n",
                       node->name, node->stats.recompute,
                       node->stats.compute, node->stats.abort);
+        ds_put_cstr(&dump, "- run: ");
+        engine_time_stats_format(&node->stats.run_time, &dump);
+        ds_put_char(&dump, '\n');
+
+        for (size_t j = 0; j < node->n_inputs; j++) {
+            const struct engine_node_input *input = &node->inputs[j];
+
+            if (!input->change_handler) {
+                continue;
+            }
+            ds_put_format(&dump, "- handler %s: handled %"PRIu64", "
+                          "failed %"PRIu64", ", input->node->name,
+                          input->stats.handled, input->stats.failed);
+            engine_time_stats_format(&input->stats.time, &dump);
+            ds_put_char(&dump, '\n');
+        }
+    }
+    unixctl_command_reply(conn, ds_cstr(&dump));
+
+    ds_destroy(&dump);
+}
+
+static void
+engine_dump_recompute_causes(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                             const char *argv[] OVS_UNUSED,
+                             void *arg OVS_UNUSED)
+{
+    struct ds dump = DS_EMPTY_INITIALIZER;
+    uint64_t first = (n_recompute_causes > ENGINE_RECOMPUTE_HISTORY
+                      ? n_recompute_causes - ENGINE_RECOMPUTE_HISTORY : 0);
+
+    for (uint64_t i = first; i < n_recompute_causes; i++) {
+        const struct engine_recompute_cause *cause
+            = &recompute_causes[i % ENGINE_RECOMPUTE_HISTORY];
+        char *when = xastrftime_msec("%Y-%m-%dT%H:%M:%S.###Z",
+                                     cause->when, true);
+
+        ds_put_format(&dump, "%s node %s: ", when, cause->node->name);
+        if (!cause->input) {
+            ds_put_cstr(&dump, "forced");
+        } else if (cause->no_handler) {
+            ds_put_format(&dump, "input %s changed, no change handler",
+                          cause->input->name);
+        } else {
+            ds_put_format(&dump, "change handler for input %s failed",
+                          cause->input->name);
+        }
+        if (cause->aborted) {
+            ds_put_cstr(&dump, " (aborted)");
+        }
+        ds_put_char(&dump, '\n');
+        free(when);
     }
     unixctl_command_reply(conn, ds_cstr(&dump));
 
@@ -155,6 +277,8 @@ engine_init(struct engine_node *node, struct engine_arg *arg)
                              engine_dump_stats, NULL);
     unixctl_command_register("inc-engine/clear-stats", "", 0, 0,
                              engine_clear_stats, NULL);
+    unixctl_command_register("inc-engine/show-recompute-causes", "", 0, 0,
+                             engine_dump_recompute_causes, NULL);
 }
 
 void
@@ -312,13 +436,16 @@ engine_init_run(void)
 }
 
 /* Do a full recompute (or at least try). If we're not allowed then
- * mark the node as "aborted".
+ * mark the node as "aborted".  'input' is the input whose change caused the
+ * recompute, or NULL if it is forced.
  */
 static void
-engine_recompute(struct engine_node *node, bool forced, bool allowed)
+engine_recompute(struct engine_node *node,
+                 const struct engine_node_input *input, bool allowed)
 {
     VLOG_DBG("node: %s, recompute (%s)", node->name,
-             forced ? "forced" : "triggered");
+             input ? "triggered" : "forced");
+    engine_record_recompute_cause(node, input, !allowed);
 
     if (!allowed) {
         VLOG_DBG("node: %s, recompute aborted", node->name);
@@ -333,7 +460,9 @@ engine_recompute(struct engine_node *node, bool forced, bool allowed)
     }
 
     /* Run the node handler which might change state. */
+    long long int start = time_usec();
     node->run(node, node->data);
+    engine_time_stats_record(&node->stats.run_time, start);
     node->stats.recompute++;
 }
 
@@ -342,21 +471,29 @@ static bool
 engine_compute(struct engine_node *node, bool recompute_allowed)
 {
     for (size_t i = 0; i < node->n_inputs; i++) {
+        struct engine_node_input *input = &node->inputs[i];
+
         /* If the input node data changed call its change handler. */
-        if (node->inputs[i].node->state == EN_UPDATED) {
+        if (input->node->state == EN_UPDATED) {
             VLOG_DBG("node: %s, handle change for input %s",
-                     node->name, node->inputs[i].node->name);
+                     node->name, input->node->name);
+
+            long long int start = time_usec();
+            bool handled = input->change_handler(node, node->data);
+            engine_time_stats_record(&input->stats.time, start);
 
             /* If the input change can't be handled incrementally, run
              * the node handler.
              */
-            if (!node->inputs[i].change_handler(node, node->data)) {
+            if (!handled) {
+                input->stats.failed++;
                 VLOG_DBG("node: %s, can't handle change for input %s, "
                          "fall back to recompute",
-                         node->name, node->inputs[i].node->name);
-                engine_recompute(node, false, recompute_allowed);
+                         node->name, input->node->name);
+                engine_recompute(node, input, recompute_allowed);
                 return (node->state != EN_ABORTED);
             }
+            input->stats.handled++;
         }
     }
     node->stats.compute++;
@@ -369,13 +506,15 @@ engine_run_node(struct engine_node *node, bool recompute_allowed)
 {
     if (!node->n_inputs) {
         /* Run the node handler which might change state. */
+        long long int start = time_usec();
         node->run(node, node->data);
+        engine_time_stats_record(&node->stats.run_time, start);
         node->stats.recompute++;
         return;
     }
 
     if (engine_force_recompute) {
-        engine_recompute(node, true, recompute_allowed);
+        engine_recompute(node, NULL, recompute_allowed);
         return;
     }
 
@@ -389,7 +528,7 @@ engine_run_node(struct engine_node *node, bool recompute_allowed)
 
             /* Trigger a recompute if we don't have a change handler. */
             if (!node->inputs[i].change_handler) {
-                engine_recompute(node, false, recompute_allowed);
+                engine_recompute(node, &node->inputs[i], recompute_allowed);
                 return;
             }
         }
@@ -18,9 +18,10 @@
 #define INC_PROC_ENG_H 1
 
 /* The Incremental Processing Engine is a framework for incrementally
- * processing changes from different inputs. The main user is ovn-controller.
- * To compute desired states (e.g. openflow rules) based on many inputs (e.g.
- * south-bound DB tables, local OVSDB interfaces, etc.), it is straightforward
+ * processing changes from different inputs. It is used by ovn-controller and
+ * ovn-northd. To compute desired states (e.g. openflow rules or logical
+ * flows) based on many inputs (e.g. north-bound and south-bound DB tables,
+ * local OVSDB interfaces, etc.), it is straightforward
  * to recompute everything when there is any change in any inputs, but it
  * is inefficient when the size of the input data becomes large. Instead,
  * tracking the changes and update the desired states based on what's changed
@@ -63,20 +64,43 @@
 #define ENGINE_MAX_INPUT 256
 #define ENGINE_MAX_OVSDB_INDEX 256
 
+/* Number of buckets of the time histograms of the engine statistics.  Bucket
+ * 0 counts the durations below 1 ms, bucket 'i' those between 2**(i - 1) and
+ * 2**i ms, and the last bucket all the longer ones. */
+#define ENGINE_TIME_HIST_LEN 12
+
+/* Number of recompute causes kept for inc-engine/show-recompute-causes. */
+#define ENGINE_RECOMPUTE_HISTORY 32
+
 struct engine_context {
     struct ovsdb_idl_txn *ovs_idl_txn;
+    struct ovsdb_idl_txn *ovnnb_idl_txn;
     struct ovsdb_idl_txn *ovnsb_idl_txn;
     void *client_ctx;
 };
 
 /* Arguments to be passed to the engine at engine_init(). */
 struct engine_arg {
+    struct ovsdb_idl *nb_idl;
     struct ovsdb_idl *sb_idl;
     struct ovsdb_idl *ovs_idl;
 };
 
 struct engine_node;
 
+/* Durations of the calls to a 'run' method or a change handler. */
+struct engine_time_stats {
+    uint64_t total_usec;
+    uint64_t max_usec;
+    uint64_t hist[ENGINE_TIME_HIST_LEN];
+};
+
+struct engine_input_stats {
+    uint64_t handled;           /* Calls that returned true. */
+    uint64_t failed;            /* Calls that returned false. */
+    struct engine_time_stats time;
+};
+
 struct engine_node_input {
     /* The input node. */
     struct engine_node *node;
@@ -91,6 +115,9 @@ struct engine_node_input {
      * and the pointers are NULL, the change handler MUST return false.
      */
     bool (*change_handler)(struct engine_node *node, void *data);
+
+    /* Change handler stats. */
+    struct engine_input_stats stats;
 };
 
 enum engine_node_state {
@@ -111,6 +138,7 @@ struct engine_stats {
     uint64_t recompute;
     uint64_t compute;
     uint64_t abort;
+    struct engine_time_stats run_time;
 };
 
 struct engine_node {
@@ -338,6 +366,11 @@ static void en_##DB_NAME##_##TBL_NAME##_cleanup(void *data OVS_UNUSED) \
 { \
 }
 
+/* Macro to define member functions of an engine node which represents
+ * a table of OVN NB DB */
+#define ENGINE_FUNC_NB(TBL_NAME) \
+    ENGINE_FUNC_OVSDB(nb, TBL_NAME)
+
 /* Macro to define member functions of an engine node which represents
  * a table of OVN SB DB */
 #define ENGINE_FUNC_SB(TBL_NAME) \
@@ -352,6 +385,10 @@ static void en_##DB_NAME##_##TBL_NAME##_cleanup(void *data OVS_UNUSED) \
 #define ENGINE_NODE_OVSDB(DB_NAME, DB_NAME_STR, TBL_NAME, TBL_NAME_STR) \
     ENGINE_NODE(DB_NAME##_##TBL_NAME, DB_NAME_STR"_"TBL_NAME_STR)
 
+/* Macro to define an engine node which represents a table of OVN NB DB */
+#define ENGINE_NODE_NB(TBL_NAME, TBL_NAME_STR) \
+    ENGINE_NODE_OVSDB(nb, "NB", TBL_NAME, TBL_NAME_STR);
+
 /* Macro to define an engine node which represents a table of OVN SB DB */
 #define ENGINE_NODE_SB(TBL_NAME, TBL_NAME_STR) \
     ENGINE_NODE_OVSDB(sb, "SB", TBL_NAME, TBL_NAME_STR);
@@ -168,6 +168,10 @@ void ovn_northd_lb_vip_destroy(struct ovn_northd_lb_vip *vip)
         free(vip->backends_nb[i].svc_mon_src_ip);
     }
     free(vip->backends_nb);
+    free(vip->ls_lflow_match);
+    free(vip->ls_lflow_actions);
+    free(vip->lr_lflow_match);
+    free(vip->lr_lflow_actions);
 }
 
 static void
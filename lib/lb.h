@@ -72,6 +72,17 @@ struct ovn_northd_lb_vip {
     size_t n_backends;
 
     struct nbrec_load_balancer_health_check *lb_health_check;
+
+    /* Match and actions of the load balancing flows of the VIP, which
+     * ovn-northd formats once for all the logical switches and routers of
+     * the load balancer.  The router match doesn't include the gateway port
+     * residency condition. */
+    char *ls_lflow_match;
+    char *ls_lflow_actions;
+    uint16_t ls_lflow_priority;
+    char *lr_lflow_match;
+    char *lr_lflow_actions;
+    uint16_t lr_lflow_priority;
 };
 
 struct ovn_northd_lb_backend {
@@ -506,10 +506,14 @@ lex_parse_integer(const char *p, struct lex_token *token)
     return p;
 }
 
+/* Parses the quoted string at 'p'.  Most strings, e.g. port names, have no
+ * escapes, so they are copied as they are, usually into 'token->buffer',
+ * instead of going through json_string_unescape() and malloc(). */
 static const char *
 lex_parse_string(const char *p, struct lex_token *token)
 {
     const char *start = ++p;
+    bool escaped = false;
     char * s = NULL;
     for (;;) {
         switch (*p) {
@@ -518,12 +522,18 @@ lex_parse_string(const char *p, struct lex_token *token)
             return p;
 
         case '"':
+            if (!escaped) {
+                token->type = LEX_T_STRING;
+                lex_token_strcpy(token, start, p - start);
+                return p + 1;
+            }
             token->type = (json_string_unescape(start, p - start, &s)
                            ? LEX_T_STRING : LEX_T_ERROR);
             lex_token_strset(token, s);
             return p + 1;
 
         case '\\':
+            escaped = true;
             p++;
             if (*p) {
                 p++;
@@ -281,6 +281,40 @@ ovn_init_symtab(struct shash *symtab)
 
     expr_symtab_add_ovn_field(symtab, "icmp4.frag_mtu", OVN_ICMP4_FRAG_MTU);
     expr_symtab_add_ovn_field(symtab, "icmp6.frag_mtu", OVN_ICMP6_FRAG_MTU);
+
+    expr_symtab_compile(symtab);
+}
+
+static struct ovs_mutex shared_symtab_mutex = OVS_MUTEX_INITIALIZER;
+static struct shash shared_symtab OVS_GUARDED_BY(shared_symtab_mutex);
+static unsigned int shared_symtab_refcount OVS_GUARDED_BY(shared_symtab_mutex);
+
+/* Returns a symbol table initialized by ovn_init_symtab() that is shared by
+ * all the callers, so that it is built only once per process.  The caller
+ * must not modify it, and must release it with ovn_symtab_unref(). */
+const struct shash *
+ovn_symtab_ref(void)
+{
+    ovs_mutex_lock(&shared_symtab_mutex);
+    if (!shared_symtab_refcount++) {
+        ovn_init_symtab(&shared_symtab);
+    }
+    ovs_mutex_unlock(&shared_symtab_mutex);
+    return &shared_symtab;
+}
+
+/* Releases a reference taken with ovn_symtab_ref(), and destroys the shared
+ * symbol table when it was the last one. */
+void
+ovn_symtab_unref(void)
+{
+    ovs_mutex_lock(&shared_symtab_mutex);
+    ovs_assert(shared_symtab_refcount);
+    if (!--shared_symtab_refcount) {
+        expr_symtab_destroy(&shared_symtab);
+        shash_destroy(&shared_symtab);
+    }
+    ovs_mutex_unlock(&shared_symtab_mutex);
 }
 
 const char *
@@ -33,6 +33,7 @@ extern "C" {
 #include "openvswitch/hmap.h"
 #include "openvswitch/thread.h"
 #include "ovs-atomic.h"
+#include "ovs-rcu.h"
 
 /* Process this include only if OVS does not supply parallel definitions
  */
@@ -200,9 +201,14 @@ static inline void wait_for_work(struct worker_control *control)
 {
     int ret;
 
+    /* The workers may wait for a long time between two jobs.  Being
+     * quiescent meanwhile lets the RCU grace periods complete in the
+     * process. */
+    ovsrcu_quiesce_start();
     do {
         ret = sem_wait(control->fire);
     } while ((ret == -1) && (errno == EINTR));
+    ovsrcu_quiesce_end();
     atomic_thread_fence(memory_order_acquire);
     ovs_assert(ret == 0);
 }
@@ -294,6 +300,71 @@ bool ovn_can_parallelize_hashes(bool force_parallel);
 
 #endif
 
+/* Dynamic distribution of work across the workers of a pool.
+ *
+ * HMAP_FOR_EACH_IN_PARALLEL assigns the buckets of a hash map to the workers
+ * statically, so a worker that gets a few expensive elements keeps running
+ * long after the others are idle.  Instead, a 'struct parallel_work' hands
+ * out chunks of consecutive buckets to whichever worker asks for one next,
+ * until all of them are processed:
+ *
+ *     size_t start, end;
+ *     while (parallel_work_next(work, &start, &end)) {
+ *         for (size_t bnum = start; bnum < end; bnum++) {
+ *             HMAP_FOR_EACH_IN_PARALLEL (NODE, MEMBER, bnum, HMAP) {
+ *                 ...
+ *             }
+ *         }
+ *     }
+ *
+ * The main thread initializes it with parallel_work_init() before running
+ * the pool.  The hash map must not be modified while the pool runs. */
+
+/* Number of chunks per worker.  Smaller chunks balance the load better, at
+ * the cost of more contention on the shared counter. */
+#define PARALLEL_WORK_CHUNKS_PER_WORKER 16
+
+struct parallel_work {
+    atomic_size_t next;     /* First bucket of the next chunk. */
+    size_t n_buckets;       /* Number of buckets (or array elements). */
+    size_t chunk_size;      /* Number of buckets per chunk. */
+};
+
+/* Initializes 'work' to hand out the indexes 0 to 'n' - 1 of an array,
+ * instead of the buckets of a hash map. */
+static inline void
+parallel_work_init_n(struct parallel_work *work, size_t n, size_t pool_size)
+{
+    size_t n_chunks = MAX(pool_size, 1) * PARALLEL_WORK_CHUNKS_PER_WORKER;
+
+    atomic_init(&work->next, 0);
+    work->n_buckets = n;
+    work->chunk_size = MAX(n / n_chunks, 1);
+}
+
+static inline void
+parallel_work_init(struct parallel_work *work, const struct hmap *hmap,
+                   size_t pool_size)
+{
+    parallel_work_init_n(work, hmap->mask + 1, pool_size);
+}
+
+/* Claims the next chunk of buckets [*start, *end) for the calling worker.
+ * Returns false if there are no buckets left. */
+static inline bool
+parallel_work_next(struct parallel_work *work, size_t *start, size_t *end)
+{
+    size_t first;
+
+    atomic_add_relaxed(&work->next, work->chunk_size, &first);
+    if (first >= work->n_buckets) {
+        return false;
+    }
+    *start = first;
+    *end = MIN(first + work->chunk_size, work->n_buckets);
+    return true;
+}
+
 #ifdef  __cplusplus
 }
 #endif
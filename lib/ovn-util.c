@@ -19,6 +19,7 @@
 #include <ctype.h>
 #include <unistd.h>
 
+#include "bitmap.h"
 #include "daemon.h"
 #include "include/ovn/actions.h"
 #include "openvswitch/ofp-parse.h"
@@ -539,10 +540,23 @@ ovn_logical_flow_hash(uint8_t table_id, const char *pipeline,
                       uint16_t priority,
                       const char *match, const char *actions)
 {
-    size_t hash = hash_2words((table_id << 16) | priority, 0);
+    return ovn_logical_flow_hash__(table_id, pipeline, priority,
+                                   hash_string(match, 0),
+                                   hash_string(actions, 0));
+}
+
+/* Same as ovn_logical_flow_hash(), for callers that already have the hashes
+ * of the match and actions, as computed by hash_string(s, 0). */
+uint32_t
+ovn_logical_flow_hash__(uint8_t table_id, const char *pipeline,
+                        uint16_t priority,
+                        uint32_t match_hash, uint32_t actions_hash)
+{
+    uint32_t hash = hash_2words((table_id << 16) | priority, 0);
     hash = hash_string(pipeline, hash);
-    hash = hash_string(match, hash);
-    return hash_string(actions, hash);
+    hash = hash_add(hash, match_hash);
+    hash = hash_add(hash, actions_hash);
+    return hash_finish(hash, 8);
 }
 
 uint32_t
@@ -565,68 +579,167 @@ datapath_snat_ct_zone(const struct sbrec_datapath_binding *dp)
 }
 
 
-struct tnlid_node {
-    struct hmap_node hmap_node;
-    uint32_t tnlid;
-};
+void
+ovn_tnlids_init(struct ovn_tnlids *tnlids)
+{
+    *tnlids = (struct ovn_tnlids) OVN_TNLIDS_INITIALIZER;
+}
 
 void
-ovn_destroy_tnlids(struct hmap *tnlids)
+ovn_destroy_tnlids(struct ovn_tnlids *tnlids)
 {
-    struct tnlid_node *node;
-    HMAP_FOR_EACH_POP (node, hmap_node, tnlids) {
-        free(node);
+    for (size_t i = 0; i < tnlids->n_levels; i++) {
+        free(tnlids->levels[i]);
     }
-    hmap_destroy(tnlids);
+    ovn_tnlids_init(tnlids);
 }
 
-/* Returns true if 'tnlid' is present in the hmap 'tnlids'. */
-bool
-ovn_tnlid_present(struct hmap *tnlids, uint32_t tnlid)
+static bool
+ovn_tnlids_word_is_full(unsigned long word)
 {
-    uint32_t hash = hash_int(tnlid, 0);
-    struct tnlid_node *node;
-    HMAP_FOR_EACH_IN_BUCKET (node, hmap_node, hash, tnlids) {
-        if (node->tnlid == tnlid) {
-            return true;
+    return word == ULONG_MAX;
+}
+
+/* Grows the bitmaps of 'tnlids' to cover 'tnlid' and rebuilds the levels
+ * above level 0. */
+static void
+ovn_tnlids_grow(struct ovn_tnlids *tnlids, uint32_t tnlid)
+{
+    size_t old_n_words = tnlids->n_levels ? tnlids->n_words[0] : 0;
+    size_t n_words = MAX(old_n_words, 1);
+    while ((uint64_t) n_words * BITMAP_ULONG_BITS <= tnlid) {
+        n_words *= 2;
+    }
+
+    unsigned long *used = xrealloc(tnlids->levels[0],
+                                   n_words * sizeof *used);
+    memset(&used[old_n_words], 0, (n_words - old_n_words) * sizeof *used);
+    for (size_t i = 1; i < tnlids->n_levels; i++) {
+        free(tnlids->levels[i]);
+    }
+
+    size_t level = 0;
+    tnlids->levels[0] = used;
+    tnlids->n_words[0] = n_words;
+    while (tnlids->n_words[level] > 1) {
+        const unsigned long *lower = tnlids->levels[level];
+        size_t n_lower = tnlids->n_words[level];
+        size_t n_upper = DIV_ROUND_UP(n_lower, BITMAP_ULONG_BITS);
+        unsigned long *upper = xzalloc(n_upper * sizeof *upper);
+
+        for (size_t i = 0; i < n_lower; i++) {
+            if (ovn_tnlids_word_is_full(lower[i])) {
+                bitmap_set1(upper, i);
+            }
         }
+        level++;
+        ovs_assert(level < OVN_TNLIDS_MAX_LEVELS);
+        tnlids->levels[level] = upper;
+        tnlids->n_words[level] = n_upper;
     }
+    tnlids->n_levels = level + 1;
+}
 
-    return false;
+/* Returns true if 'tnlid' is present in 'tnlids'. */
+bool
+ovn_tnlid_present(const struct ovn_tnlids *tnlids, uint32_t tnlid)
+{
+    return (tnlids->n_levels
+            && tnlid / BITMAP_ULONG_BITS < tnlids->n_words[0]
+            && bitmap_is_set(tnlids->levels[0], tnlid));
 }
 
 bool
-ovn_add_tnlid(struct hmap *set, uint32_t tnlid)
+ovn_add_tnlid(struct ovn_tnlids *tnlids, uint32_t tnlid)
 {
-    if (ovn_tnlid_present(set, tnlid)) {
+    if (ovn_tnlid_present(tnlids, tnlid)) {
         return false;
     }
 
-    uint32_t hash = hash_int(tnlid, 0);
-    struct tnlid_node *node = xmalloc(sizeof *node);
-    hmap_insert(set, &node->hmap_node, hash);
-    node->tnlid = tnlid;
+    if (!tnlids->n_levels
+        || tnlid / BITMAP_ULONG_BITS >= tnlids->n_words[0]) {
+        ovn_tnlids_grow(tnlids, tnlid);
+    }
+
+    /* Set the bit of 'tnlid', then the bits of the words that become full
+     * in the levels above. */
+    uint64_t pos = tnlid;
+    for (size_t level = 0; level < tnlids->n_levels; level++) {
+        bitmap_set1(tnlids->levels[level], pos);
+        if (!ovn_tnlids_word_is_full(
+                tnlids->levels[level][pos / BITMAP_ULONG_BITS])) {
+            break;
+        }
+        pos /= BITMAP_ULONG_BITS;
+    }
     return true;
 }
 
-static uint32_t
-next_tnlid(uint32_t tnlid, uint32_t min, uint32_t max)
+/* Returns the first bit of 'level' of 'tnlids' at or after 'pos' that is
+ * not set.  The result may be beyond the end of the level. */
+static uint64_t
+ovn_tnlids_next_free__(const struct ovn_tnlids *tnlids, size_t level,
+                       uint64_t pos)
+{
+    const unsigned long *words = tnlids->levels[level];
+    size_t n_words = tnlids->n_words[level];
+    uint64_t w = pos / BITMAP_ULONG_BITS;
+
+    if (w >= n_words) {
+        return pos;
+    }
+
+    unsigned long free_bits = (~words[w]
+                               & (ULONG_MAX << (pos % BITMAP_ULONG_BITS)));
+    if (free_bits) {
+        return w * BITMAP_ULONG_BITS + raw_ctz(free_bits);
+    }
+
+    /* The rest of word 'w' is full, so look for the next word that isn't in
+     * the level above. */
+    if (level + 1 >= tnlids->n_levels) {
+        return (uint64_t) n_words * BITMAP_ULONG_BITS;
+    }
+    w = ovn_tnlids_next_free__(tnlids, level + 1, w + 1);
+    if (w >= n_words) {
+        return (uint64_t) n_words * BITMAP_ULONG_BITS;
+    }
+    return w * BITMAP_ULONG_BITS + raw_ctz(~words[w]);
+}
+
+/* Returns the first key at or after 'pos' that is not present in
+ * 'tnlids'. */
+static uint64_t
+ovn_tnlids_next_free(const struct ovn_tnlids *tnlids, uint64_t pos)
 {
-    return tnlid + 1 <= max ? tnlid + 1 : min;
+    return tnlids->n_levels ? ovn_tnlids_next_free__(tnlids, 0, pos) : pos;
 }
 
+/* Allocates the first key between 'min' and 'max' that is not present in
+ * 'tnlids', looking after '*hint' first and then wrapping around to 'min'.
+ * '*hint' itself is not reused.  Updates '*hint' and returns the key, or 0
+ * if all the keys are in use. */
 uint32_t
-ovn_allocate_tnlid(struct hmap *set, const char *name, uint32_t min,
+ovn_allocate_tnlid(struct ovn_tnlids *tnlids, const char *name, uint32_t min,
                    uint32_t max, uint32_t *hint)
 {
-    for (uint32_t tnlid = next_tnlid(*hint, min, max); tnlid != *hint;
-         tnlid = next_tnlid(tnlid, min, max)) {
-        if (ovn_add_tnlid(set, tnlid)) {
-            *hint = tnlid;
-            return tnlid;
+    bool hint_in_range = *hint >= min && *hint <= max;
+    uint64_t tnlid = ovn_tnlids_next_free(tnlids, (hint_in_range
+                                                   ? (uint64_t) *hint + 1
+                                                   : min));
+    if (tnlid > max && hint_in_range) {
+        tnlid = ovn_tnlids_next_free(tnlids, min);
+        if (tnlid >= *hint) {
+            tnlid = UINT64_MAX;
         }
     }
 
+    if (tnlid <= max) {
+        ovn_add_tnlid(tnlids, tnlid);
+        *hint = tnlid;
+        return tnlid;
+    }
+
     static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
     VLOG_WARN_RL(&rl, "all %s tunnel ids exhausted", name);
     return 0;
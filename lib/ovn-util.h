@@ -18,6 +18,7 @@
 
 #include "lib/packets.h"
 #include "include/ovn/version.h"
+#include "openvswitch/hmap.h"
 
 #define ovn_set_program_name(name) \
     ovs_set_program_name(name, OVN_PACKAGE_VERSION)
@@ -106,6 +107,9 @@ uint32_t sbrec_logical_flow_hash(const struct sbrec_logical_flow *);
 uint32_t ovn_logical_flow_hash(uint8_t table_id, const char *pipeline,
                                uint16_t priority,
                                const char *match, const char *actions);
+uint32_t ovn_logical_flow_hash__(uint8_t table_id, const char *pipeline,
+                                 uint16_t priority,
+                                 uint32_t match_hash, uint32_t actions_hash);
 uint32_t ovn_logical_flow_hash_datapath(const struct uuid *logical_datapath,
                                         uint32_t hash);
 bool datapath_is_switch(const struct sbrec_datapath_binding *);
@@ -123,12 +127,28 @@ void ovn_conn_show(struct unixctl_conn *conn, int argc OVS_UNUSED,
 #define OVN_MAX_DP_VXLAN_KEY ((1u << 12) - 1)
 #define OVN_MAX_DP_VXLAN_KEY_LOCAL (OVN_MAX_DP_KEY - OVN_MAX_DP_GLOBAL_NUM)
 
-struct hmap;
-void ovn_destroy_tnlids(struct hmap *tnlids);
-bool ovn_add_tnlid(struct hmap *set, uint32_t tnlid);
-bool ovn_tnlid_present(struct hmap *tnlids, uint32_t tnlid);
-uint32_t ovn_allocate_tnlid(struct hmap *set, const char *name, uint32_t min,
-                            uint32_t max, uint32_t *hint);
+/* A set of tunnel keys in use.
+ *
+ * It is a hierarchy of bitmaps.  Bit 'i' of level 0 is set if key 'i' is in
+ * use, and bit 'i' of level 'n' is set if word 'i' of level 'n - 1' is full,
+ * so that ovn_allocate_tnlid() finds a free key in O(log n) even when the
+ * keys are dense.  The bitmaps grow with the largest key in use. */
+#define OVN_TNLIDS_MAX_LEVELS 7
+
+struct ovn_tnlids {
+    unsigned long *levels[OVN_TNLIDS_MAX_LEVELS];
+    size_t n_words[OVN_TNLIDS_MAX_LEVELS];
+    size_t n_levels;
+};
+
+#define OVN_TNLIDS_INITIALIZER { .n_levels = 0 }
+
+void ovn_tnlids_init(struct ovn_tnlids *);
+void ovn_destroy_tnlids(struct ovn_tnlids *);
+bool ovn_add_tnlid(struct ovn_tnlids *, uint32_t tnlid);
+bool ovn_tnlid_present(const struct ovn_tnlids *, uint32_t tnlid);
+uint32_t ovn_allocate_tnlid(struct ovn_tnlids *, const char *name,
+                            uint32_t min, uint32_t max, uint32_t *hint);
 
 static inline void
 get_unique_lport_key(uint64_t dp_tunnel_key, uint64_t lport_tunnel_key,
@@ -145,6 +165,16 @@ get_sb_port_group_name(const char *nb_pg_name, int64_t dp_tunnel_key,
     ds_put_format(sb_pg_name, "%"PRId64"_%s", dp_tunnel_key, nb_pg_name);
 }
 
+/* Returns the number of bytes allocated for the buckets of 'hmap', for
+ * memory accounting. */
+static inline size_t
+ovn_hmap_buckets_size(const struct hmap *hmap)
+{
+    return (hmap->buckets != &hmap->one
+            ? (hmap->mask + 1) * sizeof *hmap->buckets
+            : 0);
+}
+
 char *ovn_chassis_redirect_name(const char *port_name);
 void ovn_set_pidfile(const char *name);
 
@@ -11,6 +11,9 @@
 #include "smap.h"
 #include "packets.h"
 #include "bitmap.h"
+#include "hash.h"
+#include "util.h"
+#include "openvswitch/hmap.h"
 #include "openvswitch/vlog.h"
 
 VLOG_DEFINE_THIS_MODULE(ipam)
@@ -76,8 +79,13 @@ ipam_get_unused_ip(struct ipam_info *info)
         return 0;
     }
 
-    size_t new_ip_index = bitmap_scan(info->allocated_ipv4s, 0, 0,
+    /* Addresses are only ever added to 'allocated_ipv4s', so there is no need
+     * to rescan the part of the bitmap that was found full by the previous
+     * call. */
+    size_t new_ip_index = bitmap_scan(info->allocated_ipv4s, 0,
+                                      info->next_ipv4_index,
                                       info->total_ipv4s - 1);
+    info->next_ipv4_index = new_ip_index;
     if (new_ip_index == info->total_ipv4s - 1) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
         VLOG_WARN_RL(&rl, "%s: Subnet address space has been exhausted.",
@@ -88,6 +96,106 @@ ipam_get_unused_ip(struct ipam_info *info)
     return info->start_ipv4 + new_ip_index;
 }
 
+/* IPv4 address pools, keyed by the 'id' passed to init_ipam_info().
+ *
+ * Parsing 'subnet' and 'exclude_ips' and building the initial bitmap is
+ * repeated for every logical switch on every ovn-northd run, although the
+ * configuration rarely changes.  The result is kept here across runs and
+ * reused as long as the configuration stays the same. */
+static struct hmap ipv4_pools = HMAP_INITIALIZER(&ipv4_pools);
+
+struct ipv4_pool {
+    struct hmap_node hmap_node;     /* In 'ipv4_pools'. */
+    char *id;
+    char *subnet;
+    char *exclude_ips;              /* May be NULL. */
+    uint32_t start_ipv4;
+    size_t total_ipv4s;
+    unsigned long *excluded_ipv4s;  /* First IP and 'exclude_ips'. */
+    bool used;                      /* Used since last ipam_sweep_cache(). */
+};
+
+static struct ipv4_pool *
+ipv4_pool_find(const char *id)
+{
+    struct ipv4_pool *pool;
+    HMAP_FOR_EACH_WITH_HASH (pool, hmap_node, hash_string(id, 0),
+                             &ipv4_pools) {
+        if (!strcmp(pool->id, id)) {
+            return pool;
+        }
+    }
+    return NULL;
+}
+
+static void
+ipv4_pool_destroy(struct ipv4_pool *pool)
+{
+    hmap_remove(&ipv4_pools, &pool->hmap_node);
+    bitmap_free(pool->excluded_ipv4s);
+    free(pool->exclude_ips);
+    free(pool->subnet);
+    free(pool->id);
+    free(pool);
+}
+
+static void
+ipv4_pool_store(const struct ipam_info *info, const char *subnet_str,
+                const char *exclude_ip_list)
+{
+    struct ipv4_pool *pool = ipv4_pool_find(info->id);
+    if (pool) {
+        ipv4_pool_destroy(pool);
+    }
+
+    pool = xmalloc(sizeof *pool);
+    pool->id = xstrdup(info->id);
+    pool->subnet = xstrdup(subnet_str);
+    pool->exclude_ips = nullable_xstrdup(exclude_ip_list);
+    pool->start_ipv4 = info->start_ipv4;
+    pool->total_ipv4s = info->total_ipv4s;
+    pool->excluded_ipv4s = bitmap_clone(info->allocated_ipv4s,
+                                        info->total_ipv4s);
+    pool->used = true;
+    hmap_insert(&ipv4_pools, &pool->hmap_node, hash_string(pool->id, 0));
+}
+
+/* Initializes the IPv4 part of 'info' from the pool cached for 'info->id', if
+ * that pool was built from the same configuration.  Returns true if
+ * successful, false if the configuration has to be parsed. */
+static bool
+ipv4_pool_load(struct ipam_info *info, const char *subnet_str,
+               const char *exclude_ip_list)
+{
+    struct ipv4_pool *pool = ipv4_pool_find(info->id);
+    if (!pool || strcmp(pool->subnet, subnet_str)
+        || !nullable_string_is_equal(pool->exclude_ips, exclude_ip_list)) {
+        return false;
+    }
+
+    info->start_ipv4 = pool->start_ipv4;
+    info->total_ipv4s = pool->total_ipv4s;
+    info->allocated_ipv4s = bitmap_clone(pool->excluded_ipv4s,
+                                         pool->total_ipv4s);
+    pool->used = true;
+    return true;
+}
+
+/* Frees the cached IPv4 pools that were not used by init_ipam_info() since the
+ * previous call, e.g. because their logical switch was deleted. */
+void
+ipam_sweep_cache(void)
+{
+    struct ipv4_pool *pool, *next;
+    HMAP_FOR_EACH_SAFE (pool, next, hmap_node, &ipv4_pools) {
+        if (pool->used) {
+            pool->used = false;
+        } else {
+            ipv4_pool_destroy(pool);
+        }
+    }
+}
+
 /* MAC address management (macam) table of "struct eth_addr"s, that holds the
  * MAC addresses allocated by the OVN ipam module. */
 static struct hmap macam = HMAP_INITIALIZER(&macam);
@@ -251,8 +359,9 @@ init_ipam_ipv4(const char *subnet_str, const char *exclude_ip_list,
     info->start_ipv4 = 0;
     info->total_ipv4s = 0;
     info->allocated_ipv4s = NULL;
+    info->next_ipv4_index = 0;
 
-    if (!subnet_str) {
+    if (!subnet_str || ipv4_pool_load(info, subnet_str, exclude_ip_list)) {
         return;
     }
 
@@ -275,6 +384,7 @@ init_ipam_ipv4(const char *subnet_str, const char *exclude_ip_list,
     bitmap_set1(info->allocated_ipv4s, 0);
 
     if (!exclude_ip_list) {
+        ipv4_pool_store(info, subnet_str, NULL);
         return;
     }
 
@@ -316,6 +426,10 @@ init_ipam_ipv4(const char *subnet_str, const char *exclude_ip_list,
     if (lexer.error) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
         VLOG_WARN_RL(&rl, "%s: bad exclude_ips (%s)", info->id, lexer.error);
+    } else {
+        /* Only cache valid configurations so that errors keep being
+         * reported. */
+        ipv4_pool_store(info, subnet_str, exclude_ip_list);
     }
     lexer_destroy(&lexer);
 }
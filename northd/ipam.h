@@ -10,6 +10,7 @@ struct ipam_info {
     uint32_t start_ipv4;
     size_t total_ipv4s;
     unsigned long *allocated_ipv4s; /* A bitmap of allocated IPv4s */
+    size_t next_ipv4_index;         /* All lower bits are set. */
     bool ipv6_prefix_set;
     struct in6_addr ipv6_prefix;
     bool mac_only;
@@ -32,6 +33,8 @@ uint64_t ipam_get_unused_mac(ovs_be32 ip);
 
 void cleanup_macam(void);
 
+void ipam_sweep_cache(void);
+
 struct eth_addr get_mac_prefix(void);
 
 const char *set_mac_prefix(const char *hint);
@@ -396,6 +396,86 @@ get_nb_cfg(const struct json *table_updates, int64_t *nb_cfgp)
     }
 }
 
+/* Maximum number of rows passed to DDlog at a time. */
+#define NORTHD_UPDATE_CHUNK 1024
+
+/* Serializes <table-updates> 'chunk', whose rows are borrowed from another
+ * <table-updates>, and pushes it into DDlog.  Empties 'chunk' without freeing
+ * the rows.  Returns 0 if successful, otherwise a nonzero value. */
+static int
+northd_apply_chunk(struct northd_ctx *ctx, struct json *chunk)
+{
+    int error = 0;
+
+    if (!shash_is_empty(json_object(chunk))) {
+        char *updates_s = json_to_string(chunk, 0);
+        error = ddlog_apply_ovsdb_updates(ctx->ddlog, ctx->prefix,
+                                          updates_s);
+        if (error) {
+            VLOG_WARN("DDlog failed to apply updates %s", updates_s);
+        }
+        free(updates_s);
+    }
+
+    struct shash_node *node;
+    SHASH_FOR_EACH (node, json_object(chunk)) {
+        shash_clear(json_object(node->data));
+        json_destroy(node->data);
+    }
+    shash_clear(json_object(chunk));
+    return error;
+}
+
+/* Pushes <table-updates> 'table_updates' into DDlog.
+ *
+ * The updates are serialized NORTHD_UPDATE_CHUNK rows at a time, so that a
+ * large update, such as the initial contents of the database, is never held
+ * in memory as a single string in addition to its JSON tree. */
+static int
+northd_apply_updates(struct northd_ctx *ctx,
+                     const struct json *table_updates)
+{
+    if (table_updates->type != JSON_OBJECT) {
+        return 0;
+    }
+
+    struct json *chunk = json_object_create();
+    size_t n_rows = 0;
+    int error = 0;
+
+    struct shash_node *table;
+    SHASH_FOR_EACH (table, json_object(table_updates)) {
+        const struct json *rows = table->data;
+        if (rows->type != JSON_OBJECT) {
+            continue;
+        }
+
+        struct shash_node *row;
+        SHASH_FOR_EACH (row, json_object(rows)) {
+            struct json *chunk_rows = shash_find_data(json_object(chunk),
+                                                      table->name);
+            if (!chunk_rows) {
+                chunk_rows = json_object_create();
+                json_object_put(chunk, table->name, chunk_rows);
+            }
+            shash_add(json_object(chunk_rows), row->name, row->data);
+
+            if (++n_rows >= NORTHD_UPDATE_CHUNK) {
+                error = northd_apply_chunk(ctx, chunk);
+                if (error) {
+                    goto out;
+                }
+                n_rows = 0;
+            }
+        }
+    }
+    error = northd_apply_chunk(ctx, chunk);
+
+out:
+    json_destroy(chunk);
+    return error;
+}
+
 static void
 northd_parse_updates(struct northd_ctx *ctx, struct ovs_list *updates)
 {
@@ -429,13 +509,9 @@ northd_parse_updates(struct northd_ctx *ctx, struct ovs_list *updates)
             goto error;
         }
 
-        char *updates_s = json_to_string(update->table_updates, 0);
-        if (ddlog_apply_ovsdb_updates(ctx->ddlog, ctx->prefix, updates_s)) {
-            VLOG_WARN("DDlog failed to apply updates %s", updates_s);
-            free(updates_s);
+        if (northd_apply_updates(ctx, update->table_updates)) {
             goto error;
         }
-        free(updates_s);
 
         if (ctx->has_timestamp_columns) {
             get_nb_cfg(update->table_updates, &new_nb_cfg);
@@ -638,11 +714,40 @@ northd_wait(struct northd_ctx *ctx)
 
 /* ddlog-specific actions. */
 
+/* Parses 'updates', a comma-separated list of OVSDB operations as dumped by
+ * DDlog, and appends the operations to JSON array 'ops'.  The operations are
+ * parsed in place, without first copying them into a complete transaction
+ * string. */
+static void
+ddlog_append_ops(struct json *ops, const char *table, const char *updates)
+{
+    struct json_parser *parser = json_parser_create(0);
+    json_parser_feed(parser, "[", 1);
+    json_parser_feed(parser, updates, strlen(updates));
+    json_parser_feed(parser, "]", 1);
+
+    struct json *array = json_parser_finish(parser);
+    if (array->type != JSON_ARRAY) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+        VLOG_WARN_RL(&rl, "%s: failed to parse update commands (%s)", table,
+                     array->type == JSON_STRING ? json_string(array) : "");
+        json_destroy(array);
+        return;
+    }
+
+    for (size_t i = 0; i < array->array.n; i++) {
+        json_array_add(ops, array->array.elems[i]);
+    }
+    array->array.n = 0;
+    json_destroy(array);
+}
+
 /* Generate OVSDB update command for delta-plus, delta-minus, and delta-update
  * tables. */
 static void
-ddlog_table_update_deltas(struct ds *ds, ddlog_prog ddlog, ddlog_delta *delta,
-                          const char *db, const char *table)
+ddlog_table_update_deltas(struct json *ops, ddlog_prog ddlog,
+                          ddlog_delta *delta, const char *db,
+                          const char *table)
 {
     int error;
     char *updates;
@@ -653,20 +758,18 @@ ddlog_table_update_deltas(struct ds *ds, ddlog_prog ddlog, ddlog_delta *delta,
         return;
     }
 
-    if (!updates[0]) {
-        ddlog_free_json(updates);
-        return;
+    if (updates[0]) {
+        ddlog_append_ops(ops, table, updates);
     }
-
-    ds_put_cstr(ds, updates);
-    ds_put_char(ds, ',');
     ddlog_free_json(updates);
 }
 
-/* Generate OVSDB update command for a output-only table. */
+/* Generate OVSDB update command for a output-only table.  If 'ops' is null,
+ * the commands are discarded. */
 static void
-ddlog_table_update_output(struct ds *ds, ddlog_prog ddlog, ddlog_delta *delta,
-                          const char *db, const char *table)
+ddlog_table_update_output(struct json *ops, ddlog_prog ddlog,
+                          ddlog_delta *delta, const char *db,
+                          const char *table)
 {
     int error;
     char *updates;
@@ -681,13 +784,9 @@ ddlog_table_update_output(struct ds *ds, ddlog_prog ddlog, ddlog_delta *delta,
     ddlog_delta_clear_table(delta, ddlog_get_table_id(ddlog, table_name));
     free(table_name);
 
-    if (!updates[0]) {
-        ddlog_free_json(updates);
-        return;
+    if (ops && updates[0]) {
+        ddlog_append_ops(ops, table, updates);
     }
-
-    ds_put_cstr(ds, updates);
-    ds_put_char(ds, ',');
     ddlog_free_json(updates);
 }
 
@@ -807,7 +906,7 @@ struct dump_index_data {
     ddlog_prog prog;
     struct hmap *rows_present;
     const char *table;
-    struct ds *ops_s;
+    struct json *ops;
 };
 
 static void OVS_UNUSED
@@ -845,7 +944,7 @@ index_cb(uintptr_t data_, const ddlog_record *rec)
                      data->table);
         return;
     }
-    ds_put_format(data->ops_s, "%s,", s);
+    ddlog_append_ops(data->ops, data->table, s);
     ddlog_free_json(s);
 }
 
@@ -864,15 +963,14 @@ where_uuid_equals(const struct uuid *uuid)
 }
 
 static void
-add_delete_row_op(const char *table, const struct uuid *uuid, struct ds *ops_s)
+add_delete_row_op(const char *table, const struct uuid *uuid,
+                  struct json *ops)
 {
     struct json *op = json_object_create();
     json_object_put_string(op, "op", "delete");
     json_object_put_string(op, "table", table);
     json_object_put(op, "where", where_uuid_equals(uuid));
-    json_to_ds(op, 0, ops_s);
-    json_destroy(op);
-    ds_put_char(ops_s, ',');
+    json_array_add(ops, op);
 }
 
 static void
@@ -896,14 +994,10 @@ northd_update_sb_cfg_cb(
 static struct json *
 get_database_ops(struct northd_ctx *ctx)
 {
-    struct ds ops_s = DS_EMPTY_INITIALIZER;
-    ds_put_char(&ops_s, '[');
-    json_string_escape(ctx->db_name, &ops_s);
-    ds_put_char(&ops_s, ',');
-    size_t start_len = ops_s.length;
+    struct json *ops = json_array_create_1(json_string_create(ctx->db_name));
 
     for (const char **p = ctx->output_relations; *p; p++) {
-        ddlog_table_update_deltas(&ops_s, ctx->ddlog, ctx->delta,
+        ddlog_table_update_deltas(ops, ctx->ddlog, ctx->delta,
                                   ctx->db_name, *p);
     }
 
@@ -968,7 +1062,7 @@ get_database_ops(struct northd_ctx *ctx)
             /* For each row in the index, update a corresponding OVSDB row, if
              * there is one, otherwise insert a new row. */
             struct dump_index_data cbdata = {
-                ctx->ddlog, &rows_present, table, &ops_s
+                ctx->ddlog, &rows_present, table, ops
             };
             ddlog_dump_index(ctx->ddlog, idxid, index_cb, (uintptr_t) &cbdata);
 
@@ -976,23 +1070,21 @@ get_database_ops(struct northd_ctx *ctx)
              * but not DDlog.  Delete them from OVSDB. */
             struct uuidset_node *node;
             HMAP_FOR_EACH (node, hmap_node, &rows_present) {
-                add_delete_row_op(table, &node->uuid, &ops_s);
+                add_delete_row_op(table, &node->uuid, ops);
             }
             uuidset_destroy(&rows_present);
 
             /* Discard any queued output to this table, since we just
              * did a full sync to it. */
-            struct ds tmp = DS_EMPTY_INITIALIZER;
-            ddlog_table_update_output(&tmp, ctx->ddlog, ctx->delta,
+            ddlog_table_update_output(NULL, ctx->ddlog, ctx->delta,
                                       ctx->db_name, table);
-            ds_destroy(&tmp);
         }
 
         json_destroy(ctx->output_only_data);
         ctx->output_only_data = NULL;
     } else {
         for (const char **p = ctx->output_only_relations; *p; p++) {
-            ddlog_table_update_output(&ops_s, ctx->ddlog, ctx->delta,
+            ddlog_table_update_output(ops, ctx->ddlog, ctx->delta,
                                       ctx->db_name, *p);
         }
     }
@@ -1018,22 +1110,25 @@ get_database_ops(struct northd_ctx *ctx)
         if (new_sb_cfg != old_sb_cfg) {
             old_sb_cfg = new_sb_cfg;
             old_sb_cfg_timestamp = time_wall_msec();
-            ds_put_format(&ops_s, "{\"op\":\"update\",\"table\":\"NB_Global\",\"where\":[],"
-                          "\"row\":{\"sb_cfg_timestamp\":%"PRId64"}},", old_sb_cfg_timestamp);
+
+            struct json *row = json_object_create();
+            json_object_put(row, "sb_cfg_timestamp",
+                            json_integer_create(old_sb_cfg_timestamp));
+
+            struct json *op = json_object_create();
+            json_object_put_string(op, "op", "update");
+            json_object_put_string(op, "table", "NB_Global");
+            json_object_put(op, "where", json_array_create_empty());
+            json_object_put(op, "row", row);
+            json_array_add(ops, op);
         }
     }
 
-    struct json *ops;
-    if (ops_s.length > start_len) {
-        ds_chomp(&ops_s, ',');
-        ds_put_char(&ops_s, ']');
-        ops = json_from_string(ds_cstr(&ops_s));
-    } else {
-        ops = NULL;
+    /* The first element is the database name. */
+    if (ops->array.n <= 1) {
+        json_destroy(ops);
+        return NULL;
     }
-
-    ds_destroy(&ops_s);
-
     return ops;
 }
 
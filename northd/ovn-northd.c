@@ -30,7 +30,9 @@
 #include "openvswitch/hmap.h"
 #include "openvswitch/json.h"
 #include "ovn/lex.h"
+#include "lib/arena.h"
 #include "lib/chassis-index.h"
+#include "lib/inc-proc-eng.h"
 #include "lib/ip-mcast-index.h"
 #include "lib/mcast-group-index.h"
 #include "lib/ovn-l7.h"
@@ -39,6 +41,7 @@
 #include "lib/ovn-util.h"
 #include "lib/lb.h"
 #include "memory.h"
+#include "ovs-thread.h"
 #include "lib/ovn-parallel-hmap.h"
 #include "ovn/actions.h"
 #include "ovn/features.h"
@@ -49,6 +52,7 @@
 #include "smap.h"
 #include "sset.h"
 #include "svec.h"
+#include "stopwatch.h"
 #include "stream.h"
 #include "stream-ssl.h"
 #include "timeval.h"
@@ -64,6 +68,9 @@ static unixctl_cb_func ovn_northd_pause;
 static unixctl_cb_func ovn_northd_resume;
 static unixctl_cb_func ovn_northd_is_paused;
 static unixctl_cb_func ovn_northd_status;
+static unixctl_cb_func ovn_northd_stage_stats;
+static unixctl_cb_func ovn_northd_datapath_stats;
+static unixctl_cb_func ovn_northd_partition_stats;
 static unixctl_cb_func cluster_state_reset_cmd;
 
 struct northd_context {
@@ -75,6 +82,9 @@ struct northd_context {
     struct ovsdb_idl_index *sbrec_ha_chassis_grp_by_name;
     struct ovsdb_idl_index *sbrec_mcast_group_by_name_dp;
     struct ovsdb_idl_index *sbrec_ip_mcast_by_dp;
+    struct ovsdb_idl_index *sbrec_igmp_group_by_addr_dp;
+    struct ovsdb_idl_index *sbrec_lflow_by_datapath;
+    const char *ovn_internal_version;
 };
 
 struct northd_state {
@@ -102,6 +112,27 @@ static struct eth_addr svc_monitor_mac_ea;
  * Otherwise, it will avoid using it.  The default is true. */
 static bool use_ct_inv_match = true;
 
+/* If this option is 'true', the ARP and ND responder flows of a logical
+ * switch port match the set of its addresses instead of one address each,
+ * see build_lswitch_arp_nd_responder_compact().  The default is false. */
+static bool compact_arp_nd_responder;
+
+/* If this option is 'true', the changes that arrive while a transaction to
+ * either database is in flight are kept tracked and processed once both
+ * transactions are available again, instead of forcing a recompute.  The
+ * default is false. */
+static bool defer_changes_during_commit;
+
+/* Stopwatches for the phases of a northd iteration.  Their statistics are
+ * reported by the "stopwatch/show" unixctl command. */
+#define OVNNB_DB_RUN_STOPWATCH_NAME "ovnnb_db_run"
+#define BUILD_DATAPATHS_STOPWATCH_NAME "build_datapaths"
+#define BUILD_PORTS_STOPWATCH_NAME "build_ports"
+#define BUILD_LBS_STOPWATCH_NAME "build_ovn_lbs"
+#define BUILD_LFLOWS_STOPWATCH_NAME "build_lflows"
+#define OVNSB_DB_RUN_STOPWATCH_NAME "ovnsb_db_run"
+#define OVNSB_COMMIT_STOPWATCH_NAME "ovnsb_commit"
+
 /* Default probe interval for NB and SB DB connections. */
 #define DEFAULT_PROBE_INTERVAL_MSEC 5000
 static int northd_probe_interval_nb = 0;
@@ -565,7 +596,7 @@ struct mcast_router_info {
 
 struct mcast_info {
 
-    struct hmap group_tnlids;  /* Group tunnel IDs in use on this DP. */
+    struct ovn_tnlids group_tnlids; /* Group tunnel IDs in use on this DP. */
     uint32_t group_tnlid_hint; /* Hint for allocating next group tunnel ID. */
     struct ovs_list groups;    /* List of groups learnt on this DP. */
 
@@ -616,6 +647,7 @@ ovn_mcast_group_allocate_key(struct mcast_info *mcast_info)
 struct ovn_datapath {
     struct hmap_node key_node;  /* Index on 'key'. */
     struct uuid key;            /* (nbs/nbr)->header_.uuid. */
+    size_t index;               /* In 'datapaths_array'. */
 
     const struct nbrec_logical_switch *nbs;  /* May be NULL. */
     const struct nbrec_logical_router *nbr;  /* May be NULL. */
@@ -629,7 +661,7 @@ struct ovn_datapath {
     struct ovn_port **router_ports;
     size_t n_router_ports;
 
-    struct hmap port_tnlids;
+    struct ovn_tnlids port_tnlids;
     uint32_t port_key_hint;
 
     bool has_stateful_acl;
@@ -672,6 +704,11 @@ struct ovn_datapath {
 
     /* Port groups related to the datapath, used only when nbs is NOT NULL. */
     struct hmap nb_pgs;
+
+    /* Logical flows of the datapath, counted by build_lflows(). */
+    size_t n_lflows;
+    size_t n_lflow_bytes;       /* Bytes of their matches and actions. */
+    bool lflow_budget_exceeded; /* More than 'lflow_budget_hard' flows. */
 };
 
 /* Contains a NAT entry with the external addresses pre-parsed. */
@@ -682,6 +719,14 @@ struct ovn_nat {
                                          * list of nat entries. Currently
                                          * only used for SNAT.
                                          */
+
+    /* The addresses used by the NAT flows, see nat_entry_parse(). */
+    bool is_valid;              /* False if the NAT flows can't be built. */
+    bool is_v6;
+    ovs_be32 mask;
+    int cidr_bits;              /* Prefix length of 'logical_ip'. */
+    bool has_mac;               /* Whether 'external_mac' is valid. */
+    struct eth_addr mac;        /* Parsed 'external_mac'. */
 };
 
 /* Stores the list of SNAT entries referencing a unique SNAT IP address.
@@ -732,6 +777,95 @@ snat_ip_add(struct ovn_datapath *od, const char *ip, struct ovn_nat *nat_entry)
     }
 }
 
+/* Parses the external and logical IPs of 'nat_entry' for the NAT flows, once
+ * per datapath rather than each time the flows are built.  Returns 0 if they
+ * are valid. */
+static int
+nat_entry_parse__(const struct ovn_datapath *od, const struct nbrec_nat *nat,
+                  ovs_be32 *mask, bool *is_v6, int *cidr_bits)
+{
+    struct in6_addr ipv6, mask_v6, v6_exact = IN6ADDR_EXACT_INIT;
+    ovs_be32 ip;
+
+    if (nat->allowed_ext_ips && nat->exempted_ext_ips) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+        VLOG_WARN_RL(&rl, "NAT rule: "UUID_FMT" not applied, since "
+                    "both allowed and exempt external ips set",
+                    UUID_ARGS(&(nat->header_.uuid)));
+        return -EINVAL;
+    }
+
+    char *error = ip_parse_masked(nat->external_ip, &ip, mask);
+    *is_v6 = false;
+
+    if (error || *mask != OVS_BE32_MAX) {
+        free(error);
+        error = ipv6_parse_masked(nat->external_ip, &ipv6, &mask_v6);
+        if (error || memcmp(&mask_v6, &v6_exact, sizeof(mask_v6))) {
+            /* Invalid for both IPv4 and IPv6 */
+            static struct vlog_rate_limit rl =
+                VLOG_RATE_LIMIT_INIT(5, 1);
+            VLOG_WARN_RL(&rl, "bad external ip %s for nat",
+                        nat->external_ip);
+            free(error);
+            return -EINVAL;
+        }
+        /* It was an invalid IPv4 address, but valid IPv6.
+        * Treat the rest of the handling of this NAT rule
+        * as IPv6. */
+        *is_v6 = true;
+    }
+
+    /* Check the validity of nat->logical_ip. 'logical_ip' can
+    * be a subnet when the type is "snat". */
+    if (*is_v6) {
+        error = ipv6_parse_masked(nat->logical_ip, &ipv6, &mask_v6);
+        *cidr_bits = ipv6_count_cidr_bits(&mask_v6);
+    } else {
+        error = ip_parse_masked(nat->logical_ip, &ip, mask);
+        *cidr_bits = ip_count_cidr_bits(*mask);
+    }
+    if (!strcmp(nat->type, "snat")) {
+        if (error) {
+            /* Invalid for both IPv4 and IPv6 */
+            static struct vlog_rate_limit rl =
+                VLOG_RATE_LIMIT_INIT(5, 1);
+            VLOG_WARN_RL(&rl, "bad ip network or ip %s for snat "
+                        "in router "UUID_FMT"",
+                        nat->logical_ip, UUID_ARGS(&od->key));
+            free(error);
+            return -EINVAL;
+        }
+    } else {
+        if (error || (*is_v6 == false && *mask != OVS_BE32_MAX)
+            || (*is_v6 && memcmp(&mask_v6, &v6_exact,
+                                sizeof mask_v6))) {
+            /* Invalid for both IPv4 and IPv6 */
+            static struct vlog_rate_limit rl =
+                VLOG_RATE_LIMIT_INIT(5, 1);
+            VLOG_WARN_RL(&rl, "bad ip %s for dnat in router "
+                ""UUID_FMT"", nat->logical_ip, UUID_ARGS(&od->key));
+            free(error);
+            return -EINVAL;
+        }
+    }
+
+    return 0;
+}
+
+static void
+nat_entry_parse(const struct ovn_datapath *od, struct ovn_nat *nat_entry)
+{
+    const struct nbrec_nat *nat = nat_entry->nb;
+
+    nat_entry->is_valid = !nat_entry_parse__(od, nat, &nat_entry->mask,
+                                             &nat_entry->is_v6,
+                                             &nat_entry->cidr_bits);
+    nat_entry->has_mac = (nat->external_mac
+                          && eth_addr_from_string(nat->external_mac,
+                                                  &nat_entry->mac));
+}
+
 static void
 init_nat_entries(struct ovn_datapath *od)
 {
@@ -787,6 +921,7 @@ init_nat_entries(struct ovn_datapath *od)
         struct ovn_nat *nat_entry = &od->nat_entries[i];
 
         nat_entry->nb = nat;
+        nat_entry_parse(od, nat_entry);
         if (!extract_ip_addresses(nat->external_ip,
                                   &nat_entry->ext_addrs) ||
                 !nat_entry_is_valid(nat_entry)) {
@@ -848,7 +983,7 @@ ovn_datapath_create(struct hmap *datapaths, const struct uuid *key,
     od->sb = sb;
     od->nbs = nbs;
     od->nbr = nbr;
-    hmap_init(&od->port_tnlids);
+    ovn_tnlids_init(&od->port_tnlids);
     hmap_init(&od->nb_pgs);
     od->port_key_hint = 0;
     hmap_insert(datapaths, &od->key_node, uuid_hash(&od->key));
@@ -914,6 +1049,12 @@ ovn_datapath_find_by_key(struct hmap *datapaths, uint32_t dp_key)
     return NULL;
 }
 
+/* All the datapaths built by build_datapaths(), indexed by
+ * 'ovn_datapath->index'.  Logical flows represent their groups of datapaths
+ * as bitmaps of these indexes. */
+static struct ovn_datapath **datapaths_array;
+static size_t n_datapaths;
+
 static bool
 ovn_datapath_is_stale(const struct ovn_datapath *od)
 {
@@ -1019,7 +1160,7 @@ init_mcast_info_for_datapath(struct ovn_datapath *od)
         return;
     }
 
-    hmap_init(&od->mcast_info.group_tnlids);
+    ovn_tnlids_init(&od->mcast_info.group_tnlids);
     od->mcast_info.group_tnlid_hint = OVN_MIN_IP_MULTICAST;
     ovs_list_init(&od->mcast_info.groups);
 
@@ -1254,7 +1395,7 @@ get_ovn_max_dp_key_local(struct northd_context *ctx)
 
 static void
 ovn_datapath_allocate_key(struct northd_context *ctx,
-                          struct hmap *datapaths, struct hmap *dp_tnlids,
+                          struct hmap *datapaths, struct ovn_tnlids *dp_tnlids,
                           struct ovn_datapath *od, uint32_t *hint)
 {
     if (!od->tunnel_key) {
@@ -1273,7 +1414,7 @@ ovn_datapath_allocate_key(struct northd_context *ctx,
 }
 
 static void
-ovn_datapath_assign_requested_tnl_id(struct hmap *dp_tnlids,
+ovn_datapath_assign_requested_tnl_id(struct ovn_tnlids *dp_tnlids,
                                      struct ovn_datapath *od)
 {
     const struct smap *other_config = (od->nbs
@@ -1307,7 +1448,7 @@ build_datapaths(struct northd_context *ctx, struct hmap *datapaths,
     join_datapaths(ctx, datapaths, &sb_only, &nb_only, &both, lr_list);
 
     /* Assign explicitly requested tunnel ids first. */
-    struct hmap dp_tnlids = HMAP_INITIALIZER(&dp_tnlids);
+    struct ovn_tnlids dp_tnlids = OVN_TNLIDS_INITIALIZER;
     struct ovn_datapath *od, *next;
     LIST_FOR_EACH (od, list, &both) {
         ovn_datapath_assign_requested_tnl_id(&dp_tnlids, od);
@@ -1352,6 +1493,14 @@ build_datapaths(struct northd_context *ctx, struct hmap *datapaths,
         sbrec_datapath_binding_delete(od->sb);
         ovn_datapath_destroy(datapaths, od);
     }
+
+    free(datapaths_array);
+    datapaths_array = xmalloc(hmap_count(datapaths) * sizeof *datapaths_array);
+    n_datapaths = 0;
+    HMAP_FOR_EACH (od, key_node, datapaths) {
+        od->index = n_datapaths;
+        datapaths_array[n_datapaths++] = od;
+    }
 }
 
 /* A logical switch port or logical router port.
@@ -2173,6 +2322,156 @@ tag_alloc_create_new_tag(struct hmap *tag_alloc_table,
 }
 
 
+static bool use_parallel_build = true;
+
+/* Worker pool for the phases of northd that compute data for each item of
+ * an array, see parallel_run().  The IDL is not thread-safe, so the workers
+ * can only read the rows.  The main thread then updates the IDL and the
+ * shared data structures with the results. */
+struct parallel_job {
+    struct parallel_work work;
+    void (*cb)(size_t index, void *aux);
+    void *aux;
+};
+
+/* Below this many items, waking up the workers costs more than it saves. */
+#define PARALLEL_RUN_MIN 256
+
+static bool parallel_run_pool_init_done = false;
+static struct worker_pool *parallel_run_pool = NULL;
+
+static void *
+parallel_run_thread(void *arg)
+{
+    struct worker_control *control = arg;
+    size_t start, end;
+
+    while (!stop_parallel_processing()) {
+        wait_for_work(control);
+        struct parallel_job *job = control->data;
+        if (stop_parallel_processing()) {
+            return NULL;
+        }
+        if (job) {
+            while (parallel_work_next(&job->work, &start, &end)) {
+                for (size_t i = start; i < end; i++) {
+                    job->cb(i, job->aux);
+                }
+            }
+        }
+        post_completed_work(control);
+    }
+    return NULL;
+}
+
+/* Calls 'cb' with each index from 0 to 'n' - 1 and 'aux', in parallel if
+ * parallel build is enabled.  'cb' must not access the IDL other than to
+ * read rows. */
+static void
+parallel_run(size_t n, void (*cb)(size_t index, void *aux), void *aux)
+{
+    if (use_parallel_build && !parallel_run_pool_init_done) {
+        parallel_run_pool = add_worker_pool(parallel_run_thread);
+        parallel_run_pool_init_done = true;
+    }
+
+    if (!use_parallel_build || !parallel_run_pool || n < PARALLEL_RUN_MIN) {
+        for (size_t i = 0; i < n; i++) {
+            cb(i, aux);
+        }
+        return;
+    }
+
+    struct parallel_job job = { .cb = cb, .aux = aux };
+    parallel_work_init_n(&job.work, n, parallel_run_pool->size);
+    for (int i = 0; i < parallel_run_pool->size; i++) {
+        parallel_run_pool->controls[i].data = &job;
+    }
+    run_pool_callback(parallel_run_pool, NULL, NULL, NULL);
+}
+
+/* The addresses of a northbound logical switch or router port, parsed by
+ * parse_port_addresses() before join_logical_ports() creates the port. */
+struct port_addresses {
+    const struct nbrec_logical_switch_port *nbsp;  /* May be NULL. */
+    const struct nbrec_logical_router_port *nbrp;  /* May be NULL. */
+
+    /* Logical switch port data, see the members of struct ovn_port. */
+    struct lport_addresses *lsp_addrs;
+    unsigned int n_lsp_addrs;
+    struct lport_addresses *ps_addrs;
+    unsigned int n_ps_addrs;
+    bool has_unknown;
+
+    /* Logical router port data. */
+    bool has_lrp_networks;      /* False if 'mac' is invalid. */
+    struct lport_addresses lrp_networks;
+};
+
+static void
+parse_port_addresses(size_t index, void *port_addrs_)
+{
+    struct port_addresses *port_addrs = port_addrs_;
+    struct port_addresses *pa = &port_addrs[index];
+
+    if (pa->nbrp) {
+        pa->has_lrp_networks = extract_lrp_networks(pa->nbrp,
+                                                    &pa->lrp_networks);
+        return;
+    }
+
+    const struct nbrec_logical_switch_port *nbsp = pa->nbsp;
+    pa->lsp_addrs = xmalloc(sizeof *pa->lsp_addrs * nbsp->n_addresses);
+    for (size_t j = 0; j < nbsp->n_addresses; j++) {
+        if (!strcmp(nbsp->addresses[j], "unknown")) {
+            pa->has_unknown = true;
+            continue;
+        }
+        if (!strcmp(nbsp->addresses[j], "router")) {
+            continue;
+        }
+        if (is_dynamic_lsp_address(nbsp->addresses[j])) {
+            continue;
+        } else if (!extract_lsp_addresses(nbsp->addresses[j],
+                                          &pa->lsp_addrs[pa->n_lsp_addrs])) {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+            VLOG_INFO_RL(&rl, "invalid syntax '%s' in logical switch port "
+                         "addresses. No MAC address found",
+                         nbsp->addresses[j]);
+            continue;
+        }
+        pa->n_lsp_addrs++;
+    }
+
+    pa->ps_addrs = xmalloc(sizeof *pa->ps_addrs * nbsp->n_port_security);
+    for (size_t j = 0; j < nbsp->n_port_security; j++) {
+        if (!extract_lsp_addresses(nbsp->port_security[j],
+                                   &pa->ps_addrs[pa->n_ps_addrs])) {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+            VLOG_INFO_RL(&rl, "invalid syntax '%s' in port security. No MAC "
+                         "address found", nbsp->port_security[j]);
+            continue;
+        }
+        pa->n_ps_addrs++;
+    }
+}
+
+static void
+port_addresses_destroy(struct port_addresses *pa)
+{
+    for (unsigned int i = 0; i < pa->n_lsp_addrs; i++) {
+        destroy_lport_addresses(&pa->lsp_addrs[i]);
+    }
+    free(pa->lsp_addrs);
+    for (unsigned int i = 0; i < pa->n_ps_addrs; i++) {
+        destroy_lport_addresses(&pa->ps_addrs[i]);
+    }
+    free(pa->ps_addrs);
+    if (pa->has_lrp_networks) {
+        destroy_lport_addresses(&pa->lrp_networks);
+    }
+}
+
 static void
 join_logical_ports(struct northd_context *ctx,
                    struct hmap *datapaths, struct hmap *ports,
@@ -2191,18 +2490,44 @@ join_logical_ports(struct northd_context *ctx,
         ovs_list_push_back(sb_only, &op->list);
     }
 
+    /* Parsing the addresses of the ports is the expensive part and does not
+     * depend on the other ports, so do it in parallel first.  Looking up
+     * and creating the ports in 'ports' is done serially below. */
     struct ovn_datapath *od;
+    size_t n_port_addrs = 0;
+    HMAP_FOR_EACH (od, key_node, datapaths) {
+        n_port_addrs += od->nbs ? od->nbs->n_ports : od->nbr->n_ports;
+    }
+    struct port_addresses *port_addrs = xcalloc(n_port_addrs,
+                                                sizeof *port_addrs);
+    size_t n = 0;
+    HMAP_FOR_EACH (od, key_node, datapaths) {
+        if (od->nbs) {
+            for (size_t i = 0; i < od->nbs->n_ports; i++) {
+                port_addrs[n++].nbsp = od->nbs->ports[i];
+            }
+        } else {
+            for (size_t i = 0; i < od->nbr->n_ports; i++) {
+                port_addrs[n++].nbrp = od->nbr->ports[i];
+            }
+        }
+    }
+    parallel_run(n_port_addrs, parse_port_addresses, port_addrs);
+
+    n = 0;
     HMAP_FOR_EACH (od, key_node, datapaths) {
         if (od->nbs) {
             size_t n_allocated_localnet_ports = 0;
             for (size_t i = 0; i < od->nbs->n_ports; i++) {
                 const struct nbrec_logical_switch_port *nbsp
                     = od->nbs->ports[i];
+                struct port_addresses *pa = &port_addrs[n++];
                 struct ovn_port *op = ovn_port_find_bound(ports, nbsp->name);
                 if (op && (op->od || op->nbsp || op->nbrp)) {
                     static struct vlog_rate_limit rl
                         = VLOG_RATE_LIMIT_INIT(5, 1);
                     VLOG_WARN_RL(&rl, "duplicate logical port %s", nbsp->name);
+                    port_addresses_destroy(pa);
                     continue;
                 } else if (op && (!op->sb || op->sb->datapath == od->sb)) {
                     ovn_port_set_nb(op, nbsp, NULL);
@@ -2235,45 +2560,11 @@ join_logical_ports(struct northd_context *ctx,
                    od->localnet_ports[od->n_localnet_ports++] = op;
                 }
 
-                op->lsp_addrs
-                    = xmalloc(sizeof *op->lsp_addrs * nbsp->n_addresses);
-                for (size_t j = 0; j < nbsp->n_addresses; j++) {
-                    if (!strcmp(nbsp->addresses[j], "unknown")) {
-                        op->has_unknown = true;
-                        continue;
-                    }
-                    if (!strcmp(nbsp->addresses[j], "router")) {
-                        continue;
-                    }
-                    if (is_dynamic_lsp_address(nbsp->addresses[j])) {
-                        continue;
-                    } else if (!extract_lsp_addresses(nbsp->addresses[j],
-                                           &op->lsp_addrs[op->n_lsp_addrs])) {
-                        static struct vlog_rate_limit rl
-                            = VLOG_RATE_LIMIT_INIT(1, 1);
-                        VLOG_INFO_RL(&rl, "invalid syntax '%s' in logical "
-                                          "switch port addresses. No MAC "
-                                          "address found",
-                                          op->nbsp->addresses[j]);
-                        continue;
-                    }
-                    op->n_lsp_addrs++;
-                }
-
-                op->ps_addrs
-                    = xmalloc(sizeof *op->ps_addrs * nbsp->n_port_security);
-                for (size_t j = 0; j < nbsp->n_port_security; j++) {
-                    if (!extract_lsp_addresses(nbsp->port_security[j],
-                                               &op->ps_addrs[op->n_ps_addrs])) {
-                        static struct vlog_rate_limit rl
-                            = VLOG_RATE_LIMIT_INIT(1, 1);
-                        VLOG_INFO_RL(&rl, "invalid syntax '%s' in port "
-                                          "security. No MAC address found",
-                                          op->nbsp->port_security[j]);
-                        continue;
-                    }
-                    op->n_ps_addrs++;
-                }
+                op->lsp_addrs = pa->lsp_addrs;
+                op->n_lsp_addrs = pa->n_lsp_addrs;
+                op->ps_addrs = pa->ps_addrs;
+                op->n_ps_addrs = pa->n_ps_addrs;
+                op->has_unknown = pa->has_unknown;
 
                 op->od = od;
                 tag_alloc_add_existing_tags(tag_alloc_table, nbsp);
@@ -2282,15 +2573,17 @@ join_logical_ports(struct northd_context *ctx,
             for (size_t i = 0; i < od->nbr->n_ports; i++) {
                 const struct nbrec_logical_router_port *nbrp
                     = od->nbr->ports[i];
+                struct port_addresses *pa = &port_addrs[n++];
 
-                struct lport_addresses lrp_networks;
-                if (!extract_lrp_networks(nbrp, &lrp_networks)) {
+                if (!pa->has_lrp_networks) {
                     static struct vlog_rate_limit rl
                         = VLOG_RATE_LIMIT_INIT(5, 1);
                     VLOG_WARN_RL(&rl, "bad 'mac' %s", nbrp->mac);
                     continue;
                 }
 
+                struct lport_addresses lrp_networks = pa->lrp_networks;
+
                 if (!lrp_networks.n_ipv4_addrs && !lrp_networks.n_ipv6_addrs) {
                     continue;
                 }
@@ -2369,6 +2662,8 @@ join_logical_ports(struct northd_context *ctx,
         }
     }
 
+    free(port_addrs);
+
     /* Connect logical router ports, and logical switch ports of type "router",
      * to their peers. */
     struct ovn_port *op;
@@ -3391,6 +3686,117 @@ void build_lb_vip_actions(struct ovn_lb_vip *lb_vip,
     }
 }
 
+static const char *
+lb_lflow_protocol(const struct ovn_northd_lb *lb)
+{
+    const char *protocol = lb->nlb->protocol;
+
+    return (nullable_string_is_equal(protocol, "udp") ? "udp"
+            : nullable_string_is_equal(protocol, "sctp") ? "sctp"
+            : "tcp");
+}
+
+/* Formats the match and actions of the load balancing flows of each VIP of
+ * 'lb', for build_lb_rules() and build_lrouter_lb_flows().  They don't depend
+ * on the datapath, so this saves formatting them again for each logical
+ * switch and router of a load balancer that is applied to many of them. */
+static void
+build_lb_lflow_templates(struct ovn_northd_lb *lb)
+{
+    struct ds action = DS_EMPTY_INITIALIZER;
+    struct ds match = DS_EMPTY_INITIALIZER;
+    const char *proto = lb_lflow_protocol(lb);
+
+    for (size_t i = 0; i < lb->n_vips; i++) {
+        struct ovn_lb_vip *lb_vip = &lb->vips[i];
+        struct ovn_northd_lb_vip *lb_vip_nb = &lb->vips_nb[i];
+        const char *ip_match = (IN6_IS_ADDR_V4MAPPED(&lb_vip->vip)
+                                ? "ip4" : "ip6");
+
+        /* Logical switches.
+         *
+         * Store the original destination IP and port to be used when
+         * generating hairpin flows. */
+        ds_clear(&action);
+        ds_clear(&match);
+        if (IN6_IS_ADDR_V4MAPPED(&lb_vip->vip)) {
+            ds_put_format(&action, REG_ORIG_DIP_IPV4 " = %s; ",
+                          lb_vip->vip_str);
+        } else {
+            ds_put_format(&action, REG_ORIG_DIP_IPV6 " = %s; ",
+                          lb_vip->vip_str);
+        }
+        if (lb_vip->vip_port) {
+            ds_put_format(&action, REG_ORIG_TP_DPORT " = %"PRIu16"; ",
+                          lb_vip->vip_port);
+        }
+        build_lb_vip_actions(lb_vip, lb_vip_nb, &action,
+                             lb->selection_fields, true);
+
+        ds_put_format(&match, "ct.new && %s.dst == %s", ip_match,
+                      lb_vip->vip_str);
+        if (lb_vip->vip_port) {
+            ds_put_format(&match, " && %s.dst == %d", proto, lb_vip->vip_port);
+        }
+
+        free(lb_vip_nb->ls_lflow_match);
+        free(lb_vip_nb->ls_lflow_actions);
+        lb_vip_nb->ls_lflow_match = ds_steal_cstr(&match);
+        lb_vip_nb->ls_lflow_actions = ds_steal_cstr(&action);
+        lb_vip_nb->ls_lflow_priority = lb_vip->vip_port ? 120 : 110;
+
+        /* Logical routers. */
+        build_lb_vip_actions(lb_vip, lb_vip_nb, &action,
+                             lb->selection_fields, false);
+
+        ds_put_format(&match, "ip && %s.dst == %s", ip_match, lb_vip->vip_str);
+        if (lb_vip->vip_port) {
+            ds_put_format(&match, " && %s && %s.dst == %d", proto,
+                          proto, lb_vip->vip_port);
+        }
+
+        free(lb_vip_nb->lr_lflow_match);
+        free(lb_vip_nb->lr_lflow_actions);
+        lb_vip_nb->lr_lflow_match = ds_steal_cstr(&match);
+        lb_vip_nb->lr_lflow_actions = ds_steal_cstr(&action);
+        lb_vip_nb->lr_lflow_priority = lb_vip->vip_port ? 120 : 110;
+    }
+    ds_destroy(&action);
+    ds_destroy(&match);
+}
+
+/* Creates the southbound Load_Balancer record of 'lb' if it doesn't have one
+ * yet, and syncs its columns with the northbound one. */
+static void
+sync_lb_to_sb(struct northd_context *ctx, struct ovn_northd_lb *lb)
+{
+    /* Store the fact that northd provides the original (destination IP +
+     * transport port) tuple.
+     */
+    struct smap options;
+    smap_clone(&options, &lb->nlb->options);
+    smap_replace(&options, "hairpin_orig_tuple", "true");
+
+    if (!lb->slb) {
+        const struct sbrec_load_balancer *sbrec_lb
+            = sbrec_load_balancer_insert(ctx->ovnsb_txn);
+        lb->slb = sbrec_lb;
+        char *lb_id = xasprintf(UUID_FMT, UUID_ARGS(&lb->nlb->header_.uuid));
+        const struct smap external_ids =
+            SMAP_CONST1(&external_ids, "lb_id", lb_id);
+        sbrec_load_balancer_set_external_ids(sbrec_lb, &external_ids);
+        free(lb_id);
+    }
+    sbrec_load_balancer_set_name(lb->slb, lb->nlb->name);
+    sbrec_load_balancer_set_vips(lb->slb, &lb->nlb->vips);
+    sbrec_load_balancer_set_protocol(lb->slb, lb->nlb->protocol);
+    sbrec_load_balancer_set_options(lb->slb, &options);
+    sbrec_load_balancer_set_datapaths(
+        lb->slb, (struct sbrec_datapath_binding **)lb->dps,
+        lb->n_dps);
+    smap_destroy(&options);
+}
+
 static void
 build_ovn_lbs(struct northd_context *ctx, struct hmap *datapaths,
               struct hmap *ports, struct hmap *lbs)
@@ -3458,35 +3864,9 @@ build_ovn_lbs(struct northd_context *ctx, struct hmap *datapaths,
      * the SB load balancer columns. */
     HMAP_FOR_EACH (lb, hmap_node, lbs) {
 
-        if (!lb->n_dps) {
-            continue;
-        }
-
-        /* Store the fact that northd provides the original (destination IP +
-         * transport port) tuple.
-         */
-        struct smap options;
-        smap_clone(&options, &lb->nlb->options);
-        smap_replace(&options, "hairpin_orig_tuple", "true");
-
-        if (!lb->slb) {
-            sbrec_lb = sbrec_load_balancer_insert(ctx->ovnsb_txn);
-            lb->slb = sbrec_lb;
-            char *lb_id = xasprintf(
-                UUID_FMT, UUID_ARGS(&lb->nlb->header_.uuid));
-            const struct smap external_ids =
-                SMAP_CONST1(&external_ids, "lb_id", lb_id);
-            sbrec_load_balancer_set_external_ids(sbrec_lb, &external_ids);
-            free(lb_id);
+        if (lb->n_dps) {
+            sync_lb_to_sb(ctx, lb);
         }
-        sbrec_load_balancer_set_name(lb->slb, lb->nlb->name);
-        sbrec_load_balancer_set_vips(lb->slb, &lb->nlb->vips);
-        sbrec_load_balancer_set_protocol(lb->slb, lb->nlb->protocol);
-        sbrec_load_balancer_set_options(lb->slb, &options);
-        sbrec_load_balancer_set_datapaths(
-            lb->slb, (struct sbrec_datapath_binding **)lb->dps,
-            lb->n_dps);
-        smap_destroy(&options);
     }
 
     /* Set the list of associated load balanacers to a logical switch
@@ -3869,7 +4249,9 @@ ovn_igmp_group_add(struct northd_context *ctx, struct hmap *igmp_groups,
         } else {
             igmp_group->mcgroup.key = 0;
         }
-        igmp_group->mcgroup.name = address_s;
+        /* Owned, because the southbound record may be deleted without a
+         * recompute, see northd_sb_igmp_group_handler(). */
+        igmp_group->mcgroup.name = xstrdup(address_s);
         ovs_list_init(&igmp_group->entries);
 
         hmap_insert(igmp_groups, &igmp_group->hmap_node,
@@ -4004,6 +4386,7 @@ ovn_igmp_group_destroy(struct hmap *igmp_groups,
         }
         hmap_remove(igmp_groups, &igmp_group->hmap_node);
         ovs_list_remove(&igmp_group->list_node);
+        free(CONST_CAST(char *, igmp_group->mcgroup.name));
         free(igmp_group);
     }
 }
@@ -4018,36 +4401,142 @@ struct ovn_lflow {
     struct hmap_node hmap_node;
 
     struct ovn_datapath *od;     /* 'logical_datapath' in SB schema.  */
-    struct hmapx od_group;       /* Hash map of 'struct ovn_datapath *'. */
+
+    /* The datapaths that the flow applies to.  'dpg_bitmap', indexed by
+     * 'ovn_datapath->index', is only allocated once there is more than one,
+     * from the lflow arena. */
+    size_t n_ods;
+    struct ovn_datapath *od_first;
+    unsigned long *dpg_bitmap;
+    struct ovn_dp_group *dpg;    /* Group of 'dpg_bitmap', if any. */
+
     enum ovn_stage stage;
     uint16_t priority;
-    char *match;
-    char *actions;
-    char *stage_hint;
+    const char *match;           /* Interned, see lflow_intern(). */
+    const char *actions;         /* Interned, see lflow_intern(). */
+    const char *stage_hint;      /* Interned, see lflow_intern(). */
     const char *where;
+    bool shared;                 /* Can be combined with equal flows. */
 };
 
-static void ovn_lflow_destroy(struct hmap *lflows, struct ovn_lflow *lflow);
-static struct ovn_lflow * ovn_lflow_find_by_lflow(const struct hmap *,
-                                                  const struct ovn_lflow *,
-                                                  uint32_t hash);
-
+/* The logical flows built by build_lflows() and update_lswitch_acl_lflows(),
+ * along with their strings, are allocated from an arena and all released at
+ * once when these functions are done with them.
+ *
+ * Many flows have the same match, actions or stage hint, so the strings are
+ * interned: each one is stored only once per arena, with its hash.  This
+ * saves memory, makes equal strings from the same arena compare as equal
+ * pointers and avoids hashing a string once per flow.
+ *
+ * Each worker of the parallel build has its own arena, so that no locking is
+ * needed.  'lflow_arena' is the arena of the current thread. */
+struct lflow_arena {
+    struct arena arena;
+    struct hmap strings;         /* Contains "struct lflow_string"s. */
+};
+
+struct lflow_string {
+    struct hmap_node hmap_node;  /* In 'strings', hash_string(s, 0). */
+    char s[];
+};
+
+#define LFLOW_ARENA_INITIALIZER(LA) \
+    { ARENA_INITIALIZER, HMAP_INITIALIZER(&(LA)->strings) }
+
+static struct lflow_arena lflow_main_arena
+    = LFLOW_ARENA_INITIALIZER(&lflow_main_arena);
+static struct lflow_arena *lflow_worker_arenas;
+static size_t n_lflow_worker_arenas;
+DEFINE_STATIC_PER_THREAD_DATA(struct lflow_arena *, lflow_arena, NULL);
+
+static void
+lflow_arena_init(struct lflow_arena *la)
+{
+    arena_init(&la->arena);
+    hmap_init(&la->strings);
+}
+
+static void
+lflow_arena_clear(struct lflow_arena *la)
+{
+    hmap_clear(&la->strings);
+    arena_clear(&la->arena);
+}
+
+static void
+lflow_arenas_clear(void)
+{
+    lflow_arena_clear(&lflow_main_arena);
+    for (size_t i = 0; i < n_lflow_worker_arenas; i++) {
+        lflow_arena_clear(&lflow_worker_arenas[i]);
+    }
+}
+
+/* Returns the copy of 's' in 'la', adding one if there is none yet. */
+static const char *
+lflow_intern(struct lflow_arena *la, const char *s)
+{
+    uint32_t hash = hash_string(s, 0);
+    struct lflow_string *ls;
+
+    HMAP_FOR_EACH_WITH_HASH (ls, hmap_node, hash, &la->strings) {
+        if (!strcmp(ls->s, s)) {
+            return ls->s;
+        }
+    }
+
+    size_t len = strlen(s) + 1;
+    ls = arena_alloc(&la->arena, sizeof *ls + len);
+    memcpy(ls->s, s, len);
+    hmap_insert(&la->strings, &ls->hmap_node, hash);
+    return ls->s;
+}
+
+/* Returns the hash of 's', which must have been returned by
+ * lflow_intern(). */
+static uint32_t
+lflow_string_hash(const char *s)
+{
+    const struct lflow_string *ls = CONTAINER_OF(s, struct lflow_string, s);
+
+    return ls->hmap_node.hash;
+}
+
+/* Returns true if 'a' and 'b' are equal.  Strings interned in the same arena
+ * are equal only if they are the same pointer, but strings from different
+ * arenas or from the southbound database need a full comparison. */
+static bool
+lflow_string_equal(const char *a, const char *b)
+{
+    return a == b || !strcmp(a, b);
+}
+
+static void ovn_lflow_destroy(struct hmap *lflows, struct ovn_lflow *lflow);
+static struct ovn_lflow * ovn_lflow_find_by_lflow(const struct hmap *,
+                                                  const struct ovn_lflow *,
+                                                  uint32_t hash);
+
+/* Returns the hash of 'lflow', whose strings must be interned. */
 static uint32_t
 ovn_lflow_hash(const struct ovn_lflow *lflow)
 {
-    return ovn_logical_flow_hash(ovn_stage_get_table(lflow->stage),
-                                 ovn_stage_get_pipeline_name(lflow->stage),
-                                 lflow->priority, lflow->match,
-                                 lflow->actions);
+    return ovn_logical_flow_hash__(ovn_stage_get_table(lflow->stage),
+                                   ovn_stage_get_pipeline_name(lflow->stage),
+                                   lflow->priority,
+                                   lflow_string_hash(lflow->match),
+                                   lflow_string_hash(lflow->actions));
 }
 
-static char *
-ovn_lflow_hint(const struct ovsdb_idl_row *row)
+static const char *
+ovn_lflow_hint(struct lflow_arena *la, const struct ovsdb_idl_row *row)
 {
     if (!row) {
         return NULL;
     }
-    return xasprintf("%08x", row->uuid.parts[0]);
+
+    char hint[9];
+    snprintf(hint, sizeof hint, "%08x", row->uuid.parts[0]);
+    return lflow_intern(la, hint);
 }
 
 static bool
@@ -4056,54 +4545,116 @@ ovn_lflow_equal(const struct ovn_lflow *a, const struct ovn_lflow *b)
     return (a->od == b->od
             && a->stage == b->stage
             && a->priority == b->priority
-            && !strcmp(a->match, b->match)
-            && !strcmp(a->actions, b->actions));
+            && lflow_string_equal(a->match, b->match)
+            && lflow_string_equal(a->actions, b->actions));
 }
 
 static void
 ovn_lflow_init(struct ovn_lflow *lflow, struct ovn_datapath *od,
                enum ovn_stage stage, uint16_t priority,
-               char *match, char *actions, char *stage_hint,
-               const char *where)
+               const char *match, const char *actions,
+               const char *stage_hint, const char *where)
 {
-    hmapx_init(&lflow->od_group);
     lflow->od = od;
+    lflow->n_ods = 0;
+    lflow->od_first = NULL;
+    lflow->dpg_bitmap = NULL;
+    lflow->dpg = NULL;
     lflow->stage = stage;
     lflow->priority = priority;
     lflow->match = match;
     lflow->actions = actions;
     lflow->stage_hint = stage_hint;
     lflow->where = where;
+    lflow->shared = false;
 }
 
 /* If this option is 'true' northd will combine logical flows that differ by
  * logical datapath only by creating a datapath group. */
 static bool use_logical_dp_groups = false;
-static bool use_parallel_build = true;
 
-static struct hashrow_locks lflow_locks;
+static unsigned long *
+ovn_lflow_alloc_dpg_bitmap(struct lflow_arena *la, struct ovn_lflow *lflow)
+{
+    size_t n_bytes = bitmap_n_bytes(n_datapaths);
+
+    lflow->dpg_bitmap = memset(arena_alloc(&la->arena, n_bytes), 0, n_bytes);
+    bitmap_set1(lflow->dpg_bitmap, lflow->od_first->index);
+    return lflow->dpg_bitmap;
+}
+
+/* Adds 'od' to the datapaths of 'lflow'. */
+static void
+ovn_lflow_add_od(struct lflow_arena *la, struct ovn_lflow *lflow,
+                 struct ovn_datapath *od)
+{
+    if (!lflow->n_ods) {
+        lflow->od_first = od;
+        lflow->n_ods = 1;
+    } else if (od != lflow->od_first) {
+        unsigned long *bitmap = lflow->dpg_bitmap;
+
+        if (!bitmap) {
+            bitmap = ovn_lflow_alloc_dpg_bitmap(la, lflow);
+        }
+        if (!bitmap_is_set(bitmap, od->index)) {
+            bitmap_set1(bitmap, od->index);
+            lflow->n_ods++;
+        }
+    }
+}
+
+/* Adds all the datapaths of 'src' to those of 'dst'. */
+static void
+ovn_lflow_merge_ods(struct lflow_arena *la, struct ovn_lflow *dst,
+                    const struct ovn_lflow *src)
+{
+    if (!src->dpg_bitmap) {
+        ovn_lflow_add_od(la, dst, src->od_first);
+        return;
+    }
+
+    if (!dst->dpg_bitmap) {
+        ovn_lflow_alloc_dpg_bitmap(la, dst);
+    }
+    bitmap_or(dst->dpg_bitmap, src->dpg_bitmap, n_datapaths);
+    dst->n_ods = bitmap_count1(dst->dpg_bitmap, n_datapaths);
+}
+
+/* Makes the only datapath of 'lflow' its 'od'. */
+static void
+ovn_lflow_set_single_od(struct ovn_lflow *lflow)
+{
+    ovs_assert(lflow->n_ods == 1);
+    lflow->od = lflow->od_first;
+    lflow->n_ods = 0;
+    lflow->od_first = NULL;
+}
 
 /* Adds a row with the specified contents to the Logical_Flow table.
- * Version to use when locking is required.
- */
+ *
+ * With parallel build each worker adds flows to its own 'lflow_map', see
+ * merge_lflows_with_dp_groups() for how they are combined afterwards. */
 static void
 do_ovn_lflow_add(struct hmap *lflow_map, bool shared,
                  struct ovn_datapath *od,
                  uint32_t hash, struct ovn_lflow *lflow)
 {
 
+    struct lflow_arena *la = *lflow_arena_get();
     struct ovn_lflow *old_lflow;
 
+    lflow->shared = shared;
     if (shared && use_logical_dp_groups) {
         old_lflow = ovn_lflow_find_by_lflow(lflow_map, lflow, hash);
         if (old_lflow) {
             ovn_lflow_destroy(NULL, lflow);
-            hmapx_add(&old_lflow->od_group, od);
+            ovn_lflow_add_od(la, old_lflow, od);
             return;
         }
     }
 
-    hmapx_add(&lflow->od_group, od);
+    ovn_lflow_add_od(la, lflow, od);
     hmap_insert_fast(lflow_map, &lflow->hmap_node, hash);
 }
 
@@ -4116,26 +4667,21 @@ ovn_lflow_add_at(struct hmap *lflow_map, struct ovn_datapath *od,
 {
     ovs_assert(ovn_stage_to_datapath_type(stage) == ovn_datapath_get_type(od));
 
+    struct lflow_arena *la = *lflow_arena_get();
     struct ovn_lflow *lflow;
     uint32_t hash;
 
-    lflow = xmalloc(sizeof *lflow);
+    ovs_assert(la);
+    lflow = arena_alloc(&la->arena, sizeof *lflow);
     /* While adding new logical flows we're not setting single datapath, but
      * collecting a group.  'od' will be updated later for all flows with only
      * one datapath in a group, so it could be hashed correctly. */
     ovn_lflow_init(lflow, NULL, stage, priority,
-                   xstrdup(match), xstrdup(actions),
-                   ovn_lflow_hint(stage_hint), where);
+                   lflow_intern(la, match), lflow_intern(la, actions),
+                   ovn_lflow_hint(la, stage_hint), where);
 
     hash = ovn_lflow_hash(lflow);
-
-    if (use_logical_dp_groups && use_parallel_build) {
-        lock_hash_row(&lflow_locks, hash);
-        do_ovn_lflow_add(lflow_map, shared, od, hash, lflow);
-        unlock_hash_row(&lflow_locks, hash);
-    } else {
-        do_ovn_lflow_add(lflow_map, shared, od, hash, lflow);
-    }
+    do_ovn_lflow_add(lflow_map, shared, od, hash, lflow);
 }
 
 /* Adds a row with the specified contents to the Logical_Flow table. */
@@ -4173,13 +4719,13 @@ ovn_lflow_find(struct hmap *lflows, struct ovn_datapath *od,
                const char *match, const char *actions, uint32_t hash)
 {
     struct ovn_lflow target;
-    ovn_lflow_init(&target, od, stage, priority,
-                   CONST_CAST(char *, match), CONST_CAST(char *, actions),
-                   NULL, NULL);
+    ovn_lflow_init(&target, od, stage, priority, match, actions, NULL, NULL);
 
     return ovn_lflow_find_by_lflow(lflows, &target, hash);
 }
 
+/* Removes 'lflow' from 'lflows', if nonnull.  The memory of 'lflow' itself
+ * belongs to the lflow arena of the thread that added it. */
 static void
 ovn_lflow_destroy(struct hmap *lflows, struct ovn_lflow *lflow)
 {
@@ -4187,11 +4733,6 @@ ovn_lflow_destroy(struct hmap *lflows, struct ovn_lflow *lflow)
         if (lflows) {
             hmap_remove(lflows, &lflow->hmap_node);
         }
-        hmapx_destroy(&lflow->od_group);
-        free(lflow->match);
-        free(lflow->actions);
-        free(lflow->stage_hint);
-        free(lflow);
     }
 }
 
@@ -5484,11 +6025,81 @@ build_acl_log(struct ds *actions, const struct nbrec_acl *acl,
     ds_put_cstr(actions, "); ");
 }
 
+/* At most two logical flows are built for an ACL, see build_acl_lflows(). */
+#define ACL_MAX_LFLOWS 2
+
+struct acl_lflow {
+    enum ovn_stage stage;
+    uint16_t priority;
+    char *match;
+    char *actions;
+};
+
+/* The logical flows of an ACL only depend on the ACL, on its meter and on
+ * whether the logical switch has stateful ACLs.  They are formatted once for
+ * all the logical switches that use the ACL, directly or through port groups,
+ * and kept across runs until the ACL or its meter changes. */
+struct acl_lflows {
+    struct hmap_node hmap_node; /* In 'acl_lflows_cache', by ACL UUID. */
+    const struct nbrec_acl *acl;
+    unsigned int insert_seqno;  /* Seqnos of 'acl' when the flows were */
+    unsigned int modify_seqno;  /* built. */
+    bool fair_meter;            /* Whether the meter was a fair one. */
+    uint64_t generation;        /* Last refresh_acl_lflows_cache() that saw
+                                 * 'acl'. */
+
+    /* Indexed by whether the logical switch has stateful ACLs. */
+    struct acl_lflow flows[2][ACL_MAX_LFLOWS];
+    size_t n_flows[2];
+};
+
+static struct hmap acl_lflows_cache = HMAP_INITIALIZER(&acl_lflows_cache);
+static uint64_t acl_lflows_generation;
+
+static void
+acl_lflows_add(struct acl_lflows *al, bool has_stateful, enum ovn_stage stage,
+               uint16_t priority, const char *match, const char *actions)
+{
+    size_t *n_flows = &al->n_flows[has_stateful];
+    ovs_assert(*n_flows < ACL_MAX_LFLOWS);
+
+    struct acl_lflow *flow = &al->flows[has_stateful][(*n_flows)++];
+    flow->stage = stage;
+    flow->priority = priority;
+    flow->match = xstrdup(match);
+    flow->actions = xstrdup(actions);
+}
+
+static void
+acl_lflows_clear(struct acl_lflows *al)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(al->flows); i++) {
+        for (size_t j = 0; j < al->n_flows[i]; j++) {
+            free(al->flows[i][j].match);
+            free(al->flows[i][j].actions);
+        }
+        al->n_flows[i] = 0;
+    }
+}
+
+static struct acl_lflows *
+acl_lflows_find(const struct nbrec_acl *acl)
+{
+    struct acl_lflows *al;
+
+    HMAP_FOR_EACH_WITH_HASH (al, hmap_node, uuid_hash(&acl->header_.uuid),
+                             &acl_lflows_cache) {
+        if (uuid_equals(&al->acl->header_.uuid, &acl->header_.uuid)) {
+            return al;
+        }
+    }
+    return NULL;
+}
+
 static void
-build_reject_acl_rules(struct ovn_datapath *od, struct hmap *lflows,
-                       enum ovn_stage stage, struct nbrec_acl *acl,
+build_reject_acl_rules(struct acl_lflows *al, bool has_stateful,
+                       enum ovn_stage stage, const struct nbrec_acl *acl,
                        struct ds *extra_match, struct ds *extra_actions,
-                       const struct ovsdb_idl_row *stage_hint,
                        const struct shash *meter_groups)
 {
     struct ds match = DS_EMPTY_INITIALIZER;
@@ -5515,19 +6126,20 @@ build_reject_acl_rules(struct ovn_datapath *od, struct hmap *lflows,
                   "reject { "
                   "/* eth.dst <-> eth.src; ip.dst <-> ip.src; is implicit. */ "
                   "outport <-> inport; %s };", next_action);
-    ovn_lflow_add_with_hint(lflows, od, stage,
-                            acl->priority + OVN_ACL_PRI_OFFSET,
-                            ds_cstr(&match), ds_cstr(&actions), stage_hint);
+    acl_lflows_add(al, has_stateful, stage,
+                   acl->priority + OVN_ACL_PRI_OFFSET,
+                   ds_cstr(&match), ds_cstr(&actions));
 
     free(next_action);
     ds_destroy(&match);
     ds_destroy(&actions);
 }
 
+/* Builds the logical flows of 'acl' for a logical switch that has stateful
+ * ACLs or not, according to 'has_stateful', into 'al'. */
 static void
-consider_acl(struct hmap *lflows, struct ovn_datapath *od,
-             struct nbrec_acl *acl, bool has_stateful,
-             const struct shash *meter_groups)
+build_acl_lflows(struct acl_lflows *al, const struct nbrec_acl *acl,
+                 bool has_stateful, const struct shash *meter_groups)
 {
     bool ingress = !strcmp(acl->direction, "from-lport") ? true :false;
     enum ovn_stage stage = ingress ? S_SWITCH_IN_ACL : S_SWITCH_OUT_ACL;
@@ -5536,10 +6148,9 @@ consider_acl(struct hmap *lflows, struct ovn_datapath *od,
         struct ds actions = DS_EMPTY_INITIALIZER;
         build_acl_log(&actions, acl, meter_groups);
         ds_put_cstr(&actions, "next;");
-        ovn_lflow_add_with_hint(lflows, od, stage,
-                                acl->priority + OVN_ACL_PRI_OFFSET,
-                                acl->match, ds_cstr(&actions),
-                                &acl->header_);
+        acl_lflows_add(al, has_stateful, stage,
+                       acl->priority + OVN_ACL_PRI_OFFSET,
+                       acl->match, ds_cstr(&actions));
         ds_destroy(&actions);
     } else if (!strcmp(acl->action, "allow")
         || !strcmp(acl->action, "allow-related")) {
@@ -5552,10 +6163,9 @@ consider_acl(struct hmap *lflows, struct ovn_datapath *od,
             struct ds actions = DS_EMPTY_INITIALIZER;
             build_acl_log(&actions, acl, meter_groups);
             ds_put_cstr(&actions, "next;");
-            ovn_lflow_add_with_hint(lflows, od, stage,
-                                    acl->priority + OVN_ACL_PRI_OFFSET,
-                                    acl->match, ds_cstr(&actions),
-                                    &acl->header_);
+            acl_lflows_add(al, has_stateful, stage,
+                           acl->priority + OVN_ACL_PRI_OFFSET,
+                           acl->match, ds_cstr(&actions));
             ds_destroy(&actions);
         } else {
             struct ds match = DS_EMPTY_INITIALIZER;
@@ -5578,11 +6188,9 @@ consider_acl(struct hmap *lflows, struct ovn_datapath *od,
             ds_put_cstr(&actions, REGBIT_CONNTRACK_COMMIT" = 1; ");
             build_acl_log(&actions, acl, meter_groups);
             ds_put_cstr(&actions, "next;");
-            ovn_lflow_add_with_hint(lflows, od, stage,
-                                    acl->priority + OVN_ACL_PRI_OFFSET,
-                                    ds_cstr(&match),
-                                    ds_cstr(&actions),
-                                    &acl->header_);
+            acl_lflows_add(al, has_stateful, stage,
+                           acl->priority + OVN_ACL_PRI_OFFSET,
+                           ds_cstr(&match), ds_cstr(&actions));
 
             /* Match on traffic in the request direction for an established
              * connection tracking entry that has not been marked for
@@ -5597,10 +6205,9 @@ consider_acl(struct hmap *lflows, struct ovn_datapath *od,
 
             build_acl_log(&actions, acl, meter_groups);
             ds_put_cstr(&actions, "next;");
-            ovn_lflow_add_with_hint(lflows, od, stage,
-                                    acl->priority + OVN_ACL_PRI_OFFSET,
-                                    ds_cstr(&match), ds_cstr(&actions),
-                                    &acl->header_);
+            acl_lflows_add(al, has_stateful, stage,
+                           acl->priority + OVN_ACL_PRI_OFFSET,
+                           ds_cstr(&match), ds_cstr(&actions));
 
             ds_destroy(&match);
             ds_destroy(&actions);
@@ -5619,16 +6226,15 @@ consider_acl(struct hmap *lflows, struct ovn_datapath *od,
              * connection, then we can simply reject/drop it. */
             ds_put_cstr(&match, REGBIT_ACL_HINT_DROP " == 1");
             if (!strcmp(acl->action, "reject")) {
-                build_reject_acl_rules(od, lflows, stage, acl, &match,
-                                       &actions, &acl->header_, meter_groups);
+                build_reject_acl_rules(al, has_stateful, stage, acl, &match,
+                                       &actions, meter_groups);
             } else {
                 ds_put_format(&match, " && (%s)", acl->match);
                 build_acl_log(&actions, acl, meter_groups);
                 ds_put_cstr(&actions, "/* drop */");
-                ovn_lflow_add_with_hint(lflows, od, stage,
-                                        acl->priority + OVN_ACL_PRI_OFFSET,
-                                        ds_cstr(&match), ds_cstr(&actions),
-                                        &acl->header_);
+                acl_lflows_add(al, has_stateful, stage,
+                               acl->priority + OVN_ACL_PRI_OFFSET,
+                               ds_cstr(&match), ds_cstr(&actions));
             }
             /* For an existing connection without ct_label set, we've
              * encountered a policy change. ACLs previously allowed
@@ -5646,31 +6252,29 @@ consider_acl(struct hmap *lflows, struct ovn_datapath *od,
             ds_put_cstr(&match, REGBIT_ACL_HINT_BLOCK " == 1");
             ds_put_cstr(&actions, "ct_commit { ct_label.blocked = 1; }; ");
             if (!strcmp(acl->action, "reject")) {
-                build_reject_acl_rules(od, lflows, stage, acl, &match,
-                                       &actions, &acl->header_, meter_groups);
+                build_reject_acl_rules(al, has_stateful, stage, acl, &match,
+                                       &actions, meter_groups);
             } else {
                 ds_put_format(&match, " && (%s)", acl->match);
                 build_acl_log(&actions, acl, meter_groups);
                 ds_put_cstr(&actions, "/* drop */");
-                ovn_lflow_add_with_hint(lflows, od, stage,
-                                        acl->priority + OVN_ACL_PRI_OFFSET,
-                                        ds_cstr(&match), ds_cstr(&actions),
-                                        &acl->header_);
+                acl_lflows_add(al, has_stateful, stage,
+                               acl->priority + OVN_ACL_PRI_OFFSET,
+                               ds_cstr(&match), ds_cstr(&actions));
             }
         } else {
             /* There are no stateful ACLs in use on this datapath,
              * so a "reject/drop" ACL is simply the "reject/drop"
              * logical flow action in all cases. */
             if (!strcmp(acl->action, "reject")) {
-                build_reject_acl_rules(od, lflows, stage, acl, &match,
-                                       &actions, &acl->header_, meter_groups);
+                build_reject_acl_rules(al, has_stateful, stage, acl, &match,
+                                       &actions, meter_groups);
             } else {
                 build_acl_log(&actions, acl, meter_groups);
                 ds_put_cstr(&actions, "/* drop */");
-                ovn_lflow_add_with_hint(lflows, od, stage,
-                                        acl->priority + OVN_ACL_PRI_OFFSET,
-                                        acl->match, ds_cstr(&actions),
-                                        &acl->header_);
+                acl_lflows_add(al, has_stateful, stage,
+                               acl->priority + OVN_ACL_PRI_OFFSET,
+                               acl->match, ds_cstr(&actions));
             }
         }
         ds_destroy(&match);
@@ -5678,6 +6282,85 @@ consider_acl(struct hmap *lflows, struct ovn_datapath *od,
     }
 }
 
+/* Updates 'acl_lflows_cache' for the current northbound contents, rebuilding
+ * the flows of the ACLs that changed or whose meter changed from or to a fair
+ * one, and dropping the deleted ACLs.  This runs before building the logical
+ * flows, possibly in parallel, so that consider_acl() only reads the cache. */
+static void
+refresh_acl_lflows_cache(struct northd_context *ctx,
+                         const struct shash *meter_groups)
+{
+    uint64_t generation = ++acl_lflows_generation;
+
+    const struct nbrec_acl *acl;
+    NBREC_ACL_FOR_EACH (acl, ctx->ovnnb_idl) {
+        unsigned int insert_seqno
+            = nbrec_acl_row_get_seqno(acl, OVSDB_IDL_CHANGE_INSERT);
+        unsigned int modify_seqno
+            = nbrec_acl_row_get_seqno(acl, OVSDB_IDL_CHANGE_MODIFY);
+        bool fair_meter = (acl->log && acl->meter
+                           && fair_meter_lookup_by_name(meter_groups,
+                                                        acl->meter));
+
+        struct acl_lflows *al = acl_lflows_find(acl);
+        if (!al) {
+            al = xzalloc(sizeof *al);
+            hmap_insert(&acl_lflows_cache, &al->hmap_node,
+                        uuid_hash(&acl->header_.uuid));
+        } else if (al->acl == acl
+                   && al->insert_seqno == insert_seqno
+                   && al->modify_seqno == modify_seqno
+                   && al->fair_meter == fair_meter) {
+            al->generation = generation;
+            continue;
+        }
+
+        acl_lflows_clear(al);
+        al->acl = acl;
+        al->insert_seqno = insert_seqno;
+        al->modify_seqno = modify_seqno;
+        al->fair_meter = fair_meter;
+        al->generation = generation;
+        build_acl_lflows(al, acl, false, meter_groups);
+        build_acl_lflows(al, acl, true, meter_groups);
+    }
+
+    struct acl_lflows *al, *next_al;
+    HMAP_FOR_EACH_SAFE (al, next_al, hmap_node, &acl_lflows_cache) {
+        if (al->generation != generation) {
+            hmap_remove(&acl_lflows_cache, &al->hmap_node);
+            acl_lflows_clear(al);
+            free(al);
+        }
+    }
+}
+
+static void
+destroy_acl_lflows_cache(void)
+{
+    struct acl_lflows *al;
+    HMAP_FOR_EACH_POP (al, hmap_node, &acl_lflows_cache) {
+        acl_lflows_clear(al);
+        free(al);
+    }
+    hmap_destroy(&acl_lflows_cache);
+}
+
+static void
+consider_acl(struct hmap *lflows, struct ovn_datapath *od,
+             const struct nbrec_acl *acl, bool has_stateful)
+{
+    const struct acl_lflows *al = acl_lflows_find(acl);
+
+    ovs_assert(al && al->acl == acl);
+    for (size_t i = 0; i < al->n_flows[has_stateful]; i++) {
+        const struct acl_lflow *flow = &al->flows[has_stateful][i];
+
+        ovn_lflow_add_with_hint(lflows, od, flow->stage, flow->priority,
+                                flow->match, flow->actions, &acl->header_);
+    }
+}
+
 static struct ovn_port_group *
 ovn_port_group_create(struct hmap *pgs,
                       const struct nbrec_port_group *nb_pg)
@@ -5705,6 +6388,19 @@ ovn_port_group_destroy(struct hmap *pgs, struct ovn_port_group *pg)
     }
 }
 
+static struct ovn_port_group *
+ovn_port_group_find(const struct hmap *pgs, const struct uuid *uuid)
+{
+    struct ovn_port_group *pg;
+
+    HMAP_FOR_EACH_WITH_HASH (pg, key_node, uuid_hash(uuid), pgs) {
+        if (uuid_equals(uuid, &pg->key)) {
+            return pg;
+        }
+    }
+    return NULL;
+}
+
 static void
 build_port_group_lswitches(struct northd_context *ctx, struct hmap *pgs,
                            struct hmap *ports)
@@ -5745,7 +6441,7 @@ build_port_group_lswitches(struct northd_context *ctx, struct hmap *pgs,
 
 static void
 build_acls(struct ovn_datapath *od, struct hmap *lflows,
-           struct hmap *port_groups, const struct shash *meter_groups)
+           struct hmap *port_groups)
 {
     bool has_stateful = od->has_stateful_acl || od->has_lb_vip;
 
@@ -5860,14 +6556,13 @@ build_acls(struct ovn_datapath *od, struct hmap *lflows,
     /* Ingress or Egress ACL Table (Various priorities). */
     for (size_t i = 0; i < od->nbs->n_acls; i++) {
         struct nbrec_acl *acl = od->nbs->acls[i];
-        consider_acl(lflows, od, acl, has_stateful, meter_groups);
+        consider_acl(lflows, od, acl, has_stateful);
     }
     struct ovn_port_group *pg;
     HMAP_FOR_EACH (pg, key_node, port_groups) {
         if (ovn_port_group_ls_find(pg, &od->nbs->header_.uuid)) {
             for (size_t i = 0; i < pg->nb_pg->n_acls; i++) {
-                consider_acl(lflows, od, pg->nb_pg->acls[i], has_stateful,
-                             meter_groups);
+                consider_acl(lflows, od, pg->nb_pg->acls[i], has_stateful);
             }
         }
     }
@@ -6019,67 +6714,16 @@ static void
 build_lb_rules(struct ovn_datapath *od, struct hmap *lflows,
                struct ovn_northd_lb *lb)
 {
-    struct ds action = DS_EMPTY_INITIALIZER;
-    struct ds match = DS_EMPTY_INITIALIZER;
-
     for (size_t i = 0; i < lb->n_vips; i++) {
-        struct ovn_lb_vip *lb_vip = &lb->vips[i];
         struct ovn_northd_lb_vip *lb_vip_nb = &lb->vips_nb[i];
-        const char *ip_match = NULL;
-
-        ds_clear(&action);
-        ds_clear(&match);
-
-        /* Store the original destination IP to be used when generating
-         * hairpin flows.
-         */
-        if (IN6_IS_ADDR_V4MAPPED(&lb_vip->vip)) {
-            ip_match = "ip4";
-            ds_put_format(&action, REG_ORIG_DIP_IPV4 " = %s; ",
-                          lb_vip->vip_str);
-        } else {
-            ip_match = "ip6";
-            ds_put_format(&action, REG_ORIG_DIP_IPV6 " = %s; ",
-                          lb_vip->vip_str);
-        }
-
-        const char *proto = NULL;
-        if (lb_vip->vip_port) {
-            proto = "tcp";
-            if (lb->nlb->protocol) {
-                if (!strcmp(lb->nlb->protocol, "udp")) {
-                    proto = "udp";
-                } else if (!strcmp(lb->nlb->protocol, "sctp")) {
-                    proto = "sctp";
-                }
-            }
-
-            /* Store the original destination port to be used when generating
-             * hairpin flows.
-             */
-            ds_put_format(&action, REG_ORIG_TP_DPORT " = %"PRIu16"; ",
-                          lb_vip->vip_port);
-        }
 
         /* New connections in Ingress table. */
-        build_lb_vip_actions(lb_vip, lb_vip_nb, &action,
-                             lb->selection_fields, true);
-
-        ds_put_format(&match, "ct.new && %s.dst == %s", ip_match,
-                      lb_vip->vip_str);
-        if (lb_vip->vip_port) {
-            ds_put_format(&match, " && %s.dst == %d", proto, lb_vip->vip_port);
-            ovn_lflow_add_with_hint(lflows, od, S_SWITCH_IN_STATEFUL, 120,
-                                    ds_cstr(&match), ds_cstr(&action),
-                                    &lb->nlb->header_);
-        } else {
-            ovn_lflow_add_with_hint(lflows, od, S_SWITCH_IN_STATEFUL, 110,
-                                    ds_cstr(&match), ds_cstr(&action),
-                                    &lb->nlb->header_);
-        }
+        ovn_lflow_add_with_hint(lflows, od, S_SWITCH_IN_STATEFUL,
+                                lb_vip_nb->ls_lflow_priority,
+                                lb_vip_nb->ls_lflow_match,
+                                lb_vip_nb->ls_lflow_actions,
+                                &lb->nlb->header_);
     }
-    ds_destroy(&action);
-    ds_destroy(&match);
 }
 
 static void
@@ -6239,65 +6883,52 @@ build_fwd_group_lflows(struct ovn_datapath *od, struct hmap *lflows)
     }
 }
 
+/* The datapaths connected to the ports of a logical router, see
+ * build_lrouter_groups(). */
+struct lrouter_peers {
+    struct ovn_datapath *od;
+    size_t *peers;              /* 'index'es of the peer datapaths. */
+    size_t n_peers;
+};
+
+struct lrouter_peers_job {
+    const struct hmap *ports;
+    struct lrouter_peers *routers;
+};
+
 static void
-build_lrouter_groups__(struct hmap *ports, struct ovn_datapath *od)
+find_lrouter_peers(size_t index, void *job_)
 {
-    ovs_assert((od && od->nbr && od->lr_group));
-
-    if (od->l3dgw_port && od->l3redirect_port) {
-        /* It's a logical router with gateway port. If it
-         * has HA_Chassis_Group associated to it in SB DB, then store the
-         * ha chassis group name. */
-        if (od->l3redirect_port->sb->ha_chassis_group) {
-            sset_add(&od->lr_group->ha_chassis_groups,
-                     od->l3redirect_port->sb->ha_chassis_group->name);
-        }
-    }
+    struct lrouter_peers_job *job = job_;
+    struct lrouter_peers *lr = &job->routers[index];
+    const struct nbrec_logical_router *nbr = lr->od->nbr;
 
-    for (size_t i = 0; i < od->nbr->n_ports; i++) {
-        struct ovn_port *router_port =
-            ovn_port_find(ports, od->nbr->ports[i]->name);
+    lr->peers = xmalloc(nbr->n_ports * sizeof *lr->peers);
+    lr->n_peers = 0;
+    for (size_t i = 0; i < nbr->n_ports; i++) {
+        const struct ovn_port *router_port =
+            ovn_port_find(job->ports, nbr->ports[i]->name);
 
-        if (!router_port || !router_port->peer) {
-            continue;
+        /* The peer is either a logical router port or a logical switch port
+         * of type "router".  The logical routers connected to the logical
+         * switch are connected together through it. */
+        if (router_port && router_port->peer) {
+            lr->peers[lr->n_peers++] = router_port->peer->od->index;
         }
+    }
+}
 
-        /* Get the peer logical switch/logical router datapath. */
-        struct ovn_datapath *peer_dp = router_port->peer->od;
-        if (peer_dp->nbr) {
-            if (!peer_dp->lr_group) {
-                peer_dp->lr_group = od->lr_group;
-                od->lr_group->router_dps[od->lr_group->n_router_dps++]
-                    = peer_dp;
-                build_lrouter_groups__(ports, peer_dp);
-            }
-        } else {
-            for (size_t j = 0; j < peer_dp->n_router_ports; j++) {
-                if (!peer_dp->router_ports[j]->peer) {
-                    /* If there is no peer port connecting to the
-                    * router port, ignore it. */
-                    continue;
-                }
-
-                struct ovn_datapath *router_dp;
-                router_dp = peer_dp->router_ports[j]->peer->od;
-                if (router_dp == od) {
-                    continue;
-                }
-
-                if (router_dp->lr_group == od->lr_group) {
-                    /* 'router_dp' and 'od' already belong to the same
-                    * lrouter group. Nothing to be done. */
-                    continue;
-                }
-
-                router_dp->lr_group = od->lr_group;
-                od->lr_group->router_dps[od->lr_group->n_router_dps++]
-                    = router_dp;
-                build_lrouter_groups__(ports, router_dp);
-            }
-        }
+/* Returns the root of the set of datapath 'i' in the union-find forest
+ * 'parents'. */
+static size_t
+lrouter_group_find(size_t *parents, size_t i)
+{
+    while (parents[i] != i) {
+        /* Path halving. */
+        parents[i] = parents[parents[i]];
+        i = parents[i];
     }
+    return i;
 }
 
 /* Adds each logical router into a logical router group. All the
@@ -6320,25 +6951,76 @@ build_lrouter_groups__(struct hmap *ports, struct ovn_datapath *od)
  * Group 3 -> lr5
  *
  * Each logical router can belong to only one group.
+ *
+ * The groups are the connected components of the graph of the datapaths
+ * and their peer ports, found with a union-find over the datapaths.  The
+ * peers of the logical routers are looked up in parallel.
  */
 static void
 build_lrouter_groups(struct hmap *ports, struct ovs_list *lr_list)
 {
+    size_t n_routers = ovs_list_size(lr_list);
+    struct lrouter_peers *routers = xmalloc(n_routers * sizeof *routers);
     struct ovn_datapath *od;
-    size_t n_router_dps = ovs_list_size(lr_list);
+    size_t n = 0;
 
     LIST_FOR_EACH (od, lr_list, lr_list) {
-        if (!od->lr_group) {
-            od->lr_group = xzalloc(sizeof *od->lr_group);
-            /* Each logical router group can have max
-             * 'n_router_dps'. So allocate enough memory. */
-            od->lr_group->router_dps = xcalloc(sizeof *od, n_router_dps);
-            od->lr_group->router_dps[0] = od;
-            od->lr_group->n_router_dps = 1;
-            sset_init(&od->lr_group->ha_chassis_groups);
-            build_lrouter_groups__(ports, od);
+        routers[n++].od = od;
+    }
+    struct lrouter_peers_job job = { .ports = ports, .routers = routers };
+    parallel_run(n_routers, find_lrouter_peers, &job);
+
+    size_t *parents = xmalloc(n_datapaths * sizeof *parents);
+    for (size_t i = 0; i < n_datapaths; i++) {
+        parents[i] = i;
+    }
+    for (size_t i = 0; i < n_routers; i++) {
+        size_t a = lrouter_group_find(parents, routers[i].od->index);
+        for (size_t j = 0; j < routers[i].n_peers; j++) {
+            size_t b = lrouter_group_find(parents, routers[i].peers[j]);
+            if (a != b) {
+                parents[b] = a;
+            }
+        }
+        free(routers[i].peers);
+    }
+
+    /* Size the groups by their number of routers, indexed by the root of
+     * their set. */
+    struct lrouter_group **groups = xcalloc(n_datapaths, sizeof *groups);
+    size_t *n_group_dps = xcalloc(n_datapaths, sizeof *n_group_dps);
+    for (size_t i = 0; i < n_routers; i++) {
+        n_group_dps[lrouter_group_find(parents, routers[i].od->index)]++;
+    }
+
+    for (size_t i = 0; i < n_routers; i++) {
+        od = routers[i].od;
+        size_t root = lrouter_group_find(parents, od->index);
+        struct lrouter_group *lr_group = groups[root];
+        if (!lr_group) {
+            lr_group = groups[root] = xzalloc(sizeof *lr_group);
+            lr_group->router_dps = xcalloc(n_group_dps[root],
+                                           sizeof *lr_group->router_dps);
+            sset_init(&lr_group->ha_chassis_groups);
+        }
+        lr_group->router_dps[lr_group->n_router_dps++] = od;
+        od->lr_group = lr_group;
+
+        if (od->l3dgw_port && od->l3redirect_port) {
+            /* It's a logical router with gateway port. If it
+             * has HA_Chassis_Group associated to it in SB DB, then store the
+             * ha chassis group name. */
+            if (od->l3redirect_port->sb->ha_chassis_group) {
+                sset_add(&lr_group->ha_chassis_groups,
+                         od->l3redirect_port->sb->ha_chassis_group->name);
+            }
         }
     }
+
+    free(n_group_dps);
+    free(groups);
+    free(parents);
+    free(routers);
 }
 
 /* Returns 'true' if the IPv4 'addr' is on the same subnet with one of the
@@ -6889,7 +7571,7 @@ build_lswitch_lflows_pre_acl_and_acl(struct ovn_datapath *od,
         build_pre_lb(od, lflows, meter_groups, lbs);
         build_pre_stateful(od, lflows);
         build_acl_hints(od, lflows);
-        build_acls(od, lflows, port_groups, meter_groups);
+        build_acls(od, lflows, port_groups);
         build_qos(od, lflows);
         build_stateful(od, lflows, lbs);
         build_lb_hairpin(od, lflows);
@@ -6943,34 +7625,154 @@ build_lswitch_arp_nd_responder_skip_local(struct ovn_port *op,
 
 /* Ingress table 13: ARP/ND responder, reply for known IPs.
  * (priority 50). */
+/* Adds the ND reply flow for the 'j'th IPv6 address of 'laddrs', owned by
+ * 'op'. */
 static void
-build_lswitch_arp_nd_responder_known_ips(struct ovn_port *op,
-                                         struct hmap *lflows,
-                                         struct hmap *ports,
-                                         struct ds *actions,
-                                         struct ds *match)
+build_lswitch_nd_reply_flow(struct ovn_port *op,
+                            const struct lport_addresses *laddrs, size_t j,
+                            struct hmap *lflows, struct ds *actions,
+                            struct ds *match)
 {
-    if (op->nbsp) {
-        if (!strcmp(op->nbsp->type, "virtual")) {
-            /* Handle
-             *  - GARPs for virtual ip which belongs to a logical port
-             *    of type 'virtual' and bind that port.
-             *
-             *  - ARP reply from the virtual ip which belongs to a logical
-             *    port of type 'virtual' and bind that port.
-             * */
-            ovs_be32 ip;
-            const char *virtual_ip = smap_get(&op->nbsp->options,
-                                              "virtual-ip");
-            const char *virtual_parents = smap_get(&op->nbsp->options,
-                                                   "virtual-parents");
-            if (!virtual_ip || !virtual_parents ||
-                !ip_parse(virtual_ip, &ip)) {
-                return;
-            }
+    ds_clear(match);
+    ds_put_format(match,
+                  "nd_ns && ip6.dst == {%s, %s} && nd.target == %s",
+                  laddrs->ipv6_addrs[j].addr_s,
+                  laddrs->ipv6_addrs[j].sn_addr_s,
+                  laddrs->ipv6_addrs[j].addr_s);
 
-            char *tokstr = xstrdup(virtual_parents);
-            char *save_ptr = NULL;
+    ds_clear(actions);
+    ds_put_format(actions,
+                  "%s { "
+                  "eth.src = %s; "
+                  "ip6.src = %s; "
+                  "nd.target = %s; "
+                  "nd.tll = %s; "
+                  "outport = inport; "
+                  "flags.loopback = 1; "
+                  "output; "
+                  "};",
+                  lsp_is_router(op->nbsp) ? "nd_na_router" : "nd_na",
+                  laddrs->ea_s,
+                  laddrs->ipv6_addrs[j].addr_s,
+                  laddrs->ipv6_addrs[j].addr_s,
+                  laddrs->ea_s);
+    ovn_lflow_add_with_hint(lflows, op->od, S_SWITCH_IN_ARP_ND_RSP, 50,
+                            ds_cstr(match), ds_cstr(actions),
+                            &op->nbsp->header_);
+}
+
+/* Same as the ARP/ND responder flows that
+ * build_lswitch_arp_nd_responder_known_ips() adds for the addresses of
+ * 'laddrs', with fewer flows:
+ *
+ *  - A single ARP reply flow matches all the IPv4 addresses.  It swaps
+ *    arp.spa and arp.tpa, which sets arp.spa to the requested address.
+ *
+ *  - A single flow for each address family doesn't reply to the requests
+ *    from 'op' itself.
+ *
+ * ND replies set the requested address in ip6.src and nd.target, so they
+ * still take a flow for each IPv6 address. */
+static void
+build_lswitch_arp_nd_responder_compact(struct ovn_port *op,
+                                       const struct lport_addresses *laddrs,
+                                       struct hmap *lflows,
+                                       struct ds *actions, struct ds *match)
+{
+    if (laddrs->n_ipv4_addrs) {
+        ds_clear(match);
+        ds_put_cstr(match, "arp.tpa == ");
+        if (laddrs->n_ipv4_addrs > 1) {
+            ds_put_char(match, '{');
+        }
+        for (size_t j = 0; j < laddrs->n_ipv4_addrs; j++) {
+            ds_put_format(match, "%s%s", j ? ", " : "",
+                          laddrs->ipv4_addrs[j].addr_s);
+        }
+        if (laddrs->n_ipv4_addrs > 1) {
+            ds_put_char(match, '}');
+        }
+        ds_put_cstr(match, " && arp.op == 1");
+
+        ds_clear(actions);
+        ds_put_format(actions,
+                      "eth.dst = eth.src; "
+                      "eth.src = %s; "
+                      "arp.op = 2; /* ARP reply */ "
+                      "arp.tha = arp.sha; "
+                      "arp.sha = %s; "
+                      "arp.tpa <-> arp.spa; "
+                      "outport = inport; "
+                      "flags.loopback = 1; "
+                      "output;",
+                      laddrs->ea_s, laddrs->ea_s);
+        ovn_lflow_add_with_hint(lflows, op->od, S_SWITCH_IN_ARP_ND_RSP, 50,
+                                ds_cstr(match), ds_cstr(actions),
+                                &op->nbsp->header_);
+
+        ds_put_format(match, " && inport == %s", op->json_key);
+        ovn_lflow_add_with_hint(lflows, op->od, S_SWITCH_IN_ARP_ND_RSP, 100,
+                                ds_cstr(match), "next;",
+                                &op->nbsp->header_);
+    }
+
+    if (laddrs->n_ipv6_addrs) {
+        for (size_t j = 0; j < laddrs->n_ipv6_addrs; j++) {
+            build_lswitch_nd_reply_flow(op, laddrs, j, lflows, actions,
+                                        match);
+        }
+
+        /* A solicitation from 'op' for one of its addresses isn't answered
+         * by any of the flows above if its destination isn't the address or
+         * its solicited-node multicast address, so there is no need to
+         * match on it. */
+        ds_clear(match);
+        ds_put_cstr(match, "nd_ns && nd.target == ");
+        if (laddrs->n_ipv6_addrs > 1) {
+            ds_put_char(match, '{');
+        }
+        for (size_t j = 0; j < laddrs->n_ipv6_addrs; j++) {
+            ds_put_format(match, "%s%s", j ? ", " : "",
+                          laddrs->ipv6_addrs[j].addr_s);
+        }
+        if (laddrs->n_ipv6_addrs > 1) {
+            ds_put_char(match, '}');
+        }
+        ds_put_format(match, " && inport == %s", op->json_key);
+        ovn_lflow_add_with_hint(lflows, op->od, S_SWITCH_IN_ARP_ND_RSP, 100,
+                                ds_cstr(match), "next;",
+                                &op->nbsp->header_);
+    }
+}
+
+static void
+build_lswitch_arp_nd_responder_known_ips(struct ovn_port *op,
+                                         struct hmap *lflows,
+                                         struct hmap *ports,
+                                         struct ds *actions,
+                                         struct ds *match)
+{
+    if (op->nbsp) {
+        if (!strcmp(op->nbsp->type, "virtual")) {
+            /* Handle
+             *  - GARPs for virtual ip which belongs to a logical port
+             *    of type 'virtual' and bind that port.
+             *
+             *  - ARP reply from the virtual ip which belongs to a logical
+             *    port of type 'virtual' and bind that port.
+             * */
+            ovs_be32 ip;
+            const char *virtual_ip = smap_get(&op->nbsp->options,
+                                              "virtual-ip");
+            const char *virtual_parents = smap_get(&op->nbsp->options,
+                                                   "virtual-parents");
+            if (!virtual_ip || !virtual_parents ||
+                !ip_parse(virtual_ip, &ip)) {
+                return;
+            }
+
+            char *tokstr = xstrdup(virtual_parents);
+            char *save_ptr = NULL;
             char *vparent;
             for (vparent = strtok_r(tokstr, ",", &save_ptr); vparent != NULL;
                  vparent = strtok_r(NULL, ",", &save_ptr)) {
@@ -7018,6 +7820,12 @@ build_lswitch_arp_nd_responder_known_ips(struct ovn_port *op,
             }
 
             for (size_t i = 0; i < op->n_lsp_addrs; i++) {
+                if (compact_arp_nd_responder) {
+                    build_lswitch_arp_nd_responder_compact(
+                        op, &op->lsp_addrs[i], lflows, actions, match);
+                    continue;
+                }
+
                 for (size_t j = 0; j < op->lsp_addrs[i].n_ipv4_addrs; j++) {
                     ds_clear(match);
                     ds_put_format(match, "arp.tpa == %s && arp.op == 1",
@@ -7065,34 +7873,8 @@ build_lswitch_arp_nd_responder_known_ips(struct ovn_port *op,
                  * unicast IPv6 address and its all-nodes multicast address,
                  * but always respond with the unicast IPv6 address. */
                 for (size_t j = 0; j < op->lsp_addrs[i].n_ipv6_addrs; j++) {
-                    ds_clear(match);
-                    ds_put_format(match,
-                            "nd_ns && ip6.dst == {%s, %s} && nd.target == %s",
-                            op->lsp_addrs[i].ipv6_addrs[j].addr_s,
-                            op->lsp_addrs[i].ipv6_addrs[j].sn_addr_s,
-                            op->lsp_addrs[i].ipv6_addrs[j].addr_s);
-
-                    ds_clear(actions);
-                    ds_put_format(actions,
-                            "%s { "
-                            "eth.src = %s; "
-                            "ip6.src = %s; "
-                            "nd.target = %s; "
-                            "nd.tll = %s; "
-                            "outport = inport; "
-                            "flags.loopback = 1; "
-                            "output; "
-                            "};",
-                            lsp_is_router(op->nbsp) ? "nd_na_router" : "nd_na",
-                            op->lsp_addrs[i].ea_s,
-                            op->lsp_addrs[i].ipv6_addrs[j].addr_s,
-                            op->lsp_addrs[i].ipv6_addrs[j].addr_s,
-                            op->lsp_addrs[i].ea_s);
-                    ovn_lflow_add_with_hint(lflows, op->od,
-                                            S_SWITCH_IN_ARP_ND_RSP, 50,
-                                            ds_cstr(match),
-                                            ds_cstr(actions),
-                                            &op->nbsp->header_);
+                    build_lswitch_nd_reply_flow(op, &op->lsp_addrs[i], j,
+                                                lflows, actions, match);
 
                     /* Do not reply to a solicitation from the port that owns
                      * the address (otherwise DAD detection will fail). */
@@ -7442,13 +8224,10 @@ build_lswitch_ip_mcast_igmp_mld(struct ovn_igmp_group *igmp_group,
     }
 }
 
-static struct ovs_mutex mcgroup_mutex = OVS_MUTEX_INITIALIZER;
-
 /* Ingress table 19: Destination lookup, unicast handling (priority 50), */
 static void
 build_lswitch_ip_unicast_lookup(struct ovn_port *op,
                                 struct hmap *lflows,
-                                struct hmap *mcgroups,
                                 struct ds *actions,
                                 struct ds *match)
 {
@@ -7481,12 +8260,9 @@ build_lswitch_ip_unicast_lookup(struct ovn_port *op,
                                         ds_cstr(actions),
                                         &op->nbsp->header_);
             } else if (!strcmp(op->nbsp->addresses[i], "unknown")) {
-                if (lsp_is_enabled(op->nbsp)) {
-                    ovs_mutex_lock(&mcgroup_mutex);
-                    ovn_multicast_add(mcgroups, &mc_unknown, op);
-                    ovs_mutex_unlock(&mcgroup_mutex);
-                    op->od->has_unknown = true;
-                }
+                /* Ports with "unknown" addresses are added to the MC_UNKNOWN
+                 * group by build_mcast_groups(). */
+                continue;
             } else if (is_dynamic_lsp_address(op->nbsp->addresses[i])) {
                 if (!op->nbsp->dynamic_addresses
                     || !ovs_scan(op->nbsp->dynamic_addresses,
@@ -7704,10 +8480,16 @@ build_bfd_table(struct northd_context *ctx, struct hmap *bfd_connections,
     const struct sbrec_bfd *sb_bt;
     unsigned long *bfd_src_ports;
     struct bfd_entry *bfd_e;
+    struct ovn_port *op;
     uint32_t hash;
 
     bfd_src_ports = bitmap_allocate(BFD_UDP_SRC_PORT_LEN);
 
+    /* The ports are kept across runs by the "northd" engine node. */
+    HMAP_FOR_EACH (op, key_node, ports) {
+        op->has_bfd = false;
+    }
+
     SBREC_BFD_FOR_EACH (sb_bt, ctx->ovnsb_idl) {
         bfd_e = xmalloc(sizeof *bfd_e);
         bfd_e->sb_bt = sb_bt;
@@ -7763,14 +8545,14 @@ build_bfd_table(struct northd_context *ctx, struct hmap *bfd_connections,
             hmap_insert(bfd_connections, &bfd_e->hmap_node, hash);
         }
 
-        struct ovn_port *op = ovn_port_find(ports, nb_bt->logical_port);
+        op = ovn_port_find(ports, nb_bt->logical_port);
         if (op) {
             op->has_bfd = true;
         }
     }
 
     HMAP_FOR_EACH_POP (bfd_e, hmap_node, &sb_only) {
-        struct ovn_port *op = ovn_port_find(ports, bfd_e->sb_bt->logical_port);
+        op = ovn_port_find(ports, bfd_e->sb_bt->logical_port);
         if (op) {
             op->has_bfd = false;
         }
@@ -8152,9 +8934,11 @@ struct ecmp_route_list_node {
     const struct parsed_route *route;
 };
 
+/* Routes with the same prefix, which are ECMP routes if there are more than
+ * one of them. */
 struct ecmp_groups_node {
     struct hmap_node hmap_node; /* In ecmp_groups */
-    uint16_t id; /* starts from 1 */
+    uint16_t id; /* starts from 1, 0 while the group has a single route */
     struct in6_addr prefix;
     unsigned int plen;
     bool is_src_route;
@@ -8182,16 +8966,9 @@ static struct ecmp_groups_node *
 ecmp_groups_add(struct hmap *ecmp_groups,
                 const struct parsed_route *route)
 {
-    if (hmap_count(ecmp_groups) == UINT16_MAX) {
-        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 1);
-        VLOG_WARN_RL(&rl, "too many ecmp groups.");
-        return NULL;
-    }
-
     struct ecmp_groups_node *eg = xzalloc(sizeof *eg);
     hmap_insert(ecmp_groups, &eg->hmap_node, route->hash);
 
-    eg->id = hmap_count(ecmp_groups);
     eg->prefix = route->prefix;
     eg->plen = route->plen;
     eg->is_src_route = route->is_src_route;
@@ -8231,51 +9008,6 @@ ecmp_groups_destroy(struct hmap *ecmp_groups)
     hmap_destroy(ecmp_groups);
 }
 
-struct unique_routes_node {
-    struct hmap_node hmap_node;
-    const struct parsed_route *route;
-};
-
-static void
-unique_routes_add(struct hmap *unique_routes,
-                  const struct parsed_route *route)
-{
-    struct unique_routes_node *ur = xmalloc(sizeof *ur);
-    ur->route = route;
-    hmap_insert(unique_routes, &ur->hmap_node, route->hash);
-}
-
-/* Remove the unique_routes_node from the hmap, and return the parsed_route
- * pointed by the removed node. */
-static const struct parsed_route *
-unique_routes_remove(struct hmap *unique_routes,
-                     const struct parsed_route *route)
-{
-    struct unique_routes_node *ur;
-    HMAP_FOR_EACH_WITH_HASH (ur, hmap_node, route->hash, unique_routes) {
-        if (ipv6_addr_equals(&route->prefix, &ur->route->prefix) &&
-            route->plen == ur->route->plen &&
-            route->is_src_route == ur->route->is_src_route) {
-            hmap_remove(unique_routes, &ur->hmap_node);
-            const struct parsed_route *existed_route = ur->route;
-            free(ur);
-            return existed_route;
-        }
-    }
-    return NULL;
-}
-
-static void
-unique_routes_destroy(struct hmap *unique_routes)
-{
-    struct unique_routes_node *ur, *next;
-    HMAP_FOR_EACH_SAFE (ur, next, hmap_node, unique_routes) {
-        hmap_remove(unique_routes, &ur->hmap_node);
-        free(ur);
-    }
-    hmap_destroy(unique_routes);
-}
-
 static char *
 build_route_prefix_s(const struct in6_addr *prefix, unsigned int plen)
 {
@@ -8315,9 +9047,55 @@ build_route_match(const struct ovn_port *op_inport, const char *network_s,
                   network_s, plen);
 }
 
+/* Output port of the static routes of a router with the same next hop and
+ * output port.  Routers often have many routes to a few next hops, e.g. the
+ * ones learned through ovn-ic, so the port is only looked up once for each
+ * of them. */
+struct route_nexthop {
+    struct hmap_node hmap_node; /* In the 'nexthops' of a router. */
+    const char *nexthop;
+    const char *output_port;    /* May be NULL. */
+    const char *lrp_addr_s;
+    struct ovn_port *out_port;
+};
+
+static uint32_t
+route_nexthop_hash(const struct nbrec_logical_router_static_route *route)
+{
+    return hash_string(route->nexthop,
+                       route->output_port
+                       ? hash_string(route->output_port, 0) : 0);
+}
+
+static struct route_nexthop *
+route_nexthop_find(struct hmap *nexthops,
+                   const struct nbrec_logical_router_static_route *route,
+                   uint32_t hash)
+{
+    struct route_nexthop *nh;
+    HMAP_FOR_EACH_WITH_HASH (nh, hmap_node, hash, nexthops) {
+        if (!strcmp(nh->nexthop, route->nexthop)
+            && nullable_string_is_equal(nh->output_port,
+                                        route->output_port)) {
+            return nh;
+        }
+    }
+    return NULL;
+}
+
+static void
+route_nexthops_destroy(struct hmap *nexthops)
+{
+    struct route_nexthop *nh;
+    HMAP_FOR_EACH_POP (nh, hmap_node, nexthops) {
+        free(nh);
+    }
+    hmap_destroy(nexthops);
+}
+
 /* Output: p_lrp_addr_s and p_out_port. */
 static bool
-find_static_route_outport(struct ovn_datapath *od, struct hmap *ports,
+find_static_route_outport__(struct ovn_datapath *od, struct hmap *ports,
     const struct nbrec_logical_router_static_route *route, bool is_ipv4,
     const char **p_lrp_addr_s, struct ovn_port **p_out_port)
 {
@@ -8380,6 +9158,37 @@ find_static_route_outport(struct ovn_datapath *od, struct hmap *ports,
     return true;
 }
 
+/* Same as find_static_route_outport__(), looking up the routes with the same
+ * next hop and output port only once in 'nexthops'. */
+static bool
+find_static_route_outport(struct ovn_datapath *od, struct hmap *ports,
+    const struct nbrec_logical_router_static_route *route, bool is_ipv4,
+    struct hmap *nexthops,
+    const char **p_lrp_addr_s, struct ovn_port **p_out_port)
+{
+    uint32_t hash = route_nexthop_hash(route);
+    struct route_nexthop *nh = route_nexthop_find(nexthops, route, hash);
+
+    if (!nh) {
+        const char *lrp_addr_s;
+        struct ovn_port *out_port;
+
+        if (!find_static_route_outport__(od, ports, route, is_ipv4,
+                                         &lrp_addr_s, &out_port)) {
+            return false;
+        }
+        nh = xmalloc(sizeof *nh);
+        nh->nexthop = route->nexthop;
+        nh->output_port = route->output_port;
+        nh->lrp_addr_s = lrp_addr_s;
+        nh->out_port = out_port;
+        hmap_insert(nexthops, &nh->hmap_node, hash);
+    }
+    *p_lrp_addr_s = nh->lrp_addr_s;
+    *p_out_port = nh->out_port;
+    return true;
+}
+
 static void
 add_ecmp_symmetric_reply_flows(struct hmap *lflows,
                                struct ovn_datapath *od,
@@ -8462,7 +9271,8 @@ add_ecmp_symmetric_reply_flows(struct hmap *lflows,
 
 static void
 build_ecmp_route_flow(struct hmap *lflows, struct ovn_datapath *od,
-                      struct hmap *ports, struct ecmp_groups_node *eg)
+                      struct hmap *ports, struct hmap *nexthops,
+                      struct ecmp_groups_node *eg)
 
 {
     bool is_ipv4 = IN6_IS_ADDR_V4MAPPED(&eg->prefix);
@@ -8504,8 +9314,8 @@ build_ecmp_route_flow(struct hmap *lflows, struct ovn_datapath *od,
         /* Find the outgoing port. */
         const char *lrp_addr_s = NULL;
         struct ovn_port *out_port = NULL;
-        if (!find_static_route_outport(od, ports, route, is_ipv4, &lrp_addr_s,
-                                       &out_port)) {
+        if (!find_static_route_outport(od, ports, route, is_ipv4, nexthops,
+                                       &lrp_addr_s, &out_port)) {
             continue;
         }
         /* Symmetric ECMP reply is only usable on gateway routers.
@@ -8607,7 +9417,7 @@ add_route(struct hmap *lflows, struct ovn_datapath *od,
 
 static void
 build_static_route_flow(struct hmap *lflows, struct ovn_datapath *od,
-                        struct hmap *ports,
+                        struct hmap *ports, struct hmap *nexthops,
                         const struct parsed_route *route_)
 {
     const char *lrp_addr_s = NULL;
@@ -8619,7 +9429,7 @@ build_static_route_flow(struct hmap *lflows, struct ovn_datapath *od,
     if (!route_->is_discard_route) {
         if (!find_static_route_outport(od, ports, route,
                                        IN6_IS_ADDR_V4MAPPED(&route_->prefix),
-                                       &lrp_addr_s, &out_port)) {
+                                       nexthops, &lrp_addr_s, &out_port)) {
             return;
         }
     }
@@ -8844,8 +9654,7 @@ build_lrouter_lb_flows(struct hmap *lflows, struct ovn_datapath *od,
             struct ovn_lb_vip *lb_vip = &lb->vips[j];
             struct ovn_northd_lb_vip *lb_vip_nb = &lb->vips_nb[j];
             ds_clear(actions);
-            build_lb_vip_actions(lb_vip, lb_vip_nb, actions,
-                                 lb->selection_fields, false);
+            ds_put_cstr(actions, lb_vip_nb->lr_lflow_actions);
 
             if (!sset_contains(&all_ips, lb_vip->vip_str)) {
                 sset_add(&all_ips, lb_vip->vip_str);
@@ -8876,25 +9685,9 @@ build_lrouter_lb_flows(struct hmap *lflows, struct ovn_datapath *od,
              * on ct.new with an action of "ct_lb($targets);".  The other
              * flow is for ct.est with an action of "ct_dnat;". */
             ds_clear(match);
-            if (IN6_IS_ADDR_V4MAPPED(&lb_vip->vip)) {
-                ds_put_format(match, "ip && ip4.dst == %s",
-                              lb_vip->vip_str);
-            } else {
-                ds_put_format(match, "ip && ip6.dst == %s",
-                              lb_vip->vip_str);
-            }
-
-            int prio = 110;
-            bool is_udp = nullable_string_is_equal(nb_lb->protocol, "udp");
-            bool is_sctp = nullable_string_is_equal(nb_lb->protocol,
-                                                    "sctp");
-            const char *proto = is_udp ? "udp" : is_sctp ? "sctp" : "tcp";
-
-            if (lb_vip->vip_port) {
-                ds_put_format(match, " && %s && %s.dst == %d", proto,
-                              proto, lb_vip->vip_port);
-                prio = 120;
-            }
+            ds_put_cstr(match, lb_vip_nb->lr_lflow_match);
+            int prio = lb_vip_nb->lr_lflow_priority;
+            const char *proto = lb_lflow_protocol(lb);
 
             if (od->l3redirect_port &&
                 (lb_vip->n_backends || !lb_vip->empty_backend_rej)) {
@@ -9896,10 +10689,12 @@ build_static_route_flows_for_lrouter(
         ovn_lflow_add(lflows, od, S_ROUTER_IN_IP_ROUTING_ECMP, 150,
                       REG_ECMP_GROUP_ID" == 0", "next;");
 
+        /* Group the routes by prefix in a single pass.  A group becomes an
+         * ECMP group, and gets an id, when its second route is added. */
         struct hmap ecmp_groups = HMAP_INITIALIZER(&ecmp_groups);
-        struct hmap unique_routes = HMAP_INITIALIZER(&unique_routes);
         struct ovs_list parsed_routes = OVS_LIST_INITIALIZER(&parsed_routes);
         struct ecmp_groups_node *group;
+        uint16_t n_ecmp_groups = 0;
         for (int i = 0; i < od->nbr->n_static_routes; i++) {
             struct parsed_route *route =
                 parsed_routes_add(&parsed_routes, od->nbr->static_routes[i],
@@ -9908,32 +10703,38 @@ build_static_route_flows_for_lrouter(
                 continue;
             }
             group = ecmp_groups_find(&ecmp_groups, route);
-            if (group) {
-                ecmp_groups_add_route(group, route);
-            } else {
-                const struct parsed_route *existed_route =
-                    unique_routes_remove(&unique_routes, route);
-                if (existed_route) {
-                    group = ecmp_groups_add(&ecmp_groups, existed_route);
-                    if (group) {
-                        ecmp_groups_add_route(group, route);
-                    }
-                } else {
-                    unique_routes_add(&unique_routes, route);
+            if (!group) {
+                ecmp_groups_add(&ecmp_groups, route);
+                continue;
+            }
+            if (!group->id) {
+                if (n_ecmp_groups == UINT16_MAX) {
+                    static struct vlog_rate_limit rl
+                        = VLOG_RATE_LIMIT_INIT(5, 1);
+                    VLOG_WARN_RL(&rl, "too many ecmp groups.");
+                    continue;
                 }
+                group->id = ++n_ecmp_groups;
             }
+            ecmp_groups_add_route(group, route);
         }
+
+        struct hmap nexthops = HMAP_INITIALIZER(&nexthops);
         HMAP_FOR_EACH (group, hmap_node, &ecmp_groups) {
-            /* add a flow in IP_ROUTING, and one flow for each member in
-             * IP_ROUTING_ECMP. */
-            build_ecmp_route_flow(lflows, od, ports, group);
-        }
-        const struct unique_routes_node *ur;
-        HMAP_FOR_EACH (ur, hmap_node, &unique_routes) {
-            build_static_route_flow(lflows, od, ports, ur->route);
+            if (group->id) {
+                /* add a flow in IP_ROUTING, and one flow for each member in
+                 * IP_ROUTING_ECMP. */
+                build_ecmp_route_flow(lflows, od, ports, &nexthops, group);
+            } else {
+                const struct ecmp_route_list_node *er = CONTAINER_OF(
+                    ovs_list_front(&group->route_list),
+                    struct ecmp_route_list_node, list_node);
+                build_static_route_flow(lflows, od, ports, &nexthops,
+                                        er->route);
+            }
         }
+        route_nexthops_destroy(&nexthops);
         ecmp_groups_destroy(&ecmp_groups);
-        unique_routes_destroy(&unique_routes);
         parsed_routes_destroy(&parsed_routes);
     }
 }
@@ -11435,9 +12236,12 @@ build_lrouter_out_undnat_flow(struct hmap *lflows, struct ovn_datapath *od,
                             &nat->header_);
 }
 
+/* Builds the SNAT flow of 'nat', for the logical IPs in 'logical_ips', which
+ * are the ones of 'nat' or of a group of SNAT rules, see snat_groups_add(). */
 static void
 build_lrouter_out_snat_flow(struct hmap *lflows, struct ovn_datapath *od,
-                            const struct nbrec_nat *nat, struct ds *match,
+                            const struct nbrec_nat *nat,
+                            const char *logical_ips, struct ds *match,
                             struct ds *actions, bool distributed,
                             struct eth_addr mac, ovs_be32 mask,
                             int cidr_bits, bool is_v6)
@@ -11454,7 +12258,7 @@ build_lrouter_out_snat_flow(struct hmap *lflows, struct ovn_datapath *od,
         /* Gateway router. */
         ds_clear(match);
         ds_put_format(match, "ip && ip%s.src == %s",
-                      is_v6 ? "6" : "4", nat->logical_ip);
+                      is_v6 ? "6" : "4", logical_ips);
         ds_clear(actions);
 
         if (nat->allowed_ext_ips || nat->exempted_ext_ips) {
@@ -11487,7 +12291,7 @@ build_lrouter_out_snat_flow(struct hmap *lflows, struct ovn_datapath *od,
         /* Distributed router. */
         ds_clear(match);
         ds_put_format(match, "ip && ip%s.src == %s && outport == %s",
-                      is_v6 ? "6" : "4", nat->logical_ip,
+                      is_v6 ? "6" : "4", logical_ips,
                       od->l3dgw_port->json_key);
         if (!distributed && od->l3redirect_port) {
             /* Flows for NAT rules that are centralized are only
@@ -11529,6 +12333,52 @@ build_lrouter_out_snat_flow(struct hmap *lflows, struct ovn_datapath *od,
     }
 }
 
+/* SNAT rules of a router with the same external IP, external port range and
+ * logical IP prefix length, which translate to a single SNAT flow that
+ * matches the set of their logical IPs.  A router that SNATs many logical IPs
+ * to the same external IP needs a single flow for them. */
+struct snat_group {
+    struct hmap_node hmap_node;
+    const struct ovn_nat *nat_entry; /* First rule of the group. */
+    struct svec logical_ips;
+};
+
+/* Only plain stateful SNAT rules can share a flow, the other rules have
+ * different matches or actions for the same external IP. */
+static bool
+lrouter_nat_snat_can_group(const struct nbrec_nat *nat)
+{
+    return (!strcmp(nat->type, "snat")
+            && !nat->allowed_ext_ips && !nat->exempted_ext_ips);
+}
+
+static void
+snat_groups_add(struct hmap *snat_groups, const struct ovn_nat *nat_entry)
+{
+    const struct nbrec_nat *nat = nat_entry->nb;
+    uint32_t hash = hash_string(nat->external_ip, nat_entry->cidr_bits);
+    hash = hash_string(nat->external_port_range, hash);
+
+    struct snat_group *sg;
+    HMAP_FOR_EACH_WITH_HASH (sg, hmap_node, hash, snat_groups) {
+        const struct ovn_nat *first = sg->nat_entry;
+        if (first->cidr_bits == nat_entry->cidr_bits
+            && first->is_v6 == nat_entry->is_v6
+            && !strcmp(first->nb->external_ip, nat->external_ip)
+            && !strcmp(first->nb->external_port_range,
+                       nat->external_port_range)) {
+            svec_add(&sg->logical_ips, nat->logical_ip);
+            return;
+        }
+    }
+
+    sg = xmalloc(sizeof *sg);
+    sg->nat_entry = nat_entry;
+    svec_init(&sg->logical_ips);
+    svec_add(&sg->logical_ips, nat->logical_ip);
+    hmap_insert(snat_groups, &sg->hmap_node, hash);
+}
+
 static void
 build_lrouter_ingress_flow(struct hmap *lflows, struct ovn_datapath *od,
                            const struct nbrec_nat *nat, struct ds *match,
@@ -11572,83 +12422,27 @@ build_lrouter_ingress_flow(struct hmap *lflows, struct ovn_datapath *od,
     }
 }
 
+/* Returns 0 if the flows of 'nat_entry' can be built on 'od', also
+ * determining whether the NAT rule satisfies the conditions for distributed
+ * NAT processing. */
 static int
-lrouter_check_nat_entry(struct ovn_datapath *od, const struct nbrec_nat *nat,
-                        ovs_be32 *mask, bool *is_v6, int *cidr_bits,
+lrouter_check_nat_entry(struct ovn_datapath *od,
+                        const struct ovn_nat *nat_entry,
                         struct eth_addr *mac, bool *distributed)
 {
-    struct in6_addr ipv6, mask_v6, v6_exact = IN6ADDR_EXACT_INIT;
-    ovs_be32 ip;
+    const struct nbrec_nat *nat = nat_entry->nb;
 
-    if (nat->allowed_ext_ips && nat->exempted_ext_ips) {
-        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
-        VLOG_WARN_RL(&rl, "NAT rule: "UUID_FMT" not applied, since "
-                    "both allowed and exempt external ips set",
-                    UUID_ARGS(&(nat->header_.uuid)));
+    if (!nat_entry->is_valid) {
         return -EINVAL;
     }
 
-    char *error = ip_parse_masked(nat->external_ip, &ip, mask);
-    *is_v6 = false;
-
-    if (error || *mask != OVS_BE32_MAX) {
-        free(error);
-        error = ipv6_parse_masked(nat->external_ip, &ipv6, &mask_v6);
-        if (error || memcmp(&mask_v6, &v6_exact, sizeof(mask_v6))) {
-            /* Invalid for both IPv4 and IPv6 */
-            static struct vlog_rate_limit rl =
-                VLOG_RATE_LIMIT_INIT(5, 1);
-            VLOG_WARN_RL(&rl, "bad external ip %s for nat",
-                        nat->external_ip);
-            free(error);
-            return -EINVAL;
-        }
-        /* It was an invalid IPv4 address, but valid IPv6.
-        * Treat the rest of the handling of this NAT rule
-        * as IPv6. */
-        *is_v6 = true;
-    }
-
-    /* Check the validity of nat->logical_ip. 'logical_ip' can
-    * be a subnet when the type is "snat". */
-    if (*is_v6) {
-        error = ipv6_parse_masked(nat->logical_ip, &ipv6, &mask_v6);
-        *cidr_bits = ipv6_count_cidr_bits(&mask_v6);
-    } else {
-        error = ip_parse_masked(nat->logical_ip, &ip, mask);
-        *cidr_bits = ip_count_cidr_bits(*mask);
-    }
-    if (!strcmp(nat->type, "snat")) {
-        if (error) {
-            /* Invalid for both IPv4 and IPv6 */
-            static struct vlog_rate_limit rl =
-                VLOG_RATE_LIMIT_INIT(5, 1);
-            VLOG_WARN_RL(&rl, "bad ip network or ip %s for snat "
-                        "in router "UUID_FMT"",
-                        nat->logical_ip, UUID_ARGS(&od->key));
-            free(error);
-            return -EINVAL;
-        }
-    } else {
-        if (error || (*is_v6 == false && *mask != OVS_BE32_MAX)
-            || (*is_v6 && memcmp(&mask_v6, &v6_exact,
-                                sizeof mask_v6))) {
-            /* Invalid for both IPv4 and IPv6 */
-            static struct vlog_rate_limit rl =
-                VLOG_RATE_LIMIT_INIT(5, 1);
-            VLOG_WARN_RL(&rl, "bad ip %s for dnat in router "
-                ""UUID_FMT"", nat->logical_ip, UUID_ARGS(&od->key));
-            free(error);
-            return -EINVAL;
-        }
-    }
-
     /* For distributed router NAT, determine whether this NAT rule
      * satisfies the conditions for distributed NAT processing. */
     *distributed = false;
     if (od->l3dgw_port && !strcmp(nat->type, "dnat_and_snat") &&
         nat->logical_port && nat->external_mac) {
-        if (eth_addr_from_string(nat->external_mac, mac)) {
+        if (nat_entry->has_mac) {
+            *mac = nat_entry->mac;
             *distributed = true;
         } else {
             static struct vlog_rate_limit rl =
@@ -11702,18 +12496,21 @@ build_lrouter_nat_defrag_and_lb(struct ovn_datapath *od,
     bool lb_force_snat_ip =
         !lport_addresses_is_empty(&od->lb_force_snat_addrs);
 
+    struct hmap snat_groups = HMAP_INITIALIZER(&snat_groups);
     for (int i = 0; i < od->nbr->n_nat; i++) {
-        const struct nbrec_nat *nat = nat = od->nbr->nat[i];
+        const struct ovn_nat *nat_entry = &od->nat_entries[i];
+        const struct nbrec_nat *nat = nat_entry->nb;
         struct eth_addr mac = eth_addr_broadcast;
-        bool is_v6, distributed;
-        ovs_be32 mask;
-        int cidr_bits;
+        bool distributed;
 
-        if (lrouter_check_nat_entry(od, nat, &mask, &is_v6, &cidr_bits,
-                                    &mac, &distributed) < 0) {
+        if (lrouter_check_nat_entry(od, nat_entry, &mac, &distributed) < 0) {
             continue;
         }
 
+        bool is_v6 = nat_entry->is_v6;
+        ovs_be32 mask = nat_entry->mask;
+        int cidr_bits = nat_entry->cidr_bits;
+
         /* S_ROUTER_IN_UNSNAT */
         build_lrouter_in_unsnat_flow(lflows, od, nat, match, actions, distributed,
                                      is_v6);
@@ -11753,8 +12550,13 @@ build_lrouter_nat_defrag_and_lb(struct ovn_datapath *od,
         build_lrouter_out_undnat_flow(lflows, od, nat, match, actions, distributed,
                                       mac, is_v6);
         /* S_ROUTER_OUT_SNAT */
-        build_lrouter_out_snat_flow(lflows, od, nat, match, actions, distributed,
-                                    mac, mask, cidr_bits, is_v6);
+        if (lrouter_nat_snat_can_group(nat)) {
+            snat_groups_add(&snat_groups, nat_entry);
+        } else {
+            build_lrouter_out_snat_flow(lflows, od, nat, nat->logical_ip,
+                                        match, actions, distributed, mac,
+                                        mask, cidr_bits, is_v6);
+        }
 
         /* S_ROUTER_IN_ADMISSION - S_ROUTER_IN_IP_INPUT */
         build_lrouter_ingress_flow(lflows, od, nat, match, actions,
@@ -11823,6 +12625,30 @@ build_lrouter_nat_defrag_and_lb(struct ovn_datapath *od,
         }
     }
 
+    struct snat_group *sg;
+    HMAP_FOR_EACH_POP (sg, hmap_node, &snat_groups) {
+        const struct ovn_nat *nat_entry = sg->nat_entry;
+        char *logical_ips;
+
+        /* Sorted, for the flow not to depend on the order of the rules. */
+        svec_sort(&sg->logical_ips);
+        if (sg->logical_ips.n == 1) {
+            logical_ips = xstrdup(sg->logical_ips.names[0]);
+        } else {
+            char *list = svec_join(&sg->logical_ips, ", ", "");
+            logical_ips = xasprintf("{%s}", list);
+            free(list);
+        }
+        build_lrouter_out_snat_flow(lflows, od, nat_entry->nb, logical_ips,
+                                    match, actions, false, eth_addr_broadcast,
+                                    nat_entry->mask, nat_entry->cidr_bits,
+                                    nat_entry->is_v6);
+        free(logical_ips);
+        svec_destroy(&sg->logical_ips);
+        free(sg);
+    }
+    hmap_destroy(&snat_groups);
+
     /* Handle force SNAT options set in the gateway router. */
     if (!od->l3dgw_port) {
         if (dnat_force_snat_ip) {
@@ -11881,11 +12707,11 @@ struct lswitch_flow_build_info {
     struct hmap *ports;
     struct hmap *port_groups;
     struct hmap *lflows;
-    struct hmap *mcgroups;
     struct hmap *igmp_groups;
     struct shash *meter_groups;
     struct hmap *lbs;
     struct hmap *bfd_connections;
+    struct lflow_arena *arena;
     char *svc_check_match;
     struct ds match;
     struct ds actions;
@@ -11958,8 +12784,8 @@ build_lswitch_and_lrouter_iterate_by_op(struct ovn_port *op,
                                              &lsi->match);
     build_lswitch_dhcp_options_and_response(op, lsi->lflows);
     build_lswitch_external_port(op, lsi->lflows);
-    build_lswitch_ip_unicast_lookup(op, lsi->lflows, lsi->mcgroups,
-                                    &lsi->actions, &lsi->match);
+    build_lswitch_ip_unicast_lookup(op, lsi->lflows, &lsi->actions,
+                                    &lsi->match);
     build_lswitch_output_port_sec_op(op, lsi->lflows,
                                      &lsi->actions, &lsi->match);
 
@@ -11986,6 +12812,13 @@ build_lswitch_and_lrouter_iterate_by_op(struct ovn_port *op,
 
 struct lflows_thread_pool {
     struct worker_pool *pool;
+
+    /* Shared by the workers to split up each hash map processed by
+     * build_lflows_thread(). */
+    struct parallel_work datapaths_work;
+    struct parallel_work ports_work;
+    struct parallel_work lbs_work;
+    struct parallel_work igmp_groups_work;
 };
 
 
@@ -12000,7 +12833,7 @@ build_lflows_thread(void *arg)
     struct ovn_port *op;
     struct ovn_northd_lb *lb;
     struct ovn_igmp_group *igmp_group;
-    int bnum;
+    size_t bnum, start, end;
 
     while (!stop_parallel_processing()) {
         wait_for_work(control);
@@ -12010,54 +12843,60 @@ build_lflows_thread(void *arg)
             return NULL;
         }
         if (lsi && workload) {
-            /* Iterate over bucket ThreadID, ThreadID+size, ... */
-            for (bnum = control->id;
-                    bnum <= lsi->datapaths->mask;
-                    bnum += workload->pool->size)
-            {
-                HMAP_FOR_EACH_IN_PARALLEL (od, key_node, bnum, lsi->datapaths) {
-                    if (stop_parallel_processing()) {
-                        return NULL;
+            *lflow_arena_get() = lsi->arena;
+
+            /* Take chunks of buckets until there are none left, so that the
+             * workers which are done with their part help with the rest
+             * instead of waiting for the slowest one. */
+            while (parallel_work_next(&workload->datapaths_work,
+                                      &start, &end)) {
+                for (bnum = start; bnum < end; bnum++) {
+                    HMAP_FOR_EACH_IN_PARALLEL (od, key_node, bnum,
+                                               lsi->datapaths) {
+                        if (stop_parallel_processing()) {
+                            return NULL;
+                        }
+                        build_lswitch_and_lrouter_iterate_by_od(od, lsi);
                     }
-                    build_lswitch_and_lrouter_iterate_by_od(od, lsi);
                 }
             }
-            for (bnum = control->id;
-                    bnum <= lsi->ports->mask;
-                    bnum += workload->pool->size)
-            {
-                HMAP_FOR_EACH_IN_PARALLEL (op, key_node, bnum, lsi->ports) {
-                    if (stop_parallel_processing()) {
-                        return NULL;
+            while (parallel_work_next(&workload->ports_work, &start, &end)) {
+                for (bnum = start; bnum < end; bnum++) {
+                    HMAP_FOR_EACH_IN_PARALLEL (op, key_node, bnum,
+                                               lsi->ports) {
+                        if (stop_parallel_processing()) {
+                            return NULL;
+                        }
+                        build_lswitch_and_lrouter_iterate_by_op(op, lsi);
                     }
-                    build_lswitch_and_lrouter_iterate_by_op(op, lsi);
                 }
             }
-            for (bnum = control->id;
-                    bnum <= lsi->lbs->mask;
-                    bnum += workload->pool->size)
-            {
-                HMAP_FOR_EACH_IN_PARALLEL (lb, hmap_node, bnum, lsi->lbs) {
-                    if (stop_parallel_processing()) {
-                        return NULL;
+            while (parallel_work_next(&workload->lbs_work, &start, &end)) {
+                for (bnum = start; bnum < end; bnum++) {
+                    HMAP_FOR_EACH_IN_PARALLEL (lb, hmap_node, bnum,
+                                               lsi->lbs) {
+                        if (stop_parallel_processing()) {
+                            return NULL;
+                        }
+                        build_lswitch_arp_nd_service_monitor(lb, lsi->lflows,
+                                                             &lsi->match,
+                                                             &lsi->actions);
                     }
-                    build_lswitch_arp_nd_service_monitor(lb, lsi->lflows,
-                                                         &lsi->match,
-                                                         &lsi->actions);
                 }
             }
-            for (bnum = control->id;
-                    bnum <= lsi->igmp_groups->mask;
-                    bnum += workload->pool->size)
-            {
-                HMAP_FOR_EACH_IN_PARALLEL (
-                        igmp_group, hmap_node, bnum, lsi->igmp_groups) {
-                    if (stop_parallel_processing()) {
-                        return NULL;
+            while (parallel_work_next(&workload->igmp_groups_work,
+                                      &start, &end)) {
+                for (bnum = start; bnum < end; bnum++) {
+                    HMAP_FOR_EACH_IN_PARALLEL (igmp_group, hmap_node, bnum,
+                                               lsi->igmp_groups) {
+                        if (stop_parallel_processing()) {
+                            return NULL;
+                        }
+                        build_lswitch_ip_mcast_igmp_mld(igmp_group,
+                                                        lsi->lflows,
+                                                        &lsi->match,
+                                                        &lsi->actions);
                     }
-                    build_lswitch_ip_mcast_igmp_mld(igmp_group, lsi->lflows,
-                                                    &lsi->match,
-                                                    &lsi->actions);
                 }
             }
         }
@@ -12080,6 +12919,13 @@ init_lflows_thread_pool(void)
         if (pool) {
             build_lflows_pool = xmalloc(sizeof(*build_lflows_pool));
             build_lflows_pool->pool = pool;
+
+            n_lflow_worker_arenas = pool->size;
+            lflow_worker_arenas = xmalloc(n_lflow_worker_arenas
+                                          * sizeof *lflow_worker_arenas);
+            for (index = 0; index < pool->size; index++) {
+                lflow_arena_init(&lflow_worker_arenas[index]);
+            }
             for (index = 0; index < build_lflows_pool->pool->size; index++) {
                 build_lflows_pool->pool->controls[index].workload =
                     build_lflows_pool;
@@ -12094,20 +12940,41 @@ init_lflows_thread_pool(void)
  * Setting to 1 forces "all parallel" lflow build.
  */
 
+/* Merges the logical flows built by worker 'index' into 'fin_result'.
+ *
+ * Each worker already combined the equal shared flows it built into one
+ * flow with a group of datapaths.  Here the groups of equal shared flows
+ * from different workers are united, so the result doesn't depend on how
+ * the work was split between the workers.  This runs in the main thread
+ * as the workers complete, so the workers never contend on 'fin_result'. */
 static void
-noop_callback(struct worker_pool *pool OVS_UNUSED,
-              void *fin_result OVS_UNUSED,
-              void *result_frags OVS_UNUSED,
-              int index OVS_UNUSED)
+merge_lflows_with_dp_groups(struct worker_pool *pool OVS_UNUSED,
+                            void *fin_result, void *result_frags, int index)
 {
-    /* Do nothing */
-}
+    struct hmap *lflows = fin_result;
+    struct hmap *frag = &((struct hmap *) result_frags)[index];
+    struct ovn_lflow *lflow;
 
+    HMAP_FOR_EACH_POP (lflow, hmap_node, frag) {
+        uint32_t hash = hmap_node_hash(&lflow->hmap_node);
+        struct ovn_lflow *old_lflow = NULL;
+
+        if (lflow->shared) {
+            old_lflow = ovn_lflow_find_by_lflow(lflows, lflow, hash);
+        }
+        if (old_lflow) {
+            ovn_lflow_merge_ods(&lflow_main_arena, old_lflow, lflow);
+            ovn_lflow_destroy(NULL, lflow);
+        } else {
+            hmap_insert_fast(lflows, &lflow->hmap_node, hash);
+        }
+    }
+    hmap_destroy(frag);
+}
 
 static void
 build_lswitch_and_lrouter_flows(struct hmap *datapaths, struct hmap *ports,
                                 struct hmap *port_groups, struct hmap *lflows,
-                                struct hmap *mcgroups,
                                 struct hmap *igmp_groups,
                                 struct shash *meter_groups, struct hmap *lbs,
                                 struct hmap *bfd_connections)
@@ -12128,32 +12995,23 @@ build_lswitch_and_lrouter_flows(struct hmap *datapaths, struct hmap *ports,
         int index;
 
         lsiv = xcalloc(sizeof(*lsiv), build_lflows_pool->pool->size);
-        if (use_logical_dp_groups) {
-            lflow_segs = NULL;
-        } else {
-            lflow_segs = xcalloc(sizeof(*lflow_segs), build_lflows_pool->pool->size);
-        }
+        lflow_segs = xcalloc(sizeof(*lflow_segs),
+                             build_lflows_pool->pool->size);
 
         /* Set up "work chunks" for each thread to work on. */
 
         for (index = 0; index < build_lflows_pool->pool->size; index++) {
-            if (use_logical_dp_groups) {
-                /* if dp_groups are in use we lock a shared lflows hash
-                 * on a per-bucket level instead of merging hash frags */
-                lsiv[index].lflows = lflows;
-            } else {
-                fast_hmap_init(&lflow_segs[index], lflows->mask);
-                lsiv[index].lflows = &lflow_segs[index];
-            }
+            fast_hmap_init(&lflow_segs[index], lflows->mask);
+            lsiv[index].lflows = &lflow_segs[index];
 
             lsiv[index].datapaths = datapaths;
             lsiv[index].ports = ports;
             lsiv[index].port_groups = port_groups;
-            lsiv[index].mcgroups = mcgroups;
             lsiv[index].igmp_groups = igmp_groups;
             lsiv[index].meter_groups = meter_groups;
             lsiv[index].lbs = lbs;
             lsiv[index].bfd_connections = bfd_connections;
+            lsiv[index].arena = &lflow_worker_arenas[index];
             lsiv[index].svc_check_match = svc_check_match;
             ds_init(&lsiv[index].match);
             ds_init(&lsiv[index].actions);
@@ -12161,9 +13019,18 @@ build_lswitch_and_lrouter_flows(struct hmap *datapaths, struct hmap *ports,
             build_lflows_pool->pool->controls[index].data = &lsiv[index];
         }
 
+        size_t pool_size = build_lflows_pool->pool->size;
+        parallel_work_init(&build_lflows_pool->datapaths_work, datapaths,
+                           pool_size);
+        parallel_work_init(&build_lflows_pool->ports_work, ports, pool_size);
+        parallel_work_init(&build_lflows_pool->lbs_work, lbs, pool_size);
+        parallel_work_init(&build_lflows_pool->igmp_groups_work, igmp_groups,
+                           pool_size);
+
         /* Run thread pool. */
         if (use_logical_dp_groups) {
-            run_pool_callback(build_lflows_pool->pool, NULL, NULL, noop_callback);
+            run_pool_callback(build_lflows_pool->pool, lflows, lflow_segs,
+                              merge_lflows_with_dp_groups);
         } else {
             run_pool_hash(build_lflows_pool->pool, lflows, lflow_segs);
         }
@@ -12184,11 +13051,11 @@ build_lswitch_and_lrouter_flows(struct hmap *datapaths, struct hmap *ports,
             .ports = ports,
             .port_groups = port_groups,
             .lflows = lflows,
-            .mcgroups = mcgroups,
             .igmp_groups = igmp_groups,
             .meter_groups = meter_groups,
             .lbs = lbs,
             .bfd_connections = bfd_connections,
+            .arena = &lflow_main_arena,
             .svc_check_match = svc_check_match,
             .match = DS_EMPTY_INITIALIZER,
             .actions = DS_EMPTY_INITIALIZER,
@@ -12223,20 +13090,30 @@ build_lswitch_and_lrouter_flows(struct hmap *datapaths, struct hmap *ports,
     build_lswitch_flows(datapaths, lflows);
 }
 
+/* A group of datapaths shared by logical flows.  Equal groups are only kept
+ * once, so all the flows with the same datapaths use the same southbound
+ * Logical_DP_Group row. */
 struct ovn_dp_group {
-    struct hmapx map;
+    struct hmap_node node;      /* In build_lflows()'s 'dp_groups'. */
+    unsigned long *bitmap;      /* Datapaths by 'ovn_datapath->index'. */
+    size_t n_ods;               /* Number of 1-bits in 'bitmap'. */
     struct sbrec_logical_dp_group *dp_group;
-    struct hmap_node node;
 };
 
+static uint32_t
+ovn_dp_group_hash(const unsigned long *bitmap)
+{
+    return hash_bytes(bitmap, bitmap_n_bytes(n_datapaths), 0);
+}
+
 static struct ovn_dp_group *
 ovn_dp_group_find(const struct hmap *dp_groups,
-                  const struct hmapx *od, uint32_t hash)
+                  const unsigned long *bitmap, uint32_t hash)
 {
     struct ovn_dp_group *dpg;
 
     HMAP_FOR_EACH_WITH_HASH (dpg, node, hash, dp_groups) {
-        if (hmapx_equals(&dpg->map, od)) {
+        if (bitmap_equal(dpg->bitmap, bitmap, n_datapaths)) {
             return dpg;
         }
     }
@@ -12245,16 +13122,15 @@ ovn_dp_group_find(const struct hmap *dp_groups,
 
 static struct sbrec_logical_dp_group *
 ovn_sb_insert_logical_dp_group(struct northd_context *ctx,
-                                     const struct hmapx *od)
+                               const struct ovn_dp_group *dpg)
 {
     struct sbrec_logical_dp_group *dp_group;
     const struct sbrec_datapath_binding **sb;
-    const struct hmapx_node *node;
-    int n = 0;
+    size_t n = 0, index;
 
-    sb = xmalloc(hmapx_count(od) * sizeof *sb);
-    HMAPX_FOR_EACH (node, od) {
-        sb[n++] = ((struct ovn_datapath *) node->data)->sb;
+    sb = xmalloc(dpg->n_ods * sizeof *sb);
+    BITMAP_FOR_EACH_1 (index, n_datapaths, dpg->bitmap) {
+        sb[n++] = datapaths_array[index]->sb;
     }
     dp_group = sbrec_logical_dp_group_insert(ctx->ovnsb_txn);
     sbrec_logical_dp_group_set_datapaths(
@@ -12264,89 +13140,421 @@ ovn_sb_insert_logical_dp_group(struct northd_context *ctx,
     return dp_group;
 }
 
+/* Reuses the existing Logical_DP_Group rows that are equal to one of the
+ * 'dp_groups', so that they are not inserted again when a flow moves to a
+ * different group and so that duplicate rows die out. */
 static void
-ovn_sb_set_lflow_logical_dp_group(
-    struct northd_context *ctx,
-    struct hmap *dp_groups,
-    const struct sbrec_logical_flow *sbflow,
-    const struct hmapx *od_group)
+ovn_dp_groups_match_sb(struct northd_context *ctx, struct hmap *dp_groups,
+                       struct hmap *datapaths)
 {
-    struct ovn_dp_group *dpg;
-
-    if (!hmapx_count(od_group)) {
-        sbrec_logical_flow_set_logical_dp_group(sbflow, NULL);
+    if (hmap_is_empty(dp_groups)) {
         return;
     }
 
-    ovs_assert(hmapx_count(od_group) != 1);
+    unsigned long *bitmap = bitmap_allocate(n_datapaths);
+    const struct sbrec_logical_dp_group *sb_group;
+    SBREC_LOGICAL_DP_GROUP_FOR_EACH (sb_group, ctx->ovnsb_idl) {
+        bool valid = sb_group->n_datapaths > 1;
+
+        for (size_t i = 0; valid && i < sb_group->n_datapaths; i++) {
+            struct ovn_datapath *od
+                = ovn_datapath_from_sbrec(datapaths, sb_group->datapaths[i]);
+
+            if (!od || ovn_datapath_is_stale(od)) {
+                valid = false;
+            } else {
+                bitmap_set1(bitmap, od->index);
+            }
+        }
+
+        if (valid) {
+            struct ovn_dp_group *dpg
+                = ovn_dp_group_find(dp_groups, bitmap,
+                                    ovn_dp_group_hash(bitmap));
+            if (dpg && !dpg->dp_group) {
+                dpg->dp_group = CONST_CAST(struct sbrec_logical_dp_group *,
+                                           sb_group);
+            }
+        }
+        bitmap_set_multiple(bitmap, 0, n_datapaths, false);
+    }
+    bitmap_free(bitmap);
+}
+
+static void
+ovn_sb_set_lflow_logical_dp_group(struct northd_context *ctx,
+                                  const struct sbrec_logical_flow *sbflow,
+                                  const struct ovn_lflow *lflow)
+{
+    struct ovn_dp_group *dpg = lflow->dpg;
 
-    dpg = ovn_dp_group_find(dp_groups, od_group,
-                            hash_int(hmapx_count(od_group), 0));
-    ovs_assert(dpg != NULL);
+    if (!dpg) {
+        sbrec_logical_flow_set_logical_dp_group(sbflow, NULL);
+        return;
+    }
 
     if (!dpg->dp_group) {
-        dpg->dp_group = ovn_sb_insert_logical_dp_group(ctx, &dpg->map);
+        dpg->dp_group = ovn_sb_insert_logical_dp_group(ctx, dpg);
     }
     sbrec_logical_flow_set_logical_dp_group(sbflow, dpg->dp_group);
 }
 
+/* Inserts a new row for 'lflow' into the Logical_Flow table. */
+static void
+ovn_sb_insert_lflow(struct northd_context *ctx, const struct ovn_lflow *lflow)
+{
+    const char *pipeline = ovn_stage_get_pipeline_name(lflow->stage);
+    uint8_t table = ovn_stage_get_table(lflow->stage);
+
+    struct sbrec_logical_flow *sbflow;
+    sbflow = sbrec_logical_flow_insert(ctx->ovnsb_txn);
+    if (lflow->od) {
+        sbrec_logical_flow_set_logical_datapath(sbflow, lflow->od->sb);
+    }
+    ovn_sb_set_lflow_logical_dp_group(ctx, sbflow, lflow);
+    sbrec_logical_flow_set_pipeline(sbflow, pipeline);
+    sbrec_logical_flow_set_table_id(sbflow, table);
+    sbrec_logical_flow_set_priority(sbflow, lflow->priority);
+    sbrec_logical_flow_set_match(sbflow, lflow->match);
+    sbrec_logical_flow_set_actions(sbflow, lflow->actions);
+
+    /* Trim the source locator lflow->where, which looks something like
+     * "ovn/northd/ovn-northd.c:1234", down to just the part following the
+     * last slash, e.g. "ovn-northd.c:1234". */
+    const char *slash = strrchr(lflow->where, '/');
+#if _WIN32
+    const char *backslash = strrchr(lflow->where, '\\');
+    if (!slash || backslash > slash) {
+        slash = backslash;
+    }
+#endif
+    const char *where = slash ? slash + 1 : lflow->where;
+
+    struct smap ids = SMAP_INITIALIZER(&ids);
+    smap_add(&ids, "stage-name", ovn_stage_to_str(lflow->stage));
+    smap_add(&ids, "source", where);
+    if (lflow->stage_hint) {
+        smap_add(&ids, "stage-hint", lflow->stage_hint);
+    }
+    sbrec_logical_flow_set_external_ids(sbflow, &ids);
+    smap_destroy(&ids);
+}
+
 static ssize_t max_seen_lflow_size = 128;
 
-/* Updates the Logical_Flow and Multicast_Group tables in the OVN_SB database,
- * constructing their contents based on the OVN_NB database. */
+/* Number of logical flows in each stage, indexed by "enum ovn_stage", as of
+ * the most recent full build_lflows().  Reported by "stage-stats". */
+static size_t lflows_per_stage[OVN_STAGE_BUILD(DP_ROUTER, P_OUT, UINT8_MAX)
+                               + 1];
+/* Bytes of the matches and actions of the same flows. */
+static size_t lflow_bytes_per_stage[OVN_STAGE_BUILD(DP_ROUTER, P_OUT,
+                                                    UINT8_MAX) + 1];
+
+/* Maximum number of logical flows per datapath, 0 for no limit, from
+ * NB_Global options:lflow_budget_soft and options:lflow_budget_hard.
+ * Beyond the soft budget, ovn-northd warns.  Beyond the hard budget, it also
+ * stops updating the flows that only belong to the datapath, so that the
+ * southbound database keeps those of the previous runs. */
+static size_t lflow_budget_soft;
+static size_t lflow_budget_hard;
+
+/* Datapaths with the most logical flows, as of the most recent full
+ * build_lflows().  Reported by "datapath-stats". */
+#define LFLOW_TOP_DATAPATHS 10
+struct lflow_dp_stats {
+    char *name;
+    struct uuid key;
+    size_t n_lflows;
+    size_t n_bytes;
+};
+static struct lflow_dp_stats lflow_top_datapaths[LFLOW_TOP_DATAPATHS];
+static size_t n_lflow_top_datapaths;
+
+static const char *
+ovn_datapath_name(const struct ovn_datapath *od)
+{
+    return od->nbs ? od->nbs->name : od->nbr ? od->nbr->name : "";
+}
+
+static void
+lflow_count(struct ovn_lflow *lflow)
+{
+    size_t n_bytes = strlen(lflow->match) + strlen(lflow->actions);
+
+    lflows_per_stage[lflow->stage]++;
+    lflow_bytes_per_stage[lflow->stage] += n_bytes;
+
+    if (lflow->n_ods == 1) {
+        lflow->od_first->n_lflows++;
+        lflow->od_first->n_lflow_bytes += n_bytes;
+    } else {
+        size_t index;
+        BITMAP_FOR_EACH_1 (index, n_datapaths, lflow->dpg_bitmap) {
+            datapaths_array[index]->n_lflows++;
+            datapaths_array[index]->n_lflow_bytes += n_bytes;
+        }
+    }
+}
+
+static int
+compare_lflow_dp_stats(const void *a_, const void *b_)
+{
+    const struct lflow_dp_stats *a = a_;
+    const struct lflow_dp_stats *b = b_;
+
+    return a->n_lflows < b->n_lflows ? 1 : a->n_lflows > b->n_lflows ? -1 : 0;
+}
+
+/* Records the datapaths with the most logical flows, and checks the flows of
+ * each datapath against the budgets. */
+static void
+lflow_check_budgets(void)
+{
+    static struct vlog_rate_limit err_rl = VLOG_RATE_LIMIT_INIT(5, 5);
+    static struct vlog_rate_limit warn_rl = VLOG_RATE_LIMIT_INIT(5, 5);
+
+    for (size_t i = 0; i < n_lflow_top_datapaths; i++) {
+        free(lflow_top_datapaths[i].name);
+    }
+    n_lflow_top_datapaths = 0;
+
+    for (size_t i = 0; i < n_datapaths; i++) {
+        struct ovn_datapath *od = datapaths_array[i];
+
+        if (ovn_datapath_is_stale(od)) {
+            continue;
+        }
+
+        od->lflow_budget_exceeded = lflow_budget_hard
+                                    && od->n_lflows > lflow_budget_hard;
+        if (od->lflow_budget_exceeded) {
+            VLOG_ERR_RL(&err_rl, "datapath %s has %"PRIuSIZE" logical "
+                        "flows, more than the hard budget of %"PRIuSIZE", "
+                        "its flows are not updated", ovn_datapath_name(od),
+                        od->n_lflows, lflow_budget_hard);
+        } else if (lflow_budget_soft && od->n_lflows > lflow_budget_soft) {
+            VLOG_WARN_RL(&warn_rl, "datapath %s has %"PRIuSIZE" logical "
+                         "flows, more than the soft budget of %"PRIuSIZE,
+                         ovn_datapath_name(od), od->n_lflows,
+                         lflow_budget_soft);
+        }
+
+        /* Keep the array sorted, the last entry being the smallest. */
+        size_t n = n_lflow_top_datapaths;
+        if (n == LFLOW_TOP_DATAPATHS) {
+            if (od->n_lflows <= lflow_top_datapaths[n - 1].n_lflows) {
+                continue;
+            }
+            free(lflow_top_datapaths[--n].name);
+        }
+        lflow_top_datapaths[n] = (struct lflow_dp_stats) {
+            .name = xstrdup(ovn_datapath_name(od)),
+            .key = od->key,
+            .n_lflows = od->n_lflows,
+            .n_bytes = od->n_lflow_bytes,
+        };
+        n_lflow_top_datapaths = n + 1;
+        qsort(lflow_top_datapaths, n_lflow_top_datapaths,
+              sizeof *lflow_top_datapaths, compare_lflow_dp_stats);
+    }
+}
+
+/* The groups of connected datapaths, i.e. the logical routers of an
+ * "lrouter_group" with the logical switches attached to them, or a logical
+ * switch attached to no router.  The flows of a datapath only depend on the
+ * datapaths of its group, so the groups are the units across which the
+ * logical flow generation could be partitioned.  Their sizes, as of the most
+ * recent full build_lflows(), are reported by "partition-stats". */
+struct lflow_partition {
+    struct hmap_node hmap_node;
+    const void *key;            /* 'lrouter_group' or 'ovn_datapath'. */
+    const struct ovn_datapath *od; /* First datapath of the group. */
+    size_t n_datapaths;
+    size_t n_lflows;
+    const struct ovn_lflow *last_lflow; /* Last flow counted in 'n_lflows'. */
+};
+
+struct lflow_partition_stats {
+    char *name;                 /* Name of the first datapath. */
+    size_t n_datapaths;
+    size_t n_lflows;
+};
+
+static size_t n_lflow_partitions;
+static size_t n_lflows_total;
+static struct lflow_partition_stats lflow_top_partitions[LFLOW_TOP_DATAPATHS];
+static size_t n_lflow_top_partitions;
+
+static int
+compare_lflow_partition_stats(const void *a_, const void *b_)
+{
+    const struct lflow_partition_stats *a = a_;
+    const struct lflow_partition_stats *b = b_;
+
+    return a->n_lflows < b->n_lflows ? 1 : a->n_lflows > b->n_lflows ? -1 : 0;
+}
+
+/* Records the groups of connected datapaths with the most flows in 'lflows'.
+ * A flow shared by several datapaths of a group, through a datapath group,
+ * counts once for the group. */
+static void
+lflow_record_partitions(const struct hmap *lflows)
+{
+    struct hmap partitions = HMAP_INITIALIZER(&partitions);
+    struct lflow_partition **od_partitions
+        = xcalloc(n_datapaths, sizeof *od_partitions);
+
+    for (size_t i = 0; i < n_datapaths; i++) {
+        const struct ovn_datapath *od = datapaths_array[i];
+        const void *key = od;
+
+        if (ovn_datapath_is_stale(od)) {
+            continue;
+        }
+        if (od->lr_group) {
+            key = od->lr_group;
+        } else {
+            for (size_t j = 0; j < od->n_router_ports; j++) {
+                if (od->router_ports[j]->peer) {
+                    key = od->router_ports[j]->peer->od->lr_group;
+                    break;
+                }
+            }
+        }
+
+        struct lflow_partition *p;
+        uint32_t hash = hash_pointer(key, 0);
+        HMAP_FOR_EACH_WITH_HASH (p, hmap_node, hash, &partitions) {
+            if (p->key == key) {
+                break;
+            }
+        }
+        if (!p) {
+            p = xzalloc(sizeof *p);
+            p->key = key;
+            p->od = od;
+            hmap_insert(&partitions, &p->hmap_node, hash);
+        }
+        p->n_datapaths++;
+        od_partitions[i] = p;
+    }
+
+    const struct ovn_lflow *lflow;
+    HMAP_FOR_EACH (lflow, hmap_node, lflows) {
+        if (!lflow->n_ods) {
+            struct lflow_partition *p = od_partitions[lflow->od->index];
+            if (p) {
+                p->n_lflows++;
+            }
+            continue;
+        }
+
+        size_t index;
+        BITMAP_FOR_EACH_1 (index, n_datapaths, lflow->dpg_bitmap) {
+            struct lflow_partition *p = od_partitions[index];
+            if (p && p->last_lflow != lflow) {
+                p->last_lflow = lflow;
+                p->n_lflows++;
+            }
+        }
+    }
+    n_lflows_total = hmap_count(lflows);
+    free(od_partitions);
+
+    for (size_t i = 0; i < n_lflow_top_partitions; i++) {
+        free(lflow_top_partitions[i].name);
+    }
+    n_lflow_top_partitions = 0;
+    n_lflow_partitions = hmap_count(&partitions);
+
+    struct lflow_partition *p;
+    HMAP_FOR_EACH_POP (p, hmap_node, &partitions) {
+        size_t n = n_lflow_top_partitions;
+        if (n == LFLOW_TOP_DATAPATHS
+            && p->n_lflows <= lflow_top_partitions[n - 1].n_lflows) {
+            free(p);
+            continue;
+        }
+        if (n == LFLOW_TOP_DATAPATHS) {
+            free(lflow_top_partitions[--n].name);
+        }
+        lflow_top_partitions[n] = (struct lflow_partition_stats) {
+            .name = xstrdup(ovn_datapath_name(p->od)),
+            .n_datapaths = p->n_datapaths,
+            .n_lflows = p->n_lflows,
+        };
+        n_lflow_top_partitions = n + 1;
+        qsort(lflow_top_partitions, n_lflow_top_partitions,
+              sizeof *lflow_top_partitions, compare_lflow_partition_stats);
+        free(p);
+    }
+    hmap_destroy(&partitions);
+}
+
+/* Updates the Logical_Flow table in the OVN_SB database, constructing its
+ * contents based on the OVN_NB database. */
 static void
 build_lflows(struct northd_context *ctx, struct hmap *datapaths,
              struct hmap *ports, struct hmap *port_groups,
-             struct hmap *mcgroups, struct hmap *igmp_groups,
-             struct shash *meter_groups,
+             struct hmap *igmp_groups, struct shash *meter_groups,
              struct hmap *lbs, struct hmap *bfd_connections)
 {
     struct hmap lflows;
 
+    *lflow_arena_get() = &lflow_main_arena;
     fast_hmap_size_for(&lflows, max_seen_lflow_size);
-    if (use_parallel_build) {
-        update_hashrow_locks(&lflows, &lflow_locks);
+
+    struct ovn_northd_lb *lb;
+    HMAP_FOR_EACH (lb, hmap_node, lbs) {
+        build_lb_lflow_templates(lb);
     }
+    refresh_acl_lflows_cache(ctx, meter_groups);
     build_lswitch_and_lrouter_flows(datapaths, ports,
-                                    port_groups, &lflows, mcgroups,
-                                    igmp_groups, meter_groups, lbs,
-                                    bfd_connections);
+                                    port_groups, &lflows, igmp_groups,
+                                    meter_groups, lbs, bfd_connections);
 
     if (hmap_count(&lflows) > max_seen_lflow_size) {
         max_seen_lflow_size = hmap_count(&lflows);
     }
+    memset(lflows_per_stage, 0, sizeof lflows_per_stage);
+    memset(lflow_bytes_per_stage, 0, sizeof lflow_bytes_per_stage);
+    for (size_t i = 0; i < n_datapaths; i++) {
+        datapaths_array[i]->n_lflows = 0;
+        datapaths_array[i]->n_lflow_bytes = 0;
+    }
 
     /* Collecting all unique datapath groups. */
     struct hmap dp_groups = HMAP_INITIALIZER(&dp_groups);
     struct hmapx single_dp_lflows = HMAPX_INITIALIZER(&single_dp_lflows);
     struct ovn_lflow *lflow;
     HMAP_FOR_EACH (lflow, hmap_node, &lflows) {
-        uint32_t hash = hash_int(hmapx_count(&lflow->od_group), 0);
         struct ovn_dp_group *dpg;
 
-        ovs_assert(hmapx_count(&lflow->od_group));
+        ovs_assert(lflow->n_ods);
+        lflow_count(lflow);
 
-        if (hmapx_count(&lflow->od_group) == 1) {
+        if (lflow->n_ods == 1) {
             /* There is only one datapath, so it should be moved out of the
              * group to a single 'od'. */
-            const struct hmapx_node *node;
-            HMAPX_FOR_EACH (node, &lflow->od_group) {
-                lflow->od = node->data;
-                break;
-            }
-            hmapx_clear(&lflow->od_group);
+            ovn_lflow_set_single_od(lflow);
             /* Logical flow should be re-hashed later to allow lookups. */
             hmapx_add(&single_dp_lflows, lflow);
             continue;
         }
 
-        dpg = ovn_dp_group_find(&dp_groups, &lflow->od_group, hash);
+        uint32_t hash = ovn_dp_group_hash(lflow->dpg_bitmap);
+        dpg = ovn_dp_group_find(&dp_groups, lflow->dpg_bitmap, hash);
         if (!dpg) {
             dpg = xzalloc(sizeof *dpg);
-            hmapx_clone(&dpg->map, &lflow->od_group);
+            dpg->bitmap = bitmap_clone(lflow->dpg_bitmap, n_datapaths);
+            dpg->n_ods = lflow->n_ods;
             hmap_insert(&dp_groups, &dpg->node, hash);
         }
+        lflow->dpg = dpg;
     }
+    lflow_check_budgets();
+    lflow_record_partitions(&lflows);
+    ovn_dp_groups_match_sb(ctx, &dp_groups, datapaths);
 
     /* Adding datapath to the flow hash for logical flows that have only one,
      * so they could be found by the southbound db record. */
@@ -12366,19 +13574,17 @@ build_lflows(struct northd_context *ctx, struct hmap *datapaths,
     const struct sbrec_logical_flow *sbflow, *next_sbflow;
     SBREC_LOGICAL_FLOW_FOR_EACH_SAFE (sbflow, next_sbflow, ctx->ovnsb_idl) {
         struct sbrec_logical_dp_group *dp_group = sbflow->logical_dp_group;
-        struct ovn_datapath **od, *logical_datapath_od = NULL;
-        int n_datapaths = 0;
-        size_t i;
-
-        od = xmalloc((dp_group ? dp_group->n_datapaths + 1 : 1) * sizeof *od);
-        /* Check all logical datapaths from the group. */
-        for (i = 0; dp_group && i < dp_group->n_datapaths; i++) {
-            od[n_datapaths] = ovn_datapath_from_sbrec(datapaths,
-                                                      dp_group->datapaths[i]);
-            if (!od[n_datapaths] || ovn_datapath_is_stale(od[n_datapaths])) {
-                continue;
+        struct ovn_datapath *group_od = NULL, *logical_datapath_od = NULL;
+
+        /* Find a valid logical datapath in the group. */
+        for (size_t i = 0; dp_group && i < dp_group->n_datapaths; i++) {
+            struct ovn_datapath *od
+                = ovn_datapath_from_sbrec(datapaths, dp_group->datapaths[i]);
+
+            if (od && !ovn_datapath_is_stale(od)) {
+                group_od = od;
+                break;
             }
-            n_datapaths++;
         }
 
         struct sbrec_datapath_binding *dp = sbflow->logical_datapath;
@@ -12390,10 +13596,9 @@ build_lflows(struct northd_context *ctx, struct hmap *datapaths,
             }
         }
 
-        if (!n_datapaths && !logical_datapath_od) {
+        if (!group_od && !logical_datapath_od) {
             /* This lflow has no valid logical datapaths. */
             sbrec_logical_flow_delete(sbflow);
-            free(od);
             continue;
         }
 
@@ -12401,8 +13606,8 @@ build_lflows(struct northd_context *ctx, struct hmap *datapaths,
             = !strcmp(sbflow->pipeline, "ingress") ? P_IN : P_OUT;
         enum ovn_datapath_type dp_type;
 
-        if (n_datapaths) {
-            dp_type = od[0]->nbs ? DP_SWITCH : DP_ROUTER;
+        if (group_od) {
+            dp_type = group_od->nbs ? DP_SWITCH : DP_ROUTER;
         } else {
             dp_type = logical_datapath_od->nbs ? DP_SWITCH : DP_ROUTER;
         }
@@ -12410,84 +13615,166 @@ build_lflows(struct northd_context *ctx, struct hmap *datapaths,
             &lflows, logical_datapath_od,
             ovn_stage_build(dp_type, pipeline, sbflow->table_id),
             sbflow->priority, sbflow->match, sbflow->actions, sbflow->hash);
+        if (!dp_group && logical_datapath_od->lflow_budget_exceeded) {
+            /* Keep the flows of the datapath as they are. */
+            if (lflow) {
+                ovn_lflow_destroy(&lflows, lflow);
+            }
+            continue;
+        }
         if (lflow) {
             /* This is a valid lflow.  Checking if the datapath group needs
-             * updates. */
-            bool update_dp_group = false;
-
-            if (n_datapaths != hmapx_count(&lflow->od_group)) {
-                update_dp_group = true;
-            } else {
-                for (i = 0; i < n_datapaths; i++) {
-                    if (od[i] && !hmapx_contains(&lflow->od_group, od[i])) {
-                        update_dp_group = true;
-                        break;
-                    }
-                }
-            }
-
-            if (update_dp_group) {
-                ovn_sb_set_lflow_logical_dp_group(ctx, &dp_groups,
-                                                  sbflow, &lflow->od_group);
+             * updates.  Equal groups share a row, so comparing the rows is
+             * enough. */
+            if (lflow->dpg ? dp_group != lflow->dpg->dp_group : !!dp_group) {
+                ovn_sb_set_lflow_logical_dp_group(ctx, sbflow, lflow);
             }
             /* This lflow updated.  Not needed anymore. */
             ovn_lflow_destroy(&lflows, lflow);
         } else {
             sbrec_logical_flow_delete(sbflow);
         }
-        free(od);
     }
 
     struct ovn_lflow *next_lflow;
     HMAP_FOR_EACH_SAFE (lflow, next_lflow, hmap_node, &lflows) {
-        const char *pipeline = ovn_stage_get_pipeline_name(lflow->stage);
-        uint8_t table = ovn_stage_get_table(lflow->stage);
-
-        sbflow = sbrec_logical_flow_insert(ctx->ovnsb_txn);
-        if (lflow->od) {
-            sbrec_logical_flow_set_logical_datapath(sbflow, lflow->od->sb);
-        }
-        ovn_sb_set_lflow_logical_dp_group(ctx, &dp_groups,
-                                          sbflow, &lflow->od_group);
-        sbrec_logical_flow_set_pipeline(sbflow, pipeline);
-        sbrec_logical_flow_set_table_id(sbflow, table);
-        sbrec_logical_flow_set_priority(sbflow, lflow->priority);
-        sbrec_logical_flow_set_match(sbflow, lflow->match);
-        sbrec_logical_flow_set_actions(sbflow, lflow->actions);
-
-        /* Trim the source locator lflow->where, which looks something like
-         * "ovn/northd/ovn-northd.c:1234", down to just the part following the
-         * last slash, e.g. "ovn-northd.c:1234". */
-        const char *slash = strrchr(lflow->where, '/');
-#if _WIN32
-        const char *backslash = strrchr(lflow->where, '\\');
-        if (!slash || backslash > slash) {
-            slash = backslash;
-        }
-#endif
-        const char *where = slash ? slash + 1 : lflow->where;
-
-        struct smap ids = SMAP_INITIALIZER(&ids);
-        smap_add(&ids, "stage-name", ovn_stage_to_str(lflow->stage));
-        smap_add(&ids, "source", where);
-        if (lflow->stage_hint) {
-            smap_add(&ids, "stage-hint", lflow->stage_hint);
+        if (lflow->dpg || !lflow->od->lflow_budget_exceeded) {
+            ovn_sb_insert_lflow(ctx, lflow);
         }
-        sbrec_logical_flow_set_external_ids(sbflow, &ids);
-        smap_destroy(&ids);
-
         ovn_lflow_destroy(&lflows, lflow);
     }
     hmap_destroy(&lflows);
+    lflow_arenas_clear();
 
     struct ovn_dp_group *dpg;
     HMAP_FOR_EACH_POP (dpg, node, &dp_groups) {
-        hmapx_destroy(&dpg->map);
+        bitmap_free(dpg->bitmap);
         free(dpg);
     }
     hmap_destroy(&dp_groups);
+}
+
+/* Returns true if all the logical flows in 'stage' are built by
+ * build_lswitch_lflows_pre_acl_and_acl(). */
+static bool
+ovn_stage_is_lswitch_acl(enum ovn_stage stage)
+{
+    switch (stage) {
+    case S_SWITCH_IN_PRE_ACL:
+    case S_SWITCH_IN_PRE_LB:
+    case S_SWITCH_IN_PRE_STATEFUL:
+    case S_SWITCH_IN_ACL_HINT:
+    case S_SWITCH_IN_ACL:
+    case S_SWITCH_IN_QOS_MARK:
+    case S_SWITCH_IN_QOS_METER:
+    case S_SWITCH_IN_STATEFUL:
+    case S_SWITCH_IN_PRE_HAIRPIN:
+    case S_SWITCH_IN_NAT_HAIRPIN:
+    case S_SWITCH_IN_HAIRPIN:
+    case S_SWITCH_OUT_PRE_LB:
+    case S_SWITCH_OUT_PRE_ACL:
+    case S_SWITCH_OUT_PRE_STATEFUL:
+    case S_SWITCH_OUT_ACL_HINT:
+    case S_SWITCH_OUT_ACL:
+    case S_SWITCH_OUT_QOS_MARK:
+    case S_SWITCH_OUT_QOS_METER:
+    case S_SWITCH_OUT_STATEFUL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Updates the Logical_Flow table in the OVN_SB database for the ACL, QoS and
+ * load balancing stages of the logical switches in 'ods', without touching
+ * the flows of any other datapath or stage.
+ *
+ * This relies on every logical flow having a single datapath, so it must not
+ * be used with logical datapath groups. */
+static void
+update_lswitch_acl_lflows(struct northd_context *ctx, const struct hmapx *ods,
+                          struct hmap *port_groups, struct shash *meter_groups,
+                          struct hmap *lbs)
+{
+    struct hmap od_lflows = HMAP_INITIALIZER(&od_lflows);
+    const struct hmapx_node *node;
+
+    ovs_assert(!use_logical_dp_groups);
+
+    refresh_acl_lflows_cache(ctx, meter_groups);
+    *lflow_arena_get() = &lflow_main_arena;
+    HMAPX_FOR_EACH (node, ods) {
+        build_lswitch_lflows_pre_acl_and_acl(node->data, port_groups,
+                                             &od_lflows, meter_groups, lbs);
+    }
+
+    /* As in build_lflows(), move the only datapath out of the group and add
+     * it to the hash, so that the flows can be found by their southbound
+     * records. */
+    struct hmap lflows = HMAP_INITIALIZER(&lflows);
+    struct ovn_lflow *lflow;
+    HMAP_FOR_EACH_POP (lflow, hmap_node, &od_lflows) {
+        uint32_t hash = hmap_node_hash(&lflow->hmap_node);
+
+        ovn_lflow_set_single_od(lflow);
+        hash = ovn_logical_flow_hash_datapath(&lflow->od->sb->header_.uuid,
+                                              hash);
+        hmap_insert(&lflows, &lflow->hmap_node, hash);
+    }
+    hmap_destroy(&od_lflows);
+
+    /* Sync with the existing flows of the same datapaths and stages. */
+    struct sbrec_logical_flow *target =
+        sbrec_logical_flow_index_init_row(ctx->sbrec_lflow_by_datapath);
+    struct hmapx stale_sbflows = HMAPX_INITIALIZER(&stale_sbflows);
+    HMAPX_FOR_EACH (node, ods) {
+        struct ovn_datapath *od = node->data;
+        const struct sbrec_logical_flow *sbflow;
+
+        sbrec_logical_flow_index_set_logical_datapath(target, od->sb);
+        SBREC_LOGICAL_FLOW_FOR_EACH_EQUAL (sbflow, target,
+                                           ctx->sbrec_lflow_by_datapath) {
+            enum ovn_pipeline pipeline
+                = !strcmp(sbflow->pipeline, "ingress") ? P_IN : P_OUT;
+            enum ovn_stage stage
+                = ovn_stage_build(DP_SWITCH, pipeline, sbflow->table_id);
+
+            if (!ovn_stage_is_lswitch_acl(stage)) {
+                continue;
+            }
+
+            lflow = ovn_lflow_find(&lflows, od, stage, sbflow->priority,
+                                   sbflow->match, sbflow->actions,
+                                   sbflow->hash);
+            if (lflow) {
+                ovn_lflow_destroy(&lflows, lflow);
+            } else {
+                hmapx_add(&stale_sbflows, CONST_CAST(void *, sbflow));
+            }
+        }
+    }
+    sbrec_logical_flow_index_destroy_row(target);
+
+    HMAPX_FOR_EACH (node, &stale_sbflows) {
+        sbrec_logical_flow_delete(node->data);
+    }
+    hmapx_destroy(&stale_sbflows);
+
+    HMAP_FOR_EACH_POP (lflow, hmap_node, &lflows) {
+        ovn_sb_insert_lflow(ctx, lflow);
+        ovn_lflow_destroy(NULL, lflow);
+    }
+    hmap_destroy(&lflows);
+    lflow_arena_clear(&lflow_main_arena);
+}
 
-    /* Push changes to the Multicast_Group table to database. */
+/* Updates the Multicast_Group table in the OVN_SB database based on the groups
+ * computed by build_mcast_groups().  All the entries of 'mcgroups' are
+ * destroyed. */
+static void
+sync_multicast_groups(struct northd_context *ctx, struct hmap *datapaths,
+                      struct hmap *mcgroups)
+{
     const struct sbrec_multicast_group *sbmc, *next_sbmc;
     SBREC_MULTICAST_GROUP_FOR_EACH_SAFE (sbmc, next_sbmc, ctx->ovnsb_idl) {
         struct ovn_datapath *od = ovn_datapath_from_sbrec(datapaths,
@@ -12540,6 +13827,38 @@ sync_address_set(struct northd_context *ctx, const char *name,
                                     addrs, n_addrs);
 }
 
+/* The IPv4 and IPv6 addresses of the ports of a port group, see
+ * sync_address_sets(). */
+struct pg_address_sets {
+    const struct nbrec_port_group *nb_pg;
+    struct svec ipv4_addrs;
+    struct svec ipv6_addrs;
+};
+
+static void
+build_port_group_address_sets(size_t index, void *pg_sets_)
+{
+    struct pg_address_sets *pg_sets = pg_sets_;
+    struct pg_address_sets *pg_set = &pg_sets[index];
+    const struct nbrec_port_group *nb_pg = pg_set->nb_pg;
+
+    svec_init(&pg_set->ipv4_addrs);
+    svec_init(&pg_set->ipv6_addrs);
+    for (size_t i = 0; i < nb_pg->n_ports; i++) {
+        for (size_t j = 0; j < nb_pg->ports[i]->n_addresses; j++) {
+            const char *addrs = nb_pg->ports[i]->addresses[j];
+            if (!is_dynamic_lsp_address(addrs)) {
+                split_addresses(addrs, &pg_set->ipv4_addrs,
+                                &pg_set->ipv6_addrs);
+            }
+        }
+        if (nb_pg->ports[i]->dynamic_addresses) {
+            split_addresses(nb_pg->ports[i]->dynamic_addresses,
+                            &pg_set->ipv4_addrs, &pg_set->ipv6_addrs);
+        }
+    }
+}
+
 /* OVN_Southbound Address_Set table contains same records as in north
  * bound, plus the records generated from Port_Group table in north bound.
  *
@@ -12566,37 +13885,35 @@ sync_address_sets(struct northd_context *ctx)
                      &sb_address_sets);
 
     /* sync port group generated address sets first */
+    struct pg_address_sets *pg_sets = NULL;
+    size_t n_pg_sets = 0, allocated_pg_sets = 0;
     const struct nbrec_port_group *nb_port_group;
     NBREC_PORT_GROUP_FOR_EACH (nb_port_group, ctx->ovnnb_idl) {
-        struct svec ipv4_addrs = SVEC_EMPTY_INITIALIZER;
-        struct svec ipv6_addrs = SVEC_EMPTY_INITIALIZER;
-        for (size_t i = 0; i < nb_port_group->n_ports; i++) {
-            for (size_t j = 0; j < nb_port_group->ports[i]->n_addresses; j++) {
-                const char *addrs = nb_port_group->ports[i]->addresses[j];
-                if (!is_dynamic_lsp_address(addrs)) {
-                    split_addresses(addrs, &ipv4_addrs, &ipv6_addrs);
-                }
-            }
-            if (nb_port_group->ports[i]->dynamic_addresses) {
-                split_addresses(nb_port_group->ports[i]->dynamic_addresses,
-                                &ipv4_addrs, &ipv6_addrs);
-            }
+        if (n_pg_sets == allocated_pg_sets) {
+            pg_sets = x2nrealloc(pg_sets, &allocated_pg_sets, sizeof *pg_sets);
         }
-        char *ipv4_addrs_name = xasprintf("%s_ip4", nb_port_group->name);
-        char *ipv6_addrs_name = xasprintf("%s_ip6", nb_port_group->name);
+        pg_sets[n_pg_sets++].nb_pg = nb_port_group;
+    }
+    parallel_run(n_pg_sets, build_port_group_address_sets, pg_sets);
+
+    for (size_t i = 0; i < n_pg_sets; i++) {
+        struct pg_address_sets *pg_set = &pg_sets[i];
+        char *ipv4_addrs_name = xasprintf("%s_ip4", pg_set->nb_pg->name);
+        char *ipv6_addrs_name = xasprintf("%s_ip6", pg_set->nb_pg->name);
         sync_address_set(ctx, ipv4_addrs_name,
                          /* "char **" is not compatible with "const char **" */
-                         (const char **)ipv4_addrs.names,
-                         ipv4_addrs.n, &sb_address_sets);
+                         (const char **)pg_set->ipv4_addrs.names,
+                         pg_set->ipv4_addrs.n, &sb_address_sets);
         sync_address_set(ctx, ipv6_addrs_name,
                          /* "char **" is not compatible with "const char **" */
-                         (const char **)ipv6_addrs.names,
-                         ipv6_addrs.n, &sb_address_sets);
+                         (const char **)pg_set->ipv6_addrs.names,
+                         pg_set->ipv6_addrs.n, &sb_address_sets);
         free(ipv4_addrs_name);
         free(ipv6_addrs_name);
-        svec_destroy(&ipv4_addrs);
-        svec_destroy(&ipv6_addrs);
+        svec_destroy(&pg_set->ipv4_addrs);
+        svec_destroy(&pg_set->ipv6_addrs);
     }
+    free(pg_sets);
 
     /* sync user defined address sets, which may overwrite port group
      * generated address sets if same name is used */
@@ -13054,6 +14371,11 @@ build_mcast_groups(struct northd_context *ctx,
         } else if (op->nbsp && lsp_is_enabled(op->nbsp)) {
             ovn_multicast_add(mcast_groups, &mc_flood, op);
 
+            if (op->has_unknown && !lsp_is_external(op->nbsp)) {
+                ovn_multicast_add(mcast_groups, &mc_unknown, op);
+                op->od->has_unknown = true;
+            }
+
             if (!lsp_is_router(op->nbsp)) {
                 ovn_multicast_add(mcast_groups, &mc_flood_l2, op);
             }
@@ -13225,45 +14547,116 @@ get_probe_interval(const char *db, const struct nbrec_nb_global *nb)
     return interval;
 }
 
-static void
-ovnnb_db_run(struct northd_context *ctx,
-             struct ovsdb_idl_index *sbrec_chassis_by_name,
-             struct ovsdb_idl_loop *sb_loop,
-             struct hmap *datapaths, struct hmap *ports,
-             struct ovs_list *lr_list,
-             int64_t loop_start_time,
-             const char *ovn_internal_version)
-{
-    if (!ctx->ovnsb_txn || !ctx->ovnnb_txn) {
-        return;
-    }
+/* Data computed from the northbound database by the "northd" engine node.  It
+ * persists across main loop iterations so that changes which only affect the
+ * logical flows don't require rebuilding it. */
+struct northd_data {
+    struct hmap datapaths;
+    struct hmap ports;
+    struct ovs_list lr_list;
     struct hmap port_groups;
-    struct hmap mcast_groups;
     struct hmap igmp_groups;
-    struct shash meter_groups = SHASH_INITIALIZER(&meter_groups);
+    struct shash meter_groups;
     struct hmap lbs;
-    struct hmap bfd_connections = HMAP_INITIALIZER(&bfd_connections);
 
-    /* Sync ipsec configuration.
-     * Copy nb_cfg from northbound to southbound database.
-     * Also set up to update sb_cfg once our southbound transaction commits. */
-    const struct nbrec_nb_global *nb = nbrec_nb_global_first(ctx->ovnnb_idl);
-    if (!nb) {
-        nb = nbrec_nb_global_insert(ctx->ovnnb_txn);
+    /* Changes made by the incremental handlers during the current engine
+     * run.  'tracked' is false if the data was recomputed instead. */
+    bool tracked;
+    struct hmapx lb_updated_lswitches; /* Switches whose load balancers
+                                        * changed. */
+};
+
+static void
+northd_data_init(struct northd_data *data)
+{
+    hmap_init(&data->datapaths);
+    hmap_init(&data->ports);
+    ovs_list_init(&data->lr_list);
+    hmap_init(&data->port_groups);
+    hmap_init(&data->igmp_groups);
+    shash_init(&data->meter_groups);
+    hmap_init(&data->lbs);
+    data->tracked = false;
+    hmapx_init(&data->lb_updated_lswitches);
+}
+
+static void
+northd_data_destroy(struct northd_data *data)
+{
+    hmapx_destroy(&data->lb_updated_lswitches);
+
+    struct ovn_northd_lb *lb;
+    HMAP_FOR_EACH_POP (lb, hmap_node, &data->lbs) {
+        ovn_northd_lb_destroy(lb);
     }
-    const struct sbrec_sb_global *sb = sbrec_sb_global_first(ctx->ovnsb_idl);
-    if (!sb) {
-        sb = sbrec_sb_global_insert(ctx->ovnsb_txn);
+    hmap_destroy(&data->lbs);
+
+    struct ovn_igmp_group *igmp_group, *next_igmp_group;
+
+    HMAP_FOR_EACH_SAFE (igmp_group, next_igmp_group, hmap_node,
+                        &data->igmp_groups) {
+        ovn_igmp_group_destroy(&data->igmp_groups, igmp_group);
     }
-    if (nb->ipsec != sb->ipsec) {
-        sbrec_sb_global_set_ipsec(sb, nb->ipsec);
+    hmap_destroy(&data->igmp_groups);
+
+    struct ovn_port_group *pg, *next_pg;
+    HMAP_FOR_EACH_SAFE (pg, next_pg, key_node, &data->port_groups) {
+        ovn_port_group_destroy(&data->port_groups, pg);
+    }
+    hmap_destroy(&data->port_groups);
+
+    shash_destroy(&data->meter_groups);
+
+    destroy_datapaths_and_ports(&data->datapaths, &data->ports,
+                                &data->lr_list);
+}
+
+/* Copies nb_cfg from the northbound to the southbound database and sets up to
+ * update sb_cfg once our southbound transaction commits.
+ *
+ * This runs on every iteration that has both transactions, not only when the
+ * incremental processing engine recomputes, because a bump of nb_cfg alone
+ * doesn't change any of the data computed by the engine. */
+static void
+sync_nb_cfg(struct northd_context *ctx, struct ovsdb_idl_loop *sb_loop,
+            int64_t loop_start_time)
+{
+    const struct nbrec_nb_global *nb = nbrec_nb_global_first(ctx->ovnnb_idl);
+    if (!nb) {
+        nb = nbrec_nb_global_insert(ctx->ovnnb_txn);
+    }
+    const struct sbrec_sb_global *sb = sbrec_sb_global_first(ctx->ovnsb_idl);
+    if (!sb) {
+        sb = sbrec_sb_global_insert(ctx->ovnsb_txn);
     }
     if (nb->nb_cfg != sb->nb_cfg) {
         sbrec_sb_global_set_nb_cfg(sb, nb->nb_cfg);
         nbrec_nb_global_set_nb_cfg_timestamp(nb, loop_start_time);
     }
-    sbrec_sb_global_set_options(sb, &nb->options);
     sb_loop->next_cfg = nb->nb_cfg;
+}
+
+static void
+ovnnb_db_run(struct northd_context *ctx, struct northd_data *data)
+{
+    if (!ctx->ovnsb_txn || !ctx->ovnnb_txn) {
+        return;
+    }
+    struct hmap mcast_groups;
+
+    /* Sync ipsec configuration. */
+    const struct nbrec_nb_global *nb = nbrec_nb_global_first(ctx->ovnnb_idl);
+    if (!nb) {
+        nb = nbrec_nb_global_insert(ctx->ovnnb_txn);
+    }
+    const struct sbrec_sb_global *sb = sbrec_sb_global_first(ctx->ovnsb_idl);
+    if (!sb) {
+        sb = sbrec_sb_global_insert(ctx->ovnsb_txn);
+    }
+    if (nb->ipsec != sb->ipsec) {
+        sbrec_sb_global_set_ipsec(sb, nb->ipsec);
+    }
+    sbrec_sb_global_set_options(sb, &nb->options);
 
     const char *mac_addr_prefix = set_mac_prefix(smap_get(&nb->options,
                                                           "mac_prefix"));
@@ -13294,7 +14687,8 @@ ovnnb_db_run(struct northd_context *ctx,
     smap_replace(&options, "max_tunid", max_tunid);
     free(max_tunid);
 
-    smap_replace(&options, "northd_internal_version", ovn_internal_version);
+    smap_replace(&options, "northd_internal_version",
+                 ctx->ovn_internal_version);
 
     nbrec_nb_global_verify_options(nb);
     nbrec_nb_global_set_options(nb, &options);
@@ -13313,62 +14707,46 @@ ovnnb_db_run(struct northd_context *ctx,
                                           "use_logical_dp_groups", false);
     use_ct_inv_match = smap_get_bool(&nb->options,
                                      "use_ct_inv_match", true);
+    compact_arp_nd_responder = smap_get_bool(&nb->options,
+                                             "compact_arp_nd_responder",
+                                             false);
+    defer_changes_during_commit = smap_get_bool(&nb->options,
+                                                "defer_changes_during_commit",
+                                                false);
 
     /* deprecated, use --event instead */
     controller_event_en = smap_get_bool(&nb->options,
                                         "controller_event", false);
     check_lsp_is_up = !smap_get_bool(&nb->options,
                                      "ignore_lsp_down", false);
-
-    build_datapaths(ctx, datapaths, lr_list);
-    build_ports(ctx, sbrec_chassis_by_name, datapaths, ports);
-    build_ovn_lbs(ctx, datapaths, ports, &lbs);
-    build_ipam(datapaths, ports);
-    build_port_group_lswitches(ctx, &port_groups, ports);
-    build_lrouter_groups(ports, lr_list);
-    build_ip_mcast(ctx, datapaths);
-    build_mcast_groups(ctx, datapaths, ports, &mcast_groups, &igmp_groups);
-    build_meter_groups(ctx, &meter_groups);
-    build_bfd_table(ctx, &bfd_connections, ports);
-    build_lflows(ctx, datapaths, ports, &port_groups, &mcast_groups,
-                 &igmp_groups, &meter_groups, &lbs, &bfd_connections);
-    ovn_update_ipv6_prefix(ports);
-
-    sync_address_sets(ctx);
-    sync_port_groups(ctx, &port_groups);
-    sync_meters(ctx, &meter_groups);
-    sync_dns_entries(ctx, datapaths);
-    cleanup_stale_fdp_entries(ctx, datapaths);
-
-    struct ovn_northd_lb *lb;
-    HMAP_FOR_EACH_POP (lb, hmap_node, &lbs) {
-        ovn_northd_lb_destroy(lb);
-    }
-    hmap_destroy(&lbs);
-
-    struct ovn_igmp_group *igmp_group, *next_igmp_group;
-
-    HMAP_FOR_EACH_SAFE (igmp_group, next_igmp_group, hmap_node, &igmp_groups) {
-        ovn_igmp_group_destroy(&igmp_groups, igmp_group);
-    }
-
-    struct ovn_port_group *pg, *next_pg;
-    HMAP_FOR_EACH_SAFE (pg, next_pg, key_node, &port_groups) {
-        ovn_port_group_destroy(&port_groups, pg);
-    }
-
-    bfd_cleanup_connections(ctx, &bfd_connections);
-
-    hmap_destroy(&igmp_groups);
+    lflow_budget_soft = smap_get_ullong(&nb->options, "lflow_budget_soft", 0);
+    lflow_budget_hard = smap_get_ullong(&nb->options, "lflow_budget_hard", 0);
+
+    stopwatch_start(BUILD_DATAPATHS_STOPWATCH_NAME, time_msec());
+    build_datapaths(ctx, &data->datapaths, &data->lr_list);
+    stopwatch_stop(BUILD_DATAPATHS_STOPWATCH_NAME, time_msec());
+    stopwatch_start(BUILD_PORTS_STOPWATCH_NAME, time_msec());
+    build_ports(ctx, ctx->sbrec_chassis_by_name, &data->datapaths,
+                &data->ports);
+    stopwatch_stop(BUILD_PORTS_STOPWATCH_NAME, time_msec());
+    stopwatch_start(BUILD_LBS_STOPWATCH_NAME, time_msec());
+    build_ovn_lbs(ctx, &data->datapaths, &data->ports, &data->lbs);
+    stopwatch_stop(BUILD_LBS_STOPWATCH_NAME, time_msec());
+    build_ipam(&data->datapaths, &data->ports);
+    build_port_group_lswitches(ctx, &data->port_groups, &data->ports);
+    build_lrouter_groups(&data->ports, &data->lr_list);
+    build_ip_mcast(ctx, &data->datapaths);
+    build_mcast_groups(ctx, &data->datapaths, &data->ports, &mcast_groups,
+                       &data->igmp_groups);
+    sync_multicast_groups(ctx, &data->datapaths, &mcast_groups);
     hmap_destroy(&mcast_groups);
-    hmap_destroy(&port_groups);
-    hmap_destroy(&bfd_connections);
+    build_meter_groups(ctx, &data->meter_groups);
+    ovn_update_ipv6_prefix(&data->ports);
 
-    struct shash_node *node, *next;
-    SHASH_FOR_EACH_SAFE (node, next, &meter_groups) {
-        shash_delete(&meter_groups, node);
-    }
-    shash_destroy(&meter_groups);
+    sync_address_sets(ctx);
+    sync_port_groups(ctx, &data->port_groups);
+    sync_dns_entries(ctx, &data->datapaths);
+    cleanup_stale_fdp_entries(ctx, &data->datapaths);
 
     /* XXX Having to explicitly clean up macam here
      * is a bit strange. We don't explicitly initialize
@@ -13378,40 +14756,21 @@ ovnnb_db_run(struct northd_context *ctx,
      * as well.
      */
     cleanup_macam();
+    ipam_sweep_cache();
 }
 
-/* Stores the list of chassis which references an ha_chassis_group.
+/* Stores the set of chassis which references an ha_chassis_group.
  */
 struct ha_ref_chassis_info {
     const struct sbrec_ha_chassis_group *ha_chassis_group;
-    struct sbrec_chassis **ref_chassis;
-    size_t n_ref_chassis;
-    size_t free_slots;
+    struct hmapx ref_chassis;   /* Contains "const struct sbrec_chassis *". */
 };
 
 static void
 add_to_ha_ref_chassis_info(struct ha_ref_chassis_info *ref_ch_info,
                            const struct sbrec_chassis *chassis)
 {
-    for (size_t j = 0; j < ref_ch_info->n_ref_chassis; j++) {
-        if (ref_ch_info->ref_chassis[j] == chassis) {
-           return;
-        }
-    }
-
-    /* Allocate space for 3 chassis at a time. */
-    if (!ref_ch_info->free_slots) {
-        ref_ch_info->ref_chassis =
-            xrealloc(ref_ch_info->ref_chassis,
-                     sizeof *ref_ch_info->ref_chassis *
-                     (ref_ch_info->n_ref_chassis + 3));
-        ref_ch_info->free_slots = 3;
-    }
-
-    ref_ch_info->ref_chassis[ref_ch_info->n_ref_chassis] =
-        CONST_CAST(struct sbrec_chassis *, chassis);
-    ref_ch_info->n_ref_chassis++;
-    ref_ch_info->free_slots--;
+    hmapx_add(&ref_ch_info->ref_chassis, CONST_CAST(void *, chassis));
 }
 
 static void
@@ -13420,10 +14779,19 @@ update_sb_ha_group_ref_chassis(struct shash *ha_ref_chassis_map)
     struct shash_node *node, *next;
     SHASH_FOR_EACH_SAFE (node, next, ha_ref_chassis_map) {
         struct ha_ref_chassis_info *ha_ref_info = node->data;
+        size_t n_ref_chassis = hmapx_count(&ha_ref_info->ref_chassis);
+        struct sbrec_chassis **ref_chassis =
+            xmalloc(n_ref_chassis * sizeof *ref_chassis);
+        struct hmapx_node *hmapx_node;
+        size_t i = 0;
+
+        HMAPX_FOR_EACH (hmapx_node, &ha_ref_info->ref_chassis) {
+            ref_chassis[i++] = hmapx_node->data;
+        }
         sbrec_ha_chassis_group_set_ref_chassis(ha_ref_info->ha_chassis_group,
-                                               ha_ref_info->ref_chassis,
-                                               ha_ref_info->n_ref_chassis);
-        free(ha_ref_info->ref_chassis);
+                                               ref_chassis, n_ref_chassis);
+        free(ref_chassis);
+        hmapx_destroy(&ha_ref_info->ref_chassis);
         free(ha_ref_info);
         shash_delete(ha_ref_chassis_map, node);
     }
@@ -13449,8 +14817,7 @@ update_sb_ha_group_ref_chassis(struct shash *ha_ref_chassis_map)
  *  - 'ref_chassis' of hagrp1.
  */
 static void
-build_ha_chassis_group_ref_chassis(struct northd_context *ctx,
-                                   const struct sbrec_port_binding *sb,
+build_ha_chassis_group_ref_chassis(const struct sbrec_port_binding *sb,
                                    struct ovn_port *op,
                                    struct shash *ha_ref_chassis_map)
 {
@@ -13471,16 +14838,13 @@ build_ha_chassis_group_ref_chassis(struct northd_context *ctx,
         return;
     }
 
+    /* 'ha_ref_chassis_map' has an entry for each SB HA_Chassis_Group, so
+     * there is no need to look the groups up in the IDL. */
     const char *ha_group_name;
     SSET_FOR_EACH (ha_group_name, &lr_group->ha_chassis_groups) {
-        const struct sbrec_ha_chassis_group *sb_ha_chassis_grp;
-        sb_ha_chassis_grp = ha_chassis_group_lookup_by_name(
-            ctx->sbrec_ha_chassis_grp_by_name, ha_group_name);
-
-        if (sb_ha_chassis_grp) {
-            struct ha_ref_chassis_info *ref_ch_info =
-            shash_find_data(ha_ref_chassis_map, sb_ha_chassis_grp->name);
-            ovs_assert(ref_ch_info);
+        struct ha_ref_chassis_info *ref_ch_info =
+            shash_find_data(ha_ref_chassis_map, ha_group_name);
+        if (ref_ch_info) {
             add_to_ha_ref_chassis_info(ref_ch_info, sb->chassis);
         }
     }
@@ -13501,6 +14865,7 @@ handle_port_binding_changes(struct northd_context *ctx, struct hmap *ports,
             struct ha_ref_chassis_info *ref_ch_info =
                 xzalloc(sizeof *ref_ch_info);
             ref_ch_info->ha_chassis_group = ha_ch_grp;
+            hmapx_init(&ref_ch_info->ref_chassis);
             build_ha_chassis_ref = true;
             shash_add(ha_ref_chassis_map, ha_ch_grp->name, ref_ch_info);
         }
@@ -13534,8 +14899,7 @@ handle_port_binding_changes(struct northd_context *ctx, struct hmap *ports,
         if (build_ha_chassis_ref && ctx->ovnsb_txn && sb->chassis) {
             /* Check and add the chassis which has claimed this 'sb'
              * to the ha chassis group's ref_chassis if required. */
-            build_ha_chassis_group_ref_chassis(ctx, sb, op,
-                                               ha_ref_chassis_map);
+            build_ha_chassis_group_ref_chassis(sb, op, ha_ref_chassis_map);
         }
     }
 }
@@ -13958,7 +15322,9 @@ update_northbound_cfg(struct northd_context *ctx,
     }
 }
 
-/* Handle a fairly small set of changes in the southbound database. */
+/* Handle a fairly small set of changes in the southbound database.  'ports'
+ * is NULL if the ports built from the northbound database are not up to date
+ * in this iteration, in which case Port_Binding changes are left for later. */
 static void
 ovnsb_db_run(struct northd_context *ctx,
              struct ovsdb_idl_loop *sb_loop,
@@ -13970,7 +15336,9 @@ ovnsb_db_run(struct northd_context *ctx,
     }
 
     struct shash ha_ref_chassis_map = SHASH_INITIALIZER(&ha_ref_chassis_map);
-    handle_port_binding_changes(ctx, ports, &ha_ref_chassis_map);
+    if (ports) {
+        handle_port_binding_changes(ctx, ports, &ha_ref_chassis_map);
+    }
     update_northbound_cfg(ctx, sb_loop, loop_start_time);
     if (ctx->ovnsb_txn) {
         update_sb_ha_group_ref_chassis(&ha_ref_chassis_map);
@@ -13978,26 +15346,890 @@ ovnsb_db_run(struct northd_context *ctx,
     shash_destroy(&ha_ref_chassis_map);
 }
 
+/* Incremental processing engine.
+ *
+ * The "northd" node builds the datapaths, ports, load balancers, port groups,
+ * IGMP groups and meters from the northbound database, and keeps the
+ * southbound tables that derive directly from them in sync.  The "lflow" node
+ * builds the Logical_Flow table on top of that data.  This way changes that
+ * only affect logical flows, e.g. to ACLs or QoS rules, don't require
+ * rebuilding the "northd" data, and changes that ovn-northd doesn't care
+ * about, e.g. to MAC_Binding or Chassis_Private, don't trigger any
+ * processing at all.  Unless logical datapath groups are enabled, the
+ * "lflow" node handles ACL and QoS changes by rebuilding only the ACL
+ * related stages of the affected logical switches, see
+ * update_lswitch_acl_lflows().
+ *
+ * The southbound tables that only ovn-northd writes to (Logical_Flow,
+ * Multicast_Group, Address_Set, ...) are not inputs to the engine: any
+ * change to them is ovn-northd's own update coming back.  The tables that
+ * the "northd" data points into are inputs without a change handler, so
+ * that new and deleted rows always lead to a recompute before the data is
+ * used again. */
+#define NB_NODES \
+    NB_NODE(nb_global, "nb_global") \
+    NB_NODE(logical_switch, "logical_switch") \
+    NB_NODE(logical_switch_port, "logical_switch_port") \
+    NB_NODE(load_balancer, "load_balancer") \
+    NB_NODE(load_balancer_health_check, "load_balancer_health_check") \
+    NB_NODE(acl, "acl") \
+    NB_NODE(logical_router, "logical_router") \
+    NB_NODE(qos, "qos") \
+    NB_NODE(meter, "meter") \
+    NB_NODE(meter_band, "meter_band") \
+    NB_NODE(logical_router_port, "logical_router_port") \
+    NB_NODE(logical_router_static_route, "logical_router_static_route") \
+    NB_NODE(logical_router_policy, "logical_router_policy") \
+    NB_NODE(nat, "nat") \
+    NB_NODE(dhcp_options, "dhcp_options") \
+    NB_NODE(address_set, "address_set") \
+    NB_NODE(port_group, "port_group") \
+    NB_NODE(dns, "dns") \
+    NB_NODE(forwarding_group, "forwarding_group") \
+    NB_NODE(gateway_chassis, "gateway_chassis") \
+    NB_NODE(ha_chassis_group, "ha_chassis_group") \
+    NB_NODE(ha_chassis, "ha_chassis") \
+    NB_NODE(bfd, "bfd")
+
+#define NB_NODE(NAME, NAME_STR) ENGINE_FUNC_NB(NAME);
+    NB_NODES
+#undef NB_NODE
+
+#define SB_NODES \
+    SB_NODE(chassis, "chassis") \
+    SB_NODE(encap, "encap") \
+    SB_NODE(datapath_binding, "datapath_binding") \
+    SB_NODE(port_binding, "port_binding") \
+    SB_NODE(ha_chassis_group, "ha_chassis_group") \
+    SB_NODE(igmp_group, "igmp_group") \
+    SB_NODE(load_balancer, "load_balancer") \
+    SB_NODE(service_monitor, "service_monitor") \
+    SB_NODE(bfd, "bfd")
+
+#define SB_NODE(NAME, NAME_STR) ENGINE_FUNC_SB(NAME);
+    SB_NODES
+#undef SB_NODE
+
+static void *
+en_northd_init(struct engine_node *node OVS_UNUSED,
+               struct engine_arg *arg OVS_UNUSED)
+{
+    struct northd_data *data = xmalloc(sizeof *data);
+
+    northd_data_init(data);
+    return data;
+}
+
 static void
-ovn_db_run(struct northd_context *ctx,
-           struct ovsdb_idl_index *sbrec_chassis_by_name,
-           struct ovsdb_idl_loop *ovnsb_idl_loop,
-           const char *ovn_internal_version)
+en_northd_clear_tracked_data(void *data_)
 {
-    struct hmap datapaths, ports;
-    struct ovs_list lr_list;
-    ovs_list_init(&lr_list);
-    hmap_init(&datapaths);
-    hmap_init(&ports);
+    struct northd_data *data = data_;
 
-    int64_t start_time = time_wall_msec();
-    ovnnb_db_run(ctx, sbrec_chassis_by_name, ovnsb_idl_loop,
-                 &datapaths, &ports, &lr_list, start_time,
-                 ovn_internal_version);
-    ovnsb_db_run(ctx, ovnsb_idl_loop, &ports, start_time);
-    destroy_datapaths_and_ports(&datapaths, &ports, &lr_list);
+    data->tracked = false;
+    hmapx_clear(&data->lb_updated_lswitches);
 }
-
+
+static void
+en_northd_cleanup(void *data)
+{
+    northd_data_destroy(data);
+}
+
+static void
+en_northd_run(struct engine_node *node, void *data)
+{
+    const struct engine_context *eng_ctx = engine_get_context();
+    struct northd_context *ctx = eng_ctx->client_ctx;
+
+    northd_data_destroy(data);
+    northd_data_init(data);
+    stopwatch_start(OVNNB_DB_RUN_STOPWATCH_NAME, time_msec());
+    ovnnb_db_run(ctx, data);
+    stopwatch_stop(OVNNB_DB_RUN_STOPWATCH_NAME, time_msec());
+
+    engine_set_node_state(node, EN_UPDATED);
+}
+
+/* NB_Global columns that are kept up to date on every iteration outside of
+ * the engine, see sync_nb_cfg() and update_northbound_cfg(). */
+static bool
+nb_global_col_is_cfg(enum nbrec_nb_global_column_id col)
+{
+    return (col == NBREC_NB_GLOBAL_COL_NB_CFG
+            || col == NBREC_NB_GLOBAL_COL_NB_CFG_TIMESTAMP
+            || col == NBREC_NB_GLOBAL_COL_SB_CFG
+            || col == NBREC_NB_GLOBAL_COL_SB_CFG_TIMESTAMP
+            || col == NBREC_NB_GLOBAL_COL_HV_CFG
+            || col == NBREC_NB_GLOBAL_COL_HV_CFG_TIMESTAMP);
+}
+
+static bool
+northd_nb_nb_global_handler(struct engine_node *node,
+                            void *data OVS_UNUSED)
+{
+    const struct nbrec_nb_global_table *nb_global_table =
+        EN_OVSDB_GET(engine_get_input("NB_nb_global", node));
+
+    const struct nbrec_nb_global *nb;
+    NBREC_NB_GLOBAL_TABLE_FOR_EACH_TRACKED (nb, nb_global_table) {
+        if (nbrec_nb_global_is_new(nb) || nbrec_nb_global_is_deleted(nb)) {
+            return false;
+        }
+        for (int col = 0; col < NBREC_NB_GLOBAL_N_COLUMNS; col++) {
+            if (!nb_global_col_is_cfg(col)
+                && nbrec_nb_global_is_updated(nb, col)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* ACLs and QoS rules are only used when building logical flows, so a logical
+ * switch whose only change is to them doesn't need the "northd" data to be
+ * rebuilt. */
+static bool
+northd_nb_logical_switch_handler(struct engine_node *node,
+                                 void *data OVS_UNUSED)
+{
+    const struct nbrec_logical_switch_table *ls_table =
+        EN_OVSDB_GET(engine_get_input("NB_logical_switch", node));
+
+    const struct nbrec_logical_switch *ls;
+    NBREC_LOGICAL_SWITCH_TABLE_FOR_EACH_TRACKED (ls, ls_table) {
+        if (nbrec_logical_switch_is_new(ls)
+            || nbrec_logical_switch_is_deleted(ls)) {
+            return false;
+        }
+        for (int col = 0; col < NBREC_LOGICAL_SWITCH_N_COLUMNS; col++) {
+            if (col != NBREC_LOGICAL_SWITCH_COL_ACLS
+                && col != NBREC_LOGICAL_SWITCH_COL_QOS_RULES
+                && nbrec_logical_switch_is_updated(ls, col)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Same as northd_nb_logical_switch_handler(), for port group ACLs. */
+static bool
+northd_nb_port_group_handler(struct engine_node *node,
+                             void *data OVS_UNUSED)
+{
+    const struct nbrec_port_group_table *pg_table =
+        EN_OVSDB_GET(engine_get_input("NB_port_group", node));
+
+    const struct nbrec_port_group *pg;
+    NBREC_PORT_GROUP_TABLE_FOR_EACH_TRACKED (pg, pg_table) {
+        if (nbrec_port_group_is_new(pg) || nbrec_port_group_is_deleted(pg)) {
+            return false;
+        }
+        for (int col = 0; col < NBREC_PORT_GROUP_N_COLUMNS; col++) {
+            if (col != NBREC_PORT_GROUP_COL_ACLS
+                && nbrec_port_group_is_updated(pg, col)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* ovn-northd itself sets the "up" and "dynamic_addresses" columns of logical
+ * switch ports, after the data was built from the values it writes, so these
+ * updates don't require a recompute.  Unless "ignore_lsp_down" is set, the
+ * ARP and ND responder flows depend on "up" though. */
+static bool
+northd_nb_logical_switch_port_handler(struct engine_node *node,
+                                      void *data OVS_UNUSED)
+{
+    const struct nbrec_logical_switch_port_table *lsp_table =
+        EN_OVSDB_GET(engine_get_input("NB_logical_switch_port", node));
+
+    const struct nbrec_logical_switch_port *lsp;
+    NBREC_LOGICAL_SWITCH_PORT_TABLE_FOR_EACH_TRACKED (lsp, lsp_table) {
+        if (nbrec_logical_switch_port_is_new(lsp)
+            || nbrec_logical_switch_port_is_deleted(lsp)) {
+            return false;
+        }
+        for (int col = 0; col < NBREC_LOGICAL_SWITCH_PORT_N_COLUMNS; col++) {
+            if (col == NBREC_LOGICAL_SWITCH_PORT_COL_DYNAMIC_ADDRESSES
+                || (col == NBREC_LOGICAL_SWITCH_PORT_COL_UP
+                    && !check_lsp_is_up)) {
+                continue;
+            }
+            if (nbrec_logical_switch_port_is_updated(lsp, col)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Returns true if the change to 'nbrec_lb' can be handled by
+ * northd_nb_load_balancer_handler(), that is, if it only affects the
+ * southbound Load_Balancer record and the flows of logical switches.  Load
+ * balancers applied to logical routers change router flows, and health
+ * checks change the service monitors, so those require a recompute. */
+static bool
+northd_lb_can_update(struct northd_data *data,
+                     const struct nbrec_load_balancer *nbrec_lb)
+{
+    if (nbrec_load_balancer_is_new(nbrec_lb)
+        || nbrec_load_balancer_is_deleted(nbrec_lb)
+        || nbrec_lb->n_health_check) {
+        return false;
+    }
+
+    struct ovn_northd_lb *lb = ovn_northd_lb_find(&data->lbs,
+                                                  &nbrec_lb->header_.uuid);
+    if (!lb) {
+        return false;
+    }
+    for (size_t i = 0; i < lb->n_vips; i++) {
+        if (lb->vips_nb[i].lb_health_check) {
+            return false;
+        }
+    }
+
+    struct ovn_datapath *od;
+    LIST_FOR_EACH (od, lr_list, &data->lr_list) {
+        for (size_t i = 0; i < od->nbr->n_load_balancer; i++) {
+            if (od->nbr->load_balancer[i] == nbrec_lb) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Rebuilds the load balancers whose northbound rows changed, keeping their
+ * southbound records and datapaths, and tracks the logical switches that
+ * use them so that the "lflow" node only updates their flows. */
+static bool
+northd_nb_load_balancer_handler(struct engine_node *node, void *data_)
+{
+    const struct engine_context *eng_ctx = engine_get_context();
+    struct northd_context *ctx = eng_ctx->client_ctx;
+    struct northd_data *data = data_;
+
+    if (!ctx->ovnsb_txn) {
+        return false;
+    }
+
+    const struct nbrec_load_balancer_table *lb_table =
+        EN_OVSDB_GET(engine_get_input("NB_load_balancer", node));
+
+    /* Check all the changes first, so that nothing is updated if the node
+     * has to be recomputed anyway. */
+    const struct nbrec_load_balancer *nbrec_lb;
+    NBREC_LOAD_BALANCER_TABLE_FOR_EACH_TRACKED (nbrec_lb, lb_table) {
+        if (!northd_lb_can_update(data, nbrec_lb)) {
+            return false;
+        }
+    }
+
+    NBREC_LOAD_BALANCER_TABLE_FOR_EACH_TRACKED (nbrec_lb, lb_table) {
+        struct ovn_northd_lb *old_lb =
+            ovn_northd_lb_find(&data->lbs, &nbrec_lb->header_.uuid);
+        struct ovn_northd_lb *lb =
+            ovn_northd_lb_create(nbrec_lb, &data->ports,
+                                 (void *)ovn_port_find);
+
+        lb->slb = old_lb->slb;
+        lb->dps = old_lb->dps;
+        lb->n_dps = old_lb->n_dps;
+        lb->n_allocated_dps = old_lb->n_allocated_dps;
+        old_lb->dps = NULL;
+        hmap_replace(&data->lbs, &old_lb->hmap_node, &lb->hmap_node);
+        ovn_northd_lb_destroy(old_lb);
+
+        build_lb_lflow_templates(lb);
+        if (lb->n_dps) {
+            sync_lb_to_sb(ctx, lb);
+        }
+
+        for (size_t i = 0; i < lb->n_dps; i++) {
+            struct ovn_datapath *od =
+                ovn_datapath_from_sbrec(&data->datapaths, lb->dps[i]);
+            if (!od) {
+                return false;
+            }
+            hmapx_add(&data->lb_updated_lswitches, od);
+        }
+    }
+
+    data->tracked = true;
+    engine_set_node_state(node, EN_UPDATED);
+    return true;
+}
+
+/* The "northd" node writes the southbound Load_Balancer records itself, so
+ * their updates don't require a recompute.  New records, including the ones
+ * inserted by the last recompute, and deleted ones do, to find out which
+ * load balancers they belong to. */
+static bool
+northd_sb_load_balancer_handler(struct engine_node *node,
+                                void *data OVS_UNUSED)
+{
+    const struct sbrec_load_balancer_table *sb_lb_table =
+        EN_OVSDB_GET(engine_get_input("SB_load_balancer", node));
+
+    const struct sbrec_load_balancer *sbrec_lb;
+    SBREC_LOAD_BALANCER_TABLE_FOR_EACH_TRACKED (sbrec_lb, sb_lb_table) {
+        if (sbrec_load_balancer_is_new(sbrec_lb)
+            || sbrec_load_balancer_is_deleted(sbrec_lb)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Datapath_Binding records are only written by ovn-northd, so the changes
+ * tracked here are the ones committed by the last recompute.  The IDL frees
+ * the rows that a transaction inserts once it is committed and creates new
+ * ones when the database reports them, so the data has to point to the new
+ * rows.  Records that are deleted while the data still refers to them
+ * require a recompute. */
+static bool
+northd_sb_datapath_binding_handler(struct engine_node *node, void *data_)
+{
+    struct northd_data *data = data_;
+    const struct sbrec_datapath_binding_table *sb_dp_table =
+        EN_OVSDB_GET(engine_get_input("SB_datapath_binding", node));
+
+    const struct sbrec_datapath_binding *sb;
+    SBREC_DATAPATH_BINDING_TABLE_FOR_EACH_TRACKED (sb, sb_dp_table) {
+        struct ovn_datapath *od = ovn_datapath_from_sbrec(&data->datapaths,
+                                                          sb);
+        if (sbrec_datapath_binding_is_deleted(sb)) {
+            if (od && od->sb == sb) {
+                return false;
+            }
+        } else if (sbrec_datapath_binding_is_new(sb)) {
+            if (!od) {
+                return false;
+            }
+
+            /* The load balancers refer to the southbound records of their
+             * logical switches too.  Only the addresses of the freed rows
+             * are compared here. */
+            struct ovn_northd_lb *lb;
+            HMAP_FOR_EACH (lb, hmap_node, &data->lbs) {
+                for (size_t i = 0; i < lb->n_dps; i++) {
+                    if (lb->dps[i] == od->sb) {
+                        lb->dps[i] = sb;
+                    }
+                }
+            }
+            od->sb = sb;
+        }
+    }
+    return true;
+}
+
+/* Same as northd_sb_datapath_binding_handler(), for the Port_Binding records.
+ * ovn-controller also updates them, the "chassis" and "virtual_parent"
+ * columns are used to build the data and the logical flows of virtual ports,
+ * whereas "up" is only handled by ovnsb_db_run(). */
+static bool
+northd_sb_port_binding_handler(struct engine_node *node, void *data_)
+{
+    struct northd_data *data = data_;
+    const struct sbrec_port_binding_table *sb_pb_table =
+        EN_OVSDB_GET(engine_get_input("SB_port_binding", node));
+
+    const struct sbrec_port_binding *sb;
+    SBREC_PORT_BINDING_TABLE_FOR_EACH_TRACKED (sb, sb_pb_table) {
+        struct ovn_port *op = ovn_port_find(&data->ports, sb->logical_port);
+        if (sbrec_port_binding_is_deleted(sb)) {
+            if (op && op->sb == sb) {
+                return false;
+            }
+        } else if (sbrec_port_binding_is_new(sb)) {
+            if (!op) {
+                return false;
+            }
+            op->sb = sb;
+        } else if (sbrec_port_binding_is_updated(
+                       sb, SBREC_PORT_BINDING_COL_CHASSIS)
+                   || sbrec_port_binding_is_updated(
+                       sb, SBREC_PORT_BINDING_COL_VIRTUAL_PARENT)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Returns the logical switch IGMP group of 'data' that 'sb_igmp' belongs
+ * to, or NULL if there is none or if build_mcast_groups() would purge or
+ * skip 'sb_igmp'. */
+static struct ovn_igmp_group *
+northd_igmp_group_from_sbrec(struct northd_data *data,
+                             const struct sbrec_igmp_group *sb_igmp)
+{
+    if (!sb_igmp->chassis || !sb_igmp->datapath) {
+        return NULL;
+    }
+
+    struct ovn_datapath *od = ovn_datapath_from_sbrec(&data->datapaths,
+                                                      sb_igmp->datapath);
+    if (!od || ovn_datapath_is_stale(od) || !od->nbs) {
+        return NULL;
+    }
+
+    struct in6_addr address;
+    if (!ovn_igmp_group_get_address(sb_igmp, &address)) {
+        return NULL;
+    }
+    return ovn_igmp_group_find(&data->igmp_groups, od, &address);
+}
+
+/* Adds to 'mcast_groups' the multicast group of the logical switch IGMP
+ * group 'igmp_group', with the ports that build_mcast_groups() would
+ * aggregate from all its southbound IGMP_Group records.  Returns false if
+ * the group would not exist anymore. */
+static bool
+northd_igmp_group_add_ports(struct northd_context *ctx,
+                            struct northd_data *data,
+                            struct ovn_igmp_group *igmp_group,
+                            struct hmap *mcast_groups)
+{
+    struct ovn_datapath *od = igmp_group->datapath;
+    const struct sbrec_igmp_group *sb_igmp;
+    bool valid = true;
+
+    struct sbrec_igmp_group *target =
+        sbrec_igmp_group_index_init_row(ctx->sbrec_igmp_group_by_addr_dp);
+    sbrec_igmp_group_index_set_address(target, igmp_group->mcgroup.name);
+    sbrec_igmp_group_index_set_datapath(target, od->sb);
+    SBREC_IGMP_GROUP_FOR_EACH_EQUAL (sb_igmp, target,
+                                     ctx->sbrec_igmp_group_by_addr_dp) {
+        if (!sb_igmp->chassis) {
+            valid = false;
+            break;
+        }
+
+        size_t n_igmp_ports;
+        struct ovn_port **igmp_ports =
+            ovn_igmp_group_get_ports(sb_igmp, &n_igmp_ports, &data->ports);
+        if (igmp_ports) {
+            ovn_multicast_add_ports(mcast_groups, od, &igmp_group->mcgroup,
+                                    igmp_ports, n_igmp_ports);
+            free(igmp_ports);
+        }
+    }
+    sbrec_igmp_group_index_destroy_row(target);
+
+    if (!valid
+        || !ovn_multicast_find(mcast_groups, od, &igmp_group->mcgroup)) {
+        return false;
+    }
+
+    if (od->n_localnet_ports) {
+        ovn_multicast_add_ports(mcast_groups, od, &igmp_group->mcgroup,
+                                od->localnet_ports, od->n_localnet_ports);
+    }
+    return true;
+}
+
+/* IGMP_Group records are written by ovn-controller as hosts join and leave
+ * multicast groups.  As long as the set of groups of the logical switches
+ * stays the same, only the ports of their southbound Multicast_Group
+ * records change, so these are updated directly.  The groups of the
+ * logical routers with relay enabled only depend on which groups exist.
+ * New or removed groups change the logical flows and require a
+ * recompute. */
+static bool
+northd_sb_igmp_group_handler(struct engine_node *node, void *data_)
+{
+    const struct engine_context *eng_ctx = engine_get_context();
+    struct northd_context *ctx = eng_ctx->client_ctx;
+    struct northd_data *data = data_;
+
+    if (!ctx->ovnsb_txn) {
+        return false;
+    }
+
+    const struct sbrec_igmp_group_table *sb_igmp_table =
+        EN_OVSDB_GET(engine_get_input("SB_igmp_group", node));
+
+    struct hmapx igmp_groups = HMAPX_INITIALIZER(&igmp_groups);
+    const struct sbrec_igmp_group *sb_igmp;
+    SBREC_IGMP_GROUP_TABLE_FOR_EACH_TRACKED (sb_igmp, sb_igmp_table) {
+        struct ovn_igmp_group *igmp_group =
+            northd_igmp_group_from_sbrec(data, sb_igmp);
+        if (!igmp_group) {
+            hmapx_destroy(&igmp_groups);
+            return false;
+        }
+        hmapx_add(&igmp_groups, igmp_group);
+    }
+
+    struct hmap mcast_groups = HMAP_INITIALIZER(&mcast_groups);
+    struct hmapx_node *hmapx_node;
+    bool handled = true;
+    HMAPX_FOR_EACH (hmapx_node, &igmp_groups) {
+        if (!northd_igmp_group_add_ports(ctx, data, hmapx_node->data,
+                                         &mcast_groups)) {
+            handled = false;
+            break;
+        }
+    }
+    hmapx_destroy(&igmp_groups);
+
+    /* Check that all the records exist before updating any of them. */
+    struct ovn_multicast *mc, *next_mc;
+    if (handled) {
+        HMAP_FOR_EACH (mc, hmap_node, &mcast_groups) {
+            if (!mcast_group_lookup(ctx->sbrec_mcast_group_by_name_dp,
+                                    mc->group->name, mc->datapath->sb)) {
+                handled = false;
+                break;
+            }
+        }
+    }
+
+    HMAP_FOR_EACH_SAFE (mc, next_mc, hmap_node, &mcast_groups) {
+        if (handled) {
+            const struct sbrec_multicast_group *sbmc =
+                mcast_group_lookup(ctx->sbrec_mcast_group_by_name_dp,
+                                   mc->group->name, mc->datapath->sb);
+            ovn_multicast_update_sbrec(mc, sbmc);
+        }
+        ovn_multicast_destroy(&mcast_groups, mc);
+    }
+    hmap_destroy(&mcast_groups);
+
+    /* The "northd" data itself is unchanged. */
+    return handled;
+}
+
+/* Address sets don't affect the "northd" data, only their southbound copies
+ * need to be updated. */
+static bool
+northd_nb_address_set_handler(struct engine_node *node OVS_UNUSED,
+                              void *data OVS_UNUSED)
+{
+    const struct engine_context *eng_ctx = engine_get_context();
+    struct northd_context *ctx = eng_ctx->client_ctx;
+
+    if (!ctx->ovnsb_txn) {
+        return false;
+    }
+    sync_address_sets(ctx);
+    return true;
+}
+
+struct lflow_data {
+    /* Logical switches whose ACL flows were already updated incrementally
+     * during the current engine run. */
+    struct hmapx updated_lswitches;
+};
+
+static void *
+en_lflow_init(struct engine_node *node OVS_UNUSED,
+              struct engine_arg *arg OVS_UNUSED)
+{
+    struct lflow_data *data = xmalloc(sizeof *data);
+
+    hmapx_init(&data->updated_lswitches);
+    return data;
+}
+
+static void
+en_lflow_clear_tracked_data(void *data_)
+{
+    struct lflow_data *data = data_;
+
+    hmapx_clear(&data->updated_lswitches);
+}
+
+static void
+en_lflow_cleanup(void *data_)
+{
+    struct lflow_data *data = data_;
+
+    hmapx_destroy(&data->updated_lswitches);
+}
+
+static void
+en_lflow_run(struct engine_node *node, void *data OVS_UNUSED)
+{
+    const struct engine_context *eng_ctx = engine_get_context();
+    struct northd_context *ctx = eng_ctx->client_ctx;
+    struct northd_data *northd_data = engine_get_input_data("northd", node);
+    struct hmap bfd_connections = HMAP_INITIALIZER(&bfd_connections);
+
+    build_bfd_table(ctx, &bfd_connections, &northd_data->ports);
+    stopwatch_start(BUILD_LFLOWS_STOPWATCH_NAME, time_msec());
+    build_lflows(ctx, &northd_data->datapaths, &northd_data->ports,
+                 &northd_data->port_groups, &northd_data->igmp_groups,
+                 &northd_data->meter_groups, &northd_data->lbs,
+                 &bfd_connections);
+    stopwatch_stop(BUILD_LFLOWS_STOPWATCH_NAME, time_msec());
+    bfd_cleanup_connections(ctx, &bfd_connections);
+    hmap_destroy(&bfd_connections);
+    sync_meters(ctx, &northd_data->meter_groups);
+
+    engine_set_node_state(node, EN_UPDATED);
+}
+
+/* Updates the ACL flows of the logical switches in 'ods' that were not
+ * already updated during this engine run. */
+static void
+lflow_update_lswitch_acls(struct engine_node *node, struct lflow_data *data,
+                          struct hmapx *ods)
+{
+    const struct engine_context *eng_ctx = engine_get_context();
+    struct northd_context *ctx = eng_ctx->client_ctx;
+    struct northd_data *northd_data = engine_get_input_data("northd", node);
+
+    struct hmapx_node *od_node, *next_od_node;
+    HMAPX_FOR_EACH_SAFE (od_node, next_od_node, ods) {
+        if (!hmapx_add(&data->updated_lswitches, od_node->data)) {
+            hmapx_delete(ods, od_node);
+        }
+    }
+    if (hmapx_is_empty(ods)) {
+        return;
+    }
+
+    update_lswitch_acl_lflows(ctx, ods, &northd_data->port_groups,
+                              &northd_data->meter_groups, &northd_data->lbs);
+    engine_set_node_state(node, EN_UPDATED);
+}
+
+/* The incremental handlers below update the flows of one logical switch at a
+ * time, which requires a southbound transaction and logical flows that are
+ * not shared across datapaths.  The logical flow budgets are only checked by
+ * full builds. */
+static bool
+lflow_can_update_lswitches(void)
+{
+    const struct engine_context *eng_ctx = engine_get_context();
+
+    return eng_ctx->ovnsb_idl_txn && !use_logical_dp_groups
+           && !lflow_budget_soft && !lflow_budget_hard;
+}
+
+static bool
+lflow_nb_logical_switch_handler(struct engine_node *node, void *data)
+{
+    if (!lflow_can_update_lswitches()) {
+        return false;
+    }
+
+    struct northd_data *northd_data = engine_get_input_data("northd", node);
+    const struct nbrec_logical_switch_table *ls_table =
+        EN_OVSDB_GET(engine_get_input("NB_logical_switch", node));
+
+    struct hmapx ods = HMAPX_INITIALIZER(&ods);
+    const struct nbrec_logical_switch *ls;
+    NBREC_LOGICAL_SWITCH_TABLE_FOR_EACH_TRACKED (ls, ls_table) {
+        struct ovn_datapath *od = ovn_datapath_find(&northd_data->datapaths,
+                                                    &ls->header_.uuid);
+        if (!od) {
+            hmapx_destroy(&ods);
+            return false;
+        }
+        hmapx_add(&ods, od);
+    }
+
+    lflow_update_lswitch_acls(node, data, &ods);
+    hmapx_destroy(&ods);
+    return true;
+}
+
+/* Handles the changes tracked by the incremental handlers of the "northd"
+ * node.  Any other change to its data requires a recompute. */
+static bool
+lflow_northd_handler(struct engine_node *node, void *data)
+{
+    struct northd_data *northd_data = engine_get_input_data("northd", node);
+
+    if (!northd_data->tracked || !lflow_can_update_lswitches()) {
+        return false;
+    }
+
+    struct hmapx ods = HMAPX_INITIALIZER(&ods);
+    struct hmapx_node *od_node;
+    HMAPX_FOR_EACH (od_node, &northd_data->lb_updated_lswitches) {
+        hmapx_add(&ods, od_node->data);
+    }
+
+    lflow_update_lswitch_acls(node, data, &ods);
+    hmapx_destroy(&ods);
+    return true;
+}
+
+/* New and deleted ACLs are handled through the Logical_Switch or Port_Group
+ * row that refers to them.  Updated ones require finding those rows. */
+static bool
+lflow_nb_acl_handler(struct engine_node *node, void *data)
+{
+    if (!lflow_can_update_lswitches()) {
+        return false;
+    }
+
+    const struct nbrec_acl_table *acl_table =
+        EN_OVSDB_GET(engine_get_input("NB_acl", node));
+
+    struct hmapx acls = HMAPX_INITIALIZER(&acls);
+    const struct nbrec_acl *acl;
+    NBREC_ACL_TABLE_FOR_EACH_TRACKED (acl, acl_table) {
+        if (!nbrec_acl_is_new(acl) && !nbrec_acl_is_deleted(acl)) {
+            hmapx_add(&acls, CONST_CAST(struct nbrec_acl *, acl));
+        }
+    }
+    if (hmapx_is_empty(&acls)) {
+        hmapx_destroy(&acls);
+        return true;
+    }
+
+    struct northd_data *northd_data = engine_get_input_data("northd", node);
+    struct hmapx ods = HMAPX_INITIALIZER(&ods);
+    struct ovn_datapath *od;
+    HMAP_FOR_EACH (od, key_node, &northd_data->datapaths) {
+        if (!od->nbs) {
+            continue;
+        }
+        for (size_t i = 0; i < od->nbs->n_acls; i++) {
+            if (hmapx_contains(&acls, od->nbs->acls[i])) {
+                hmapx_add(&ods, od);
+                break;
+            }
+        }
+
+        struct ovn_ls_port_group *ls_pg;
+        HMAP_FOR_EACH (ls_pg, key_node, &od->nb_pgs) {
+            for (size_t i = 0; i < ls_pg->nb_pg->n_acls; i++) {
+                if (hmapx_contains(&acls, ls_pg->nb_pg->acls[i])) {
+                    hmapx_add(&ods, od);
+                    break;
+                }
+            }
+        }
+    }
+    hmapx_destroy(&acls);
+
+    lflow_update_lswitch_acls(node, data, &ods);
+    hmapx_destroy(&ods);
+    return true;
+}
+
+/* Same as lflow_nb_acl_handler(), for QoS rules. */
+static bool
+lflow_nb_qos_handler(struct engine_node *node, void *data)
+{
+    if (!lflow_can_update_lswitches()) {
+        return false;
+    }
+
+    const struct nbrec_qos_table *qos_table =
+        EN_OVSDB_GET(engine_get_input("NB_qos", node));
+
+    struct hmapx qos_rules = HMAPX_INITIALIZER(&qos_rules);
+    const struct nbrec_qos *qos;
+    NBREC_QOS_TABLE_FOR_EACH_TRACKED (qos, qos_table) {
+        if (!nbrec_qos_is_new(qos) && !nbrec_qos_is_deleted(qos)) {
+            hmapx_add(&qos_rules, CONST_CAST(struct nbrec_qos *, qos));
+        }
+    }
+    if (hmapx_is_empty(&qos_rules)) {
+        hmapx_destroy(&qos_rules);
+        return true;
+    }
+
+    struct northd_data *northd_data = engine_get_input_data("northd", node);
+    struct hmapx ods = HMAPX_INITIALIZER(&ods);
+    struct ovn_datapath *od;
+    HMAP_FOR_EACH (od, key_node, &northd_data->datapaths) {
+        if (!od->nbs) {
+            continue;
+        }
+        for (size_t i = 0; i < od->nbs->n_qos_rules; i++) {
+            if (hmapx_contains(&qos_rules, od->nbs->qos_rules[i])) {
+                hmapx_add(&ods, od);
+                break;
+            }
+        }
+    }
+    hmapx_destroy(&qos_rules);
+
+    lflow_update_lswitch_acls(node, data, &ods);
+    hmapx_destroy(&ods);
+    return true;
+}
+
+static bool
+lflow_nb_port_group_handler(struct engine_node *node, void *data)
+{
+    if (!lflow_can_update_lswitches()) {
+        return false;
+    }
+
+    struct northd_data *northd_data = engine_get_input_data("northd", node);
+    const struct nbrec_port_group_table *pg_table =
+        EN_OVSDB_GET(engine_get_input("NB_port_group", node));
+
+    struct hmapx ods = HMAPX_INITIALIZER(&ods);
+    const struct nbrec_port_group *nb_pg;
+    NBREC_PORT_GROUP_TABLE_FOR_EACH_TRACKED (nb_pg, pg_table) {
+        struct ovn_port_group *pg
+            = ovn_port_group_find(&northd_data->port_groups,
+                                  &nb_pg->header_.uuid);
+        if (!pg) {
+            hmapx_destroy(&ods);
+            return false;
+        }
+
+        struct ovn_port_group_ls *pg_ls;
+        HMAP_FOR_EACH (pg_ls, key_node, &pg->nb_lswitches) {
+            hmapx_add(&ods, pg_ls->od);
+        }
+    }
+
+    lflow_update_lswitch_acls(node, data, &ods);
+    hmapx_destroy(&ods);
+    return true;
+}
+
+/* Logical flows only refer to meters by name, so band changes only need the
+ * southbound meters to be updated. */
+static bool
+lflow_nb_meter_band_handler(struct engine_node *node, void *data OVS_UNUSED)
+{
+    const struct engine_context *eng_ctx = engine_get_context();
+    struct northd_context *ctx = eng_ctx->client_ctx;
+    struct northd_data *northd_data = engine_get_input_data("northd", node);
+
+    if (!ctx->ovnsb_txn) {
+        return false;
+    }
+    sync_meters(ctx, &northd_data->meter_groups);
+    return true;
+}
+
+/* Logical flows only refer to address sets by name, so only renames require
+ * rebuilding them. */
+static bool
+lflow_nb_address_set_handler(struct engine_node *node, void *data OVS_UNUSED)
+{
+    const struct nbrec_address_set_table *as_table =
+        EN_OVSDB_GET(engine_get_input("NB_address_set", node));
+
+    const struct nbrec_address_set *as;
+    NBREC_ADDRESS_SET_TABLE_FOR_EACH_TRACKED (as, as_table) {
+        if (!nbrec_address_set_is_new(as)
+            && !nbrec_address_set_is_deleted(as)
+            && nbrec_address_set_is_updated(as, NBREC_ADDRESS_SET_COL_NAME)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static void
 parse_options(int argc OVS_UNUSED, char *argv[] OVS_UNUSED,
               bool *paused)
@@ -14144,6 +16376,12 @@ main(int argc, char *argv[])
     unixctl_command_register("is-paused", "", 0, 0, ovn_northd_is_paused,
                              &state);
     unixctl_command_register("status", "", 0, 0, ovn_northd_status, &state);
+    unixctl_command_register("stage-stats", "", 0, 0, ovn_northd_stage_stats,
+                             NULL);
+    unixctl_command_register("datapath-stats", "", 0, 0,
+                             ovn_northd_datapath_stats, NULL);
+    unixctl_command_register("partition-stats", "", 0, 0,
+                             ovn_northd_partition_stats, NULL);
 
     bool reset_ovnsb_idl_min_index = false;
     unixctl_command_register("sb-cluster-state-reset", "", 0, 0,
@@ -14157,7 +16395,6 @@ main(int argc, char *argv[])
 
     daemonize_complete();
 
-    init_hash_row_locks(&lflow_locks);
     use_parallel_build = can_parallelize_hashes(false);
 
     /* We want to detect (almost) all changes to the ovn-nb db. */
@@ -14418,12 +16655,110 @@ main(int argc, char *argv[])
     struct ovsdb_idl_index *sbrec_ip_mcast_by_dp
         = ip_mcast_index_create(ovnsb_idl_loop.idl);
 
+    struct ovsdb_idl_index *sbrec_igmp_group_by_addr_dp
+        = ovsdb_idl_index_create2(ovnsb_idl_loop.idl,
+                                  &sbrec_igmp_group_col_address,
+                                  &sbrec_igmp_group_col_datapath);
+
+    struct ovsdb_idl_index *sbrec_lflow_by_datapath
+        = ovsdb_idl_index_create1(ovnsb_idl_loop.idl,
+                                  &sbrec_logical_flow_col_logical_datapath);
+
     unixctl_command_register("sb-connection-status", "", 0, 0,
                              ovn_conn_show, ovnsb_idl_loop.idl);
 
+    ovsdb_idl_track_add_all(ovnnb_idl_loop.idl);
+    ovsdb_idl_track_add_all(ovnsb_idl_loop.idl);
+
+    /* Define inc-proc-engine nodes. */
+    ENGINE_NODE_WITH_CLEAR_TRACK_DATA(northd, "northd");
+    ENGINE_NODE_WITH_CLEAR_TRACK_DATA(lflow, "lflow");
+
+#define NB_NODE(NAME, NAME_STR) ENGINE_NODE_NB(NAME, NAME_STR);
+    NB_NODES
+#undef NB_NODE
+
+#define SB_NODE(NAME, NAME_STR) ENGINE_NODE_SB(NAME, NAME_STR);
+    SB_NODES
+#undef SB_NODE
+
+    /* Add dependencies between inc-proc-engine nodes. */
+    engine_add_input(&en_northd, &en_nb_nb_global,
+                     northd_nb_nb_global_handler);
+    engine_add_input(&en_northd, &en_nb_logical_switch,
+                     northd_nb_logical_switch_handler);
+    engine_add_input(&en_northd, &en_nb_logical_switch_port,
+                     northd_nb_logical_switch_port_handler);
+    engine_add_input(&en_northd, &en_nb_load_balancer,
+                     northd_nb_load_balancer_handler);
+    engine_add_input(&en_northd, &en_nb_load_balancer_health_check, NULL);
+    engine_add_input(&en_northd, &en_nb_acl, engine_noop_handler);
+    engine_add_input(&en_northd, &en_nb_logical_router, NULL);
+    engine_add_input(&en_northd, &en_nb_qos, engine_noop_handler);
+    engine_add_input(&en_northd, &en_nb_meter, NULL);
+    engine_add_input(&en_northd, &en_nb_meter_band, engine_noop_handler);
+    engine_add_input(&en_northd, &en_nb_logical_router_port, NULL);
+    engine_add_input(&en_northd, &en_nb_logical_router_static_route, NULL);
+    engine_add_input(&en_northd, &en_nb_logical_router_policy, NULL);
+    engine_add_input(&en_northd, &en_nb_nat, NULL);
+    engine_add_input(&en_northd, &en_nb_dhcp_options, NULL);
+    engine_add_input(&en_northd, &en_nb_address_set,
+                     northd_nb_address_set_handler);
+    engine_add_input(&en_northd, &en_nb_port_group,
+                     northd_nb_port_group_handler);
+    engine_add_input(&en_northd, &en_nb_dns, NULL);
+    engine_add_input(&en_northd, &en_nb_forwarding_group, NULL);
+    engine_add_input(&en_northd, &en_nb_gateway_chassis, NULL);
+    engine_add_input(&en_northd, &en_nb_ha_chassis_group, NULL);
+    engine_add_input(&en_northd, &en_nb_ha_chassis, NULL);
+
+    engine_add_input(&en_northd, &en_sb_chassis, NULL);
+    engine_add_input(&en_northd, &en_sb_encap, NULL);
+    engine_add_input(&en_northd, &en_sb_datapath_binding,
+                     northd_sb_datapath_binding_handler);
+    engine_add_input(&en_northd, &en_sb_port_binding,
+                     northd_sb_port_binding_handler);
+    engine_add_input(&en_northd, &en_sb_ha_chassis_group, NULL);
+    engine_add_input(&en_northd, &en_sb_igmp_group,
+                     northd_sb_igmp_group_handler);
+    engine_add_input(&en_northd, &en_sb_load_balancer,
+                     northd_sb_load_balancer_handler);
+    engine_add_input(&en_northd, &en_sb_service_monitor, NULL);
+
+    engine_add_input(&en_lflow, &en_northd, lflow_northd_handler);
+    engine_add_input(&en_lflow, &en_nb_logical_switch,
+                     lflow_nb_logical_switch_handler);
+    engine_add_input(&en_lflow, &en_nb_acl, lflow_nb_acl_handler);
+    engine_add_input(&en_lflow, &en_nb_qos, lflow_nb_qos_handler);
+    engine_add_input(&en_lflow, &en_nb_meter_band,
+                     lflow_nb_meter_band_handler);
+    engine_add_input(&en_lflow, &en_nb_port_group,
+                     lflow_nb_port_group_handler);
+    engine_add_input(&en_lflow, &en_nb_address_set,
+                     lflow_nb_address_set_handler);
+    engine_add_input(&en_lflow, &en_nb_bfd, NULL);
+    engine_add_input(&en_lflow, &en_sb_bfd, NULL);
+
+    struct engine_arg engine_arg = {
+        .nb_idl = ovnnb_idl_loop.idl,
+        .sb_idl = ovnsb_idl_loop.idl,
+    };
+    engine_init(&en_lflow, &engine_arg);
+
     char *ovn_internal_version = ovn_get_internal_version();
     VLOG_INFO("OVN internal version is : [%s]", ovn_internal_version);
 
+    stopwatch_create(OVNNB_DB_RUN_STOPWATCH_NAME, SW_MS);
+    stopwatch_create(BUILD_DATAPATHS_STOPWATCH_NAME, SW_MS);
+    stopwatch_create(BUILD_PORTS_STOPWATCH_NAME, SW_MS);
+    stopwatch_create(BUILD_LBS_STOPWATCH_NAME, SW_MS);
+    stopwatch_create(BUILD_LFLOWS_STOPWATCH_NAME, SW_MS);
+    stopwatch_create(OVNSB_DB_RUN_STOPWATCH_NAME, SW_MS);
+    stopwatch_create(OVNSB_COMMIT_STOPWATCH_NAME, SW_MS);
+
+    unsigned int ovnnb_cond_seqno = UINT_MAX;
+    unsigned int ovnsb_cond_seqno = UINT_MAX;
+
     /* Main loop. */
     exiting = false;
 
@@ -14438,6 +16773,7 @@ main(int argc, char *argv[])
             simap_destroy(&usage);
         }
 
+        bool keep_tracked_changes = false;
         if (!state.paused) {
             if (!ovsdb_idl_has_lock(ovnsb_idl_loop.idl) &&
                 !ovsdb_idl_is_lock_contended(ovnsb_idl_loop.idl))
@@ -14459,12 +16795,38 @@ main(int argc, char *argv[])
                 .sbrec_ha_chassis_grp_by_name = sbrec_ha_chassis_grp_by_name,
                 .sbrec_mcast_group_by_name_dp = sbrec_mcast_group_by_name_dp,
                 .sbrec_ip_mcast_by_dp = sbrec_ip_mcast_by_dp,
+                .sbrec_igmp_group_by_addr_dp = sbrec_igmp_group_by_addr_dp,
+                .sbrec_lflow_by_datapath = sbrec_lflow_by_datapath,
+                .ovn_internal_version = ovn_internal_version,
             };
 
+            unsigned int new_ovnnb_cond_seqno
+                = ovsdb_idl_get_condition_seqno(ovnnb_idl_loop.idl);
+            if (new_ovnnb_cond_seqno != ovnnb_cond_seqno) {
+                if (!new_ovnnb_cond_seqno) {
+                    VLOG_INFO("OVNNB IDL reconnected, force recompute.");
+                    engine_set_force_recompute(true);
+                }
+                ovnnb_cond_seqno = new_ovnnb_cond_seqno;
+            }
+
+            unsigned int new_ovnsb_cond_seqno
+                = ovsdb_idl_get_condition_seqno(ovnsb_idl_loop.idl);
+            if (new_ovnsb_cond_seqno != ovnsb_cond_seqno) {
+                if (!new_ovnsb_cond_seqno) {
+                    VLOG_INFO("OVNSB IDL reconnected, force recompute.");
+                    engine_set_force_recompute(true);
+                }
+                ovnsb_cond_seqno = new_ovnsb_cond_seqno;
+            }
+
             if (!state.had_lock && ovsdb_idl_has_lock(ovnsb_idl_loop.idl)) {
                 VLOG_INFO("ovn-northd lock acquired. "
                         "This ovn-northd instance is now active.");
                 state.had_lock = true;
+
+                /* Changes were not processed while on standby. */
+                engine_set_force_recompute(true);
             } else if (state.had_lock &&
                        !ovsdb_idl_has_lock(ovnsb_idl_loop.idl))
             {
@@ -14474,8 +16836,61 @@ main(int argc, char *argv[])
             }
 
             if (ovsdb_idl_has_lock(ovnsb_idl_loop.idl)) {
-                ovn_db_run(&ctx, sbrec_chassis_by_name, &ovnsb_idl_loop,
-                           ovn_internal_version);
+                int64_t loop_start_time = time_wall_msec();
+                struct engine_context eng_ctx = {
+                    .ovnnb_idl_txn = ctx.ovnnb_txn,
+                    .ovnsb_idl_txn = ctx.ovnsb_txn,
+                    .client_ctx = &ctx,
+                };
+
+                engine_init_run();
+                engine_set_context(&eng_ctx);
+
+                /* A recompute writes to both databases, so it is only allowed
+                 * when both transactions are available.  Otherwise the engine
+                 * still processes the changes it can handle incrementally and
+                 * aborts if a recompute is needed, unless the changes are
+                 * deferred until the transactions in flight complete.  Their
+                 * completion wakes us up, and the changes accumulated in the
+                 * IDLs are then processed together. */
+                bool recompute_allowed = ctx.ovnnb_txn && ctx.ovnsb_txn;
+                if (!recompute_allowed && defer_changes_during_commit) {
+                    keep_tracked_changes = true;
+                } else {
+                    engine_run(recompute_allowed);
+                }
+
+                /* There is no need to wake up immediately when the engine
+                 * can't run: a transaction is in flight and its completion
+                 * will wake us up. */
+                if (keep_tracked_changes) {
+                    VLOG_DBG("transaction in flight, engine run deferred");
+                } else if (!engine_has_run()) {
+                    if (engine_need_run()) {
+                        VLOG_DBG("engine did not run, force recompute next "
+                                 "time");
+                        engine_set_force_recompute(true);
+                    } else {
+                        VLOG_DBG("engine did not run, and it was not needed");
+                    }
+                } else if (engine_aborted()) {
+                    VLOG_DBG("engine was aborted, force recompute next time");
+                    engine_set_force_recompute(true);
+                } else {
+                    engine_set_force_recompute(false);
+                }
+
+                struct northd_data *northd_data = NULL;
+                if (recompute_allowed) {
+                    sync_nb_cfg(&ctx, &ovnsb_idl_loop, loop_start_time);
+                    northd_data = engine_get_data(&en_northd);
+                }
+                stopwatch_start(OVNSB_DB_RUN_STOPWATCH_NAME, time_msec());
+                ovnsb_db_run(&ctx, &ovnsb_idl_loop,
+                             northd_data ? &northd_data->ports : NULL,
+                             loop_start_time);
+                stopwatch_stop(OVNSB_DB_RUN_STOPWATCH_NAME, time_msec());
+
                 if (ctx.ovnsb_txn) {
                     check_and_add_supported_dhcp_opts_to_sb_db(&ctx);
                     check_and_add_supported_dhcpv6_opts_to_sb_db(&ctx);
@@ -14483,8 +16898,16 @@ main(int argc, char *argv[])
                 }
             }
 
-            ovsdb_idl_loop_commit_and_wait(&ovnnb_idl_loop);
-            ovsdb_idl_loop_commit_and_wait(&ovnsb_idl_loop);
+            if (!ovsdb_idl_loop_commit_and_wait(&ovnnb_idl_loop)) {
+                VLOG_INFO("OVNNB commit failed, force recompute next time.");
+                engine_set_force_recompute(true);
+            }
+            stopwatch_start(OVNSB_COMMIT_STOPWATCH_NAME, time_msec());
+            if (!ovsdb_idl_loop_commit_and_wait(&ovnsb_idl_loop)) {
+                VLOG_INFO("OVNSB commit failed, force recompute next time.");
+                engine_set_force_recompute(true);
+            }
+            stopwatch_stop(OVNSB_COMMIT_STOPWATCH_NAME, time_msec());
         } else {
             /* ovn-northd is paused
              *    - we still want to handle any db updates and update the
@@ -14507,6 +16930,11 @@ main(int argc, char *argv[])
             ovsdb_idl_wait(ovnsb_idl_loop.idl);
         }
 
+        if (!keep_tracked_changes) {
+            ovsdb_idl_track_clear(ovnnb_idl_loop.idl);
+            ovsdb_idl_track_clear(ovnsb_idl_loop.idl);
+        }
+
         unixctl_server_run(unixctl);
         unixctl_server_wait(unixctl);
         memory_wait();
@@ -14539,6 +16967,10 @@ main(int argc, char *argv[])
     }
 
 
+    engine_set_context(NULL);
+    engine_cleanup();
+    destroy_acl_lflows_cache();
+
     free(ovn_internal_version);
     unixctl_server_destroy(unixctl);
     ovsdb_idl_loop_destroy(&ovnnb_idl_loop);
@@ -14613,6 +17045,68 @@ ovn_northd_status(struct unixctl_conn *conn, int argc OVS_UNUSED,
     ds_destroy(&s);
 }
 
+static void
+ovn_northd_stage_stats(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                       const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+{
+    struct ds s = DS_EMPTY_INITIALIZER;
+    size_t total = 0;
+    size_t total_bytes = 0;
+
+#define PIPELINE_STAGE(DP_TYPE, PIPELINE, STAGE, TABLE, NAME)              \
+    ds_put_format(&s, "%-28s %-8"PRIuSIZE" %"PRIuSIZE"\n", NAME,           \
+                  lflows_per_stage[S_##DP_TYPE##_##PIPELINE##_##STAGE],     \
+                  lflow_bytes_per_stage[S_##DP_TYPE##_##PIPELINE##_##STAGE]);\
+    total += lflows_per_stage[S_##DP_TYPE##_##PIPELINE##_##STAGE];          \
+    total_bytes += lflow_bytes_per_stage[S_##DP_TYPE##_##PIPELINE##_##STAGE];
+    PIPELINE_STAGES
+#undef PIPELINE_STAGE
+    ds_put_format(&s, "%-28s %-8"PRIuSIZE" %"PRIuSIZE"\n", "total", total,
+                  total_bytes);
+
+    unixctl_command_reply(conn, ds_cstr(&s));
+    ds_destroy(&s);
+}
+
+static void
+ovn_northd_datapath_stats(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                          const char *argv[] OVS_UNUSED,
+                          void *aux OVS_UNUSED)
+{
+    struct ds s = DS_EMPTY_INITIALIZER;
+
+    for (size_t i = 0; i < n_lflow_top_datapaths; i++) {
+        const struct lflow_dp_stats *stats = &lflow_top_datapaths[i];
+
+        ds_put_format(&s, UUID_FMT" %-28s %-8"PRIuSIZE" %"PRIuSIZE"\n",
+                      UUID_ARGS(&stats->key), stats->name, stats->n_lflows,
+                      stats->n_bytes);
+    }
+
+    unixctl_command_reply(conn, ds_cstr(&s));
+    ds_destroy(&s);
+}
+
+static void
+ovn_northd_partition_stats(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                           const char *argv[] OVS_UNUSED,
+                           void *aux OVS_UNUSED)
+{
+    struct ds s = DS_EMPTY_INITIALIZER;
+
+    ds_put_format(&s, "partitions: %"PRIuSIZE", logical flows: %"PRIuSIZE
+                  "\n", n_lflow_partitions, n_lflows_total);
+    for (size_t i = 0; i < n_lflow_top_partitions; i++) {
+        const struct lflow_partition_stats *stats = &lflow_top_partitions[i];
+
+        ds_put_format(&s, "%-28s datapaths=%"PRIuSIZE" lflows=%"PRIuSIZE"\n",
+                      stats->name, stats->n_datapaths, stats->n_lflows);
+    }
+
+    unixctl_command_reply(conn, ds_cstr(&s));
+    ds_destroy(&s);
+}
+
 static void
 cluster_state_reset_cmd(struct unixctl_conn *conn, int argc OVS_UNUSED,
                const char *argv[] OVS_UNUSED, void *idl_reset_)
@@ -4,9 +4,11 @@ EXTRA_DIST += \
 	$(SYSTEM_TESTSUITE_AT) \
 	$(SYSTEM_KMOD_TESTSUITE_AT) \
 	$(SYSTEM_USERSPACE_TESTSUITE_AT) \
+	$(PERF_TESTSUITE_AT) \
 	$(TESTSUITE) \
 	$(SYSTEM_KMOD_TESTSUITE) \
 	$(SYSTEM_USERSPACE_TESTSUITE) \
+	$(PERF_TESTSUITE) \
 	tests/atlocal.in \
 	$(srcdir)/package.m4 \
 	$(srcdir)/tests/testsuite \
@@ -17,6 +19,11 @@ COMMON_MACROS_AT = \
 	tests/ovs-macros.at \
 	tests/ofproto-macros.at
 
+PERF_TESTSUITE_AT = \
+	tests/perf-testsuite.at \
+	tests/perf-northd.at \
+	tests/perf-scale.at
+
 TESTSUITE_AT = \
 	tests/testsuite.at \
 	tests/checkpatch.at \
@@ -35,6 +42,9 @@ TESTSUITE_AT = \
 	tests/ovn-ofctrl-seqno.at \
 	tests/ovn-ipam.at \
 	tests/ovn-lflow-cache.at \
+	tests/ovn-lflow-conj-ids.at \
+	tests/ovn-timer-wheel.at \
+	tests/ovn-mac-learn.at \
 	tests/ovn-ipsec.at
 
 SYSTEM_KMOD_TESTSUITE_AT = \
@@ -59,6 +69,9 @@ TESTSUITE_PATCH = $(srcdir)/tests/testsuite.patch
 TESTSUITE_DIR = $(abs_top_builddir)/tests/testsuite.dir
 SYSTEM_KMOD_TESTSUITE = $(srcdir)/tests/system-kmod-testsuite
 SYSTEM_USERSPACE_TESTSUITE = $(srcdir)/tests/system-userspace-testsuite
+PERF_TESTSUITE = $(srcdir)/tests/perf-testsuite
+PERF_TESTSUITE_RESULTS = $(abs_top_builddir)/tests/perf-testsuite.results
+PERF_SCALE_RESULTS = $(abs_top_builddir)/tests/perf-scale.results
 DISTCLEANFILES += tests/atconfig tests/atlocal
 
 AUTOTEST_PATH = $(ovs_builddir)/utilities:$(ovs_builddir)/vswitchd:$(ovs_builddir)/ovsdb:$(ovs_builddir)/vtep:tests:$(PTHREAD_WIN32_DIR_DLL):$(SSL_DIR):controller-vtep:northd:utilities:controller:ic
@@ -169,8 +182,24 @@ check-system-userspace: all
 	set $(SHELL) '$(SYSTEM_USERSPACE_TESTSUITE)' -C tests  AUTOTEST_PATH='$(AUTOTEST_PATH)'; \
 	$(SUDO) "$$@" $(TESTSUITEFLAGS) -j1 || (test X'$(RECHECK)' = Xyes && $(SUDO) "$$@" --recheck)
 
+# Run the northd and scale benchmarks.  The results are written to
+# tests/perf-testsuite.results and tests/perf-scale.results.  Pass
+# PERF_SCALE_BASELINE=<file> in TESTSUITEFLAGS to compare the scale results
+# with an earlier run.
+check-perf: all
+	rm -f '$(PERF_TESTSUITE_RESULTS)' '$(PERF_SCALE_RESULTS)'
+	$(SHELL) '$(PERF_TESTSUITE)' -C tests AUTOTEST_PATH='$(AUTOTEST_PATH)' PERF_RESULTS='$(PERF_TESTSUITE_RESULTS)' PERF_SCALE_RESULTS='$(PERF_SCALE_RESULTS)' $(TESTSUITEFLAGS) -j1
+	@echo
+	@echo '----------------------------------------------------------------------'
+	@echo 'Results (test step latency-ms sb-bytes northd-rss-kB) are in'
+	@echo '$(PERF_TESTSUITE_RESULTS)'
+	@echo 'Results (scenario metric value) are in'
+	@echo '$(PERF_SCALE_RESULTS)'
+	@echo '----------------------------------------------------------------------'
+
 clean-local:
 	test ! -f '$(TESTSUITE)' || $(SHELL) '$(TESTSUITE)' -C tests --clean
+	rm -f '$(PERF_TESTSUITE_RESULTS)' '$(PERF_SCALE_RESULTS)'
 
 AUTOTEST = $(AUTOM4TE) --language=autotest
 
@@ -193,6 +222,10 @@ $(SYSTEM_USERSPACE_TESTSUITE): package.m4 $(SYSTEM_TESTSUITE_AT) $(SYSTEM_USERSP
 	$(AM_V_GEN)$(AUTOTEST) -I '$(srcdir)' -o $@.tmp $@.at
 	$(AM_V_at)mv $@.tmp $@
 
+$(PERF_TESTSUITE): package.m4 $(PERF_TESTSUITE_AT) $(COMMON_MACROS_AT) tests/ovn-macros.at
+	$(AM_V_GEN)$(AUTOTEST) -I '$(srcdir)' -o $@.tmp $@.at
+	$(AM_V_at)mv $@.tmp $@
+
 # The `:;' works around a Bash 3.2 bug when the output is not writeable.
 $(srcdir)/package.m4: $(top_srcdir)/configure.ac
 	$(AM_V_GEN):;{ \
@@ -213,11 +246,20 @@ tests_ovstest_SOURCES = \
 	tests/test-utils.h \
 	tests/test-ovn.c \
 	controller/test-lflow-cache.c \
+	controller/test-lflow-conj-ids.c \
 	controller/test-ofctrl-seqno.c \
+	controller/test-timer-wheel.c \
+	controller/test-mac-learn.c \
 	controller/lflow-cache.c \
 	controller/lflow-cache.h \
+	controller/lflow-conj-ids.c \
+	controller/lflow-conj-ids.h \
 	controller/ofctrl-seqno.c \
 	controller/ofctrl-seqno.h \
+	controller/timer-wheel.c \
+	controller/timer-wheel.h \
+	controller/mac-learn.c \
+	controller/mac-learn.h \
 	northd/test-ipam.c \
 	northd/ipam.c \
 	northd/ipam.h
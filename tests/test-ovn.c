@@ -33,11 +33,14 @@
 #include "ovn/lex.h"
 #include "ovn/logical-fields.h"
 #include "lib/ovn-l7.h"
+#include "lib/ovn-util.h"
 #include "lib/extend-table.h"
 #include "ovs-thread.h"
 #include "ovstest.h"
 #include "openvswitch/shash.h"
 #include "simap.h"
+#include "svec.h"
+#include "timeval.h"
 #include "util.h"
 #include "controller/lflow.h"
 
@@ -385,6 +388,251 @@ test_expr_to_flows(struct ovs_cmdl_context *ctx OVS_UNUSED)
     test_parse_expr__(4);
 }
 
+/* Benchmarking expression compilation. */
+
+enum benchmark_phase_type {
+    BP_LEX,
+    BP_PARSE,
+    BP_ANNOTATE,
+    BP_SIMPLIFY,
+    BP_NORMALIZE,
+    BP_TO_MATCHES,
+    BP_DESTROY,
+    N_BENCHMARK_PHASES
+};
+
+struct benchmark_phase {
+    const char *name;
+    long long int usec;         /* Total time, over all iterations. */
+    struct expr_node_stats nodes; /* Total nodes, over all iterations. */
+
+    /* At the start of the current iteration. */
+    long long int start_usec;
+    struct expr_node_stats start_nodes;
+};
+
+static void
+benchmark_phase_start(struct benchmark_phase *phase)
+{
+    expr_get_node_stats(&phase->start_nodes);
+    phase->start_usec = time_usec();
+}
+
+static void
+benchmark_phase_stop(struct benchmark_phase *phase)
+{
+    struct expr_node_stats nodes;
+
+    phase->usec += time_usec() - phase->start_usec;
+    expr_get_node_stats(&nodes);
+    phase->nodes.n_allocated += (nodes.n_allocated
+                                 - phase->start_nodes.n_allocated);
+    phase->nodes.n_reused += nodes.n_reused - phase->start_nodes.n_reused;
+}
+
+/* Adds the address set or port group defined by 'line', of the form
+ * "address_set NAME VALUE..." or "port_group NAME PORT...", to 'addr_sets'
+ * or 'port_groups'.  The ports of port groups are added to 'ports', like
+ * local ports.  Returns false if 'line' doesn't define a set. */
+static bool
+benchmark_parse_const_set(const char *line, struct shash *addr_sets,
+                          struct shash *port_groups, struct simap *ports)
+{
+    bool is_addr_set = !strncmp(line, "address_set ", 12);
+    bool is_port_group = !strncmp(line, "port_group ", 11);
+    if (!is_addr_set && !is_port_group) {
+        return false;
+    }
+
+    char *copy = xstrdup(line);
+    char *save_ptr = NULL;
+    strtok_r(copy, " ", &save_ptr);
+    char *name = strtok_r(NULL, " ,", &save_ptr);
+    if (!name) {
+        ovs_fatal(0, "%s: missing set name", line);
+    }
+
+    struct svec values = SVEC_EMPTY_INITIALIZER;
+    for (char *value = strtok_r(NULL, " ,", &save_ptr); value;
+         value = strtok_r(NULL, " ,", &save_ptr)) {
+        svec_add(&values, value);
+    }
+
+    const char *const *names = (const char *const *) values.names;
+    if (is_addr_set) {
+        expr_const_sets_add_integers(addr_sets, name, names, values.n);
+    } else {
+        /* Logical flows refer to the port groups of their datapath. */
+        char *sb_name = xasprintf("0_%s", name);
+        expr_const_sets_add_strings(port_groups, sb_name, names, values.n,
+                                    NULL);
+        free(sb_name);
+
+        for (size_t i = 0; i < values.n; i++) {
+            if (!simap_contains(ports, names[i])) {
+                simap_put(ports, names[i], 0x100 + simap_count(ports));
+            }
+        }
+    }
+    svec_destroy(&values);
+    free(copy);
+    return true;
+}
+
+static void
+test_benchmark_expr(struct ovs_cmdl_context *ctx)
+{
+    unsigned int n_iterations = 1;
+    if (ctx->argc > 1 && (!str_to_uint(ctx->argv[1], 10, &n_iterations)
+                          || !n_iterations)) {
+        ovs_fatal(0, "%s: bad number of iterations", ctx->argv[1]);
+    }
+
+    struct shash symtab;
+    struct shash addr_sets;
+    struct shash port_groups;
+    struct simap ports;
+
+    create_symtab(&symtab);
+    create_addr_sets(&addr_sets);
+    create_port_groups(&port_groups);
+
+    simap_init(&ports);
+    simap_put(&ports, "eth0", 5);
+    simap_put(&ports, "eth1", 6);
+    simap_put(&ports, "LOCAL", ofp_to_u16(OFPP_LOCAL));
+
+    struct svec corpus = SVEC_EMPTY_INITIALIZER;
+    struct ds input = DS_EMPTY_INITIALIZER;
+    while (!ds_get_test_line(&input, stdin)) {
+        if (!benchmark_parse_const_set(ds_cstr(&input), &addr_sets,
+                                       &port_groups, &ports)) {
+            svec_add(&corpus, ds_cstr(&input));
+        }
+    }
+    ds_destroy(&input);
+
+    struct benchmark_phase phases[N_BENCHMARK_PHASES] = {
+        [BP_LEX] = { .name = "lex" },
+        [BP_PARSE] = { .name = "parse" },
+        [BP_ANNOTATE] = { .name = "annotate" },
+        [BP_SIMPLIFY] = { .name = "simplify" },
+        [BP_NORMALIZE] = { .name = "normalize" },
+        [BP_TO_MATCHES] = { .name = "to_matches" },
+        [BP_DESTROY] = { .name = "destroy" },
+    };
+    size_t n = corpus.n;
+    struct expr **exprs = xmalloc(n * sizeof *exprs);
+    struct hmap *matches = xmalloc(n * sizeof *matches);
+    size_t n_errors = 0;
+    size_t n_flows = 0;
+
+    for (unsigned int iteration = 0; iteration < n_iterations; iteration++) {
+        bool first = !iteration;
+        char *error;
+
+        benchmark_phase_start(&phases[BP_LEX]);
+        for (size_t i = 0; i < n; i++) {
+            struct lexer lexer;
+
+            lexer_init(&lexer, corpus.names[i]);
+            while (lexer_get(&lexer) != LEX_T_END) {
+                continue;
+            }
+            lexer_destroy(&lexer);
+        }
+        benchmark_phase_stop(&phases[BP_LEX]);
+
+        benchmark_phase_start(&phases[BP_PARSE]);
+        for (size_t i = 0; i < n; i++) {
+            exprs[i] = expr_parse_string(corpus.names[i], &symtab,
+                                         &addr_sets, &port_groups, NULL,
+                                         NULL, 0, &error);
+            if (error) {
+                n_errors += first;
+                free(error);
+            }
+        }
+        benchmark_phase_stop(&phases[BP_PARSE]);
+
+        benchmark_phase_start(&phases[BP_ANNOTATE]);
+        for (size_t i = 0; i < n; i++) {
+            if (exprs[i]) {
+                exprs[i] = expr_annotate(exprs[i], &symtab, &error);
+                if (error) {
+                    n_errors += first;
+                    free(error);
+                }
+            }
+        }
+        benchmark_phase_stop(&phases[BP_ANNOTATE]);
+
+        benchmark_phase_start(&phases[BP_SIMPLIFY]);
+        for (size_t i = 0; i < n; i++) {
+            if (exprs[i]) {
+                exprs[i] = expr_simplify(exprs[i]);
+                exprs[i] = expr_evaluate_condition(exprs[i],
+                                                   is_chassis_resident_cb,
+                                                   &ports, NULL);
+            }
+        }
+        benchmark_phase_stop(&phases[BP_SIMPLIFY]);
+
+        benchmark_phase_start(&phases[BP_NORMALIZE]);
+        for (size_t i = 0; i < n; i++) {
+            if (exprs[i]) {
+                exprs[i] = expr_normalize(exprs[i]);
+            }
+        }
+        benchmark_phase_stop(&phases[BP_NORMALIZE]);
+
+        benchmark_phase_start(&phases[BP_TO_MATCHES]);
+        for (size_t i = 0; i < n; i++) {
+            if (exprs[i]) {
+                expr_to_matches(exprs[i], lookup_port_cb, &ports,
+                                &matches[i]);
+            } else {
+                hmap_init(&matches[i]);
+            }
+        }
+        benchmark_phase_stop(&phases[BP_TO_MATCHES]);
+
+        benchmark_phase_start(&phases[BP_DESTROY]);
+        for (size_t i = 0; i < n; i++) {
+            n_flows += first ? hmap_count(&matches[i]) : 0;
+            expr_matches_destroy(&matches[i]);
+            expr_destroy(exprs[i]);
+        }
+        benchmark_phase_stop(&phases[BP_DESTROY]);
+    }
+
+    printf("%"PRIuSIZE" expressions (%"PRIuSIZE" errors), %"PRIuSIZE" flows, "
+           "%u iterations\n", n, n_errors, n_flows, n_iterations);
+    printf("%-12s %12s %12s %12s %12s\n",
+           "phase", "us/expr", "expr/s", "allocs/expr", "reused/expr");
+    double n_total = MAX((double) n * n_iterations, 1);
+    for (size_t i = 0; i < N_BENCHMARK_PHASES; i++) {
+        const struct benchmark_phase *phase = &phases[i];
+        double usec = MAX(phase->usec, 1);
+
+        printf("%-12s %12.2f %12.0f %12.2f %12.2f\n", phase->name,
+               usec / n_total, n_total * 1e6 / usec,
+               phase->nodes.n_allocated / n_total,
+               phase->nodes.n_reused / n_total);
+    }
+
+    free(matches);
+    free(exprs);
+    svec_destroy(&corpus);
+    simap_destroy(&ports);
+    expr_symtab_destroy(&symtab);
+    shash_destroy(&symtab);
+    expr_const_sets_destroy(&addr_sets);
+    shash_destroy(&addr_sets);
+    expr_const_sets_destroy(&port_groups);
+    shash_destroy(&port_groups);
+}
+
 /* Print the symbol table. */
 
 static void
@@ -886,12 +1134,27 @@ test_tree_shape_exhaustively(struct expr *expr, struct shash *symtab,
         init_terminal(terminals[i], 0, nvars, n_nvars, svars, n_svars);
     }
 
+    /* All the microflows to evaluate the expressions against. */
+    int n_substs = 1 << (n_bits * n_nvars + n_svars);
+    struct flow *flows = xcalloc(n_substs, sizeof *flows);
+    for (int subst = 0; subst < n_substs; subst++) {
+        struct flow *f = &flows[subst];
+        for (int i = 0; i < n_nvars; i++) {
+            f->regs[i] = (subst >> (i * n_bits)) & var_mask;
+        }
+        for (int i = 0; i < n_svars; i++) {
+            f->regs[n_nvars + i] = ((subst >> (n_nvars * n_bits + i))
+                                    & 1);
+        }
+    }
+    unsigned long *batch_results = bitmap_allocate(n_substs);
+
     struct ds s = DS_EMPTY_INITIALIZER;
-    struct flow f;
-    memset(&f, 0, sizeof f);
     for (;;) {
         for (int i = n_terminals - 1; ; i--) {
             if (!i) {
+                bitmap_free(batch_results);
+                free(flows);
                 ds_destroy(&s);
                 return n_tested;
             }
@@ -948,18 +1211,22 @@ test_tree_shape_exhaustively(struct expr *expr, struct shash *symtab,
                                   m->conjunctions, m->n);
             }
         }
-        for (int subst = 0; subst < 1 << (n_bits * n_nvars + n_svars);
-             subst++) {
-            for (int i = 0; i < n_nvars; i++) {
-                f.regs[i] = (subst >> (i * n_bits)) & var_mask;
-            }
-            for (int i = 0; i < n_svars; i++) {
-                f.regs[n_nvars + i] = ((subst >> (n_nvars * n_bits + i))
-                                       & 1);
+        expr_evaluate_batch(modified, flows, n_substs, lookup_atoi_cb, NULL,
+                            batch_results);
+        for (int subst = 0; subst < n_substs; subst++) {
+            const struct flow *f = &flows[subst];
+
+            bool expected = expr_evaluate(expr, f, lookup_atoi_cb, NULL);
+            bool actual = expr_evaluate(modified, f, lookup_atoi_cb, NULL);
+            bool batch = bitmap_is_set(batch_results, subst);
+            if (batch != actual) {
+                struct ds modified_s = DS_EMPTY_INITIALIZER;
+                expr_format(modified, &modified_s);
+                fprintf(stderr, "%s evaluates to %d, but to %d in a batch, "
+                        "for subst %d\n",
+                        ds_cstr(&modified_s), actual, batch, subst);
+                exit(EXIT_FAILURE);
             }
-
-            bool expected = expr_evaluate(expr, &f, lookup_atoi_cb, NULL);
-            bool actual = expr_evaluate(modified, &f, lookup_atoi_cb, NULL);
             if (actual != expected) {
                 struct ds expr_s, modified_s;
 
@@ -990,7 +1257,7 @@ test_tree_shape_exhaustively(struct expr *expr, struct shash *symtab,
 
             if (operation >= OP_FLOW) {
                 bool found = classifier_lookup(&cls, OVS_VERSION_MIN,
-                                               &f, NULL) != NULL;
+                                               f, NULL) != NULL;
                 if (expected != found) {
                     struct ds expr_s, modified_s;
 
@@ -1419,6 +1686,41 @@ test_parse_actions(struct ovs_cmdl_context *ctx OVS_UNUSED)
     exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
 }
 
+static void
+test_allocate_tnlids(struct ovs_cmdl_context *ctx)
+{
+    struct ovn_tnlids tnlids = OVN_TNLIDS_INITIALIZER;
+    unsigned int min, max, hint, n;
+
+    if (!str_to_uint(ctx->argv[1], 10, &min)
+        || !str_to_uint(ctx->argv[2], 10, &max)
+        || !str_to_uint(ctx->argv[3], 10, &hint)
+        || !str_to_uint(ctx->argv[4], 10, &n)) {
+        ovs_fatal(0, "MIN, MAX, HINT and N must be integers");
+    }
+
+    for (int i = 5; i < ctx->argc; i++) {
+        unsigned int first, last;
+        int n_parsed = sscanf(ctx->argv[i], "%u-%u", &first, &last);
+        if (n_parsed < 1) {
+            ovs_fatal(0, "%s: key or range of keys expected", ctx->argv[i]);
+        } else if (n_parsed == 1) {
+            last = first;
+        }
+        for (uint64_t key = first; key <= last; key++) {
+            ovn_add_tnlid(&tnlids, key);
+        }
+    }
+
+    uint32_t tnlid_hint = hint;
+    for (unsigned int i = 0; i < n; i++) {
+        printf("%s%"PRIu32, i ? " " : "",
+               ovn_allocate_tnlid(&tnlids, "test", min, max, &tnlid_hint));
+    }
+    printf("\n");
+    ovn_destroy_tnlids(&tnlids);
+}
+
 static unsigned int
 parse_relops(const char *s)
 {
@@ -1461,7 +1763,18 @@ normalize-expr\n\
 expr-to-flows\n\
   Parses OVN expressions from stdin and prints them back on stdout after\n\
   differing degrees of analysis.  Available fields are based on packet\n\
-  headers.\n\
+  headers.  With --aggregate, the prefixes of all the disjunctions are\n\
+  aggregated, instead of only those of the large ones.  With\n\
+  --cross-product-limit=N, conjunctions are replaced by cross products\n\
+  that don't need more flows, or up to N more flows.\n\
+\n\
+benchmark-expr [ITERATIONS]\n\
+  Reads OVN expressions from stdin and prints the time and the number of\n\
+  expression nodes allocated by each phase of their conversion to flows,\n\
+  over ITERATIONS conversions of all of them, by default 1.  Lines of the\n\
+  form \"address_set NAME VALUE...\" or \"port_group NAME PORT...\" define\n\
+  the sets that the expressions use, e.g. from the Address_Set and\n\
+  Port_Group tables of a southbound database, whose ports are resident.\n\
 \n\
 expr-to-packets\n\
   Parses OVN expressions from stdin and prints out matching packets in\n\
@@ -1492,6 +1805,9 @@ exhaustive N\n\
         normalize, flow.  Default: flow.  'normalize' includes 'simplify',\n\
         'flow' includes 'simplify' and 'normalize'.\n\
     --parallel=N  Number of processes to use in parallel, default 1.\n\
+    --aggregate  Aggregate the prefixes of all the disjunctions.\n\
+    --cross-product-limit=N  Replace conjunctions by cross products of up\n\
+        to N more flows.\n\
    Numeric vars:\n\
     --nvars=N  Number of numeric vars to test, in range 0...4, default 2.\n\
     --bits=N  Number of bits per variable, in range 1...3, default 3.\n\
@@ -1504,6 +1820,10 @@ exhaustive N\n\
 parse-actions\n\
   Parses OVN actions from stdin and prints the equivalent OpenFlow actions\n\
   on stdout.\n\
+\n\
+allocate-tnlids MIN MAX HINT N [KEY | FIRST-LAST]...\n\
+  Marks the given tunnel keys as in use, then allocates N keys between MIN\n\
+  and MAX starting after HINT, and prints them on stdout.\n\
 ",
            program_name, program_name);
     exit(EXIT_SUCCESS);
@@ -1518,7 +1838,9 @@ test_ovn_main(int argc, char *argv[])
         OPT_SVARS,
         OPT_BITS,
         OPT_OPERATION,
-        OPT_PARALLEL
+        OPT_PARALLEL,
+        OPT_AGGREGATE,
+        OPT_CROSS_PRODUCT_LIMIT
     };
     static const struct option long_options[] = {
         {"relops", required_argument, NULL, OPT_RELOPS},
@@ -1527,6 +1849,9 @@ test_ovn_main(int argc, char *argv[])
         {"bits", required_argument, NULL, OPT_BITS},
         {"operation", required_argument, NULL, OPT_OPERATION},
         {"parallel", required_argument, NULL, OPT_PARALLEL},
+        {"aggregate", no_argument, NULL, OPT_AGGREGATE},
+        {"cross-product-limit", required_argument, NULL,
+         OPT_CROSS_PRODUCT_LIMIT},
         {"more", no_argument, NULL, 'm'},
         {"help", no_argument, NULL, 'h'},
         {NULL, 0, NULL, 0},
@@ -1590,6 +1915,14 @@ test_ovn_main(int argc, char *argv[])
             test_parallel = atoi(optarg);
             break;
 
+        case OPT_AGGREGATE:
+            expr_set_aggregate_prefixes(true);
+            break;
+
+        case OPT_CROSS_PRODUCT_LIMIT:
+            expr_set_cross_product_limit(atoi(optarg));
+            break;
+
         case 'm':
             verbosity++;
             break;
@@ -1620,6 +1953,7 @@ test_ovn_main(int argc, char *argv[])
         {"simplify-expr", NULL, 0, 0, test_simplify_expr, OVS_RO},
         {"normalize-expr", NULL, 0, 0, test_normalize_expr, OVS_RO},
         {"expr-to-flows", NULL, 0, 0, test_expr_to_flows, OVS_RO},
+        {"benchmark-expr", NULL, 0, 1, test_benchmark_expr, OVS_RO},
         {"evaluate-expr", NULL, 1, 1, test_evaluate_expr, OVS_RO},
         {"composition", NULL, 1, 1, test_composition, OVS_RO},
         {"tree-shape", NULL, 1, 1, test_tree_shape, OVS_RO},
@@ -1629,6 +1963,9 @@ test_ovn_main(int argc, char *argv[])
         /* Actions. */
         {"parse-actions", NULL, 0, 0, test_parse_actions, OVS_RO},
 
+        /* Tunnel keys. */
+        {"allocate-tnlids", NULL, 4, INT_MAX, test_allocate_tnlids, OVS_RO},
+
         {NULL, NULL, 0, 0, NULL, OVS_RO},
     };
     struct ovs_cmdl_context ctx;
@@ -17,6 +17,9 @@
 
 #include "test-utils.h"
 
+#include <time.h>
+
+#include "timeval.h"
 #include "util.h"
 
 bool
@@ -47,3 +50,72 @@ test_read_value(struct ovs_cmdl_context *ctx, unsigned int index,
 
     return ctx->argv[index];
 }
+
+/* Returns a monotonic time, in ns, for timing short operations. */
+uint64_t
+test_time_ns(void)
+{
+    struct timespec ts;
+
+    xclock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+test_latencies_init(struct test_latencies *lat, const char *name)
+{
+    lat->name = name;
+    lat->ns = NULL;
+    lat->n = lat->allocated = 0;
+    lat->total_ns = 0;
+}
+
+void
+test_latencies_destroy(struct test_latencies *lat)
+{
+    free(lat->ns);
+}
+
+void
+test_latencies_add(struct test_latencies *lat, uint64_t ns)
+{
+    if (lat->n >= lat->allocated) {
+        lat->ns = x2nrealloc(lat->ns, &lat->allocated, sizeof *lat->ns);
+    }
+    lat->ns[lat->n++] = ns;
+    lat->total_ns += ns;
+}
+
+static int
+compare_uint64(const void *a_, const void *b_)
+{
+    const uint64_t *a = a_;
+    const uint64_t *b = b_;
+
+    return *a < *b ? -1 : *a > *b;
+}
+
+void
+test_latencies_print_header(void)
+{
+    printf("%-12s %10s %12s %8s %8s %8s %8s\n", "op", "count", "ops/s",
+           "p50-ns", "p90-ns", "p99-ns", "max-ns");
+}
+
+/* Prints the number of runs of 'lat', their throughput and the percentiles
+ * of their latencies.  Sorts the latencies. */
+void
+test_latencies_print(struct test_latencies *lat)
+{
+    if (!lat->n) {
+        printf("%-12s %10d\n", lat->name, 0);
+        return;
+    }
+
+    qsort(lat->ns, lat->n, sizeof *lat->ns, compare_uint64);
+    printf("%-12s %10"PRIuSIZE" %12.0f %8"PRIu64" %8"PRIu64" %8"PRIu64
+           " %8"PRIu64"\n", lat->name, lat->n,
+           lat->n * 1e9 / MAX(lat->total_ns, 1),
+           lat->ns[lat->n / 2], lat->ns[lat->n * 9 / 10],
+           lat->ns[lat->n * 99 / 100], lat->ns[lat->n - 1]);
+}
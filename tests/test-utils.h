@@ -16,6 +16,9 @@
 #ifndef TEST_UTILS_H
 #define TEST_UTILS_H 1
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "ovstest.h"
 
 bool test_read_uint_value(struct ovs_cmdl_context *ctx, unsigned int index,
@@ -23,4 +26,21 @@ bool test_read_uint_value(struct ovs_cmdl_context *ctx, unsigned int index,
 const char *test_read_value(struct ovs_cmdl_context *ctx, unsigned int index,
                             const char *descr);
 
+/* Latencies of the runs of a benchmarked operation. */
+struct test_latencies {
+    const char *name;
+    uint64_t *ns;               /* Latency of each run, in ns. */
+    size_t n;
+    size_t allocated;
+    uint64_t total_ns;
+};
+
+uint64_t test_time_ns(void);
+
+void test_latencies_init(struct test_latencies *, const char *name);
+void test_latencies_destroy(struct test_latencies *);
+void test_latencies_add(struct test_latencies *, uint64_t ns);
+void test_latencies_print_header(void);
+void test_latencies_print(struct test_latencies *);
+
 #endif /* tests/test-utils.h */
@@ -16,6 +16,7 @@
 
 #include "ovn-dbctl.h"
 
+#include <errno.h>
 #include <getopt.h>
 
 #include "command-line.h"
@@ -34,6 +35,7 @@
 #include "svec.h"
 #include "table.h"
 #include "timer.h"
+#include "timeval.h"
 #include "unixctl.h"
 #include "util.h"
 
@@ -70,6 +72,10 @@ static struct table_style table_style = TABLE_STYLE_DEFAULT;
 static struct ovsdb_idl *the_idl;
 static struct ovsdb_idl_txn *the_idl_txn;
 
+/* Whether the last transaction that do_dbctl() ran was committed, even if a
+ * later step failed. */
+static bool txn_committed;
+
 /* --leader-only, --no-leader-only: Only accept the leader in a cluster. */
 static int leader_only = true;
 
@@ -80,8 +86,14 @@ static int shuffle_remotes = true;
 /* --unixctl-path: Path to use for unixctl server socket, for daemon mode. */
 static char *unixctl_path;
 
+/* --bulk: File with the commands to execute, one per line, in transactions
+ * of at most 'bulk_size' lines (--bulk-size). */
+static const char *bulk_file;
+static unsigned int bulk_size = 1000;
+
 static unixctl_cb_func server_cmd_exit;
 static unixctl_cb_func server_cmd_run;
+static unixctl_cb_func server_cmd_stats;
 
 static struct option *get_all_options(void);
 static bool has_option(const struct ovs_cmdl_parsed_option *, size_t n,
@@ -107,6 +119,8 @@ static char * OVS_WARN_UNUSED_RESULT main_loop(
     struct ovsdb_idl *idl, const struct timer *);
 static void server_loop(const struct ovn_dbctl_options *dbctl_options,
                         struct ovsdb_idl *idl, int argc, char *argv[]);
+static void bulk_load(const struct ovn_dbctl_options *dbctl_options,
+                      struct ovsdb_idl *idl);
 static void ovn_dbctl_exit(int status);
 
 int
@@ -164,7 +178,8 @@ ovn_dbctl_main(int argc, char *argv[],
                                : getenv(dbctl_options->daemon_env_var_name));
     if (((socket_name && socket_name[0])
          || has_option(parsed_options, n_parsed_options, 'u'))
-        && !will_detach(parsed_options, n_parsed_options)) {
+        && !will_detach(parsed_options, n_parsed_options)
+        && !has_option(parsed_options, n_parsed_options, OPT_BULK)) {
         dbctl_client(dbctl_options, socket_name,
                      parsed_options, n_parsed_options, argc, argv_);
     }
@@ -181,11 +196,21 @@ ovn_dbctl_main(int argc, char *argv[],
             ctl_fatal("non-option arguments not supported with --detach "
                       "(use --help for help)");
         }
+        if (bulk_file) {
+            ctl_fatal("--bulk is not supported with --detach");
+        }
         daemon_mode = true;
+    } else if (bulk_file) {
+        if (argc != optind || !shash_is_empty(&local_options)) {
+            ctl_fatal("commands on the command line are not supported with "
+                      "--bulk (use --help for help)");
+        }
     }
-    /* Initialize IDL. */
+    /* Initialize IDL.  Like a daemon, a bulk load runs many transactions,
+     * whose commands are not known in advance, so it monitors every
+     * table. */
     idl = the_idl = ovsdb_idl_create_unconnected(dbctl_options->idl_class,
-                                                 daemon_mode);
+                                                 daemon_mode || bulk_file);
     ovsdb_idl_set_shuffle_remotes(idl, shuffle_remotes);
     /* "retry" is true iff in daemon mode. */
     ovsdb_idl_set_remote(idl, db, daemon_mode);
@@ -193,6 +218,8 @@ ovn_dbctl_main(int argc, char *argv[],
 
     if (daemon_mode) {
         server_loop(dbctl_options, idl, argc, argv_);
+    } else if (bulk_file) {
+        bulk_load(dbctl_options, idl);
     } else {
         struct ctl_command *commands;
         size_t n_commands;
@@ -248,7 +275,7 @@ main_loop(const struct ovn_dbctl_options *dbctl_options,
           const char *args, struct ctl_command *commands, size_t n_commands,
           struct ovsdb_idl *idl, const struct timer *wait_timeout)
 {
-    unsigned int seqno;
+    unsigned int seqno, cond_seqno;
     bool idl_ready;
 
     /* Execute the commands.
@@ -257,8 +284,11 @@ main_loop(const struct ovn_dbctl_options *dbctl_options,
      * execute our transaction.  There's no point in trying to commit more than
      * once for any given sequence number, because if the transaction fails
      * it's because the database changed and we need to obtain an up-to-date
-     * view of the database before we try the transaction again. */
+     * view of the database before we try the transaction again.  Commands
+     * that change monitor conditions also wait for the server to apply them,
+     * which changes 'cond_seqno' even if no row changes. */
     seqno = ovsdb_idl_get_seqno(idl);
+    cond_seqno = ovsdb_idl_get_condition_seqno(idl);
 
     /* IDL might have already obtained the database copy during previous
      * invocation. If so, we can't expect the sequence number to change before
@@ -272,9 +302,11 @@ main_loop(const struct ovn_dbctl_options *dbctl_options,
                       db, ovs_retval_to_string(retval));
         }
 
-        if (idl_ready || seqno != ovsdb_idl_get_seqno(idl)) {
+        if (idl_ready || seqno != ovsdb_idl_get_seqno(idl)
+            || cond_seqno != ovsdb_idl_get_condition_seqno(idl)) {
             idl_ready = false;
             seqno = ovsdb_idl_get_seqno(idl);
+            cond_seqno = ovsdb_idl_get_condition_seqno(idl);
 
             bool retry;
             char *error = do_dbctl(dbctl_options,
@@ -288,7 +320,8 @@ main_loop(const struct ovn_dbctl_options *dbctl_options,
             }
         }
 
-        if (seqno == ovsdb_idl_get_seqno(idl)) {
+        if (seqno == ovsdb_idl_get_seqno(idl)
+            && cond_seqno == ovsdb_idl_get_condition_seqno(idl)) {
             ovsdb_idl_wait(idl);
             poll_block();
         }
@@ -324,6 +357,8 @@ enum {
     OPT_SHUFFLE_REMOTES,
     OPT_NO_SHUFFLE_REMOTES,
     OPT_BOOTSTRAP_CA_CERT,
+    OPT_BULK,
+    OPT_BULK_SIZE,
     MAIN_LOOP_OPTION_ENUMS,
     OVN_DAEMON_OPTION_ENUMS,
     VLOG_OPTION_ENUMS,
@@ -441,6 +476,8 @@ get_all_options(void)
         {"no-shuffle-remotes", no_argument, NULL, OPT_NO_SHUFFLE_REMOTES},
         {"version", no_argument, NULL, 'V'},
         {"unixctl", required_argument, NULL, 'u'},
+        {"bulk", required_argument, NULL, OPT_BULK},
+        {"bulk-size", required_argument, NULL, OPT_BULK_SIZE},
         MAIN_LOOP_LONG_OPTIONS,
         OVN_DAEMON_LONG_OPTIONS,
         VLOG_LONG_OPTIONS,
@@ -570,6 +607,16 @@ apply_options_direct(const struct ovn_dbctl_options *dbctl_options,
             unixctl_path = optarg;
             break;
 
+        case OPT_BULK:
+            bulk_file = po->arg;
+            break;
+
+        case OPT_BULK_SIZE:
+            if (!str_to_uint(po->arg, 10, &bulk_size) || !bulk_size) {
+                ctl_fatal("value %s on --bulk-size is invalid", po->arg);
+            }
+            break;
+
         case 'V':
             ovn_print_version(0, 0);
             printf("DB Schema %s\n", dbctl_options->db_version);
@@ -690,6 +737,7 @@ do_dbctl(const struct ovn_dbctl_options *dbctl_options,
 
     ovs_assert(retry);
 
+    txn_committed = false;
     txn = the_idl_txn = ovsdb_idl_txn_create(idl);
     if (dry_run) {
         ovsdb_idl_txn_set_dry_run(txn);
@@ -705,7 +753,8 @@ do_dbctl(const struct ovn_dbctl_options *dbctl_options,
         c->table = NULL;
     }
     struct ctl_context *ctx = dbctl_options->ctx_create();
-    ctl_context_init(ctx, NULL, idl, txn, symtab, NULL);
+    ctl_context_init(ctx, NULL, idl, txn, symtab,
+                     dbctl_options->ctx_invalidate_cache);
     for (c = commands; c < &commands[n_commands]; c++) {
         ctl_context_init_command(ctx, c);
         if (c->syntax->run) {
@@ -749,6 +798,7 @@ do_dbctl(const struct ovn_dbctl_options *dbctl_options,
     long long int start_time = time_wall_msec();
     status = ovsdb_idl_txn_commit_block(txn);
     if (status == TXN_UNCHANGED || status == TXN_SUCCESS) {
+        txn_committed = true;
         for (c = commands; c < &commands[n_commands]; c++) {
             if (c->syntax->postprocess) {
                 ctl_context_init(ctx, c, idl, txn, symtab, NULL);
@@ -838,6 +888,138 @@ out_error:
     return error;
 }
 
+/* Bulk load implementation. */
+
+/* Reads up to 'bulk_size' nonblank lines from 'stream' into 'argv', as the
+ * arguments of a single command line, with "--" between the lines.
+ * Advances '*line_number' to the last line read.  Returns the number of
+ * lines read, which is less than 'bulk_size' only at the end of 'stream'. */
+static size_t
+bulk_read_commands(FILE *stream, int *line_number, struct svec *argv)
+{
+    struct ds line = DS_EMPTY_INITIALIZER;
+    size_t n = 0;
+
+    while (n < bulk_size
+           && !ds_get_preprocessed_line(&line, stream, line_number)) {
+        if (!line.length) {
+            continue;
+        }
+        if (n++) {
+            svec_add(argv, "--");
+        }
+        svec_parse_words(argv, ds_cstr(&line));
+    }
+    ds_destroy(&line);
+
+    return n;
+}
+
+/* Executes the commands of 'argv' in a single transaction and stores their
+ * number in '*n_commandsp'.  'args' describes them for the transaction's
+ * comment. */
+static char * OVS_WARN_UNUSED_RESULT
+bulk_execute(const struct ovn_dbctl_options *dbctl_options,
+             struct ovsdb_idl *idl, const char *args, struct svec *argv,
+             size_t *n_commandsp)
+{
+    struct shash local_options = SHASH_INITIALIZER(&local_options);
+    struct ctl_command *commands;
+    size_t n_commands;
+    char *error;
+
+    svec_terminate(argv);
+    error = ctl_parse_commands(argv->n, argv->names, &local_options,
+                               &commands, &n_commands);
+    shash_destroy(&local_options);
+    if (error) {
+        return error;
+    }
+    *n_commandsp = n_commands;
+
+    error = run_prerequisites(dbctl_options, commands, n_commands, idl);
+    if (!error) {
+        error = main_loop(dbctl_options, args, commands, n_commands, idl,
+                          NULL);
+    }
+
+    for (struct ctl_command *c = commands; c < &commands[n_commands]; c++) {
+        ds_destroy(&c->output);
+        table_destroy(c->table);
+        free(c->table);
+        shash_destroy_free_data(&c->options);
+    }
+    free(commands);
+
+    return error;
+}
+
+/* Executes the commands in 'bulk_file', one per line, in transactions of
+ * 'bulk_size' commands, so that neither the client nor the database has to
+ * hold all of them at once, and without one round trip per command.  Only
+ * the last transaction waits as requested by --wait, since each of them
+ * waits for all of the earlier changes.  Reports the throughput on stderr at
+ * the end. */
+static void
+bulk_load(const struct ovn_dbctl_options *dbctl_options,
+          struct ovsdb_idl *idl)
+{
+    FILE *stream = !strcmp(bulk_file, "-") ? stdin : fopen(bulk_file, "r");
+    if (!stream) {
+        ctl_fatal("%s: open failed (%s)", bulk_file, ovs_strerror(errno));
+    }
+
+    ctl_timeout_setup(timeout);
+
+    enum nbctl_wait_type final_wait_type = wait_type;
+    long long int start = time_msec();
+    size_t n_commands = 0;
+    size_t n_txns = 0;
+
+    struct svec argv = SVEC_EMPTY_INITIALIZER;
+    struct svec next_argv = SVEC_EMPTY_INITIALIZER;
+    int line_number = 0;
+    int first_line = 1;
+    size_t n = bulk_read_commands(stream, &line_number, &argv);
+    while (n) {
+        int last_line = line_number;
+
+        /* Read ahead to know whether this is the last transaction. */
+        size_t next_n = (n < bulk_size ? 0
+                         : bulk_read_commands(stream, &line_number,
+                                              &next_argv));
+        wait_type = next_n ? NBCTL_WAIT_NONE : final_wait_type;
+
+        char *args = xasprintf("--bulk=%s (lines %d-%d)",
+                               bulk_file, first_line, last_line);
+        size_t n_executed = 0;
+        char *error = bulk_execute(dbctl_options, idl, args, &argv,
+                                   &n_executed);
+        free(args);
+        if (error) {
+            ctl_fatal("%s: lines %d-%d: %s",
+                      bulk_file, first_line, last_line, error);
+        }
+        n_commands += n_executed;
+        n_txns++;
+
+        svec_swap(&argv, &next_argv);
+        svec_clear(&next_argv);
+        first_line = last_line + 1;
+        n = next_n;
+    }
+    svec_destroy(&argv);
+    svec_destroy(&next_argv);
+    if (stream != stdin) {
+        fclose(stream);
+    }
+
+    long long int elapsed = time_msec() - start;
+    fprintf(stderr, "%"PRIuSIZE" commands in %"PRIuSIZE" transactions, "
+            "%lld ms (%.0f commands/s)\n", n_commands, n_txns, elapsed,
+            n_commands * 1000.0 / MAX(elapsed, 1));
+}
+
 /* Frees the current transaction and the underlying IDL and then calls
  * exit(status).
  *
@@ -977,6 +1159,271 @@ struct server_cmd_run_ctx {
     const struct ovn_dbctl_options *dbctl_options;
 };
 
+/* A "run" request from a client.  server_cmd_run() parses the request and
+ * queues it, and server_run_requests() executes the requests queued by all
+ * the clients in one pass of unixctl_server_run(), so that it may batch
+ * several of them into a single transaction.  The connection cannot go away
+ * in between, because it is only serviced by unixctl_server_run(). */
+struct server_request {
+    struct ovs_list list_node;  /* In 'server_requests'. */
+    struct unixctl_conn *conn;
+    long long int queued;       /* Time when it was queued, in ms. */
+
+    int argc;
+    char **argv;                /* Referred to by 'commands'. */
+    char *args;                 /* For logging and for the txn comment. */
+    struct shash local_options;
+    struct ctl_command *commands;
+    size_t n_commands;
+
+    /* Global options for this request. */
+    bool oneline;
+    bool dry_run;
+    enum nbctl_wait_type wait_type;
+    bool print_wait_time;
+    unsigned int timeout;
+    struct table_style table_style;
+};
+
+static struct ovs_list server_requests
+    = OVS_LIST_INITIALIZER(&server_requests);
+
+/* Maximum number of requests that share a transaction. */
+#define SERVER_BATCH_MAX 64
+
+/* Statistics for the "stats" command. */
+static struct {
+    unsigned long long int n_requests;  /* Requests replied to. */
+    unsigned long long int n_batched;   /* Requests in shared transactions. */
+    unsigned long long int n_txns;      /* Transactions run for requests. */
+    size_t queue_depth;                 /* Requests in the last pass. */
+    size_t max_queue_depth;
+    long long int total_latency;        /* Sum, in ms, from queue to reply. */
+    long long int max_latency;
+} server_stats;
+
+static void
+server_request_destroy(struct server_request *req)
+{
+    for (struct ctl_command *c = req->commands;
+         c < &req->commands[req->n_commands]; c++) {
+        ds_destroy(&c->output);
+        table_destroy(c->table);
+        free(c->table);
+        shash_destroy_free_data(&c->options);
+    }
+    free(req->commands);
+    shash_destroy_free_data(&req->local_options);
+    free(req->args);
+    for (int i = 0; i < req->argc; i++) {
+        free(req->argv[i]);
+    }
+    free(req->argv);
+    free(req);
+}
+
+/* Returns true if 'req' may share a transaction with other requests, that is,
+ * if it does not depend on anything that is specific to its own
+ * transaction: waiting, a dry run, a timeout, "wait-until" or row ids. */
+static bool
+server_request_is_batchable(const struct server_request *req)
+{
+    if (req->dry_run || req->wait_type != NBCTL_WAIT_NONE || req->timeout) {
+        return false;
+    }
+    for (const struct ctl_command *c = req->commands;
+         c < &req->commands[req->n_commands]; c++) {
+        if (!strcmp(c->syntax->name, "wait-until")
+            || shash_find(&c->options, "--id")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Sets the global options from those of 'req'. */
+static void
+server_request_apply_options(const struct server_request *req)
+{
+    oneline = req->oneline;
+    dry_run = req->dry_run;
+    wait_type = req->wait_type;
+    print_wait_time = req->print_wait_time;
+    timeout = req->timeout;
+    table_style = req->table_style;
+}
+
+/* Frees the output of a failed attempt to execute the commands of 'req'. */
+static void
+server_request_clear_output(struct server_request *req)
+{
+    for (struct ctl_command *c = req->commands;
+         c < &req->commands[req->n_commands]; c++) {
+        ds_destroy(&c->output);
+        ds_init(&c->output);
+        table_destroy(c->table);
+        free(c->table);
+        c->table = NULL;
+    }
+}
+
+/* Replies to 'req' with 'error', if nonnull, or with the output of its
+ * commands, then removes it from its list and frees it. */
+static void
+server_request_reply(struct server_request *req, const char *error)
+{
+    if (error) {
+        unixctl_command_reply_error(req->conn, error);
+    } else {
+        struct ds output = DS_EMPTY_INITIALIZER;
+        table_format_reset();
+        for (struct ctl_command *c = req->commands;
+             c < &req->commands[req->n_commands]; c++) {
+            if (c->table) {
+                table_format(c->table, &req->table_style, &output);
+            } else if (req->oneline) {
+                oneline_format(&c->output, &output);
+            } else {
+                ds_put_cstr(&output, ds_cstr_ro(&c->output));
+            }
+        }
+        unixctl_command_reply(req->conn, ds_cstr_ro(&output));
+        ds_destroy(&output);
+    }
+
+    long long int latency = time_msec() - req->queued;
+    server_stats.n_requests++;
+    server_stats.total_latency += latency;
+    server_stats.max_latency = MAX(server_stats.max_latency, latency);
+
+    ovs_list_remove(&req->list_node);
+    server_request_destroy(req);
+}
+
+/* Executes 'req' in a transaction of its own and replies to it. */
+static void
+server_request_run(const struct ovn_dbctl_options *dbctl_options,
+                   struct ovsdb_idl *idl, struct server_request *req)
+{
+    server_request_apply_options(req);
+
+    struct timer *wait_timeout = NULL;
+    struct timer wait_timeout_;
+    if (timeout) {
+        wait_timeout = &wait_timeout_;
+        timer_set_duration(wait_timeout, timeout * 1000);
+    }
+
+    char *error = main_loop(dbctl_options, req->args, req->commands,
+                            req->n_commands, idl, wait_timeout);
+    server_stats.n_txns++;
+    server_request_reply(req, error);
+    free(error);
+}
+
+/* Executes the 'n' requests in 'batch' in a single transaction and replies to
+ * them.  Returns false, without replying, if the transaction failed before it
+ * was committed, so that the caller can run the requests one by one to find
+ * out which one failed. */
+static bool
+server_requests_run_batch(const struct ovn_dbctl_options *dbctl_options,
+                          struct ovsdb_idl *idl, struct ovs_list *batch)
+{
+    struct ds args = DS_EMPTY_INITIALIZER;
+    size_t n_commands = 0;
+    struct server_request *req, *next;
+
+    LIST_FOR_EACH (req, list_node, batch) {
+        ds_put_format(&args, "%s%s", args.length ? " -- " : "", req->args);
+        n_commands += req->n_commands;
+    }
+
+    /* Move the commands of all the requests into a single array, and back
+     * once they have run. */
+    struct ctl_command *commands = xmalloc(n_commands * sizeof *commands);
+    struct ctl_command *c = commands;
+    LIST_FOR_EACH (req, list_node, batch) {
+        for (size_t i = 0; i < req->n_commands; i++, c++) {
+            *c = req->commands[i];
+            shash_moved(&c->options);
+        }
+    }
+
+    req = CONTAINER_OF(ovs_list_front(batch), struct server_request,
+                       list_node);
+    server_request_apply_options(req);
+    char *error = main_loop(dbctl_options, ds_cstr(&args), commands,
+                            n_commands, idl, NULL);
+    server_stats.n_txns++;
+
+    c = commands;
+    LIST_FOR_EACH (req, list_node, batch) {
+        for (size_t i = 0; i < req->n_commands; i++, c++) {
+            req->commands[i] = *c;
+            shash_moved(&req->commands[i].options);
+        }
+    }
+    free(commands);
+    ds_destroy(&args);
+
+    if (error && !txn_committed) {
+        LIST_FOR_EACH (req, list_node, batch) {
+            server_request_clear_output(req);
+        }
+        free(error);
+        return false;
+    }
+
+    LIST_FOR_EACH_SAFE (req, next, list_node, batch) {
+        server_stats.n_batched++;
+        server_request_reply(req, error);
+    }
+    free(error);
+    return true;
+}
+
+/* Executes the queued requests, in order.  Consecutive requests that allow
+ * it share transactions of up to SERVER_BATCH_MAX requests. */
+static void
+server_run_requests(const struct ovn_dbctl_options *dbctl_options,
+                    struct ovsdb_idl *idl)
+{
+    size_t depth = ovs_list_size(&server_requests);
+    if (!depth) {
+        return;
+    }
+    server_stats.queue_depth = depth;
+    server_stats.max_queue_depth = MAX(server_stats.max_queue_depth, depth);
+
+    while (!ovs_list_is_empty(&server_requests)) {
+        struct ovs_list batch = OVS_LIST_INITIALIZER(&batch);
+        struct server_request *req, *next;
+        size_t n = 0;
+
+        while (!ovs_list_is_empty(&server_requests) && n < SERVER_BATCH_MAX) {
+            req = CONTAINER_OF(ovs_list_front(&server_requests),
+                               struct server_request, list_node);
+            bool batchable = server_request_is_batchable(req);
+            if (!batchable && n) {
+                break;
+            }
+            ovs_list_remove(&req->list_node);
+            ovs_list_push_back(&batch, &req->list_node);
+            n++;
+            if (!batchable) {
+                break;
+            }
+        }
+
+        if (n > 1 && server_requests_run_batch(dbctl_options, idl, &batch)) {
+            continue;
+        }
+        LIST_FOR_EACH_SAFE (req, next, list_node, &batch) {
+            server_request_run(dbctl_options, idl, req);
+        }
+    }
+}
+
 static void
 server_cmd_run(struct unixctl_conn *conn, int argc, const char **argv_,
                void *ctx_)
@@ -985,92 +1432,85 @@ server_cmd_run(struct unixctl_conn *conn, int argc, const char **argv_,
     struct ovsdb_idl *idl = ctx->idl;
     const struct ovn_dbctl_options *dbctl_options = ctx->dbctl_options;
 
-    struct ctl_command *commands = NULL;
-    struct shash local_options;
-    size_t n_commands = 0;
+    struct server_request *req = xmalloc(sizeof *req);
+    *req = (struct server_request) {
+        .conn = conn,
+        .queued = time_msec(),
+        .argc = argc,
+    };
     int n_options = 0;
     char *error = NULL;
 
     /* Copy args so that getopt() can permute them. Leave last entry NULL. */
-    char **argv = xcalloc(argc + 1, sizeof *argv);
+    req->argv = xcalloc(argc + 1, sizeof *req->argv);
     for (int i = 0; i < argc; i++) {
-        argv[i] = xstrdup(argv_[i]);
+        req->argv[i] = xstrdup(argv_[i]);
     }
 
     /* Reset global state. */
     oneline = false;
     dry_run = false;
     wait_type = NBCTL_WAIT_NONE;
+    print_wait_time = false;
     timeout = 0;
     table_style = table_style_default;
 
     /* Parse commands & options. */
-    char *args = process_escape_args(argv);
-    shash_init(&local_options);
-    error = server_parse_options(dbctl_options,
-                                 argc, argv, &local_options, &n_options);
+    req->args = process_escape_args(req->argv);
+    shash_init(&req->local_options);
+    error = server_parse_options(dbctl_options, argc, req->argv,
+                                 &req->local_options, &n_options);
     if (error) {
-        unixctl_command_reply_error(conn, error);
-        goto out;
+        goto out_error;
     }
-    error = ctl_parse_commands(argc - n_options, argv + n_options,
-                               &local_options, &commands, &n_commands);
+    error = ctl_parse_commands(argc - n_options, req->argv + n_options,
+                               &req->local_options, &req->commands,
+                               &req->n_commands);
     if (error) {
-        unixctl_command_reply_error(conn, error);
-        goto out;
-    }
-    VLOG(ctl_might_write_to_db(commands, n_commands) ? VLL_INFO : VLL_DBG,
-         "Running command %s", args);
-
-    struct timer *wait_timeout = NULL;
-    struct timer wait_timeout_;
-    if (timeout) {
-        wait_timeout = &wait_timeout_;
-        timer_set_duration(wait_timeout, timeout * 1000);
+        goto out_error;
     }
+    VLOG(ctl_might_write_to_db(req->commands, req->n_commands)
+         ? VLL_INFO : VLL_DBG, "Running command %s", req->args);
 
-    error = run_prerequisites(dbctl_options, commands, n_commands, idl);
-    if (error) {
-        unixctl_command_reply_error(conn, error);
-        goto out;
-    }
-    error = main_loop(dbctl_options, args, commands, n_commands, idl, wait_timeout);
+    error = run_prerequisites(dbctl_options, req->commands, req->n_commands,
+                              idl);
     if (error) {
-        unixctl_command_reply_error(conn, error);
-        goto out;
+        goto out_error;
     }
 
-    struct ds output = DS_EMPTY_INITIALIZER;
-    table_format_reset();
-    for (struct ctl_command *c = commands; c < &commands[n_commands]; c++) {
-        if (c->table) {
-            table_format(c->table, &table_style, &output);
-        } else if (oneline) {
-            oneline_format(&c->output, &output);
-        } else {
-            ds_put_cstr(&output, ds_cstr_ro(&c->output));
-        }
-    }
-    unixctl_command_reply(conn, ds_cstr_ro(&output));
-    ds_destroy(&output);
+    req->oneline = oneline;
+    req->dry_run = dry_run;
+    req->wait_type = wait_type;
+    req->print_wait_time = print_wait_time;
+    req->timeout = timeout;
+    req->table_style = table_style;
+    ovs_list_push_back(&server_requests, &req->list_node);
+    return;
 
-out:
+out_error:
+    unixctl_command_reply_error(conn, error);
     free(error);
+    server_request_destroy(req);
+}
 
-    struct ctl_command *c;
-    for (c = commands; c < &commands[n_commands]; c++) {
-        ds_destroy(&c->output);
-        table_destroy(c->table);
-        free(c->table);
-        shash_destroy_free_data(&c->options);
-    }
-    free(commands);
-    shash_destroy_free_data(&local_options);
-    free(args);
-    for (int i = 0; i < argc; i++) {
-        free(argv[i]);
-    }
-    free(argv);
+static void
+server_cmd_stats(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                 const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+{
+    struct ds s = DS_EMPTY_INITIALIZER;
+
+    ds_put_format(&s, "requests: %llu\n", server_stats.n_requests);
+    ds_put_format(&s, "batched requests: %llu\n", server_stats.n_batched);
+    ds_put_format(&s, "transactions: %llu\n", server_stats.n_txns);
+    ds_put_format(&s, "queue depth: %"PRIuSIZE" (max %"PRIuSIZE")\n",
+                  server_stats.queue_depth, server_stats.max_queue_depth);
+    ds_put_format(&s, "latency: %lld ms average, %lld ms max\n",
+                  (server_stats.n_requests
+                   ? server_stats.total_latency / server_stats.n_requests
+                   : 0),
+                  server_stats.max_latency);
+    unixctl_command_reply(conn, ds_cstr(&s));
+    ds_destroy(&s);
 }
 
 static void
@@ -1101,6 +1541,7 @@ server_loop(const struct ovn_dbctl_options *dbctl_options,
     unixctl_command_register("run", "", 0, INT_MAX, server_cmd_run,
                              &server_cmd_run_ctx);
     unixctl_command_register("exit", "", 0, 0, server_cmd_exit, &exiting);
+    unixctl_command_register("stats", "", 0, 0, server_cmd_stats, NULL);
 
     for (;;) {
         update_ssl_config();
@@ -1124,6 +1565,7 @@ server_loop(const struct ovn_dbctl_options *dbctl_options,
             daemonize_complete();
         }
         unixctl_server_run(server);
+        server_run_requests(dbctl_options, idl);
 
         if (exiting) {
             break;
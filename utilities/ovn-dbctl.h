@@ -54,6 +54,10 @@ struct ovn_dbctl_options {
 
     struct ctl_context *(*ctx_create)(void);
     void (*ctx_destroy)(struct ctl_context *);
+
+    /* Called before a generic database command modifies the database, if
+     * nonnull. */
+    void (*ctx_invalidate_cache)(struct ctl_context *);
 };
 
 int ovn_dbctl_main(int argc, char *argv[], const struct ovn_dbctl_options *);
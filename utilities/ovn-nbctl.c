@@ -154,18 +154,38 @@ static char * OVS_WARN_UNUSED_RESULT dhcp_options_get(
     struct ctl_context *ctx, const char *id, bool must_exist,
     const struct nbrec_dhcp_options **);
 
+/* Tables whose rows are looked up by name through 'struct nbctl_context'. */
+enum nbctl_names {
+    NBCTL_NAMES_LS,             /* Logical_Switch. */
+    NBCTL_NAMES_LSP,            /* Logical_Switch_Port. */
+    NBCTL_NAMES_LR,             /* Logical_Router. */
+    NBCTL_NAMES_LRP,            /* Logical_Router_Port. */
+    NBCTL_NAMES_LB,             /* Load_Balancer. */
+    NBCTL_NAMES_PG,             /* Port_Group. */
+    N_NBCTL_NAMES
+};
+
 /* A context for keeping track of which switch/router certain ports are
  * connected to.
  *
  * It is required to track changes that we did within current set of commands
  * because partial updates of sets in database are not reflected in the idl
- * until transaction is committed and updates received from the server. */
+ * until transaction is committed and updates received from the server.
+ *
+ * The context also maps the names of the rows of the tables in 'enum
+ * nbctl_names' to the rows, so that a transaction with many commands does
+ * not scan a whole table each time it resolves a name.  Each map is built on
+ * first use and then kept up to date by the commands that add and delete
+ * rows.  A name that several rows share maps to NULL. */
 struct nbctl_context {
     struct ctl_context base;
 
     bool context_valid;
     struct shash lsp_to_ls_map;
     struct shash lrp_to_lr_map;
+
+    bool names_valid[N_NBCTL_NAMES];
+    struct shash names[N_NBCTL_NAMES];
 };
 
 static struct ctl_context *
@@ -177,6 +197,9 @@ nbctl_ctx_create(void)
         .lsp_to_ls_map = SHASH_INITIALIZER(&nbctx->lsp_to_ls_map),
         .lrp_to_lr_map = SHASH_INITIALIZER(&nbctx->lrp_to_lr_map),
     };
+    for (size_t i = 0; i < N_NBCTL_NAMES; i++) {
+        shash_init(&nbctx->names[i]);
+    }
     return &nbctx->base;
 }
 
@@ -188,9 +211,26 @@ nbctl_ctx_destroy(struct ctl_context *base)
     nbctx->context_valid = false;
     shash_destroy(&nbctx->lsp_to_ls_map);
     shash_destroy(&nbctx->lrp_to_lr_map);
+    for (size_t i = 0; i < N_NBCTL_NAMES; i++) {
+        shash_destroy(&nbctx->names[i]);
+    }
     free(nbctx);
 }
 
+/* Called before a generic database command (e.g. "create", "set" or
+ * "destroy") modifies rows, which may add, rename or delete rows that the
+ * name maps refer to. */
+static void
+nbctl_ctx_invalidate_cache(struct ctl_context *base)
+{
+    struct nbctl_context *nbctx
+        = CONTAINER_OF(base, struct nbctl_context, base);
+    for (size_t i = 0; i < N_NBCTL_NAMES; i++) {
+        shash_clear(&nbctx->names[i]);
+        nbctx->names_valid[i] = false;
+    }
+}
+
 static void
 nbctl_pre_context(struct ctl_context *base)
 {
@@ -233,6 +273,128 @@ nbctl_context_get(struct ctl_context *base)
     return nbctx;
 }
 
+static void
+nbctl_names_add__(struct shash *names, const char *name, const void *row)
+{
+    struct shash_node *node = shash_find(names, name);
+    if (node) {
+        node->data = NULL;
+    } else {
+        shash_add(names, name, row);
+    }
+}
+
+/* Returns the map of names to rows of 'table', building it if needed. */
+static struct shash *
+nbctl_names_get(struct ctl_context *base, enum nbctl_names table)
+{
+    struct nbctl_context *nbctx
+        = CONTAINER_OF(base, struct nbctl_context, base);
+    struct shash *names = &nbctx->names[table];
+    if (nbctx->names_valid[table]) {
+        return names;
+    }
+
+    switch (table) {
+    case NBCTL_NAMES_LS: {
+        const struct nbrec_logical_switch *ls;
+        NBREC_LOGICAL_SWITCH_FOR_EACH (ls, base->idl) {
+            nbctl_names_add__(names, ls->name, ls);
+        }
+        break;
+    }
+    case NBCTL_NAMES_LSP: {
+        const struct nbrec_logical_switch_port *lsp;
+        NBREC_LOGICAL_SWITCH_PORT_FOR_EACH (lsp, base->idl) {
+            nbctl_names_add__(names, lsp->name, lsp);
+        }
+        break;
+    }
+    case NBCTL_NAMES_LR: {
+        const struct nbrec_logical_router *lr;
+        NBREC_LOGICAL_ROUTER_FOR_EACH (lr, base->idl) {
+            nbctl_names_add__(names, lr->name, lr);
+        }
+        break;
+    }
+    case NBCTL_NAMES_LRP: {
+        const struct nbrec_logical_router_port *lrp;
+        NBREC_LOGICAL_ROUTER_PORT_FOR_EACH (lrp, base->idl) {
+            nbctl_names_add__(names, lrp->name, lrp);
+        }
+        break;
+    }
+    case NBCTL_NAMES_LB: {
+        const struct nbrec_load_balancer *lb;
+        NBREC_LOAD_BALANCER_FOR_EACH (lb, base->idl) {
+            nbctl_names_add__(names, lb->name, lb);
+        }
+        break;
+    }
+    case NBCTL_NAMES_PG: {
+        const struct nbrec_port_group *pg;
+        NBREC_PORT_GROUP_FOR_EACH (pg, base->idl) {
+            nbctl_names_add__(names, pg->name, pg);
+        }
+        break;
+    }
+    case N_NBCTL_NAMES:
+    default:
+        OVS_NOT_REACHED();
+    }
+
+    nbctx->names_valid[table] = true;
+    return names;
+}
+
+/* Looks up the row of 'table' named 'name'.  Returns false if several rows
+ * have that name, otherwise stores the row, or NULL if there is none, in
+ * '*rowp' and returns true. */
+static bool
+nbctl_names_find(struct ctl_context *base, enum nbctl_names table,
+                 const char *name, const void **rowp)
+{
+    struct shash_node *node = shash_find(nbctl_names_get(base, table), name);
+
+    *rowp = node ? node->data : NULL;
+    return !node || node->data;
+}
+
+/* Records that 'row', named 'name', was added to 'table'. */
+static void
+nbctl_names_add(struct ctl_context *base, enum nbctl_names table,
+                const char *name, const void *row)
+{
+    struct nbctl_context *nbctx
+        = CONTAINER_OF(base, struct nbctl_context, base);
+    if (nbctx->names_valid[table]) {
+        nbctl_names_add__(&nbctx->names[table], name, row);
+    }
+}
+
+/* Records that 'row', named 'name', is about to be deleted from 'table'.
+ * The map is dropped, to be built again on next use, if other rows have the
+ * same name. */
+static void
+nbctl_names_remove(struct ctl_context *base, enum nbctl_names table,
+                   const char *name, const void *row)
+{
+    struct nbctl_context *nbctx
+        = CONTAINER_OF(base, struct nbctl_context, base);
+    if (!nbctx->names_valid[table]) {
+        return;
+    }
+
+    struct shash *names = &nbctx->names[table];
+    struct shash_node *node = shash_find(names, name);
+    if (node && node->data == row) {
+        shash_delete(names, node);
+    } else if (node) {
+        shash_clear(names);
+        nbctx->names_valid[table] = false;
+    }
+}
+
 static void
 nbctl_usage(void)
 {
@@ -442,6 +604,8 @@ Options:\n\
   --print-wait-time           print time spent on waiting\n\
   -t, --timeout=SECS          wait at most SECS seconds\n\
   --dry-run                   do not commit changes to database\n\
+  --bulk=FILE                 execute the commands in FILE, one per line\n\
+  --bulk-size=N               commands per transaction with --bulk (1000)\n\
   --oneline                   print exactly one line of output per command\n",
            ctl_get_db_cmd_usage(),
            ctl_list_db_tables_usage(), default_nb_db());
@@ -479,18 +643,13 @@ lr_by_name_or_uuid(struct ctl_context *ctx, const char *id,
     }
 
     if (!lr) {
-        const struct nbrec_logical_router *iter;
+        const void *row;
 
-        NBREC_LOGICAL_ROUTER_FOR_EACH(iter, ctx->idl) {
-            if (strcmp(iter->name, id)) {
-                continue;
-            }
-            if (lr) {
-                return xasprintf("Multiple logical routers named '%s'.  "
-                                 "Use a UUID.", id);
-            }
-            lr = iter;
+        if (!nbctl_names_find(ctx, NBCTL_NAMES_LR, id, &row)) {
+            return xasprintf("Multiple logical routers named '%s'.  "
+                             "Use a UUID.", id);
         }
+        lr = row;
     }
 
     if (!lr && must_exist) {
@@ -556,18 +715,13 @@ ls_by_name_or_uuid(struct ctl_context *ctx, const char *id, bool must_exist,
     }
 
     if (!ls) {
-        const struct nbrec_logical_switch *iter;
+        const void *row;
 
-        NBREC_LOGICAL_SWITCH_FOR_EACH(iter, ctx->idl) {
-            if (strcmp(iter->name, id)) {
-                continue;
-            }
-            if (ls) {
-                return xasprintf("Multiple logical switches named '%s'.  "
-                                 "Use a UUID.", id);
-            }
-            ls = iter;
+        if (!nbctl_names_find(ctx, NBCTL_NAMES_LS, id, &row)) {
+            return xasprintf("Multiple logical switches named '%s'.  "
+                             "Use a UUID.", id);
         }
+        ls = row;
     }
 
     if (!ls && must_exist) {
@@ -592,18 +746,13 @@ lb_by_name_or_uuid(struct ctl_context *ctx, const char *id, bool must_exist,
     }
 
     if (!lb) {
-        const struct nbrec_load_balancer *iter;
+        const void *row;
 
-        NBREC_LOAD_BALANCER_FOR_EACH(iter, ctx->idl) {
-            if (strcmp(iter->name, id)) {
-                continue;
-            }
-            if (lb) {
-                return xasprintf("Multiple load balancers named '%s'.  "
-                                 "Use a UUID.", id);
-            }
-            lb = iter;
+        if (!nbctl_names_find(ctx, NBCTL_NAMES_LB, id, &row)) {
+            return xasprintf("Multiple load balancers named '%s'.  "
+                             "Use a UUID.", id);
         }
+        lb = row;
     }
 
     if (!lb && must_exist) {
@@ -631,12 +780,18 @@ pg_by_name_or_uuid(struct ctl_context *ctx, const char *id, bool must_exist,
     }
 
     if (!pg) {
-        const struct nbrec_port_group *iter;
+        const void *row;
 
-        NBREC_PORT_GROUP_FOR_EACH (iter, ctx->idl) {
-            if (!strcmp(iter->name, id)) {
-                pg = iter;
-                break;
+        if (nbctl_names_find(ctx, NBCTL_NAMES_PG, id, &row)) {
+            pg = row;
+        } else {
+            const struct nbrec_port_group *iter;
+
+            NBREC_PORT_GROUP_FOR_EACH (iter, ctx->idl) {
+                if (!strcmp(iter->name, id)) {
+                    pg = iter;
+                    break;
+                }
             }
         }
     }
@@ -902,18 +1057,16 @@ nbctl_ls_add(struct ctl_context *ctx)
     }
 
     if (ls_name) {
-        if (!add_duplicate) {
-            const struct nbrec_logical_switch *ls;
-            NBREC_LOGICAL_SWITCH_FOR_EACH (ls, ctx->idl) {
-                if (!strcmp(ls->name, ls_name)) {
-                    if (may_exist) {
-                        return;
-                    }
-                    ctl_error(ctx, "%s: a switch with this name already "
-                              "exists", ls_name);
-                    return;
-                }
+        const void *row;
+        if (!add_duplicate
+            && (!nbctl_names_find(ctx, NBCTL_NAMES_LS, ls_name, &row)
+                || row)) {
+            if (may_exist) {
+                return;
             }
+            ctl_error(ctx, "%s: a switch with this name already exists",
+                      ls_name);
+            return;
         }
     } else if (may_exist) {
         ctl_error(ctx, "--may-exist requires specifying a name");
@@ -928,6 +1081,7 @@ nbctl_ls_add(struct ctl_context *ctx)
     if (ls_name) {
         nbrec_logical_switch_set_name(ls, ls_name);
     }
+    nbctl_names_add(ctx, NBCTL_NAMES_LS, ls->name, ls);
 }
 
 static void
@@ -957,6 +1111,7 @@ nbctl_ls_del(struct ctl_context *ctx)
     for (size_t i = 0; i < ls->n_ports; i++) {
         shash_find_and_delete(&nbctx->lsp_to_ls_map, ls->ports[i]->name);
     }
+    nbctl_names_remove(ctx, NBCTL_NAMES_LS, ls->name, ls);
 
     nbrec_logical_switch_delete(ls);
 }
@@ -1002,9 +1157,15 @@ lsp_by_name_or_uuid(struct ctl_context *ctx, const char *id,
     }
 
     if (!lsp) {
-        NBREC_LOGICAL_SWITCH_PORT_FOR_EACH(lsp, ctx->idl) {
-            if (!strcmp(lsp->name, id)) {
-                break;
+        const void *row;
+
+        if (nbctl_names_find(ctx, NBCTL_NAMES_LSP, id, &row)) {
+            lsp = row;
+        } else {
+            NBREC_LOGICAL_SWITCH_PORT_FOR_EACH(lsp, ctx->idl) {
+                if (!strcmp(lsp->name, id)) {
+                    break;
+                }
             }
         }
     }
@@ -1166,6 +1327,7 @@ nbctl_lsp_add(struct ctl_context *ctx)
 
     /* Updating runtime cache. */
     shash_add(&nbctx->lsp_to_ls_map, lsp_name, ls);
+    nbctl_names_add(ctx, NBCTL_NAMES_LSP, lsp->name, lsp);
 }
 
 static void
@@ -1189,6 +1351,7 @@ remove_lsp(struct ctl_context *ctx,
 
     /* Updating runtime cache. */
     shash_find_and_delete(&nbctx->lsp_to_ls_map, lsp->name);
+    nbctl_names_remove(ctx, NBCTL_NAMES_LSP, lsp->name, lsp);
 
     /* First remove 'lsp' from the array of ports.  This is what will
      * actually cause the logical port to be deleted when the transaction is
@@ -2830,6 +2993,7 @@ nbctl_lb_add(struct ctl_context *ctx)
         const struct smap options = SMAP_CONST1(&options, "event", "true");
         nbrec_load_balancer_set_options(lb, &options);
     }
+    nbctl_names_add(ctx, NBCTL_NAMES_LB, lb->name, lb);
 out:
     ds_destroy(&lb_ips_new);
 
@@ -2864,6 +3028,7 @@ nbctl_lb_del(struct ctl_context *ctx)
         if (smap_get(&lb->vips, lb_vip)) {
             smap_remove(CONST_CAST(struct smap *, &lb->vips), lb_vip);
             if (smap_is_empty(&lb->vips)) {
+                nbctl_names_remove(ctx, NBCTL_NAMES_LB, lb->name, lb);
                 nbrec_load_balancer_delete(lb);
                 return;
             }
@@ -2880,6 +3045,7 @@ nbctl_lb_del(struct ctl_context *ctx)
         }
         return;
     }
+    nbctl_names_remove(ctx, NBCTL_NAMES_LB, lb->name, lb);
     nbrec_load_balancer_delete(lb);
 }
 
@@ -3285,18 +3451,16 @@ nbctl_lr_add(struct ctl_context *ctx)
     }
 
     if (lr_name) {
-        if (!add_duplicate) {
-            const struct nbrec_logical_router *lr;
-            NBREC_LOGICAL_ROUTER_FOR_EACH (lr, ctx->idl) {
-                if (!strcmp(lr->name, lr_name)) {
-                    if (may_exist) {
-                        return;
-                    }
-                    ctl_error(ctx, "%s: a router with this name already "
-                              "exists", lr_name);
-                    return;
-                }
+        const void *row;
+        if (!add_duplicate
+            && (!nbctl_names_find(ctx, NBCTL_NAMES_LR, lr_name, &row)
+                || row)) {
+            if (may_exist) {
+                return;
             }
+            ctl_error(ctx, "%s: a router with this name already exists",
+                      lr_name);
+            return;
         }
     } else if (may_exist) {
         ctl_error(ctx, "--may-exist requires specifying a name");
@@ -3311,6 +3475,7 @@ nbctl_lr_add(struct ctl_context *ctx)
     if (lr_name) {
         nbrec_logical_router_set_name(lr, lr_name);
     }
+    nbctl_names_add(ctx, NBCTL_NAMES_LR, lr->name, lr);
 }
 
 static void
@@ -3342,6 +3507,7 @@ nbctl_lr_del(struct ctl_context *ctx)
     for (size_t i = 0; i < lr->n_ports; i++) {
         shash_find_and_delete(&nbctx->lrp_to_lr_map, lr->ports[i]->name);
     }
+    nbctl_names_remove(ctx, NBCTL_NAMES_LR, lr->name, lr);
 
     nbrec_logical_router_delete(lr);
 }
@@ -4855,9 +5021,15 @@ lrp_by_name_or_uuid(struct ctl_context *ctx, const char *id, bool must_exist,
     }
 
     if (!lrp) {
-        NBREC_LOGICAL_ROUTER_PORT_FOR_EACH(lrp, ctx->idl) {
-            if (!strcmp(lrp->name, id)) {
-                break;
+        const void *row;
+
+        if (nbctl_names_find(ctx, NBCTL_NAMES_LRP, id, &row)) {
+            lrp = row;
+        } else {
+            NBREC_LOGICAL_ROUTER_PORT_FOR_EACH(lrp, ctx->idl) {
+                if (!strcmp(lrp->name, id)) {
+                    break;
+                }
             }
         }
     }
@@ -5280,6 +5452,7 @@ nbctl_lrp_add(struct ctl_context *ctx)
 
     /* Updating runtime cache. */
     shash_add(&nbctx->lrp_to_lr_map, lrp->name, lr);
+    nbctl_names_add(ctx, NBCTL_NAMES_LRP, lrp->name, lrp);
 }
 
 /* Removes logical router port 'lrp' from logical router 'lr'. */
@@ -5292,6 +5465,7 @@ remove_lrp(struct ctl_context *ctx,
 
     /* Updating runtime cache. */
     shash_find_and_delete(&nbctx->lrp_to_lr_map, lrp->name);
+    nbctl_names_remove(ctx, NBCTL_NAMES_LRP, lrp->name, lrp);
 
     /* First remove 'lrp' from the array of ports.  This is what will
      * actually cause the logical port to be deleted when the transaction is
@@ -6232,6 +6406,7 @@ cmd_pg_add(struct ctl_context *ctx)
 
     pg = nbrec_port_group_insert(ctx->txn);
     nbrec_port_group_set_name(pg, ctx->argv[1]);
+    nbctl_names_add(ctx, NBCTL_NAMES_PG, pg->name, pg);
     if (ctx->argc > 2) {
         ctx->error = set_ports_on_pg(ctx, pg, ctx->argv + 2, ctx->argc - 2);
     }
@@ -6279,6 +6454,7 @@ cmd_pg_del(struct ctl_context *ctx)
         return;
     }
 
+    nbctl_names_remove(ctx, NBCTL_NAMES_PG, pg->name, pg);
     nbrec_port_group_delete(pg);
 }
 
@@ -6816,6 +6992,7 @@ main(int argc, char *argv[])
 
         .ctx_create = nbctl_ctx_create,
         .ctx_destroy = nbctl_ctx_destroy,
+        .ctx_invalidate_cache = nbctl_ctx_invalidate_cache,
     };
 
     return ovn_dbctl_main(argc, argv, &dbctl_options);
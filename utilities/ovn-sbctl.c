@@ -105,6 +105,7 @@ Port binding commands:\n\
   lsp-unbind PORT             reset the port binding of logical port PORT\n\
 \n\
 Logical flow commands:\n\
+  [--stage=STAGE] [--uuid-prefix=PREFIX] [--no-sort]\n\
   lflow-list [DATAPATH] [LFLOW...] List logical flows for DATAPATH\n\
   dump-flows [DATAPATH] [LFLOW...] Alias for lflow-list\n\
 \n\
@@ -129,6 +130,8 @@ Options:\n\
   --no-leader-only            accept any cluster member, not just the leader\n\
   -t, --timeout=SECS          wait at most SECS seconds\n\
   --dry-run                   do not commit changes to database\n\
+  --bulk=FILE                 execute the commands in FILE, one per line\n\
+  --bulk-size=N               commands per transaction with --bulk (1000)\n\
   --oneline                   print exactly one line of output per command\n",
            program_name, program_name, ctl_get_db_cmd_usage(),
            ctl_list_db_tables_usage(), default_sb_db());
@@ -907,6 +910,145 @@ sbctl_lflow_add(struct sbctl_lflow **lflows,
     (*n_flows)++;
 }
 
+/* In a direct invocation, lflow-list only retrieves the logical flows of the
+ * requested datapath, or of the requested stage, through a monitor condition
+ * on Logical_Flow.  The condition depends on the datapaths, which are not
+ * known yet when the prerequisites are added, so pre_lflow_list() first
+ * excludes all the logical flows.  cmd_lflow_list() then sets the condition
+ * and tries again once the server has applied it. */
+static enum {
+    LFLOW_COND_ALL,             /* All the logical flows are retrieved. */
+    LFLOW_COND_NONE,            /* None until cmd_lflow_list() sets one. */
+    LFLOW_COND_SET,             /* In effect at 'lflow_cond_seqno'. */
+} lflow_cond_state;
+static unsigned int lflow_cond_seqno;
+
+static void
+pre_lflow_list(struct ctl_context *ctx)
+{
+    static size_t n_lflow_lists;
+
+    pre_get_info(ctx);
+
+    /* The daemon keeps its copy of the database for later commands, and
+     * several lflow-list commands in one invocation would need several
+     * conditions. */
+    if (get_detach() || ovsdb_idl_has_ever_connected(ctx->idl)) {
+        return;
+    }
+
+    struct ovsdb_idl_condition cond;
+    ovsdb_idl_condition_init(&cond);
+    if (++n_lflow_lists == 1
+        && (ctx->argc > 1 || shash_find(&ctx->options, "--stage"))) {
+        lflow_cond_state = LFLOW_COND_NONE;
+        sbrec_logical_flow_set_condition(ctx->idl, &cond);
+    } else if (lflow_cond_state != LFLOW_COND_ALL) {
+        lflow_cond_state = LFLOW_COND_ALL;
+        ovsdb_idl_condition_add_clause_true(&cond);
+        sbrec_logical_flow_set_condition(ctx->idl, &cond);
+    }
+    ovsdb_idl_condition_destroy(&cond);
+}
+
+/* Restricts the logical flows in the IDL to those of 'datapath', if nonnull,
+ * otherwise to those of 'stage', if nonnull, and returns the condition
+ * sequence number at which this is in effect. */
+static unsigned int
+sbctl_lflow_set_condition(struct ovsdb_idl *idl,
+                          const struct sbrec_datapath_binding *datapath,
+                          const char *stage)
+{
+    struct ovsdb_idl_condition cond;
+    ovsdb_idl_condition_init(&cond);
+    if (datapath) {
+        struct uuid *uuid = CONST_CAST(struct uuid *,
+                                       &datapath->header_.uuid);
+        sbrec_logical_flow_add_clause_logical_datapath(&cond, OVSDB_F_EQ,
+                                                       uuid);
+
+        const struct sbrec_logical_dp_group *dp_group;
+        SBREC_LOGICAL_DP_GROUP_FOR_EACH (dp_group, idl) {
+            if (datapath_group_contains_datapath(dp_group, datapath)) {
+                sbrec_logical_flow_add_clause_logical_dp_group(
+                    &cond, OVSDB_F_EQ, &dp_group->header_.uuid);
+            }
+        }
+    } else if (stage) {
+        const struct smap ids = SMAP_CONST1(&ids, "stage-name", stage);
+        sbrec_logical_flow_add_clause_external_ids(&cond, OVSDB_F_INCLUDES,
+                                                   &ids);
+    } else {
+        ovsdb_idl_condition_add_clause_true(&cond);
+    }
+    unsigned int seqno = sbrec_logical_flow_set_condition(idl, &cond);
+    ovsdb_idl_condition_destroy(&cond);
+    return seqno;
+}
+
+/* Returns true if 'lflow' passes the --stage and --uuid-prefix options and
+ * the LFLOW arguments of lflow-list. */
+static bool
+sbctl_lflow_is_selected(const struct ctl_context *ctx,
+                        const struct sbrec_logical_flow *lflow,
+                        const char *stage, const char *uuid_prefix)
+{
+    if (stage && strcmp(smap_get_def(&lflow->external_ids, "stage-name", ""),
+                        stage)) {
+        return false;
+    }
+
+    /* By default, we print all flows, but if any UUIDs were listed on the
+     * command line then we only print the matching ones. */
+    if (ctx->argc <= 1 && !uuid_prefix) {
+        return true;
+    }
+    if (uuid_prefix && is_partial_uuid_match(&lflow->header_.uuid,
+                                             uuid_prefix)) {
+        return true;
+    }
+    for (size_t i = 1; i < ctx->argc; i++) {
+        if (is_partial_uuid_match(&lflow->header_.uuid, ctx->argv[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+sbctl_lflow_print(struct ctl_context *ctx, const struct sbctl_lflow *curr,
+                  const struct sbctl_lflow *prev, bool print_uuid,
+                  struct vconn *vconn, bool stats)
+{
+    /* Print a header line for this datapath or pipeline, if we haven't
+     * already done so. */
+    if (!prev
+        || prev->dp != curr->dp
+        || strcmp(prev->lflow->pipeline, curr->lflow->pipeline)) {
+        ds_put_cstr(&ctx->output, "Datapath: ");
+        print_datapath_name(curr->dp, &ctx->output);
+        ds_put_format(&ctx->output, " ("UUID_FMT")  Pipeline: %s\n",
+                      UUID_ARGS(&curr->dp->header_.uuid),
+                      curr->lflow->pipeline);
+    }
+
+    /* Print the flow. */
+    ds_put_cstr(&ctx->output, "  ");
+    print_uuid_part(&curr->lflow->header_.uuid, print_uuid, &ctx->output);
+    ds_put_format(&ctx->output,
+                  "table=%-2"PRId64"(%-19s), priority=%-5"PRId64
+                  ", match=(%s), action=(%s)\n",
+                  curr->lflow->table_id,
+                  smap_get_def(&curr->lflow->external_ids,
+                               "stage-name", ""),
+                  curr->lflow->priority, curr->lflow->match,
+                  curr->lflow->actions);
+    if (vconn) {
+        sbctl_dump_openflow(vconn, &curr->lflow->header_.uuid, stats,
+                            &ctx->output);
+    }
+}
+
 static void
 cmd_lflow_list(struct ctl_context *ctx)
 {
@@ -935,9 +1077,28 @@ cmd_lflow_list(struct ctl_context *ctx)
             return;
         }
     }
+    char *uuid_prefix = shash_find_data(&ctx->options, "--uuid-prefix");
+    if (uuid_prefix && !parse_partial_uuid(uuid_prefix)) {
+        ctl_error(ctx, "%s is not a UUID or the beginning of a UUID",
+                  uuid_prefix);
+        return;
+    }
+    const char *stage = shash_find_data(&ctx->options, "--stage");
+
+    if (lflow_cond_state == LFLOW_COND_NONE) {
+        lflow_cond_seqno = sbctl_lflow_set_condition(ctx->idl, datapath,
+                                                     stage);
+        lflow_cond_state = LFLOW_COND_SET;
+    }
+    if (lflow_cond_state == LFLOW_COND_SET
+        && ovsdb_idl_get_condition_seqno(ctx->idl) != lflow_cond_seqno) {
+        ctx->try_again = true;
+        return;
+    }
 
     struct vconn *vconn = sbctl_open_vconn(&ctx->options);
     bool stats = shash_find(&ctx->options, "--stats") != NULL;
+    bool print_uuid = shash_find(&ctx->options, "--uuid") != NULL;
 
     struct sbctl_lflow *lflows = NULL;
     size_t n_flows = 0;
@@ -951,6 +1112,9 @@ cmd_lflow_list(struct ctl_context *ctx)
                                                  datapath)) {
             continue;
         }
+        if (!sbctl_lflow_is_selected(ctx, lflow, stage, uuid_prefix)) {
+            continue;
+        }
         if (datapath) {
             sbctl_lflow_add(&lflows, &n_flows, &n_capacity, lflow, datapath);
             continue;
@@ -966,64 +1130,15 @@ cmd_lflow_list(struct ctl_context *ctx)
         }
     }
 
-    if (n_flows) {
+    /* With --no-sort, the flows are listed in the order of the IDL, which
+     * saves sorting them all but repeats the datapath and pipeline headers
+     * as needed. */
+    if (n_flows && !shash_find(&ctx->options, "--no-sort")) {
         qsort(lflows, n_flows, sizeof *lflows, sbctl_lflow_cmp);
     }
-
-    bool print_uuid = shash_find(&ctx->options, "--uuid") != NULL;
-
-    const struct sbctl_lflow *curr, *prev = NULL;
     for (size_t i = 0; i < n_flows; i++) {
-        curr = &lflows[i];
-
-        /* Figure out whether to print this particular flow.  By default, we
-         * print all flows, but if any UUIDs were listed on the command line
-         * then we only print the matching ones. */
-        bool include;
-        if (ctx->argc > 1) {
-            include = false;
-            for (size_t j = 1; j < ctx->argc; j++) {
-                if (is_partial_uuid_match(&curr->lflow->header_.uuid,
-                                          ctx->argv[j])) {
-                    include = true;
-                    break;
-                }
-            }
-        } else {
-            include = true;
-        }
-        if (!include) {
-            continue;
-        }
-
-        /* Print a header line for this datapath or pipeline, if we haven't
-         * already done so. */
-        if (!prev
-            || prev->dp != curr->dp
-            || strcmp(prev->lflow->pipeline, curr->lflow->pipeline)) {
-            ds_put_cstr(&ctx->output, "Datapath: ");
-            print_datapath_name(curr->dp, &ctx->output);
-            ds_put_format(&ctx->output, " ("UUID_FMT")  Pipeline: %s\n",
-                          UUID_ARGS(&curr->dp->header_.uuid),
-                          curr->lflow->pipeline);
-        }
-
-        /* Print the flow. */
-        ds_put_cstr(&ctx->output, "  ");
-        print_uuid_part(&curr->lflow->header_.uuid, print_uuid, &ctx->output);
-        ds_put_format(&ctx->output,
-                      "table=%-2"PRId64"(%-19s), priority=%-5"PRId64
-                      ", match=(%s), action=(%s)\n",
-                      curr->lflow->table_id,
-                      smap_get_def(&curr->lflow->external_ids,
-                                   "stage-name", ""),
-                      curr->lflow->priority, curr->lflow->match,
-                      curr->lflow->actions);
-        if (vconn) {
-            sbctl_dump_openflow(vconn, &curr->lflow->header_.uuid, stats,
-                                &ctx->output);
-        }
-        prev = curr;
+        sbctl_lflow_print(ctx, &lflows[i], i ? &lflows[i - 1] : NULL,
+                          print_uuid, vconn, stats);
     }
 
     bool vflows = shash_find(&ctx->options, "--vflows") != NULL;
@@ -1381,11 +1496,11 @@ static const struct ctl_command_syntax sbctl_commands[] = {
 
     /* Logical flow commands */
     {"lflow-list", 0, INT_MAX, "[DATAPATH] [LFLOW...]",
-     pre_get_info, cmd_lflow_list, NULL,
-     "--uuid,--ovs?,--stats,--vflows?", RO},
+     pre_lflow_list, cmd_lflow_list, NULL,
+     "--uuid,--ovs?,--stats,--vflows?,--stage=,--uuid-prefix=,--no-sort", RO},
     {"dump-flows", 0, INT_MAX, "[DATAPATH] [LFLOW...]",
-     pre_get_info, cmd_lflow_list, NULL,
-     "--uuid,--ovs?,--stats,--vflows?",
+     pre_lflow_list, cmd_lflow_list, NULL,
+     "--uuid,--ovs?,--stats,--vflows?,--stage=,--uuid-prefix=,--no-sort",
      RO}, /* Friendly alias for lflow-list */
 
     /* IP multicast commands. */
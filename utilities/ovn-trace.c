@@ -18,12 +18,14 @@
 
 #include <getopt.h>
 
+#include "classifier.h"
 #include "command-line.h"
 #include "compiler.h"
 #include "daemon.h"
 #include "dirs.h"
 #include "fatal-signal.h"
 #include "flow.h"
+#include "hmapx.h"
 #include "nx-match.h"
 #include "openvswitch/dynamic-string.h"
 #include "openvswitch/json.h"
@@ -42,8 +44,12 @@
 #include "lib/ovn-util.h"
 #include "ovsdb-idl.h"
 #include "openvswitch/poll-loop.h"
+#include "ovs-atomic.h"
+#include "ovs-rcu.h"
+#include "ovs-thread.h"
 #include "stream-ssl.h"
 #include "stream.h"
+#include "svec.h"
 #include "unixctl.h"
 #include "util.h"
 #include "random.h"
@@ -73,10 +79,21 @@ static bool minimal;
 static const char *ovs;
 static struct vconn *vconn;
 
-/* --ct: Connection tracking state to use for ct_next() actions. */
+/* --ct: Connection tracking state to use for ct_next() actions.  The index
+ * of the next one to use is per thread, since --batch traces microflows in
+ * parallel. */
 static uint32_t *ct_states;
 static size_t n_ct_states;
-static size_t ct_state_idx;
+DEFINE_STATIC_PER_THREAD_DATA(size_t, ct_state_idx, 0);
+
+/* --batch: File with the microflows to trace, and the number of threads
+ * that trace them (--threads). */
+static const char *batch_file;
+static int n_batch_threads;
+
+/* While tracing for --batch, the names of the ports that the microflow is
+ * output to. */
+DEFINE_STATIC_PER_THREAD_DATA(struct svec *, trace_outputs, NULL);
 
 /* --lb-dst: load balancer destination info. */
 static struct ovnact_ct_lb_dst lb_dst;
@@ -92,9 +109,15 @@ static bool use_friendly_names = true;
 OVS_NO_RETURN static void usage(void);
 static void parse_options(int argc, char *argv[]);
 static char *trace(const char *datapath, const char *flow);
+static void trace_batch(const char *datapath);
 static void read_db(void);
+static void update_db(void);
+static void track_db(void);
 static unixctl_cb_func ovntrace_exit;
 static unixctl_cb_func ovntrace_trace;
+static unixctl_cb_func ovntrace_trace_batch;
+static bool ovntrace_lookup_port(const void *dp_, const char *port_name,
+                                 unsigned int *portp);
 
 int
 main(int argc, char *argv[])
@@ -114,6 +137,17 @@ main(int argc, char *argv[])
             ovs_fatal(0, "non-option arguments not supported with --detach "
                       "(use --help for help)");
         }
+        if (batch_file) {
+            ovs_fatal(0, "--batch is not supported with --detach");
+        }
+    } else if (batch_file) {
+        if (argc > 1) {
+            ovs_fatal(0, "at most one non-option argument is allowed with "
+                      "--batch (use --help for help)");
+        }
+        if (ovs) {
+            ovs_fatal(0, "--ovs is not supported with --batch");
+        }
     } else {
         if (argc != 1 && argc != 2) {
             ovs_fatal(0, "one or two non-option arguments are required "
@@ -136,10 +170,20 @@ main(int argc, char *argv[])
         unixctl_command_register("exit", "", 0, 0, ovntrace_exit, &exiting);
         unixctl_command_register("trace", "[OPTIONS] [DATAPATH] MICROFLOW",
                                  1, INT_MAX, ovntrace_trace, NULL);
+        unixctl_command_register("trace-batch",
+                                 "[OPTIONS] DATAPATH MICROFLOW "
+                                 "[DATAPATH MICROFLOW]...",
+                                 2, INT_MAX, ovntrace_trace_batch, NULL);
     }
     ovnsb_idl = ovsdb_idl_create(db, &sbrec_idl_class, true, false);
+    if (get_detach()) {
+        /* Keep the data read from the database up to date instead of
+         * reading it only once. */
+        track_db();
+    }
 
     bool already_read = false;
+    unsigned int db_seqno = 0;
     for (;;) {
         ovsdb_idl_run(ovnsb_idl);
         unixctl_server_run(server);
@@ -150,13 +194,21 @@ main(int argc, char *argv[])
         }
 
         if (ovsdb_idl_has_ever_connected(ovnsb_idl)) {
+            unsigned int new_seqno = ovsdb_idl_get_seqno(ovnsb_idl);
             if (!already_read) {
                 already_read = true;
                 read_db();
+            } else if (new_seqno != db_seqno) {
+                update_db();
             }
+            db_seqno = new_seqno;
+            ovsdb_idl_track_clear(ovnsb_idl);
 
             daemonize_complete();
-            if (!get_detach()) {
+            if (batch_file) {
+                trace_batch(argc ? argv[0] : NULL);
+                return 0;
+            } else if (!get_detach()) {
                 const char *dp_s = argc > 1 ? argv[0] : NULL;
                 const char *flow_s = argv[argc - 1];
                 char *output = trace(dp_s, flow_s);
@@ -245,7 +297,9 @@ parse_options(int argc, char *argv[])
         SSL_OPTION_ENUMS,
         VLOG_OPTION_ENUMS,
         OPT_LB_DST,
-        OPT_SELECT_ID
+        OPT_SELECT_ID,
+        OPT_BATCH,
+        OPT_THREADS
     };
     static const struct option long_options[] = {
         {"db", required_argument, NULL, OPT_DB},
@@ -262,6 +316,8 @@ parse_options(int argc, char *argv[])
         {"version", no_argument, NULL, 'V'},
         {"lb-dst", required_argument, NULL, OPT_LB_DST},
         {"select-id", required_argument, NULL, OPT_SELECT_ID},
+        {"batch", required_argument, NULL, OPT_BATCH},
+        {"threads", required_argument, NULL, OPT_THREADS},
         OVN_DAEMON_LONG_OPTIONS,
         VLOG_LONG_OPTIONS,
         STREAM_SSL_LONG_OPTIONS,
@@ -327,6 +383,17 @@ parse_options(int argc, char *argv[])
             parse_select_option(optarg);
             break;
 
+        case OPT_BATCH:
+            batch_file = optarg;
+            break;
+
+        case OPT_THREADS:
+            if (!str_to_int(optarg, 10, &n_batch_threads)
+                || n_batch_threads < 1) {
+                ovs_fatal(0, "%s: bad number of threads", optarg);
+            }
+            break;
+
         case 'h':
             usage();
 
@@ -363,6 +430,7 @@ usage(void)
     printf("\
 %s: OVN trace utility\n\
 usage: %s [OPTIONS] [DATAPATH] MICROFLOW\n\
+       %s [OPTIONS] --batch=FILE [DATAPATH]\n\
        %s [OPTIONS] --detach\n\
 \n\
 Output format options:\n\
@@ -371,8 +439,11 @@ Output format options:\n\
   --minimal               minimum to explain externally visible behavior\n\
   --all                   provide all forms of output\n\
 Output style options:\n\
-  --no-friendly-names     do not substitute human friendly names for UUIDs\n",
-           program_name, program_name, program_name);
+  --no-friendly-names     do not substitute human friendly names for UUIDs\n\
+Batch options:\n\
+  --batch=FILE            trace each microflow in FILE, print JSON verdicts\n\
+  --threads=N             trace with N threads (default: number of cores)\n",
+           program_name, program_name, program_name, program_name);
     daemon_usage();
     vlog_usage();
     printf("\n\
@@ -404,6 +475,10 @@ struct ovntrace_datapath {
     struct ovntrace_flow **flows;
     size_t n_flows, allocated_flows;
 
+    /* The flows of each logical table, by pipeline and table id.  Each
+     * classifier contains "struct ovntrace_rule"s. */
+    struct classifier tables[2][LOG_PIPELINE_LEN];
+
     struct hmap mac_bindings;   /* Contains "struct ovntrace_mac_binding"s. */
     struct hmap fdbs;   /* Contains "struct ovntrace_fdb"s. */
 
@@ -435,6 +510,7 @@ struct ovntrace_mcgroup {
 };
 
 struct ovntrace_flow {
+    struct ovntrace_datapath *dp;
     struct uuid uuid;
     enum ovnact_pipeline pipeline;
     int table_id;
@@ -443,10 +519,28 @@ struct ovntrace_flow {
     int priority;
     char *match_s;
     struct expr *match;
+    struct hmap matches;        /* Contains "struct expr_match"es. */
+    uint32_t n_conjs;           /* Number of conjunctive matches. */
     struct ovnact *ovnacts;
     size_t ovnacts_len;
 };
 
+/* A rule in the classifier of a logical table, for one of the matches of
+ * 'flow'.  A clause of a conjunctive match may be the same, at the same
+ * priority, in several flows, so a single rule gets all of their
+ * conjunctions. */
+struct ovntrace_rule {
+    struct cls_rule cr;
+    const struct ovntrace_flow *flow;
+
+    /* Only used while building the classifier. */
+    struct hmap_node node;
+    const struct match *match;
+    uint32_t conj_id_ofs;
+    struct cls_conjunction *conjs;
+    size_t n_conjs, allocated_conjs;
+};
+
 struct ovntrace_mac_binding {
     struct hmap_node node;
     uint16_t port_key;
@@ -493,6 +587,19 @@ static struct hmap dhcpv6_opts; /* Contains "struct gen_opts_map"s. */
 static struct hmap nd_ra_opts; /* Contains "struct gen_opts_map"s. */
 static struct controller_event_options event_opts;
 
+/* The flows parsed from a southbound Logical_Flow record, one per datapath
+ * that the record applies to. */
+struct ovntrace_lflow {
+    struct hmap_node node;      /* In 'lflows', by Logical_Flow UUID. */
+    struct uuid uuid;
+    struct ovntrace_flow **flows;
+    size_t n_flows;
+};
+
+/* Every ovntrace_lflow, so that with --detach only the logical flows that
+ * change need to be parsed again. */
+static struct hmap lflows = HMAP_INITIALIZER(&lflows);
+
 static struct ovntrace_datapath *
 ovntrace_datapath_find_by_sb_uuid(const struct uuid *sb_uuid)
 {
@@ -676,6 +783,11 @@ read_datapaths(void)
         dp->tunnel_key = sbdb->tunnel_key;
 
         ovs_list_init(&dp->mcgroups);
+        for (size_t i = 0; i < ARRAY_SIZE(dp->tables); i++) {
+            for (size_t j = 0; j < ARRAY_SIZE(dp->tables[i]); j++) {
+                classifier_init(&dp->tables[i][j], NULL);
+            }
+        }
         hmap_init(&dp->mac_bindings);
         hmap_init(&dp->fdbs);
         hmap_insert(&datapaths, &dp->sb_uuid_node, uuid_hash(&dp->sb_uuid));
@@ -913,7 +1025,7 @@ ovntrace_make_names_friendly(const char *in)
     return ds_steal_cstr(&out);
 }
 
-static void
+static struct ovntrace_flow *
 parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
                         const struct sbrec_datapath_binding *sbdb)
 {
@@ -921,7 +1033,7 @@ parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
             = ovntrace_datapath_find_by_sb_uuid(&sbdb->header_.uuid);
         if (!dp) {
             VLOG_WARN("logical flow missing datapath");
-            return;
+            return NULL;
         }
 
         char *error;
@@ -933,7 +1045,7 @@ parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
             VLOG_WARN("%s: parsing expression failed (%s)",
                       sblf->match, error);
             free(error);
-            return;
+            return NULL;
         }
 
         struct ovnact_parse_params pp = {
@@ -956,7 +1068,7 @@ parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
             VLOG_WARN("%s: parsing actions failed (%s)", sblf->actions, error);
             free(error);
             expr_destroy(match);
-            return;
+            return NULL;
         }
 
         match = expr_combine(EXPR_T_AND, match, prereqs);
@@ -967,7 +1079,7 @@ parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
             expr_destroy(match);
             ovnacts_free(ovnacts.data, ovnacts.size);
             ofpbuf_uninit(&ovnacts);
-            return;
+            return NULL;
         }
         if (match) {
             match = expr_simplify(match);
@@ -977,6 +1089,7 @@ parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
         }
 
         struct ovntrace_flow *flow = xzalloc(sizeof *flow);
+        flow->dp = dp;
         flow->uuid = sblf->header_.uuid;
         flow->pipeline = (!strcmp(sblf->pipeline, "ingress")
                           ? OVNACT_P_INGRESS
@@ -989,14 +1102,253 @@ parse_lflow_for_datapath(const struct sbrec_logical_flow *sblf,
         flow->priority = sblf->priority;
         flow->match_s = ovntrace_make_names_friendly(sblf->match);
         flow->match = match;
+        hmap_init(&flow->matches);
+        if (match) {
+            struct expr *normalized = expr_normalize(expr_clone(match));
+            flow->n_conjs = expr_to_matches(normalized, ovntrace_lookup_port,
+                                            dp, &flow->matches);
+            expr_destroy(normalized);
+        }
         flow->ovnacts_len = ovnacts.size;
         flow->ovnacts = ofpbuf_steal_data(&ovnacts);
+        return flow;
+}
+
+static void
+ovntrace_flow_destroy(struct ovntrace_flow *flow)
+{
+    free(flow->stage_name);
+    free(flow->source);
+    free(flow->match_s);
+    expr_destroy(flow->match);
+    expr_matches_destroy(&flow->matches);
+    ovnacts_free(flow->ovnacts, flow->ovnacts_len);
+    free(flow->ovnacts);
+    free(flow);
+}
 
-        if (dp->n_flows >= dp->allocated_flows) {
-            dp->flows = x2nrealloc(dp->flows, &dp->allocated_flows,
-                                   sizeof *dp->flows);
+static struct ovntrace_lflow *
+ovntrace_lflow_find(const struct uuid *uuid)
+{
+    struct ovntrace_lflow *lflow;
+    HMAP_FOR_EACH_WITH_HASH (lflow, node, uuid_hash(uuid), &lflows) {
+        if (uuid_equals(uuid, &lflow->uuid)) {
+            return lflow;
         }
-        dp->flows[dp->n_flows++] = flow;
+    }
+    return NULL;
+}
+
+/* Parses 'sblf' for each of its datapaths and adds the result to 'lflows'.
+ * The flows only get into the datapaths' tables on the next call to
+ * index_flows().  Returns the new ovntrace_lflow, or NULL if 'sblf' has no
+ * datapath. */
+static struct ovntrace_lflow *
+ovntrace_lflow_add(const struct sbrec_logical_flow *sblf)
+{
+    const struct sbrec_logical_dp_group *g = sblf->logical_dp_group;
+    size_t n_datapaths = ((sblf->logical_datapath ? 1 : 0)
+                          + (g ? g->n_datapaths : 0));
+    if (!n_datapaths) {
+        VLOG_WARN("logical flow missing datapath");
+        return NULL;
+    }
+
+    struct ovntrace_lflow *lflow = xzalloc(sizeof *lflow);
+    lflow->uuid = sblf->header_.uuid;
+    lflow->flows = xmalloc(n_datapaths * sizeof *lflow->flows);
+    hmap_insert(&lflows, &lflow->node, uuid_hash(&lflow->uuid));
+
+    struct ovntrace_flow *flow;
+    if (sblf->logical_datapath) {
+        flow = parse_lflow_for_datapath(sblf, sblf->logical_datapath);
+        if (flow) {
+            lflow->flows[lflow->n_flows++] = flow;
+        }
+    }
+    for (size_t i = 0; g && i < g->n_datapaths; i++) {
+        flow = parse_lflow_for_datapath(sblf, g->datapaths[i]);
+        if (flow) {
+            lflow->flows[lflow->n_flows++] = flow;
+        }
+    }
+    return lflow;
+}
+
+/* Frees 'lflow' and its flows.  The caller must remove it from 'lflows'
+ * and call index_flows() before any trace. */
+static void
+ovntrace_lflow_destroy(struct ovntrace_lflow *lflow)
+{
+    for (size_t i = 0; i < lflow->n_flows; i++) {
+        ovntrace_flow_destroy(lflow->flows[i]);
+    }
+    free(lflow->flows);
+    free(lflow);
+}
+
+static void
+ovntrace_rule_free(struct ovntrace_rule *rule)
+{
+    cls_rule_destroy(&rule->cr);
+    free(rule);
+}
+
+static struct ovntrace_rule *
+ovntrace_rule_find(const struct hmap *rules, const struct match *match,
+                   int priority, uint32_t hash)
+{
+    struct ovntrace_rule *rule;
+    HMAP_FOR_EACH_WITH_HASH (rule, node, hash, rules) {
+        if (rule->flow->priority == priority
+            && match_equal(rule->match, match)) {
+            return rule;
+        }
+    }
+    return NULL;
+}
+
+/* Inserts into 'cls' the rules for the matches of the 'n_flows' flows in
+ * 'flows', which must all be in the same logical table. */
+static void
+ovntrace_table_build(struct classifier *cls,
+                     struct ovntrace_flow *const *flows, size_t n_flows)
+{
+    struct hmap rules = HMAP_INITIALIZER(&rules);
+    uint32_t conj_id_ofs = 0;
+
+    for (size_t i = 0; i < n_flows; i++) {
+        const struct ovntrace_flow *flow = flows[i];
+        const struct expr_match *m;
+
+        HMAP_FOR_EACH (m, hmap_node, &flow->matches) {
+            uint32_t hash = match_hash(&m->match, flow->priority);
+            struct ovntrace_rule *rule = NULL;
+
+            /* A match on conj_id is specific to its flow. */
+            if (!m->match.wc.masks.conj_id) {
+                rule = ovntrace_rule_find(&rules, &m->match, flow->priority,
+                                          hash);
+            }
+            if (!rule) {
+                rule = xzalloc(sizeof *rule);
+                rule->flow = flow;
+                rule->match = &m->match;
+                rule->conj_id_ofs = conj_id_ofs;
+                hmap_insert(&rules, &rule->node, hash);
+            } else if (!m->n || !rule->n_conjs) {
+                /* Same match and priority as an earlier flow: as in
+                 * OpenFlow, only one of them can apply. */
+                continue;
+            }
+
+            for (size_t j = 0; j < m->n; j++) {
+                if (rule->n_conjs >= rule->allocated_conjs) {
+                    rule->conjs = x2nrealloc(rule->conjs,
+                                             &rule->allocated_conjs,
+                                             sizeof *rule->conjs);
+                }
+                struct cls_conjunction *conj = &rule->conjs[rule->n_conjs++];
+                *conj = m->conjunctions[j];
+                conj->id += conj_id_ofs;
+            }
+        }
+        conj_id_ofs += flow->n_conjs;
+    }
+
+    struct ovntrace_rule *rule;
+    HMAP_FOR_EACH_POP (rule, node, &rules) {
+        struct match match = *rule->match;
+        if (match.wc.masks.conj_id) {
+            match.flow.conj_id += rule->conj_id_ofs;
+        }
+        cls_rule_init(&rule->cr, &match, rule->flow->priority);
+        classifier_insert(cls, &rule->cr, OVS_VERSION_MIN,
+                          rule->conjs, rule->n_conjs);
+
+        free(rule->conjs);
+        rule->conjs = NULL;
+        rule->n_conjs = rule->allocated_conjs = 0;
+        rule->match = NULL;
+    }
+    hmap_destroy(&rules);
+}
+
+/* Removes all the rules from the classifiers of 'dp'. */
+static void
+ovntrace_datapath_clear_tables(struct ovntrace_datapath *dp)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(dp->tables); i++) {
+        for (size_t j = 0; j < ARRAY_SIZE(dp->tables[i]); j++) {
+            struct classifier *cls = &dp->tables[i][j];
+            struct ovntrace_rule *rule;
+
+            CLS_FOR_EACH (rule, cr, cls) {
+                classifier_remove_assert(cls, &rule->cr);
+                ovsrcu_postpone(ovntrace_rule_free, rule);
+            }
+        }
+    }
+}
+
+/* Rebuilds the classifiers of 'dp' from its sorted 'flows'. */
+static void
+ovntrace_datapath_build_tables(struct ovntrace_datapath *dp)
+{
+    ovntrace_datapath_clear_tables(dp);
+
+    size_t start = 0;
+    for (size_t i = 1; i <= dp->n_flows; i++) {
+        const struct ovntrace_flow *first = dp->flows[start];
+        if (i < dp->n_flows
+            && dp->flows[i]->pipeline == first->pipeline
+            && dp->flows[i]->table_id == first->table_id) {
+            continue;
+        }
+
+        if (first->table_id >= 0 && first->table_id < LOG_PIPELINE_LEN) {
+            ovntrace_table_build(&dp->tables[first->pipeline][first->table_id],
+                                 &dp->flows[start], i - start);
+        }
+        start = i;
+    }
+}
+
+/* Rebuilds the sorted flow tables and the classifiers of the datapaths in
+ * 'dps', or of every datapath if 'dps' is NULL, from 'lflows'. */
+static void
+index_flows(const struct hmapx *dps)
+{
+    struct ovntrace_datapath *dp;
+    HMAP_FOR_EACH (dp, sb_uuid_node, &datapaths) {
+        if (!dps || hmapx_contains(dps, dp)) {
+            dp->n_flows = 0;
+        }
+    }
+
+    const struct ovntrace_lflow *lflow;
+    HMAP_FOR_EACH (lflow, node, &lflows) {
+        for (size_t i = 0; i < lflow->n_flows; i++) {
+            struct ovntrace_flow *flow = lflow->flows[i];
+
+            dp = flow->dp;
+            if (dps && !hmapx_contains(dps, dp)) {
+                continue;
+            }
+            if (dp->n_flows >= dp->allocated_flows) {
+                dp->flows = x2nrealloc(dp->flows, &dp->allocated_flows,
+                                       sizeof *dp->flows);
+            }
+            dp->flows[dp->n_flows++] = flow;
+        }
+    }
+
+    HMAP_FOR_EACH (dp, sb_uuid_node, &datapaths) {
+        if (!dps || hmapx_contains(dps, dp)) {
+            qsort(dp->flows, dp->n_flows, sizeof *dp->flows, compare_flow);
+            ovntrace_datapath_build_tables(dp);
+        }
+    }
 }
 
 static void
@@ -1006,27 +1358,41 @@ read_flows(void)
 
     const struct sbrec_logical_flow *sblf;
     SBREC_LOGICAL_FLOW_FOR_EACH (sblf, ovnsb_idl) {
-        bool missing_datapath = true;
+        ovntrace_lflow_add(sblf);
+    }
+    index_flows(NULL);
+}
 
-        if (sblf->logical_datapath) {
-            parse_lflow_for_datapath(sblf, sblf->logical_datapath);
-            missing_datapath = false;
-        }
+/* Parses again the logical flows that changed since the IDL's tracked
+ * changes were last cleared. */
+static void
+update_flows(void)
+{
+    struct hmapx dps = HMAPX_INITIALIZER(&dps);
 
-        const struct sbrec_logical_dp_group *g = sblf->logical_dp_group;
-        for (size_t i = 0; g && i < g->n_datapaths; i++) {
-            parse_lflow_for_datapath(sblf, g->datapaths[i]);
-            missing_datapath = false;
+    const struct sbrec_logical_flow *sblf;
+    SBREC_LOGICAL_FLOW_FOR_EACH_TRACKED (sblf, ovnsb_idl) {
+        struct ovntrace_lflow *lflow
+            = ovntrace_lflow_find(&sblf->header_.uuid);
+        if (lflow) {
+            for (size_t i = 0; i < lflow->n_flows; i++) {
+                hmapx_add(&dps, lflow->flows[i]->dp);
+            }
+            hmap_remove(&lflows, &lflow->node);
+            ovntrace_lflow_destroy(lflow);
         }
-        if (missing_datapath) {
-            VLOG_WARN("logical flow missing datapath");
+        if (!sbrec_logical_flow_is_deleted(sblf)) {
+            lflow = ovntrace_lflow_add(sblf);
+            for (size_t i = 0; lflow && i < lflow->n_flows; i++) {
+                hmapx_add(&dps, lflow->flows[i]->dp);
+            }
         }
     }
 
-    const struct ovntrace_datapath *dp;
-    HMAP_FOR_EACH (dp, sb_uuid_node, &datapaths) {
-        qsort(dp->flows, dp->n_flows, sizeof *dp->flows, compare_flow);
+    if (!hmapx_is_empty(&dps)) {
+        index_flows(&dps);
     }
+    hmapx_destroy(&dps);
 }
 
 static void
@@ -1130,6 +1496,165 @@ read_db(void)
     read_fdbs();
 }
 
+static void
+destroy_mac_bindings(void)
+{
+    struct ovntrace_datapath *dp;
+    HMAP_FOR_EACH (dp, sb_uuid_node, &datapaths) {
+        struct ovntrace_mac_binding *binding;
+        HMAP_FOR_EACH_POP (binding, node, &dp->mac_bindings) {
+            free(binding);
+        }
+
+        struct ovntrace_fdb *fdb;
+        HMAP_FOR_EACH_POP (fdb, node, &dp->fdbs) {
+            free(fdb);
+        }
+    }
+}
+
+/* Frees everything read by read_db(). */
+static void
+destroy_db(void)
+{
+    struct ovntrace_lflow *lflow;
+    HMAP_FOR_EACH_POP (lflow, node, &lflows) {
+        ovntrace_lflow_destroy(lflow);
+    }
+
+    destroy_mac_bindings();
+
+    struct ovntrace_datapath *dp;
+    HMAP_FOR_EACH_POP (dp, sb_uuid_node, &datapaths) {
+        struct ovntrace_mcgroup *mcgroup;
+        LIST_FOR_EACH_POP (mcgroup, list_node, &dp->mcgroups) {
+            free(mcgroup->name);
+            free(mcgroup->ports);
+            free(mcgroup);
+        }
+        free(dp->flows);
+        ovntrace_datapath_clear_tables(dp);
+        for (size_t i = 0; i < ARRAY_SIZE(dp->tables); i++) {
+            for (size_t j = 0; j < ARRAY_SIZE(dp->tables[i]); j++) {
+                classifier_destroy(&dp->tables[i][j]);
+            }
+        }
+        hmap_destroy(&dp->mac_bindings);
+        hmap_destroy(&dp->fdbs);
+        free(dp->name);
+        free(dp->name2);
+        free(dp->friendly_name);
+        free(dp);
+    }
+    hmap_destroy(&datapaths);
+
+    struct shash_node *node;
+    SHASH_FOR_EACH (node, &ports) {
+        struct ovntrace_port *port = node->data;
+        free(port->name);
+        free(port->name2);
+        free(CONST_CAST(char *, port->friendly_name));
+        free(port->type);
+        free(port);
+    }
+    shash_destroy(&ports);
+
+    expr_const_sets_destroy(&address_sets);
+    shash_destroy(&address_sets);
+    expr_const_sets_destroy(&port_groups);
+    shash_destroy(&port_groups);
+
+    dhcp_opts_destroy(&dhcp_opts);
+    dhcp_opts_destroy(&dhcpv6_opts);
+    nd_ra_opts_destroy(&nd_ra_opts);
+    controller_event_opts_destroy(&event_opts);
+
+    expr_symtab_destroy(&symtab);
+    shash_destroy(&symtab);
+}
+
+/* Makes the IDL track changes to the columns that read_db() uses, so that
+ * update_db() can tell what needs to be read again.  The other columns,
+ * e.g. the chassis that a port is bound to, change often and do not matter
+ * to ovn-trace. */
+static void
+track_db(void)
+{
+    static const struct ovsdb_idl_column *columns[] = {
+        &sbrec_datapath_binding_col_external_ids,
+        &sbrec_datapath_binding_col_tunnel_key,
+        &sbrec_port_binding_col_datapath,
+        &sbrec_port_binding_col_external_ids,
+        &sbrec_port_binding_col_logical_port,
+        &sbrec_port_binding_col_options,
+        &sbrec_port_binding_col_tunnel_key,
+        &sbrec_port_binding_col_type,
+        &sbrec_multicast_group_col_datapath,
+        &sbrec_multicast_group_col_name,
+        &sbrec_multicast_group_col_ports,
+        &sbrec_multicast_group_col_tunnel_key,
+        &sbrec_address_set_col_addresses,
+        &sbrec_address_set_col_name,
+        &sbrec_port_group_col_name,
+        &sbrec_port_group_col_ports,
+        &sbrec_dhcp_options_col_code,
+        &sbrec_dhcp_options_col_name,
+        &sbrec_dhcp_options_col_type,
+        &sbrec_dhcpv6_options_col_code,
+        &sbrec_dhcpv6_options_col_name,
+        &sbrec_dhcpv6_options_col_type,
+        &sbrec_logical_dp_group_col_datapaths,
+        &sbrec_logical_flow_col_actions,
+        &sbrec_logical_flow_col_external_ids,
+        &sbrec_logical_flow_col_logical_datapath,
+        &sbrec_logical_flow_col_logical_dp_group,
+        &sbrec_logical_flow_col_match,
+        &sbrec_logical_flow_col_pipeline,
+        &sbrec_logical_flow_col_priority,
+        &sbrec_logical_flow_col_table_id,
+        &sbrec_mac_binding_col_datapath,
+        &sbrec_mac_binding_col_ip,
+        &sbrec_mac_binding_col_logical_port,
+        &sbrec_mac_binding_col_mac,
+        &sbrec_fdb_col_dp_key,
+        &sbrec_fdb_col_mac,
+        &sbrec_fdb_col_port_key,
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(columns); i++) {
+        ovsdb_idl_track_add_column(ovnsb_idl, columns[i]);
+    }
+}
+
+/* Brings the data read by read_db() up to date with the changes tracked by
+ * the IDL.  A change to the logical flows only requires parsing again the
+ * flows that changed, but the flows depend on the other tables, so any
+ * change to those reads the whole database again. */
+static void
+update_db(void)
+{
+    if (sbrec_datapath_binding_track_get_first(ovnsb_idl)
+        || sbrec_port_binding_track_get_first(ovnsb_idl)
+        || sbrec_multicast_group_track_get_first(ovnsb_idl)
+        || sbrec_address_set_track_get_first(ovnsb_idl)
+        || sbrec_port_group_track_get_first(ovnsb_idl)
+        || sbrec_dhcp_options_track_get_first(ovnsb_idl)
+        || sbrec_dhcpv6_options_track_get_first(ovnsb_idl)
+        || sbrec_logical_dp_group_track_get_first(ovnsb_idl)) {
+        destroy_db();
+        read_db();
+        return;
+    }
+
+    if (sbrec_mac_binding_track_get_first(ovnsb_idl)
+        || sbrec_fdb_track_get_first(ovnsb_idl)) {
+        destroy_mac_bindings();
+        read_mac_bindings();
+        read_fdbs();
+    }
+    update_flows();
+}
+
 static const struct ovntrace_port *
 ovntrace_port_lookup_by_name(const char *name)
 {
@@ -1212,18 +1737,16 @@ ovntrace_lookup_port(const void *dp_, const char *port_name,
 
 static const struct ovntrace_flow *
 ovntrace_flow_lookup(const struct ovntrace_datapath *dp,
-                     const struct flow *uflow,
+                     struct flow *uflow,
                      uint8_t table_id, enum ovnact_pipeline pipeline)
 {
-    for (size_t i = 0; i < dp->n_flows; i++) {
-        const struct ovntrace_flow *flow = dp->flows[i];
-        if (flow->pipeline == pipeline &&
-            flow->table_id == table_id &&
-            expr_evaluate(flow->match, uflow, ovntrace_lookup_port, dp)) {
-            return flow;
-        }
+    if (table_id >= LOG_PIPELINE_LEN) {
+        return NULL;
     }
-    return NULL;
+
+    const struct cls_rule *cr = classifier_lookup(
+        &dp->tables[pipeline][table_id], OVS_VERSION_MIN, uflow, NULL);
+    return cr ? CONTAINER_OF(cr, struct ovntrace_rule, cr)->flow : NULL;
 }
 
 static char *
@@ -1565,6 +2088,10 @@ execute_output(const struct ovntrace_datapath *dp, struct flow *uflow,
             ovntrace_node_append(super, OVNTRACE_NODE_MODIFY,
                                  "output(\"%s\")", out_name);
 
+            struct svec *outputs = *trace_outputs_get();
+            if (outputs) {
+                svec_add(outputs, out_name);
+            }
         }
         return;
     }
@@ -2250,8 +2777,9 @@ execute_ct_next(const struct ovnact_ct_next *ct_next,
     /* Figure out ct_state. */
     uint32_t state;
     const char *comment;
-    if (ct_state_idx < n_ct_states) {
-        state = ct_states[ct_state_idx++];
+    size_t *idx = ct_state_idx_get();
+    if (*idx < n_ct_states) {
+        state = ct_states[(*idx)++];
         comment = "";
     } else {
         state = CS_ESTABLISHED | CS_TRACKED;
@@ -2961,6 +3489,8 @@ trace(const char *dp_s, const char *flow_s)
     const struct ovntrace_port *inport = ovntrace_port_find_by_key(dp, in_key);
     const char *inport_name = inport ? inport->friendly_name : "(unnamed)";
 
+    *ct_state_idx_get() = 0;
+
     struct ds output = DS_EMPTY_INITIALIZER;
 
     ds_put_cstr(&output, "# ");
@@ -3014,6 +3544,129 @@ trace(const char *dp_s, const char *flow_s)
     return ds_steal_cstr(&output);
 }
 
+/* Traces 'flow_s' and returns a JSON object with its verdict: whether the
+ * microflow is dropped or output, and to which ports. */
+static struct json *
+trace_verdict(const char *dp_s, const char *flow_s)
+{
+    struct json *verdict = json_object_create();
+    json_object_put_string(verdict, "microflow", flow_s);
+
+    const struct ovntrace_datapath *dp;
+    struct flow uflow;
+    char *error = trace_parse(dp_s, flow_s, &dp, &uflow);
+    if (error) {
+        json_object_put_string(verdict, "verdict", "error");
+        error[strcspn(error, "\n")] = '\0';
+        json_object_put_string(verdict, "error", error);
+        free(error);
+        return verdict;
+    }
+
+    struct svec outputs = SVEC_EMPTY_INITIALIZER;
+    struct ovs_list root = OVS_LIST_INITIALIZER(&root);
+    *ct_state_idx_get() = 0;
+    *trace_outputs_get() = &outputs;
+    trace__(dp, &uflow, 0, OVNACT_P_INGRESS, &root);
+    *trace_outputs_get() = NULL;
+    ovntrace_node_list_destroy(&root);
+
+    struct json *ports = json_array_create_empty();
+    const char *name;
+    size_t i;
+    SVEC_FOR_EACH (i, name, &outputs) {
+        json_array_add(ports, json_string_create(name));
+    }
+    json_object_put_string(verdict, "datapath", dp->friendly_name);
+    json_object_put_string(verdict, "verdict",
+                           outputs.n ? "output" : "drop");
+    json_object_put(verdict, "ports", ports);
+    svec_destroy(&outputs);
+
+    return verdict;
+}
+
+struct trace_batch_ctx {
+    const char *dp_s;
+    const struct svec *flows;
+    struct json **verdicts;     /* One per microflow in 'flows'. */
+    atomic_count next;          /* Index of the next microflow to trace. */
+};
+
+static void *
+trace_batch_thread(void *ctx_)
+{
+    struct trace_batch_ctx *ctx = ctx_;
+
+    for (;;) {
+        unsigned int i = atomic_count_inc(&ctx->next);
+        if (i >= ctx->flows->n) {
+            break;
+        }
+        ctx->verdicts[i] = trace_verdict(ctx->dp_s, ctx->flows->names[i]);
+    }
+    return NULL;
+}
+
+/* Traces each microflow of 'batch_file', one per line, through 'dp_s' or
+ * the datapath of its inport, and prints a line with the JSON verdict of
+ * each, in the order of the file.  The traces only read the data read by
+ * read_db(), so they run in parallel in 'n_batch_threads' threads. */
+static void
+trace_batch(const char *dp_s)
+{
+    FILE *stream = (!strcmp(batch_file, "-") ? stdin
+                    : fopen(batch_file, "r"));
+    if (!stream) {
+        ovs_fatal(errno, "%s: open failed", batch_file);
+    }
+
+    struct svec flows = SVEC_EMPTY_INITIALIZER;
+    struct ds line = DS_EMPTY_INITIALIZER;
+    int line_number = 0;
+    while (!ds_get_preprocessed_line(&line, stream, &line_number)) {
+        if (line.length) {
+            svec_add(&flows, ds_cstr(&line));
+        }
+    }
+    ds_destroy(&line);
+    if (stream != stdin) {
+        fclose(stream);
+    }
+
+    struct trace_batch_ctx ctx = {
+        .dp_s = dp_s,
+        .flows = &flows,
+        .verdicts = xcalloc(flows.n, sizeof *ctx.verdicts),
+        .next = ATOMIC_COUNT_INIT(0),
+    };
+
+    size_t n_threads = n_batch_threads ? n_batch_threads : count_cpu_cores();
+    n_threads = MIN(n_threads, flows.n);
+    if (n_threads <= 1) {
+        trace_batch_thread(&ctx);
+    } else {
+        pthread_t *threads = xmalloc(n_threads * sizeof *threads);
+        for (size_t i = 0; i < n_threads; i++) {
+            threads[i] = ovs_thread_create("ovn_trace_batch",
+                                           trace_batch_thread, &ctx);
+        }
+        for (size_t i = 0; i < n_threads; i++) {
+            xpthread_join(threads[i], NULL);
+        }
+        free(threads);
+    }
+
+    for (size_t i = 0; i < flows.n; i++) {
+        char *s = json_to_string(ctx.verdicts[i], JSSF_SORT);
+        puts(s);
+        free(s);
+        json_destroy(ctx.verdicts[i]);
+    }
+    free(ctx.verdicts);
+    svec_destroy(&flows);
+}
+
 static void
 ovntrace_exit(struct unixctl_conn *conn, int argc OVS_UNUSED,
               const char *argv[] OVS_UNUSED, void *exiting_)
@@ -3023,10 +3676,16 @@ ovntrace_exit(struct unixctl_conn *conn, int argc OVS_UNUSED,
     unixctl_command_reply(conn, NULL);
 }
 
-static void
-ovntrace_trace(struct unixctl_conn *conn, int argc,
-               const char *argv[], void *aux OVS_UNUSED)
+/* Parses the output format options at the beginning of 'argv' for the
+ * "trace" and "trace-batch" commands, and skips them.  Returns false, after
+ * replying with an error to 'conn', if one of them is not valid. */
+static bool
+ovntrace_parse_trace_options(struct unixctl_conn *conn,
+                             int *argcp, const char **argvp[])
 {
+    int argc = *argcp;
+    const char **argv = *argvp;
+
     detailed = summary = minimal = false;
     while (argc > 1 && argv[1][0] == '-') {
         if (!strcmp(argv[1], "--detailed")) {
@@ -3039,7 +3698,7 @@ ovntrace_trace(struct unixctl_conn *conn, int argc,
             detailed = summary = minimal = true;
         } else {
             unixctl_command_reply_error(conn, "unknown option");
-            return;
+            return false;
         }
         argc--;
         argv++;
@@ -3048,6 +3707,19 @@ ovntrace_trace(struct unixctl_conn *conn, int argc,
         detailed = true;
     }
 
+    *argcp = argc;
+    *argvp = argv;
+    return true;
+}
+
+static void
+ovntrace_trace(struct unixctl_conn *conn, int argc,
+               const char *argv[], void *aux OVS_UNUSED)
+{
+    if (!ovntrace_parse_trace_options(conn, &argc, &argv)) {
+        return;
+    }
+
     if (argc != 2 && argc != 3) {
         unixctl_command_reply_error(
             conn, "one or two non-option arguments are required");
@@ -3060,3 +3732,37 @@ ovntrace_trace(struct unixctl_conn *conn, int argc,
     unixctl_command_reply(conn, output);
     free(output);
 }
+
+/* Traces each DATAPATH MICROFLOW pair of 'argv' and replies with all the
+ * traces, in order.  An empty DATAPATH is inferred from the microflow's
+ * inport, as when "trace" is given only a MICROFLOW. */
+static void
+ovntrace_trace_batch(struct unixctl_conn *conn, int argc,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    if (!ovntrace_parse_trace_options(conn, &argc, &argv)) {
+        return;
+    }
+
+    if (argc < 3 || (argc - 1) % 2) {
+        unixctl_command_reply_error(
+            conn, "DATAPATH MICROFLOW pairs are required");
+        return;
+    }
+
+    struct ds output = DS_EMPTY_INITIALIZER;
+    for (int i = 1; i < argc; i += 2) {
+        const char *dp_s = argv[i][0] ? argv[i] : NULL;
+        char *trace_s = trace(dp_s, argv[i + 1]);
+
+        if (i > 1) {
+            ds_put_char(&output, '\n');
+        }
+        ds_put_format(&output, "## Trace %d of %d.\n", i / 2 + 1,
+                      (argc - 1) / 2);
+        ds_put_cstr(&output, trace_s);
+        free(trace_s);
+    }
+    unixctl_command_reply(conn, ds_cstr(&output));
+    ds_destroy(&output);
+}